@@ -54,9 +54,14 @@ You can contact the author at :
 #  define XXH_PRIVATE_API
 #  include "xxhash.c"
 #else
+#  define XXH_STATIC_LINKING_ONLY   /* XXH32_state_t, XXH64_state_t */
 #  include "xxhash.h"
 #endif
 
+/* xxhash.h 0.8 dropped the static state macros this tool was written against */
+#define XXH32_CREATESTATE_STATIC(name)  XXH32_state_t name##_body; XXH32_state_t* const name = &name##_body
+#define XXH64_CREATESTATE_STATIC(name)  XXH64_state_t name##_body; XXH64_state_t* const name = &name##_body
+
 
 /* ************************************
 *  OS-Specific Includes
@@ -8,16 +8,278 @@
 
  #include "s4.h"
 #include "s4Internal.h"
-  
+
+#if defined(LTC_X86_SIMD)
+#include <cpuid.h>
+#endif
+
+#if defined(LTC_BLAKE3_THREADS)
+#include <unistd.h>
+#endif
+
+#ifdef __clang__
+#pragma mark - cpu features
+#endif
+
+static uint32_t     sCPUFeatures = 0;
+static bool         sCPUFeaturesValid = false;
+static uint32_t     sCPUMask = kS4CPU_All;
+
+#if defined(LTC_X86_SIMD)
+
+static uint32_t sCPU_Detect(void)
+{
+    uint32_t        features = 0;
+    unsigned int    eax, ebx, ecx, edx;
+    uint64_t        xcr0 = 0;
+    
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    
+    if(edx & (1U << 26)) features |= kS4CPU_SSE2;
+    if(ecx & (1U << 9))  features |= kS4CPU_SSSE3;
+    if(ecx & (1U << 19)) features |= kS4CPU_SSE41;
+    if(ecx & (1U << 25)) features |= kS4CPU_AES;
+    if(ecx & (1U << 1))  features |= kS4CPU_PCLMUL;
+    
+    /* the OS must save the YMM/ZMM registers before we can use them */
+    if(ecx & (1U << 27))
+    {
+        uint32_t lo, hi;
+        __asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+        xcr0 = ((uint64_t)hi << 32) | lo;
+    }
+    
+    if((ecx & (1U << 28)) && (xcr0 & 0x06) == 0x06)
+        features |= kS4CPU_AVX;
+    
+    if(__get_cpuid_max(0, NULL) >= 7)
+    {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        
+        if(ebx & (1U << 8))  features |= kS4CPU_BMI2;
+        if(ebx & (1U << 29)) features |= kS4CPU_SHA;
+        
+        if(features & kS4CPU_AVX)
+        {
+            if(ebx & (1U << 5)) features |= kS4CPU_AVX2;
+            
+            if((xcr0 & 0xE6) == 0xE6 && (ebx & (1U << 16)))
+            {
+                features |= kS4CPU_AVX512F;
+                if(ebx & (1U << 31)) features |= kS4CPU_AVX512VL;
+                if(ebx & (1U << 30)) features |= kS4CPU_AVX512BW;
+            }
+        }
+    }
+    
+    return features;
+}
+
+#else
+
+static uint32_t sCPU_Detect(void)
+{
+    return 0;
+}
+
+#endif
+
+uint32_t sCPU_Features(void)
+{
+    if(!sCPUFeaturesValid)
+    {
+        sCPUFeatures = sCPU_Detect();
+#if defined(__SIZEOF_INT128__)
+        sCPUFeatures |= kS4CPU_MUL128;
+#endif
+        sCPUFeaturesValid = true;
+    }
+    
+    return sCPUFeatures & sCPUMask;
+}
+
+#ifdef __clang__
+#pragma mark - backends
+#endif
+
+/* pick the fastest compress functions the CPU supports, the portable code stays the default */
+static void sSelectBackends(void)
+{
+    sha256_set_backend(LTC_SHA_BACKEND_C);
+    sha512_set_backend(LTC_SHA_BACKEND_C);
+    aes_set_backend(LTC_AES_BACKEND_C);
+    gcm_set_backend(LTC_GCM_BACKEND_C);
+    chacha_set_backend(LTC_CHACHA_BACKEND_C);
+    poly1305_set_backend(LTC_POLY1305_BACKEND_C);
+#if defined(LTC_BLAKE3)
+    blake3_set_backend(LTC_BLAKE3_BACKEND_C);
+#endif
+    
+    /* the radix 2^26 Poly1305 is what 32 bit builds run */
+    if(!sCPU_Has(kS4CPU_MUL128))
+        poly1305_set_backend(LTC_POLY1305_BACKEND_C26);
+    
+#if defined(LTC_X86_SIMD)
+    if(sCPU_Has(kS4CPU_SHA | kS4CPU_SSE41))
+        sha256_set_backend(LTC_SHA_BACKEND_SHANI);
+    
+    if(sCPU_Has(kS4CPU_AVX2 | kS4CPU_BMI2))
+        sha512_set_backend(LTC_SHA_BACKEND_AVX2);
+    
+    if(sCPU_Has(kS4CPU_AES | kS4CPU_SSSE3))
+        aes_set_backend(LTC_AES_BACKEND_AESNI);
+    else if(sCPU_Has(kS4CPU_SSSE3))
+        aes_set_backend(LTC_AES_BACKEND_VPAES);
+
+    if(sCPU_Has(kS4CPU_PCLMUL | kS4CPU_SSSE3))
+        gcm_set_backend(LTC_GCM_BACKEND_PCLMUL);
+
+    if(sCPU_Has(kS4CPU_AVX512F))
+        chacha_set_backend(LTC_CHACHA_BACKEND_AVX512);
+    else if(sCPU_Has(kS4CPU_AVX2))
+        chacha_set_backend(LTC_CHACHA_BACKEND_AVX2);
+    else if(sCPU_Has(kS4CPU_SSE2))
+        chacha_set_backend(LTC_CHACHA_BACKEND_SSE2);
+
+    if(sCPU_Has(kS4CPU_AVX2))
+        poly1305_set_backend(LTC_POLY1305_BACKEND_AVX2);
+#endif
+
+#if defined(LTC_BLAKE3)
+#if defined(LTC_X86_SIMD)
+    if(sCPU_Has(kS4CPU_AVX512F | kS4CPU_SSE41))
+        blake3_set_backend(LTC_BLAKE3_BACKEND_AVX512);
+    else if(sCPU_Has(kS4CPU_AVX2 | kS4CPU_SSE41))
+        blake3_set_backend(LTC_BLAKE3_BACKEND_AVX2);
+    else if(sCPU_Has(kS4CPU_SSE41))
+        blake3_set_backend(LTC_BLAKE3_BACKEND_SSE41);
+#endif
+
+#if defined(LTC_BLAKE3_THREADS)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        blake3_set_threads(cpus > 0 ? (int) MIN(cpus, 16) : 1);
+    }
+#endif
+#endif
+}
+
+static const char* sSHABackendName(int backend)
+{
+    switch(backend)
+    {
+        case LTC_SHA_BACKEND_SHANI:     return "shani";
+        case LTC_SHA_BACKEND_AVX2:      return "avx2";
+        default:                        return "c";
+    }
+}
+
+static const char* sAESBackendName(int backend)
+{
+    switch(backend)
+    {
+        case LTC_AES_BACKEND_AESNI:     return "aesni";
+        case LTC_AES_BACKEND_VPAES:     return "vpaes";
+        default:                        return "c";
+    }
+}
+
+static const char* sGCMBackendName(int backend)
+{
+    switch(backend)
+    {
+        case LTC_GCM_BACKEND_PCLMUL:    return "pclmul";
+        case LTC_GCM_BACKEND_4BIT:      return "4bit";
+        default:                        return "c";
+    }
+}
+
+static const char* sChaChaBackendName(int backend)
+{
+    switch(backend)
+    {
+        case LTC_CHACHA_BACKEND_SSE2:   return "sse2";
+        case LTC_CHACHA_BACKEND_AVX2:   return "avx2";
+        case LTC_CHACHA_BACKEND_AVX512: return "avx512";
+        default:                        return "c";
+    }
+}
+
+static const char* sPoly1305BackendName(int backend)
+{
+    switch(backend)
+    {
+        case LTC_POLY1305_BACKEND_AVX2: return "avx2";
+        case LTC_POLY1305_BACKEND_C26:  return "c26";
+        default:                        return "c";
+    }
+}
+
+static const char* sBLAKE3BackendName(int backend)
+{
+    switch(backend)
+    {
+        case LTC_BLAKE3_BACKEND_SSE41:  return "sse41";
+        case LTC_BLAKE3_BACKEND_AVX2:   return "avx2";
+        case LTC_BLAKE3_BACKEND_AVX512: return "avx512";
+        default:                        return "c";
+    }
+}
+
 #ifdef __clang__
 #pragma mark - init
 #endif
 
+/* the tomcrypt cipher index and key size of each block cipher algorithm.  find_cipher
+   compares names down the descriptor table, so it is done once here by S4_Init and the
+   modes look the answer up by algorithm */
+typedef struct
+{
+    int     cipher;
+    int     keylen;
+} sCipherEntry;
+
+static sCipherEntry sCipherTable[kCipher_Algorithm_2FISH256 + 1];
+
+static void sInitCipherTable(void)
+{
+    int aes     = find_cipher("aes");
+    int twofish = find_cipher("twofish");
+
+    sCipherTable[kCipher_Algorithm_AES128]      = (sCipherEntry) { aes,     128 >> 3 };
+    sCipherTable[kCipher_Algorithm_AES192]      = (sCipherEntry) { aes,     192 >> 3 };
+    sCipherTable[kCipher_Algorithm_AES256]      = (sCipherEntry) { aes,     256 >> 3 };
+    sCipherTable[kCipher_Algorithm_2FISH256]    = (sCipherEntry) { twofish, 256 >> 3 };
+}
+
+S4Err sCipherForAlgorithm(Cipher_Algorithm algorithm, int *cipher, int *keylen)
+{
+    S4Err   err = kS4Err_NoErr;
+
+    /* an entry S4_Init has not filled in has no key size */
+    if((size_t)algorithm >= sizeof(sCipherTable) / sizeof(sCipherTable[0])
+       || sCipherTable[algorithm].keylen == 0)
+        RETERR(kS4Err_BadCipherNumber);
+
+    if(cipher)
+        *cipher = sCipherTable[algorithm].cipher;
+
+    if(keylen)
+        *keylen = sCipherTable[algorithm].keylen;
+
+done:
+    return err;
+}
+
 
 S4Err S4_Init()
 {
     S4Err err = kS4Err_NoErr;
     
+    sCPU_Features();
+    sSelectBackends();
+    
     ltc_mp = ltm_desc;
 
     register_prng (&sprng_desc);
@@ -31,8 +293,21 @@ S4Err S4_Init()
     register_hash (&skein512_desc);
     register_hash (&skein1024_desc);
     register_hash (&sha512_256_desc);
+    register_hash (&blake3_desc);
     register_cipher (&aes_desc);
     register_cipher (&twofish_desc);
+
+    sInitCipherTable();
+    
+    return err;
+}
+
+S4Err sCPU_SetMask(uint32_t mask)
+{
+    S4Err err = kS4Err_NoErr;
+    
+    sCPUMask = mask;
+    sSelectBackends();
     
     return err;
 }
@@ -133,9 +408,9 @@ S4Err  S4_GetVersionString(size_t	bufSize, char *outString)
     ValidateParam(outString);
     *outString = 0;
     
-    char version_string[128];
+    char version_string[256];
     
-    snprintf(version_string, sizeof(version_string), "%s%s (%03d) %s",
+    snprintf(version_string, sizeof(version_string), "%s%s (%03d) %s [sha256:%s sha512:%s blake3:%s aes:%s gcm:%s chacha:%s poly1305:%s]",
              S4_SHORT_VERSION_STRING,
 #if _USES_COMMON_CRYPTO_
              "CC",
@@ -143,7 +418,14 @@ S4Err  S4_GetVersionString(size_t	bufSize, char *outString)
              "",
 #endif
             S4_BUILD_NUMBER,
-             GIT_COMMIT_HASH);
+             GIT_COMMIT_HASH,
+             sSHABackendName(sha256_get_backend()),
+             sSHABackendName(sha512_get_backend()),
+             sBLAKE3BackendName(blake3_get_backend()),
+             sAESBackendName(aes_get_backend()),
+             sGCMBackendName(gcm_get_backend()),
+             sChaChaBackendName(chacha_get_backend()),
+             sPoly1305BackendName(poly1305_get_backend()));
     
     if(strlen(version_string) +1 > bufSize)
         RETERR (kS4Err_BufferTooSmall);
@@ -200,6 +482,10 @@ const struct ltc_hash_descriptor* sDescriptorForHash(HASH_Algorithm algorithm)
             desc = &skein1024_desc;
             break;
             
+        case  kHASH_Algorithm_BLAKE3:
+            desc = &blake3_desc;
+            break;
+            
             // want more... put more descriptors here,
         default:
             break;
@@ -293,6 +579,7 @@ S4Err Cipher_GetSize(Cipher_Algorithm  algorithm, size_t *bytesOut)
         case kCipher_Algorithm_AES192: bits = 192; break;
         case kCipher_Algorithm_AES256: bits = 256; break;
         case kCipher_Algorithm_2FISH256: bits = 256; break;
+        case kCipher_Algorithm_ChaCha20: bits = 256; break;
         case kCipher_Algorithm_3FISH256: bits = 256; break;
         case kCipher_Algorithm_3FISH512: bits = 512; break;
         case kCipher_Algorithm_3FISH1024: bits = 1024; break;
@@ -0,0 +1,280 @@
+//
+//  s4chacha.c
+//  S4
+//
+//  ChaCha20-Poly1305 authenticated encryption (RFC 8439).  The tomcrypt
+//  chacha code makes 4, 8 or 16 blocks of keystream at a time with SSE2,
+//  AVX2 or AVX-512, and poly1305 hashes four blocks at a time with AVX2.
+//  The context mirrors the GCM one: it knows which direction it is going,
+//  so the tag is written after encrypting and checked after decrypting.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#include "s4Internal.h"
+
+#define kCHACHAPOLY_KeySize         32
+
+/* a 32 bit block counter that runs from 1 to 2^32 - 2 under a 12 byte nonce */
+#define kCHACHAPOLY_MaxTextBytes    ((UINT64_C(1) << 38) - 128)
+
+typedef struct CHACHAPOLY_Context    CHACHAPOLY_Context;
+
+struct CHACHAPOLY_Context
+{
+#define kCHACHAPOLY_ContextMagic		0x43346370
+    uint32_t                magic;
+    Cipher_Algorithm        algor;
+    int                     direction;      /* CHACHA20POLY1305_ENCRYPT or _DECRYPT once text is seen, -1 before */
+    size_t                  nonceLen;
+    uint64_t                textBytes;
+    chacha20poly1305_state  state;
+};
+
+
+static bool sCHACHAPOLY_ContextIsValid( const CHACHAPOLY_ContextRef  ref)
+{
+    bool       valid	= false;
+
+    valid	= IsntNull( ref ) && ref->magic	 == kCHACHAPOLY_ContextMagic;
+
+    return( valid );
+}
+
+#define validateCHACHAPOLYContext( s )		\
+ValidateParam( sCHACHAPOLY_ContextIsValid( s ) )
+
+
+#ifdef __clang__
+#pragma mark - Utility
+#endif
+
+/* the tag comparison takes the same time wherever the first difference is */
+static bool sCHACHAPOLY_TagsMatch(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    uint8_t     diff = 0;
+    size_t      i;
+
+    for(i = 0; i < len; i++)
+        diff |= a[i] ^ b[i];
+
+    return diff == 0;
+}
+
+static S4Err sCHACHAPOLY_Process(CHACHAPOLY_ContextRef ctx,
+                                 const void *in,
+                                 size_t     bytesIn,
+                                 void       *out,
+                                 int        direction)
+{
+    S4Err       err     = kS4Err_NoErr;
+    int         status  =  CRYPT_OK;
+
+    validateCHACHAPOLYContext(ctx);
+    ValidateParam(bytesIn == 0 || (in && out));
+
+    /* one context goes one way */
+    ValidateParam(ctx->direction == -1 || ctx->direction == direction);
+    ValidateParam(ctx->nonceLen != 12 || bytesIn <= kCHACHAPOLY_MaxTextBytes - ctx->textBytes);
+
+    ctx->direction = direction;
+
+    if(direction == CHACHA20POLY1305_ENCRYPT)
+        status = chacha20poly1305_encrypt(&ctx->state, in, bytesIn, out);
+    else
+        status = chacha20poly1305_decrypt(&ctx->state, in, bytesIn, out);
+    CKSTAT;
+
+    ctx->textBytes += bytesIn;
+
+done:
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Public
+#endif
+
+S4Err CHACHAPOLY_Init(Cipher_Algorithm algorithm,
+                      const void *key,
+                      const void *nonce,
+                      size_t     nonceLen,
+                      CHACHAPOLY_ContextRef * ctxOut)
+{
+    int                     err     = kS4Err_NoErr;
+    CHACHAPOLY_Context*     cpCTX   = NULL;
+    int                     status  =  CRYPT_OK;
+
+    ValidateParam(key);
+    ValidateParam(nonce);
+    ValidateParam(nonceLen == 12 || nonceLen == 8);
+    ValidateParam(ctxOut);
+
+    if(algorithm != kCipher_Algorithm_ChaCha20)
+        RETERR(kS4Err_BadCipherNumber);
+
+    cpCTX = XMALLOC(sizeof (CHACHAPOLY_Context)); CKNULL(cpCTX);
+    ZERO(cpCTX, sizeof(CHACHAPOLY_Context));
+
+    cpCTX->magic       = kCHACHAPOLY_ContextMagic;
+    cpCTX->algor       = algorithm;
+    cpCTX->direction   = -1;
+    cpCTX->nonceLen    = nonceLen;
+
+    status = chacha20poly1305_init(&cpCTX->state, key, kCHACHAPOLY_KeySize); CKSTAT;
+    status = chacha20poly1305_setiv(&cpCTX->state, nonce, nonceLen); CKSTAT;
+
+    *ctxOut = cpCTX;
+
+done:
+
+    if(status != CRYPT_OK)
+    {
+        if(cpCTX)
+        {
+            ZERO(cpCTX, sizeof(CHACHAPOLY_Context));
+            XFREE(cpCTX);
+        }
+        err = sCrypt2S4Err(status);
+    }
+
+    return err;
+}
+
+S4Err CHACHAPOLY_AddAAD(CHACHAPOLY_ContextRef ctx,
+                        const void *	aad,
+                        size_t         aadLen)
+{
+    S4Err       err     = kS4Err_NoErr;
+    int         status  =  CRYPT_OK;
+
+    validateCHACHAPOLYContext(ctx);
+    ValidateParam(aadLen == 0 || aad);
+
+    /* the AAD all comes before the text */
+    ValidateParam(ctx->direction == -1);
+
+    status = chacha20poly1305_add_aad(&ctx->state, aad, aadLen); CKSTAT;
+
+done:
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
+S4Err CHACHAPOLY_Encrypt(CHACHAPOLY_ContextRef ctx,
+                         const void *	in,
+                         size_t         bytesIn,
+                         void *         out )
+{
+    return sCHACHAPOLY_Process(ctx, in, bytesIn, out, CHACHA20POLY1305_ENCRYPT);
+}
+
+S4Err CHACHAPOLY_Decrypt(CHACHAPOLY_ContextRef ctx,
+                         const void *	in,
+                         size_t         bytesIn,
+                         void *         out )
+{
+    return sCHACHAPOLY_Process(ctx, in, bytesIn, out, CHACHA20POLY1305_DECRYPT);
+}
+
+S4Err CHACHAPOLY_Final(CHACHAPOLY_ContextRef ctx,
+                       void *         tag,
+                       size_t         tagLen)
+{
+    S4Err           err     = kS4Err_NoErr;
+    int             status  =  CRYPT_OK;
+    uint8_t         computed[kCHACHAPOLY_TagSize];
+    unsigned long   computedLen = sizeof(computed);
+
+    validateCHACHAPOLYContext(ctx);
+    ValidateParam(tag);
+    ValidateParam(tagLen == kCHACHAPOLY_TagSize);
+
+    status = chacha20poly1305_done(&ctx->state, computed, &computedLen); CKSTAT;
+
+    if(ctx->direction == CHACHA20POLY1305_DECRYPT)
+    {
+        if(!sCHACHAPOLY_TagsMatch(computed, tag, tagLen))
+            err = kS4Err_BadIntegrity;
+    }
+    else
+        COPY(computed, tag, tagLen);
+
+done:
+
+    ZERO(computed, sizeof(computed));
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
+void CHACHAPOLY_Free(CHACHAPOLY_ContextRef  ctx)
+{
+    if(sCHACHAPOLY_ContextIsValid(ctx))
+    {
+        ZERO(ctx, sizeof(CHACHAPOLY_Context));
+        XFREE(ctx);
+    }
+}
+
+S4Err CHACHAPOLY_EncryptAEAD(Cipher_Algorithm algorithm,
+                             const void *key,
+                             const void *nonce, size_t nonceLen,
+                             const void *aad,   size_t aadLen,
+                             const void *in,    size_t bytesIn,
+                             void       *out,
+                             void       *tag,   size_t tagLen)
+{
+    S4Err                   err     = kS4Err_NoErr;
+    CHACHAPOLY_ContextRef   cp      = kInvalidCHACHAPOLY_ContextRef;
+
+    err = CHACHAPOLY_Init(algorithm, key, nonce, nonceLen, &cp); CKERR;
+    err = CHACHAPOLY_AddAAD(cp, aad, aadLen); CKERR;
+    err = CHACHAPOLY_Encrypt(cp, in, bytesIn, out); CKERR;
+    err = CHACHAPOLY_Final(cp, tag, tagLen); CKERR;
+
+done:
+
+    if(CHACHAPOLY_ContextRefIsValid(cp))
+        CHACHAPOLY_Free(cp);
+
+    return err;
+}
+
+S4Err CHACHAPOLY_DecryptAEAD(Cipher_Algorithm algorithm,
+                             const void *key,
+                             const void *nonce, size_t nonceLen,
+                             const void *aad,   size_t aadLen,
+                             const void *in,    size_t bytesIn,
+                             void       *out,
+                             const void *tag,   size_t tagLen)
+{
+    S4Err                   err     = kS4Err_NoErr;
+    CHACHAPOLY_ContextRef   cp      = kInvalidCHACHAPOLY_ContextRef;
+
+    err = CHACHAPOLY_Init(algorithm, key, nonce, nonceLen, &cp); CKERR;
+    err = CHACHAPOLY_AddAAD(cp, aad, aadLen); CKERR;
+    err = CHACHAPOLY_Decrypt(cp, in, bytesIn, out); CKERR;
+    err = CHACHAPOLY_Final(cp, (void *) tag, tagLen); CKERR;
+
+done:
+
+    /* plaintext that did not authenticate is not handed back */
+    if(IsS4Err(err) && out && bytesIn > 0)
+        ZERO(out, bytesIn);
+
+    if(CHACHAPOLY_ContextRefIsValid(cp))
+        CHACHAPOLY_Free(cp);
+
+    return err;
+}
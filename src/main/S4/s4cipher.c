@@ -13,6 +13,106 @@
 #pragma mark - EBC Symmetric Crypto
 #endif
 
+typedef struct ECB_Context    ECB_Context;
+
+struct ECB_Context
+{
+#define kECB_ContextMagic		0x43346562
+    uint32_t            magic;
+    Cipher_Algorithm    algor;
+    symmetric_ECB       state;
+};
+
+
+static bool sECB_ContextIsValid( const ECB_ContextRef  ref)
+{
+    bool       valid	= false;
+    
+    valid	= IsntNull( ref ) && ref->magic	 == kECB_ContextMagic;
+    
+    return( valid );
+}
+
+#define validateECBContext( s )		\
+ValidateParam( sECB_ContextIsValid( s ) )
+
+
+S4Err ECB_Init(Cipher_Algorithm algorithm,
+               const void *key,
+               ECB_ContextRef * ctxOut)
+{
+    int             err     = kS4Err_NoErr;
+    ECB_Context*    ecbCTX  = NULL;
+    int             keylen  = 0;
+    int             cipher  = -1;
+    int             status  =  CRYPT_OK;
+    
+    ValidateParam(key);
+    ValidateParam(ctxOut);
+    
+    err = sCipherForAlgorithm(algorithm, &cipher, &keylen); CKERR;
+    
+    ecbCTX = XMALLOC(sizeof (ECB_Context)); CKNULL(ecbCTX);
+    ZERO(ecbCTX, sizeof(ECB_Context));
+    
+    ecbCTX->magic = kECB_ContextMagic;
+    ecbCTX->algor = algorithm;
+    
+    status = ecb_start(cipher, key, keylen, 0, &ecbCTX->state); CKSTAT;
+    
+    *ctxOut = ecbCTX;
+    
+done:
+    
+    if(status != CRYPT_OK)
+    {
+        if(ecbCTX)
+        {
+            ZERO(ecbCTX, sizeof(ECB_Context));
+            XFREE(ecbCTX);
+        }
+        err = sCrypt2S4Err(status);
+    }
+    
+    return err;
+}
+
+S4Err ECB_Process(ECB_ContextRef ctx,
+                  bool           encrypt,
+                  const void *	in,
+                  size_t         bytesIn,
+                  void *         out )
+{
+    S4Err           err = kS4Err_NoErr;
+    int             status  =  CRYPT_OK;
+    
+    validateECBContext(ctx);
+    ValidateParam(bytesIn == 0 || (in && out));
+    
+    if(bytesIn == 0)
+        goto done;
+    
+    if(encrypt)
+        status = ecb_encrypt(in, out, bytesIn, &ctx->state);
+    else
+        status = ecb_decrypt(in, out, bytesIn, &ctx->state);
+    
+    err = sCrypt2S4Err(status);
+    
+done:
+    return (err);
+}
+
+void ECB_Free(ECB_ContextRef  ctx)
+{
+    if(sECB_ContextIsValid(ctx))
+    {
+        ecb_done(&ctx->state);
+        ZERO(ctx, sizeof(ECB_Context));
+        XFREE(ctx);
+    }
+}
+
 S4Err ECB_Encrypt(Cipher_Algorithm algorithm,
                   const void *	key,
                   const void *	in,
@@ -26,31 +126,9 @@ S4Err ECB_Encrypt(Cipher_Algorithm algorithm,
     int             keylen  = 0;
     int             cipher  = -1;
     
-    switch(algorithm)
-    {
-        case kCipher_Algorithm_AES128:
-            keylen = 128 >> 3;
-            cipher = find_cipher("aes");
-            
-            break;
-        case kCipher_Algorithm_AES192:
-            keylen = 192 >> 3;
-            cipher = find_cipher("aes");
-            
-            break;
-        case kCipher_Algorithm_AES256:
-            keylen = 256 >> 3;
-            cipher = find_cipher("aes");
-            break;
-            
-        case kCipher_Algorithm_2FISH256:
-            keylen = 256 >> 3;
-            cipher = find_cipher("twofish");
-            break;
-            
-        default:
-            RETERR(kS4Err_BadCipherNumber);
-    }
+    ECB.cipher = -1;
+    
+    err = sCipherForAlgorithm(algorithm, &cipher, &keylen); CKERR;
     
     status  = ecb_start(cipher, key, keylen, 0, &ECB ); CKSTAT;
     
@@ -60,6 +138,7 @@ S4Err ECB_Encrypt(Cipher_Algorithm algorithm,
 done:
     
     ecb_done(&ECB);
+    ZERO(&ECB, sizeof(ECB));
     
     if(status != CRYPT_OK)
         err = sCrypt2S4Err(status);
@@ -82,31 +161,9 @@ S4Err ECB_Decrypt(Cipher_Algorithm algorithm,
     int             keylen  = 0;
     int             cipher  = -1;
     
-    switch(algorithm)
-    {
-        case kCipher_Algorithm_AES128:
-            keylen = 128 >> 3;
-            cipher = find_cipher("aes");
-            
-            break;
-        case kCipher_Algorithm_AES192:
-            keylen = 192 >> 3;
-            cipher = find_cipher("aes");
-            
-            break;
-        case kCipher_Algorithm_AES256:
-            keylen = 256 >> 3;
-            cipher = find_cipher("aes");
-            break;
-            
-        case kCipher_Algorithm_2FISH256:
-            keylen = 256 >> 3;
-            cipher = find_cipher("twofish");
-            break;
-            
-        default:
-            RETERR(kS4Err_BadCipherNumber);
-    }
+    ECB.cipher = -1;
+    
+    err = sCipherForAlgorithm(algorithm, &cipher, &keylen); CKERR;
     
     status  = ecb_start(cipher, key, keylen, 0, &ECB ); CKSTAT;
     
@@ -116,6 +173,7 @@ S4Err ECB_Decrypt(Cipher_Algorithm algorithm,
 done:
     
     ecb_done(&ECB);
+    ZERO(&ECB, sizeof(ECB));
     
     if(status != CRYPT_OK)
         err = sCrypt2S4Err(status);
@@ -170,31 +228,7 @@ S4Err CBC_Init(Cipher_Algorithm algorithm,
     
     ValidateParam(ctxOut);
     
-    switch(algorithm)
-    {
-        case kCipher_Algorithm_AES128:
-            keylen = 128 >> 3;
-            cipher = find_cipher("aes");
-            
-            break;
-        case kCipher_Algorithm_AES192:
-            keylen = 192 >> 3;
-            cipher = find_cipher("aes");
-            
-            break;
-        case kCipher_Algorithm_AES256:
-            keylen = 256 >> 3;
-            cipher = find_cipher("aes");
-            break;
-            
-        case kCipher_Algorithm_2FISH256:
-            keylen = 256 >> 3;
-            cipher = find_cipher("twofish");
-            break;
-            
-        default:
-            RETERR(kS4Err_BadCipherNumber);
-    }
+    err = sCipherForAlgorithm(algorithm, &cipher, &keylen); CKERR;
     
     
     cbcCTX = XMALLOC(sizeof (CBC_Context)); CKNULL(cbcCTX);
@@ -271,6 +305,73 @@ void CBC_Free(CBC_ContextRef  ctx)
 }
 
 
+/* the CBC states of CBC_EncryptMulti are scheduled this many at a time */
+#define kCBC_MultiGroup     64
+
+S4Err CBC_EncryptMulti(Cipher_Algorithm     algorithm,
+                       size_t               count,
+                       const void           *key[],
+                       const void           *iv[],
+                       const void           *in[],
+                       const size_t         inlen[],
+                       void                 *out[])
+{
+    S4Err           err     = kS4Err_NoErr;
+    int             status  =  CRYPT_OK;
+    int             keylen  = 0;
+    int             cipher  = -1;
+    symmetric_CBC   *state  = NULL;
+    symmetric_CBC   *cbc[kCBC_MultiGroup];
+    const unsigned char *src[kCBC_MultiGroup];
+    unsigned char   *dst[kCBC_MultiGroup];
+    unsigned long   len[kCBC_MultiGroup];
+    size_t          group, i, n = 0;
+
+    ValidateParam(count == 0 || (key && iv && in && inlen && out));
+
+    err = sCipherForAlgorithm(algorithm, &cipher, &keylen); CKERR;
+
+    for(i = 0; i < count; i++)
+    {
+        ValidateParam(key[i] && iv[i]);
+        ValidateParam(inlen[i] == 0 || (in[i] && out[i]));
+    }
+
+    if(count == 0)
+        goto done;
+
+    state = XMALLOC(MIN(count, kCBC_MultiGroup) * sizeof(symmetric_CBC)); CKNULL(state);
+
+    for(group = 0; group < count; group += n)
+    {
+        n = MIN(count - group, kCBC_MultiGroup);
+
+        for(i = 0; i < n; i++)
+        {
+            status = cbc_start(cipher, iv[group + i], key[group + i], keylen, 0, &state[i]); CKSTAT;
+            cbc[i] = &state[i];
+            src[i] = in[group + i];
+            dst[i] = out[group + i];
+            len[i] = inlen[group + i];
+        }
+
+        status = cbc_encrypt_multi(cbc, src, dst, len, n); CKSTAT;
+    }
+
+done:
+
+    if(state)
+    {
+        ZERO(state, MIN(count, kCBC_MultiGroup) * sizeof(symmetric_CBC));
+        XFREE(state);
+    }
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
 
 #define MIN_MSG_BLOCKSIZE   32
 #define MSG_BLOCKSIZE   16
@@ -0,0 +1,45 @@
+//
+//  s4cpu.h
+//  S4
+//
+//  CPU features used to pick the SIMD backends.  Internal to the library, not exported.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#ifndef s4cpu_h
+#define s4cpu_h
+
+#include <stdint.h>
+#include "s4pubtypes.h"
+
+enum
+{
+    kS4CPU_SSE2         = 1 << 0,
+    kS4CPU_SSSE3        = 1 << 1,
+    kS4CPU_SSE41        = 1 << 2,
+    kS4CPU_AVX          = 1 << 3,
+    kS4CPU_AVX2         = 1 << 4,
+    kS4CPU_AVX512F      = 1 << 5,
+    kS4CPU_AVX512VL     = 1 << 6,
+    kS4CPU_AVX512BW     = 1 << 7,
+    kS4CPU_AES          = 1 << 8,
+    kS4CPU_PCLMUL       = 1 << 9,
+    kS4CPU_SHA          = 1 << 10,
+    kS4CPU_BMI2         = 1 << 11,
+    kS4CPU_MUL128       = 1 << 12,      /* 64x64 to 128 bit products, from the compiler not CPUID */
+};
+
+#define kS4CPU_All          UINT32_MAX
+
+/* the kS4CPU_ features, detected once and limited by sCPU_SetMask */
+uint32_t sCPU_Features(void);
+
+#define sCPU_Has(_f_)   (((sCPU_Features()) & (_f_)) == (_f_))
+
+/* pick the backends again as if the CPU only had the features in mask, kS4CPU_All
+ undoes it.  A test hook so optest can run every SIMD kernel on one machine: it swaps
+ the global backends, so no other thread may be in S4 while it runs */
+S4Err sCPU_SetMask(uint32_t mask);
+
+#endif /* s4cpu_h */
@@ -71,7 +71,8 @@ typedef struct HASH_Context *      HASH_ContextRef;
 
 #define HASH_ContextRefIsValid( ref )		( (ref) != kInvalidHASH_ContextRef )
 
-#define kHASH_ContextAllocSize 512
+/* big enough for any context HASH_InitInPlace can build, whatever the buffer alignment */
+#define kHASH_ContextAllocSize 768
 
 
 enum HASH_Algorithm_
@@ -86,10 +87,15 @@ enum HASH_Algorithm_
     kHASH_Algorithm_SKEIN512        = 8,
     kHASH_Algorithm_SKEIN1024       = 9,
     kHASH_Algorithm_SHA512_256      = 10,
+    kHASH_Algorithm_SKEIN512_TREE   = 11,
+    kHASH_Algorithm_SKEIN1024_TREE  = 12,
+    kHASH_Algorithm_BLAKE3          = 13,
 
 #if _USES_XXHASH_
     kHASH_Algorithm_xxHash32        = 20,
     kHASH_Algorithm_xxHash64        = 21,
+    kHASH_Algorithm_xxHash3_64      = 22,
+    kHASH_Algorithm_xxHash128       = 23,
 #endif
     
     kHASH_Algorithm_Invalid           =  kEnumMaxValue,
@@ -102,19 +108,89 @@ ENUM_TYPEDEF( HASH_Algorithm_, HASH_Algorithm   );
 
 S4Err HASH_Init(HASH_Algorithm algorithm, HASH_ContextRef * ctx);
 
+/* xxHash algorithms only.  HASH_Init seeds xxHash32/64 with 2654435761 and XXH3 with 0.
+ xxHash digests are the hash value in host byte order */
+S4Err HASH_InitWithSeed(HASH_Algorithm algorithm, uint64_t seed, HASH_ContextRef * ctx);
+
+/* Skein tree hashing, for kHASH_Algorithm_SKEIN512_TREE and kHASH_Algorithm_SKEIN1024_TREE.
+ leaves are (state size << leafSizeExp) bytes, each node combines (1 << fanOutExp) children,
+ and the tree is at most maxHeight levels high.  Leaves are hashed on threadCount threads,
+ 0 for one per CPU; the digest does not depend on the thread count.
+ leafSizeExp is at most kHASH_SkeinTree_MaxLeafSizeExp, since each thread buffers two leaves
+ (2 MB leaves for SKEIN1024 at the limit).
+ HASH_Init uses the defaults below.  Tree contexts can not be exported. */
+
+#define kHASH_SkeinTree_LeafSizeExp     10
+#define kHASH_SkeinTree_MaxLeafSizeExp  14
+#define kHASH_SkeinTree_FanOutExp       8
+#define kHASH_SkeinTree_MaxHeight       0xFF
+
+S4Err HASH_InitSkeinTree(HASH_Algorithm algorithm,
+                         uint8_t        leafSizeExp,
+                         uint8_t        fanOutExp,
+                         uint8_t        maxHeight,
+                         uint32_t       threadCount,
+                         HASH_ContextRef * ctx);
+
+/* build the context in buffer instead of on the heap,  bufSize of kHASH_ContextAllocSize always fits.
+ HASH_Free wipes it but leaves the memory to the caller.  Not for the tree hashes */
+S4Err HASH_InitInPlace(HASH_Algorithm algorithm, void *buffer, size_t bufSize, HASH_ContextRef * ctx);
+
+/* start a new message with the same algorithm, seed and output size */
+S4Err HASH_Reset(HASH_ContextRef ctx);
+
+/* several digests of the same data in one pass.  HASH_Update feeds each member a cache sized
+ block at a time, HASH_Final writes the digests one after the other in the order given and
+ HASH_GetSize reports their total.  Multi contexts can not be exported */
+
+#define kHASH_Multi_MaxCount    8
+
+S4Err HASH_MultiInit(const HASH_Algorithm algorithms[], size_t count, HASH_ContextRef * ctx);
+
 S4Err HASH_Update(HASH_ContextRef ctx, const void *data, size_t dataLength);
 
 S4Err HASH_Final(HASH_ContextRef  ctx, void *hashOut);
 
 S4Err HASH_GetSize(HASH_ContextRef  ctx, size_t *hashSize);
 
+/* kHASH_Algorithm_BLAKE3 is extendable, HASH_Final writes hashSize bytes (32 by default).
+ set it before HASH_Final;  HASH_DO uses outLen */
+S4Err HASH_SetOutputSize(HASH_ContextRef  ctx, size_t hashSize);
+
 void HASH_Free(HASH_ContextRef  ctx);
 
+/* checkpoint a hash in progress.  The export holds the chaining value, length and
+   unprocessed input in a versioned little endian encoding, not the context itself,
+   so it can be imported by another process or library version.  It is at most
+   kHASH_ExportMaxSize bytes, and usually much less (SHA-256 needs 43 plus the
+   partial block).  Skein tree and HASH_MultiInit contexts can not be exported. */
+#define kHASH_ExportMaxSize     1880
+
 S4Err HASH_Export(HASH_ContextRef ctx, void *outData, size_t bufSize, size_t *datSize);
 S4Err HASH_Import(void *inData, size_t bufSize, HASH_ContextRef * ctx);
 
 S4Err HASH_DO(HASH_Algorithm algorithm, const unsigned char *in, unsigned long inlen, unsigned long outLen, uint8_t *out);
 
+/* one shot seeded xxHash, like HASH_DO it does not allocate a context for xxHash algorithms */
+S4Err HASH_DOWithSeed(HASH_Algorithm algorithm, uint64_t seed,
+                      const unsigned char *in, unsigned long inlen, unsigned long outLen, uint8_t *out);
+
+/* hash the contents of the file at path.  Regular files are memory mapped and read ahead
+ while they are hashed, pipes and devices are read on a background thread.  A regular file
+ truncated by another process while it is hashed fails with kS4Err_CorruptData, or raises
+ SIGBUS if it shrinks under the window being hashed */
+S4Err HASH_File(HASH_Algorithm algorithm, const char *path, unsigned long outLen, uint8_t *out);
+
+/* hash count independent messages,  in[i] of inlen[i] bytes into out[i].
+ SHA-2 and Skein-256/512 messages are hashed several at a time in SIMD lanes when the CPU allows it */
+
+S4Err HASH_DOBatch(HASH_Algorithm       algorithm,
+                   size_t               count,
+                   const unsigned char  *in[],
+                   const unsigned long  inlen[],
+                   unsigned long        outLen,
+                   uint8_t              *out[]);
+
 #ifdef __clang__
 #pragma mark - Message  Authentication Code wrappers
 #endif
@@ -138,12 +214,26 @@ typedef struct MAC_Context *      MAC_ContextRef;
 
 #define MAC_ContextRefIsValid( ref )		( (ref) != kInvalidMAC_ContextRef )
 
+#define kMAC_ContextAllocSize 1344
+
 S4Err MAC_Init(MAC_Algorithm     mac,
                   HASH_Algorithm    hash,
                   const void        *macKey,
                   size_t            macKeyLen,
                   MAC_ContextRef    *ctx);
 
+/* like HASH_InitInPlace,  bufSize of kMAC_ContextAllocSize always fits */
+S4Err MAC_InitInPlace(MAC_Algorithm     mac,
+                      HASH_Algorithm    hash,
+                      const void        *macKey,
+                      size_t            macKeyLen,
+                      void              *buffer,
+                      size_t            bufSize,
+                      MAC_ContextRef    *ctx);
+
+/* start a new message under the same key, without going through the key setup again */
+S4Err MAC_Reset(MAC_ContextRef  ctx);
+
 S4Err MAC_Update(MAC_ContextRef  ctx,
                     const void      *data,
                     size_t          dataLength);
@@ -168,6 +258,28 @@ S4Err  MAC_KDF(MAC_Algorithm     mac,
                          unsigned long   outLen,
                          uint8_t         *out);
 
+/* MAC the contents of the file at path, read the same way as HASH_File */
+S4Err MAC_File(MAC_Algorithm        mac,
+               HASH_Algorithm       hash,
+               const void           *macKey,
+               size_t               macKeyLen,
+               const char           *path,
+               unsigned long        outLen,
+               uint8_t              *out);
+
+/* MAC count independent messages with the same key,  in[i] of inlen[i] bytes into out[i].
+ Skein-MAC runs four messages at a time in SIMD lanes when the CPU allows it */
+
+S4Err MAC_DOBatch(MAC_Algorithm        mac,
+                  HASH_Algorithm       hash,
+                  const void           *macKey,
+                  size_t               macKeyLen,
+                  size_t               count,
+                  const unsigned char  *in[],
+                  const unsigned long  inlen[],
+                  unsigned long        outLen,
+                  uint8_t              *out[]);
+
 
 #ifdef __clang__
 #pragma mark - Cipher function wrappers
@@ -179,6 +291,7 @@ enum Cipher_Algorithm_
     kCipher_Algorithm_AES192         = 2,
     kCipher_Algorithm_AES256         = 3,
     kCipher_Algorithm_2FISH256       = 4,
+    kCipher_Algorithm_ChaCha20       = 5,
   
     
     kCipher_Algorithm_3FISH256      = 100,
@@ -212,6 +325,27 @@ S4Err ECB_Decrypt(Cipher_Algorithm algorithm,
                   size_t         bytesIn,
                   void *         out );
 
+typedef struct ECB_Context *      ECB_ContextRef;
+
+#define	kInvalidECB_ContextRef		((ECB_ContextRef) NULL)
+
+#define ECB_ContextRefIsValid( ref )		( (ref) != kInvalidECB_ContextRef )
+
+/* ECB with the key schedule expanded once, for a key that wraps or unwraps many others.
+ ECB_Encrypt and ECB_Decrypt expand the key on every call */
+
+S4Err ECB_Init(Cipher_Algorithm algorithm,
+               const void *key,
+               ECB_ContextRef * ctxOut);
+
+S4Err ECB_Process(ECB_ContextRef ctx,
+                  bool           encrypt,
+                  const void *	in,
+                  size_t         bytesIn,
+                  void *         out );
+
+void ECB_Free(ECB_ContextRef  ctx);
+
 typedef struct CBC_Context *      CBC_ContextRef;
 
 #define	kInvalidCBC_ContextRef		((CBC_ContextRef) NULL)
@@ -236,6 +370,18 @@ S4Err CBC_Decrypt(CBC_ContextRef ctx,
 
 void CBC_Free(CBC_ContextRef  ctx);
 
+/* CBC encrypt count independent messages, each under its own key[i] and iv[i],  in[i] of inlen[i]
+ bytes (a multiple of the block size) into out[i].  One CBC chain keeps a single block in the
+ cipher, so with AES-NI up to 8 of the messages run side by side */
+
+S4Err CBC_EncryptMulti(Cipher_Algorithm     algorithm,
+                       size_t               count,
+                       const void           *key[],
+                       const void           *iv[],
+                       const void           *in[],
+                       const size_t         inlen[],
+                       void                 *out[]);
+
 /* higher level CBC encode/decod with padding */
 
 S4Err CBC_EncryptPAD(Cipher_Algorithm algorithm,
@@ -253,6 +399,273 @@ S4Err CBC_DecryptPAD(Cipher_Algorithm algorithm,
                      uint8_t **outData, size_t *outSize);
 
 
+typedef struct CTR_Context *      CTR_ContextRef;
+
+#define	kInvalidCTR_ContextRef		((CTR_ContextRef) NULL)
+
+#define CTR_ContextRefIsValid( ref )		( (ref) != kInvalidCTR_ContextRef )
+
+/* counter mode, the iv is the first counter block and is incremented as a 128 bit big endian number.
+ With kCipher_Algorithm_3FISH256/512/1024 the 16 byte iv and zeros fill every block and the block
+ number goes in the tweak instead, the key being the Threefish key.
+ Updates above a few MB are split across threadCount threads, 0 for one per CPU */
+
+S4Err CTR_Init(Cipher_Algorithm algorithm,
+               const void *key,
+               const void *iv,
+               uint32_t   threadCount,
+               CTR_ContextRef * ctxOut);
+
+/* encrypts and decrypts, in and out may be the same buffer */
+S4Err CTR_Update(CTR_ContextRef ctx,
+                 const void *	in,
+                 size_t         bytesIn,
+                 void *         out );
+
+/* continue at byte offset in the stream, without generating the keystream before it */
+S4Err CTR_Seek(CTR_ContextRef ctx,
+               uint64_t       offset);
+
+void CTR_Free(CTR_ContextRef  ctx);
+
+typedef struct GCM_Context *      GCM_ContextRef;
+
+#define	kInvalidGCM_ContextRef		((GCM_ContextRef) NULL)
+
+#define GCM_ContextRefIsValid( ref )		( (ref) != kInvalidGCM_ContextRef )
+
+/* Galois/Counter mode authenticated encryption with AES or 2FISH.  A 12 byte iv is used
+ as is, other lengths are hashed.  AAD is added before any text, and a context either
+ encrypts or decrypts.  GCM_Final writes the tag after encrypting and checks it after
+ decrypting, returning kS4Err_BadIntegrity when it does not match */
+
+S4Err GCM_Init(Cipher_Algorithm algorithm,
+               const void *key,
+               const void *iv,
+               size_t     ivLen,
+               GCM_ContextRef * ctxOut);
+
+/* how a context keeps H.  The 64KB tables are the fastest without PCLMULQDQ, the 4 bit
+ table takes 256 bytes and suits many contexts alive at once.  PCLMUL needs only the
+ powers of H and is there when the CPU has it.  The default is PCLMUL when it is there
+ and the 64KB tables when not */
+
+enum GCM_Layout_
+{
+    kGCM_Layout_Default             = 0,
+    kGCM_Layout_Tables64K           = 1,
+    kGCM_Layout_Table4Bit           = 2,
+    kGCM_Layout_PCLMUL              = 3,
+
+    kGCM_Layout_Invalid             =  kEnumMaxValue,
+
+    ENUM_FORCE( GCM_Layout_ )
+};
+
+ENUM_TYPEDEF( GCM_Layout_, GCM_Layout   );
+
+/* a context only allocates what its layout uses */
+S4Err GCM_InitWithLayout(Cipher_Algorithm algorithm,
+                         const void *key,
+                         const void *iv,
+                         size_t     ivLen,
+                         GCM_Layout layout,
+                         GCM_ContextRef * ctxOut);
+
+S4Err GCM_AddAAD(GCM_ContextRef ctx,
+                 const void *	aad,
+                 size_t         aadLen);
+
+/* in and out may be the same buffer */
+S4Err GCM_Encrypt(GCM_ContextRef ctx,
+                  const void *	in,
+                  size_t         bytesIn,
+                  void *         out );
+
+S4Err GCM_Decrypt(GCM_ContextRef ctx,
+                  const void *	in,
+                  size_t         bytesIn,
+                  void *         out );
+
+/* tagLen is 4 to 16 bytes */
+S4Err GCM_Final(GCM_ContextRef ctx,
+                void *         tag,
+                size_t         tagLen);
+
+void GCM_Free(GCM_ContextRef  ctx);
+
+/* one shot, GCM_DecryptAEAD zeroes out when the tag does not match */
+
+S4Err GCM_EncryptAEAD(Cipher_Algorithm algorithm,
+                      const void *key,
+                      const void *iv,   size_t ivLen,
+                      const void *aad,  size_t aadLen,
+                      const void *in,   size_t bytesIn,
+                      void       *out,
+                      void       *tag,  size_t tagLen);
+
+S4Err GCM_DecryptAEAD(Cipher_Algorithm algorithm,
+                      const void *key,
+                      const void *iv,   size_t ivLen,
+                      const void *aad,  size_t aadLen,
+                      const void *in,   size_t bytesIn,
+                      void       *out,
+                      const void *tag,  size_t tagLen);
+
+typedef struct CHACHAPOLY_Context *      CHACHAPOLY_ContextRef;
+
+#define	kInvalidCHACHAPOLY_ContextRef		((CHACHAPOLY_ContextRef) NULL)
+
+#define CHACHAPOLY_ContextRefIsValid( ref )		( (ref) != kInvalidCHACHAPOLY_ContextRef )
+
+#define kCHACHAPOLY_TagSize     16
+
+/* ChaCha20-Poly1305 authenticated encryption (RFC 8439) with kCipher_Algorithm_ChaCha20
+ and a 32 byte key.  The nonce is 12 bytes, or 8 for the original 64 bit nonce and counter.
+ It is used the same way as GCM: AAD first, one direction per context, and CHACHAPOLY_Final
+ writes the 16 byte tag after encrypting and checks it after decrypting */
+
+S4Err CHACHAPOLY_Init(Cipher_Algorithm algorithm,
+                      const void *key,
+                      const void *nonce,
+                      size_t     nonceLen,
+                      CHACHAPOLY_ContextRef * ctxOut);
+
+S4Err CHACHAPOLY_AddAAD(CHACHAPOLY_ContextRef ctx,
+                        const void *	aad,
+                        size_t         aadLen);
+
+/* in and out may be the same buffer */
+S4Err CHACHAPOLY_Encrypt(CHACHAPOLY_ContextRef ctx,
+                         const void *	in,
+                         size_t         bytesIn,
+                         void *         out );
+
+S4Err CHACHAPOLY_Decrypt(CHACHAPOLY_ContextRef ctx,
+                         const void *	in,
+                         size_t         bytesIn,
+                         void *         out );
+
+/* tagLen is kCHACHAPOLY_TagSize */
+S4Err CHACHAPOLY_Final(CHACHAPOLY_ContextRef ctx,
+                       void *         tag,
+                       size_t         tagLen);
+
+void CHACHAPOLY_Free(CHACHAPOLY_ContextRef  ctx);
+
+/* one shot, CHACHAPOLY_DecryptAEAD zeroes out when the tag does not match */
+
+S4Err CHACHAPOLY_EncryptAEAD(Cipher_Algorithm algorithm,
+                             const void *key,
+                             const void *nonce, size_t nonceLen,
+                             const void *aad,   size_t aadLen,
+                             const void *in,    size_t bytesIn,
+                             void       *out,
+                             void       *tag,   size_t tagLen);
+
+S4Err CHACHAPOLY_DecryptAEAD(Cipher_Algorithm algorithm,
+                             const void *key,
+                             const void *nonce, size_t nonceLen,
+                             const void *aad,   size_t aadLen,
+                             const void *in,    size_t bytesIn,
+                             void       *out,
+                             const void *tag,   size_t tagLen);
+
+typedef struct OCB_Context *      OCB_ContextRef;
+
+#define	kInvalidOCB_ContextRef		((OCB_ContextRef) NULL)
+
+#define OCB_ContextRefIsValid( ref )		( (ref) != kInvalidOCB_ContextRef )
+
+/* OCB3 authenticated encryption (RFC 7253) with AES or 2FISH.  The nonce is 1 to 15 bytes
+ and the tag 1 to 16, both fixed at init.  It is used the same way as GCM: AAD first, one
+ direction per context, and OCB_Final writes the tag after encrypting and checks it after
+ decrypting.  Every OCB_Encrypt or OCB_Decrypt but the last takes a multiple of 16 bytes */
+
+S4Err OCB_Init(Cipher_Algorithm algorithm,
+               const void *key,
+               const void *nonce,
+               size_t     nonceLen,
+               size_t     tagLen,
+               OCB_ContextRef * ctxOut);
+
+S4Err OCB_AddAAD(OCB_ContextRef ctx,
+                 const void *	aad,
+                 size_t         aadLen);
+
+/* in and out may be the same buffer */
+S4Err OCB_Encrypt(OCB_ContextRef ctx,
+                  const void *	in,
+                  size_t         bytesIn,
+                  void *         out );
+
+S4Err OCB_Decrypt(OCB_ContextRef ctx,
+                  const void *	in,
+                  size_t         bytesIn,
+                  void *         out );
+
+/* tagLen is the one given to OCB_Init */
+S4Err OCB_Final(OCB_ContextRef ctx,
+                void *         tag,
+                size_t         tagLen);
+
+void OCB_Free(OCB_ContextRef  ctx);
+
+/* one shot, OCB_DecryptAEAD zeroes out when the tag does not match */
+
+S4Err OCB_EncryptAEAD(Cipher_Algorithm algorithm,
+                      const void *key,
+                      const void *nonce, size_t nonceLen,
+                      const void *aad,   size_t aadLen,
+                      const void *in,    size_t bytesIn,
+                      void       *out,
+                      void       *tag,   size_t tagLen);
+
+S4Err OCB_DecryptAEAD(Cipher_Algorithm algorithm,
+                      const void *key,
+                      const void *nonce, size_t nonceLen,
+                      const void *aad,   size_t aadLen,
+                      const void *in,    size_t bytesIn,
+                      void       *out,
+                      const void *tag,   size_t tagLen);
+
+typedef struct XTS_Context *      XTS_ContextRef;
+
+#define	kInvalidXTS_ContextRef		((XTS_ContextRef) NULL)
+
+#define XTS_ContextRefIsValid( ref )		( (ref) != kInvalidXTS_ContextRef )
+
+/* one sector for XTS_EncryptSectors and XTS_DecryptSectors, out may be in */
+typedef struct XTS_Sector
+{
+    uint64_t        sector;         /* the tweak, as a 128 bit little endian number */
+    const void      *in;
+    void            *out;
+} XTS_Sector;
+
+/* XTS (IEEE 1619) for disk sectors and database pages, with AES or 2FISH.  key is the data
+ key followed by the tweak key, twice the cipher key size, and the two have to differ.  Every
+ sector is sectorSize bytes, at least 16 and not necessarily whole blocks.  A call takes
+ any number of sectors in any order, arrays above a few MB are split across threadCount
+ threads, 0 for one per CPU */
+
+S4Err XTS_Init(Cipher_Algorithm algorithm,
+               const void *key,
+               size_t     sectorSize,
+               uint32_t   threadCount,
+               XTS_ContextRef * ctxOut);
+
+S4Err XTS_EncryptSectors(XTS_ContextRef ctx,
+                         const XTS_Sector *sectors,
+                         size_t         count);
+
+S4Err XTS_DecryptSectors(XTS_ContextRef ctx,
+                         const XTS_Sector *sectors,
+                         size_t         count);
+
+void XTS_Free(XTS_ContextRef  ctx);
+
+
 #ifdef __clang__
 #pragma mark -  tweakable block cipher functions
 #endif
@@ -280,6 +693,25 @@ S4Err TBC_Decrypt(TBC_ContextRef ctx,
                   const void *	in,
                   void *         out );
 
+/* many blocks, each with its own tweek, in one call.  The tweek is the 16 bytes
+ TBC_SetTweek takes, out may be in, and the tweek set on the context is left alone.
+ With AVX2 four blocks go through Threefish side by side */
+
+typedef struct TBC_Block
+{
+    const void      *tweek;
+    const void      *in;
+    void            *out;
+} TBC_Block;
+
+S4Err TBC_EncryptBlocks(TBC_ContextRef ctx,
+                        const TBC_Block *blocks,
+                        size_t         count);
+
+S4Err TBC_DecryptBlocks(TBC_ContextRef ctx,
+                        const TBC_Block *blocks,
+                        size_t         count);
+
 void TBC_Free(TBC_ContextRef  ctx);
 
 
@@ -0,0 +1,464 @@
+//
+//  s4CTR.c
+//  S4
+//
+//  Counter mode.  The counter for block n is the IV plus n as a 128 bit big
+//  endian number, so any block of keystream can be made without the ones
+//  before it.  That gives seeking for free, and lets large buffers be cut
+//  into slices that are encrypted on several threads.  Short updates are
+//  served from a buffer of keystream generated a few KB ahead, so the
+//  cipher always runs on whole batches of blocks.
+//
+//  Threefish keys run the same way with their own, larger blocks.  The IV is
+//  the plaintext of every block and the block number goes in the tweak, as
+//  the first 8 bytes in little endian order followed by 8 zero bytes, so
+//  each block of keystream is the IV under a tweak of its own, and the
+//  blocks go through TBC_EncryptBlocks four at a time.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#include "s4Internal.h"
+
+#define kCTR_BlockSize          16
+
+/* Threefish-1024 */
+#define kCTR_MaxBlockSize       128
+
+/* keystream generated ahead for updates that are not a multiple of the block size */
+#define kCTR_AheadBytes         4096
+
+/* the 16 byte Threefish tweak, block number first */
+#define kCTR_TweekBytes         16
+
+/* counter blocks encrypted together by ciphers without a CTR accelerator */
+#define kCTR_BatchBlocks        64
+
+typedef struct CTR_Context    CTR_Context;
+
+struct CTR_Context
+{
+#define kCTR_ContextMagic		0x43346374
+    uint32_t            magic;
+    Cipher_Algorithm    algor;
+    int                 cipher;
+    uint32_t            threadCount;
+    symmetric_key       key;
+    TBC_ContextRef      tbc;                        /* Threefish instead of the tomcrypt cipher */
+    size_t              blockSize;
+
+    uint8_t             iv[kCTR_MaxBlockSize];
+    uint64_t            block;                      /* next block to generate, counted from the IV */
+
+    uint8_t             ahead[kCTR_AheadBytes];     /* keystream for the blocks just before block */
+    size_t              aheadLen;
+    size_t              aheadUsed;
+};
+
+typedef struct
+{
+    const CTR_Context   *ctx;
+    const uint8_t       *in;
+    uint8_t             *out;
+} sCTR_Buffer;
+
+
+static bool sCTR_ContextIsValid( const CTR_ContextRef  ref)
+{
+    bool       valid	= false;
+
+    valid	= IsntNull( ref ) && ref->magic	 == kCTR_ContextMagic;
+
+    return( valid );
+}
+
+#define validateCTRContext( s )		\
+ValidateParam( sCTR_ContextIsValid( s ) )
+
+
+#ifdef __clang__
+#pragma mark - Keystream
+#endif
+
+/* the counter block for block number n */
+
+static void sCTR_Counter(const CTR_Context *ctx, uint64_t n, uint8_t *ctr)
+{
+    unsigned    carry = 0;
+    int         i;
+
+    for(i = kCTR_BlockSize - 1; i >= 0; i--)
+    {
+        carry   += ctx->iv[i] + (unsigned)(n & 0xFF);
+        ctr[i]   = (uint8_t) carry;
+        carry  >>= 8;
+        n      >>= 8;
+    }
+}
+
+/* out = in ^ pad, a word at a time */
+
+static void sCTR_XOR(const uint8_t *in, const uint8_t *pad, uint8_t *out, size_t len)
+{
+    uint64_t    a, b;
+    size_t      i = 0;
+
+    for(; i + 8 <= len; i += 8)
+    {
+        memcpy(&a, in + i, 8);
+        memcpy(&b, pad + i, 8);
+        a ^= b;
+        memcpy(out + i, &a, 8);
+    }
+
+    for(; i < len; i++)
+        out[i] = in[i] ^ pad[i];
+}
+
+static void sCTR_Increment(uint8_t *ctr)
+{
+    int i;
+
+    for(i = kCTR_BlockSize - 1; i >= 0; i--)
+        if(++ctr[i] != 0)
+            break;
+}
+
+/* the Threefish keystream, block n is the IV encrypted with n, little endian, as the tweak */
+
+static S4Err sCTR_CryptTBC(const CTR_Context *ctx, uint64_t n, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    uint8_t     pad[kCTR_BatchBlocks * kCTR_BlockSize];
+    uint8_t     tweek[kCTR_BatchBlocks * kCTR_TweekBytes];
+    TBC_Block   tbcBlocks[kCTR_BatchBlocks];
+    size_t      batch = sizeof(pad) / ctx->blockSize;
+    size_t      count, i;
+    S4Err       err = kS4Err_NoErr;
+
+    for(i = 0; i < batch; i++)
+    {
+        tbcBlocks[i].tweek  = tweek + i * kCTR_TweekBytes;
+        tbcBlocks[i].in     = pad + i * ctx->blockSize;
+        tbcBlocks[i].out    = pad + i * ctx->blockSize;
+    }
+
+    ZERO(tweek, sizeof(tweek));
+
+    for(; blocks > 0; blocks -= count)
+    {
+        count = MIN(blocks, batch);
+
+        for(i = 0; i < count; i++)
+        {
+            COPY(ctx->iv, pad + i * ctx->blockSize, ctx->blockSize);
+            STORE64L(n + i, tweek + i * kCTR_TweekBytes);
+        }
+
+        err = TBC_EncryptBlocks(ctx->tbc, tbcBlocks, count); CKERR;
+
+        sCTR_XOR(in, pad, out, count * ctx->blockSize);
+
+        in  += count * ctx->blockSize;
+        out += count * ctx->blockSize;
+        n   += count;
+    }
+
+done:
+
+    ZERO(pad, sizeof(pad));
+
+    return err;
+}
+
+/* out = in ^ keystream for blocks starting at block number n.  Only reads
+   the context, so slices of one buffer can run on several threads */
+
+static S4Err sCTR_Crypt(const CTR_Context *ctx, uint64_t n, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    const struct ltc_cipher_descriptor *desc;
+    uint8_t     ctr[kCTR_BlockSize];
+    uint8_t     pad[kCTR_BatchBlocks * kCTR_BlockSize];
+    int         status = CRYPT_OK;
+    size_t      count, i;
+
+    if(TBC_ContextRefIsValid(ctx->tbc))
+        return sCTR_CryptTBC(ctx, n, in, out, blocks);
+
+    desc = &cipher_descriptor[ctx->cipher];
+
+    sCTR_Counter(ctx, n, ctr);
+
+    if(desc->accel_ctr_encrypt)
+    {
+        int x;
+
+        /* the accelerator steps the counter before each block */
+        for(x = kCTR_BlockSize - 1; x >= 0; x--)
+            if(ctr[x]-- != 0)
+                break;
+
+        status = desc->accel_ctr_encrypt(in, out, blocks, ctr, CTR_COUNTER_BIG_ENDIAN | kCTR_BlockSize,
+                                         (symmetric_key *) &ctx->key);
+        goto done;
+    }
+
+    for(; blocks > 0; blocks -= count)
+    {
+        count = MIN(blocks, kCTR_BatchBlocks);
+
+        for(i = 0; i < count; i++)
+        {
+            COPY(ctr, pad + i * kCTR_BlockSize, kCTR_BlockSize);
+            sCTR_Increment(ctr);
+        }
+
+        if(desc->accel_ecb_encrypt)
+        {
+            status = desc->accel_ecb_encrypt(pad, pad, count, (symmetric_key *) &ctx->key); CKSTAT;
+        }
+        else
+        {
+            for(i = 0; i < count && status == CRYPT_OK; i++)
+                status = desc->ecb_encrypt(pad + i * kCTR_BlockSize, pad + i * kCTR_BlockSize,
+                                           (symmetric_key *) &ctx->key);
+            CKSTAT;
+        }
+
+        sCTR_XOR(in, pad, out, count * kCTR_BlockSize);
+
+        in  += count * kCTR_BlockSize;
+        out += count * kCTR_BlockSize;
+    }
+
+done:
+
+    ZERO(ctr, sizeof(ctr));
+    ZERO(pad, sizeof(pad));
+
+    return sCrypt2S4Err(status);
+}
+
+/* one slice of sCTR_CryptBlocks, counted in blocks from the current position */
+
+static int sCTR_Slice(void *arg, size_t first, size_t count)
+{
+    const sCTR_Buffer   *buf = arg;
+    size_t              offset = first * buf->ctx->blockSize;
+
+    return sCTR_Crypt(buf->ctx, buf->ctx->block + first, buf->in + offset, buf->out + offset, count);
+}
+
+/* whole blocks from the current position, large buffers are cut into one slice per thread */
+
+static S4Err sCTR_CryptBlocks(CTR_Context *ctx, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    sCTR_Buffer buf = { ctx, in, out };
+    S4Err       err;
+
+    err = sSliceRun(sCTR_Slice, &buf, blocks, ctx->blockSize, ctx->threadCount);
+
+    /* any keystream made ahead is behind us now */
+    if(IsntS4Err(err))
+    {
+        ctx->block     += blocks;
+        ctx->aheadLen   = 0;
+        ctx->aheadUsed  = 0;
+    }
+
+    return err;
+}
+
+static S4Err sCTR_FillAhead(CTR_Context *ctx)
+{
+    size_t  blocks = kCTR_AheadBytes / ctx->blockSize;
+    S4Err   err;
+
+    ZERO(ctx->ahead, kCTR_AheadBytes);
+
+    ctx->aheadLen   = 0;
+    ctx->aheadUsed  = 0;
+
+    err = sCTR_Crypt(ctx, ctx->block, ctx->ahead, ctx->ahead, blocks);
+
+    if(IsntS4Err(err))
+    {
+        ctx->aheadLen = blocks * ctx->blockSize;
+        ctx->block   += blocks;
+    }
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Public
+#endif
+
+S4Err CTR_Init(Cipher_Algorithm algorithm,
+               const void *key,
+               const void *iv,
+               uint32_t   threadCount,
+               CTR_ContextRef * ctxOut)
+{
+    int             err     = kS4Err_NoErr;
+    CTR_Context*    ctrCTX  = NULL;
+    int             keylen  = 0;
+    int             cipher  = -1;
+    size_t          blockSize = kCTR_BlockSize;
+    int             status  =  CRYPT_OK;
+
+    ValidateParam(key);
+    ValidateParam(iv);
+    ValidateParam(ctxOut);
+
+    switch(algorithm)
+    {
+        case kCipher_Algorithm_3FISH256:
+            blockSize = 256 >> 3;
+            break;
+
+        case kCipher_Algorithm_3FISH512:
+            blockSize = 512 >> 3;
+            break;
+
+        case kCipher_Algorithm_3FISH1024:
+            blockSize = 1024 >> 3;
+            break;
+
+        default:
+            err = sCipherForAlgorithm(algorithm, &cipher, &keylen); CKERR;
+            status = cipher_is_valid(cipher); CKSTAT;
+            break;
+    }
+
+    ctrCTX = XMALLOC(sizeof (CTR_Context)); CKNULL(ctrCTX);
+    ZERO(ctrCTX, sizeof(CTR_Context));
+
+    ctrCTX->magic       = kCTR_ContextMagic;
+    ctrCTX->algor       = algorithm;
+    ctrCTX->cipher      = cipher;
+    ctrCTX->threadCount = sSliceThreadCount(threadCount);
+    ctrCTX->tbc         = kInvalidTBC_ContextRef;
+    ctrCTX->blockSize   = blockSize;
+
+    /* the IV fills the front of a Threefish block, the rest is zero */
+    COPY(iv, ctrCTX->iv, kCTR_BlockSize);
+
+    if(cipher < 0)
+    {
+        err = TBC_Init(algorithm, key, &ctrCTX->tbc); CKERR;
+    }
+    else
+    {
+        status = cipher_descriptor[cipher].setup(key, keylen, 0, &ctrCTX->key); CKSTAT;
+    }
+
+    *ctxOut = ctrCTX;
+
+done:
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    if(IsS4Err(err) && ctrCTX)
+    {
+        ZERO(ctrCTX, sizeof(CTR_Context));
+        XFREE(ctrCTX);
+    }
+
+    return err;
+}
+
+S4Err CTR_Update(CTR_ContextRef ctx,
+                 const void *	in,
+                 size_t         bytesIn,
+                 void *         out )
+{
+    S4Err           err     = kS4Err_NoErr;
+    const uint8_t   *p      = in;
+    uint8_t         *q      = out;
+    size_t          n;
+
+    validateCTRContext(ctx);
+    ValidateParam(bytesIn == 0 || (in && out));
+
+    while(bytesIn > 0)
+    {
+        /* use up keystream made ahead before starting on new blocks */
+        if(ctx->aheadUsed < ctx->aheadLen)
+        {
+            n = MIN(bytesIn, ctx->aheadLen - ctx->aheadUsed);
+
+            sCTR_XOR(p, ctx->ahead + ctx->aheadUsed, q, n);
+
+            ctx->aheadUsed += n;
+        }
+        else if(bytesIn >= kCTR_AheadBytes)
+        {
+            /* large runs of whole blocks go straight from the caller's buffer */
+            n = bytesIn - bytesIn % ctx->blockSize;
+
+            err = sCTR_CryptBlocks(ctx, p, q, n / ctx->blockSize); CKERR;
+        }
+        else
+        {
+            err = sCTR_FillAhead(ctx); CKERR;
+            continue;
+        }
+
+        p       += n;
+        q       += n;
+        bytesIn -= n;
+    }
+
+done:
+
+    return err;
+}
+
+S4Err CTR_Seek(CTR_ContextRef ctx,
+               uint64_t       offset)
+{
+    S4Err       err     = kS4Err_NoErr;
+    uint64_t    block, first;
+
+    validateCTRContext(ctx);
+
+    block = offset / ctx->blockSize;
+
+    /* still inside the keystream made ahead */
+    first = ctx->block - ctx->aheadLen / ctx->blockSize;
+    if(ctx->aheadLen > 0 && block >= first && block < ctx->block)
+    {
+        ctx->aheadUsed = (size_t)(offset - first * ctx->blockSize);
+        goto done;
+    }
+
+    ctx->aheadLen   = 0;
+    ctx->aheadUsed  = 0;
+    ctx->block      = block;
+
+    if(offset % ctx->blockSize)
+    {
+        err = sCTR_FillAhead(ctx); CKERR;
+        ctx->aheadUsed = offset % ctx->blockSize;
+    }
+
+done:
+
+    return err;
+}
+
+void CTR_Free(CTR_ContextRef  ctx)
+{
+    if(sCTR_ContextIsValid(ctx))
+    {
+        if(TBC_ContextRefIsValid(ctx->tbc))
+            TBC_Free(ctx->tbc);
+        else
+            cipher_descriptor[ctx->cipher].done(&ctx->key);
+
+        ZERO(ctx, sizeof(CTR_Context));
+        XFREE(ctx);
+    }
+}
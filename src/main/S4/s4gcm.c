@@ -0,0 +1,346 @@
+//
+//  s4GCM.c
+//  S4
+//
+//  Galois/Counter mode authenticated encryption.  The work is done by the
+//  tomcrypt gcm_ code, which hashes with the carry-less multiply on CPUs that
+//  have it (and runs AES-NI CTR in the same loop) and with the 64 KB tables
+//  otherwise.  This wraps it in a context that knows which direction it is
+//  going, so the tag is written after encrypting and checked after decrypting.
+//  The gcm_state ends with the 64KB tables, a context on one of the other
+//  layouts is allocated without them.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#include <stddef.h>
+
+#include "s4Internal.h"
+
+#define kGCM_BlockSize          16
+#define kGCM_MinTagSize         4
+
+/* SP 800-38D limit on the text under one IV, 2^39 - 256 bits */
+#define kGCM_MaxTextBytes       ((UINT64_C(1) << 36) - 32)
+
+typedef struct GCM_Context    GCM_Context;
+
+struct GCM_Context
+{
+#define kGCM_ContextMagic		0x43346763
+    uint32_t            magic;
+    Cipher_Algorithm    algor;
+    GCM_Layout          layout;
+    size_t              allocSize;
+    int                 direction;      /* GCM_ENCRYPT or GCM_DECRYPT once text is seen, -1 before */
+    uint64_t            textBytes;
+    gcm_state           gcm;            /* last, it is cut short when the 64KB tables are not used */
+};
+
+
+static bool sGCM_ContextIsValid( const GCM_ContextRef  ref)
+{
+    bool       valid	= false;
+
+    valid	= IsntNull( ref ) && ref->magic	 == kGCM_ContextMagic;
+
+    return( valid );
+}
+
+#define validateGCMContext( s )		\
+ValidateParam( sGCM_ContextIsValid( s ) )
+
+
+#ifdef __clang__
+#pragma mark - Utility
+#endif
+
+/* the tag comparison takes the same time wherever the first difference is */
+static bool sGCM_TagsMatch(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    uint8_t     diff = 0;
+    size_t      i;
+
+    for(i = 0; i < len; i++)
+        diff |= a[i] ^ b[i];
+
+    return diff == 0;
+}
+
+static S4Err sGCM_Process(GCM_ContextRef ctx,
+                          const void *in,
+                          size_t     bytesIn,
+                          void       *out,
+                          int        direction)
+{
+    S4Err       err     = kS4Err_NoErr;
+    int         status  =  CRYPT_OK;
+
+    validateGCMContext(ctx);
+    ValidateParam(bytesIn == 0 || (in && out));
+
+    /* one context goes one way */
+    ValidateParam(ctx->direction == -1 || ctx->direction == direction);
+    ValidateParam(bytesIn <= kGCM_MaxTextBytes - ctx->textBytes);
+
+    ctx->direction = direction;
+
+    /* no AAD was added, the IV still has to be finished */
+    if(ctx->gcm.mode == LTC_GCM_MODE_IV)
+    {
+        status = gcm_add_aad(&ctx->gcm, NULL, 0); CKSTAT;
+    }
+
+    /* gcm_process takes the plaintext first whichever way it goes, in and out may be the same buffer */
+    if(direction == GCM_ENCRYPT)
+        status = gcm_process(&ctx->gcm, (unsigned char *) in, bytesIn, out, GCM_ENCRYPT);
+    else
+        status = gcm_process(&ctx->gcm, out, bytesIn, (unsigned char *) in, GCM_DECRYPT);
+    CKSTAT;
+
+    ctx->textBytes += bytesIn;
+
+done:
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Public
+#endif
+
+S4Err GCM_Init(Cipher_Algorithm algorithm,
+               const void *key,
+               const void *iv,
+               size_t     ivLen,
+               GCM_ContextRef * ctxOut)
+{
+    return GCM_InitWithLayout(algorithm, key, iv, ivLen, kGCM_Layout_Default, ctxOut);
+}
+
+S4Err GCM_InitWithLayout(Cipher_Algorithm algorithm,
+                         const void *key,
+                         const void *iv,
+                         size_t     ivLen,
+                         GCM_Layout layout,
+                         GCM_ContextRef * ctxOut)
+{
+    int             err     = kS4Err_NoErr;
+    GCM_Context*    gcmCTX  = NULL;
+    int             keylen  = 0;
+    int             cipher  = -1;
+    int             backend = LTC_GCM_BACKEND_C;
+    size_t          allocSize;
+    int             status  =  CRYPT_OK;
+
+    ValidateParam(key);
+    ValidateParam(iv);
+    ValidateParam(ivLen > 0);
+    ValidateParam(ctxOut);
+
+    err = sCipherForAlgorithm(algorithm, &cipher, &keylen); CKERR;
+
+    switch(layout)
+    {
+        case kGCM_Layout_Default:
+            backend = gcm_get_backend();
+            break;
+
+        case kGCM_Layout_Tables64K:
+            backend = LTC_GCM_BACKEND_C;
+            break;
+
+        case kGCM_Layout_Table4Bit:
+            backend = LTC_GCM_BACKEND_4BIT;
+            break;
+
+        /* S4_Init only selects it on CPUs that have it */
+        case kGCM_Layout_PCLMUL:
+            if(gcm_get_backend() != LTC_GCM_BACKEND_PCLMUL)
+                RETERR(kS4Err_FeatureNotAvailable);
+            backend = LTC_GCM_BACKEND_PCLMUL;
+            break;
+
+        default:
+            RETERR(kS4Err_BadParams);
+    }
+
+    status = cipher_is_valid(cipher); CKSTAT;
+
+    allocSize = offsetof(GCM_Context, gcm) + gcm_state_size(backend, cipher);
+
+    gcmCTX = XMALLOC(allocSize); CKNULL(gcmCTX);
+    ZERO(gcmCTX, allocSize);
+
+    gcmCTX->magic       = kGCM_ContextMagic;
+    gcmCTX->algor       = algorithm;
+    gcmCTX->layout      = layout;
+    gcmCTX->allocSize   = allocSize;
+    gcmCTX->direction   = -1;
+
+    status = gcm_init_backend(&gcmCTX->gcm, backend, cipher, key, keylen); CKSTAT;
+    status = gcm_add_iv(&gcmCTX->gcm, iv, ivLen); CKSTAT;
+
+    *ctxOut = gcmCTX;
+
+done:
+
+    if(status != CRYPT_OK)
+    {
+        if(gcmCTX)
+        {
+            ZERO(gcmCTX, gcmCTX->allocSize);
+            XFREE(gcmCTX);
+        }
+        err = sCrypt2S4Err(status);
+    }
+
+    return err;
+}
+
+S4Err GCM_AddAAD(GCM_ContextRef ctx,
+                 const void *	aad,
+                 size_t         aadLen)
+{
+    S4Err       err     = kS4Err_NoErr;
+    int         status  =  CRYPT_OK;
+
+    validateGCMContext(ctx);
+    ValidateParam(aadLen == 0 || aad);
+
+    /* the AAD all comes before the text */
+    ValidateParam(ctx->direction == -1);
+
+    status = gcm_add_aad(&ctx->gcm, aad, aadLen); CKSTAT;
+
+done:
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
+S4Err GCM_Encrypt(GCM_ContextRef ctx,
+                  const void *	in,
+                  size_t         bytesIn,
+                  void *         out )
+{
+    return sGCM_Process(ctx, in, bytesIn, out, GCM_ENCRYPT);
+}
+
+S4Err GCM_Decrypt(GCM_ContextRef ctx,
+                  const void *	in,
+                  size_t         bytesIn,
+                  void *         out )
+{
+    return sGCM_Process(ctx, in, bytesIn, out, GCM_DECRYPT);
+}
+
+S4Err GCM_Final(GCM_ContextRef ctx,
+                void *         tag,
+                size_t         tagLen)
+{
+    S4Err           err     = kS4Err_NoErr;
+    int             status  =  CRYPT_OK;
+    uint8_t         computed[kGCM_BlockSize];
+    unsigned long   computedLen = sizeof(computed);
+
+    validateGCMContext(ctx);
+    ValidateParam(tag);
+    ValidateParam(tagLen >= kGCM_MinTagSize && tagLen <= kGCM_BlockSize);
+
+    /* AAD only is a MAC, same as an encryption of nothing */
+    if(ctx->gcm.mode == LTC_GCM_MODE_IV)
+    {
+        status = gcm_add_aad(&ctx->gcm, NULL, 0); CKSTAT;
+    }
+    if(ctx->gcm.mode == LTC_GCM_MODE_AAD)
+    {
+        status = gcm_process(&ctx->gcm, NULL, 0, NULL, GCM_ENCRYPT); CKSTAT;
+    }
+
+    status = gcm_done(&ctx->gcm, computed, &computedLen); CKSTAT;
+
+    if(ctx->direction == GCM_DECRYPT)
+    {
+        if(!sGCM_TagsMatch(computed, tag, tagLen))
+            err = kS4Err_BadIntegrity;
+    }
+    else
+        COPY(computed, tag, tagLen);
+
+done:
+
+    ZERO(computed, sizeof(computed));
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
+void GCM_Free(GCM_ContextRef  ctx)
+{
+    if(sGCM_ContextIsValid(ctx))
+    {
+        ZERO(ctx, ctx->allocSize);
+        XFREE(ctx);
+    }
+}
+
+S4Err GCM_EncryptAEAD(Cipher_Algorithm algorithm,
+                      const void *key,
+                      const void *iv,   size_t ivLen,
+                      const void *aad,  size_t aadLen,
+                      const void *in,   size_t bytesIn,
+                      void       *out,
+                      void       *tag,  size_t tagLen)
+{
+    S4Err           err     = kS4Err_NoErr;
+    GCM_ContextRef  gcm     = kInvalidGCM_ContextRef;
+
+    err = GCM_Init(algorithm, key, iv, ivLen, &gcm); CKERR;
+    err = GCM_AddAAD(gcm, aad, aadLen); CKERR;
+    err = GCM_Encrypt(gcm, in, bytesIn, out); CKERR;
+    err = GCM_Final(gcm, tag, tagLen); CKERR;
+
+done:
+
+    if(GCM_ContextRefIsValid(gcm))
+        GCM_Free(gcm);
+
+    return err;
+}
+
+S4Err GCM_DecryptAEAD(Cipher_Algorithm algorithm,
+                      const void *key,
+                      const void *iv,   size_t ivLen,
+                      const void *aad,  size_t aadLen,
+                      const void *in,   size_t bytesIn,
+                      void       *out,
+                      const void *tag,  size_t tagLen)
+{
+    S4Err           err     = kS4Err_NoErr;
+    GCM_ContextRef  gcm     = kInvalidGCM_ContextRef;
+
+    err = GCM_Init(algorithm, key, iv, ivLen, &gcm); CKERR;
+    err = GCM_AddAAD(gcm, aad, aadLen); CKERR;
+    err = GCM_Decrypt(gcm, in, bytesIn, out); CKERR;
+    err = GCM_Final(gcm, (void *) tag, tagLen); CKERR;
+
+done:
+
+    /* plaintext that did not authenticate is not handed back */
+    if(IsS4Err(err) && out && bytesIn > 0)
+        ZERO(out, bytesIn);
+
+    if(GCM_ContextRefIsValid(gcm))
+        GCM_Free(gcm);
+
+    return err;
+}
@@ -6,9 +6,14 @@
 //  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
 //
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+
 #include "s4Internal.h"
 
 #if _USES_XXHASH_
+#define XXH_STATIC_LINKING_ONLY
 #include "xxhash.h"
 #endif
 
@@ -40,12 +45,19 @@ struct HASH_Context
 #endif
 
 #if _USES_XXHASH_
-        XXH32_stateBody_t       xxHash32_state;
-        XXH64_stateBody_t       xxHash64_state;
+        XXH32_state_t           xxHash32_state;
+        XXH64_state_t           xxHash64_state;
+        XXH3_state_t            xxHash3_state;      /* XXH3 64 and 128 bit */
 #endif
         
+        SkeinTree_Context       *skeinTree;
+        struct sHASH_Multi      *multi;
+        
     }state;
     
+    uint64_t                seed;           /* xxHash seed, so HASH_Reset can restart it */
+    bool                    inPlace;        /* built by HASH_InitInPlace, HASH_Free does not release it */
+    
     
     int (*process)(void *ctx, const unsigned char *in, unsigned long inlen);
     
@@ -67,61 +79,41 @@ sHASH_ContextIsValid( const HASH_ContextRef  ref)
 #define validateHASHContext( s )		\
 ValidateParam( sHASH_ContextIsValid( s ) )
 
-S4Err HASH_Import(void *inData, size_t bufSize, HASH_ContextRef * ctx)
-{
-    S4Err        err = kS4Err_NoErr;
-    HASH_Context*   hashCTX = NULL;
-    
-    ValidateParam(ctx);
-    *ctx = NULL;
-    
-    
-    if(sizeof(HASH_Context) != bufSize)
-        RETERR( kS4Err_BadParams);
-    
-    hashCTX = XMALLOC(sizeof (HASH_Context)); CKNULL(hashCTX);
-    
-    COPY( inData, hashCTX, sizeof(HASH_Context));
-    
-    validateHASHContext(hashCTX);
-    
-    *ctx = hashCTX;
-    
-done:
-    
-    if(IsS4Err(err))
-    {
-        if(IsntNull(hashCTX))
-        {
-            XFREE(hashCTX);
-        }
-    }
-    
-    return err;
-}
+#define sHASH_IsSkeinTree( a )  \
+( (a) == kHASH_Algorithm_SKEIN512_TREE || (a) == kHASH_Algorithm_SKEIN1024_TREE )
 
-S4Err HASH_Export(HASH_ContextRef ctx, void *outData, size_t bufSize, size_t *datSize)
+/* HASH_MultiInit contexts, never handed to HASH_Init */
+#define kHASH_Algorithm_Multi   ((HASH_Algorithm) 0x7FFF)
+
+/* tree and multi contexts keep their state outside the context, so it can not be exported */
+#define sHASH_IsExternal( a )  \
+( sHASH_IsSkeinTree(a) || (a) == kHASH_Algorithm_Multi )
+
+#if _USES_XXHASH_
+#define sHASH_IsXXHash( a )  \
+( (a) == kHASH_Algorithm_xxHash32 || (a) == kHASH_Algorithm_xxHash64 \
+ || (a) == kHASH_Algorithm_xxHash3_64 || (a) == kHASH_Algorithm_xxHash128 )
+#endif
+
+/* the XXH3 state keeps its accumulators 64 byte aligned for the SIMD paths,
+   which is more than malloc promises */
+#define kHASH_ContextAlign      64
+
+/* HASH_InitInPlace aligns the caller's buffer itself, so kHASH_ContextAllocSize has to cover the slack */
+typedef char sHASH_ContextFits[(sizeof(HASH_Context) + kHASH_ContextAlign - 1 <= kHASH_ContextAllocSize) ? 1 : -1];
+
+static HASH_Context* sHASH_AllocContext(void)
 {
-    S4Err        err = kS4Err_NoErr;
-    
-    validateHASHContext(ctx);
-    ValidateParam(outData);
-    ValidateParam(datSize);
-    
-    if(sizeof(HASH_Context) > bufSize)
-        RETERR( kS4Err_BufferTooSmall);
+    void    *p = NULL;
     
-    COPY( ctx, outData, sizeof(HASH_Context));
+    if(posix_memalign(&p, kHASH_ContextAlign, sizeof(HASH_Context)) != 0)
+        return NULL;
     
-    *datSize = sizeof(HASH_Context);
-    
-done:
-    
-    return err;
+    ((HASH_Context*)p)->inPlace = false;
     
+    return p;
 }
 
-
 #if  _USES_COMMON_CRYPTO_
 
 int sCCHashUpdateMD5(void *ctx, const unsigned char *in, unsigned long inlen)
@@ -265,43 +257,233 @@ int xxHashFinal64(void *ctx, unsigned char *out)
     return CRYPT_OK;
 }
 
+int xxHashUpdate3_64(void *ctx, const unsigned char *in, unsigned long inlen)
+{
+    
+    return  (XXH3_64bits_update( ctx, in, inlen) == XXH_OK) ? CRYPT_OK :CRYPT_ERROR;
+    
+}
+
+int xxHashFinal3_64(void *ctx, unsigned char *out)
+{
+    uint64_t digest = XXH3_64bits_digest(ctx);
+    
+    COPY(&digest, out, sizeof(digest));
+    
+    return CRYPT_OK;
+}
+
+int xxHashUpdate128(void *ctx, const unsigned char *in, unsigned long inlen)
+{
+    
+    return  (XXH3_128bits_update( ctx, in, inlen) == XXH_OK) ? CRYPT_OK :CRYPT_ERROR;
+    
+}
+
+int xxHashFinal128(void *ctx, unsigned char *out)
+{
+    XXH128_hash_t digest = XXH3_128bits_digest(ctx);
+    
+    COPY(&digest, out, sizeof(digest));
+    
+    return CRYPT_OK;
+}
+
+/* HASH_Init seeds, the 32 and 64 bit values match the xxhsum test vectors */
+static uint64_t sXXHashDefaultSeed(HASH_Algorithm algorithm)
+{
+    return (algorithm == kHASH_Algorithm_xxHash32 || algorithm == kHASH_Algorithm_xxHash64)
+            ? 2654435761U : 0;
+}
+
+/* one shot xxHash straight into out, no context */
+static S4Err sXXHash_DO(HASH_Algorithm algorithm, uint64_t seed,
+                        const unsigned char *in, unsigned long inlen,
+                        unsigned long outLen, uint8_t *out)
+{
+    S4Err           err = kS4Err_NoErr;
+    uint8_t         hashBuf[16];
+    size_t          hashSize = 0;
+    
+    switch(algorithm)
+    {
+        case kHASH_Algorithm_xxHash32:
+        {
+            uint32_t digest = XXH32(in, inlen, (uint32_t) seed);
+            hashSize = sizeof(digest);
+            COPY(&digest, hashBuf, hashSize);
+            break;
+        }
+            
+        case kHASH_Algorithm_xxHash64:
+        {
+            uint64_t digest = XXH64(in, inlen, seed);
+            hashSize = sizeof(digest);
+            COPY(&digest, hashBuf, hashSize);
+            break;
+        }
+            
+        case kHASH_Algorithm_xxHash3_64:
+        {
+            uint64_t digest = XXH3_64bits_withSeed(in, inlen, seed);
+            hashSize = sizeof(digest);
+            COPY(&digest, hashBuf, hashSize);
+            break;
+        }
+            
+        case kHASH_Algorithm_xxHash128:
+        {
+            XXH128_hash_t digest = XXH3_128bits_withSeed(in, inlen, seed);
+            hashSize = sizeof(digest);
+            COPY(&digest, hashBuf, hashSize);
+            break;
+        }
+            
+        default:
+            RETERR(kS4Err_BadHashNumber);
+    }
+    
+    COPY(hashBuf, out, MIN(outLen, hashSize));
+    
+done:
+    return err;
+}
+
 #endif
 
-S4Err HASH_Init(HASH_Algorithm algorithm, HASH_ContextRef * ctx)
+int sSkeinTreeUpdate(void *ctx, const unsigned char *in, unsigned long inlen)
 {
-    int             err = kS4Err_NoErr;
+    return sSkeinTree_Process(*(SkeinTree_Context**)ctx, in, inlen);
+}
+
+int sSkeinTreeFinal(void *ctx, unsigned char *out)
+{
+    return sSkeinTree_Done(*(SkeinTree_Context**)ctx, out);
+}
+
+S4Err HASH_InitSkeinTree(HASH_Algorithm algorithm,
+                         uint8_t        leafSizeExp,
+                         uint8_t        fanOutExp,
+                         uint8_t        maxHeight,
+                         uint32_t       threadCount,
+                         HASH_ContextRef * ctx)
+{
+    S4Err           err = kS4Err_NoErr;
     HASH_Context*   hashCTX = NULL;
-    const struct ltc_hash_descriptor* desc = NULL;
     
     ValidateParam(ctx);
     *ctx = NULL;
     
-    hashCTX = XMALLOC(sizeof (HASH_Context)); CKNULL(hashCTX);
+    if(!sHASH_IsSkeinTree(algorithm))
+        RETERR(kS4Err_BadHashNumber);
+    
+    hashCTX = sHASH_AllocContext(); CKNULL(hashCTX);
+    ZERO(hashCTX, sizeof(HASH_Context));
     
     hashCTX->magic = kHASH_ContextMagic;
     hashCTX->algor = algorithm;
+    hashCTX->hashsize = (algorithm == kHASH_Algorithm_SKEIN1024_TREE) ? 128 : 64;
+    hashCTX->process    = (void*) sSkeinTreeUpdate;
+    hashCTX->done       = (void*) sSkeinTreeFinal;
     
-#if _USES_XXHASH_
-    if(hashCTX->algor == kHASH_Algorithm_xxHash32)
+    err = sSkeinTree_Init(algorithm, leafSizeExp, fanOutExp, maxHeight, threadCount,
+                          &hashCTX->state.skeinTree); CKERR;
+    
+    *ctx = hashCTX;
+    
+done:
+    
+    if(IsS4Err(err))
     {
-        hashCTX->hashsize = 4;
-        hashCTX->process    = (void*) xxHashUpdate32;
-        hashCTX->done       = (void*) xxHashFinal32;
-
-        XXH32_reset((XXH32_state_t*)&hashCTX->state.xxHash32_state, 2654435761U);
+        if(IsntNull(hashCTX))
+        {
+            XFREE(hashCTX);
+        }
     }
-    else if(hashCTX->algor == kHASH_Algorithm_xxHash64)
+    
+    return err;
+}
+
+/* the libtomcrypt implementation of algorithm */
+static S4Err sHASH_SetupDescriptor(HASH_Context *hashCTX, HASH_Algorithm algorithm)
+{
+    int             err = kS4Err_NoErr;
+    const struct ltc_hash_descriptor* desc = NULL;
+    
+    desc = sDescriptorForHash(algorithm);
+    
+    if(IsNull(desc))
+        RETERR( kS4Err_BadHashNumber);
+    
+    hashCTX->hashsize = desc->hashsize;
+    hashCTX->process = (void*) desc->process;
+    hashCTX->done =     (void*) desc->done;
+    
+    if(desc->init)
+        err = (desc->init)(&hashCTX->state.tc_state);
+    CKERR;
+    
+done:
+    
+    return err;
+}
+
+/* BLAKE3 keeps its state on the heap, release it when a context is dropped or restarted
+   without HASH_Final */
+static void sHASH_ReleaseState(HASH_Context *hashCTX)
+{
+    if(hashCTX->algor == kHASH_Algorithm_BLAKE3)
+        blake3_free(&hashCTX->state.tc_state);
+}
+
+/* fill in a context in memory the caller owns, shared by the Init calls and HASH_Reset.
+   the magic goes on last so a failed setup never leaves a valid looking context */
+static S4Err sHASH_Setup(HASH_Context *hashCTX, HASH_Algorithm algorithm, uint64_t seed)
+{
+    int             err = kS4Err_NoErr;
+    
+    hashCTX->magic = 0;
+    hashCTX->algor = algorithm;
+    hashCTX->seed = seed;
+    
+#if _USES_XXHASH_
+    
+    switch(algorithm)
     {
-        hashCTX->hashsize = 8;
-        hashCTX->process    = (void*) xxHashUpdate64;
-        hashCTX->done       = (void*) xxHashFinal64;
-        
-        XXH64_reset((XXH64_state_t*)&hashCTX->state.xxHash64_state, 2654435761U);
+        case kHASH_Algorithm_xxHash32:
+            hashCTX->hashsize = 4;
+            hashCTX->process    = (void*) xxHashUpdate32;
+            hashCTX->done       = (void*) xxHashFinal32;
+            XXH32_reset(&hashCTX->state.xxHash32_state, (uint32_t) seed);
+            goto complete;
+            
+        case kHASH_Algorithm_xxHash64:
+            hashCTX->hashsize = 8;
+            hashCTX->process    = (void*) xxHashUpdate64;
+            hashCTX->done       = (void*) xxHashFinal64;
+            XXH64_reset(&hashCTX->state.xxHash64_state, seed);
+            goto complete;
+            
+        case kHASH_Algorithm_xxHash3_64:
+            hashCTX->hashsize = 8;
+            hashCTX->process    = (void*) xxHashUpdate3_64;
+            hashCTX->done       = (void*) xxHashFinal3_64;
+            XXH3_64bits_reset_withSeed(&hashCTX->state.xxHash3_state, seed);
+            goto complete;
+            
+        case kHASH_Algorithm_xxHash128:
+            hashCTX->hashsize = 16;
+            hashCTX->process    = (void*) xxHashUpdate128;
+            hashCTX->done       = (void*) xxHashFinal128;
+            XXH3_128bits_reset_withSeed(&hashCTX->state.xxHash3_state, seed);
+            goto complete;
+            
+        default:
+            break;
     }
-    else
-
+    
 #endif
-    {
+    
 #if _USES_COMMON_CRYPTO_
     
     switch(algorithm)
@@ -359,101 +541,1010 @@ S4Err HASH_Init(HASH_Algorithm algorithm, HASH_ContextRef * ctx)
             break;
     }
     
-    if(hashCTX->ccAlgor == kCCHmacAlgInvalid)
-    {
-        desc = sDescriptorForHash(algorithm);
-        hashCTX->hashsize = desc->hashsize;
-        hashCTX->process = (void*) desc->process;
-        hashCTX->done =     (void*) desc->done;
-        
-        if(IsNull(desc))
-            RETERR( kS4Err_BadHashNumber);
-        
-        if(desc->init)
-            err = (desc->init)(&hashCTX->state.tc_state);
-        CKERR;
-        
-    }
-    
-#else
-    
-    desc = sDescriptorForHash(algorithm);
-    hashCTX->hashsize = desc->hashsize;
-    hashCTX->process = (void*) desc->process;
-    hashCTX->done =     (void*) desc->done;
-    
-    if(IsNull(desc))
-        RETERR( kS4Err_BadHashNumber);
-    
-    
-    if(desc->init)
-        err = (desc->init)(&hashCTX->state.tc_state);
-    CKERR;
+    if(hashCTX->ccAlgor != kCCHmacAlgInvalid)
+        goto complete;
     
 #endif
-    }
-    
-    *ctx = hashCTX;
     
-done:
+    err = sHASH_SetupDescriptor(hashCTX, algorithm); CKERR;
     
+complete:
+    hashCTX->magic = kHASH_ContextMagic;
     
-    if(IsS4Err(err))
-    {
-        if(IsntNull(hashCTX))
-        {
-            XFREE(hashCTX);
-        }
-    }
+done:
     
     return err;
-    
 }
 
-S4Err HASH_Update(HASH_ContextRef ctx, const void *data, size_t dataLength)
+#ifdef __clang__
+#pragma mark - Export
+#endif
+
+/* HASH_Export writes only what an algorithm needs to carry on: the chaining value,
+   the length so far and the input not yet compressed, all little endian.  HASH_Import
+   rebuilds the rest (dispatch, IVs, the XXH3 secret) from the algorithm and seed, so
+   a checkpoint does not depend on the layout of HASH_Context in this build.
+ 
+     version(1) algorithm(1) encoding(1) state...
+ 
+   CommonCrypto keeps its state opaque, contexts it backs are exported as the
+   CC_xxx_CTX itself and only import where CommonCrypto is used.  Portable MD5 and
+   SHA exports import everywhere, onto libtomcrypt if need be.
+*/
+
+#define kHASH_ExportVersion     1
+
+enum
 {
-    int             err = kS4Err_NoErr;
-    //    const struct    ltc_hash_descriptor* desc = NULL;
-    
-    validateHASHContext(ctx);
-    ValidateParam(data);
-    
-    if(ctx->process)
-        err = (ctx->process)(&ctx->state,  data, dataLength );
-    
-    return err;
-    
-}
+    kHASH_Encoding_Portable     = 0,
+    kHASH_Encoding_CommonCrypto = 1,
+};
 
+/* BLAKE3 with a full chaining value stack is the largest */
+typedef char sHASH_ExportFits[(3 + 8 + 32 + 3 + BLAKE3_BLOCK_LEN + 8 + 1
+                               + (BLAKE3_MAX_DEPTH + 1) * BLAKE3_OUT_LEN <= kHASH_ExportMaxSize) ? 1 : -1];
 
+typedef struct
+{
+    const uint8_t   *p;
+    size_t          left;
+    bool            shortRead;
+} sHASH_Reader;
 
-S4Err HASH_Final(HASH_ContextRef  ctx, void *hashOut)
+static inline uint8_t* sPut8(uint8_t *p, unsigned v)
 {
-    int             err = kS4Err_NoErr;
-    //    const struct    ltc_hash_descriptor* desc = NULL;
-    
-    validateHASHContext(ctx);
-    
-    if(ctx->done)
-        err = (ctx->done)(&ctx->state, hashOut );
+    *p = (uint8_t) v;
+    return p + 1;
+}
 
-    return err;
+static inline uint8_t* sPut32(uint8_t *p, ulong32 v)
+{
+    STORE32L(v, p);
+    return p + 4;
 }
 
-void HASH_Free(HASH_ContextRef  ctx)
+static inline uint8_t* sPut64(uint8_t *p, ulong64 v)
 {
-    if(sHASH_ContextIsValid(ctx))
-    {
-        
-        ZERO(ctx, sizeof(HASH_Context));
-        XFREE(ctx);
-    }
+    STORE64L(v, p);
+    return p + 8;
 }
 
-S4Err HASH_GetSize(HASH_ContextRef  ctx, size_t *hashSize)
+static inline uint8_t* sPutBytes(uint8_t *p, const void *in, size_t len)
 {
-    int             err = kS4Err_NoErr;
-    
+    COPY(in, p, len);
+    return p + len;
+}
+
+static inline const uint8_t* sGet(sHASH_Reader *rd, size_t len)
+{
+    const uint8_t *p = rd->p;
+    
+    if(rd->shortRead || rd->left < len)
+    {
+        rd->shortRead = true;
+        return NULL;
+    }
+    
+    rd->p += len;
+    rd->left -= len;
+    
+    return p;
+}
+
+static inline unsigned sGet8(sHASH_Reader *rd)
+{
+    const uint8_t *p = sGet(rd, 1);
+    
+    return p ? *p : 0;
+}
+
+static inline ulong32 sGet32(sHASH_Reader *rd)
+{
+    const uint8_t   *p = sGet(rd, 4);
+    ulong32         v = 0;
+    
+    if(p)
+        LOAD32L(v, p);
+    
+    return v;
+}
+
+static inline ulong64 sGet64(sHASH_Reader *rd)
+{
+    const uint8_t   *p = sGet(rd, 8);
+    ulong64         v = 0;
+    
+    if(p)
+        LOAD64L(v, p);
+    
+    return v;
+}
+
+static inline void sGetBytes(sHASH_Reader *rd, void *out, size_t len)
+{
+    const uint8_t *p = sGet(rd, len);
+    
+    if(p)
+        COPY(p, out, len);
+}
+
+/* the Merkle–Damgård hashes: bytes so far, chaining value, then the partial block */
+
+#define sPUT_MD(p, md, words, wordBits, blockSize)                          \
+{                                                                           \
+    size_t _i;                                                              \
+    p = sPut64(p, (md).length / 8 + (md).curlen);                           \
+    for(_i = 0; _i < words; _i++)                                           \
+        p = sPut##wordBits(p, (md).state[_i]);                              \
+    p = sPutBytes(p, (md).buf, (md).curlen);                                \
+}
+
+#define sGET_MD(rd, md, words, wordBits, blockSize)                         \
+{                                                                           \
+    size_t _i;                                                              \
+    ulong64 _total = sGet64(rd);                                            \
+    for(_i = 0; _i < words; _i++)                                           \
+        (md).state[_i] = sGet##wordBits(rd);                                \
+    (md).curlen = _total % blockSize;                                       \
+    (md).length = (_total - (md).curlen) * 8;                               \
+    sGetBytes(rd, (md).buf, (md).curlen);                                   \
+}
+
+static size_t sHASH_ExportSkein(const SkeinCtx_t *sk, size_t words, uint8_t *out)
+{
+    const Skein_Ctxt_Hdr_t  *h = &sk->m.h;
+    const u64b_t            *X = sk->m.s1024.X;
+    const u08b_t            *b = sk->m.s1024.b;
+    uint8_t                 *p = out;
+    size_t                  i;
+    
+    /* the contexts only differ in the size of X and b */
+    if(words == SKEIN_256_STATE_WORDS)
+    {
+        X = sk->m.s256.X;
+        b = sk->m.s256.b;
+    }
+    else if(words == SKEIN_512_STATE_WORDS)
+    {
+        X = sk->m.s512.X;
+        b = sk->m.s512.b;
+    }
+    
+    p = sPut64(p, h->T[0]);
+    p = sPut64(p, h->T[1]);
+    for(i = 0; i < words; i++)
+        p = sPut64(p, X[i]);
+    p = sPut8(p, (unsigned) h->bCnt);
+    p = sPutBytes(p, b, h->bCnt);
+    
+    return p - out;
+}
+
+static void sHASH_ImportSkein(sHASH_Reader *rd, SkeinCtx_t *sk, size_t words)
+{
+    Skein_Ctxt_Hdr_t        *h = &sk->m.h;
+    u64b_t                  *X = sk->m.s1024.X;
+    u08b_t                  *b = sk->m.s1024.b;
+    size_t                  i;
+    
+    if(words == SKEIN_256_STATE_WORDS)
+    {
+        X = sk->m.s256.X;
+        b = sk->m.s256.b;
+    }
+    else if(words == SKEIN_512_STATE_WORDS)
+    {
+        X = sk->m.s512.X;
+        b = sk->m.s512.b;
+    }
+    
+    h->T[0] = sGet64(rd);
+    h->T[1] = sGet64(rd);
+    for(i = 0; i < words; i++)
+        X[i] = sGet64(rd);
+    h->bCnt = sGet8(rd);
+    
+    /* Skein holds back a whole block for the final one */
+    if(h->bCnt > words * 8)
+        rd->shortRead = true;
+    else
+        sGetBytes(rd, b, h->bCnt);
+}
+
+static size_t sHASH_ExportBLAKE3(const struct blake3_state *b3, uint8_t *out)
+{
+    uint8_t     *p = out;
+    size_t      i;
+    
+    p = sPut64(p, b3->chunk.chunk_counter);
+    for(i = 0; i < 8; i++)
+        p = sPut32(p, b3->chunk.cv[i]);
+    p = sPut8(p, b3->chunk.flags);
+    p = sPut8(p, b3->chunk.blocks_compressed);
+    p = sPut8(p, b3->chunk.buf_len);
+    p = sPutBytes(p, b3->chunk.buf, b3->chunk.buf_len);
+    p = sPut64(p, b3->outlen);
+    p = sPut8(p, b3->cv_stack_len);
+    p = sPutBytes(p, b3->cv_stack, b3->cv_stack_len * BLAKE3_OUT_LEN);
+    
+    return p - out;
+}
+
+/* blake3 merges the stack lazily, so after N chunks it holds the popcount(N)
+   subtrees of N plus up to trailing_zeros(N) more that are not merged yet.
+   Anything else, or a counter past the tree depth, would later walk the merge
+   or the next push off the end of cv_stack */
+static bool sHASH_BLAKE3StackIsValid(uint64_t chunks, unsigned stackLen)
+{
+    unsigned    ones = 0;
+    unsigned    zeros = 0;
+    uint64_t    x;
+    
+    if(chunks >> BLAKE3_MAX_DEPTH)
+        return false;
+    
+    if(chunks == 0)
+        return stackLen == 0;
+    
+    for(x = chunks; (x & 1) == 0; x >>= 1)
+        zeros++;
+    
+    for(; x; x &= x - 1)
+        ones++;
+    
+    return stackLen >= ones && stackLen <= ones + zeros;
+}
+
+static void sHASH_ImportBLAKE3(sHASH_Reader *rd, struct blake3_state *b3)
+{
+    ulong64     outlen;
+    size_t      i;
+    
+    b3->chunk.chunk_counter = sGet64(rd);
+    for(i = 0; i < 8; i++)
+        b3->chunk.cv[i] = sGet32(rd);
+    b3->chunk.flags = sGet8(rd);
+    b3->chunk.blocks_compressed = sGet8(rd);
+    b3->chunk.buf_len = sGet8(rd);
+    
+    if(b3->chunk.buf_len > BLAKE3_BLOCK_LEN || b3->chunk.blocks_compressed > BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN)
+        rd->shortRead = true;
+    else
+        sGetBytes(rd, b3->chunk.buf, b3->chunk.buf_len);
+    
+    outlen = sGet64(rd);
+    b3->outlen = (unsigned long) outlen;
+    if(outlen == 0 || outlen > ULONG_MAX)
+        rd->shortRead = true;
+    
+    b3->cv_stack_len = sGet8(rd);
+    
+    if(!sHASH_BLAKE3StackIsValid(b3->chunk.chunk_counter, b3->cv_stack_len))
+        rd->shortRead = true;
+    else
+        sGetBytes(rd, b3->cv_stack, b3->cv_stack_len * BLAKE3_OUT_LEN);
+}
+
+#if _USES_XXHASH_
+
+#define kXXH3_StripeLen         64      /* XXH_STRIPE_LEN, private to xxhash.c */
+
+static size_t sHASH_ExportXXHash(const HASH_Context *ctx, uint8_t *out)
+{
+    uint8_t     *p = out;
+    size_t      i;
+    
+    p = sPut64(p, ctx->seed);
+    
+    switch(ctx->algor)
+    {
+        case kHASH_Algorithm_xxHash32:
+        {
+            const XXH32_state_t *st = &ctx->state.xxHash32_state;
+            
+            p = sPut32(p, st->total_len_32);
+            p = sPut8(p, st->large_len != 0);
+            for(i = 0; i < 4; i++)
+                p = sPut32(p, st->v[i]);
+            p = sPutBytes(p, st->mem32, st->memsize);
+            break;
+        }
+            
+        case kHASH_Algorithm_xxHash64:
+        {
+            const XXH64_state_t *st = &ctx->state.xxHash64_state;
+            
+            p = sPut64(p, st->total_len);
+            for(i = 0; i < 4; i++)
+                p = sPut64(p, st->v[i]);
+            p = sPutBytes(p, st->mem64, st->memsize);
+            break;
+        }
+            
+        default:
+        {
+            const XXH3_state_t *st = &ctx->state.xxHash3_state;
+            
+            p = sPut64(p, st->totalLen);
+            p = sPut64(p, st->nbStripesSoFar);
+            for(i = 0; i < 8; i++)
+                p = sPut64(p, st->acc[i]);
+            p = sPut32(p, st->bufferedSize);
+            p = sPutBytes(p, st->buffer, st->bufferedSize);
+            
+            /* a short tail is finished off with the end of the last stripe, kept at the end of the buffer */
+            if(st->totalLen > st->bufferedSize && st->bufferedSize < kXXH3_StripeLen)
+                p = sPutBytes(p, st->buffer + sizeof(st->buffer) - (kXXH3_StripeLen - st->bufferedSize),
+                              kXXH3_StripeLen - st->bufferedSize);
+            break;
+        }
+    }
+    
+    return p - out;
+}
+
+static void sHASH_ImportXXHash(sHASH_Reader *rd, HASH_Context *ctx)
+{
+    size_t      i;
+    
+    switch(ctx->algor)
+    {
+        case kHASH_Algorithm_xxHash32:
+        {
+            XXH32_state_t *st = &ctx->state.xxHash32_state;
+            
+            st->total_len_32 = sGet32(rd);
+            st->large_len = sGet8(rd);
+            for(i = 0; i < 4; i++)
+                st->v[i] = sGet32(rd);
+            st->memsize = st->total_len_32 % sizeof(st->mem32);
+            sGetBytes(rd, st->mem32, st->memsize);
+            break;
+        }
+            
+        case kHASH_Algorithm_xxHash64:
+        {
+            XXH64_state_t *st = &ctx->state.xxHash64_state;
+            
+            st->total_len = sGet64(rd);
+            for(i = 0; i < 4; i++)
+                st->v[i] = sGet64(rd);
+            st->memsize = (XXH32_hash_t) (st->total_len % sizeof(st->mem64));
+            sGetBytes(rd, st->mem64, st->memsize);
+            break;
+        }
+            
+        default:
+        {
+            XXH3_state_t *st = &ctx->state.xxHash3_state;
+            
+            st->totalLen = sGet64(rd);
+            st->nbStripesSoFar = (size_t) sGet64(rd);
+            for(i = 0; i < 8; i++)
+                st->acc[i] = sGet64(rd);
+            st->bufferedSize = sGet32(rd);
+            
+            if(st->bufferedSize > sizeof(st->buffer) || st->bufferedSize > st->totalLen
+               || st->nbStripesSoFar >= st->nbStripesPerBlock)
+            {
+                rd->shortRead = true;
+                break;
+            }
+            
+            sGetBytes(rd, st->buffer, st->bufferedSize);
+            
+            if(st->totalLen > st->bufferedSize && st->bufferedSize < kXXH3_StripeLen)
+                sGetBytes(rd, st->buffer + sizeof(st->buffer) - (kXXH3_StripeLen - st->bufferedSize),
+                          kXXH3_StripeLen - st->bufferedSize);
+            break;
+        }
+    }
+}
+
+#endif
+
+#if _USES_COMMON_CRYPTO_
+
+static size_t sCCStateSize(HASH_Algorithm algorithm)
+{
+    switch(algorithm)
+    {
+        case kHASH_Algorithm_MD5:       return sizeof(CC_MD5_CTX);
+        case kHASH_Algorithm_SHA1:      return sizeof(CC_SHA1_CTX);
+        case kHASH_Algorithm_SHA224:
+        case kHASH_Algorithm_SHA256:    return sizeof(CC_SHA256_CTX);
+        case kHASH_Algorithm_SHA384:
+        case kHASH_Algorithm_SHA512:    return sizeof(CC_SHA512_CTX);
+        default:                        return 0;
+    }
+}
+
+#endif
+
+S4Err HASH_Export(HASH_ContextRef ctx, void *outData, size_t bufSize, size_t *datSize)
+{
+    S4Err           err = kS4Err_NoErr;
+    const hash_state *md;
+    uint8_t         state[kHASH_ExportMaxSize];
+    uint8_t         *p = state;
+    
+    validateHASHContext(ctx);
+    ValidateParam(outData);
+    ValidateParam(datSize);
+    
+    if(sHASH_IsExternal(ctx->algor))
+        RETERR(kS4Err_FeatureNotAvailable);
+    
+    md = &ctx->state.tc_state;
+    
+    p = sPut8(p, kHASH_ExportVersion);
+    p = sPut8(p, ctx->algor);
+    
+#if _USES_COMMON_CRYPTO_
+    if(ctx->ccAlgor != kCCHmacAlgInvalid)
+    {
+        p = sPut8(p, kHASH_Encoding_CommonCrypto);
+        p = sPutBytes(p, &ctx->state, sCCStateSize(ctx->algor));
+        goto complete;
+    }
+#endif
+    
+    p = sPut8(p, kHASH_Encoding_Portable);
+    
+    switch(ctx->algor)
+    {
+        case kHASH_Algorithm_MD5:
+            sPUT_MD(p, md->md5, 4, 32, 64);
+            break;
+            
+        case kHASH_Algorithm_SHA1:
+            sPUT_MD(p, md->sha1, 5, 32, 64);
+            break;
+            
+        case kHASH_Algorithm_SHA224:
+        case kHASH_Algorithm_SHA256:
+            sPUT_MD(p, md->sha256, 8, 32, 64);
+            break;
+            
+        case kHASH_Algorithm_SHA384:
+        case kHASH_Algorithm_SHA512:
+        case kHASH_Algorithm_SHA512_256:
+            sPUT_MD(p, md->sha512, 8, 64, 128);
+            break;
+            
+        case kHASH_Algorithm_SKEIN256:
+            p += sHASH_ExportSkein(&md->skein, SKEIN_256_STATE_WORDS, p);
+            break;
+            
+        case kHASH_Algorithm_SKEIN512:
+            p += sHASH_ExportSkein(&md->skein, SKEIN_512_STATE_WORDS, p);
+            break;
+            
+        case kHASH_Algorithm_SKEIN1024:
+            p += sHASH_ExportSkein(&md->skein, SKEIN1024_STATE_WORDS, p);
+            break;
+            
+        case kHASH_Algorithm_BLAKE3:
+            /* released by HASH_Final */
+            if(IsNull(md->blake3))
+                RETERR(kS4Err_BadParams);
+            
+            p += sHASH_ExportBLAKE3(md->blake3, p);
+            break;
+            
+#if _USES_XXHASH_
+        case kHASH_Algorithm_xxHash32:
+        case kHASH_Algorithm_xxHash64:
+        case kHASH_Algorithm_xxHash3_64:
+        case kHASH_Algorithm_xxHash128:
+            p += sHASH_ExportXXHash(ctx, p);
+            break;
+#endif
+            
+        default:
+            RETERR(kS4Err_FeatureNotAvailable);
+    }
+    
+#if _USES_COMMON_CRYPTO_
+complete:
+#endif
+    
+    if((size_t)(p - state) > bufSize)
+        RETERR( kS4Err_BufferTooSmall);
+    
+    COPY(state, outData, p - state);
+    
+    *datSize = p - state;
+    
+done:
+    
+    ZERO(state, sizeof(state));
+    
+    return err;
+}
+
+S4Err HASH_Import(void *inData, size_t bufSize, HASH_ContextRef * ctx)
+{
+    S4Err           err = kS4Err_NoErr;
+    HASH_Context*   hashCTX = NULL;
+    hash_state      *md;
+    sHASH_Reader    rd = { inData, bufSize, false };
+    HASH_Algorithm  algorithm;
+    unsigned        encoding;
+    uint64_t        seed = 0;
+    
+    ValidateParam(ctx);
+    ValidateParam(inData);
+    *ctx = NULL;
+    
+    if(sGet8(&rd) != kHASH_ExportVersion)
+        RETERR(kS4Err_BadParams);
+    
+    algorithm = sGet8(&rd);
+    encoding = sGet8(&rd);
+    
+    if(rd.shortRead || sHASH_IsExternal(algorithm))
+        RETERR(kS4Err_BadParams);
+    
+#if _USES_XXHASH_
+    /* the seed comes first, the XXH3 secret is derived from it */
+    if(encoding == kHASH_Encoding_Portable && sHASH_IsXXHash(algorithm))
+    {
+        seed = sGet64(&rd);
+        
+        if(algorithm == kHASH_Algorithm_xxHash32 && seed > UINT32_MAX)
+            RETERR(kS4Err_BadParams);
+    }
+#endif
+    
+    hashCTX = sHASH_AllocContext(); CKNULL(hashCTX);
+    
+    err = sHASH_Setup(hashCTX, algorithm, seed); CKERR;
+    
+    md = &hashCTX->state.tc_state;
+    
+#if _USES_COMMON_CRYPTO_
+    if(encoding == kHASH_Encoding_CommonCrypto)
+    {
+        if(hashCTX->ccAlgor == kCCHmacAlgInvalid)
+            RETERR(kS4Err_BadParams);
+        
+        sGetBytes(&rd, &hashCTX->state, sCCStateSize(algorithm));
+        goto complete;
+    }
+    
+    /* a portable MD5 or SHA state carries on in libtomcrypt */
+    if(hashCTX->ccAlgor != kCCHmacAlgInvalid)
+    {
+        hashCTX->ccAlgor = kCCHmacAlgInvalid;
+        err = sHASH_SetupDescriptor(hashCTX, algorithm); CKERR;
+    }
+#endif
+    
+    if(encoding != kHASH_Encoding_Portable)
+        RETERR(kS4Err_FeatureNotAvailable);
+    
+    switch(algorithm)
+    {
+        case kHASH_Algorithm_MD5:
+            sGET_MD(&rd, md->md5, 4, 32, 64);
+            break;
+            
+        case kHASH_Algorithm_SHA1:
+            sGET_MD(&rd, md->sha1, 5, 32, 64);
+            break;
+            
+        case kHASH_Algorithm_SHA224:
+        case kHASH_Algorithm_SHA256:
+            sGET_MD(&rd, md->sha256, 8, 32, 64);
+            break;
+            
+        case kHASH_Algorithm_SHA384:
+        case kHASH_Algorithm_SHA512:
+        case kHASH_Algorithm_SHA512_256:
+            sGET_MD(&rd, md->sha512, 8, 64, 128);
+            break;
+            
+        case kHASH_Algorithm_SKEIN256:
+            sHASH_ImportSkein(&rd, &md->skein, SKEIN_256_STATE_WORDS);
+            break;
+            
+        case kHASH_Algorithm_SKEIN512:
+            sHASH_ImportSkein(&rd, &md->skein, SKEIN_512_STATE_WORDS);
+            break;
+            
+        case kHASH_Algorithm_SKEIN1024:
+            sHASH_ImportSkein(&rd, &md->skein, SKEIN1024_STATE_WORDS);
+            break;
+            
+        case kHASH_Algorithm_BLAKE3:
+            sHASH_ImportBLAKE3(&rd, md->blake3);
+            hashCTX->hashsize = md->blake3->outlen;
+            break;
+            
+#if _USES_XXHASH_
+        case kHASH_Algorithm_xxHash32:
+        case kHASH_Algorithm_xxHash64:
+        case kHASH_Algorithm_xxHash3_64:
+        case kHASH_Algorithm_xxHash128:
+            sHASH_ImportXXHash(&rd, hashCTX);
+            break;
+#endif
+            
+        default:
+            RETERR(kS4Err_FeatureNotAvailable);
+    }
+    
+#if _USES_COMMON_CRYPTO_
+complete:
+#endif
+    
+    /* truncated, or with something left over */
+    if(rd.shortRead || rd.left != 0)
+        RETERR(kS4Err_BadParams);
+    
+    *ctx = hashCTX;
+    
+done:
+    
+    if(IsS4Err(err))
+    {
+        if(IsntNull(hashCTX))
+        {
+            sHASH_ReleaseState(hashCTX);
+            ZERO(hashCTX, sizeof(HASH_Context));
+            XFREE(hashCTX);
+        }
+    }
+    
+    return err;
+}
+
+#ifdef __clang__
+#pragma mark - Multiple digests
+#endif
+
+/* each member sees this much of an update before the next one does.  small enough
+   that the later members read it from L2 instead of memory, big enough for the wide
+   BLAKE3 kernels, which need 16 whole chunks */
+#define kHASH_MultiBlockSize    (64 << 10)
+
+typedef struct sHASH_Multi
+{
+    size_t              count;
+    HASH_ContextRef     member[kHASH_Multi_MaxCount];
+    uint8_t             *ctxBuf;                    /* the member contexts, kHASH_ContextAllocSize each */
+} sHASH_Multi;
+
+int sMultiUpdate(void *ctx, const unsigned char *in, unsigned long inlen)
+{
+    sHASH_Multi     *multi = *(sHASH_Multi**)ctx;
+    S4Err           err = kS4Err_NoErr;
+    size_t          i, n;
+    
+    for(; inlen > 0; in += n, inlen -= n)
+    {
+        n = MIN(inlen, kHASH_MultiBlockSize);
+        
+        for(i = 0; i < multi->count; i++)
+        {
+            err = HASH_Update(multi->member[i], in, n); CKERR;
+        }
+    }
+    
+done:
+    return err;
+}
+
+int sMultiFinal(void *ctx, unsigned char *out)
+{
+    sHASH_Multi     *multi = *(sHASH_Multi**)ctx;
+    S4Err           err = kS4Err_NoErr;
+    size_t          i, hashSize;
+    
+    for(i = 0; i < multi->count; i++)
+    {
+        err = HASH_GetSize(multi->member[i], &hashSize); CKERR;
+        err = HASH_Final(multi->member[i], out); CKERR;
+        out += hashSize;
+    }
+    
+done:
+    return err;
+}
+
+static void sHASH_MultiFree(sHASH_Multi *multi)
+{
+    size_t  i;
+    
+    if(IsNull(multi))
+        return;
+    
+    for(i = 0; i < multi->count; i++)
+        HASH_Free(multi->member[i]);
+    
+    if(multi->ctxBuf)
+        XFREE(multi->ctxBuf);
+    
+    ZERO(multi, sizeof(sHASH_Multi));
+    XFREE(multi);
+}
+
+S4Err HASH_MultiInit(const HASH_Algorithm algorithms[], size_t count, HASH_ContextRef * ctx)
+{
+    S4Err           err = kS4Err_NoErr;
+    HASH_Context*   hashCTX = NULL;
+    sHASH_Multi     *multi = NULL;
+    size_t          i, hashSize;
+    
+    ValidateParam(ctx);
+    ValidateParam(algorithms);
+    *ctx = NULL;
+    
+    if(count == 0 || count > kHASH_Multi_MaxCount)
+        RETERR(kS4Err_BadParams);
+    
+    multi = XMALLOC(sizeof(sHASH_Multi)); CKNULL(multi);
+    ZERO(multi, sizeof(sHASH_Multi));
+    
+    multi->ctxBuf = XMALLOC(count * kHASH_ContextAllocSize); CKNULL(multi->ctxBuf);
+    
+    hashCTX = sHASH_AllocContext(); CKNULL(hashCTX);
+    ZERO(hashCTX, sizeof(HASH_Context));
+    
+    hashCTX->algor      = kHASH_Algorithm_Multi;
+    hashCTX->process    = (void*) sMultiUpdate;
+    hashCTX->done       = (void*) sMultiFinal;
+    
+    for(i = 0; i < count; i++)
+    {
+        if(sHASH_IsSkeinTree(algorithms[i]))
+            err = HASH_Init(algorithms[i], &multi->member[i]);
+        else
+            err = HASH_InitInPlace(algorithms[i], multi->ctxBuf + i * kHASH_ContextAllocSize,
+                                   kHASH_ContextAllocSize, &multi->member[i]);
+        CKERR;
+        
+        multi->count++;
+        
+        err = HASH_GetSize(multi->member[i], &hashSize); CKERR;
+        hashCTX->hashsize += hashSize;
+    }
+    
+    hashCTX->state.multi = multi;
+    hashCTX->magic = kHASH_ContextMagic;
+    
+    *ctx = hashCTX;
+    
+done:
+    
+    if(IsS4Err(err))
+    {
+        sHASH_MultiFree(multi);
+        
+        if(IsntNull(hashCTX))
+        {
+            XFREE(hashCTX);
+        }
+    }
+    
+    return err;
+}
+
+#ifdef __clang__
+#pragma mark - Hash
+#endif
+
+S4Err HASH_InitWithSeed(HASH_Algorithm algorithm, uint64_t seed, HASH_ContextRef * ctx)
+{
+    S4Err           err = kS4Err_NoErr;
+    HASH_Context*   hashCTX = NULL;
+    
+    ValidateParam(ctx);
+    *ctx = NULL;
+    
+#if _USES_XXHASH_
+    
+    if(!sHASH_IsXXHash(algorithm))
+        RETERR(kS4Err_FeatureNotAvailable);
+    
+    if(algorithm == kHASH_Algorithm_xxHash32 && seed > UINT32_MAX)
+        RETERR(kS4Err_BadParams);
+    
+    hashCTX = sHASH_AllocContext(); CKNULL(hashCTX);
+    
+    err = sHASH_Setup(hashCTX, algorithm, seed); CKERR;
+    
+    *ctx = hashCTX;
+    
+#else
+    RETERR(kS4Err_FeatureNotAvailable);
+#endif
+    
+done:
+    
+    if(IsS4Err(err))
+    {
+        if(IsntNull(hashCTX))
+        {
+            XFREE(hashCTX);
+        }
+    }
+    
+    return err;
+}
+
+S4Err HASH_Init(HASH_Algorithm algorithm, HASH_ContextRef * ctx)
+{
+    int             err = kS4Err_NoErr;
+    HASH_Context*   hashCTX = NULL;
+    uint64_t        seed = 0;
+    
+    ValidateParam(ctx);
+    *ctx = NULL;
+    
+    if(sHASH_IsSkeinTree(algorithm))
+        return HASH_InitSkeinTree(algorithm,
+                                  kHASH_SkeinTree_LeafSizeExp,
+                                  kHASH_SkeinTree_FanOutExp,
+                                  kHASH_SkeinTree_MaxHeight,
+                                  0, ctx);
+    
+#if _USES_XXHASH_
+    seed = sXXHashDefaultSeed(algorithm);
+#endif
+    
+    hashCTX = sHASH_AllocContext(); CKNULL(hashCTX);
+    
+    err = sHASH_Setup(hashCTX, algorithm, seed); CKERR;
+    
+    *ctx = hashCTX;
+    
+done:
+    
+    
+    if(IsS4Err(err))
+    {
+        if(IsntNull(hashCTX))
+        {
+            XFREE(hashCTX);
+        }
+    }
+    
+    return err;
+    
+}
+
+S4Err HASH_InitInPlace(HASH_Algorithm algorithm, void *buffer, size_t bufSize, HASH_ContextRef * ctx)
+{
+    int             err = kS4Err_NoErr;
+    HASH_Context*   hashCTX = NULL;
+    uintptr_t       aligned;
+    uint64_t        seed = 0;
+    
+    ValidateParam(ctx);
+    ValidateParam(buffer);
+    *ctx = NULL;
+    
+    /* the tree keeps its buffers and worker threads on the heap */
+    if(sHASH_IsSkeinTree(algorithm))
+        RETERR(kS4Err_FeatureNotAvailable);
+    
+    aligned = ((uintptr_t) buffer + kHASH_ContextAlign - 1) & ~(uintptr_t)(kHASH_ContextAlign - 1);
+    
+    if(bufSize < (aligned - (uintptr_t) buffer) + sizeof(HASH_Context))
+        RETERR(kS4Err_BufferTooSmall);
+    
+#if _USES_XXHASH_
+    seed = sXXHashDefaultSeed(algorithm);
+#endif
+    
+    hashCTX = (HASH_Context*) aligned;
+    hashCTX->inPlace = true;
+    
+    err = sHASH_Setup(hashCTX, algorithm, seed); CKERR;
+    
+    *ctx = hashCTX;
+    
+done:
+    
+    return err;
+}
+
+S4Err HASH_Reset(HASH_ContextRef ctx)
+{
+    int             err = kS4Err_NoErr;
+    size_t          hashSize;
+    
+    validateHASHContext(ctx);
+    
+    if(sHASH_IsSkeinTree(ctx->algor))
+    {
+        sSkeinTree_Reset(ctx->state.skeinTree);
+        return err;
+    }
+    
+    if(ctx->algor == kHASH_Algorithm_Multi)
+    {
+        size_t i;
+        
+        for(i = 0; i < ctx->state.multi->count; i++)
+        {
+            err = HASH_Reset(ctx->state.multi->member[i]); CKERR;
+        }
+        
+        return err;
+    }
+    
+    hashSize = ctx->hashsize;
+    
+    sHASH_ReleaseState(ctx);
+    err = sHASH_Setup(ctx, ctx->algor, ctx->seed); CKERR;
+    
+    /* keep an output size picked with HASH_SetOutputSize */
+    if(ctx->algor == kHASH_Algorithm_BLAKE3 && hashSize != ctx->hashsize)
+        err = HASH_SetOutputSize(ctx, hashSize);
+    
+done:
+    
+    return err;
+}
+
+S4Err HASH_Update(HASH_ContextRef ctx, const void *data, size_t dataLength)
+{
+    int             err = kS4Err_NoErr;
+    //    const struct    ltc_hash_descriptor* desc = NULL;
+    
+    validateHASHContext(ctx);
+    ValidateParam(data);
+    
+    if(ctx->process)
+        err = (ctx->process)(&ctx->state,  data, dataLength );
+    
+    return err;
+    
+}
+
+
+
+S4Err HASH_Final(HASH_ContextRef  ctx, void *hashOut)
+{
+    int             err = kS4Err_NoErr;
+    //    const struct    ltc_hash_descriptor* desc = NULL;
+    
+    validateHASHContext(ctx);
+    
+    if(ctx->done)
+        err = (ctx->done)(&ctx->state, hashOut );
+
+    return err;
+}
+
+void HASH_Free(HASH_ContextRef  ctx)
+{
+    if(sHASH_ContextIsValid(ctx))
+    {
+        if(sHASH_IsSkeinTree(ctx->algor))
+            sSkeinTree_Free(ctx->state.skeinTree);
+        
+        if(ctx->algor == kHASH_Algorithm_Multi)
+            sHASH_MultiFree(ctx->state.multi);
+        
+        sHASH_ReleaseState(ctx);
+        
+        bool inPlace = ctx->inPlace;    /* HASH_InitInPlace memory belongs to the caller */
+        
+        ZERO(ctx, sizeof(HASH_Context));
+        
+        if(!inPlace)
+            XFREE(ctx);
+    }
+}
+
+S4Err HASH_GetSize(HASH_ContextRef  ctx, size_t *hashSize)
+{
+    int             err = kS4Err_NoErr;
+    
     validateHASHContext(ctx);
     
     *hashSize = ctx->hashsize;
@@ -461,15 +1552,41 @@ S4Err HASH_GetSize(HASH_ContextRef  ctx, size_t *hashSize)
     return err;
 }
 
+S4Err HASH_SetOutputSize(HASH_ContextRef  ctx, size_t hashSize)
+{
+    int             err = kS4Err_NoErr;
+    
+    validateHASHContext(ctx);
+    
+    if(ctx->algor != kHASH_Algorithm_BLAKE3)
+        RETERR(kS4Err_FeatureNotAvailable);
+    
+    if(hashSize == 0 || hashSize > ULONG_MAX)
+        RETERR(kS4Err_BadParams);
+    
+    err = blake3_set_outlen(&ctx->state.tc_state, (unsigned long) hashSize); CKERR;
+    
+    ctx->hashsize = hashSize;
+    
+done:
+    
+    return err;
+}
+
 
 S4Err HASH_DO(HASH_Algorithm algorithm, const unsigned char *in, unsigned long inlen, unsigned long outLen, uint8_t *out)
 {
     
     S4Err             err         = kS4Err_NoErr;
     HASH_ContextRef     hashRef     = kInvalidHASH_ContextRef;
+    uint8_t             ctxBuf[kHASH_ContextAllocSize];
     uint8_t             hashBuf[128];
     uint8_t             *p = (outLen < sizeof(hashBuf))?hashBuf:out;
     
+#if _USES_XXHASH_
+    if(sHASH_IsXXHash(algorithm))
+        return sXXHash_DO(algorithm, sXXHashDefaultSeed(algorithm), in, inlen, outLen, out);
+#endif
     
 #if  _USES_COMMON_CRYPTO_
     
@@ -512,7 +1629,20 @@ S4Err HASH_DO(HASH_Algorithm algorithm, const unsigned char *in, unsigned long i
     
 #endif
     
-    err = HASH_Init( algorithm, & hashRef); CKERR;
+    /* everything but the tree hashes builds its context on the stack */
+    if(sHASH_IsSkeinTree(algorithm))
+        err = HASH_Init( algorithm, & hashRef);
+    else
+        err = HASH_InitInPlace( algorithm, ctxBuf, sizeof(ctxBuf), & hashRef);
+    CKERR;
+    
+    /* extendable output, produce exactly outLen bytes */
+    if(algorithm == kHASH_Algorithm_BLAKE3)
+    {
+        err = HASH_SetOutputSize(hashRef, outLen); CKERR;
+        p = out;
+    }
+    
     err = HASH_Update( hashRef, in,  inlen); CKERR;
     err = HASH_Final( hashRef, p); CKERR;
     
@@ -527,3 +1657,25 @@ done:
     return err;
 }
 
+S4Err HASH_DOWithSeed(HASH_Algorithm algorithm, uint64_t seed,
+                      const unsigned char *in, unsigned long inlen, unsigned long outLen, uint8_t *out)
+{
+    S4Err             err         = kS4Err_NoErr;
+    
+#if _USES_XXHASH_
+    
+    if(!sHASH_IsXXHash(algorithm))
+        RETERR(kS4Err_FeatureNotAvailable);
+    
+    if(algorithm == kHASH_Algorithm_xxHash32 && seed > UINT32_MAX)
+        RETERR(kS4Err_BadParams);
+    
+    err = sXXHash_DO(algorithm, seed, in, inlen, outLen, out);
+    
+#else
+    RETERR(kS4Err_FeatureNotAvailable);
+#endif
+    
+done:
+    return err;
+}
@@ -0,0 +1,913 @@
+//
+//  s4HashBatch.c
+//  S4
+//
+//  Multi-buffer SHA-2 and Skein: hash many independent messages at once by
+//  running one message per SIMD lane through a transposed compress function.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#include "s4Internal.h"
+#include "s4lanes.h"
+
+#ifdef __clang__
+#pragma mark - Multi-buffer SHA-2 kernels
+#endif
+
+#if defined(LTC_X86_SIMD)
+
+#define kMB_MaxLanes        16
+
+static const uint32_t sSHA256_K[64] = {
+    0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+    0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+    0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL, 0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+    0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+    0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL, 0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+    0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+    0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+    0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL, 0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
+};
+
+static const uint64_t sSHA512_K[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/* tomcrypt's LOAD/STORE macros may be inline asm without a memory clobber,
+   which is not safe on buffers the compiler can see, so use plain loads */
+
+static inline uint32_t sLoad32BE(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+static inline uint64_t sLoad64BE(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap64(v);
+}
+
+static inline void sStore32BE(uint32_t v, uint8_t *p)
+{
+    v = __builtin_bswap32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void sStore64BE(uint64_t v, uint8_t *p)
+{
+    v = __builtin_bswap64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+/* Skein words are little endian, as is every CPU that gets here */
+static inline uint64_t sLoad64LE(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void sStore64LE(uint64_t v, uint8_t *p)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+#define MB_LOAD32(x, y)     x = sLoad32BE(y)
+#define MB_LOAD64(x, y)     x = sLoad64BE(y)
+
+/* the round functions are written with plain C operators so that the same
+   macros work on any GCC/clang vector type */
+
+#define MB_ROR32(x, n)      (((x) >> (n)) | ((x) << (32 - (n))))
+#define MB_ROR64(x, n)      (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define MB_Ch(x,y,z)        ((z) ^ ((x) & ((y) ^ (z))))
+#define MB_Maj(x,y,z)       (((x) & (y)) | ((z) & ((x) | (y))))
+
+#define MB256_Sigma0(x)     (MB_ROR32(x, 2) ^ MB_ROR32(x, 13) ^ MB_ROR32(x, 22))
+#define MB256_Sigma1(x)     (MB_ROR32(x, 6) ^ MB_ROR32(x, 11) ^ MB_ROR32(x, 25))
+#define MB256_Gamma0(x)     (MB_ROR32(x, 7) ^ MB_ROR32(x, 18) ^ ((x) >> 3))
+#define MB256_Gamma1(x)     (MB_ROR32(x, 17) ^ MB_ROR32(x, 19) ^ ((x) >> 10))
+
+#define MB512_Sigma0(x)     (MB_ROR64(x, 28) ^ MB_ROR64(x, 34) ^ MB_ROR64(x, 39))
+#define MB512_Sigma1(x)     (MB_ROR64(x, 14) ^ MB_ROR64(x, 18) ^ MB_ROR64(x, 41))
+#define MB512_Gamma0(x)     (MB_ROR64(x, 1) ^ MB_ROR64(x, 8) ^ ((x) >> 7))
+#define MB512_Gamma1(x)     (MB_ROR64(x, 19) ^ MB_ROR64(x, 61) ^ ((x) >> 6))
+
+#define MB_RND(SIG0, SIG1, a, b, c, d, e, f, g, h, w, k)      \
+    t0 = h + SIG1(e) + MB_Ch(e, f, g) + (k) + (w);             \
+    t1 = SIG0(a) + MB_Maj(a, b, c);                            \
+    d += t0;                                                   \
+    h  = t0 + t1;
+
+/* state is laid out word-major: state[word][lane] */
+#define MB_COMPRESS_BODY(VEC, WORD, LANES, ROUNDS, K, LOADW, SIG0, SIG1, GAM0, GAM1)   \
+{                                                                               \
+    VEC         W[ROUNDS], S[8], t0, t1;                                        \
+    WORD        words[16][LANES] __attribute__((aligned(64)));                  \
+    int         i, l;                                                           \
+                                                                                \
+    for (l = 0; l < LANES; l++)                                                 \
+        for (i = 0; i < 16; i++)                                                \
+            LOADW(words[i][l], blocks[l] + (sizeof(WORD) * i));                 \
+                                                                                \
+    for (i = 0; i < 16; i++)                                                    \
+        COPY(words[i], &W[i], sizeof(VEC));                                     \
+                                                                                \
+    for (i = 16; i < ROUNDS; i++)                                               \
+        W[i] = GAM1(W[i - 2]) + W[i - 7] + GAM0(W[i - 15]) + W[i - 16];         \
+                                                                                \
+    for (i = 0; i < 8; i++)                                                     \
+        S[i] = state[i];                                                        \
+                                                                                \
+    for (i = 0; i < ROUNDS; i += 8)                                             \
+    {                                                                           \
+        MB_RND(SIG0, SIG1, S[0],S[1],S[2],S[3],S[4],S[5],S[6],S[7], W[i+0], K[i+0]); \
+        MB_RND(SIG0, SIG1, S[7],S[0],S[1],S[2],S[3],S[4],S[5],S[6], W[i+1], K[i+1]); \
+        MB_RND(SIG0, SIG1, S[6],S[7],S[0],S[1],S[2],S[3],S[4],S[5], W[i+2], K[i+2]); \
+        MB_RND(SIG0, SIG1, S[5],S[6],S[7],S[0],S[1],S[2],S[3],S[4], W[i+3], K[i+3]); \
+        MB_RND(SIG0, SIG1, S[4],S[5],S[6],S[7],S[0],S[1],S[2],S[3], W[i+4], K[i+4]); \
+        MB_RND(SIG0, SIG1, S[3],S[4],S[5],S[6],S[7],S[0],S[1],S[2], W[i+5], K[i+5]); \
+        MB_RND(SIG0, SIG1, S[2],S[3],S[4],S[5],S[6],S[7],S[0],S[1], W[i+6], K[i+6]); \
+        MB_RND(SIG0, SIG1, S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0], W[i+7], K[i+7]); \
+    }                                                                           \
+                                                                                \
+    for (i = 0; i < 8; i++)                                                     \
+        state[i] += S[i];                                                       \
+}
+
+typedef uint32_t    v8u32   __attribute__ ((vector_size (32)));
+typedef uint32_t    v16u32  __attribute__ ((vector_size (64)));
+typedef uint64_t    v8u64   __attribute__ ((vector_size (64)));
+
+__attribute__ ((target ("avx2")))
+static void sSHA256_Compress8(void *ctx, const uint8_t * const blocks[])
+{
+    v8u32 *state = ctx;
+    MB_COMPRESS_BODY(v8u32, uint32_t, 8, 64, sSHA256_K, MB_LOAD32,
+                     MB256_Sigma0, MB256_Sigma1, MB256_Gamma0, MB256_Gamma1);
+}
+
+__attribute__ ((target ("avx512f")))
+static void sSHA256_Compress16(void *ctx, const uint8_t * const blocks[])
+{
+    v16u32 *state = ctx;
+    MB_COMPRESS_BODY(v16u32, uint32_t, 16, 64, sSHA256_K, MB_LOAD32,
+                     MB256_Sigma0, MB256_Sigma1, MB256_Gamma0, MB256_Gamma1);
+}
+
+__attribute__ ((target ("avx2")))
+static void sSHA512_Compress4(void *ctx, const uint8_t * const blocks[])
+{
+    v4u64 *state = ctx;
+    MB_COMPRESS_BODY(v4u64, uint64_t, 4, 80, sSHA512_K, MB_LOAD64,
+                     MB512_Sigma0, MB512_Sigma1, MB512_Gamma0, MB512_Gamma1);
+}
+
+__attribute__ ((target ("avx512f")))
+static void sSHA512_Compress8(void *ctx, const uint8_t * const blocks[])
+{
+    v8u64 *state = ctx;
+    MB_COMPRESS_BODY(v8u64, uint64_t, 8, 80, sSHA512_K, MB_LOAD64,
+                     MB512_Sigma0, MB512_Sigma1, MB512_Gamma0, MB512_Gamma1);
+}
+
+#ifdef __clang__
+#pragma mark - Lane scheduler
+#endif
+
+static const uint32_t sSHA224_IV[8] = {
+    0xc1059ed8UL, 0x367cd507UL, 0x3070dd17UL, 0xf70e5939UL,
+    0xffc00b31UL, 0x68581511UL, 0x64f98fa7UL, 0xbefa4fa4UL
+};
+
+static const uint32_t sSHA256_IV[8] = {
+    0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+    0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+static const uint64_t sSHA384_IV[8] = {
+    0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL, 0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL,
+    0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL, 0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL
+};
+
+static const uint64_t sSHA512_IV[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const uint64_t sSHA512_256_IV[8] = {
+    0x22312194FC2BF72CULL, 0x9F555FA3C84C64C2ULL, 0x2393B86B6F53B151ULL, 0x963877195940EABDULL,
+    0x96283EE2A88EFFE3ULL, 0xBE5E1E2553863992ULL, 0x2B0199FC2C85B8AAULL, 0x0EB72DDC81C52CA2ULL
+};
+
+typedef void (*sMB_CompressProc)(void *state, const uint8_t * const blocks[]);
+
+typedef struct sMB_Info
+{
+    size_t              lanes;
+    size_t              wordSize;       /* 4 for SHA-256, 8 for SHA-512 */
+    size_t              blockSize;
+    size_t              hashSize;
+    const void          *iv;
+    sMB_CompressProc    compress;
+} sMB_Info;
+
+typedef struct sMB_Lane
+{
+    size_t              msg;            /* index of the message in this lane */
+    const uint8_t       *in;
+    size_t              block;          /* next block to compress */
+    size_t              fullBlocks;     /* blocks read directly from the input */
+    size_t              totalBlocks;
+    uint8_t             tail[256];      /* last one or two padded blocks */
+} sMB_Lane;
+
+static bool sMB_InfoForHash(HASH_Algorithm algorithm, sMB_Info *info)
+{
+    uint32_t    cpu = sCPU_Features();
+    bool        is512 = false;
+
+    switch(algorithm)
+    {
+        case kHASH_Algorithm_SHA224:
+            info->iv = sSHA224_IV;
+            info->hashSize = 28;
+            break;
+
+        case kHASH_Algorithm_SHA256:
+            info->iv = sSHA256_IV;
+            info->hashSize = 32;
+            break;
+
+        case kHASH_Algorithm_SHA384:
+            info->iv = sSHA384_IV;
+            info->hashSize = 48;
+            is512 = true;
+            break;
+
+        case kHASH_Algorithm_SHA512:
+            info->iv = sSHA512_IV;
+            info->hashSize = 64;
+            is512 = true;
+            break;
+
+        case kHASH_Algorithm_SHA512_256:
+            info->iv = sSHA512_256_IV;
+            info->hashSize = 32;
+            is512 = true;
+            break;
+
+        default:
+            return false;
+    }
+
+    info->wordSize  = is512 ? 8 : 4;
+    info->blockSize = is512 ? 128 : 64;
+
+    if(cpu & kS4CPU_AVX512F)
+    {
+        info->lanes     = is512 ? 8 : 16;
+        info->compress  = is512 ? sSHA512_Compress8 : sSHA256_Compress16;
+    }
+    else if(cpu & kS4CPU_AVX2)
+    {
+        info->lanes     = is512 ? 4 : 8;
+        info->compress  = is512 ? sSHA512_Compress4 : sSHA256_Compress8;
+    }
+    else
+        return false;
+
+    return true;
+}
+
+static void sMB_SetLaneWord(const sMB_Info *info, void *state, size_t word, size_t lane, uint64_t value)
+{
+    if(info->wordSize == 4)
+        ((uint32_t*)state)[word * info->lanes + lane] = (uint32_t) value;
+    else
+        ((uint64_t*)state)[word * info->lanes + lane] = value;
+}
+
+static void sMB_LoadLane(const sMB_Info *info, void *state, sMB_Lane *lane,
+                         size_t msg, const unsigned char *in, unsigned long inlen, size_t laneNo)
+{
+    size_t      bs      = info->blockSize;
+    size_t      lenSize = info->wordSize * 2;       /* 64 or 128 bit message length */
+    size_t      rem     = inlen % bs;
+    size_t      tailLen = (rem + 1 + lenSize > bs) ? 2 * bs : bs;
+    uint64_t    bits    = (uint64_t) inlen << 3;
+    int         i;
+
+    for (i = 0; i < 8; i++)
+        sMB_SetLaneWord(info, state, i, laneNo,
+                        info->wordSize == 4 ? ((const uint32_t*)info->iv)[i] : ((const uint64_t*)info->iv)[i]);
+
+    lane->msg           = msg;
+    lane->in            = in;
+    lane->block         = 0;
+    lane->fullBlocks    = inlen / bs;
+    lane->totalBlocks   = lane->fullBlocks + tailLen / bs;
+
+    ZERO(lane->tail, tailLen);
+    COPY(in + (inlen - rem), lane->tail, rem);
+    lane->tail[rem] = 0x80;
+    sStore64BE(bits, lane->tail + tailLen - 8);
+}
+
+static void sMB_StoreDigest(const sMB_Info *info, const void *state, size_t laneNo, unsigned long outLen, uint8_t *out)
+{
+    uint8_t     digest[64];
+    size_t      i;
+
+    for (i = 0; i < 8; i++)
+    {
+        if(info->wordSize == 4)
+            sStore32BE(((const uint32_t*)state)[i * info->lanes + laneNo], digest + 4 * i);
+        else
+            sStore64BE(((const uint64_t*)state)[i * info->lanes + laneNo], digest + 8 * i);
+    }
+
+    COPY(digest, out, outLen < info->hashSize ? outLen : info->hashSize);
+}
+
+static S4Err sHASH_DOBatchMB(const sMB_Info     *info,
+                             size_t              count,
+                             const unsigned char *in[],
+                             const unsigned long inlen[],
+                             unsigned long       outLen,
+                             uint8_t             *out[])
+{
+    S4Err           err = kS4Err_NoErr;
+    uint64_t        state[8 * kMB_MaxLanes] __attribute__((aligned(64)));
+    const uint8_t   *blocks[kMB_MaxLanes];
+    sMB_Lane        *lanes = NULL;
+    bool            active[kMB_MaxLanes];
+    uint8_t         idle[128];
+    size_t          next = 0;
+    size_t          l;
+
+    lanes = XMALLOC(sizeof(sMB_Lane) * info->lanes); CKNULL(lanes);
+    ZERO(idle, sizeof(idle));
+
+    for (l = 0; l < info->lanes; l++)
+        active[l] = false;
+
+    for(;;)
+    {
+        size_t  running = 0;
+
+        /* refill any lane that finished its message */
+        for (l = 0; l < info->lanes; l++)
+        {
+            if(!active[l] && next < count)
+            {
+                sMB_LoadLane(info, state, &lanes[l], next, in[next], inlen[next], l);
+                active[l] = true;
+                next++;
+            }
+
+            if(active[l])
+            {
+                sMB_Lane *lane = &lanes[l];
+
+                blocks[l] = (lane->block < lane->fullBlocks)
+                    ? lane->in + lane->block * info->blockSize
+                    : lane->tail + (lane->block - lane->fullBlocks) * info->blockSize;
+                running++;
+            }
+            else
+                blocks[l] = idle;
+        }
+
+        if(running == 0)
+            break;
+
+        (info->compress)(state, blocks);
+
+        for (l = 0; l < info->lanes; l++)
+        {
+            if(active[l] && ++lanes[l].block == lanes[l].totalBlocks)
+            {
+                sMB_StoreDigest(info, state, l, outLen, out[lanes[l].msg]);
+                active[l] = false;
+            }
+        }
+    }
+
+done:
+
+    if(lanes)
+    {
+        ZERO(lanes, sizeof(sMB_Lane) * info->lanes);
+        XFREE(lanes);
+    }
+
+    ZERO(state, sizeof(state));
+
+    return err;
+}
+
+#ifdef __clang__
+#pragma mark - Multi-buffer Skein kernels
+#endif
+
+/* Threefish-256/512 UBI blocks on four lanes.  Word i of every lane lives in
+   one v4u64, state is the chaining value in and out, words the message words
+   and tweak the per lane tweaks, T0 in tweak[0..3] and T1 in tweak[4..7].
+   The lane type and the mix come from s4lanes.h. */
+
+#define SK256_INJECT(s)                                             \
+    x0 += ks[((s) + 0) % 5];                                        \
+    x1 += ks[((s) + 1) % 5] + ts[(s) % 3];                          \
+    x2 += ks[((s) + 2) % 5] + ts[((s) + 1) % 3];                    \
+    x3 += ks[((s) + 3) % 5] + (uint64_t) (s);
+
+#define SK256_8_ROUNDS(R)                                           \
+    TF_MIX(x0, x1, R_256_0_0);  TF_MIX(x2, x3, R_256_0_1);          \
+    TF_MIX(x0, x3, R_256_1_0);  TF_MIX(x2, x1, R_256_1_1);          \
+    TF_MIX(x0, x1, R_256_2_0);  TF_MIX(x2, x3, R_256_2_1);          \
+    TF_MIX(x0, x3, R_256_3_0);  TF_MIX(x2, x1, R_256_3_1);          \
+    SK256_INJECT(2 * (R) + 1);                                      \
+    TF_MIX(x0, x1, R_256_4_0);  TF_MIX(x2, x3, R_256_4_1);          \
+    TF_MIX(x0, x3, R_256_5_0);  TF_MIX(x2, x1, R_256_5_1);          \
+    TF_MIX(x0, x1, R_256_6_0);  TF_MIX(x2, x3, R_256_6_1);          \
+    TF_MIX(x0, x3, R_256_7_0);  TF_MIX(x2, x1, R_256_7_1);          \
+    SK256_INJECT(2 * (R) + 2);
+
+#define SK512_INJECT(s)                                             \
+    x0 += ks[((s) + 0) % 9];                                        \
+    x1 += ks[((s) + 1) % 9];                                        \
+    x2 += ks[((s) + 2) % 9];                                        \
+    x3 += ks[((s) + 3) % 9];                                        \
+    x4 += ks[((s) + 4) % 9];                                        \
+    x5 += ks[((s) + 5) % 9] + ts[(s) % 3];                          \
+    x6 += ks[((s) + 6) % 9] + ts[((s) + 1) % 3];                    \
+    x7 += ks[((s) + 7) % 9] + (uint64_t) (s);
+
+#define SK512_ROUND(p0, p1, p2, p3, p4, p5, p6, p7, ROT)            \
+    TF_MIX(x##p0, x##p1, ROT##_0);  TF_MIX(x##p2, x##p3, ROT##_1);  \
+    TF_MIX(x##p4, x##p5, ROT##_2);  TF_MIX(x##p6, x##p7, ROT##_3);
+
+#define SK512_8_ROUNDS(R)                                           \
+    SK512_ROUND(0, 1, 2, 3, 4, 5, 6, 7, R_512_0);                   \
+    SK512_ROUND(2, 1, 4, 7, 6, 5, 0, 3, R_512_1);                   \
+    SK512_ROUND(4, 1, 6, 3, 0, 5, 2, 7, R_512_2);                   \
+    SK512_ROUND(6, 1, 0, 7, 2, 5, 4, 3, R_512_3);                   \
+    SK512_INJECT(2 * (R) + 1);                                      \
+    SK512_ROUND(0, 1, 2, 3, 4, 5, 6, 7, R_512_4);                   \
+    SK512_ROUND(2, 1, 4, 7, 6, 5, 0, 3, R_512_5);                   \
+    SK512_ROUND(4, 1, 6, 3, 0, 5, 2, 7, R_512_6);                   \
+    SK512_ROUND(6, 1, 0, 7, 2, 5, 4, 3, R_512_7);                   \
+    SK512_INJECT(2 * (R) + 2);
+
+#define SK256_BLOCK_BODY                                                        \
+{                                                                               \
+    v4u64       *X = (v4u64 *) state;                                           \
+    const v4u64 *W = (const v4u64 *) words;                                     \
+    const v4u64 *T = (const v4u64 *) tweak;                                     \
+    v4u64       ks[5], ts[3];                                                   \
+    v4u64       x0, x1, x2, x3;                                                 \
+                                                                                \
+    ks[0] = X[0];   ks[1] = X[1];   ks[2] = X[2];   ks[3] = X[3];               \
+    ks[4] = ks[0] ^ ks[1] ^ ks[2] ^ ks[3] ^ SKEIN_KS_PARITY;                    \
+                                                                                \
+    ts[0] = T[0];                                                               \
+    ts[1] = T[1];                                                               \
+    ts[2] = ts[0] ^ ts[1];                                                      \
+                                                                                \
+    x0 = W[0];  x1 = W[1];  x2 = W[2];  x3 = W[3];                              \
+                                                                                \
+    SK256_INJECT(0);                                                            \
+    SK256_8_ROUNDS(0);  SK256_8_ROUNDS(1);  SK256_8_ROUNDS(2);                  \
+    SK256_8_ROUNDS(3);  SK256_8_ROUNDS(4);  SK256_8_ROUNDS(5);                  \
+    SK256_8_ROUNDS(6);  SK256_8_ROUNDS(7);  SK256_8_ROUNDS(8);                  \
+                                                                                \
+    X[0] = x0 ^ W[0];   X[1] = x1 ^ W[1];   X[2] = x2 ^ W[2];   X[3] = x3 ^ W[3]; \
+}
+
+#define SK512_BLOCK_BODY                                                        \
+{                                                                               \
+    v4u64       *X = (v4u64 *) state;                                           \
+    const v4u64 *W = (const v4u64 *) words;                                     \
+    const v4u64 *T = (const v4u64 *) tweak;                                     \
+    v4u64       ks[9], ts[3];                                                   \
+    v4u64       x0, x1, x2, x3, x4, x5, x6, x7;                                 \
+                                                                                \
+    ks[0] = X[0];   ks[1] = X[1];   ks[2] = X[2];   ks[3] = X[3];               \
+    ks[4] = X[4];   ks[5] = X[5];   ks[6] = X[6];   ks[7] = X[7];               \
+    ks[8] = ks[0] ^ ks[1] ^ ks[2] ^ ks[3] ^                                     \
+            ks[4] ^ ks[5] ^ ks[6] ^ ks[7] ^ SKEIN_KS_PARITY;                    \
+                                                                                \
+    ts[0] = T[0];                                                               \
+    ts[1] = T[1];                                                               \
+    ts[2] = ts[0] ^ ts[1];                                                      \
+                                                                                \
+    x0 = W[0];  x1 = W[1];  x2 = W[2];  x3 = W[3];                              \
+    x4 = W[4];  x5 = W[5];  x6 = W[6];  x7 = W[7];                              \
+                                                                                \
+    SK512_INJECT(0);                                                            \
+    SK512_8_ROUNDS(0);  SK512_8_ROUNDS(1);  SK512_8_ROUNDS(2);                  \
+    SK512_8_ROUNDS(3);  SK512_8_ROUNDS(4);  SK512_8_ROUNDS(5);                  \
+    SK512_8_ROUNDS(6);  SK512_8_ROUNDS(7);  SK512_8_ROUNDS(8);                  \
+                                                                                \
+    X[0] = x0 ^ W[0];   X[1] = x1 ^ W[1];   X[2] = x2 ^ W[2];   X[3] = x3 ^ W[3]; \
+    X[4] = x4 ^ W[4];   X[5] = x5 ^ W[5];   X[6] = x6 ^ W[6];   X[7] = x7 ^ W[7]; \
+}
+
+/* the same four lanes built for AVX-512VL get a single instruction rotate */
+
+__attribute__ ((target ("avx2")))
+static void sSkein256_Block4(uint64_t *state, const uint64_t *words, const uint64_t *tweak)
+SK256_BLOCK_BODY
+
+__attribute__ ((target ("avx512f,avx512vl")))
+static void sSkein256_Block4VL(uint64_t *state, const uint64_t *words, const uint64_t *tweak)
+SK256_BLOCK_BODY
+
+__attribute__ ((target ("avx2")))
+static void sSkein512_Block4(uint64_t *state, const uint64_t *words, const uint64_t *tweak)
+SK512_BLOCK_BODY
+
+__attribute__ ((target ("avx512f,avx512vl")))
+static void sSkein512_Block4VL(uint64_t *state, const uint64_t *words, const uint64_t *tweak)
+SK512_BLOCK_BODY
+
+#ifdef __clang__
+#pragma mark - Skein lane scheduler
+#endif
+
+#define kSK_Lanes           4
+
+typedef void (*sSK_BlockProc)(uint64_t *state, const uint64_t *words, const uint64_t *tweak);
+
+typedef struct sSK_Info
+{
+    size_t              words;          /* 4 for Skein-256, 8 for Skein-512 */
+    size_t              hashSize;       /* output bytes the configuration asks for */
+    uint64_t            iv[8];          /* chaining value after the config (and key) blocks */
+    sSK_BlockProc       block;
+} sSK_Info;
+
+typedef struct sSK_Lane
+{
+    size_t              msg;            /* index of the message in this lane */
+    const uint8_t       *in;
+    size_t              remaining;      /* message bytes not yet run through UBI */
+    uint64_t            T0;
+    uint64_t            T1;
+    bool                output;         /* running the output counter blocks */
+    size_t              outBlock;
+    size_t              outBlocks;
+    uint64_t            G[8];           /* chaining value at the end of the message */
+    uint8_t             digest[128];
+    uint8_t             tail[64];
+} sSK_Lane;
+
+/* start from a one shot tomcrypt context so the batch uses the exact same
+   configuration as HASH_DO and MAC_Init */
+static bool sSK_InfoForHash(HASH_Algorithm algorithm, const void *macKey, size_t macKeyLen, bool isMAC, sSK_Info *info)
+{
+    SkeinCtx_t  ctx;
+    SkeinSize_t size;
+    bool        vl = sCPU_Has(kS4CPU_AVX512F | kS4CPU_AVX512VL);
+
+    if(!sCPU_Has(kS4CPU_AVX2))
+        return false;
+
+    switch(algorithm)
+    {
+        case kHASH_Algorithm_SKEIN256:
+            size = Skein256;
+            info->words = 4;
+            info->block = vl ? sSkein256_Block4VL : sSkein256_Block4;
+            break;
+
+        case kHASH_Algorithm_SKEIN512:
+            size = Skein512;
+            info->words = 8;
+            info->block = vl ? sSkein512_Block4VL : sSkein512_Block4;
+            break;
+
+        default:
+            return false;
+    }
+
+    skeinCtxPrepare(&ctx, size);
+
+    /* skeinmac_init always configures a 512 bit output */
+    if(isMAC)
+        skeinMacInit(&ctx, macKey, macKeyLen, 512);
+    else
+        skeinInit(&ctx, size);
+
+    info->hashSize = (ctx.m.h.hashBitLen + 7) >> 3;
+    COPY((size == Skein256 ? ctx.m.s256.X : ctx.m.s512.X), info->iv, info->words * sizeof(uint64_t));
+
+    ZERO(&ctx, sizeof(ctx));
+
+    return true;
+}
+
+static void sSK_LoadLane(const sSK_Info *info, uint64_t *state, sSK_Lane *lane,
+                         size_t msg, const unsigned char *in, unsigned long inlen, unsigned long outLen, size_t laneNo)
+{
+    size_t  blockSize = info->words * 8;
+    size_t  outBytes  = outLen < info->hashSize ? outLen : info->hashSize;
+    size_t  i;
+
+    for (i = 0; i < info->words; i++)
+        state[i * kSK_Lanes + laneNo] = info->iv[i];
+
+    lane->msg       = msg;
+    lane->in        = in;
+    lane->remaining = inlen;
+    lane->T0        = 0;
+    lane->T1        = SKEIN_T1_FLAG_FIRST | SKEIN_T1_BLK_TYPE_MSG;
+    lane->output    = false;
+    lane->outBlock  = 0;
+    lane->outBlocks = (outBytes + blockSize - 1) / blockSize;
+}
+
+/* pick the lane's next block and tweak, false when the lane has nothing left */
+static const uint8_t* sSK_NextBlock(const sSK_Info *info, sSK_Lane *lane)
+{
+    size_t      blockSize = info->words * 8;
+    const uint8_t *block;
+
+    if(!lane->output)
+    {
+        /* the last block, full or not, is held back so it can be flagged final */
+        if(lane->remaining > blockSize)
+        {
+            block = lane->in;
+            lane->in        += blockSize;
+            lane->remaining -= blockSize;
+            lane->T0        += blockSize;
+        }
+        else
+        {
+            ZERO(lane->tail, blockSize);
+            COPY(lane->in, lane->tail, lane->remaining);
+            lane->T0        += lane->remaining;
+            lane->T1        |= SKEIN_T1_FLAG_FINAL;
+            lane->remaining = 0;
+            block = lane->tail;
+        }
+    }
+    else
+    {
+        /* output stage: Threefish in counter mode keyed by G */
+        ZERO(lane->tail, blockSize);
+        sStore64LE(lane->outBlock, lane->tail);
+        lane->T0 = sizeof(uint64_t);
+        lane->T1 = SKEIN_T1_FLAG_FIRST | SKEIN_T1_BLK_TYPE_OUT_FINAL;
+        block = lane->tail;
+    }
+
+    return block;
+}
+
+/* after a block ran, true when the lane's digest is complete */
+static bool sSK_BlockDone(const sSK_Info *info, uint64_t *state, sSK_Lane *lane, size_t laneNo)
+{
+    size_t  blockSize = info->words * 8;
+    size_t  i;
+
+    if(!lane->output)
+    {
+        lane->T1 &= ~SKEIN_T1_FLAG_FIRST;
+
+        if(lane->T1 & SKEIN_T1_FLAG_FINAL)
+        {
+            for (i = 0; i < info->words; i++)
+                lane->G[i] = state[i * kSK_Lanes + laneNo];
+            lane->output = true;
+        }
+        return false;
+    }
+
+    for (i = 0; i < info->words; i++)
+    {
+        sStore64LE(state[i * kSK_Lanes + laneNo], lane->digest + lane->outBlock * blockSize + 8 * i);
+        state[i * kSK_Lanes + laneNo] = lane->G[i];
+    }
+
+    return (++lane->outBlock == lane->outBlocks);
+}
+
+static S4Err sSkein_DOBatchMB(const sSK_Info     *info,
+                              size_t              count,
+                              const unsigned char *in[],
+                              const unsigned long inlen[],
+                              unsigned long       outLen,
+                              uint8_t             *out[])
+{
+    S4Err           err = kS4Err_NoErr;
+    uint64_t        state[8 * kSK_Lanes] __attribute__((aligned(32)));
+    uint64_t        words[8 * kSK_Lanes] __attribute__((aligned(32)));
+    uint64_t        tweak[2 * kSK_Lanes] __attribute__((aligned(32)));
+    sSK_Lane        *lanes = NULL;
+    bool            active[kSK_Lanes];
+    size_t          outBytes  = outLen < info->hashSize ? outLen : info->hashSize;
+    size_t          next = 0;
+    size_t          l, i;
+
+    lanes = XMALLOC(sizeof(sSK_Lane) * kSK_Lanes); CKNULL(lanes);
+
+    ZERO(state, sizeof(state));
+    for (l = 0; l < kSK_Lanes; l++)
+        active[l] = false;
+
+    for(;;)
+    {
+        size_t  running = 0;
+
+        for (l = 0; l < kSK_Lanes; l++)
+        {
+            const uint8_t *block;
+
+            if(!active[l] && next < count)
+            {
+                sSK_LoadLane(info, state, &lanes[l], next, in[next], inlen[next], outLen, l);
+                active[l] = true;
+                next++;
+            }
+
+            /* idle lanes just encrypt zeros */
+            if(!active[l])
+            {
+                for (i = 0; i < info->words; i++)
+                    words[i * kSK_Lanes + l] = 0;
+                tweak[l] = tweak[kSK_Lanes + l] = 0;
+                continue;
+            }
+
+            block = sSK_NextBlock(info, &lanes[l]);
+
+            for (i = 0; i < info->words; i++)
+                words[i * kSK_Lanes + l] = sLoad64LE(block + 8 * i);
+
+            tweak[l]             = lanes[l].T0;
+            tweak[kSK_Lanes + l] = lanes[l].T1;
+            running++;
+        }
+
+        if(running == 0)
+            break;
+
+        (info->block)(state, words, tweak);
+
+        for (l = 0; l < kSK_Lanes; l++)
+        {
+            if(active[l] && sSK_BlockDone(info, state, &lanes[l], l))
+            {
+                COPY(lanes[l].digest, out[lanes[l].msg], outBytes);
+                active[l] = false;
+            }
+        }
+    }
+
+done:
+
+    if(lanes)
+    {
+        ZERO(lanes, sizeof(sSK_Lane) * kSK_Lanes);
+        XFREE(lanes);
+    }
+
+    ZERO(state, sizeof(state));
+    ZERO(words, sizeof(words));
+
+    return err;
+}
+
+#endif /* LTC_X86_SIMD */
+
+#ifdef __clang__
+#pragma mark - Batch hash API
+#endif
+
+S4Err HASH_DOBatch(HASH_Algorithm       algorithm,
+                   size_t               count,
+                   const unsigned char  *in[],
+                   const unsigned long  inlen[],
+                   unsigned long        outLen,
+                   uint8_t              *out[])
+{
+    S4Err       err = kS4Err_NoErr;
+    size_t      i;
+
+    ValidateParam(in);
+    ValidateParam(inlen);
+    ValidateParam(out);
+
+#if defined(LTC_X86_SIMD)
+    {
+        sMB_Info    info;
+
+        sSK_Info    skInfo;
+
+        /* a partially filled lane set costs as much as a full one */
+        if(count > 1 && sMB_InfoForHash(algorithm, &info))
+            return sHASH_DOBatchMB(&info, count, in, inlen, outLen, out);
+
+        if(count > 1 && sSK_InfoForHash(algorithm, NULL, 0, false, &skInfo))
+            return sSkein_DOBatchMB(&skInfo, count, in, inlen, outLen, out);
+    }
+#endif
+
+    for (i = 0; i < count; i++)
+    {
+        err = HASH_DO(algorithm, in[i], inlen[i], outLen, out[i]); CKERR;
+    }
+
+done:
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Batch MAC API
+#endif
+
+S4Err MAC_DOBatch(MAC_Algorithm        mac,
+                  HASH_Algorithm       hash,
+                  const void           *macKey,
+                  size_t               macKeyLen,
+                  size_t               count,
+                  const unsigned char  *in[],
+                  const unsigned long  inlen[],
+                  unsigned long        outLen,
+                  uint8_t              *out[])
+{
+    S4Err           err = kS4Err_NoErr;
+    MAC_ContextRef  macRef = kInvalidMAC_ContextRef;
+    uint8_t         macBuf[kMAC_ContextAllocSize];
+    size_t          i;
+
+    ValidateParam(macKey);
+    ValidateParam(in);
+    ValidateParam(inlen);
+    ValidateParam(out);
+
+#if defined(LTC_X86_SIMD)
+    if(mac == kMAC_Algorithm_SKEIN && count > 1)
+    {
+        sSK_Info    skInfo;
+
+        if(sSK_InfoForHash(hash, macKey, macKeyLen, true, &skInfo))
+        {
+            err = sSkein_DOBatchMB(&skInfo, count, in, inlen, outLen, out);
+            ZERO(&skInfo, sizeof(skInfo));
+            return err;
+        }
+    }
+#endif
+
+    /* key once, then restart the context for each message */
+    err = MAC_InitInPlace(mac, hash, macKey, macKeyLen, macBuf, sizeof(macBuf), &macRef); CKERR;
+
+    for (i = 0; i < count; i++)
+    {
+        size_t  resultLen = outLen;
+
+        if(i > 0)
+        {
+            err = MAC_Reset(macRef); CKERR;
+        }
+
+        err = MAC_Update(macRef, in[i], inlen[i]); CKERR;
+        err = MAC_Final(macRef, out[i], &resultLen); CKERR;
+    }
+
+done:
+
+    if(IsntNull(macRef))
+        MAC_Free(macRef);
+
+    return err;
+}
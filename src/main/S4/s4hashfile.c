@@ -0,0 +1,368 @@
+//
+//  s4HashFile.c
+//  S4
+//
+//  Hashing and MACing whole files.  Regular files are memory mapped and
+//  walked in windows, asking the kernel to read the next window while the
+//  current one is hashed.  Anything that can not be mapped (pipes, devices,
+//  files larger than the address space) is read on a background thread
+//  into two buffers, so the read of one overlaps the hashing of the other.
+//  Truncating a file while it is mapped can raise SIGBUS, see sFILE_FeedMapped.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "s4Internal.h"
+
+/* mapped files are hashed this much at a time, with the next window read ahead */
+#define kFILE_WindowSize        (8 << 20)
+
+/* each of the two reader thread buffers */
+#define kFILE_BufferSize        (1 << 20)
+
+
+#ifdef __clang__
+#pragma mark - Mapped files
+#endif
+
+/* *mapped is false when the file could not be mapped and nothing was hashed.
+ A page past the end of a file that shrinks under the map raises SIGBUS, the
+ size is checked before each window so a file truncated while it is hashed
+ fails with kS4Err_CorruptData, but one truncated inside the window being
+ hashed still takes the signal.  Callers that hash files other processes
+ may truncate should handle SIGBUS */
+static S4Err sFILE_FeedMapped(int fd, size_t fileSize, sFILE_UpdateProc update, void *ref, bool *mapped)
+{
+    S4Err       err = kS4Err_NoErr;
+    uint8_t     *map = NULL;
+    size_t      offset, n;
+    struct stat st;
+
+    *mapped = false;
+
+    map = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED)
+        return kS4Err_ResourceUnavailable;
+
+    *mapped = true;
+
+    posix_madvise(map, fileSize, POSIX_MADV_SEQUENTIAL);
+
+    for(offset = 0; offset < fileSize; offset += n)
+    {
+        n = MIN(fileSize - offset, kFILE_WindowSize);
+
+        if(fstat(fd, &st) != 0 || (uintmax_t) st.st_size < offset + n)
+            RETERR(kS4Err_CorruptData);
+
+        /* start the read of the next window before hashing this one */
+        if(offset + n < fileSize)
+            posix_madvise(map + offset + n, MIN(fileSize - offset - n, kFILE_WindowSize), POSIX_MADV_WILLNEED);
+
+        err = update(ref, map + offset, n); CKERR;
+    }
+
+done:
+
+    munmap(map, fileSize);
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Reader thread
+#endif
+
+typedef struct
+{
+    int             fd;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+
+    uint8_t         *buf[2];
+    size_t          len[2];
+    bool            full[2];            /* guarded by lock */
+    bool            quit;               /* the hashing side gave up */
+    bool            readError;
+} sFILE_Reader;
+
+/* fill the buffers in turn, an empty buffer marks the end of the file */
+
+static void* sFILE_ReaderThread(void *arg)
+{
+    sFILE_Reader    *rd = arg;
+    int             slot = 0;
+    bool            eof = false;
+
+    while(!eof)
+    {
+        size_t  len = 0;
+
+        pthread_mutex_lock(&rd->lock);
+        while(rd->full[slot] && !rd->quit)
+            pthread_cond_wait(&rd->cond, &rd->lock);
+        pthread_mutex_unlock(&rd->lock);
+
+        if(rd->quit)
+            break;
+
+        /* pipes hand over what they have, keep going until the buffer is full */
+        while(len < kFILE_BufferSize)
+        {
+            ssize_t got = read(rd->fd, rd->buf[slot] + len, kFILE_BufferSize - len);
+
+            if(got < 0 && errno == EINTR)
+                continue;
+
+            if(got <= 0)
+            {
+                rd->readError = got < 0;
+                eof = true;
+                break;
+            }
+
+            len += got;
+        }
+
+        pthread_mutex_lock(&rd->lock);
+        rd->len[slot]   = len;
+        rd->full[slot]  = true;
+        pthread_cond_broadcast(&rd->cond);
+        pthread_mutex_unlock(&rd->lock);
+
+        /* a short last buffer still needs the empty one after it */
+        if(eof && len > 0)
+        {
+            slot ^= 1;
+
+            pthread_mutex_lock(&rd->lock);
+            while(rd->full[slot] && !rd->quit)
+                pthread_cond_wait(&rd->cond, &rd->lock);
+            rd->len[slot]   = 0;
+            rd->full[slot]  = true;
+            pthread_cond_broadcast(&rd->cond);
+            pthread_mutex_unlock(&rd->lock);
+        }
+
+        slot ^= 1;
+    }
+
+    return NULL;
+}
+
+static S4Err sFILE_FeedThreaded(int fd, sFILE_UpdateProc update, void *ref)
+{
+    S4Err           err = kS4Err_NoErr;
+    sFILE_Reader    rd;
+    pthread_t       thread;
+    bool            started = false;
+    int             slot = 0;
+
+    ZERO(&rd, sizeof(rd));
+    rd.fd = fd;
+
+    rd.buf[0] = XMALLOC(kFILE_BufferSize); CKNULL(rd.buf[0]);
+    rd.buf[1] = XMALLOC(kFILE_BufferSize); CKNULL(rd.buf[1]);
+
+    pthread_mutex_init(&rd.lock, NULL);
+    pthread_cond_init(&rd.cond, NULL);
+
+    if(pthread_create(&thread, NULL, sFILE_ReaderThread, &rd) != 0)
+        RETERR(kS4Err_ResourceUnavailable);
+    started = true;
+
+    for(;;)
+    {
+        size_t  len;
+
+        pthread_mutex_lock(&rd.lock);
+        while(!rd.full[slot])
+            pthread_cond_wait(&rd.cond, &rd.lock);
+        len = rd.len[slot];
+        pthread_mutex_unlock(&rd.lock);
+
+        if(len == 0)
+            break;
+
+        err = update(ref, rd.buf[slot], len); CKERR;
+
+        pthread_mutex_lock(&rd.lock);
+        rd.full[slot] = false;
+        pthread_cond_broadcast(&rd.cond);
+        pthread_mutex_unlock(&rd.lock);
+
+        slot ^= 1;
+    }
+
+    if(rd.readError)
+        err = kS4Err_ResourceUnavailable;
+
+done:
+
+    if(started)
+    {
+        pthread_mutex_lock(&rd.lock);
+        rd.quit = true;
+        pthread_cond_broadcast(&rd.cond);
+        pthread_mutex_unlock(&rd.lock);
+
+        pthread_join(thread, NULL);
+
+        pthread_cond_destroy(&rd.cond);
+        pthread_mutex_destroy(&rd.lock);
+    }
+
+    if(rd.buf[0])
+    {
+        ZERO(rd.buf[0], kFILE_BufferSize);
+        XFREE(rd.buf[0]);
+    }
+
+    if(rd.buf[1])
+    {
+        ZERO(rd.buf[1], kFILE_BufferSize);
+        XFREE(rd.buf[1]);
+    }
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Public
+#endif
+
+S4Err sFILE_Feed(const char *path, sFILE_UpdateProc update, void *ref)
+{
+    S4Err       err = kS4Err_NoErr;
+    struct stat st;
+    int         fd = -1;
+
+    ValidateParam(path);
+    ValidateParam(update);
+
+    do {
+        fd = open(path, O_RDONLY);
+    } while(fd < 0 && errno == EINTR);
+
+    if(fd < 0)
+        RETERR(kS4Err_ResourceUnavailable);
+
+    if(fstat(fd, &st) != 0)
+        RETERR(kS4Err_ResourceUnavailable);
+
+    /* empty files can not be mapped, and their size says nothing for special files */
+    if(S_ISREG(st.st_mode) && st.st_size > 0 && (uintmax_t) st.st_size <= SIZE_MAX)
+    {
+        bool    mapped;
+
+        err = sFILE_FeedMapped(fd, (size_t) st.st_size, update, ref, &mapped);
+
+        /* only a file that could not be mapped is read instead, an error
+           after some of it was hashed is the caller's */
+        if(mapped)
+            goto done;
+
+        err = kS4Err_NoErr;
+    }
+
+    err = sFILE_FeedThreaded(fd, update, ref);
+
+done:
+
+    if(fd >= 0)
+        close(fd);
+
+    return err;
+}
+
+static S4Err sFILE_HashUpdate(void *ref, const void *data, size_t len)
+{
+    return HASH_Update((HASH_ContextRef) ref, data, len);
+}
+
+static S4Err sFILE_MACUpdate(void *ref, const void *data, size_t len)
+{
+    return MAC_Update((MAC_ContextRef) ref, data, len);
+}
+
+S4Err HASH_File(HASH_Algorithm algorithm, const char *path, unsigned long outLen, uint8_t *out)
+{
+    S4Err               err         = kS4Err_NoErr;
+    HASH_ContextRef     hashRef     = kInvalidHASH_ContextRef;
+    uint8_t             ctxBuf[kHASH_ContextAllocSize];
+    uint8_t             hashBuf[128];
+    uint8_t             *p = (outLen < sizeof(hashBuf))?hashBuf:out;
+
+    ValidateParam(path);
+    ValidateParam(out);
+
+    if(algorithm == kHASH_Algorithm_SKEIN512_TREE || algorithm == kHASH_Algorithm_SKEIN1024_TREE)
+        err = HASH_Init(algorithm, &hashRef);
+    else
+        err = HASH_InitInPlace(algorithm, ctxBuf, sizeof(ctxBuf), &hashRef);
+    CKERR;
+
+    /* extendable output, produce exactly outLen bytes */
+    if(algorithm == kHASH_Algorithm_BLAKE3)
+    {
+        err = HASH_SetOutputSize(hashRef, outLen); CKERR;
+        p = out;
+    }
+
+    err = sFILE_Feed(path, sFILE_HashUpdate, hashRef); CKERR;
+    err = HASH_Final(hashRef, p); CKERR;
+
+    if(p != out)
+        COPY(hashBuf, out, outLen);
+
+done:
+
+    if(HASH_ContextRefIsValid(hashRef))
+        HASH_Free(hashRef);
+
+    ZERO(hashBuf, sizeof(hashBuf));
+
+    return err;
+}
+
+S4Err MAC_File(MAC_Algorithm        mac,
+               HASH_Algorithm       hash,
+               const void           *macKey,
+               size_t               macKeyLen,
+               const char           *path,
+               unsigned long        outLen,
+               uint8_t              *out)
+{
+    S4Err               err         = kS4Err_NoErr;
+    MAC_ContextRef      macRef      = kInvalidMAC_ContextRef;
+    uint8_t             ctxBuf[kMAC_ContextAllocSize];
+    size_t              resultLen   = outLen;
+
+    ValidateParam(path);
+    ValidateParam(out);
+
+    err = MAC_InitInPlace(mac, hash, macKey, macKeyLen, ctxBuf, sizeof(ctxBuf), &macRef); CKERR;
+
+    err = sFILE_Feed(path, sFILE_MACUpdate, macRef); CKERR;
+    err = MAC_Final(macRef, out, &resultLen); CKERR;
+
+done:
+
+    if(MAC_ContextRefIsValid(macRef))
+        MAC_Free(macRef);
+
+    return err;
+}
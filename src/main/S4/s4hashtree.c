@@ -0,0 +1,521 @@
+//
+//  s4HashTree.c
+//  S4
+//
+//  Skein tree hashing (Skein 1.3 spec, section 3.5.6).  The message is cut
+//  into leaves of Nb * 2^Yl bytes which are hashed on a pool of worker
+//  threads, the leaf results are then combined in nodes of 2^Yf children
+//  until a single Nb byte result is left.  Leaf results are always fed to
+//  the parent stage in message order, so the digest does not depend on the
+//  number of threads.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "s4Internal.h"
+
+/* levels are bounded by the message length: 2^64 bytes in leaves of at
+   least 2 blocks with a fan-out of at least 2 */
+#define kSkeinTree_MaxLevels        64
+
+#define kSkeinTree_MaxThreads       16
+
+/* leaves buffered per worker thread before a batch is handed to the pool */
+#define kSkeinTree_LeavesPerThread  2
+
+typedef union
+{
+    Skein_Ctxt_Hdr_t    h;
+    Skein_512_Ctxt_t    s512;
+    Skein1024_Ctxt_t    s1024;
+} sTree_UBI;
+
+typedef struct
+{
+    sTree_UBI       node;                           /* node in progress, one level up */
+    uint64_t        count;                          /* child results received */
+    uint64_t        nodeIndex;
+    size_t          nodeFill;
+    uint8_t         first[SKEIN1024_STATE_BYTES];   /* kept in case it ends up the only one */
+} sTree_Level;
+
+typedef struct
+{
+    pthread_t       *threads;
+    uint32_t        threadCount;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  work;
+    pthread_cond_t  idle;
+    bool            quit;
+
+    /* current job, guarded by lock */
+    const uint8_t   *data;
+    size_t          dataLen;
+    uint64_t        firstLeaf;
+    size_t          leaves;
+    size_t          next;
+    size_t          finished;
+} sTree_Pool;
+
+struct SkeinTree_Context
+{
+    size_t          stateBytes;                     /* Nb */
+    size_t          hashBitLen;
+    size_t          leafBytes;                      /* Nl = Nb * 2^Yl */
+    size_t          nodeBytes;                      /* Nn = Nb * 2^Yf */
+    uint8_t         maxHeight;                      /* Ym */
+
+    u64b_t          K[SKEIN_MAX_STATE_WORDS];       /* chaining value after the tree config block */
+
+    uint8_t         *leafBuf;
+    size_t          leafBufSize;
+    size_t          leafFill;
+    uint8_t         *leafOut;
+    uint64_t        leafCount;
+
+    sTree_Pool      *pool;
+
+    sTree_Level     level[kSkeinTree_MaxLevels + 1];
+};
+
+
+#ifdef __clang__
+#pragma mark - UBI
+#endif
+
+static void sTree_UBIStart(const SkeinTree_Context *tree, sTree_UBI *ubi, uint64_t position, unsigned level)
+{
+    ubi->h.hashBitLen   = tree->hashBitLen;
+    ubi->h.bCnt         = 0;
+    ubi->h.T[0]         = position;
+    ubi->h.T[1]         = SKEIN_T1_FLAG_FIRST | SKEIN_T1_BLK_TYPE_MSG | SKEIN_T1_TREE_LEVEL(level);
+
+    if(tree->stateBytes == SKEIN1024_STATE_BYTES)
+        COPY(tree->K, ubi->s1024.X, SKEIN1024_STATE_BYTES);
+    else
+        COPY(tree->K, ubi->s512.X, SKEIN_512_STATE_BYTES);
+}
+
+static void sTree_UBIUpdate(const SkeinTree_Context *tree, sTree_UBI *ubi, const uint8_t *in, size_t inlen)
+{
+    if(tree->stateBytes == SKEIN1024_STATE_BYTES)
+        Skein1024_Update(&ubi->s1024, in, inlen);
+    else
+        Skein_512_Update(&ubi->s512, in, inlen);
+}
+
+static void sTree_UBIFinal(const SkeinTree_Context *tree, sTree_UBI *ubi, uint8_t *out)
+{
+    if(tree->stateBytes == SKEIN1024_STATE_BYTES)
+        Skein1024_Final_Pad(&ubi->s1024, out);
+    else
+        Skein_512_Final_Pad(&ubi->s512, out);
+}
+
+static void sTree_HashLeaf(const SkeinTree_Context *tree, const uint8_t *in, size_t inlen, uint64_t index, uint8_t *out)
+{
+    sTree_UBI   ubi;
+
+    sTree_UBIStart(tree, &ubi, index * tree->leafBytes, 1);
+    sTree_UBIUpdate(tree, &ubi, in, inlen);
+    sTree_UBIFinal(tree, &ubi, out);
+
+    ZERO(&ubi, sizeof(ubi));
+}
+
+
+#ifdef __clang__
+#pragma mark - Worker pool
+#endif
+
+/* hash leaves of the current job until there are none left, called with the lock held */
+
+static void sTree_RunLeaves(SkeinTree_Context *tree, sTree_Pool *pool)
+{
+    while(pool->next < pool->leaves)
+    {
+        size_t          i       = pool->next++;
+        size_t          offset  = i * tree->leafBytes;
+        size_t          len     = MIN(tree->leafBytes, pool->dataLen - offset);
+        const uint8_t   *data   = pool->data;
+
+        pthread_mutex_unlock(&pool->lock);
+
+        sTree_HashLeaf(tree, data + offset, len, pool->firstLeaf + i, tree->leafOut + i * tree->stateBytes);
+
+        pthread_mutex_lock(&pool->lock);
+
+        if(++pool->finished == pool->leaves)
+            pthread_cond_signal(&pool->idle);
+    }
+}
+
+static void* sTree_Worker(void *arg)
+{
+    SkeinTree_Context   *tree = arg;
+    sTree_Pool          *pool = tree->pool;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for(;;)
+    {
+        while(!pool->quit && pool->next >= pool->leaves)
+            pthread_cond_wait(&pool->work, &pool->lock);
+
+        if(pool->quit)
+            break;
+
+        sTree_RunLeaves(tree, pool);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void sTree_PoolFree(sTree_Pool *pool)
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(i = 0; i < pool->threadCount; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+
+    XFREE(pool->threads);
+    XFREE(pool);
+}
+
+static S4Err sTree_PoolInit(SkeinTree_Context *tree, uint32_t workers)
+{
+    S4Err       err = kS4Err_NoErr;
+    sTree_Pool  *pool = NULL;
+
+    pool = XMALLOC(sizeof(sTree_Pool)); CKNULL(pool);
+    ZERO(pool, sizeof(sTree_Pool));
+
+    pool->threads = XMALLOC(sizeof(pthread_t) * workers); CKNULL(pool->threads);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    tree->pool = pool;
+
+    for(; pool->threadCount < workers; pool->threadCount++)
+    {
+        if(pthread_create(&pool->threads[pool->threadCount], NULL, sTree_Worker, tree) != 0)
+            break;
+    }
+
+    /* running with fewer threads only costs speed */
+    if(pool->threadCount == 0)
+    {
+        sTree_PoolFree(pool);
+        tree->pool = NULL;
+    }
+
+    pool = NULL;
+
+done:
+
+    if(IsntNull(pool))
+    {
+        if(pool->threads) XFREE(pool->threads);
+        XFREE(pool);
+    }
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Tree
+#endif
+
+/* add one Nb byte result to level l.  A full node is only closed when the
+   next child shows up, because a level holding a single result is the root */
+
+static void sTree_Push(SkeinTree_Context *tree, unsigned l, const uint8_t *child)
+{
+    sTree_Level *lvl    = &tree->level[l];
+    bool        top     = (l + 1 == tree->maxHeight) || (l == kSkeinTree_MaxLevels);
+
+    if(lvl->count == 0)
+    {
+        COPY(child, lvl->first, tree->stateBytes);
+        sTree_UBIStart(tree, &lvl->node, 0, l + 1);
+    }
+    else if(!top && lvl->nodeFill == tree->nodeBytes)
+    {
+        uint8_t     result[SKEIN1024_STATE_BYTES];
+
+        sTree_UBIFinal(tree, &lvl->node, result);
+        sTree_Push(tree, l + 1, result);
+
+        lvl->nodeIndex++;
+        lvl->nodeFill = 0;
+        sTree_UBIStart(tree, &lvl->node, lvl->nodeIndex * tree->nodeBytes, l + 1);
+    }
+
+    sTree_UBIUpdate(tree, &lvl->node, child, tree->stateBytes);
+    lvl->nodeFill += tree->stateBytes;
+    lvl->count++;
+}
+
+/* hash the leaves in data, the last one may be short.  An empty message is a single empty leaf */
+
+static void sTree_HashLeaves(SkeinTree_Context *tree, const uint8_t *data, size_t dataLen)
+{
+    size_t  leaves = dataLen ? (dataLen + tree->leafBytes - 1) / tree->leafBytes : 1;
+    size_t  i;
+
+    if(tree->pool && leaves > 1)
+    {
+        sTree_Pool *pool = tree->pool;
+
+        pthread_mutex_lock(&pool->lock);
+
+        pool->data      = data;
+        pool->dataLen   = dataLen;
+        pool->firstLeaf = tree->leafCount;
+        pool->leaves    = leaves;
+        pool->next      = 0;
+        pool->finished  = 0;
+
+        pthread_cond_broadcast(&pool->work);
+
+        sTree_RunLeaves(tree, pool);
+
+        while(pool->finished < pool->leaves)
+            pthread_cond_wait(&pool->idle, &pool->lock);
+
+        pthread_mutex_unlock(&pool->lock);
+    }
+    else
+    {
+        for(i = 0; i < leaves; i++)
+        {
+            size_t offset = i * tree->leafBytes;
+
+            sTree_HashLeaf(tree, data + offset, MIN(tree->leafBytes, dataLen - offset),
+                           tree->leafCount + i, tree->leafOut + i * tree->stateBytes);
+        }
+    }
+
+    for(i = 0; i < leaves; i++)
+        sTree_Push(tree, 1, tree->leafOut + i * tree->stateBytes);
+
+    tree->leafCount += leaves;
+}
+
+
+#ifdef __clang__
+#pragma mark - Public
+#endif
+
+S4Err sSkeinTree_Init(HASH_Algorithm algorithm,
+                      uint8_t   leafSizeExp,
+                      uint8_t   fanOutExp,
+                      uint8_t   maxHeight,
+                      uint32_t  threadCount,
+                      SkeinTree_Context **ctx)
+{
+    S4Err               err = kS4Err_NoErr;
+    SkeinTree_Context   *tree = NULL;
+    u64b_t              treeInfo = SKEIN_CFG_TREE_INFO(leafSizeExp, fanOutExp, maxHeight);
+    size_t              stateBytes;
+
+    ValidateParam(ctx);
+    *ctx = NULL;
+
+    switch(algorithm)
+    {
+        case kHASH_Algorithm_SKEIN512_TREE:     stateBytes = SKEIN_512_STATE_BYTES; break;
+        case kHASH_Algorithm_SKEIN1024_TREE:    stateBytes = SKEIN1024_STATE_BYTES; break;
+        default:
+            RETERR(kS4Err_BadHashNumber);
+    }
+
+    /* Yl and Yf of at least 1, Ym of at least 2.  Leaves are buffered, so Yl is capped to
+       keep the leaf buffer at 64 MB for 16 threads; nodes are streamed, Yf only has to fit a size_t */
+    if(leafSizeExp < 1 || fanOutExp < 1 || maxHeight < 2
+       || leafSizeExp > kHASH_SkeinTree_MaxLeafSizeExp || fanOutExp > 20)
+        RETERR(kS4Err_BadParams);
+
+    if(threadCount == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpus > 0 ? (uint32_t) cpus : 1;
+    }
+    threadCount = MIN(threadCount, kSkeinTree_MaxThreads);
+
+    tree = XMALLOC(sizeof(SkeinTree_Context)); CKNULL(tree);
+    ZERO(tree, sizeof(SkeinTree_Context));
+
+    tree->stateBytes    = stateBytes;
+    tree->hashBitLen    = stateBytes * 8;
+    tree->leafBytes     = stateBytes << leafSizeExp;
+    tree->nodeBytes     = stateBytes << fanOutExp;
+    tree->maxHeight     = maxHeight;
+
+    if(stateBytes == SKEIN1024_STATE_BYTES)
+    {
+        Skein1024_Ctxt_t    skein;
+
+        Skein1024_InitExt(&skein, tree->hashBitLen, treeInfo, NULL, 0);
+        COPY(skein.X, tree->K, sizeof(skein.X));
+        ZERO(&skein, sizeof(skein));
+    }
+    else
+    {
+        Skein_512_Ctxt_t    skein;
+
+        Skein_512_InitExt(&skein, tree->hashBitLen, treeInfo, NULL, 0);
+        COPY(skein.X, tree->K, sizeof(skein.X));
+        ZERO(&skein, sizeof(skein));
+    }
+
+    tree->leafBufSize   = tree->leafBytes * threadCount * kSkeinTree_LeavesPerThread;
+    tree->leafBuf       = XMALLOC(tree->leafBufSize); CKNULL(tree->leafBuf);
+    tree->leafOut       = XMALLOC(stateBytes * threadCount * kSkeinTree_LeavesPerThread); CKNULL(tree->leafOut);
+
+    if(threadCount > 1)
+    {
+        err = sTree_PoolInit(tree, threadCount - 1); CKERR;
+    }
+
+    *ctx = tree;
+
+done:
+
+    if(IsS4Err(err) && IsntNull(tree))
+        sSkeinTree_Free(tree);
+
+    return err;
+}
+
+int sSkeinTree_Process(SkeinTree_Context *tree, const unsigned char *in, unsigned long inlen)
+{
+    while(inlen > 0)
+    {
+        size_t n;
+
+        /* whole batches go straight from the caller's buffer */
+        if(tree->leafFill == 0 && inlen >= tree->leafBufSize)
+        {
+            sTree_HashLeaves(tree, in, tree->leafBufSize);
+            in      += tree->leafBufSize;
+            inlen   -= tree->leafBufSize;
+            continue;
+        }
+
+        n = MIN(inlen, tree->leafBufSize - tree->leafFill);
+        COPY(in, tree->leafBuf + tree->leafFill, n);
+        tree->leafFill  += n;
+        in              += n;
+        inlen           -= n;
+
+        if(tree->leafFill == tree->leafBufSize)
+        {
+            sTree_HashLeaves(tree, tree->leafBuf, tree->leafFill);
+            tree->leafFill = 0;
+        }
+    }
+
+    return CRYPT_OK;
+}
+
+int sSkeinTree_Done(SkeinTree_Context *tree, unsigned char *out)
+{
+    uint8_t     root[SKEIN1024_STATE_BYTES];
+    sTree_UBI   ubi;
+    unsigned    l;
+
+    if(tree->leafFill > 0 || tree->leafCount == 0)
+    {
+        sTree_HashLeaves(tree, tree->leafBuf, tree->leafFill);
+        tree->leafFill = 0;
+    }
+
+    /* close the open node on each level, until a level holds just one result */
+    for(l = 1; ; l++)
+    {
+        sTree_Level *lvl = &tree->level[l];
+
+        if(lvl->count == 1)
+        {
+            COPY(lvl->first, root, tree->stateBytes);
+            break;
+        }
+
+        sTree_UBIFinal(tree, &lvl->node, root);
+
+        if(l + 1 == tree->maxHeight || l == kSkeinTree_MaxLevels)
+            break;
+
+        sTree_Push(tree, l + 1, root);
+    }
+
+    /* output stage, keyed by the root */
+    ubi.h.hashBitLen = tree->hashBitLen;
+    ubi.h.bCnt = 0;
+
+    if(tree->stateBytes == SKEIN1024_STATE_BYTES)
+    {
+        Skein_Get64_LSB_First(ubi.s1024.X, root, SKEIN1024_STATE_WORDS);
+        Skein1024_Output(&ubi.s1024, out);
+    }
+    else
+    {
+        Skein_Get64_LSB_First(ubi.s512.X, root, SKEIN_512_STATE_WORDS);
+        Skein_512_Output(&ubi.s512, out);
+    }
+
+    ZERO(&ubi, sizeof(ubi));
+    ZERO(root, sizeof(root));
+
+    return CRYPT_OK;
+}
+
+void sSkeinTree_Reset(SkeinTree_Context *tree)
+{
+    /* the config chaining value, buffers and pool carry over to the next message */
+    tree->leafFill  = 0;
+    tree->leafCount = 0;
+    ZERO(tree->level, sizeof(tree->level));
+}
+
+void sSkeinTree_Free(SkeinTree_Context *tree)
+{
+    if(IsNull(tree))
+        return;
+
+    if(tree->pool)
+        sTree_PoolFree(tree->pool);
+
+    if(tree->leafBuf)
+    {
+        ZERO(tree->leafBuf, tree->leafBufSize);
+        XFREE(tree->leafBuf);
+    }
+
+    if(tree->leafOut)
+        XFREE(tree->leafOut);
+
+    ZERO(tree, sizeof(SkeinTree_Context));
+    XFREE(tree);
+}
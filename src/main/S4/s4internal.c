@@ -0,0 +1,92 @@
+//
+//  s4internal.c
+//  S4
+//
+//  Helpers the modes share that are not part of the API.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "s4Internal.h"
+
+#ifdef __clang__
+#pragma mark - Slices
+#endif
+
+typedef struct
+{
+    sSliceProc          proc;
+    void                *arg;
+    size_t              first;
+    size_t              count;
+    int                 status;
+} sSlice_Job;
+
+static void* sSlice_Thread(void *arg)
+{
+    sSlice_Job *job = arg;
+
+    job->status = (job->proc)(job->arg, job->first, job->count);
+
+    return NULL;
+}
+
+uint32_t sSliceThreadCount(uint32_t threadCount)
+{
+    if(threadCount == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpus > 0 ? (uint32_t) cpus : 1;
+    }
+
+    return MIN(threadCount, kS4_SliceMaxThreads);
+}
+
+int sSliceRun(sSliceProc proc, void *arg, size_t count, size_t itemSize, uint32_t threadCount)
+{
+    sSlice_Job  job[kS4_SliceMaxThreads];
+    pthread_t   thread[kS4_SliceMaxThreads];
+    bool        started[kS4_SliceMaxThreads];
+    size_t      threads = MIN(MIN(threadCount, kS4_SliceMaxThreads), count * itemSize / kS4_SliceBytes);
+    size_t      slice, offset = 0, i;
+    int         status = 0;
+
+    if(threads < 2)
+        return (proc)(arg, 0, count);
+
+    slice = count / threads;
+
+    for(i = 0; i < threads; i++)
+    {
+        job[i].proc     = proc;
+        job[i].arg      = arg;
+        job[i].first    = offset;
+        job[i].count    = (i == threads - 1) ? count - offset : slice;
+        job[i].status   = 0;
+        offset += job[i].count;
+    }
+
+    /* the last slice runs here, a thread that can not be started only costs speed */
+    for(i = 0; i < threads - 1; i++)
+        started[i] = pthread_create(&thread[i], NULL, sSlice_Thread, &job[i]) == 0;
+
+    sSlice_Thread(&job[threads - 1]);
+
+    for(i = 0; i < threads - 1; i++)
+    {
+        if(started[i])
+            pthread_join(thread[i], NULL);
+        else
+            sSlice_Thread(&job[i]);
+    }
+
+    for(i = 0; i < threads && status == 0; i++)
+        status = job[i].status;
+
+    return status;
+}
@@ -13,6 +13,7 @@
 #include <tomcrypt.h>
 #include <skein_port.h>
 #include <threefishApi.h>
+#include <skeinApi.h>
 
 
 #include "s4.h"
@@ -40,10 +41,56 @@
 (x) : ((x) + ((y) - ((x) % (y)))))
 #endif
 
+#include "s4cpu.h"
+
+/* Skein tree hashing, see s4HashTree.c */
+typedef struct SkeinTree_Context SkeinTree_Context;
+
+S4Err sSkeinTree_Init(HASH_Algorithm algorithm,
+                      uint8_t   leafSizeExp,
+                      uint8_t   fanOutExp,
+                      uint8_t   maxHeight,
+                      uint32_t  threadCount,
+                      SkeinTree_Context **ctx);
+
+int sSkeinTree_Process(SkeinTree_Context *tree, const unsigned char *in, unsigned long inlen);
+
+int sSkeinTree_Done(SkeinTree_Context *tree, unsigned char *out);
+
+void sSkeinTree_Reset(SkeinTree_Context *tree);
+
+void sSkeinTree_Free(SkeinTree_Context *tree);
+
+/* file reading for HASH_File and MAC_File, see s4HashFile.c.  update is called
+   with the file contents in order, in pieces of up to a few MB */
+typedef S4Err (*sFILE_UpdateProc)(void *ref, const void *data, size_t len);
+
+S4Err sFILE_Feed(const char *path, sFILE_UpdateProc update, void *ref);
+
+/* multithreaded CTR and XTS, see s4internal.c.  A buffer of count items is cut into one
+   slice per thread, and is only split when every thread gets kS4_SliceBytes of it */
+#define kS4_SliceBytes          (1 << 20)
+
+#define kS4_SliceMaxThreads     16
+
+/* crypt items first .. first + count - 1, returns 0 or the mode's error, a CRYPT_xxx status
+   for XTS and an S4Err for CTR.  CRYPT_OK and kS4Err_NoErr are both 0 */
+typedef int (*sSliceProc)(void *arg, size_t first, size_t count);
+
+/* the threadCount a mode keeps, 0 asks for one per CPU */
+uint32_t sSliceThreadCount(uint32_t threadCount);
+
+/* runs proc on every slice, the last one on the calling thread.  Returns the first failure */
+int sSliceRun(sSliceProc proc, void *arg, size_t count, size_t itemSize, uint32_t threadCount);
+
 const struct ltc_hash_descriptor* sDescriptorForHash(HASH_Algorithm algorithm);
 
 S4Err sCrypt2S4Err(int t_err);
 
+/* the registered tomcrypt cipher and the key size in bytes for a block cipher algorithm,
+   resolved once by S4_Init */
+S4Err sCipherForAlgorithm(Cipher_Algorithm algorithm, int *cipher, int *keylen);
+
 bool sECC_ContextIsValid( const ECC_ContextRef  ref);
 
 #define validateECCContext( s )		\
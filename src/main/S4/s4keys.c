@@ -223,6 +223,7 @@ static S4Err sPASSPHRASE_HASH( const uint8_t  *key,
     S4Err           err = kS4Err_NoErr;
     
     MAC_ContextRef  macRef     = kInvalidMAC_ContextRef;
+    uint8_t         macBuf[kMAC_ContextAllocSize];
     
     uint32_t        rounds = roundsIn;
     uint8_t         L[4];
@@ -233,9 +234,10 @@ static S4Err sPASSPHRASE_HASH( const uint8_t  *key,
     L[2] = (salt_len >> 8) & 0xff;
     L[3] = salt_len & 0xff;
     
-    err = MAC_Init(kMAC_Algorithm_SKEIN,
-                   kHASH_Algorithm_SKEIN256,
-                   key, key_len, &macRef); CKERR
+    err = MAC_InitInPlace(kMAC_Algorithm_SKEIN,
+                          kHASH_Algorithm_SKEIN256,
+                          key, key_len,
+                          macBuf, sizeof(macBuf), &macRef); CKERR
     
     MAC_Update(macRef,  "\x00\x00\x00\x01",  4);
     MAC_Update(macRef,  label,  strlen(label));
@@ -256,6 +258,16 @@ done:
     return err;
 }
 
+/* the ECB context of a symmetric key, used when it wraps or unwraps other keys.  It is
+ made once when the key is created and not changed until the key is freed, so any number
+ of threads can use the same key at once without a lock */
+static S4Err sSymKeyExpand(S4KeyContext *ctx)
+{
+    ValidateParam(ctx->type == kS4KeyType_Symmetric);
+    
+    return ECB_Init(ctx->sym.symAlgor, ctx->sym.symKey, &ctx->sym.ecb);
+}
+
 static S4Err sKEY_HASH( const uint8_t  *key,
                        unsigned long  key_len,
                        S4KeyType     keyTypeIn,
@@ -266,15 +278,17 @@ static S4Err sKEY_HASH( const uint8_t  *key,
     S4Err           err = kS4Err_NoErr;
     
     MAC_ContextRef  macRef     = kInvalidMAC_ContextRef;
+    uint8_t         macBuf[kMAC_ContextAllocSize];
     
     uint32_t        keyType = keyTypeIn;
     uint32_t        algorithm = keyAlgorithmIn;
     
     char*           label = "key-hash";
     
-    err = MAC_Init(kMAC_Algorithm_SKEIN,
-                   kHASH_Algorithm_SKEIN256,
-                   key, key_len, &macRef); CKERR
+    err = MAC_InitInPlace(kMAC_Algorithm_SKEIN,
+                          kHASH_Algorithm_SKEIN256,
+                          key, key_len,
+                          macBuf, sizeof(macBuf), &macRef); CKERR
     
     MAC_Update(macRef,  "\x00\x00\x00\x01",  4);
     MAC_Update(macRef,  label,  strlen(label));
@@ -1036,7 +1050,10 @@ static S4Err sDecryptFromPubKey( S4KeyContextRef      encodedCtx,
     ASSERTERR( CMP(keyHash, encodedCtx->publicKeyEncoded.keyHash, kS4KeyPublic_Encrypted_HashBytes),
               kS4Err_BadIntegrity)
     
-    
+    if(keyCTX->type == kS4KeyType_Symmetric)
+    {
+        err = sSymKeyExpand(keyCTX); CKERR;
+    }
     
     *symCtx = keyCTX;
     
@@ -1370,11 +1387,14 @@ S4Err S4Key_NewSymmetric(Cipher_Algorithm       algorithm,
  
     keyCTX->sym.symAlgor = algorithm;
     keyCTX->sym.keylen = keylen;
+    keyCTX->sym.ecb = kInvalidECB_ContextRef;
     
     // leave null bytes at end of key, for odd size keys (like 192)
     ZERO(keyCTX->sym.symKey, sizeof(keyCTX->sym.symKey) );
     COPY(key, keyCTX->sym.symKey, keylen);
     
+    err = sSymKeyExpand(keyCTX); CKERR;
+    
     *ctxOut = keyCTX;
     
 done:
@@ -1611,6 +1631,13 @@ void S4Key_Free(S4KeyContextRef ctx)
         }
         
         switch (ctx->type) {
+            case kS4KeyType_Symmetric:
+                
+                if(ECB_ContextRefIsValid(ctx->sym.ecb))
+                    ECB_Free(ctx->sym.ecb);
+                
+                break;
+                
             case kS4KeyType_PublicKey:
                 
                 if(ECC_ContextRefIsValid(ctx->pub.ecc))
@@ -1688,6 +1715,8 @@ S4Err S4Key_Copy(S4KeyContextRef ctx, S4KeyContextRef *ctxOut)
     {
         case kS4KeyType_Symmetric:
             keyCTX->sym = ctx->sym;
+            keyCTX->sym.ecb = kInvalidECB_ContextRef;
+            err = sSymKeyExpand(keyCTX); CKERR;
             break;
             
         case kS4KeyType_Tweekable:
@@ -2186,7 +2215,8 @@ S4Err S4Key_SerializeToS4Key(S4KeyContextRef  ctx,
         tempLen = sizeof(tempBuf);
         
         uint8_t encrypted_key[128] = {0};
-        err =  ECB_Encrypt(encyptAlgor, unlockingKey, keyToEncrypt, keyBytes, encrypted_key); CKERR;
+        
+        err = ECB_Process(passKeyCtx->sym.ecb, true, keyToEncrypt, keyBytes, encrypted_key); CKERR;
         base64_encode(encrypted_key, keyBytes, tempBuf, &tempLen);
      }
 
@@ -3462,6 +3492,11 @@ S4Err S4Key_DecryptFromPassPhrase( S4KeyContextRef  passCtx,
         COPY(decrypted_key, keyCTX->share.shareSecret, keyBytes);
     }
 
+    if(keyCTX->type == kS4KeyType_Symmetric)
+    {
+        err = sSymKeyExpand(keyCTX); CKERR;
+    }
+    
     sCloneProperties(passCtx, keyCTX);
  
     *symCtx = keyCTX;
@@ -3555,7 +3590,7 @@ S4Err S4Key_DecryptFromS4Key( S4KeyContextRef      encodedCtx,
             decryptedLen = 32;
         }
         
-        err =  ECB_Decrypt(encyptAlgor, unlockingKey, keyToDecrypt, decryptedLen, decrypted_key); CKERR;
+        err = ECB_Process(passKeyCtx->sym.ecb, false, keyToDecrypt, decryptedLen, decrypted_key); CKERR;
         
         COPY(decrypted_key, keyCTX->sym.symKey, decryptedLen);
       
@@ -3570,7 +3605,7 @@ S4Err S4Key_DecryptFromS4Key( S4KeyContextRef      encodedCtx,
         keyCTX->tbc.tbcAlgor = encodedCtx->symKeyEncoded.cipherAlgor;
         keyCTX->tbc.keybits = decryptedLen << 3;
         
-        err =  ECB_Decrypt(encyptAlgor, unlockingKey, keyToDecrypt, decryptedLen, decrypted_key); CKERR;
+        err = ECB_Process(passKeyCtx->sym.ecb, false, keyToDecrypt, decryptedLen, decrypted_key); CKERR;
         
         memcpy(keyCTX->tbc.key, decrypted_key, decryptedLen);
 //        Skein_Get64_LSB_First(keyCTX->tbc.key, decrypted_key, decryptedLen >>2);   /* bytes to words */
@@ -3604,6 +3639,11 @@ S4Err S4Key_DecryptFromS4Key( S4KeyContextRef      encodedCtx,
     ASSERTERR( CMP(keyHash, encodedCtx->symKeyEncoded.keyHash, kS4KeyPublic_Encrypted_HashBytes),
               kS4Err_BadIntegrity)
     
+    if(keyCTX->type == kS4KeyType_Symmetric)
+    {
+        err = sSymKeyExpand(keyCTX); CKERR;
+    }
+    
     sCloneProperties(encodedCtx, keyCTX);
 
     *outKeyCtx = keyCTX;
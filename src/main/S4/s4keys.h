@@ -93,6 +93,7 @@ typedef struct S4KeySymmetric_
     Cipher_Algorithm    symAlgor;
     size_t              keylen;
     uint8_t        		symKey[64];
+    ECB_ContextRef      ecb;            /* the expanded key, made with the key and used to wrap others */
     
 }S4KeySymmetric;
 
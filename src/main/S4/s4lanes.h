@@ -0,0 +1,27 @@
+//
+//  s4lanes.h
+//  S4
+//
+//  Threefish on four blocks side by side, word i of every block in one v4u64.
+//  Shared by the TBC kernels in s4TBC.c and the Skein kernels in s4HashBatch.c.
+//  Internal to the library, not exported.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#ifndef s4lanes_h
+#define s4lanes_h
+
+#include <tomcrypt.h>
+
+#if defined(LTC_X86_SIMD)
+
+typedef uint64_t    v4u64   __attribute__ ((vector_size (32)));
+
+#define TF_ROTL64(x, n)     (((x) << (n)) | ((x) >> (64 - (n))))
+#define TF_MIX(a, b, r)     a += b; b = TF_ROTL64(b, r) ^ a;
+#define TF_UNMIX(a, b, r)   b ^= a; b = TF_ROTL64(b, 64 - (r)); a -= b;
+
+#endif /* LTC_X86_SIMD */
+
+#endif /* s4lanes_h */
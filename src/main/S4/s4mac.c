@@ -14,6 +14,29 @@
 #endif
 
 
+/* HMAC keeps the hash state after the (K ^ ipad) and (K ^ opad) blocks,
+   so a new message under the same key only costs a copy */
+typedef struct
+{
+    const struct ltc_hash_descriptor    *desc;
+    hash_state                          md;
+    hash_state                          inner;
+    hash_state                          outer;
+} sHMAC_State;
+
+#if  _USES_COMMON_CRYPTO_
+
+/* CCHmacContext can not be restarted,  MAC_Reset runs CCHmacInit again with the saved key */
+typedef struct
+{
+    CCHmacContext           ctx;
+    CCHmacAlgorithm         algor;
+    size_t                  keyLen;
+    uint8_t                 key[128];
+} sCCMac_State;
+
+#endif
+
 typedef struct MAC_Context    MAC_Context;
 
 struct MAC_Context
@@ -27,13 +50,14 @@ struct MAC_Context
 #endif
     
     size_t                  hashsize;
+    bool                    inPlace;        /* built by MAC_InitInPlace, MAC_Free does not release it */
     
     union
     {
-        hmac_state              hmac;
+        sHMAC_State             hmac;
         skeinmac_state          skeinmac;
 #if  _USES_COMMON_CRYPTO_
-        CCHmacContext           ccMac;
+        sCCMac_State            ccMac;
 #endif
     }state;
     
@@ -41,8 +65,14 @@ struct MAC_Context
     
     int (*done)(void *ctx, unsigned char *out, unsigned long *outlen);
     
+    void (*reset)(void *ctx);
+    
 };
 
+#define kMAC_ContextAlign      16
+
+typedef char sMAC_ContextFits[(sizeof(MAC_Context) + kMAC_ContextAlign - 1 <= kMAC_ContextAllocSize) ? 1 : -1];
+
 
 /*____________________________________________________________________________
  validity test
@@ -63,55 +93,164 @@ ValidateParam( sMAC_ContextIsValid( s ) )
 #if  _USES_COMMON_CRYPTO_
 
 
-int sCCMacUpdate(CCHmacContext *ctx, const unsigned char *in, unsigned long inlen)
+int sCCMacUpdate(sCCMac_State *ctx, const unsigned char *in, unsigned long inlen)
 {
-    CCHmacUpdate(ctx, in, inlen);
+    CCHmacUpdate(&ctx->ctx, in, inlen);
     
     return CRYPT_OK;
 }
 
 
-int sCCMacFinal(CCHmacContext *ctx, unsigned char *out, unsigned long *outlen)
+int sCCMacFinal(sCCMac_State *ctx, unsigned char *out, unsigned long *outlen)
 {
     
     u08b_t    macBuf[64];
     u08b_t    *p = (*outlen < sizeof(macBuf))?macBuf:out;
     
-    CCHmacFinal(ctx, p);
+    CCHmacFinal(&ctx->ctx, p);
     
     if(p!= out)
         memcpy( out,macBuf, *outlen);
     
     
 #ifdef LTC_CLEAN_STACK
-    zeromem(ctx, sizeof(CCHmacContext));
+    zeromem(&ctx->ctx, sizeof(CCHmacContext));
     zeromem(macBuf, sizeof(macBuf));
 #endif
     
     return CRYPT_OK;
 }
 
+void sCCMacReset(sCCMac_State *ctx)
+{
+    CCHmacInit(&ctx->ctx, ctx->algor, ctx->key, ctx->keyLen);
+}
 
 #endif
 
-S4Err MAC_Init(MAC_Algorithm mac, HASH_Algorithm hash, const void *macKey, size_t macKeyLen, MAC_ContextRef * ctx)
+#ifdef __clang__
+#pragma mark - HMAC
+#endif
+
+static int sHMAC_Init(sHMAC_State *hmac, const struct ltc_hash_descriptor *desc,
+                      const unsigned char *key, unsigned long keyLen)
+{
+    int             err = CRYPT_OK;
+    unsigned char   pad[MAXBLOCKSIZE];
+    unsigned long   i;
+    
+    if(desc->blocksize > sizeof(pad) || desc->hashsize > sizeof(pad))
+        return CRYPT_INVALID_HASH;
+    
+    hmac->desc = desc;
+    ZERO(pad, sizeof(pad));
+    
+    /* keys longer than a block are hashed first */
+    if(keyLen > desc->blocksize)
+    {
+        if((err = desc->init(&hmac->md)) != CRYPT_OK) goto done;
+        if((err = desc->process(&hmac->md, key, keyLen)) != CRYPT_OK) goto done;
+        if((err = desc->done(&hmac->md, pad)) != CRYPT_OK) goto done;
+    }
+    else if(keyLen > 0)
+    {
+        COPY(key, pad, keyLen);
+    }
+    
+    for(i = 0; i < desc->blocksize; i++)
+        pad[i] ^= 0x36;
+    
+    if((err = desc->init(&hmac->inner)) != CRYPT_OK) goto done;
+    if((err = desc->process(&hmac->inner, pad, desc->blocksize)) != CRYPT_OK) goto done;
+    
+    for(i = 0; i < desc->blocksize; i++)
+        pad[i] ^= 0x36 ^ 0x5C;
+    
+    if((err = desc->init(&hmac->outer)) != CRYPT_OK) goto done;
+    if((err = desc->process(&hmac->outer, pad, desc->blocksize)) != CRYPT_OK) goto done;
+    
+    COPY(&hmac->inner, &hmac->md, sizeof(hash_state));
+    
+done:
+    ZERO(pad, sizeof(pad));
+    
+    return err;
+}
+
+static int sHMAC_Process(sHMAC_State *hmac, const unsigned char *in, unsigned long inlen)
+{
+    return hmac->desc->process(&hmac->md, in, inlen);
+}
+
+static int sHMAC_Done(sHMAC_State *hmac, unsigned char *out, unsigned long *outlen)
+{
+    int             err = CRYPT_OK;
+    unsigned char   buf[MAXBLOCKSIZE];
+    unsigned long   hashsize = hmac->desc->hashsize;
+    
+    if((err = hmac->desc->done(&hmac->md, buf)) != CRYPT_OK) goto done;
+    
+    COPY(&hmac->outer, &hmac->md, sizeof(hash_state));
+    
+    if((err = hmac->desc->process(&hmac->md, buf, hashsize)) != CRYPT_OK) goto done;
+    if((err = hmac->desc->done(&hmac->md, buf)) != CRYPT_OK) goto done;
+    
+    *outlen = MIN(*outlen, hashsize);
+    COPY(buf, out, *outlen);
+    
+done:
+    ZERO(buf, sizeof(buf));
+    
+    return err;
+}
+
+static void sHMAC_Reset(sHMAC_State *hmac)
+{
+    COPY(&hmac->inner, &hmac->md, sizeof(hash_state));
+}
+
+#ifdef __clang__
+#pragma mark - Skein MAC
+#endif
+
+/* skeinmac_done wipes the context under LTC_CLEAN_STACK, this keeps XSave for skeinReset */
+static int sSkeinMacDone(skeinmac_state *mac, unsigned char *out, unsigned long *outlen)
+{
+    u08b_t    macBuf[SKEIN1024_STATE_BYTES];
+    size_t    macLen = (size_t) (mac->skein.m.h.hashBitLen + 7) / 8;
+    
+    skeinFinal(&mac->skein, macBuf);
+    
+    *outlen = MIN(*outlen, macLen);
+    COPY(macBuf, out, *outlen);
+    
+    ZERO(macBuf, sizeof(macBuf));
+    
+    return CRYPT_OK;
+}
+
+static void sSkeinMacReset(skeinmac_state *mac)
+{
+    skeinReset(&mac->skein);
+}
+
+#ifdef __clang__
+#pragma mark - Public
+#endif
+
+/* key the context in memory the caller owns, shared by MAC_Init and MAC_InitInPlace */
+static S4Err sMAC_Setup(MAC_Context *macCTX, MAC_Algorithm mac, HASH_Algorithm hash,
+                        const void *macKey, size_t macKeyLen)
 {
     int             err = kS4Err_NoErr;
     const struct    ltc_hash_descriptor* hashDesc = NULL;
-    MAC_Context*   macCTX = NULL;
-    
-    ValidateParam(ctx);
-    *ctx = NULL;
     
     hashDesc = sDescriptorForHash(hash);
     
     if(IsNull(hashDesc))
         RETERR( kS4Err_BadHashNumber);
     
-    
-    macCTX = XMALLOC(sizeof (MAC_Context)); CKNULL(macCTX);
-    
-    macCTX->magic = kMAC_ContextMagic;
+    macCTX->magic = 0;
     macCTX->macAlgor = mac;
     macCTX->hashsize = 0;
     
@@ -119,6 +258,10 @@ S4Err MAC_Init(MAC_Algorithm mac, HASH_Algorithm hash, const void *macKey, size_
     {
         case  kMAC_Algorithm_HMAC:
             
+            /* sHMAC_Reset copies hash states, the BLAKE3 one lives on the heap */
+            if(hash == kHASH_Algorithm_BLAKE3)
+                RETERR(kS4Err_BadHashNumber);
+            
 #if  _USES_COMMON_CRYPTO_
             
             switch(hash)
@@ -158,25 +301,34 @@ S4Err MAC_Init(MAC_Algorithm mac, HASH_Algorithm hash, const void *macKey, size_
                 break;
         }
             
-            if(macCTX->ccAlgor != kCCHmacAlgInvalid)
+            /* keys that do not fit the reset copy go through our own HMAC */
+            if(macCTX->ccAlgor != kCCHmacAlgInvalid
+               && macKeyLen <= sizeof(macCTX->state.ccMac.key))
             {
-                CCHmacInit(&macCTX->state.ccMac, macCTX->ccAlgor, macKey, macKeyLen);
+                macCTX->state.ccMac.algor = macCTX->ccAlgor;
+                macCTX->state.ccMac.keyLen = macKeyLen;
+                COPY(macKey, macCTX->state.ccMac.key, macKeyLen);
+                
+                sCCMacReset(&macCTX->state.ccMac);
                 macCTX->process = (void*) sCCMacUpdate;
                 macCTX->done = (void*) sCCMacFinal;
+                macCTX->reset = (void*) sCCMacReset;
             }
             else
             {
-                err = hmac_init(&macCTX->state.hmac,  find_hash_id(hashDesc->ID) , macKey, macKeyLen) ; CKERR;
-                macCTX->process = (void*) hmac_process;
-                macCTX->done = (void*) hmac_done;
+                err = sHMAC_Init(&macCTX->state.hmac, hashDesc, macKey, macKeyLen) ; CKERR;
+                macCTX->process = (void*) sHMAC_Process;
+                macCTX->done = (void*) sHMAC_Done;
+                macCTX->reset = (void*) sHMAC_Reset;
                 macCTX->hashsize = hashDesc->hashsize;
             }
             
 #else
             
-            err = hmac_init(&macCTX->state.hmac,  find_hash_id(hashDesc->ID) , macKey, macKeyLen) ; CKERR;
-            macCTX->process = (void*) hmac_process;
-            macCTX->done = (void*) hmac_done;
+            err = sHMAC_Init(&macCTX->state.hmac, hashDesc, macKey, macKeyLen) ; CKERR;
+            macCTX->process = (void*) sHMAC_Process;
+            macCTX->done = (void*) sHMAC_Done;
+            macCTX->reset = (void*) sHMAC_Reset;
             macCTX->hashsize = hashDesc->hashsize;
             
 #endif
@@ -190,14 +342,16 @@ S4Err MAC_Init(MAC_Algorithm mac, HASH_Algorithm hash, const void *macKey, size_
                 case kHASH_Algorithm_SKEIN256:
                     err = skeinmac_init(&macCTX->state.skeinmac, Skein256, macKey, macKeyLen);
                     macCTX->process = (void*) skeinmac_process;
-                    macCTX->done = (void*) skeinmac_done;
+                    macCTX->done = (void*) sSkeinMacDone;
+                    macCTX->reset = (void*) sSkeinMacReset;
                     macCTX->hashsize = 32;
                     break;
                     
                 case kHASH_Algorithm_SKEIN512:
                     err = skeinmac_init(&macCTX->state.skeinmac, Skein512, macKey, macKeyLen);
                     macCTX->process = (void*) skeinmac_process;
-                    macCTX->done = (void*) skeinmac_done;
+                    macCTX->done = (void*) sSkeinMacDone;
+                    macCTX->reset = (void*) sSkeinMacReset;
                     macCTX->hashsize = 64;
                     break;
                     
@@ -211,6 +365,26 @@ S4Err MAC_Init(MAC_Algorithm mac, HASH_Algorithm hash, const void *macKey, size_
             RETERR( kS4Err_BadHashNumber) ;
     }
     
+    macCTX->magic = kMAC_ContextMagic;
+    
+done:
+    
+    return err;
+}
+
+S4Err MAC_Init(MAC_Algorithm mac, HASH_Algorithm hash, const void *macKey, size_t macKeyLen, MAC_ContextRef * ctx)
+{
+    int             err = kS4Err_NoErr;
+    MAC_Context*   macCTX = NULL;
+    
+    ValidateParam(ctx);
+    *ctx = NULL;
+    
+    macCTX = XMALLOC(sizeof (MAC_Context)); CKNULL(macCTX);
+    macCTX->inPlace = false;
+    
+    err = sMAC_Setup(macCTX, mac, hash, macKey, macKeyLen); CKERR;
+    
     *ctx = macCTX;
     
 done:
@@ -219,6 +393,7 @@ done:
     {
         if(IsntNull(macCTX))
         {
+            ZERO(macCTX, sizeof(MAC_Context));
             XFREE(macCTX);
         }
     }
@@ -226,6 +401,54 @@ done:
     
 }
 
+S4Err MAC_InitInPlace(MAC_Algorithm     mac,
+                      HASH_Algorithm    hash,
+                      const void        *macKey,
+                      size_t            macKeyLen,
+                      void              *buffer,
+                      size_t            bufSize,
+                      MAC_ContextRef    *ctx)
+{
+    int             err = kS4Err_NoErr;
+    MAC_Context*    macCTX = NULL;
+    uintptr_t       aligned;
+    
+    ValidateParam(ctx);
+    ValidateParam(buffer);
+    *ctx = NULL;
+    
+    aligned = ((uintptr_t) buffer + kMAC_ContextAlign - 1) & ~(uintptr_t)(kMAC_ContextAlign - 1);
+    
+    if(bufSize < (aligned - (uintptr_t) buffer) + sizeof(MAC_Context))
+        RETERR(kS4Err_BufferTooSmall);
+    
+    macCTX = (MAC_Context*) aligned;
+    macCTX->inPlace = true;
+    
+    err = sMAC_Setup(macCTX, mac, hash, macKey, macKeyLen); CKERR;
+    
+    *ctx = macCTX;
+    
+done:
+    
+    if(IsS4Err(err) && IsntNull(macCTX))
+        ZERO(macCTX, sizeof(MAC_Context));
+    
+    return err;
+}
+
+S4Err MAC_Reset(MAC_ContextRef  ctx)
+{
+    int  err = kS4Err_NoErr;
+    
+    validateMACContext(ctx);
+    
+    if(ctx->reset)
+        (ctx->reset)(&ctx->state);
+    
+    return err;
+}
+
 
 S4Err MAC_HashSize( MAC_ContextRef  ctx, size_t * bytes)
 {
@@ -274,8 +497,12 @@ void MAC_Free(MAC_ContextRef  ctx)
     
     if(sMAC_ContextIsValid(ctx))
     {
+        bool inPlace = ctx->inPlace;    /* MAC_InitInPlace memory belongs to the caller */
+        
         ZERO(ctx, sizeof(MAC_Context));
-        XFREE(ctx);
+        
+        if(!inPlace)
+            XFREE(ctx);
     }
 }
 
@@ -293,6 +520,7 @@ S4Err  MAC_KDF(  MAC_Algorithm      mac,
 {
     S4Err             err = kS4Err_NoErr;
     MAC_ContextRef       macRef = kInvalidMAC_ContextRef;
+    uint8_t              macBuf[kMAC_ContextAllocSize];
     uint8_t              L[4];
     size_t               resultLen = 0;
     
@@ -301,9 +529,10 @@ S4Err  MAC_KDF(  MAC_Algorithm      mac,
     L[2] = (hashLen >> 8) & 0xff;
     L[3] = hashLen & 0xff;
     
-    err  = MAC_Init( mac,
-                    hash,
-                    K, Klen, &macRef); CKERR;
+    err  = MAC_InitInPlace( mac,
+                           hash,
+                           K, Klen,
+                           macBuf, sizeof(macBuf), &macRef); CKERR;
     
     MAC_Update(macRef,  "\x00\x00\x00\x01",  4);
     MAC_Update(macRef,  label,  strlen(label));
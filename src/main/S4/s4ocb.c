@@ -0,0 +1,279 @@
+//
+//  s4ocb.c
+//  S4
+//
+//  OCB3 authenticated encryption (RFC 7253).  One pass of the block cipher
+//  does both the encryption and the authentication, and no block depends on
+//  the one before it, so the tomcrypt ocb3 code runs AES-NI 8 blocks at a time.
+//  The context mirrors the GCM one: it knows which direction it is going, so
+//  the tag is written after encrypting and checked after decrypting.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#include "s4Internal.h"
+
+#define kOCB_BlockSize          16
+#define kOCB_MaxNonceSize       15
+
+typedef struct OCB_Context    OCB_Context;
+
+struct OCB_Context
+{
+#define kOCB_ContextMagic		0x43346f63
+    uint32_t            magic;
+    Cipher_Algorithm    algor;
+    int                 direction;      /* OCB3_ENCRYPT or OCB3_DECRYPT once text is seen, -1 before */
+    size_t              tagLen;
+    ocb3_state          state;
+};
+
+
+static bool sOCB_ContextIsValid( const OCB_ContextRef  ref)
+{
+    bool       valid	= false;
+
+    valid	= IsntNull( ref ) && ref->magic	 == kOCB_ContextMagic;
+
+    return( valid );
+}
+
+#define validateOCBContext( s )		\
+ValidateParam( sOCB_ContextIsValid( s ) )
+
+
+#ifdef __clang__
+#pragma mark - Utility
+#endif
+
+/* the tag comparison takes the same time wherever the first difference is */
+static bool sOCB_TagsMatch(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    uint8_t     diff = 0;
+    size_t      i;
+
+    for(i = 0; i < len; i++)
+        diff |= a[i] ^ b[i];
+
+    return diff == 0;
+}
+
+static S4Err sOCB_Process(OCB_ContextRef ctx,
+                          const void *in,
+                          size_t     bytesIn,
+                          void       *out,
+                          int        direction)
+{
+    S4Err       err     = kS4Err_NoErr;
+    int         status  =  CRYPT_OK;
+
+    validateOCBContext(ctx);
+    ValidateParam(bytesIn == 0 || (in && out));
+
+    /* one context goes one way, and a short block ends the text */
+    ValidateParam(ctx->direction == -1 || ctx->direction == direction);
+    ValidateParam(bytesIn == 0 || !ctx->state.textdone);
+
+    ctx->direction = direction;
+
+    if(direction == OCB3_ENCRYPT)
+        status = ocb3_encrypt(&ctx->state, in, bytesIn, out);
+    else
+        status = ocb3_decrypt(&ctx->state, in, bytesIn, out);
+    CKSTAT;
+
+done:
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Public
+#endif
+
+S4Err OCB_Init(Cipher_Algorithm algorithm,
+               const void *key,
+               const void *nonce,
+               size_t     nonceLen,
+               size_t     tagLen,
+               OCB_ContextRef * ctxOut)
+{
+    int             err     = kS4Err_NoErr;
+    OCB_Context*    ocbCTX  = NULL;
+    int             keylen  = 0;
+    int             cipher  = -1;
+    int             status  =  CRYPT_OK;
+
+    ValidateParam(key);
+    ValidateParam(nonce);
+    ValidateParam(nonceLen > 0 && nonceLen <= kOCB_MaxNonceSize);
+    ValidateParam(tagLen > 0 && tagLen <= kOCB_BlockSize);
+    ValidateParam(ctxOut);
+
+    err = sCipherForAlgorithm(algorithm, &cipher, &keylen); CKERR;
+
+    status = cipher_is_valid(cipher); CKSTAT;
+
+    ocbCTX = XMALLOC(sizeof (OCB_Context)); CKNULL(ocbCTX);
+    ZERO(ocbCTX, sizeof(OCB_Context));
+
+    ocbCTX->magic       = kOCB_ContextMagic;
+    ocbCTX->algor       = algorithm;
+    ocbCTX->direction   = -1;
+    ocbCTX->tagLen      = tagLen;
+
+    status = ocb3_init(&ocbCTX->state, cipher, key, keylen, nonce, nonceLen, tagLen); CKSTAT;
+
+    *ctxOut = ocbCTX;
+
+done:
+
+    if(status != CRYPT_OK)
+    {
+        if(ocbCTX)
+        {
+            ZERO(ocbCTX, sizeof(OCB_Context));
+            XFREE(ocbCTX);
+        }
+        err = sCrypt2S4Err(status);
+    }
+
+    return err;
+}
+
+S4Err OCB_AddAAD(OCB_ContextRef ctx,
+                 const void *	aad,
+                 size_t         aadLen)
+{
+    S4Err       err     = kS4Err_NoErr;
+    int         status  =  CRYPT_OK;
+
+    validateOCBContext(ctx);
+    ValidateParam(aadLen == 0 || aad);
+
+    /* the AAD all comes before the text */
+    ValidateParam(ctx->direction == -1);
+
+    status = ocb3_add_aad(&ctx->state, aad, aadLen); CKSTAT;
+
+done:
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
+S4Err OCB_Encrypt(OCB_ContextRef ctx,
+                  const void *	in,
+                  size_t         bytesIn,
+                  void *         out )
+{
+    return sOCB_Process(ctx, in, bytesIn, out, OCB3_ENCRYPT);
+}
+
+S4Err OCB_Decrypt(OCB_ContextRef ctx,
+                  const void *	in,
+                  size_t         bytesIn,
+                  void *         out )
+{
+    return sOCB_Process(ctx, in, bytesIn, out, OCB3_DECRYPT);
+}
+
+S4Err OCB_Final(OCB_ContextRef ctx,
+                void *         tag,
+                size_t         tagLen)
+{
+    S4Err           err     = kS4Err_NoErr;
+    int             status  =  CRYPT_OK;
+    uint8_t         computed[kOCB_BlockSize];
+    unsigned long   computedLen = sizeof(computed);
+
+    validateOCBContext(ctx);
+    ValidateParam(tag);
+    ValidateParam(tagLen == ctx->tagLen);
+
+    status = ocb3_done(&ctx->state, computed, &computedLen); CKSTAT;
+
+    if(ctx->direction == OCB3_DECRYPT)
+    {
+        if(!sOCB_TagsMatch(computed, tag, tagLen))
+            err = kS4Err_BadIntegrity;
+    }
+    else
+        COPY(computed, tag, tagLen);
+
+done:
+
+    ZERO(computed, sizeof(computed));
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
+void OCB_Free(OCB_ContextRef  ctx)
+{
+    if(sOCB_ContextIsValid(ctx))
+    {
+        ZERO(ctx, sizeof(OCB_Context));
+        XFREE(ctx);
+    }
+}
+
+S4Err OCB_EncryptAEAD(Cipher_Algorithm algorithm,
+                      const void *key,
+                      const void *nonce, size_t nonceLen,
+                      const void *aad,   size_t aadLen,
+                      const void *in,    size_t bytesIn,
+                      void       *out,
+                      void       *tag,   size_t tagLen)
+{
+    S4Err           err     = kS4Err_NoErr;
+    OCB_ContextRef  ocb     = kInvalidOCB_ContextRef;
+
+    err = OCB_Init(algorithm, key, nonce, nonceLen, tagLen, &ocb); CKERR;
+    err = OCB_AddAAD(ocb, aad, aadLen); CKERR;
+    err = OCB_Encrypt(ocb, in, bytesIn, out); CKERR;
+    err = OCB_Final(ocb, tag, tagLen); CKERR;
+
+done:
+
+    if(OCB_ContextRefIsValid(ocb))
+        OCB_Free(ocb);
+
+    return err;
+}
+
+S4Err OCB_DecryptAEAD(Cipher_Algorithm algorithm,
+                      const void *key,
+                      const void *nonce, size_t nonceLen,
+                      const void *aad,   size_t aadLen,
+                      const void *in,    size_t bytesIn,
+                      void       *out,
+                      const void *tag,   size_t tagLen)
+{
+    S4Err           err     = kS4Err_NoErr;
+    OCB_ContextRef  ocb     = kInvalidOCB_ContextRef;
+
+    err = OCB_Init(algorithm, key, nonce, nonceLen, tagLen, &ocb); CKERR;
+    err = OCB_AddAAD(ocb, aad, aadLen); CKERR;
+    err = OCB_Decrypt(ocb, in, bytesIn, out); CKERR;
+    err = OCB_Final(ocb, (void *) tag, tagLen); CKERR;
+
+done:
+
+    /* plaintext that did not authenticate is not handed back */
+    if(IsS4Err(err) && out && bytesIn > 0)
+        ZERO(out, bytesIn);
+
+    if(OCB_ContextRefIsValid(ocb))
+        OCB_Free(ocb);
+
+    return err;
+}
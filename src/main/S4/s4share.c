@@ -264,15 +264,17 @@ S4Err SHARES_GetShareHash( const uint8_t *key,
     S4Err           err = kS4Err_NoErr;
     
     MAC_ContextRef  macRef     = kInvalidMAC_ContextRef;
+    uint8_t         macBuf[kMAC_ContextAllocSize];
     
     uint32_t        secretLength    =  (uint32_t) keyLenIn;
     uint32_t        threshold       = thresholdIn;
     
     char*           label = "share-hash";
     
-    err = MAC_Init(kMAC_Algorithm_SKEIN,
-                   kHASH_Algorithm_SKEIN256,
-                   key, keyLenIn, &macRef); CKERR
+    err = MAC_InitInPlace(kMAC_Algorithm_SKEIN,
+                          kHASH_Algorithm_SKEIN256,
+                          key, keyLenIn,
+                          macBuf, sizeof(macBuf), &macRef); CKERR
     
     MAC_Update(macRef,  "\x00\x00\x00\x01",  4);
     MAC_Update(macRef,  label,  strlen(label));
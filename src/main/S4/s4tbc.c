@@ -7,6 +7,250 @@
 //
 
 #include "s4Internal.h"
+#include "s4lanes.h"
+
+/* blocks that go through the SIMD kernels side by side */
+#define kTBC_Lanes          4
+
+/* words[] holds word i of lane l at words[kTBC_Lanes * i + l], tweak holds
+   T0 of each lane in tweak[0..3] and T1 in tweak[4..7] */
+typedef void (*sTBC_LanesProc)(const uint64_t *ks, const uint64_t *tweak, uint64_t *words);
+
+
+#ifdef __clang__
+#pragma mark - Multi-block Threefish kernels
+#endif
+
+#if defined(LTC_X86_SIMD)
+
+/* Threefish-256/512/1024 on four blocks, one key and a tweak per block.  Word i
+   of every block lives in one v4u64.  The key schedule is the same for all four,
+   so its words stay scalar and are broadcast as they are added in. */
+
+#define TF256_KEY(OP, s)                                            \
+    x0 OP ks[((s) + 0) % 5];                                        \
+    x1 OP ks[((s) + 1) % 5] + ts[(s) % 3];                          \
+    x2 OP ks[((s) + 2) % 5] + ts[((s) + 1) % 3];                    \
+    x3 OP ks[((s) + 3) % 5] + (uint64_t) (s);
+
+#define TF256_ROUND(M, p0, p1, p2, p3, ROT)                         \
+    M(x##p0, x##p1, ROT##_0);  M(x##p2, x##p3, ROT##_1);
+
+#define TF256_ENC8(R)                                               \
+    TF256_ROUND(TF_MIX, 0, 1, 2, 3, R_256_0);                       \
+    TF256_ROUND(TF_MIX, 0, 3, 2, 1, R_256_1);                       \
+    TF256_ROUND(TF_MIX, 0, 1, 2, 3, R_256_2);                       \
+    TF256_ROUND(TF_MIX, 0, 3, 2, 1, R_256_3);                       \
+    TF256_KEY(+=, 2 * (R) + 1);                                     \
+    TF256_ROUND(TF_MIX, 0, 1, 2, 3, R_256_4);                       \
+    TF256_ROUND(TF_MIX, 0, 3, 2, 1, R_256_5);                       \
+    TF256_ROUND(TF_MIX, 0, 1, 2, 3, R_256_6);                       \
+    TF256_ROUND(TF_MIX, 0, 3, 2, 1, R_256_7);                       \
+    TF256_KEY(+=, 2 * (R) + 2);
+
+#define TF256_DEC8(R)                                               \
+    TF256_KEY(-=, 2 * (R) + 2);                                     \
+    TF256_ROUND(TF_UNMIX, 0, 3, 2, 1, R_256_7);                     \
+    TF256_ROUND(TF_UNMIX, 0, 1, 2, 3, R_256_6);                     \
+    TF256_ROUND(TF_UNMIX, 0, 3, 2, 1, R_256_5);                     \
+    TF256_ROUND(TF_UNMIX, 0, 1, 2, 3, R_256_4);                     \
+    TF256_KEY(-=, 2 * (R) + 1);                                     \
+    TF256_ROUND(TF_UNMIX, 0, 3, 2, 1, R_256_3);                     \
+    TF256_ROUND(TF_UNMIX, 0, 1, 2, 3, R_256_2);                     \
+    TF256_ROUND(TF_UNMIX, 0, 3, 2, 1, R_256_1);                     \
+    TF256_ROUND(TF_UNMIX, 0, 1, 2, 3, R_256_0);
+
+#define TF512_KEY(OP, s)                                            \
+    x0 OP ks[((s) + 0) % 9];                                        \
+    x1 OP ks[((s) + 1) % 9];                                        \
+    x2 OP ks[((s) + 2) % 9];                                        \
+    x3 OP ks[((s) + 3) % 9];                                        \
+    x4 OP ks[((s) + 4) % 9];                                        \
+    x5 OP ks[((s) + 5) % 9] + ts[(s) % 3];                          \
+    x6 OP ks[((s) + 6) % 9] + ts[((s) + 1) % 3];                    \
+    x7 OP ks[((s) + 7) % 9] + (uint64_t) (s);
+
+#define TF512_ROUND(M, p0, p1, p2, p3, p4, p5, p6, p7, ROT)         \
+    M(x##p0, x##p1, ROT##_0);  M(x##p2, x##p3, ROT##_1);            \
+    M(x##p4, x##p5, ROT##_2);  M(x##p6, x##p7, ROT##_3);
+
+#define TF512_ENC8(R)                                               \
+    TF512_ROUND(TF_MIX, 0, 1, 2, 3, 4, 5, 6, 7, R_512_0);           \
+    TF512_ROUND(TF_MIX, 2, 1, 4, 7, 6, 5, 0, 3, R_512_1);           \
+    TF512_ROUND(TF_MIX, 4, 1, 6, 3, 0, 5, 2, 7, R_512_2);           \
+    TF512_ROUND(TF_MIX, 6, 1, 0, 7, 2, 5, 4, 3, R_512_3);           \
+    TF512_KEY(+=, 2 * (R) + 1);                                     \
+    TF512_ROUND(TF_MIX, 0, 1, 2, 3, 4, 5, 6, 7, R_512_4);           \
+    TF512_ROUND(TF_MIX, 2, 1, 4, 7, 6, 5, 0, 3, R_512_5);           \
+    TF512_ROUND(TF_MIX, 4, 1, 6, 3, 0, 5, 2, 7, R_512_6);           \
+    TF512_ROUND(TF_MIX, 6, 1, 0, 7, 2, 5, 4, 3, R_512_7);           \
+    TF512_KEY(+=, 2 * (R) + 2);
+
+#define TF512_DEC8(R)                                               \
+    TF512_KEY(-=, 2 * (R) + 2);                                     \
+    TF512_ROUND(TF_UNMIX, 6, 1, 0, 7, 2, 5, 4, 3, R_512_7);         \
+    TF512_ROUND(TF_UNMIX, 4, 1, 6, 3, 0, 5, 2, 7, R_512_6);         \
+    TF512_ROUND(TF_UNMIX, 2, 1, 4, 7, 6, 5, 0, 3, R_512_5);         \
+    TF512_ROUND(TF_UNMIX, 0, 1, 2, 3, 4, 5, 6, 7, R_512_4);         \
+    TF512_KEY(-=, 2 * (R) + 1);                                     \
+    TF512_ROUND(TF_UNMIX, 6, 1, 0, 7, 2, 5, 4, 3, R_512_3);         \
+    TF512_ROUND(TF_UNMIX, 4, 1, 6, 3, 0, 5, 2, 7, R_512_2);         \
+    TF512_ROUND(TF_UNMIX, 2, 1, 4, 7, 6, 5, 0, 3, R_512_1);         \
+    TF512_ROUND(TF_UNMIX, 0, 1, 2, 3, 4, 5, 6, 7, R_512_0);
+
+#define TF1024_KEY(OP, s)                                           \
+    x00 OP ks[((s) +  0) % 17];                                     \
+    x01 OP ks[((s) +  1) % 17];                                     \
+    x02 OP ks[((s) +  2) % 17];                                     \
+    x03 OP ks[((s) +  3) % 17];                                     \
+    x04 OP ks[((s) +  4) % 17];                                     \
+    x05 OP ks[((s) +  5) % 17];                                     \
+    x06 OP ks[((s) +  6) % 17];                                     \
+    x07 OP ks[((s) +  7) % 17];                                     \
+    x08 OP ks[((s) +  8) % 17];                                     \
+    x09 OP ks[((s) +  9) % 17];                                     \
+    x10 OP ks[((s) + 10) % 17];                                     \
+    x11 OP ks[((s) + 11) % 17];                                     \
+    x12 OP ks[((s) + 12) % 17];                                     \
+    x13 OP ks[((s) + 13) % 17] + ts[(s) % 3];                       \
+    x14 OP ks[((s) + 14) % 17] + ts[((s) + 1) % 3];                 \
+    x15 OP ks[((s) + 15) % 17] + (uint64_t) (s);
+
+#define TF1024_ROUND(M, p0, p1, p2, p3, p4, p5, p6, p7, p8, p9, pA, pB, pC, pD, pE, pF, ROT) \
+    M(x##p0, x##p1, ROT##_0);  M(x##p2, x##p3, ROT##_1);            \
+    M(x##p4, x##p5, ROT##_2);  M(x##p6, x##p7, ROT##_3);            \
+    M(x##p8, x##p9, ROT##_4);  M(x##pA, x##pB, ROT##_5);            \
+    M(x##pC, x##pD, ROT##_6);  M(x##pE, x##pF, ROT##_7);
+
+#define TF1024_P0(M, ROT)   TF1024_ROUND(M, 00, 01, 02, 03, 04, 05, 06, 07, 08, 09, 10, 11, 12, 13, 14, 15, ROT)
+#define TF1024_P1(M, ROT)   TF1024_ROUND(M, 00, 09, 02, 13, 06, 11, 04, 15, 10, 07, 12, 03, 14, 05, 08, 01, ROT)
+#define TF1024_P2(M, ROT)   TF1024_ROUND(M, 00, 07, 02, 05, 04, 03, 06, 01, 12, 15, 14, 13, 08, 11, 10, 09, ROT)
+#define TF1024_P3(M, ROT)   TF1024_ROUND(M, 00, 15, 02, 11, 06, 13, 04, 09, 14, 01, 08, 05, 10, 03, 12, 07, ROT)
+
+#define TF1024_ENC8(R)                                              \
+    TF1024_P0(TF_MIX, R1024_0);     TF1024_P1(TF_MIX, R1024_1);     \
+    TF1024_P2(TF_MIX, R1024_2);     TF1024_P3(TF_MIX, R1024_3);     \
+    TF1024_KEY(+=, 2 * (R) + 1);                                    \
+    TF1024_P0(TF_MIX, R1024_4);     TF1024_P1(TF_MIX, R1024_5);     \
+    TF1024_P2(TF_MIX, R1024_6);     TF1024_P3(TF_MIX, R1024_7);     \
+    TF1024_KEY(+=, 2 * (R) + 2);
+
+#define TF1024_DEC8(R)                                              \
+    TF1024_KEY(-=, 2 * (R) + 2);                                    \
+    TF1024_P3(TF_UNMIX, R1024_7);   TF1024_P2(TF_UNMIX, R1024_6);   \
+    TF1024_P1(TF_UNMIX, R1024_5);   TF1024_P0(TF_UNMIX, R1024_4);   \
+    TF1024_KEY(-=, 2 * (R) + 1);                                    \
+    TF1024_P3(TF_UNMIX, R1024_3);   TF1024_P2(TF_UNMIX, R1024_2);   \
+    TF1024_P1(TF_UNMIX, R1024_1);   TF1024_P0(TF_UNMIX, R1024_0);
+
+#define TF_TWEAK                                                    \
+    const v4u64 *T = (const v4u64 *) tweak;                         \
+    v4u64       ts[3];                                              \
+                                                                    \
+    ts[0] = T[0];                                                   \
+    ts[1] = T[1];                                                   \
+    ts[2] = ts[0] ^ ts[1];
+
+#define TF256_BODY(CRYPT)                                                       \
+{                                                                               \
+    v4u64       *W = (v4u64 *) words;                                           \
+    v4u64       x0 = W[0], x1 = W[1], x2 = W[2], x3 = W[3];                     \
+    TF_TWEAK                                                                    \
+                                                                                \
+    CRYPT                                                                       \
+                                                                                \
+    W[0] = x0;  W[1] = x1;  W[2] = x2;  W[3] = x3;                              \
+}
+
+#define TF512_BODY(CRYPT)                                                       \
+{                                                                               \
+    v4u64       *W = (v4u64 *) words;                                           \
+    v4u64       x0 = W[0], x1 = W[1], x2 = W[2], x3 = W[3];                     \
+    v4u64       x4 = W[4], x5 = W[5], x6 = W[6], x7 = W[7];                     \
+    TF_TWEAK                                                                    \
+                                                                                \
+    CRYPT                                                                       \
+                                                                                \
+    W[0] = x0;  W[1] = x1;  W[2] = x2;  W[3] = x3;                              \
+    W[4] = x4;  W[5] = x5;  W[6] = x6;  W[7] = x7;                              \
+}
+
+#define TF1024_BODY(CRYPT)                                                      \
+{                                                                               \
+    v4u64       *W = (v4u64 *) words;                                           \
+    v4u64       x00 = W[ 0], x01 = W[ 1], x02 = W[ 2], x03 = W[ 3];             \
+    v4u64       x04 = W[ 4], x05 = W[ 5], x06 = W[ 6], x07 = W[ 7];             \
+    v4u64       x08 = W[ 8], x09 = W[ 9], x10 = W[10], x11 = W[11];             \
+    v4u64       x12 = W[12], x13 = W[13], x14 = W[14], x15 = W[15];             \
+    TF_TWEAK                                                                    \
+                                                                                \
+    CRYPT                                                                       \
+                                                                                \
+    W[ 0] = x00;  W[ 1] = x01;  W[ 2] = x02;  W[ 3] = x03;                      \
+    W[ 4] = x04;  W[ 5] = x05;  W[ 6] = x06;  W[ 7] = x07;                      \
+    W[ 8] = x08;  W[ 9] = x09;  W[10] = x10;  W[11] = x11;                      \
+    W[12] = x12;  W[13] = x13;  W[14] = x14;  W[15] = x15;                      \
+}
+
+#define TF256_ENCRYPT                                                           \
+    TF256_KEY(+=, 0);                                                           \
+    TF256_ENC8(0);  TF256_ENC8(1);  TF256_ENC8(2);                              \
+    TF256_ENC8(3);  TF256_ENC8(4);  TF256_ENC8(5);                              \
+    TF256_ENC8(6);  TF256_ENC8(7);  TF256_ENC8(8);
+
+#define TF256_DECRYPT                                                           \
+    TF256_DEC8(8);  TF256_DEC8(7);  TF256_DEC8(6);                              \
+    TF256_DEC8(5);  TF256_DEC8(4);  TF256_DEC8(3);                              \
+    TF256_DEC8(2);  TF256_DEC8(1);  TF256_DEC8(0);                              \
+    TF256_KEY(-=, 0);
+
+#define TF512_ENCRYPT                                                           \
+    TF512_KEY(+=, 0);                                                           \
+    TF512_ENC8(0);  TF512_ENC8(1);  TF512_ENC8(2);                              \
+    TF512_ENC8(3);  TF512_ENC8(4);  TF512_ENC8(5);                              \
+    TF512_ENC8(6);  TF512_ENC8(7);  TF512_ENC8(8);
+
+#define TF512_DECRYPT                                                           \
+    TF512_DEC8(8);  TF512_DEC8(7);  TF512_DEC8(6);                              \
+    TF512_DEC8(5);  TF512_DEC8(4);  TF512_DEC8(3);                              \
+    TF512_DEC8(2);  TF512_DEC8(1);  TF512_DEC8(0);                              \
+    TF512_KEY(-=, 0);
+
+#define TF1024_ENCRYPT                                                          \
+    TF1024_KEY(+=, 0);                                                          \
+    TF1024_ENC8(0); TF1024_ENC8(1); TF1024_ENC8(2); TF1024_ENC8(3);             \
+    TF1024_ENC8(4); TF1024_ENC8(5); TF1024_ENC8(6); TF1024_ENC8(7);             \
+    TF1024_ENC8(8); TF1024_ENC8(9);
+
+#define TF1024_DECRYPT                                                          \
+    TF1024_DEC8(9); TF1024_DEC8(8); TF1024_DEC8(7); TF1024_DEC8(6);             \
+    TF1024_DEC8(5); TF1024_DEC8(4); TF1024_DEC8(3); TF1024_DEC8(2);             \
+    TF1024_DEC8(1); TF1024_DEC8(0);                                             \
+    TF1024_KEY(-=, 0);
+
+/* each kernel is built for AVX2 and again for AVX-512VL, which has a single
+   instruction rotate */
+
+#define TF_KERNEL(NAME, TARGET, BODY, CRYPT)                                    \
+__attribute__ ((target (TARGET)))                                               \
+static void NAME(const uint64_t *ks, const uint64_t *tweak, uint64_t *words)    \
+BODY(CRYPT)
+
+TF_KERNEL(sThreefish256_Encrypt4,     "avx2",               TF256_BODY,  TF256_ENCRYPT)
+TF_KERNEL(sThreefish256_Decrypt4,     "avx2",               TF256_BODY,  TF256_DECRYPT)
+TF_KERNEL(sThreefish512_Encrypt4,     "avx2",               TF512_BODY,  TF512_ENCRYPT)
+TF_KERNEL(sThreefish512_Decrypt4,     "avx2",               TF512_BODY,  TF512_DECRYPT)
+TF_KERNEL(sThreefish1024_Encrypt4,    "avx2",               TF1024_BODY, TF1024_ENCRYPT)
+TF_KERNEL(sThreefish1024_Decrypt4,    "avx2",               TF1024_BODY, TF1024_DECRYPT)
+
+TF_KERNEL(sThreefish256_Encrypt4VL,   "avx512f,avx512vl",   TF256_BODY,  TF256_ENCRYPT)
+TF_KERNEL(sThreefish256_Decrypt4VL,   "avx512f,avx512vl",   TF256_BODY,  TF256_DECRYPT)
+TF_KERNEL(sThreefish512_Encrypt4VL,   "avx512f,avx512vl",   TF512_BODY,  TF512_ENCRYPT)
+TF_KERNEL(sThreefish512_Decrypt4VL,   "avx512f,avx512vl",   TF512_BODY,  TF512_DECRYPT)
+TF_KERNEL(sThreefish1024_Encrypt4VL,  "avx512f,avx512vl",   TF1024_BODY, TF1024_ENCRYPT)
+TF_KERNEL(sThreefish1024_Decrypt4VL,  "avx512f,avx512vl",   TF1024_BODY, TF1024_DECRYPT)
+
+#endif /* LTC_X86_SIMD */
 
 
 #ifdef __clang__
@@ -20,10 +264,12 @@ struct TBC_Context
 #define kTBC_ContextMagic		0x43347462
     uint32_t            magic;
     Cipher_Algorithm    algor;
-    
+
     int                 keybits;
-    u64b_t             key[16];        // need a copy of key to reset the state
-    
+
+    sTBC_LanesProc      encrypt4;       // kTBC_Lanes blocks at a time, NULL without SIMD
+    sTBC_LanesProc      decrypt4;
+
     ThreefishKey_t       state;
 };
 
@@ -31,9 +277,9 @@ struct TBC_Context
 static bool sTBC_ContextIsValid( const TBC_ContextRef  ref)
 {
     bool       valid	= false;
-    
+
     valid	= IsntNull( ref ) && ref->magic	 == kTBC_ContextMagic;
-    
+
     return( valid );
 }
 
@@ -43,6 +289,38 @@ static bool sTBC_ContextIsValid( const TBC_ContextRef  ref)
 ValidateParam( sTBC_ContextIsValid( s ) )
 
 
+static void sTBC_SelectLanes(TBC_Context *ctx)
+{
+    ctx->encrypt4 = NULL;
+    ctx->decrypt4 = NULL;
+
+#if defined(LTC_X86_SIMD)
+    bool    vl = sCPU_Has(kS4CPU_AVX512F | kS4CPU_AVX512VL);
+
+    if(!sCPU_Has(kS4CPU_AVX2))
+        return;
+
+    switch(ctx->keybits)
+    {
+        case Threefish256:
+            ctx->encrypt4 = vl ? sThreefish256_Encrypt4VL : sThreefish256_Encrypt4;
+            ctx->decrypt4 = vl ? sThreefish256_Decrypt4VL : sThreefish256_Decrypt4;
+            break;
+
+        case Threefish512:
+            ctx->encrypt4 = vl ? sThreefish512_Encrypt4VL : sThreefish512_Encrypt4;
+            ctx->decrypt4 = vl ? sThreefish512_Decrypt4VL : sThreefish512_Decrypt4;
+            break;
+
+        case Threefish1024:
+            ctx->encrypt4 = vl ? sThreefish1024_Encrypt4VL : sThreefish1024_Encrypt4;
+            ctx->decrypt4 = vl ? sThreefish1024_Decrypt4VL : sThreefish1024_Decrypt4;
+            break;
+    }
+#endif
+}
+
+
 S4Err TBC_Init(Cipher_Algorithm algorithm,
                const void *key,
                TBC_ContextRef * ctxOut)
@@ -50,61 +328,69 @@ S4Err TBC_Init(Cipher_Algorithm algorithm,
     int             err     = kS4Err_NoErr;
     TBC_Context*    tbcCTX  = NULL;
     int             keybits  = 0;
-    u64b_t          tweek[3] = {0L,0L };
-    
+    uint64_t        keyWords[16];
+    uint64_t        tweek[3] = {0L,0L };
+
+    ValidateParam(key);
     ValidateParam(ctxOut);
-    
+
     switch(algorithm)
     {
         case kCipher_Algorithm_3FISH256:
             keybits = Threefish256;
             break;
-            
+
         case kCipher_Algorithm_3FISH512:
             keybits = Threefish512;
             break;
-            
+
         case kCipher_Algorithm_3FISH1024:
             keybits = Threefish1024 ;
             break;
-            
+
         default:
             RETERR(kS4Err_BadCipherNumber);
     }
-    
-    
+
+
     tbcCTX = XMALLOC(sizeof (TBC_Context)); CKNULL(tbcCTX);
-    
+
     tbcCTX->magic = kTBC_ContextMagic;
     tbcCTX->algor = algorithm;
     tbcCTX->keybits = keybits;
-    
-    memcpy(tbcCTX->key, key, tbcCTX->keybits >> 3);
-    
-//    Skein_Get64_LSB_First(tbcCTX->key, key, tbcCTX->keybits >>5);   /* bytes to words */
-    
-    threefishSetKey(&tbcCTX->state, tbcCTX->keybits, tbcCTX->key, tweek);
-    
+
+    memcpy(keyWords, key, tbcCTX->keybits >> 3);
+
+//    Skein_Get64_LSB_First(keyWords, key, tbcCTX->keybits >>5);   /* bytes to words */
+
+    /* the key schedule parity word is worked out once here, TBC_SetTweek only
+       replaces the tweak */
+    threefishSetKey(&tbcCTX->state, tbcCTX->keybits, keyWords, tweek);
+
+    sTBC_SelectLanes(tbcCTX);
+
     *ctxOut = tbcCTX;
-    
+
 done:
-    
+
+    ZERO(keyWords, sizeof(keyWords));
+
     if(IsS4Err(err))
     {
         if(tbcCTX)
         {
-            memset(tbcCTX, sizeof (TBC_Context), 0);
+            ZERO(tbcCTX, sizeof (TBC_Context));
             XFREE(tbcCTX);
         }
     }
-    
+
     return err;
-    
+
 }
 
 void TBC_Free(TBC_ContextRef  ctx)
 {
-    
+
     if(sTBC_ContextIsValid(ctx))
     {
         ZERO(ctx, sizeof(TBC_Context));
@@ -117,18 +403,19 @@ S4Err TBC_SetTweek(TBC_ContextRef ctx,
                    const void *	tweekIn)
 {
     S4Err       err = kS4Err_NoErr;
-    u64b_t      tweek[2] = {0L,0L};
-    
+    uint64_t    tweek[2] = {0L,0L};
+
     validateTBCContext(ctx);
-    
+    ValidateParam(tweekIn);
+
     memcpy(tweek, tweekIn, sizeof(tweek));
-    
+
  //   Skein_Get64_LSB_First(tweek, tweekIn, 2);   /* bytes to words */
-    
-    threefishSetKey(&ctx->state, ctx->keybits, ctx->key, tweek);
-    
+
+    threefishSetTweak(&ctx->state, tweek);
+
     return (err);
-    
+
 }
 
 S4Err TBC_Encrypt(TBC_ContextRef ctx,
@@ -136,13 +423,13 @@ S4Err TBC_Encrypt(TBC_ContextRef ctx,
                   void *         out )
 {
     S4Err       err = kS4Err_NoErr;
-    
+
     validateTBCContext(ctx);
-    
+
     threefishEncryptBlockBytes(&ctx->state,(uint8_t*) in, out);
-    
+
     return (err);
-    
+
 }
 
 S4Err TBC_Decrypt(TBC_ContextRef ctx,
@@ -150,11 +437,107 @@ S4Err TBC_Decrypt(TBC_ContextRef ctx,
                   void *         out )
 {
     S4Err       err = kS4Err_NoErr;
-    
+
     validateTBCContext(ctx);
-    
+
     threefishDecryptBlockBytes(&ctx->state,(uint8_t*) in, out);
-    
+
+    return (err);
+}
+
+
+#ifdef __clang__
+#pragma mark - multiple blocks
+#endif
+
+/* the blocks go through the kernel kTBC_Lanes at a time, the ones left over
+   one at a time on a copy of the key, so the tweak TBC_SetTweek set is kept */
+
+static S4Err sTBC_CryptBlocks(TBC_ContextRef ctx,
+                              const TBC_Block *blocks,
+                              size_t     count,
+                              bool       encrypt)
+{
+    S4Err           err = kS4Err_NoErr;
+    sTBC_LanesProc  lanes   = NULL;
+    ThreefishKey_t  key;
+    size_t          words, i, j, w;
+    uint64_t        tweek[2];
+    uint64_t        laneTweek[2 * kTBC_Lanes]         __attribute__ ((aligned (32)));
+    uint64_t        laneWords[16 * kTBC_Lanes]        __attribute__ ((aligned (32)));
+
+    validateTBCContext(ctx);
+    ValidateParam(count == 0 || blocks);
+
+    for(i = 0; i < count; i++)
+        ValidateParam(blocks[i].tweek && blocks[i].in && blocks[i].out);
+
+    words = ctx->keybits >> 6;
+    lanes = encrypt ? ctx->encrypt4 : ctx->decrypt4;
+    i = 0;
+
+    if(lanes)
+    {
+        for(; i + kTBC_Lanes <= count; i += kTBC_Lanes)
+        {
+            for(j = 0; j < kTBC_Lanes; j++)
+            {
+                const uint8_t *in = blocks[i + j].in;
+
+                memcpy(tweek, blocks[i + j].tweek, sizeof(tweek));
+                laneTweek[j]                = tweek[0];
+                laneTweek[kTBC_Lanes + j]   = tweek[1];
+
+                for(w = 0; w < words; w++)
+                    LOAD64L(laneWords[kTBC_Lanes * w + j], in + 8 * w);
+            }
+
+            lanes((const uint64_t *) ctx->state.key, laneTweek, laneWords);
+
+            for(j = 0; j < kTBC_Lanes; j++)
+            {
+                uint8_t *out = blocks[i + j].out;
+
+                for(w = 0; w < words; w++)
+                    STORE64L(laneWords[kTBC_Lanes * w + j], out + 8 * w);
+            }
+        }
+
+        ZERO(laneTweek, sizeof(laneTweek));
+        ZERO(laneWords, sizeof(laneWords));
+    }
+
+    if(i < count)
+    {
+        key = ctx->state;
+
+        for(; i < count; i++)
+        {
+            memcpy(tweek, blocks[i].tweek, sizeof(tweek));
+            threefishSetTweak(&key, tweek);
+
+            if(encrypt)
+                threefishEncryptBlockBytes(&key, (uint8_t*) blocks[i].in, blocks[i].out);
+            else
+                threefishDecryptBlockBytes(&key, (uint8_t*) blocks[i].in, blocks[i].out);
+        }
+
+        ZERO(&key, sizeof(key));
+    }
+
     return (err);
 }
 
+S4Err TBC_EncryptBlocks(TBC_ContextRef ctx,
+                        const TBC_Block *blocks,
+                        size_t         count)
+{
+    return sTBC_CryptBlocks(ctx, blocks, count, true);
+}
+
+S4Err TBC_DecryptBlocks(TBC_ContextRef ctx,
+                        const TBC_Block *blocks,
+                        size_t         count)
+{
+    return sTBC_CryptBlocks(ctx, blocks, count, false);
+}
@@ -0,0 +1,210 @@
+//
+//  s4xts.c
+//  S4
+//
+//  XTS (IEEE 1619) for sectors and pages.  A call takes an array of sectors,
+//  each with its own number, so scattered pages of a database or block device
+//  go through in one call.  The first tweaks of 8 sectors are encrypted
+//  together, then each sector runs through the tomcrypt xts code, which does
+//  AES-NI 8 blocks at a time with the tweaks kept in registers.  Large arrays
+//  are cut into one slice per thread.
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#include "s4Internal.h"
+
+#define kXTS_BlockSize          16
+
+/* sectors whose tweaks go through the cipher together */
+#define kXTS_TweakBatch         8
+
+/* IEEE 1619 allows at most 2^20 blocks under one tweak */
+#define kXTS_MaxSectorSize      ((size_t)1 << 24)
+
+typedef struct XTS_Context    XTS_Context;
+
+struct XTS_Context
+{
+#define kXTS_ContextMagic		0x43347874
+    uint32_t            magic;
+    Cipher_Algorithm    algor;
+    size_t              sectorSize;
+    uint32_t            threadCount;
+    symmetric_xts       xts;
+};
+
+typedef struct
+{
+    XTS_Context         *ctx;
+    const XTS_Sector    *sectors;
+    int                 direction;
+} sXTS_Array;
+
+
+static bool sXTS_ContextIsValid( const XTS_ContextRef  ref)
+{
+    bool       valid	= false;
+
+    valid	= IsntNull( ref ) && ref->magic	 == kXTS_ContextMagic;
+
+    return( valid );
+}
+
+#define validateXTSContext( s )		\
+ValidateParam( sXTS_ContextIsValid( s ) )
+
+
+#ifdef __clang__
+#pragma mark - Sectors
+#endif
+
+/* one slice of the array on one thread */
+
+static int sXTS_Crypt(XTS_Context *ctx, const XTS_Sector *sectors, size_t count, int direction)
+{
+    const struct ltc_cipher_descriptor *desc = &cipher_descriptor[ctx->xts.cipher];
+    symmetric_xts   *xts = &ctx->xts;
+    uint8_t         tweaks[kXTS_TweakBatch * kXTS_BlockSize];
+    size_t          i, j, n;
+    int             status = CRYPT_OK;
+
+    for(i = 0; i < count && status == CRYPT_OK; i += n)
+    {
+        n = MIN(count - i, kXTS_TweakBatch);
+
+        /* the sector number as a 128 bit little endian tweak */
+        ZERO(tweaks, sizeof(tweaks));
+        for(j = 0; j < n; j++)
+            STORE64L(sectors[i + j].sector, tweaks + j * kXTS_BlockSize);
+
+        if(desc->accel_ecb_encrypt)
+            status = desc->accel_ecb_encrypt(tweaks, tweaks, n, &xts->key2);
+        else
+            for(j = 0; j < n && status == CRYPT_OK; j++)
+                status = desc->ecb_encrypt(tweaks + j * kXTS_BlockSize, tweaks + j * kXTS_BlockSize, &xts->key2);
+        if(status != CRYPT_OK)
+            break;
+
+        for(j = 0; j < n && status == CRYPT_OK; j++)
+        {
+            const XTS_Sector *s = &sectors[i + j];
+
+            if(direction == XTS_ENCRYPT)
+                status = xts_tweaked_encrypt(s->in, ctx->sectorSize, s->out, tweaks + j * kXTS_BlockSize, xts);
+            else
+                status = xts_tweaked_decrypt(s->in, ctx->sectorSize, s->out, tweaks + j * kXTS_BlockSize, xts);
+        }
+    }
+
+    ZERO(tweaks, sizeof(tweaks));
+
+    return status;
+}
+
+static int sXTS_Slice(void *arg, size_t first, size_t count)
+{
+    const sXTS_Array *array = arg;
+
+    return sXTS_Crypt(array->ctx, array->sectors + first, count, array->direction);
+}
+
+static S4Err sXTS_CryptSectors(XTS_ContextRef ctx, const XTS_Sector *sectors, size_t count, int direction)
+{
+    S4Err       err     = kS4Err_NoErr;
+    int         status  = CRYPT_OK;
+    sXTS_Array  array   = { ctx, sectors, direction };
+    size_t      i;
+
+    validateXTSContext(ctx);
+    ValidateParam(count == 0 || sectors);
+
+    for(i = 0; i < count; i++)
+        ValidateParam(sectors[i].in && sectors[i].out);
+
+    status = sSliceRun(sXTS_Slice, &array, count, ctx->sectorSize, ctx->threadCount);
+
+    if(status != CRYPT_OK)
+        err = sCrypt2S4Err(status);
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Public
+#endif
+
+S4Err XTS_Init(Cipher_Algorithm algorithm,
+               const void *key,
+               size_t     sectorSize,
+               uint32_t   threadCount,
+               XTS_ContextRef * ctxOut)
+{
+    int             err     = kS4Err_NoErr;
+    XTS_Context*    xtsCTX  = NULL;
+    int             keylen  = 0;
+    int             cipher  = -1;
+    int             status  =  CRYPT_OK;
+
+    ValidateParam(key);
+    ValidateParam(sectorSize >= kXTS_BlockSize && sectorSize <= kXTS_MaxSectorSize);
+    ValidateParam(ctxOut);
+
+    err = sCipherForAlgorithm(algorithm, &cipher, &keylen); CKERR;
+
+    /* SP 800-38E, the data key and the tweak key have to differ */
+    ValidateParam(!CMP(key, (const uint8_t *)key + keylen, keylen));
+
+    status = cipher_is_valid(cipher); CKSTAT;
+
+    xtsCTX = XMALLOC(sizeof (XTS_Context)); CKNULL(xtsCTX);
+    ZERO(xtsCTX, sizeof(XTS_Context));
+
+    xtsCTX->magic       = kXTS_ContextMagic;
+    xtsCTX->algor       = algorithm;
+    xtsCTX->sectorSize  = sectorSize;
+    xtsCTX->threadCount = sSliceThreadCount(threadCount);
+
+    status = xts_start(cipher, key, (const uint8_t *)key + keylen, keylen, 0, &xtsCTX->xts); CKSTAT;
+
+    *ctxOut = xtsCTX;
+
+done:
+
+    if(status != CRYPT_OK)
+    {
+        if(xtsCTX)
+        {
+            ZERO(xtsCTX, sizeof(XTS_Context));
+            XFREE(xtsCTX);
+        }
+        err = sCrypt2S4Err(status);
+    }
+
+    return err;
+}
+
+S4Err XTS_EncryptSectors(XTS_ContextRef ctx,
+                         const XTS_Sector *sectors,
+                         size_t         count)
+{
+    return sXTS_CryptSectors(ctx, sectors, count, XTS_ENCRYPT);
+}
+
+S4Err XTS_DecryptSectors(XTS_ContextRef ctx,
+                         const XTS_Sector *sectors,
+                         size_t         count)
+{
+    return sXTS_CryptSectors(ctx, sectors, count, XTS_DECRYPT);
+}
+
+void XTS_Free(XTS_ContextRef  ctx)
+{
+    if(sXTS_ContextIsValid(ctx))
+    {
+        xts_done(&ctx->xts);
+        ZERO(ctx, sizeof(XTS_Context));
+        XFREE(ctx);
+    }
+}
@@ -34,24 +34,42 @@
 
 #pragma clang diagnostic ignored "-Wconversion"
 
+#ifdef LTC_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #ifdef LTC_RIJNDAEL
 
 #ifndef ENCRYPT_ONLY 
 
-#define SETUP    rijndael_setup
-#define ECB_ENC  rijndael_ecb_encrypt
-#define ECB_DEC  rijndael_ecb_decrypt
+/* the table code below is the LTC_AES_BACKEND_C backend, rijndael_setup and the
+   block functions dispatch to whichever backend is selected */
+#define SETUP    rijndael_setup_c
+#define ECB_ENC  rijndael_ecb_encrypt_c
+#define ECB_DEC  rijndael_ecb_decrypt_c
 #define ECB_DONE rijndael_done
 #define ECB_TEST rijndael_test
 #define ECB_KS   rijndael_keysize
 
+static int rijndael_setup_c(const unsigned char *key, int keylen, int num_rounds, symmetric_key *skey);
+static int rijndael_ecb_encrypt_c(const unsigned char *pt, unsigned char *ct, symmetric_key *skey);
+static int rijndael_ecb_decrypt_c(const unsigned char *ct, unsigned char *pt, symmetric_key *skey);
+
+static int rijndael_accel_ecb_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long blocks, symmetric_key *skey);
+static int rijndael_accel_ecb_decrypt(const unsigned char *ct, unsigned char *pt, unsigned long blocks, symmetric_key *skey);
+static int rijndael_accel_cbc_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long blocks, unsigned char *IV, symmetric_key *skey);
+static int rijndael_accel_cbc_decrypt(const unsigned char *ct, unsigned char *pt, unsigned long blocks, unsigned char *IV, symmetric_key *skey);
+static int rijndael_accel_ctr_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long blocks, unsigned char *IV, int mode, symmetric_key *skey);
+
 const struct ltc_cipher_descriptor rijndael_desc =
 {
     "rijndael",
     6,
     16, 32, 16, 10,
-    SETUP, ECB_ENC, ECB_DEC, ECB_TEST, ECB_DONE, ECB_KS,
-    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+    rijndael_setup, rijndael_ecb_encrypt, rijndael_ecb_decrypt, ECB_TEST, ECB_DONE, ECB_KS,
+    rijndael_accel_ecb_encrypt, rijndael_accel_ecb_decrypt,
+    rijndael_accel_cbc_encrypt, rijndael_accel_cbc_decrypt, rijndael_accel_ctr_encrypt,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL
 };
 
 const struct ltc_cipher_descriptor aes_desc =
@@ -59,8 +77,10 @@ const struct ltc_cipher_descriptor aes_desc =
     "aes",
     6,
     16, 32, 16, 10,
-    SETUP, ECB_ENC, ECB_DEC, ECB_TEST, ECB_DONE, ECB_KS,
-    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+    rijndael_setup, rijndael_ecb_encrypt, rijndael_ecb_decrypt, ECB_TEST, ECB_DONE, ECB_KS,
+    rijndael_accel_ecb_encrypt, rijndael_accel_ecb_decrypt,
+    rijndael_accel_cbc_encrypt, rijndael_accel_cbc_decrypt, rijndael_accel_ctr_encrypt,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL
 };
 
 #else
@@ -723,6 +743,1138 @@ int ECB_TEST(void)
 #endif /* ENCRYPT_ONLY */
 
 
+#ifndef ENCRYPT_ONLY
+
+static void rijndael_ctr_increment(unsigned char *ctr, int mode, int width)
+{
+    int x;
+
+    if (mode & CTR_COUNTER_BIG_ENDIAN) {
+       for (x = 15; x >= 16 - width; x--) {
+          ctr[x] = (ctr[x] + (unsigned char)1) & (unsigned char)255;
+          if (ctr[x] != (unsigned char)0) {
+             break;
+          }
+       }
+    } else {
+       for (x = 0; x < width; x++) {
+          ctr[x] = (ctr[x] + (unsigned char)1) & (unsigned char)255;
+          if (ctr[x] != (unsigned char)0) {
+             break;
+          }
+       }
+    }
+}
+
+#ifdef LTC_X86_SIMD
+/* AES-NI.  The round keys keep the eK/dK layout of the table code, words loaded
+   big endian, so a key scheduled by one backend works with the other.  Each round
+   key is swapped back into AES byte order as it is loaded, and dK already is the
+   equivalent inverse cipher schedule AESDEC wants. */
+
+#define AESNI_ORDER()   _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3)
+#define AESNI_KEY(K, r) _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)((K) + 4*(r))), AESNI_ORDER())
+
+/* up to 8 blocks are in flight, AESENC has a latency of several cycles but issues every cycle */
+#define AESNI_LANES     8
+
+#define AESNI_ROUND8(op, b, k)                                                  \
+    b[0] = op(b[0], k); b[1] = op(b[1], k); b[2] = op(b[2], k); b[3] = op(b[3], k); \
+    b[4] = op(b[4], k); b[5] = op(b[5], k); b[6] = op(b[6], k); b[7] = op(b[7], k);
+
+__attribute__((target("aes,ssse3")))
+static int rijndael_setup_aesni(const unsigned char *key, int keylen, int num_rounds, symmetric_key *skey)
+{
+    ulong32 w[60], temp, rc = 1;
+    int Nk, Nr, i;
+    __m128i k;
+
+    LTC_ARGCHK(key  != NULL);
+    LTC_ARGCHK(skey != NULL);
+
+    if (keylen != 16 && keylen != 24 && keylen != 32) {
+       return CRYPT_INVALID_KEYSIZE;
+    }
+
+    if (num_rounds != 0 && num_rounds != (10 + ((keylen/8)-2)*2)) {
+       return CRYPT_INVALID_ROUNDS;
+    }
+
+    Nk = keylen / 4;
+    Nr = skey->rijndael.Nr = Nk + 6;
+
+    /* FIPS-197 expansion on words in byte order, AESKEYGENASSIST does the S-box
+       lookups in constant time: dword 1 of the result is RotWord(SubWord(X1)),
+       dword 0 is SubWord(X1) */
+    for (i = 0; i < Nk; i++) {
+        LOAD32L(w[i], key + 4*i);
+    }
+    for (i = Nk; i < 4 * (Nr + 1); i++) {
+        temp = w[i - 1];
+        if (i % Nk == 0) {
+            k    = _mm_aeskeygenassist_si128(_mm_set_epi32(0, 0, (int)temp, 0), 0);
+            temp = (ulong32)_mm_cvtsi128_si32(_mm_shuffle_epi32(k, 0x55)) ^ rc;
+            rc   = (rc << 1) ^ ((rc >> 7) * 0x11b);
+        } else if (Nk > 6 && i % Nk == 4) {
+            k    = _mm_aeskeygenassist_si128(_mm_set_epi32(0, 0, (int)temp, 0), 0);
+            temp = (ulong32)_mm_cvtsi128_si32(k);
+        }
+        w[i] = w[i - Nk] ^ temp;
+    }
+
+    /* the same byte swap turns them into table words */
+    for (i = 0; i <= Nr; i++) {
+        k = _mm_loadu_si128((const __m128i *)(w + 4*i));
+        _mm_storeu_si128((__m128i *)(skey->rijndael.eK + 4*i), _mm_shuffle_epi8(k, AESNI_ORDER()));
+
+        if (i > 0 && i < Nr) {
+            k = _mm_aesimc_si128(k);
+        }
+        _mm_storeu_si128((__m128i *)(skey->rijndael.dK + 4*(Nr - i)), _mm_shuffle_epi8(k, AESNI_ORDER()));
+    }
+
+    zeromem(w, sizeof(w));
+    return CRYPT_OK;
+}
+
+__attribute__((target("aes,ssse3")))
+static int rijndael_ecb_encrypt_aesni(const unsigned char *pt, unsigned char *ct, symmetric_key *skey)
+{
+    const ulong32 *K = skey->rijndael.eK;
+    int Nr = skey->rijndael.Nr, r;
+    __m128i b;
+
+    LTC_ARGCHK(pt != NULL);
+    LTC_ARGCHK(ct != NULL);
+    LTC_ARGCHK(skey != NULL);
+
+    b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pt), AESNI_KEY(K, 0));
+    for (r = 1; r < Nr; r++) {
+        b = _mm_aesenc_si128(b, AESNI_KEY(K, r));
+    }
+    b = _mm_aesenclast_si128(b, AESNI_KEY(K, Nr));
+    _mm_storeu_si128((__m128i *)ct, b);
+
+    return CRYPT_OK;
+}
+
+__attribute__((target("aes,ssse3")))
+static int rijndael_ecb_decrypt_aesni(const unsigned char *ct, unsigned char *pt, symmetric_key *skey)
+{
+    const ulong32 *K = skey->rijndael.dK;
+    int Nr = skey->rijndael.Nr, r;
+    __m128i b;
+
+    LTC_ARGCHK(pt != NULL);
+    LTC_ARGCHK(ct != NULL);
+    LTC_ARGCHK(skey != NULL);
+
+    b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)ct), AESNI_KEY(K, 0));
+    for (r = 1; r < Nr; r++) {
+        b = _mm_aesdec_si128(b, AESNI_KEY(K, r));
+    }
+    b = _mm_aesdeclast_si128(b, AESNI_KEY(K, Nr));
+    _mm_storeu_si128((__m128i *)pt, b);
+
+    return CRYPT_OK;
+}
+
+__attribute__((target("aes,ssse3")))
+static void rijndael_load_keys_aesni(const ulong32 *K, int Nr, __m128i rk[15])
+{
+    int r;
+
+    for (r = 0; r <= Nr; r++) {
+        rk[r] = AESNI_KEY(K, r);
+    }
+}
+
+/* 8 blocks in b through the whole cipher */
+__attribute__((target("aes,ssse3")))
+static void rijndael_encrypt8_aesni(__m128i b[8], const __m128i rk[15], int Nr)
+{
+    int r;
+
+    AESNI_ROUND8(_mm_xor_si128, b, rk[0]);
+    for (r = 1; r < Nr; r++) {
+        AESNI_ROUND8(_mm_aesenc_si128, b, rk[r]);
+    }
+    AESNI_ROUND8(_mm_aesenclast_si128, b, rk[Nr]);
+}
+
+__attribute__((target("aes,ssse3")))
+static void rijndael_decrypt8_aesni(__m128i b[8], const __m128i rk[15], int Nr)
+{
+    int r;
+
+    AESNI_ROUND8(_mm_xor_si128, b, rk[0]);
+    for (r = 1; r < Nr; r++) {
+        AESNI_ROUND8(_mm_aesdec_si128, b, rk[r]);
+    }
+    AESNI_ROUND8(_mm_aesdeclast_si128, b, rk[Nr]);
+}
+
+__attribute__((target("aes,ssse3")))
+static int rijndael_accel_ecb_encrypt_aesni(const unsigned char *pt, unsigned char *ct, unsigned long blocks, symmetric_key *skey)
+{
+    __m128i rk[15], b[AESNI_LANES];
+    int i;
+
+    rijndael_load_keys_aesni(skey->rijndael.eK, skey->rijndael.Nr, rk);
+
+    for (; blocks >= AESNI_LANES; blocks -= AESNI_LANES) {
+        for (i = 0; i < AESNI_LANES; i++) {
+            b[i] = _mm_loadu_si128((const __m128i *)pt + i);
+        }
+        rijndael_encrypt8_aesni(b, rk, skey->rijndael.Nr);
+        for (i = 0; i < AESNI_LANES; i++) {
+            _mm_storeu_si128((__m128i *)ct + i, b[i]);
+        }
+        pt += 16 * AESNI_LANES;
+        ct += 16 * AESNI_LANES;
+    }
+
+    for (; blocks > 0; blocks--, pt += 16, ct += 16) {
+        rijndael_ecb_encrypt_aesni(pt, ct, skey);
+    }
+
+    return CRYPT_OK;
+}
+
+__attribute__((target("aes,ssse3")))
+static int rijndael_accel_ecb_decrypt_aesni(const unsigned char *ct, unsigned char *pt, unsigned long blocks, symmetric_key *skey)
+{
+    __m128i rk[15], b[AESNI_LANES];
+    int i;
+
+    rijndael_load_keys_aesni(skey->rijndael.dK, skey->rijndael.Nr, rk);
+
+    for (; blocks >= AESNI_LANES; blocks -= AESNI_LANES) {
+        for (i = 0; i < AESNI_LANES; i++) {
+            b[i] = _mm_loadu_si128((const __m128i *)ct + i);
+        }
+        rijndael_decrypt8_aesni(b, rk, skey->rijndael.Nr);
+        for (i = 0; i < AESNI_LANES; i++) {
+            _mm_storeu_si128((__m128i *)pt + i, b[i]);
+        }
+        ct += 16 * AESNI_LANES;
+        pt += 16 * AESNI_LANES;
+    }
+
+    for (; blocks > 0; blocks--, ct += 16, pt += 16) {
+        rijndael_ecb_decrypt_aesni(ct, pt, skey);
+    }
+
+    return CRYPT_OK;
+}
+
+/* each block waits on the one before, this only saves the per block overhead */
+__attribute__((target("aes,ssse3")))
+static int rijndael_accel_cbc_encrypt_aesni(const unsigned char *pt, unsigned char *ct, unsigned long blocks, unsigned char *IV, symmetric_key *skey)
+{
+    __m128i rk[15], b;
+    int Nr = skey->rijndael.Nr, r;
+
+    rijndael_load_keys_aesni(skey->rijndael.eK, Nr, rk);
+
+    b = _mm_loadu_si128((const __m128i *)IV);
+    for (; blocks > 0; blocks--, pt += 16, ct += 16) {
+        b = _mm_xor_si128(b, _mm_xor_si128(_mm_loadu_si128((const __m128i *)pt), rk[0]));
+        for (r = 1; r < Nr; r++) {
+            b = _mm_aesenc_si128(b, rk[r]);
+        }
+        b = _mm_aesenclast_si128(b, rk[Nr]);
+        _mm_storeu_si128((__m128i *)ct, b);
+    }
+    _mm_storeu_si128((__m128i *)IV, b);
+
+    return CRYPT_OK;
+}
+
+/* the ciphertext is all there, so unlike encryption the blocks are independent */
+__attribute__((target("aes,ssse3")))
+static int rijndael_accel_cbc_decrypt_aesni(const unsigned char *ct, unsigned char *pt, unsigned long blocks, unsigned char *IV, symmetric_key *skey)
+{
+    __m128i rk[15], b[AESNI_LANES], prev, c;
+    int Nr = skey->rijndael.Nr, i, r;
+
+    rijndael_load_keys_aesni(skey->rijndael.dK, Nr, rk);
+
+    prev = _mm_loadu_si128((const __m128i *)IV);
+
+    for (; blocks >= AESNI_LANES; blocks -= AESNI_LANES) {
+        for (i = 0; i < AESNI_LANES; i++) {
+            b[i] = _mm_loadu_si128((const __m128i *)ct + i);
+        }
+        rijndael_decrypt8_aesni(b, rk, Nr);
+
+        /* reload the ciphertext, pt may be ct */
+        for (i = 0; i < AESNI_LANES; i++) {
+            c = _mm_loadu_si128((const __m128i *)ct + i);
+            _mm_storeu_si128((__m128i *)pt + i, _mm_xor_si128(b[i], prev));
+            prev = c;
+        }
+        ct += 16 * AESNI_LANES;
+        pt += 16 * AESNI_LANES;
+    }
+
+    for (; blocks > 0; blocks--, ct += 16, pt += 16) {
+        c = _mm_loadu_si128((const __m128i *)ct);
+        b[0] = _mm_xor_si128(c, rk[0]);
+        for (r = 1; r < Nr; r++) {
+            b[0] = _mm_aesdec_si128(b[0], rk[r]);
+        }
+        b[0] = _mm_aesdeclast_si128(b[0], rk[Nr]);
+        _mm_storeu_si128((__m128i *)pt, _mm_xor_si128(b[0], prev));
+        prev = c;
+    }
+    _mm_storeu_si128((__m128i *)IV, prev);
+
+    return CRYPT_OK;
+}
+
+__attribute__((target("aes,ssse3")))
+static int rijndael_accel_ctr_encrypt_aesni(const unsigned char *pt, unsigned char *ct, unsigned long blocks, unsigned char *IV, int mode, symmetric_key *skey)
+{
+    const __m128i REVERSE = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i rk[15], b[AESNI_LANES], ctr;
+    unsigned char cb[16];
+    int Nr = skey->rijndael.Nr, width = mode & 255, i;
+    ulong32 low;
+
+    rijndael_load_keys_aesni(skey->rijndael.eK, Nr, rk);
+
+    while (blocks > 0) {
+        /* a big endian counter of 32 bits or more that does not carry out of its
+           low word in this batch is a vector add, anything else goes byte by byte */
+        LOAD32H(low, IV + 12);
+        if ((mode & CTR_COUNTER_BIG_ENDIAN) && width >= 4 && low <= 0xFFFFFFFFUL - AESNI_LANES && blocks >= AESNI_LANES) {
+            ctr = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)IV), REVERSE);
+            for (i = 0; i < AESNI_LANES; i++) {
+                b[i] = _mm_shuffle_epi8(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, i + 1)), REVERSE);
+            }
+            _mm_storeu_si128((__m128i *)IV, b[AESNI_LANES - 1]);
+        } else {
+            for (i = 0; i < AESNI_LANES; i++) {
+                if ((unsigned long)i < blocks) {
+                    rijndael_ctr_increment(IV, mode, width);
+                }
+                XMEMCPY(cb, IV, 16);
+                b[i] = _mm_loadu_si128((const __m128i *)cb);
+            }
+        }
+
+        rijndael_encrypt8_aesni(b, rk, Nr);
+
+        if (blocks >= AESNI_LANES) {
+            for (i = 0; i < AESNI_LANES; i++) {
+                _mm_storeu_si128((__m128i *)ct + i, _mm_xor_si128(b[i], _mm_loadu_si128((const __m128i *)pt + i)));
+            }
+            pt     += 16 * AESNI_LANES;
+            ct     += 16 * AESNI_LANES;
+            blocks -= AESNI_LANES;
+        } else {
+            /* the last few, the spare lanes encrypted the final counter again */
+            for (i = 0; (unsigned long)i < blocks; i++) {
+                _mm_storeu_si128((__m128i *)ct + i, _mm_xor_si128(b[i], _mm_loadu_si128((const __m128i *)pt + i)));
+            }
+            blocks = 0;
+        }
+    }
+
+    return CRYPT_OK;
+}
+
+#undef AESNI_ROUND8
+
+#endif /* LTC_X86_SIMD */
+
+#ifdef LTC_X86_SIMD
+/* Vector permute AES after Hamburg, "Accelerating AES with Vector Permute
+   Instructions" (CHES 2009).  Every S-box lookup is a 16 entry byte shuffle
+   indexed by a nibble, so there are no secret dependent memory accesses.
+   The state lives in a tower field basis GF((2^4)^2) where the inverse takes
+   five shuffles; MixColumns is linear so it runs in that basis too, and the
+   round keys are moved into it as they are loaded.  The key schedule is the
+   eK/dK layout of the table code, like the AES-NI backend.  x86 only for now,
+   ARM builds still run the T-tables until the NEON port lands. */
+
+typedef __m128i vpaes_vec;
+#define VPAES_TARGET        __attribute__((target("ssse3")))
+#define VPAES_INLINE        __attribute__((target("ssse3"), always_inline))
+#define VPAES_LOAD(p)       _mm_loadu_si128((const __m128i *)(const void *)(p))
+#define VPAES_STORE(p, v)   _mm_storeu_si128((__m128i *)(void *)(p), v)
+#define VPAES_XOR(a, b)     _mm_xor_si128(a, b)
+#define VPAES_TBL(t, i)     _mm_shuffle_epi8(t, i)
+#define VPAES_LO(v)         _mm_and_si128(v, _mm_set1_epi8(15))
+#define VPAES_HI(v)         _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(15))
+#define VPAES_ADD32(a, b)   _mm_add_epi32(a, b)
+
+enum {
+   VPAES_IPT_LO,
+   VPAES_IPT_HI,
+   VPAES_INV,
+   VPAES_INVA,
+   VPAES_SB1U,
+   VPAES_SB1T,
+   VPAES_SB2U,
+   VPAES_SB2T,
+   VPAES_SBOU,
+   VPAES_SBOT,
+   VPAES_DIPT_LO,
+   VPAES_DIPT_HI,
+   VPAES_DSBEU,
+   VPAES_DSBET,
+   VPAES_DSBBU,
+   VPAES_DSBBT,
+   VPAES_DSBDU,
+   VPAES_DSBDT,
+   VPAES_DSB9U,
+   VPAES_DSB9T,
+   VPAES_DSBOU,
+   VPAES_DSBOT,
+   VPAES_K63,
+   VPAES_M63,
+   VPAES_REVERSE,
+   VPAES_ONE,
+   VPAES_ROWS
+};
+
+static const unsigned char vpaes_tab[VPAES_ROWS][16] = {
+   /* input transform into the tower basis, low and high nibble */
+   { 0x00, 0x70, 0x2a, 0x5a, 0x98, 0xe8, 0xb2, 0xc2, 0x08, 0x78, 0x22, 0x52, 0x90, 0xe0, 0xba, 0xca },
+   { 0x00, 0x4d, 0x7c, 0x31, 0x7d, 0x30, 0x01, 0x4c, 0x81, 0xcc, 0xfd, 0xb0, 0xfc, 0xb1, 0x80, 0xcd },
+   /* 1/x and a/x in GF(16), 0x80 stands for 1/0 and looks up as zero */
+   { 0x80, 0x01, 0x08, 0x0d, 0x0f, 0x06, 0x05, 0x0e, 0x02, 0x0c, 0x0b, 0x0a, 0x09, 0x03, 0x07, 0x04 },
+   { 0x80, 0x07, 0x0b, 0x0f, 0x06, 0x0a, 0x04, 0x01, 0x09, 0x08, 0x05, 0x02, 0x0c, 0x0e, 0x0d, 0x03 },
+   /* S-box output, and twice it, in the tower basis */
+   { 0x00, 0x3e, 0x50, 0xcb, 0x8f, 0xe1, 0x9b, 0xb1, 0x44, 0xf5, 0x2a, 0x14, 0x6e, 0x7a, 0xdf, 0xa5 },
+   { 0x00, 0x23, 0xe2, 0xfa, 0x15, 0xd4, 0x18, 0x36, 0xef, 0xd9, 0x2e, 0x0d, 0xc1, 0xcc, 0xf7, 0x3b },
+   { 0x00, 0x24, 0x71, 0x0b, 0xc6, 0x93, 0x7a, 0xe2, 0xcd, 0x2f, 0x98, 0xbc, 0x55, 0xe9, 0xb7, 0x5e },
+   { 0x00, 0x29, 0xe1, 0x0a, 0x40, 0x88, 0xeb, 0x69, 0x4a, 0x23, 0x82, 0xab, 0xc8, 0x63, 0xa1, 0xc2 },
+   /* last round S-box output in the AES basis */
+   { 0x00, 0xc7, 0xbd, 0x6f, 0x17, 0x6d, 0xd2, 0xd0, 0x78, 0xa8, 0x02, 0xc5, 0x7a, 0xbf, 0xaa, 0x15 },
+   { 0x00, 0x6a, 0xbb, 0x5f, 0xa5, 0x74, 0xe4, 0xcf, 0xfa, 0x35, 0x2b, 0x41, 0xd1, 0x90, 0x1e, 0x8e },
+   /* inverse cipher input transform, the inverse affine constant folded in */
+   { 0xe8, 0xb7, 0xbc, 0xe3, 0xec, 0xb3, 0xb8, 0xe7, 0xf2, 0xad, 0xa6, 0xf9, 0xf6, 0xa9, 0xa2, 0xfd },
+   { 0x00, 0x65, 0x05, 0x60, 0xe6, 0x83, 0xe3, 0x86, 0x94, 0xf1, 0x91, 0xf4, 0x72, 0x17, 0x77, 0x12 },
+   /* inverse S-box output times 14, 11, 13 and 9 */
+   { 0x00, 0xd0, 0xd4, 0x26, 0x96, 0x92, 0xf2, 0x46, 0xb0, 0xf6, 0xb4, 0x64, 0x04, 0x60, 0x42, 0x22 },
+   { 0x00, 0xc1, 0xaa, 0xff, 0xcd, 0xa6, 0x55, 0x0c, 0x32, 0x3e, 0x59, 0x98, 0x6b, 0xf3, 0x67, 0x94 },
+   { 0x00, 0x42, 0xb4, 0x96, 0x92, 0x64, 0x22, 0xd0, 0x04, 0xd4, 0xf2, 0xb0, 0xf6, 0x46, 0x26, 0x60 },
+   { 0x00, 0x67, 0x59, 0xcd, 0xa6, 0x98, 0x94, 0xc1, 0x6b, 0xaa, 0x55, 0x32, 0x3e, 0x0c, 0xff, 0xf3 },
+   { 0x00, 0xa2, 0xb1, 0xe6, 0xdf, 0xcc, 0x57, 0x7d, 0x39, 0x44, 0x2a, 0x88, 0x13, 0x9b, 0x6e, 0xf5 },
+   { 0x00, 0xcb, 0xc6, 0x24, 0xf7, 0xfa, 0xe2, 0x3c, 0xd3, 0xef, 0xde, 0x15, 0x0d, 0x18, 0x31, 0x29 },
+   { 0x00, 0xd6, 0x86, 0x9a, 0x53, 0x03, 0x1c, 0x85, 0xc9, 0x4c, 0x99, 0x4f, 0x50, 0x1f, 0xd5, 0xca },
+   { 0x00, 0x49, 0xd7, 0xec, 0x89, 0x17, 0x3b, 0xc0, 0x65, 0xa5, 0xfb, 0xb2, 0x9e, 0x2c, 0x5e, 0x72 },
+   /* last round inverse S-box output in the AES basis */
+   { 0x00, 0x40, 0xf9, 0x7e, 0x53, 0xea, 0x87, 0x13, 0x2d, 0x3e, 0x94, 0xd4, 0xb9, 0x6d, 0xaa, 0xc7 },
+   { 0x00, 0x1d, 0x44, 0x93, 0x0f, 0x56, 0xd7, 0x12, 0x9c, 0x8e, 0xc5, 0xd8, 0x59, 0x81, 0x4b, 0xca },
+   /* the S-box constant in the AES basis and in the tower basis */
+   { 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63 },
+   { 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b, 0x5b },
+   /* big endian counters as little endian words, and one to add to them */
+   { 0x0f, 0x0e, 0x0d, 0x0c, 0x0b, 0x0a, 0x09, 0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01, 0x00 },
+   { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
+};
+
+/* ShiftRows is never applied, after round r the state sits in the byte order
+   ShiftRows^r (InvShiftRows^r) leaves it in.  For each r mod 4: the round key
+   words into that order, the rotations within a column, and the way back to
+   AES byte order for the output. */
+enum {
+   VPAES_PERM_KEY,
+   VPAES_PERM_ROT1,
+   VPAES_PERM_ROT2,
+   VPAES_PERM_ROT3,
+   VPAES_PERM_OUT,
+   VPAES_PERMS
+};
+
+static const unsigned char vpaes_enc_perm[4][VPAES_PERMS][16] = {
+   {
+      { 0x03, 0x02, 0x01, 0x00, 0x07, 0x06, 0x05, 0x04, 0x0b, 0x0a, 0x09, 0x08, 0x0f, 0x0e, 0x0d, 0x0c },
+      { 0x01, 0x02, 0x03, 0x00, 0x05, 0x06, 0x07, 0x04, 0x09, 0x0a, 0x0b, 0x08, 0x0d, 0x0e, 0x0f, 0x0c },
+      { 0x02, 0x03, 0x00, 0x01, 0x06, 0x07, 0x04, 0x05, 0x0a, 0x0b, 0x08, 0x09, 0x0e, 0x0f, 0x0c, 0x0d },
+      { 0x03, 0x00, 0x01, 0x02, 0x07, 0x04, 0x05, 0x06, 0x0b, 0x08, 0x09, 0x0a, 0x0f, 0x0c, 0x0d, 0x0e },
+      { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f }
+   },
+   {
+      { 0x03, 0x0e, 0x09, 0x04, 0x07, 0x02, 0x0d, 0x08, 0x0b, 0x06, 0x01, 0x0c, 0x0f, 0x0a, 0x05, 0x00 },
+      { 0x05, 0x06, 0x07, 0x04, 0x09, 0x0a, 0x0b, 0x08, 0x0d, 0x0e, 0x0f, 0x0c, 0x01, 0x02, 0x03, 0x00 },
+      { 0x0a, 0x0b, 0x08, 0x09, 0x0e, 0x0f, 0x0c, 0x0d, 0x02, 0x03, 0x00, 0x01, 0x06, 0x07, 0x04, 0x05 },
+      { 0x0f, 0x0c, 0x0d, 0x0e, 0x03, 0x00, 0x01, 0x02, 0x07, 0x04, 0x05, 0x06, 0x0b, 0x08, 0x09, 0x0a },
+      { 0x00, 0x05, 0x0a, 0x0f, 0x04, 0x09, 0x0e, 0x03, 0x08, 0x0d, 0x02, 0x07, 0x0c, 0x01, 0x06, 0x0b }
+   },
+   {
+      { 0x03, 0x0a, 0x01, 0x08, 0x07, 0x0e, 0x05, 0x0c, 0x0b, 0x02, 0x09, 0x00, 0x0f, 0x06, 0x0d, 0x04 },
+      { 0x09, 0x0a, 0x0b, 0x08, 0x0d, 0x0e, 0x0f, 0x0c, 0x01, 0x02, 0x03, 0x00, 0x05, 0x06, 0x07, 0x04 },
+      { 0x02, 0x03, 0x00, 0x01, 0x06, 0x07, 0x04, 0x05, 0x0a, 0x0b, 0x08, 0x09, 0x0e, 0x0f, 0x0c, 0x0d },
+      { 0x0b, 0x08, 0x09, 0x0a, 0x0f, 0x0c, 0x0d, 0x0e, 0x03, 0x00, 0x01, 0x02, 0x07, 0x04, 0x05, 0x06 },
+      { 0x00, 0x09, 0x02, 0x0b, 0x04, 0x0d, 0x06, 0x0f, 0x08, 0x01, 0x0a, 0x03, 0x0c, 0x05, 0x0e, 0x07 }
+   },
+   {
+      { 0x03, 0x06, 0x09, 0x0c, 0x07, 0x0a, 0x0d, 0x00, 0x0b, 0x0e, 0x01, 0x04, 0x0f, 0x02, 0x05, 0x08 },
+      { 0x0d, 0x0e, 0x0f, 0x0c, 0x01, 0x02, 0x03, 0x00, 0x05, 0x06, 0x07, 0x04, 0x09, 0x0a, 0x0b, 0x08 },
+      { 0x0a, 0x0b, 0x08, 0x09, 0x0e, 0x0f, 0x0c, 0x0d, 0x02, 0x03, 0x00, 0x01, 0x06, 0x07, 0x04, 0x05 },
+      { 0x07, 0x04, 0x05, 0x06, 0x0b, 0x08, 0x09, 0x0a, 0x0f, 0x0c, 0x0d, 0x0e, 0x03, 0x00, 0x01, 0x02 },
+      { 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03 }
+   }
+};
+
+static const unsigned char vpaes_dec_perm[4][VPAES_PERMS][16] = {
+   {
+      { 0x03, 0x02, 0x01, 0x00, 0x07, 0x06, 0x05, 0x04, 0x0b, 0x0a, 0x09, 0x08, 0x0f, 0x0e, 0x0d, 0x0c },
+      { 0x01, 0x02, 0x03, 0x00, 0x05, 0x06, 0x07, 0x04, 0x09, 0x0a, 0x0b, 0x08, 0x0d, 0x0e, 0x0f, 0x0c },
+      { 0x02, 0x03, 0x00, 0x01, 0x06, 0x07, 0x04, 0x05, 0x0a, 0x0b, 0x08, 0x09, 0x0e, 0x0f, 0x0c, 0x0d },
+      { 0x03, 0x00, 0x01, 0x02, 0x07, 0x04, 0x05, 0x06, 0x0b, 0x08, 0x09, 0x0a, 0x0f, 0x0c, 0x0d, 0x0e },
+      { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f }
+   },
+   {
+      { 0x03, 0x06, 0x09, 0x0c, 0x07, 0x0a, 0x0d, 0x00, 0x0b, 0x0e, 0x01, 0x04, 0x0f, 0x02, 0x05, 0x08 },
+      { 0x0d, 0x0e, 0x0f, 0x0c, 0x01, 0x02, 0x03, 0x00, 0x05, 0x06, 0x07, 0x04, 0x09, 0x0a, 0x0b, 0x08 },
+      { 0x0a, 0x0b, 0x08, 0x09, 0x0e, 0x0f, 0x0c, 0x0d, 0x02, 0x03, 0x00, 0x01, 0x06, 0x07, 0x04, 0x05 },
+      { 0x07, 0x04, 0x05, 0x06, 0x0b, 0x08, 0x09, 0x0a, 0x0f, 0x0c, 0x0d, 0x0e, 0x03, 0x00, 0x01, 0x02 },
+      { 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03 }
+   },
+   {
+      { 0x03, 0x0a, 0x01, 0x08, 0x07, 0x0e, 0x05, 0x0c, 0x0b, 0x02, 0x09, 0x00, 0x0f, 0x06, 0x0d, 0x04 },
+      { 0x09, 0x0a, 0x0b, 0x08, 0x0d, 0x0e, 0x0f, 0x0c, 0x01, 0x02, 0x03, 0x00, 0x05, 0x06, 0x07, 0x04 },
+      { 0x02, 0x03, 0x00, 0x01, 0x06, 0x07, 0x04, 0x05, 0x0a, 0x0b, 0x08, 0x09, 0x0e, 0x0f, 0x0c, 0x0d },
+      { 0x0b, 0x08, 0x09, 0x0a, 0x0f, 0x0c, 0x0d, 0x0e, 0x03, 0x00, 0x01, 0x02, 0x07, 0x04, 0x05, 0x06 },
+      { 0x00, 0x09, 0x02, 0x0b, 0x04, 0x0d, 0x06, 0x0f, 0x08, 0x01, 0x0a, 0x03, 0x0c, 0x05, 0x0e, 0x07 }
+   },
+   {
+      { 0x03, 0x0e, 0x09, 0x04, 0x07, 0x02, 0x0d, 0x08, 0x0b, 0x06, 0x01, 0x0c, 0x0f, 0x0a, 0x05, 0x00 },
+      { 0x05, 0x06, 0x07, 0x04, 0x09, 0x0a, 0x0b, 0x08, 0x0d, 0x0e, 0x0f, 0x0c, 0x01, 0x02, 0x03, 0x00 },
+      { 0x0a, 0x0b, 0x08, 0x09, 0x0e, 0x0f, 0x0c, 0x0d, 0x02, 0x03, 0x00, 0x01, 0x06, 0x07, 0x04, 0x05 },
+      { 0x0f, 0x0c, 0x0d, 0x0e, 0x03, 0x00, 0x01, 0x02, 0x07, 0x04, 0x05, 0x06, 0x0b, 0x08, 0x09, 0x0a },
+      { 0x00, 0x05, 0x0a, 0x0f, 0x04, 0x09, 0x0e, 0x03, 0x08, 0x0d, 0x02, 0x07, 0x0c, 0x01, 0x06, 0x0b }
+   }
+};
+
+#define VPAES_ROW(n)        VPAES_LOAD(vpaes_tab[n])
+
+/* counters are written out this many at a time before they are encrypted */
+#define VPAES_CTR_BATCH     8
+
+/* linear map of each byte through a low and a high nibble table */
+VPAES_INLINE
+static inline vpaes_vec vpaes_transform(vpaes_vec v, int lo)
+{
+    return VPAES_XOR(VPAES_TBL(VPAES_ROW(lo), VPAES_LO(v)), VPAES_TBL(VPAES_ROW(lo + 1), VPAES_HI(v)));
+}
+
+/* the inverse of each byte of s, as the pair of indices the output tables take */
+VPAES_INLINE
+static inline void vpaes_invert(vpaes_vec s, vpaes_vec *io, vpaes_vec *jo)
+{
+    vpaes_vec inv = VPAES_ROW(VPAES_INV);
+    vpaes_vec i = VPAES_HI(s), k = VPAES_LO(s), j = VPAES_XOR(i, k);
+    vpaes_vec ak = VPAES_TBL(VPAES_ROW(VPAES_INVA), k);
+    vpaes_vec iak = VPAES_XOR(VPAES_TBL(inv, i), ak);
+    vpaes_vec jak = VPAES_XOR(VPAES_TBL(inv, j), ak);
+
+    *io = VPAES_XOR(VPAES_TBL(inv, iak), j);
+    *jo = VPAES_XOR(VPAES_TBL(inv, jak), i);
+}
+
+VPAES_INLINE
+static inline vpaes_vec vpaes_output(vpaes_vec io, vpaes_vec jo, int u)
+{
+    return VPAES_XOR(VPAES_TBL(VPAES_ROW(u), io), VPAES_TBL(VPAES_ROW(u + 1), jo));
+}
+
+/* round keys in the byte order and basis the state is in when they are added.
+   The S-box constant passes through MixColumns unchanged, so it rides on the key. */
+VPAES_TARGET
+static void vpaes_load_enc_keys(const ulong32 *K, int Nr, vpaes_vec rk[15])
+{
+    vpaes_vec k;
+    int r;
+
+    for (r = 0; r <= Nr; r++) {
+        k = VPAES_TBL(VPAES_LOAD(K + 4*r), VPAES_LOAD(vpaes_enc_perm[r & 3][VPAES_PERM_KEY]));
+        if (r == 0) {
+            rk[r] = k;
+        } else if (r < Nr) {
+            rk[r] = VPAES_XOR(vpaes_transform(k, VPAES_IPT_LO), VPAES_ROW(VPAES_M63));
+        } else {
+            rk[r] = VPAES_XOR(k, VPAES_ROW(VPAES_K63));
+        }
+    }
+}
+
+VPAES_TARGET
+static void vpaes_load_dec_keys(const ulong32 *K, int Nr, vpaes_vec rk[15])
+{
+    vpaes_vec k;
+    int r;
+
+    for (r = 0; r <= Nr; r++) {
+        k = VPAES_TBL(VPAES_LOAD(K + 4*r), VPAES_LOAD(vpaes_dec_perm[r & 3][VPAES_PERM_KEY]));
+        rk[r] = (r == 0 || r == Nr) ? k : vpaes_transform(k, VPAES_DIPT_LO);
+    }
+}
+
+VPAES_INLINE
+static inline vpaes_vec vpaes_encrypt_round(vpaes_vec s, vpaes_vec k, const unsigned char (*p)[16])
+{
+    vpaes_vec io, jo, x, y;
+
+    vpaes_invert(s, &io, &jo);
+    x = vpaes_output(io, jo, VPAES_SB1U);
+    y = vpaes_output(io, jo, VPAES_SB2U);
+
+    /* MixColumns: 2x[r] + 3x[r+1] + x[r+2] + x[r+3] */
+    k = VPAES_XOR(k, VPAES_XOR(VPAES_TBL(x, VPAES_LOAD(p[VPAES_PERM_ROT2])), VPAES_TBL(x, VPAES_LOAD(p[VPAES_PERM_ROT3]))));
+    return VPAES_XOR(VPAES_XOR(y, VPAES_TBL(VPAES_XOR(x, y), VPAES_LOAD(p[VPAES_PERM_ROT1]))), k);
+}
+
+VPAES_INLINE
+static inline vpaes_vec vpaes_encrypt_last(vpaes_vec s, vpaes_vec k, const unsigned char (*p)[16])
+{
+    vpaes_vec io, jo;
+
+    vpaes_invert(s, &io, &jo);
+    return VPAES_TBL(VPAES_XOR(vpaes_output(io, jo, VPAES_SBOU), k), VPAES_LOAD(p[VPAES_PERM_OUT]));
+}
+
+VPAES_INLINE
+static inline vpaes_vec vpaes_decrypt_round(vpaes_vec s, vpaes_vec k, const unsigned char (*p)[16])
+{
+    vpaes_vec io, jo, e, d;
+
+    vpaes_invert(s, &io, &jo);
+
+    /* InvMixColumns: 14x[r] + 11x[r+1] + 13x[r+2] + 9x[r+3] */
+    e = VPAES_XOR(vpaes_output(io, jo, VPAES_DSBEU),
+                  VPAES_TBL(vpaes_output(io, jo, VPAES_DSBBU), VPAES_LOAD(p[VPAES_PERM_ROT1])));
+    d = VPAES_XOR(VPAES_TBL(vpaes_output(io, jo, VPAES_DSBDU), VPAES_LOAD(p[VPAES_PERM_ROT2])),
+                  VPAES_TBL(vpaes_output(io, jo, VPAES_DSB9U), VPAES_LOAD(p[VPAES_PERM_ROT3])));
+    return VPAES_XOR(VPAES_XOR(e, d), k);
+}
+
+VPAES_INLINE
+static inline vpaes_vec vpaes_decrypt_last(vpaes_vec s, vpaes_vec k, const unsigned char (*p)[16])
+{
+    vpaes_vec io, jo;
+
+    vpaes_invert(s, &io, &jo);
+    return VPAES_TBL(VPAES_XOR(vpaes_output(io, jo, VPAES_DSBOU), k), VPAES_LOAD(p[VPAES_PERM_OUT]));
+}
+
+VPAES_TARGET
+static vpaes_vec vpaes_encrypt_block(vpaes_vec b, const vpaes_vec rk[15], int Nr)
+{
+    int r;
+
+    b = vpaes_transform(VPAES_XOR(b, rk[0]), VPAES_IPT_LO);
+    for (r = 1; r < Nr; r++) {
+        b = vpaes_encrypt_round(b, rk[r], vpaes_enc_perm[r & 3]);
+    }
+    return vpaes_encrypt_last(b, rk[Nr], vpaes_enc_perm[Nr & 3]);
+}
+
+VPAES_TARGET
+static vpaes_vec vpaes_decrypt_block(vpaes_vec b, const vpaes_vec rk[15], int Nr)
+{
+    int r;
+
+    b = vpaes_transform(VPAES_XOR(b, rk[0]), VPAES_DIPT_LO);
+    for (r = 1; r < Nr; r++) {
+        b = vpaes_decrypt_round(b, rk[r], vpaes_dec_perm[r & 3]);
+    }
+    return vpaes_decrypt_last(b, rk[Nr], vpaes_dec_perm[Nr & 3]);
+}
+
+/* two blocks at once, one round is a long chain of dependent shuffles and a
+   single block leaves most of the shuffle units idle */
+VPAES_TARGET
+static void vpaes_encrypt_block2(vpaes_vec b[2], const vpaes_vec rk[15], int Nr)
+{
+    int r;
+
+    b[0] = vpaes_transform(VPAES_XOR(b[0], rk[0]), VPAES_IPT_LO);
+    b[1] = vpaes_transform(VPAES_XOR(b[1], rk[0]), VPAES_IPT_LO);
+    for (r = 1; r < Nr; r++) {
+        b[0] = vpaes_encrypt_round(b[0], rk[r], vpaes_enc_perm[r & 3]);
+        b[1] = vpaes_encrypt_round(b[1], rk[r], vpaes_enc_perm[r & 3]);
+    }
+    b[0] = vpaes_encrypt_last(b[0], rk[Nr], vpaes_enc_perm[Nr & 3]);
+    b[1] = vpaes_encrypt_last(b[1], rk[Nr], vpaes_enc_perm[Nr & 3]);
+}
+
+VPAES_TARGET
+static void vpaes_decrypt_block2(vpaes_vec b[2], const vpaes_vec rk[15], int Nr)
+{
+    int r;
+
+    b[0] = vpaes_transform(VPAES_XOR(b[0], rk[0]), VPAES_DIPT_LO);
+    b[1] = vpaes_transform(VPAES_XOR(b[1], rk[0]), VPAES_DIPT_LO);
+    for (r = 1; r < Nr; r++) {
+        b[0] = vpaes_decrypt_round(b[0], rk[r], vpaes_dec_perm[r & 3]);
+        b[1] = vpaes_decrypt_round(b[1], rk[r], vpaes_dec_perm[r & 3]);
+    }
+    b[0] = vpaes_decrypt_last(b[0], rk[Nr], vpaes_dec_perm[Nr & 3]);
+    b[1] = vpaes_decrypt_last(b[1], rk[Nr], vpaes_dec_perm[Nr & 3]);
+}
+
+/* SubWord on a word in byte order */
+VPAES_TARGET
+static ulong32 vpaes_subword(ulong32 w)
+{
+    unsigned char buf[16];
+    vpaes_vec io, jo;
+
+    zeromem(buf, sizeof(buf));
+    STORE32L(w, buf);
+    vpaes_invert(vpaes_transform(VPAES_LOAD(buf), VPAES_IPT_LO), &io, &jo);
+    VPAES_STORE(buf, VPAES_XOR(vpaes_output(io, jo, VPAES_SBOU), VPAES_ROW(VPAES_K63)));
+    LOAD32L(w, buf);
+    return w;
+}
+
+/* InvMixColumns on a table word without lookups, as MixColumns after
+   x[r] += 4(x[r] + x[r+2]) */
+#define VPAES_XTIME(x)  ((((x) & 0x7f7f7f7fUL) << 1) ^ ((((x) >> 7) & 0x01010101UL) * 0x1b))
+
+static ulong32 vpaes_inv_mix(ulong32 w)
+{
+    ulong32 u;
+
+    u  = w ^ ROLc(w, 16);
+    w ^= VPAES_XTIME(VPAES_XTIME(u));
+    u  = w ^ ROLc(w, 8);
+    return VPAES_XTIME(u) ^ ROLc(w, 8) ^ ROLc(w, 16) ^ ROLc(w, 24);
+}
+
+#undef VPAES_XTIME
+
+VPAES_TARGET
+static int rijndael_setup_vpaes(const unsigned char *key, int keylen, int num_rounds, symmetric_key *skey)
+{
+    ulong32 w[60], temp, rc = 1;
+    unsigned char buf[4];
+    int Nk, Nr, i;
+
+    LTC_ARGCHK(key  != NULL);
+    LTC_ARGCHK(skey != NULL);
+
+    if (keylen != 16 && keylen != 24 && keylen != 32) {
+       return CRYPT_INVALID_KEYSIZE;
+    }
+
+    if (num_rounds != 0 && num_rounds != (10 + ((keylen/8)-2)*2)) {
+       return CRYPT_INVALID_ROUNDS;
+    }
+
+    Nk = keylen / 4;
+    Nr = skey->rijndael.Nr = Nk + 6;
+
+    /* FIPS-197 expansion on words in byte order, with the S-box above */
+    for (i = 0; i < Nk; i++) {
+        LOAD32L(w[i], key + 4*i);
+    }
+    for (i = Nk; i < 4 * (Nr + 1); i++) {
+        temp = w[i - 1];
+        if (i % Nk == 0) {
+            temp = vpaes_subword(RORc(temp, 8)) ^ rc;
+            rc   = (rc << 1) ^ ((rc >> 7) * 0x11b);
+        } else if (Nk > 6 && i % Nk == 4) {
+            temp = vpaes_subword(temp);
+        }
+        w[i] = w[i - Nk] ^ temp;
+    }
+
+    for (i = 0; i < 4 * (Nr + 1); i++) {
+        STORE32L(w[i], buf);
+        LOAD32H(temp, buf);
+        skey->rijndael.eK[i] = temp;
+        if (i >= 4 && i < 4 * Nr) {
+            temp = vpaes_inv_mix(temp);
+        }
+        skey->rijndael.dK[4 * (Nr - i/4) + i%4] = temp;
+    }
+
+    zeromem(w, sizeof(w));
+    zeromem(buf, sizeof(buf));
+    return CRYPT_OK;
+}
+
+VPAES_TARGET
+static int rijndael_ecb_encrypt_vpaes(const unsigned char *pt, unsigned char *ct, symmetric_key *skey)
+{
+    vpaes_vec rk[15];
+
+    LTC_ARGCHK(pt != NULL);
+    LTC_ARGCHK(ct != NULL);
+    LTC_ARGCHK(skey != NULL);
+
+    vpaes_load_enc_keys(skey->rijndael.eK, skey->rijndael.Nr, rk);
+    VPAES_STORE(ct, vpaes_encrypt_block(VPAES_LOAD(pt), rk, skey->rijndael.Nr));
+    return CRYPT_OK;
+}
+
+VPAES_TARGET
+static int rijndael_ecb_decrypt_vpaes(const unsigned char *ct, unsigned char *pt, symmetric_key *skey)
+{
+    vpaes_vec rk[15];
+
+    LTC_ARGCHK(pt != NULL);
+    LTC_ARGCHK(ct != NULL);
+    LTC_ARGCHK(skey != NULL);
+
+    vpaes_load_dec_keys(skey->rijndael.dK, skey->rijndael.Nr, rk);
+    VPAES_STORE(pt, vpaes_decrypt_block(VPAES_LOAD(ct), rk, skey->rijndael.Nr));
+    return CRYPT_OK;
+}
+
+/* the mode functions move the round keys into the vector basis once per call */
+
+VPAES_TARGET
+static int rijndael_accel_ecb_encrypt_vpaes(const unsigned char *pt, unsigned char *ct, unsigned long blocks, symmetric_key *skey)
+{
+    vpaes_vec rk[15], b[2];
+    int Nr = skey->rijndael.Nr;
+
+    vpaes_load_enc_keys(skey->rijndael.eK, Nr, rk);
+    for (; blocks >= 2; blocks -= 2, pt += 32, ct += 32) {
+        b[0] = VPAES_LOAD(pt);
+        b[1] = VPAES_LOAD(pt + 16);
+        vpaes_encrypt_block2(b, rk, Nr);
+        VPAES_STORE(ct, b[0]);
+        VPAES_STORE(ct + 16, b[1]);
+    }
+    if (blocks > 0) {
+        VPAES_STORE(ct, vpaes_encrypt_block(VPAES_LOAD(pt), rk, Nr));
+    }
+    return CRYPT_OK;
+}
+
+VPAES_TARGET
+static int rijndael_accel_ecb_decrypt_vpaes(const unsigned char *ct, unsigned char *pt, unsigned long blocks, symmetric_key *skey)
+{
+    vpaes_vec rk[15], b[2];
+    int Nr = skey->rijndael.Nr;
+
+    vpaes_load_dec_keys(skey->rijndael.dK, Nr, rk);
+    for (; blocks >= 2; blocks -= 2, ct += 32, pt += 32) {
+        b[0] = VPAES_LOAD(ct);
+        b[1] = VPAES_LOAD(ct + 16);
+        vpaes_decrypt_block2(b, rk, Nr);
+        VPAES_STORE(pt, b[0]);
+        VPAES_STORE(pt + 16, b[1]);
+    }
+    if (blocks > 0) {
+        VPAES_STORE(pt, vpaes_decrypt_block(VPAES_LOAD(ct), rk, Nr));
+    }
+    return CRYPT_OK;
+}
+
+VPAES_TARGET
+static int rijndael_accel_cbc_encrypt_vpaes(const unsigned char *pt, unsigned char *ct, unsigned long blocks, unsigned char *IV, symmetric_key *skey)
+{
+    vpaes_vec rk[15], iv = VPAES_LOAD(IV);
+    int Nr = skey->rijndael.Nr;
+
+    vpaes_load_enc_keys(skey->rijndael.eK, Nr, rk);
+    for (; blocks > 0; blocks--, pt += 16, ct += 16) {
+        iv = vpaes_encrypt_block(VPAES_XOR(iv, VPAES_LOAD(pt)), rk, Nr);
+        VPAES_STORE(ct, iv);
+    }
+    VPAES_STORE(IV, iv);
+    return CRYPT_OK;
+}
+
+VPAES_TARGET
+static int rijndael_accel_cbc_decrypt_vpaes(const unsigned char *ct, unsigned char *pt, unsigned long blocks, unsigned char *IV, symmetric_key *skey)
+{
+    vpaes_vec rk[15], b[2], c[2], iv = VPAES_LOAD(IV);
+    int Nr = skey->rijndael.Nr;
+
+    vpaes_load_dec_keys(skey->rijndael.dK, Nr, rk);
+
+    /* the ciphertext is held in registers, so pt may be ct */
+    for (; blocks >= 2; blocks -= 2, ct += 32, pt += 32) {
+        b[0] = c[0] = VPAES_LOAD(ct);
+        b[1] = c[1] = VPAES_LOAD(ct + 16);
+        vpaes_decrypt_block2(b, rk, Nr);
+        VPAES_STORE(pt, VPAES_XOR(b[0], iv));
+        VPAES_STORE(pt + 16, VPAES_XOR(b[1], c[0]));
+        iv = c[1];
+    }
+    if (blocks > 0) {
+        c[0] = VPAES_LOAD(ct);
+        VPAES_STORE(pt, VPAES_XOR(vpaes_decrypt_block(c[0], rk, Nr), iv));
+        iv = c[0];
+    }
+    VPAES_STORE(IV, iv);
+    return CRYPT_OK;
+}
+
+VPAES_TARGET
+static int rijndael_accel_ctr_encrypt_vpaes(const unsigned char *pt, unsigned char *ct, unsigned long blocks, unsigned char *IV, int mode, symmetric_key *skey)
+{
+    unsigned char ctr[VPAES_CTR_BATCH][16];
+    vpaes_vec rk[15], b[2], c;
+    unsigned long n, i;
+    ulong32 low;
+    int Nr = skey->rijndael.Nr;
+
+    vpaes_load_enc_keys(skey->rijndael.eK, Nr, rk);
+
+    while (blocks > 0) {
+        n = MIN(blocks, VPAES_CTR_BATCH);
+
+        /* a big endian counter of 32 bits or more that does not carry out of its
+           low word in this batch is a vector add, anything else goes byte by byte.
+           Loading each counter straight after its byte stores would stall, so
+           they are all written out before the first is encrypted. */
+        LOAD32H(low, IV + 12);
+        if ((mode & CTR_COUNTER_BIG_ENDIAN) && (mode & 255) >= 4 && low <= 0xFFFFFFFFUL - n) {
+            c = VPAES_TBL(VPAES_LOAD(IV), VPAES_ROW(VPAES_REVERSE));
+            for (i = 0; i < n; i++) {
+                c = VPAES_ADD32(c, VPAES_ROW(VPAES_ONE));
+                VPAES_STORE(ctr[i], VPAES_TBL(c, VPAES_ROW(VPAES_REVERSE)));
+            }
+            XMEMCPY(IV, ctr[n - 1], 16);
+        } else {
+            for (i = 0; i < n; i++) {
+                rijndael_ctr_increment(IV, mode, mode & 255);
+                XMEMCPY(ctr[i], IV, 16);
+            }
+        }
+
+        for (i = 0; i + 2 <= n; i += 2, pt += 32, ct += 32) {
+            b[0] = VPAES_LOAD(ctr[i]);
+            b[1] = VPAES_LOAD(ctr[i + 1]);
+            vpaes_encrypt_block2(b, rk, Nr);
+            VPAES_STORE(ct, VPAES_XOR(b[0], VPAES_LOAD(pt)));
+            VPAES_STORE(ct + 16, VPAES_XOR(b[1], VPAES_LOAD(pt + 16)));
+        }
+        if (i < n) {
+            VPAES_STORE(ct, VPAES_XOR(vpaes_encrypt_block(VPAES_LOAD(ctr[i]), rk, Nr), VPAES_LOAD(pt)));
+            pt += 16;
+            ct += 16;
+        }
+        blocks -= n;
+    }
+    return CRYPT_OK;
+}
+
+#undef VPAES_ROW
+
+#endif /* LTC_X86_SIMD */
+
+/* a backend without a multi-block function runs its block function once per block */
+typedef struct {
+    int (*setup)(const unsigned char *key, int keylen, int num_rounds, symmetric_key *skey);
+    int (*ecb_encrypt)(const unsigned char *pt, unsigned char *ct, symmetric_key *skey);
+    int (*ecb_decrypt)(const unsigned char *ct, unsigned char *pt, symmetric_key *skey);
+    int (*ecb_encrypt_blocks)(const unsigned char *pt, unsigned char *ct, unsigned long blocks, symmetric_key *skey);
+    int (*ecb_decrypt_blocks)(const unsigned char *ct, unsigned char *pt, unsigned long blocks, symmetric_key *skey);
+    int (*cbc_encrypt)(const unsigned char *pt, unsigned char *ct, unsigned long blocks, unsigned char *IV, symmetric_key *skey);
+    int (*cbc_decrypt)(const unsigned char *ct, unsigned char *pt, unsigned long blocks, unsigned char *IV, symmetric_key *skey);
+    int (*ctr_encrypt)(const unsigned char *pt, unsigned char *ct, unsigned long blocks, unsigned char *IV, int mode, symmetric_key *skey);
+} rijndael_impl;
+
+static const rijndael_impl rijndael_impl_c = {
+    rijndael_setup_c, rijndael_ecb_encrypt_c, rijndael_ecb_decrypt_c,
+    NULL, NULL, NULL, NULL, NULL
+};
+
+#ifdef LTC_X86_SIMD
+static const rijndael_impl rijndael_impl_aesni = {
+    rijndael_setup_aesni, rijndael_ecb_encrypt_aesni, rijndael_ecb_decrypt_aesni,
+    rijndael_accel_ecb_encrypt_aesni, rijndael_accel_ecb_decrypt_aesni,
+    rijndael_accel_cbc_encrypt_aesni, rijndael_accel_cbc_decrypt_aesni,
+    rijndael_accel_ctr_encrypt_aesni
+};
+#endif
+
+#ifdef LTC_X86_SIMD
+static const rijndael_impl rijndael_impl_vpaes = {
+    rijndael_setup_vpaes, rijndael_ecb_encrypt_vpaes, rijndael_ecb_decrypt_vpaes,
+    rijndael_accel_ecb_encrypt_vpaes, rijndael_accel_ecb_decrypt_vpaes,
+    rijndael_accel_cbc_encrypt_vpaes, rijndael_accel_cbc_decrypt_vpaes,
+    rijndael_accel_ctr_encrypt_vpaes
+};
+#endif
+
+static const rijndael_impl *rijndael_active = &rijndael_impl_c;
+static int rijndael_backend = LTC_AES_BACKEND_C;
+
+/**
+   Select the block functions used by rijndael and aes
+   @param backend  LTC_AES_BACKEND_C, LTC_AES_BACKEND_AESNI or LTC_AES_BACKEND_VPAES
+   @return CRYPT_OK if successful, CRYPT_INVALID_ARG if the backend is not built in
+*/
+int rijndael_set_backend(int backend)
+{
+    switch (backend) {
+       case LTC_AES_BACKEND_C:
+          rijndael_active = &rijndael_impl_c;
+          break;
+#ifdef LTC_X86_SIMD
+       case LTC_AES_BACKEND_AESNI:
+          rijndael_active = &rijndael_impl_aesni;
+          break;
+#endif
+#ifdef LTC_X86_SIMD
+       case LTC_AES_BACKEND_VPAES:
+          rijndael_active = &rijndael_impl_vpaes;
+          break;
+#endif
+       default:
+          return CRYPT_INVALID_ARG;
+    }
+    rijndael_backend = backend;
+    return CRYPT_OK;
+}
+
+/**
+   @return the LTC_AES_BACKEND_xxx used by rijndael and aes
+*/
+int rijndael_get_backend(void)
+{
+    return rijndael_backend;
+}
+
+/**
+    Initialize the AES (Rijndael) block cipher
+    @param key The symmetric key you wish to pass
+    @param keylen The key length in bytes
+    @param num_rounds The number of rounds desired (0 for default)
+    @param skey The key in as scheduled by this function.
+    @return CRYPT_OK if successful
+*/
+int rijndael_setup(const unsigned char *key, int keylen, int num_rounds, symmetric_key *skey)
+{
+    return rijndael_active->setup(key, keylen, num_rounds, skey);
+}
+
+/**
+  Encrypts a block of text with AES
+  @param pt The input plaintext (16 bytes)
+  @param ct The output ciphertext (16 bytes)
+  @param skey The key as scheduled
+  @return CRYPT_OK if successful
+*/
+int rijndael_ecb_encrypt(const unsigned char *pt, unsigned char *ct, symmetric_key *skey)
+{
+    return rijndael_active->ecb_encrypt(pt, ct, skey);
+}
+
+/**
+  Decrypts a block of text with AES
+  @param ct The input ciphertext (16 bytes)
+  @param pt The output plaintext (16 bytes)
+  @param skey The key as scheduled
+  @return CRYPT_OK if successful
+*/
+int rijndael_ecb_decrypt(const unsigned char *ct, unsigned char *pt, symmetric_key *skey)
+{
+    return rijndael_active->ecb_decrypt(ct, pt, skey);
+}
+
+/* the mode accelerators, see struct ltc_cipher_descriptor */
+
+static int rijndael_accel_ecb_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long blocks, symmetric_key *skey)
+{
+    int err = CRYPT_OK;
+
+    if (rijndael_active->ecb_encrypt_blocks != NULL) {
+       return rijndael_active->ecb_encrypt_blocks(pt, ct, blocks, skey);
+    }
+
+    for (; blocks > 0 && err == CRYPT_OK; blocks--, pt += 16, ct += 16) {
+       err = rijndael_active->ecb_encrypt(pt, ct, skey);
+    }
+    return err;
+}
+
+static int rijndael_accel_ecb_decrypt(const unsigned char *ct, unsigned char *pt, unsigned long blocks, symmetric_key *skey)
+{
+    int err = CRYPT_OK;
+
+    if (rijndael_active->ecb_decrypt_blocks != NULL) {
+       return rijndael_active->ecb_decrypt_blocks(ct, pt, blocks, skey);
+    }
+
+    for (; blocks > 0 && err == CRYPT_OK; blocks--, ct += 16, pt += 16) {
+       err = rijndael_active->ecb_decrypt(ct, pt, skey);
+    }
+    return err;
+}
+
+static int rijndael_accel_cbc_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long blocks, unsigned char *IV, symmetric_key *skey)
+{
+    int err = CRYPT_OK, x;
+
+    if (rijndael_active->cbc_encrypt != NULL) {
+       return rijndael_active->cbc_encrypt(pt, ct, blocks, IV, skey);
+    }
+
+    for (; blocks > 0; blocks--, pt += 16, ct += 16) {
+       for (x = 0; x < 16; x++) {
+          IV[x] ^= pt[x];
+       }
+       if ((err = rijndael_active->ecb_encrypt(IV, ct, skey)) != CRYPT_OK) {
+          break;
+       }
+       XMEMCPY(IV, ct, 16);
+    }
+    return err;
+}
+
+static int rijndael_accel_cbc_decrypt(const unsigned char *ct, unsigned char *pt, unsigned long blocks, unsigned char *IV, symmetric_key *skey)
+{
+    unsigned char tmp[16], next[16];
+    int err = CRYPT_OK, x;
+
+    if (rijndael_active->cbc_decrypt != NULL) {
+       return rijndael_active->cbc_decrypt(ct, pt, blocks, IV, skey);
+    }
+
+    for (; blocks > 0; blocks--, ct += 16, pt += 16) {
+       XMEMCPY(next, ct, 16);
+       if ((err = rijndael_active->ecb_decrypt(ct, tmp, skey)) != CRYPT_OK) {
+          break;
+       }
+       for (x = 0; x < 16; x++) {
+          pt[x] = tmp[x] ^ IV[x];
+       }
+       XMEMCPY(IV, next, 16);
+    }
+    zeromem(tmp, sizeof(tmp));
+    return err;
+}
+
+static int rijndael_accel_ctr_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long blocks, unsigned char *IV, int mode, symmetric_key *skey)
+{
+    unsigned char pad[16];
+    int err = CRYPT_OK, x;
+
+    if (rijndael_active->ctr_encrypt != NULL) {
+       return rijndael_active->ctr_encrypt(pt, ct, blocks, IV, mode, skey);
+    }
+
+    for (; blocks > 0; blocks--, pt += 16, ct += 16) {
+       rijndael_ctr_increment(IV, mode, mode & 255);
+       if ((err = rijndael_active->ecb_encrypt(IV, pad, skey)) != CRYPT_OK) {
+          break;
+       }
+       for (x = 0; x < 16; x++) {
+          ct[x] = pt[x] ^ pad[x];
+       }
+    }
+    zeromem(pad, sizeof(pad));
+    return err;
+}
+
+#endif /* ENCRYPT_ONLY */
+
 /** Terminate the context 
    @param skey    The scheduled key
 */
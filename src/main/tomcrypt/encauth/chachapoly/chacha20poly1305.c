@@ -0,0 +1,292 @@
+/* LibTomCrypt, modular cryptographic library -- Tom St Denis
+ *
+ * LibTomCrypt is a library that provides various cryptographic
+ * algorithms in a highly modular and flexible manner.
+ *
+ * The library is free for all purposes without any express
+ * guarantee it works.
+ *
+ * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
+ */
+#include "tomcrypt.h"
+
+/**
+  @file chacha20poly1305.c
+  ChaCha20-Poly1305 AEAD (RFC 8439).  The Poly1305 key is the first 32 bytes
+  of keystream block 0 and the text is encrypted from block 1.  The MAC runs
+  over aad || pad16 || ciphertext || pad16 || le64(aadlen) || le64(ctlen).
+*/
+
+#ifdef LTC_CHACHA20POLY1305_MODE
+
+/* the text is encrypted and hashed a piece at a time, so the MAC reads it from L1 */
+#define CHACHA20POLY1305_CHUNK  4096
+
+static const unsigned char chacha20poly1305_zeros[16] = { 0 };
+
+/* pad what has gone into the MAC so far to a whole block */
+static int chacha20poly1305_pad(chacha20poly1305_state *st, ulong64 len)
+{
+    if (len & 15) {
+       return poly1305_process(&st->poly, chacha20poly1305_zeros, 16 - (unsigned long)(len & 15));
+    }
+    return CRYPT_OK;
+}
+
+/* the AAD is over once the first text comes */
+static int chacha20poly1305_end_aad(chacha20poly1305_state *st)
+{
+    int err;
+
+    if (st->aadflg) {
+       if ((err = chacha20poly1305_pad(st, st->aadlen)) != CRYPT_OK) {
+          return err;
+       }
+       st->aadflg = 0;
+    }
+    return CRYPT_OK;
+}
+
+/**
+   Initialize with a key, a nonce has to be set before anything else
+   @param st      The state
+   @param key     The secret key
+   @param keylen  32
+   @return CRYPT_OK if successful
+*/
+int chacha20poly1305_init(chacha20poly1305_state *st, const unsigned char *key, unsigned long keylen)
+{
+    LTC_ARGCHK(st != NULL);
+
+    return chacha_setup(&st->chacha, key, keylen, 20);
+}
+
+/**
+   Set the nonce and start a new message
+   @param st     The state
+   @param iv     The nonce
+   @param ivlen  12 (RFC 8439) or 8 (the original 64 bit nonce)
+   @return CRYPT_OK if successful
+*/
+int chacha20poly1305_setiv(chacha20poly1305_state *st, const unsigned char *iv, unsigned long ivlen)
+{
+    unsigned char polykey[32];
+    int           err;
+
+    LTC_ARGCHK(st != NULL);
+    LTC_ARGCHK(iv != NULL);
+
+    if (ivlen == 12) {
+       err = chacha_ivctr32(&st->chacha, iv, ivlen, 0);
+    } else if (ivlen == 8) {
+       err = chacha_ivctr64(&st->chacha, iv, ivlen, 0);
+    } else {
+       return CRYPT_INVALID_ARG;
+    }
+    if (err != CRYPT_OK) {
+       return err;
+    }
+
+    /* block 0 keys the MAC, the rest of it is thrown away */
+    if ((err = chacha_keystream(&st->chacha, polykey, sizeof(polykey))) != CRYPT_OK) {
+       goto LBL_ERR;
+    }
+    if ((err = poly1305_init(&st->poly, polykey, sizeof(polykey))) != CRYPT_OK) {
+       goto LBL_ERR;
+    }
+    if (ivlen == 12) {
+       err = chacha_ivctr32(&st->chacha, iv, ivlen, 1);
+    } else {
+       err = chacha_ivctr64(&st->chacha, iv, ivlen, 1);
+    }
+
+    st->aadlen = 0;
+    st->ctlen  = 0;
+    st->aadflg = 1;
+
+LBL_ERR:
+    zeromem(polykey, sizeof(polykey));
+    return err;
+}
+
+/**
+   Add AAD, all of it before any text
+   @param st     The state
+   @param in     The AAD
+   @param inlen  The length of the AAD
+   @return CRYPT_OK if successful
+*/
+int chacha20poly1305_add_aad(chacha20poly1305_state *st, const unsigned char *in, unsigned long inlen)
+{
+    int err;
+
+    LTC_ARGCHK(st != NULL);
+
+    if (!st->aadflg) {
+       return CRYPT_ERROR;
+    }
+    if ((err = poly1305_process(&st->poly, in, inlen)) != CRYPT_OK) {
+       return err;
+    }
+    st->aadlen += inlen;
+    return CRYPT_OK;
+}
+
+/**
+   Encrypt, in and out may be the same buffer
+   @param st     The state
+   @param in     The plaintext
+   @param inlen  The length of the plaintext
+   @param out    [out] The ciphertext
+   @return CRYPT_OK if successful
+*/
+int chacha20poly1305_encrypt(chacha20poly1305_state *st, const unsigned char *in, unsigned long inlen, unsigned char *out)
+{
+    unsigned long n;
+    int           err;
+
+    LTC_ARGCHK(st != NULL);
+
+    if ((err = chacha20poly1305_end_aad(st)) != CRYPT_OK) {
+       return err;
+    }
+    for (; inlen > 0; in += n, out += n, inlen -= n) {
+        n = MIN(inlen, CHACHA20POLY1305_CHUNK);
+        if ((err = chacha_crypt(&st->chacha, in, n, out)) != CRYPT_OK) {
+           return err;
+        }
+        if ((err = poly1305_process(&st->poly, out, n)) != CRYPT_OK) {
+           return err;
+        }
+        st->ctlen += n;
+    }
+    return CRYPT_OK;
+}
+
+/**
+   Decrypt, in and out may be the same buffer
+   @param st     The state
+   @param in     The ciphertext
+   @param inlen  The length of the ciphertext
+   @param out    [out] The plaintext
+   @return CRYPT_OK if successful
+*/
+int chacha20poly1305_decrypt(chacha20poly1305_state *st, const unsigned char *in, unsigned long inlen, unsigned char *out)
+{
+    unsigned long n;
+    int           err;
+
+    LTC_ARGCHK(st != NULL);
+
+    if ((err = chacha20poly1305_end_aad(st)) != CRYPT_OK) {
+       return err;
+    }
+    for (; inlen > 0; in += n, out += n, inlen -= n) {
+        n = MIN(inlen, CHACHA20POLY1305_CHUNK);
+        if ((err = poly1305_process(&st->poly, in, n)) != CRYPT_OK) {
+           return err;
+        }
+        if ((err = chacha_crypt(&st->chacha, in, n, out)) != CRYPT_OK) {
+           return err;
+        }
+        st->ctlen += n;
+    }
+    return CRYPT_OK;
+}
+
+/**
+   Write the tag, a new nonce has to be set for the next message
+   @param st      The state
+   @param tag     [out] The 16 byte tag
+   @param taglen  [in/out] The size of tag, 16 on return
+   @return CRYPT_OK if successful
+*/
+int chacha20poly1305_done(chacha20poly1305_state *st, unsigned char *tag, unsigned long *taglen)
+{
+    unsigned char lens[16];
+    int           err;
+
+    LTC_ARGCHK(st != NULL);
+
+    if ((err = chacha20poly1305_end_aad(st)) != CRYPT_OK) {
+       return err;
+    }
+    if ((err = chacha20poly1305_pad(st, st->ctlen)) != CRYPT_OK) {
+       return err;
+    }
+    STORE64L(st->aadlen, lens + 0);
+    STORE64L(st->ctlen,  lens + 8);
+    if ((err = poly1305_process(&st->poly, lens, sizeof(lens))) != CRYPT_OK) {
+       return err;
+    }
+    return poly1305_done(&st->poly, tag, taglen);
+}
+
+/**
+   RFC 8439 section 2.8.2, encrypted in pieces and decrypted in place
+   @return CRYPT_OK if successful
+*/
+int chacha20poly1305_test(void)
+{
+#ifndef LTC_TEST
+    return CRYPT_NOP;
+#else
+    static const unsigned char k[32] = {
+       0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
+       0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f
+    };
+    static const unsigned char iv[12] = {
+       0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47
+    };
+    static const unsigned char aad[12] = {
+       0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7
+    };
+    static const char pt[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+    static const unsigned char ct[114] = {
+       0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e, 0xc2,
+       0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe, 0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee, 0x62, 0xd6,
+       0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9, 0x67, 0x12, 0x82, 0xfa, 0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b,
+       0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29, 0x05, 0xd6, 0xa5, 0xb6, 0x7e, 0xcd, 0x3b, 0x36,
+       0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c, 0x98, 0x03, 0xae, 0xe3, 0x28, 0x09, 0x1b, 0x58,
+       0xfa, 0xb3, 0x24, 0xe4, 0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc,
+       0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5, 0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b,
+       0x61, 0x16
+    };
+    static const unsigned char tag[16] = {
+       0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a, 0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91
+    };
+    chacha20poly1305_state st;
+    unsigned char          out[114], t[16];
+    unsigned long          tlen;
+    int                    err;
+
+    tlen = sizeof(t);
+    if ((err = chacha20poly1305_init(&st, k, sizeof(k))) != CRYPT_OK)                                    return err;
+    if ((err = chacha20poly1305_setiv(&st, iv, sizeof(iv))) != CRYPT_OK)                                 return err;
+    if ((err = chacha20poly1305_add_aad(&st, aad, sizeof(aad))) != CRYPT_OK)                             return err;
+    if ((err = chacha20poly1305_encrypt(&st, (const unsigned char *)pt, 50, out)) != CRYPT_OK)           return err;
+    if ((err = chacha20poly1305_encrypt(&st, (const unsigned char *)pt + 50, 64, out + 50)) != CRYPT_OK) return err;
+    if ((err = chacha20poly1305_done(&st, t, &tlen)) != CRYPT_OK)                                        return err;
+    if (XMEMCMP(out, ct, sizeof(ct)) != 0 || XMEMCMP(t, tag, sizeof(tag)) != 0) {
+       return CRYPT_FAIL_TESTVECTOR;
+    }
+
+    tlen = sizeof(t);
+    if ((err = chacha20poly1305_setiv(&st, iv, sizeof(iv))) != CRYPT_OK)                                 return err;
+    if ((err = chacha20poly1305_add_aad(&st, aad, sizeof(aad))) != CRYPT_OK)                             return err;
+    if ((err = chacha20poly1305_decrypt(&st, out, sizeof(out), out)) != CRYPT_OK)                        return err;
+    if ((err = chacha20poly1305_done(&st, t, &tlen)) != CRYPT_OK)                                        return err;
+    if (XMEMCMP(out, pt, sizeof(out)) != 0 || XMEMCMP(t, tag, sizeof(tag)) != 0) {
+       return CRYPT_FAIL_TESTVECTOR;
+    }
+
+    chacha_done(&st.chacha);
+    return CRYPT_OK;
+#endif
+}
+
+#endif /* LTC_CHACHA20POLY1305_MODE */
+
+/* $Source$ */
+/* $Revision$ */
+/* $Date$ */
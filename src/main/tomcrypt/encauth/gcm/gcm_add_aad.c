@@ -87,6 +87,16 @@ int gcm_add_aad(gcm_state *gcm,
       return CRYPT_INVALID_ARG;
    }
 
+#ifdef LTC_X86_SIMD
+   if (gcm->buflen == 0 && gcm->ghash == LTC_GCM_BACKEND_PCLMUL) {
+      x = adatalen & ~15UL;
+      gcm_ghash_pclmul(gcm, adata, x / 16);
+      gcm->totlen += x * CONST64(8);
+      adata    += x;
+      adatalen -= x;
+   }
+#endif
+
    x = 0;
 #ifdef LTC_FAST
    if (gcm->buflen == 0) {
@@ -0,0 +1,479 @@
+/* LibTomCrypt, modular cryptographic library -- Tom St Denis
+ *
+ * LibTomCrypt is a library that provides various cryptographic
+ * algorithms in a highly modular and flexible manner.
+ *
+ * The library is free for all purposes without any express
+ * guarantee it works.
+ *
+ * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
+ */
+
+/**
+   @file gcm_ghash.c
+   GCM implementation, GHASH backends, the 4 bit table and the carry-less multiply kernels
+*/
+#include "tomcrypt.h"
+
+#ifdef LTC_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef LTC_GCM_MODE
+
+static int gcm_backend = LTC_GCM_BACKEND_C;
+
+/**
+   Select the GHASH implementation used by states initialized from now on
+   @param backend  LTC_GCM_BACKEND_C or LTC_GCM_BACKEND_PCLMUL
+   @return CRYPT_OK if successful, CRYPT_INVALID_ARG if the backend is not built in
+*/
+int gcm_set_backend(int backend)
+{
+    switch (backend) {
+       case LTC_GCM_BACKEND_C:
+       case LTC_GCM_BACKEND_4BIT:
+#ifdef LTC_X86_SIMD
+       case LTC_GCM_BACKEND_PCLMUL:
+#endif
+          gcm_backend = backend;
+          return CRYPT_OK;
+
+       default:
+          return CRYPT_INVALID_ARG;
+    }
+}
+
+/**
+   @return The LTC_GCM_BACKEND_ new states are initialized with
+*/
+int gcm_get_backend(void)
+{
+    return gcm_backend;
+}
+
+/* Shoup's method with 4 bit digits.  HL/HH hold H times each nibble, the bits
+   shifted off the end of Z come back in through last4, the reduction of those
+   four bits by x^128 + x^7 + x^2 + x + 1 */
+static const ulong64 gcm_last4[16] = {
+   CONST64(0x0000), CONST64(0x1c20), CONST64(0x3840), CONST64(0x2460),
+   CONST64(0x7080), CONST64(0x6ca0), CONST64(0x48c0), CONST64(0x54e0),
+   CONST64(0xe100), CONST64(0xfd20), CONST64(0xd940), CONST64(0xc560),
+   CONST64(0x9180), CONST64(0x8da0), CONST64(0xa9c0), CONST64(0xb5e0)
+};
+
+/**
+  Build the 4 bit table for LTC_GCM_BACKEND_4BIT
+  @param gcm   The GCM state, H already set
+*/
+void gcm_init_4bit(gcm_state *gcm)
+{
+   ulong64 vh, vl;
+   int     i, j;
+
+   LOAD64H(vh, gcm->H);
+   LOAD64H(vl, gcm->H + 8);
+
+   /* 8 is H itself, 4, 2 and 1 are H times x, x^2 and x^3 */
+   gcm->HH[0] = gcm->HL[0] = 0;
+   gcm->HH[8] = vh;
+   gcm->HL[8] = vl;
+   for (i = 4; i > 0; i >>= 1) {
+       vl = (vh << 63) | (vl >> 1);
+       vh = (vh >> 1) ^ ((gcm->HL[i << 1] & 1) ? CONST64(0xe100000000000000) : 0);
+       gcm->HH[i] = vh;
+       gcm->HL[i] = vl;
+   }
+
+   /* the rest are sums of those */
+   for (i = 2; i <= 8; i <<= 1) {
+       for (j = 1; j < i; j++) {
+           gcm->HH[i + j] = gcm->HH[i] ^ gcm->HH[j];
+           gcm->HL[i + j] = gcm->HL[i] ^ gcm->HL[j];
+       }
+   }
+}
+
+/**
+  GCM multiply by H with the 4 bit table
+  @param gcm   The GCM state
+  @param I     The value to multiply H by
+*/
+void gcm_mult_h_4bit(gcm_state *gcm, unsigned char *I)
+{
+   ulong64 zh, zl;
+   int     i, n, rem;
+
+   n  = I[15] & 15;
+   zh = gcm->HH[n];
+   zl = gcm->HL[n];
+
+   for (i = 15; i >= 0; i--) {
+       /* low nibble, except the one Z starts from */
+       if (i != 15) {
+          n   = I[i] & 15;
+          rem = (int)(zl & 15);
+          zl  = (zh << 60) | (zl >> 4);
+          zh  = (zh >> 4) ^ (gcm_last4[rem] << 48) ^ gcm->HH[n];
+          zl ^= gcm->HL[n];
+       }
+       n   = I[i] >> 4;
+       rem = (int)(zl & 15);
+       zl  = (zh << 60) | (zl >> 4);
+       zh  = (zh >> 4) ^ (gcm_last4[rem] << 48) ^ gcm->HH[n];
+       zl ^= gcm->HL[n];
+   }
+
+   STORE64H(zh, I);
+   STORE64H(zl, I + 8);
+}
+
+#ifdef LTC_X86_SIMD
+/* Field elements are kept byte reversed in vector registers, which makes them
+   bit reflected 128 bit integers.  The product of two of those is one bit short,
+   so the reduction shifts left once before folding the top half back in
+   (Gueron and Kounavis, Intel carry-less multiplication white paper).  The
+   reduction is linear, so the unreduced products of 8 blocks against H^8..H^1
+   are summed and reduced once. */
+
+#define GCM_PCLMUL_TARGET   __attribute__((target("pclmul,ssse3")))
+#define GCM_AESNI_TARGET    __attribute__((target("aes,pclmul,ssse3")))
+#define GCM_PCLMUL_INLINE   static inline __attribute__((always_inline, target("pclmul,ssse3")))
+
+#define GCM_REVERSE()       _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)
+
+/* blocks per reduction, and AES-NI CTR lanes in the stitched loop */
+#define GCM_LANES           8
+
+/* the 256 bit product of a and b is added to hi:mid:lo, mid holding the cross terms */
+GCM_PCLMUL_INLINE void gcm_clmul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *mid, __m128i *hi)
+{
+    *lo  = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+    *hi  = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+    *mid = _mm_xor_si128(*mid, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x01),
+                                             _mm_clmulepi64_si128(a, b, 0x10)));
+}
+
+GCM_PCLMUL_INLINE __m128i gcm_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+    __m128i a, b, c;
+
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    /* hi:lo <<= 1 */
+    a  = _mm_srli_epi32(lo, 31);
+    b  = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    c  = _mm_srli_si128(a, 12);
+    lo = _mm_or_si128(lo, _mm_slli_si128(a, 4));
+    hi = _mm_or_si128(hi, _mm_or_si128(_mm_slli_si128(b, 4), c));
+
+    /* modulo x^128 + x^7 + x^2 + x + 1 */
+    a  = _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_xor_si128(_mm_slli_epi32(lo, 30), _mm_slli_epi32(lo, 25)));
+    b  = _mm_srli_si128(a, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(a, 12));
+    c  = _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_xor_si128(_mm_srli_epi32(lo, 2), _mm_srli_epi32(lo, 7)));
+    lo = _mm_xor_si128(lo, _mm_xor_si128(c, b));
+
+    return _mm_xor_si128(hi, lo);
+}
+
+GCM_PCLMUL_INLINE __m128i gcm_gfmul(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+    gcm_clmul_acc(a, b, &lo, &mid, &hi);
+    return gcm_reduce(lo, mid, hi);
+}
+
+/* x = (x ^ in[0]) * H^8 ^ in[1] * H^7 ^ ... ^ in[7] * H */
+GCM_PCLMUL_INLINE __m128i gcm_ghash8(__m128i x, const unsigned char *in, const __m128i hp[GCM_LANES])
+{
+    const __m128i REVERSE = GCM_REVERSE();
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128(), c;
+    int i;
+
+    for (i = 0; i < GCM_LANES; i++) {
+        c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in + i), REVERSE);
+        if (i == 0) {
+           c = _mm_xor_si128(c, x);
+        }
+        gcm_clmul_acc(c, hp[GCM_LANES - 1 - i], &lo, &mid, &hi);
+    }
+    return gcm_reduce(lo, mid, hi);
+}
+
+/**
+  Compute the powers of H for the PCLMUL backend
+  @param gcm   The GCM state, H already set
+*/
+GCM_PCLMUL_TARGET
+void gcm_init_pclmul(gcm_state *gcm)
+{
+    const __m128i REVERSE = GCM_REVERSE();
+    __m128i h, p;
+    int i;
+
+    h = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)gcm->H), REVERSE);
+    p = h;
+    for (i = 0; i < GCM_LANES; i++) {
+        _mm_storeu_si128((__m128i *)gcm->HP[i], p);
+        p = gcm_gfmul(p, h);
+    }
+}
+
+/**
+  GCM multiply by H with the carry-less multiply
+  @param gcm   The GCM state
+  @param I     The value to multiply H by
+*/
+GCM_PCLMUL_TARGET
+void gcm_mult_h_pclmul(gcm_state *gcm, unsigned char *I)
+{
+    const __m128i REVERSE = GCM_REVERSE();
+    __m128i x;
+
+    x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)I), REVERSE);
+    x = gcm_gfmul(x, _mm_loadu_si128((const __m128i *)gcm->HP[0]));
+    _mm_storeu_si128((__m128i *)I, _mm_shuffle_epi8(x, REVERSE));
+}
+
+/**
+  Fold whole blocks into the GHASH accumulator X
+  @param gcm     The GCM state
+  @param in      The data
+  @param blocks  The number of 16 byte blocks
+*/
+GCM_PCLMUL_TARGET
+void gcm_ghash_pclmul(gcm_state *gcm, const unsigned char *in, unsigned long blocks)
+{
+    const __m128i REVERSE = GCM_REVERSE();
+    __m128i hp[GCM_LANES], x, c;
+    int i;
+
+    for (i = 0; i < GCM_LANES; i++) {
+        hp[i] = _mm_loadu_si128((const __m128i *)gcm->HP[i]);
+    }
+    x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)gcm->X), REVERSE);
+
+    for (; blocks >= GCM_LANES; blocks -= GCM_LANES, in += 16 * GCM_LANES) {
+        x = gcm_ghash8(x, in, hp);
+    }
+    for (; blocks > 0; blocks--, in += 16) {
+        c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in), REVERSE);
+        x = gcm_gfmul(_mm_xor_si128(x, c), hp[0]);
+    }
+
+    _mm_storeu_si128((__m128i *)gcm->X, _mm_shuffle_epi8(x, REVERSE));
+}
+
+/* AES-NI CTR and GHASH in one loop, 8 blocks at a time.  The multiplies for one
+   batch of ciphertext go between the AES rounds of the next, so the two units
+   work side by side.  The round keys are the eK words of the AES key schedule.
+   Everything is written out per lane so the blocks stay in registers */
+
+#define GCM_AESNI_INLINE    static inline __attribute__((always_inline, target("aes,pclmul,ssse3")))
+
+#define GCM_AESNI_KEY(K, r) \
+    _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)((K) + 4*(r))), _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3))
+
+#define GCM_LANE8(S)    S(0) S(1) S(2) S(3) S(4) S(5) S(6) S(7)
+
+/* 8 counter blocks from ctr through AES, hashing c into x on the way when hash is set */
+GCM_AESNI_INLINE void gcm_aesni_batch(__m128i b[GCM_LANES], __m128i ctr, const __m128i rk[15], int Nr,
+                                      const __m128i c[GCM_LANES], const __m128i hp[GCM_LANES], __m128i *x, int hash)
+{
+    const __m128i REVERSE = GCM_REVERSE();
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    int r = 1;
+
+#define GCM_CTR(i)      b[i] = _mm_xor_si128(_mm_shuffle_epi8(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, i)), REVERSE), rk[0]);
+#define GCM_ENC(i)      b[i] = _mm_aesenc_si128(b[i], rk[r]);
+#define GCM_ENCLAST(i)  b[i] = _mm_aesenclast_si128(b[i], rk[Nr]);
+#define GCM_ROUND()     GCM_ENC(0) GCM_ENC(1) GCM_ENC(2) GCM_ENC(3) GCM_ENC(4) GCM_ENC(5) GCM_ENC(6) GCM_ENC(7)
+#define GCM_STITCH(i)   GCM_ROUND() gcm_clmul_acc(c[i], hp[GCM_LANES - 1 - i], &lo, &mid, &hi); r++;
+
+    GCM_LANE8(GCM_CTR)
+    if (hash) {
+       GCM_LANE8(GCM_STITCH)
+    }
+    for (; r < Nr; r++) {
+       GCM_ROUND()
+    }
+    GCM_LANE8(GCM_ENCLAST)
+    if (hash) {
+       *x = gcm_reduce(lo, mid, hi);
+    }
+
+#undef GCM_CTR
+#undef GCM_ENC
+#undef GCM_ENCLAST
+#undef GCM_ROUND
+#undef GCM_STITCH
+}
+
+GCM_AESNI_TARGET
+static void gcm_aesni_ctr_ghash(gcm_state *gcm, const unsigned char *in, unsigned char *out,
+                                unsigned long blocks, int direction)
+{
+    const __m128i REVERSE = GCM_REVERSE();
+    const __m128i *src;
+    __m128i rk[15], hp[GCM_LANES], b[GCM_LANES], c[GCM_LANES], x, ctr, lo, mid, hi;
+    int Nr = gcm->K.rijndael.Nr, r, i;
+
+    if (blocks == 0) {
+       return;
+    }
+
+    for (r = 0; r <= Nr; r++) {
+        rk[r] = GCM_AESNI_KEY(gcm->K.rijndael.eK, r);
+    }
+    for (i = 0; i < GCM_LANES; i++) {
+        hp[i] = _mm_loadu_si128((const __m128i *)gcm->HP[i]);
+    }
+    x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)gcm->X), REVERSE);
+
+    /* reversed, the 32 bit block counter of Y is lane 0 and wraps on its own */
+    ctr = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)gcm->Y), REVERSE);
+
+#define GCM_HASHIN(i)   c[i] = _mm_shuffle_epi8(_mm_loadu_si128(src + i), REVERSE);
+#define GCM_OUT(i)      b[i] = _mm_xor_si128(b[i], _mm_loadu_si128(src + i)); _mm_storeu_si128((__m128i *)out + i, b[i]);
+#define GCM_HASHOUT(i)  c[i] = _mm_shuffle_epi8(b[i], REVERSE);
+
+    if (direction == GCM_DECRYPT) {
+       /* the ciphertext coming in is hashed while its pad is made */
+       for (; blocks > 0; blocks -= GCM_LANES, in += 16 * GCM_LANES, out += 16 * GCM_LANES) {
+           src = (const __m128i *)in;
+           GCM_LANE8(GCM_HASHIN)
+           c[0] = _mm_xor_si128(c[0], x);
+           gcm_aesni_batch(b, ctr, rk, Nr, c, hp, &x, 1);
+           ctr = _mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, GCM_LANES));
+           GCM_LANE8(GCM_OUT)
+       }
+    } else {
+       /* the ciphertext going out is hashed during the next batch, the last one after the loop */
+       src = (const __m128i *)in;
+       gcm_aesni_batch(b, ctr, rk, Nr, c, hp, &x, 0);
+       for (;;) {
+           ctr = _mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, GCM_LANES));
+           GCM_LANE8(GCM_OUT)
+           GCM_LANE8(GCM_HASHOUT)
+           c[0] = _mm_xor_si128(c[0], x);
+
+           blocks -= GCM_LANES;
+           in += 16 * GCM_LANES;
+           out += 16 * GCM_LANES;
+           if (blocks == 0) {
+              break;
+           }
+
+           src = (const __m128i *)in;
+           gcm_aesni_batch(b, ctr, rk, Nr, c, hp, &x, 1);
+       }
+       lo = mid = hi = _mm_setzero_si128();
+       for (i = 0; i < GCM_LANES; i++) {
+           gcm_clmul_acc(c[i], hp[GCM_LANES - 1 - i], &lo, &mid, &hi);
+       }
+       x = gcm_reduce(lo, mid, hi);
+    }
+
+#undef GCM_HASHIN
+#undef GCM_OUT
+#undef GCM_HASHOUT
+
+    _mm_storeu_si128((__m128i *)gcm->X, _mm_shuffle_epi8(x, REVERSE));
+    _mm_storeu_si128((__m128i *)gcm->Y, _mm_shuffle_epi8(ctr, REVERSE));
+}
+
+/* Y += n, the low 32 bits only */
+static void gcm_inc32(unsigned char *Y, ulong32 n)
+{
+    ulong32 c;
+
+    LOAD32H(c, Y + 12);
+    c += n;
+    STORE32H(c, Y + 12);
+}
+
+/**
+  Encrypt or decrypt whole blocks in text mode, with the pad of the last call used up.
+  On return Y is the next counter and buf its pad, as gcm_process expects
+  @param gcm        The GCM state, on LTC_GCM_BACKEND_PCLMUL
+  @param in         The plaintext when encrypting, the ciphertext when decrypting
+  @param out        [out] The other one, may be the same buffer as in
+  @param blocks     The number of 16 byte blocks
+  @param direction  GCM_ENCRYPT or GCM_DECRYPT
+  @return CRYPT_OK on success
+*/
+int gcm_process_pclmul(gcm_state *gcm, const unsigned char *in, unsigned char *out,
+                       unsigned long blocks, int direction)
+{
+    const struct ltc_cipher_descriptor *desc = &cipher_descriptor[gcm->cipher];
+    unsigned char ctr[16], pad[16];
+    unsigned long n, x;
+    int err = CRYPT_OK, y;
+
+    gcm->pttotlen += blocks * CONST64(128);
+
+    /* AES on the AES-NI backend runs stitched with the multiply */
+    if (desc->ecb_encrypt == rijndael_ecb_encrypt && rijndael_get_backend() == LTC_AES_BACKEND_AESNI) {
+       n = blocks & ~(unsigned long)(GCM_LANES - 1);
+       gcm_aesni_ctr_ghash(gcm, in, out, n, direction);
+       in += 16 * n;
+       out += 16 * n;
+       blocks -= n;
+    }
+
+    /* anything else is CTR on the cipher's accelerator, with the ciphertext hashed around it */
+    while (blocks > 0) {
+       n = MIN(blocks, 64);
+
+       if (direction == GCM_DECRYPT) {
+          gcm_ghash_pclmul(gcm, in, n);
+       }
+
+       if (desc->accel_ctr_encrypt != NULL) {
+          /* the accelerator steps the counter before each block */
+          XMEMCPY(ctr, gcm->Y, 16);
+          gcm_inc32(ctr, 0xFFFFFFFFUL);
+          if ((err = desc->accel_ctr_encrypt(in, out, n, ctr, CTR_COUNTER_BIG_ENDIAN | 4, &gcm->K)) != CRYPT_OK) {
+             goto done;
+          }
+          gcm_inc32(gcm->Y, (ulong32)n);
+       } else {
+          for (x = 0; x < n; x++) {
+             if ((err = desc->ecb_encrypt(gcm->Y, pad, &gcm->K)) != CRYPT_OK) {
+                goto done;
+             }
+             for (y = 0; y < 16; y++) {
+                out[16 * x + y] = in[16 * x + y] ^ pad[y];
+             }
+             gcm_inc32(gcm->Y, 1);
+          }
+       }
+
+       if (direction == GCM_ENCRYPT) {
+          gcm_ghash_pclmul(gcm, out, n);
+       }
+
+       in += 16 * n;
+       out += 16 * n;
+       blocks -= n;
+    }
+
+    err = desc->ecb_encrypt(gcm->Y, gcm->buf, &gcm->K);
+
+done:
+    zeromem(pad, sizeof(pad));
+    return err;
+}
+
+#endif /* LTC_X86_SIMD */
+
+#endif
+
+/* $Source$ */
+/* $Revision$ */
+/* $Date$ */
@@ -14,11 +14,12 @@
    GCM implementation, initialize state, by Tom St Denis
 */
 #include "tomcrypt.h"
+#include <stddef.h>
 
 #ifdef LTC_GCM_MODE
 
 /**
-  Initialize a GCM state
+  Initialize a GCM state with the GHASH backend set by gcm_set_backend()
   @param gcm     The GCM state to initialize
   @param cipher  The index of the cipher to use
   @param key     The secret key
@@ -27,6 +28,53 @@
  */
 int gcm_init(gcm_state *gcm, int cipher, 
              const unsigned char *key,  int keylen)
+{
+   return gcm_init_backend(gcm, gcm_get_backend(), cipher, key, keylen);
+}
+
+/**
+  The bytes of a gcm_state a backend uses.  Only the 64KB tables need all of it,
+  the others stop at the end of the key, which for AES is a small part of K
+  @param backend  The LTC_GCM_BACKEND_
+  @param cipher   The index of the cipher to use
+  @return The size to allocate, 0 if the backend is not built in
+ */
+unsigned long gcm_state_size(int backend, int cipher)
+{
+   unsigned long keysize = sizeof(symmetric_key);
+
+#ifdef LTC_RIJNDAEL
+   if (cipher >= 0 && cipher < TAB_SIZE && cipher_descriptor[cipher].setup == rijndael_setup) {
+      keysize = sizeof(struct rijndael_key);
+   }
+#endif
+
+   switch (backend) {
+      case LTC_GCM_BACKEND_C:
+         return sizeof(gcm_state);
+
+#ifdef LTC_X86_SIMD
+      case LTC_GCM_BACKEND_PCLMUL:
+#endif
+      case LTC_GCM_BACKEND_4BIT:
+         return offsetof(gcm_state, K) + keysize;
+
+      default:
+         return 0;
+   }
+}
+
+/**
+  Initialize a GCM state with a given GHASH backend
+  @param gcm     The GCM state to initialize, gcm_state_size(backend, cipher) bytes
+  @param backend The LTC_GCM_BACKEND_ to hash with
+  @param cipher  The index of the cipher to use
+  @param key     The secret key
+  @param keylen  The length of the secret key
+  @return CRYPT_OK on success
+ */
+int gcm_init_backend(gcm_state *gcm, int backend, int cipher,
+                     const unsigned char *key, int keylen)
 {
    int           err;
    unsigned char B[16];
@@ -43,6 +91,10 @@ int gcm_init(gcm_state *gcm, int cipher,
    }
 #endif
 
+   if (gcm_state_size(backend, cipher) == 0) {
+      return CRYPT_INVALID_ARG;
+   }
+
    /* is cipher valid? */
    if ((err = cipher_is_valid(cipher)) != CRYPT_OK) {
       return err;
@@ -71,6 +123,20 @@ int gcm_init(gcm_state *gcm, int cipher,
    gcm->buflen   = 0;
    gcm->totlen   = 0;
    gcm->pttotlen = 0;
+   gcm->ghash    = backend;
+
+   if (gcm->ghash == LTC_GCM_BACKEND_4BIT) {
+      gcm_init_4bit(gcm);
+      return CRYPT_OK;
+   }
+
+#ifdef LTC_X86_SIMD
+   /* the carry-less multiply only needs the powers of H */
+   if (gcm->ghash == LTC_GCM_BACKEND_PCLMUL) {
+      gcm_init_pclmul(gcm);
+      return CRYPT_OK;
+   }
+#endif
 
 #ifdef LTC_GCM_TABLES
    /* setup tables */
@@ -26,6 +26,21 @@ void gcm_mult_h(gcm_state *gcm, unsigned char *I)
    unsigned char T[16];
 #ifdef LTC_GCM_TABLES
    int x, y;
+#endif
+
+   if (gcm->ghash == LTC_GCM_BACKEND_4BIT) {
+      gcm_mult_h_4bit(gcm, I);
+      return;
+   }
+
+#ifdef LTC_X86_SIMD
+   if (gcm->ghash == LTC_GCM_BACKEND_PCLMUL) {
+      gcm_mult_h_pclmul(gcm, I);
+      return;
+   }
+#endif
+
+#ifdef LTC_GCM_TABLES
 #ifdef LTC_GCM_TABLES_SSE2
    asm("movdqa (%0),%%xmm0"::"r"(&gcm->PC[0][I[0]][0]));
    for (x = 1; x < 16; x++) {
@@ -74,6 +74,24 @@ int gcm_process(gcm_state *gcm,
       return CRYPT_INVALID_ARG;
    }
 
+#ifdef LTC_X86_SIMD
+   /* whole blocks at once, CTR and GHASH over 8 blocks at a time */
+   if (gcm->buflen == 0 && gcm->ghash == LTC_GCM_BACKEND_PCLMUL && ptlen >= 16) {
+      x = ptlen & ~15UL;
+      if (direction == GCM_ENCRYPT) {
+         err = gcm_process_pclmul(gcm, pt, ct, x / 16, direction);
+      } else {
+         err = gcm_process_pclmul(gcm, ct, pt, x / 16, direction);
+      }
+      if (err != CRYPT_OK) {
+         return err;
+      }
+      pt    += x;
+      ct    += x;
+      ptlen -= x;
+   }
+#endif
+
    x = 0;
 #ifdef LTC_FAST
    if (gcm->buflen == 0) {
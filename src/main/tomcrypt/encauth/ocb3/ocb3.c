@@ -0,0 +1,605 @@
+/* LibTomCrypt, modular cryptographic library -- Tom St Denis
+ *
+ * LibTomCrypt is a library that provides various cryptographic
+ * algorithms in a highly modular and flexible manner.
+ *
+ * The library is free for all purposes without any express
+ * guarantee it works.
+ *
+ * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
+ */
+#include "tomcrypt.h"
+
+#ifdef LTC_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+  @file ocb3.c
+  OCB3 authenticated encryption (RFC 7253) over any 128 bit block cipher.
+  Block i is masked with Offset_i = Offset_{i-1} ^ L_{ntz(i)}, so the L table
+  is made once at init and every block can go through the cipher at the same
+  time as its neighbours.  AES on the AES-NI backend does 8 blocks per batch,
+  other ciphers go through their ECB accelerator 16 blocks at a time.
+*/
+
+#ifdef LTC_OCB3_MODE
+
+/* blocks per pass through a cipher without the AES-NI path */
+#define OCB3_BATCH      16
+
+/* internal, the AAD blocks go through the cipher like text and are summed */
+#define OCB3_HASH       2
+
+/* L_i goes up to ntz(2^32 - 1) */
+#define OCB3_MAX_BLOCKS CONST64(0xFFFFFFFF)
+
+/* out = in * x in GF(2^128) */
+static void ocb3_double(const unsigned char *in, unsigned char *out)
+{
+    ulong64 hi, lo, c;
+
+    LOAD64H(hi, in);
+    LOAD64H(lo, in + 8);
+    c = hi >> 63;
+    hi = (hi << 1) | (lo >> 63);
+    lo = (lo << 1) ^ (CONST64(0x87) & (0 - c));
+    STORE64H(hi, out);
+    STORE64H(lo, out + 8);
+}
+
+/* block index last needs L_ up to its highest bit */
+static void ocb3_extend_l(ocb3_state *ocb, ulong64 last)
+{
+    while (ocb->lcount < OCB3_L_COUNT && (CONST64(1) << ocb->lcount) <= last) {
+        ocb3_double(ocb->L_[ocb->lcount - 1], ocb->L_[ocb->lcount]);
+        ocb->lcount++;
+    }
+}
+
+static unsigned ocb3_ntz(ulong64 x)
+{
+    unsigned n = 0;
+
+    while ((x & 1) == 0) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+
+static void ocb3_xor16(unsigned char *out, const unsigned char *a, const unsigned char *b)
+{
+    int x;
+
+    for (x = 0; x < 16; x++) {
+        out[x] = a[x] ^ b[x];
+    }
+}
+
+#ifdef LTC_X86_SIMD
+
+#define OCB3_AESNI_TARGET   __attribute__((target("aes,ssse3")))
+
+#define OCB3_AESNI_KEY(K, r) \
+    _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)((K) + 4*(r))), _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3))
+
+#define OCB3_LANES      8
+#define OCB3_LANE8(S)   S(0) S(1) S(2) S(3) S(4) S(5) S(6) S(7)
+
+/* Whole batches of 8 blocks with the rounds of all 8 interleaved.  The offsets
+   of a batch are a chain of XORs, made before the cipher starts on it.
+   Returns the number of blocks done */
+OCB3_AESNI_TARGET
+static unsigned long ocb3_aesni_blocks(ocb3_state *ocb, const unsigned char *in, unsigned char *out,
+                                       unsigned long blocks, int mode)
+{
+    const ulong32 *K = (mode == OCB3_DECRYPT) ? ocb->key.rijndael.dK : ocb->key.rijndael.eK;
+    unsigned char *offset = (mode == OCB3_HASH) ? ocb->aOffset : ocb->Offset;
+    unsigned char *sum = (mode == OCB3_HASH) ? ocb->aSum : ocb->Checksum;
+    ulong64 *count = (mode == OCB3_HASH) ? &ocb->ablocks : &ocb->blocks;
+    __m128i rk[15], o[OCB3_LANES], b[OCB3_LANES], off, s;
+    unsigned long done = 0;
+    int Nr = ocb->key.rijndael.Nr, r;
+
+    for (r = 0; r <= Nr; r++) {
+        rk[r] = OCB3_AESNI_KEY(K, r);
+    }
+    off = _mm_loadu_si128((const __m128i *)offset);
+    s = _mm_loadu_si128((const __m128i *)sum);
+
+#define OCB3_IN(i)      off = _mm_xor_si128(off, _mm_loadu_si128((const __m128i *)ocb->L_[ocb3_ntz(++*count)])); \
+                        o[i] = off; \
+                        b[i] = _mm_loadu_si128((const __m128i *)in + i); \
+                        if (mode == OCB3_ENCRYPT) s = _mm_xor_si128(s, b[i]); \
+                        b[i] = _mm_xor_si128(_mm_xor_si128(b[i], o[i]), rk[0]);
+#define OCB3_ENC(i)     b[i] = _mm_aesenc_si128(b[i], rk[r]);
+#define OCB3_ENCLAST(i) b[i] = _mm_aesenclast_si128(b[i], rk[Nr]);
+#define OCB3_DEC(i)     b[i] = _mm_aesdec_si128(b[i], rk[r]);
+#define OCB3_DECLAST(i) b[i] = _mm_aesdeclast_si128(b[i], rk[Nr]);
+#define OCB3_SUM(i)     s = _mm_xor_si128(s, b[i]);
+#define OCB3_OUT(i)     b[i] = _mm_xor_si128(b[i], o[i]); \
+                        _mm_storeu_si128((__m128i *)out + i, b[i]); \
+                        if (mode == OCB3_DECRYPT) s = _mm_xor_si128(s, b[i]);
+
+    for (; blocks >= OCB3_LANES; blocks -= OCB3_LANES, done += OCB3_LANES) {
+        OCB3_LANE8(OCB3_IN)
+        if (mode == OCB3_DECRYPT) {
+           for (r = 1; r < Nr; r++) {
+               OCB3_LANE8(OCB3_DEC)
+           }
+           OCB3_LANE8(OCB3_DECLAST)
+        } else {
+           for (r = 1; r < Nr; r++) {
+               OCB3_LANE8(OCB3_ENC)
+           }
+           OCB3_LANE8(OCB3_ENCLAST)
+        }
+        if (mode == OCB3_HASH) {
+           OCB3_LANE8(OCB3_SUM)
+        } else {
+           OCB3_LANE8(OCB3_OUT)
+           out += 16 * OCB3_LANES;
+        }
+        in += 16 * OCB3_LANES;
+    }
+
+#undef OCB3_IN
+#undef OCB3_ENC
+#undef OCB3_ENCLAST
+#undef OCB3_DEC
+#undef OCB3_DECLAST
+#undef OCB3_SUM
+#undef OCB3_OUT
+
+    _mm_storeu_si128((__m128i *)offset, off);
+    _mm_storeu_si128((__m128i *)sum, s);
+
+    return done;
+}
+
+#endif /* LTC_X86_SIMD */
+
+/* Whole blocks through the cipher descriptor.  The AAD only goes forward through
+   the cipher and is summed, the text is also masked on the way out */
+static int ocb3_blocks(ocb3_state *ocb, const unsigned char *in, unsigned char *out,
+                       unsigned long blocks, int mode)
+{
+    const struct ltc_cipher_descriptor *desc = &cipher_descriptor[ocb->cipher];
+    unsigned char *offset = (mode == OCB3_HASH) ? ocb->aOffset : ocb->Offset;
+    unsigned char *sum = (mode == OCB3_HASH) ? ocb->aSum : ocb->Checksum;
+    ulong64 *count = (mode == OCB3_HASH) ? &ocb->ablocks : &ocb->blocks;
+    unsigned char off[OCB3_BATCH][16], buf[OCB3_BATCH * 16];
+    unsigned long n, x;
+    int err = CRYPT_OK;
+
+    ocb3_extend_l(ocb, *count + blocks);
+
+#ifdef LTC_X86_SIMD
+    if (desc->ecb_encrypt == rijndael_ecb_encrypt && rijndael_get_backend() == LTC_AES_BACKEND_AESNI) {
+       n = ocb3_aesni_blocks(ocb, in, out, blocks, mode);
+       in += 16 * n;
+       if (mode != OCB3_HASH) {
+          out += 16 * n;
+       }
+       blocks -= n;
+    }
+#endif
+
+    while (blocks > 0) {
+       n = MIN(blocks, OCB3_BATCH);
+
+       for (x = 0; x < n; x++) {
+           ocb3_xor16(offset, offset, ocb->L_[ocb3_ntz(++*count)]);
+           XMEMCPY(off[x], offset, 16);
+           if (mode == OCB3_ENCRYPT) {
+              ocb3_xor16(sum, sum, in + 16 * x);
+           }
+           ocb3_xor16(buf + 16 * x, in + 16 * x, off[x]);
+       }
+
+       if (mode == OCB3_DECRYPT) {
+          if (desc->accel_ecb_decrypt != NULL) {
+             err = desc->accel_ecb_decrypt(buf, buf, n, &ocb->key);
+          } else {
+             for (x = 0; x < n && err == CRYPT_OK; x++) {
+                 err = desc->ecb_decrypt(buf + 16 * x, buf + 16 * x, &ocb->key);
+             }
+          }
+       } else {
+          if (desc->accel_ecb_encrypt != NULL) {
+             err = desc->accel_ecb_encrypt(buf, buf, n, &ocb->key);
+          } else {
+             for (x = 0; x < n && err == CRYPT_OK; x++) {
+                 err = desc->ecb_encrypt(buf + 16 * x, buf + 16 * x, &ocb->key);
+             }
+          }
+       }
+       if (err != CRYPT_OK) {
+          goto done;
+       }
+
+       for (x = 0; x < n; x++) {
+           if (mode == OCB3_HASH) {
+              ocb3_xor16(sum, sum, buf + 16 * x);
+           } else {
+              ocb3_xor16(out + 16 * x, buf + 16 * x, off[x]);
+              if (mode == OCB3_DECRYPT) {
+                 ocb3_xor16(sum, sum, out + 16 * x);
+              }
+           }
+       }
+
+       in += 16 * n;
+       if (mode != OCB3_HASH) {
+          out += 16 * n;
+       }
+       blocks -= n;
+    }
+
+done:
+#ifdef LTC_CLEAN_STACK
+    zeromem(off, sizeof(off));
+    zeromem(buf, sizeof(buf));
+#endif
+    return err;
+}
+
+/**
+   Initialize an OCB3 state
+   @param ocb       The state
+   @param cipher    The index of a cipher with a 16 byte block
+   @param key       The secret key
+   @param keylen    The length of the key (octets)
+   @param nonce     The nonce, unique per message under a key
+   @param noncelen  1 to 15 octets
+   @param taglen    The tag length, 1 to 16 octets, part of the nonce block
+   @return CRYPT_OK if successful
+*/
+int ocb3_init(ocb3_state *ocb, int cipher, const unsigned char *key, unsigned long keylen,
+              const unsigned char *nonce, unsigned long noncelen, unsigned long taglen)
+{
+    unsigned char N[16], stretch[24];
+    unsigned bottom, byteshift, bitshift;
+    int err, x;
+
+    LTC_ARGCHK(ocb   != NULL);
+    LTC_ARGCHK(key   != NULL);
+    LTC_ARGCHK(nonce != NULL);
+
+    if ((err = cipher_is_valid(cipher)) != CRYPT_OK) {
+       return err;
+    }
+    if (cipher_descriptor[cipher].block_length != 16) {
+       return CRYPT_INVALID_CIPHER;
+    }
+    if (noncelen < 1 || noncelen > 15 || taglen < 1 || taglen > 16) {
+       return CRYPT_INVALID_ARG;
+    }
+
+    zeromem(ocb, sizeof(*ocb));
+    ocb->cipher = cipher;
+    ocb->taglen = taglen;
+
+    if ((err = cipher_descriptor[cipher].setup(key, keylen, 0, &ocb->key)) != CRYPT_OK) {
+       return err;
+    }
+
+    /* L_* = E(0), L_$ = double(L_*), L_0 = double(L_$), the rest as the blocks need them */
+    if ((err = cipher_descriptor[cipher].ecb_encrypt(ocb->L_star, ocb->L_star, &ocb->key)) != CRYPT_OK) {
+       goto error;
+    }
+    ocb3_double(ocb->L_star, ocb->L_dollar);
+    ocb3_double(ocb->L_dollar, ocb->L_[0]);
+    ocb->lcount = 1;
+
+    /* Nonce = num2str(TAGLEN mod 128, 7) || zeros || 1 || N */
+    zeromem(N, sizeof(N));
+    N[0] = (unsigned char)(((taglen * 8) % 128) << 1);
+    N[15 - noncelen] |= 1;
+    XMEMCPY(N + 16 - noncelen, nonce, noncelen);
+
+    /* Offset_0 = (Ktop || Ktop[1..64] ^ Ktop[9..72]) << bottom, 128 bits of it */
+    bottom = N[15] & 63;
+    N[15] &= 0xC0;
+    if ((err = cipher_descriptor[cipher].ecb_encrypt(N, stretch, &ocb->key)) != CRYPT_OK) {
+       goto error;
+    }
+    for (x = 0; x < 8; x++) {
+        stretch[16 + x] = stretch[x] ^ stretch[x + 1];
+    }
+    byteshift = bottom / 8;
+    bitshift = bottom % 8;
+    for (x = 0; x < 16; x++) {
+        ocb->Offset[x] = stretch[x + byteshift] << bitshift;
+        if (bitshift != 0) {
+           ocb->Offset[x] |= stretch[x + byteshift + 1] >> (8 - bitshift);
+        }
+    }
+
+#ifdef LTC_CLEAN_STACK
+    zeromem(N, sizeof(N));
+    zeromem(stretch, sizeof(stretch));
+#endif
+    return CRYPT_OK;
+
+error:
+    zeromem(ocb, sizeof(*ocb));
+    return err;
+}
+
+/**
+   Add AAD to the state, at any point before ocb3_done
+   @param ocb     The state
+   @param aad     The additional authenticated data
+   @param aadlen  The length of the AAD (octets)
+   @return CRYPT_OK if successful
+*/
+int ocb3_add_aad(ocb3_state *ocb, const unsigned char *aad, unsigned long aadlen)
+{
+    unsigned long n;
+    int err;
+
+    LTC_ARGCHK(ocb != NULL);
+    LTC_ARGCHK(aad != NULL || aadlen == 0);
+
+    if ((ulong64)(ocb->abuflen + aadlen) / 16 > OCB3_MAX_BLOCKS - ocb->ablocks) {
+       return CRYPT_INVALID_ARG;
+    }
+
+    /* top up a partial block first, it is only padded at the end */
+    if (ocb->abuflen > 0) {
+       n = MIN(aadlen, 16 - ocb->abuflen);
+       XMEMCPY(ocb->abuf + ocb->abuflen, aad, n);
+       ocb->abuflen += n;
+       aad += n;
+       aadlen -= n;
+       if (ocb->abuflen < 16) {
+          return CRYPT_OK;
+       }
+       if ((err = ocb3_blocks(ocb, ocb->abuf, NULL, 1, OCB3_HASH)) != CRYPT_OK) {
+          return err;
+       }
+       ocb->abuflen = 0;
+    }
+
+    n = aadlen / 16;
+    if (n > 0) {
+       if ((err = ocb3_blocks(ocb, aad, NULL, n, OCB3_HASH)) != CRYPT_OK) {
+          return err;
+       }
+    }
+
+    ocb->abuflen = aadlen % 16;
+    XMEMCPY(ocb->abuf, aad + 16 * n, ocb->abuflen);
+
+    return CRYPT_OK;
+}
+
+/* whole blocks, then a short last block that ends the text */
+static int ocb3_process(ocb3_state *ocb, const unsigned char *in, unsigned long len,
+                        unsigned char *out, int direction)
+{
+    unsigned char pad[16];
+    unsigned long n, x;
+    int err;
+
+    LTC_ARGCHK(ocb != NULL);
+    LTC_ARGCHK((in != NULL && out != NULL) || len == 0);
+
+    if (len == 0) {
+       return CRYPT_OK;
+    }
+    if (ocb->textdone || (ulong64)len / 16 > OCB3_MAX_BLOCKS - ocb->blocks) {
+       return CRYPT_INVALID_ARG;
+    }
+
+    n = len / 16;
+    if (n > 0) {
+       if ((err = ocb3_blocks(ocb, in, out, n, direction)) != CRYPT_OK) {
+          return err;
+       }
+       in += 16 * n;
+       out += 16 * n;
+       len -= 16 * n;
+    }
+
+    if (len > 0) {
+       /* Offset_* = Offset_m ^ L_*, Pad = E(Offset_*), the checksum takes P_* || 1 || 0s */
+       ocb3_xor16(ocb->Offset, ocb->Offset, ocb->L_star);
+       if ((err = cipher_descriptor[ocb->cipher].ecb_encrypt(ocb->Offset, pad, &ocb->key)) != CRYPT_OK) {
+          return err;
+       }
+       for (x = 0; x < len; x++) {
+           if (direction == OCB3_ENCRYPT) {
+              ocb->Checksum[x] ^= in[x];
+              out[x] = in[x] ^ pad[x];
+           } else {
+              out[x] = in[x] ^ pad[x];
+              ocb->Checksum[x] ^= out[x];
+           }
+       }
+       ocb->Checksum[len] ^= 0x80;
+       ocb->textdone = 1;
+#ifdef LTC_CLEAN_STACK
+       zeromem(pad, sizeof(pad));
+#endif
+    }
+
+    return CRYPT_OK;
+}
+
+/**
+   Encrypt text.  Every call but the last has to be a multiple of 16 octets
+   @param ocb    The state
+   @param pt     The plaintext
+   @param ptlen  The length of the plaintext (octets)
+   @param ct     [out] The ciphertext, may be pt
+   @return CRYPT_OK if successful
+*/
+int ocb3_encrypt(ocb3_state *ocb, const unsigned char *pt, unsigned long ptlen, unsigned char *ct)
+{
+    return ocb3_process(ocb, pt, ptlen, ct, OCB3_ENCRYPT);
+}
+
+/**
+   Decrypt text.  Every call but the last has to be a multiple of 16 octets
+   @param ocb    The state
+   @param ct     The ciphertext
+   @param ctlen  The length of the ciphertext (octets)
+   @param pt     [out] The plaintext, may be ct
+   @return CRYPT_OK if successful
+*/
+int ocb3_decrypt(ocb3_state *ocb, const unsigned char *ct, unsigned long ctlen, unsigned char *pt)
+{
+    return ocb3_process(ocb, ct, ctlen, pt, OCB3_DECRYPT);
+}
+
+/**
+   Finish the AAD and make the tag, the state is wiped afterwards
+   @param ocb     The state
+   @param tag     [out] The tag
+   @param taglen  [in/out] The room in tag, the length of the tag written
+   @return CRYPT_OK if successful
+*/
+int ocb3_done(ocb3_state *ocb, unsigned char *tag, unsigned long *taglen)
+{
+    unsigned char buf[16];
+    int err, x;
+
+    LTC_ARGCHK(ocb    != NULL);
+    LTC_ARGCHK(tag    != NULL);
+    LTC_ARGCHK(taglen != NULL);
+
+    if (*taglen < ocb->taglen) {
+       *taglen = ocb->taglen;
+       return CRYPT_BUFFER_OVERFLOW;
+    }
+
+    /* the last AAD block is padded with 1 || 0s and masked with L_* */
+    if (ocb->abuflen > 0) {
+       ocb3_xor16(ocb->aOffset, ocb->aOffset, ocb->L_star);
+       zeromem(buf, sizeof(buf));
+       XMEMCPY(buf, ocb->abuf, ocb->abuflen);
+       buf[ocb->abuflen] = 0x80;
+       ocb3_xor16(buf, buf, ocb->aOffset);
+       if ((err = cipher_descriptor[ocb->cipher].ecb_encrypt(buf, buf, &ocb->key)) != CRYPT_OK) {
+          goto done;
+       }
+       ocb3_xor16(ocb->aSum, ocb->aSum, buf);
+    }
+
+    /* Tag = E(Checksum ^ Offset ^ L_$) ^ HASH(K, A) */
+    ocb3_xor16(buf, ocb->Checksum, ocb->Offset);
+    ocb3_xor16(buf, buf, ocb->L_dollar);
+    if ((err = cipher_descriptor[ocb->cipher].ecb_encrypt(buf, buf, &ocb->key)) != CRYPT_OK) {
+       goto done;
+    }
+    for (x = 0; x < (int)ocb->taglen; x++) {
+        tag[x] = buf[x] ^ ocb->aSum[x];
+    }
+    *taglen = ocb->taglen;
+
+done:
+    cipher_descriptor[ocb->cipher].done(&ocb->key);
+    zeromem(buf, sizeof(buf));
+    zeromem(ocb, sizeof(*ocb));
+    return err;
+}
+
+/**
+  Test the OCB3 code against RFC 7253 appendix A
+  @return CRYPT_OK if successful
+*/
+int ocb3_test(void)
+{
+#ifndef LTC_TEST
+    return CRYPT_NOP;
+#else
+    static const unsigned char key[16] = {
+       0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+    static const struct {
+       unsigned char nonce[12];
+       unsigned long len;
+       unsigned char ct[40];
+       unsigned char tag[16];
+    } tests[] = {
+       /* empty A and P */
+       { { 0xbb, 0xaa, 0x99, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x00 },
+         0, { 0 },
+         { 0x78, 0x54, 0x07, 0xbf, 0xff, 0xc8, 0xad, 0x9e, 0xdc, 0xc5, 0x52, 0x0a, 0xc9, 0x11, 0x1e, 0xe6 } },
+       /* 24 octets, a partial AAD block and whole text blocks */
+       { { 0xbb, 0xaa, 0x99, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x04 },
+         24,
+         { 0x57, 0x1d, 0x53, 0x5b, 0x60, 0xb2, 0x77, 0x18, 0x8b, 0xe5, 0x14, 0x71, 0x70, 0xa9, 0xa2, 0x2c,
+           0x04, 0xf3, 0x5a, 0x3f, 0x90, 0x6b, 0x4b, 0x9c },
+         { 0x54, 0xe7, 0xaa, 0x90, 0xc0, 0x66, 0xae, 0x33, 0xe4, 0x8d, 0xaf, 0xfa, 0x64, 0x01, 0x84, 0x5f } },
+       /* 40 octets */
+       { { 0xbb, 0xaa, 0x99, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x0f },
+         40,
+         { 0x44, 0x12, 0x92, 0x34, 0x93, 0xc5, 0x7d, 0x5d, 0xe0, 0xd7, 0x00, 0xf7, 0x53, 0xcc, 0xe0, 0xd1,
+           0xd2, 0xd9, 0x50, 0x60, 0x12, 0x2e, 0x9f, 0x15, 0xa5, 0xdd, 0xbf, 0xc5, 0x78, 0x7e, 0x50, 0xb5,
+           0xcc, 0x55, 0xee, 0x50, 0x7b, 0xcb, 0x08, 0x4e },
+         { 0x24, 0x0a, 0x35, 0x36, 0x49, 0x43, 0x2a, 0xc6, 0xc1, 0xbd, 0xa9, 0xac, 0xba, 0x93, 0xf5, 0x6d } },
+    };
+    unsigned char data[40], out[40], tag[16];
+    unsigned long taglen;
+    ocb3_state ocb;
+    int err, idx, x;
+
+    if ((idx = find_cipher("aes")) == -1) {
+       if ((idx = find_cipher("rijndael")) == -1) {
+          return CRYPT_NOP;
+       }
+    }
+
+    for (x = 0; x < 40; x++) {
+        data[x] = (unsigned char)x;
+    }
+
+    for (x = 0; x < (int)(sizeof(tests)/sizeof(tests[0])); x++) {
+        /* A = P = 00 01 02 ... */
+        if ((err = ocb3_init(&ocb, idx, key, 16, tests[x].nonce, 12, 16)) != CRYPT_OK) {
+           return err;
+        }
+        if ((err = ocb3_add_aad(&ocb, data, tests[x].len)) != CRYPT_OK) {
+           return err;
+        }
+        if ((err = ocb3_encrypt(&ocb, data, tests[x].len, out)) != CRYPT_OK) {
+           return err;
+        }
+        taglen = sizeof(tag);
+        if ((err = ocb3_done(&ocb, tag, &taglen)) != CRYPT_OK) {
+           return err;
+        }
+        if (XMEMCMP(out, tests[x].ct, tests[x].len) != 0 || XMEMCMP(tag, tests[x].tag, 16) != 0) {
+           return CRYPT_FAIL_TESTVECTOR;
+        }
+
+        if ((err = ocb3_init(&ocb, idx, key, 16, tests[x].nonce, 12, 16)) != CRYPT_OK) {
+           return err;
+        }
+        if ((err = ocb3_add_aad(&ocb, data, tests[x].len)) != CRYPT_OK) {
+           return err;
+        }
+        if ((err = ocb3_decrypt(&ocb, out, tests[x].len, out)) != CRYPT_OK) {
+           return err;
+        }
+        taglen = sizeof(tag);
+        if ((err = ocb3_done(&ocb, tag, &taglen)) != CRYPT_OK) {
+           return err;
+        }
+        if (XMEMCMP(out, data, tests[x].len) != 0 || XMEMCMP(tag, tests[x].tag, 16) != 0) {
+           return CRYPT_FAIL_TESTVECTOR;
+        }
+    }
+
+    return CRYPT_OK;
+#endif
+}
+
+#endif /* LTC_OCB3_MODE */
+
+/* $Source$ */
+/* $Revision$ */
+/* $Date$ */
@@ -0,0 +1,1403 @@
+/* LibTomCrypt, modular cryptographic library -- Tom St Denis
+ *
+ * LibTomCrypt is a library that provides various cryptographic
+ * algorithms in a highly modular and flexible manner.
+ *
+ * The library is free for all purposes without any express
+ * guarantee it works.
+ *
+ * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
+ */
+#include "tomcrypt.h"
+
+/**
+  @file blake3.c
+  BLAKE3 hash function, see https://github.com/BLAKE3-team/BLAKE3-specs
+
+  Whole chunks are hashed several at a time in SIMD lanes (4 with SSE4.1,
+  8 with AVX2, 16 with AVX-512), and large updates are split into subtrees
+  that are hashed on separate threads.  Neither changes the result.
+*/
+
+#ifdef LTC_BLAKE3
+
+#ifdef LTC_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef LTC_BLAKE3_THREADS
+#include <pthread.h>
+#endif
+
+const struct ltc_hash_descriptor blake3_desc =
+{
+    "blake3",
+    20,
+    32,
+    64,
+
+    /* OID, none assigned */
+   { 0 },
+   0,
+
+    &blake3_init,
+    &blake3_process,
+    &blake3_done,
+    &blake3_test,
+    NULL
+};
+
+/* domain flags */
+#define B3_CHUNK_START          (1 << 0)
+#define B3_CHUNK_END            (1 << 1)
+#define B3_PARENT               (1 << 2)
+#define B3_ROOT                 (1 << 3)
+
+#define B3_MAX_SIMD_DEGREE      16
+
+#ifdef LTC_BLAKE3_THREADS
+/* subtrees smaller than this on either side are not worth a thread */
+#define B3_THREAD_MIN           (512 * 1024)
+#endif
+
+static const ulong32 blake3_IV[8] = {
+    0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+    0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+/* message word order of each round */
+static const unsigned char blake3_schedule[7][16] = {
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    {  2,  6,  3, 10,  7,  0,  4, 13,  1, 11, 12,  5,  9, 14, 15,  8 },
+    {  3,  4, 10, 12, 13,  2,  7, 14,  6,  5,  9,  0, 11, 15,  8,  1 },
+    { 10,  7, 12,  9, 14,  3, 13, 15,  4,  0, 11,  2,  5,  8,  1,  6 },
+    { 12, 13,  9, 11, 15, 10, 14,  8,  7,  2,  5,  3,  0,  1,  6,  4 },
+    {  9, 14, 11,  5,  8, 12, 15,  1, 13,  3,  0, 10,  2,  6,  4,  7 },
+    { 11, 15,  5,  0,  1,  9,  8,  6, 14, 10,  2, 12,  3,  4,  7, 13 },
+};
+
+/* the quarter round and the round, written in terms of ADD, XOR and ROTRn
+   so the scalar and the SIMD lane kernels share them */
+#define B3_G(a, b, c, d, x, y)                          \
+    a = ADD(ADD(a, b), x); d = ROTR16(XOR(d, a));       \
+    c = ADD(c, d);         b = ROTR12(XOR(b, c));       \
+    a = ADD(ADD(a, b), y); d = ROTR8(XOR(d, a));        \
+    c = ADD(c, d);         b = ROTR7(XOR(b, c));
+
+#define B3_ROUND(v, m, r)                                                                       \
+    B3_G(v[0], v[4], v[ 8], v[12], m[blake3_schedule[r][ 0]], m[blake3_schedule[r][ 1]])        \
+    B3_G(v[1], v[5], v[ 9], v[13], m[blake3_schedule[r][ 2]], m[blake3_schedule[r][ 3]])        \
+    B3_G(v[2], v[6], v[10], v[14], m[blake3_schedule[r][ 4]], m[blake3_schedule[r][ 5]])        \
+    B3_G(v[3], v[7], v[11], v[15], m[blake3_schedule[r][ 6]], m[blake3_schedule[r][ 7]])        \
+    B3_G(v[0], v[5], v[10], v[15], m[blake3_schedule[r][ 8]], m[blake3_schedule[r][ 9]])        \
+    B3_G(v[1], v[6], v[11], v[12], m[blake3_schedule[r][10]], m[blake3_schedule[r][11]])        \
+    B3_G(v[2], v[7], v[ 8], v[13], m[blake3_schedule[r][12]], m[blake3_schedule[r][13]])        \
+    B3_G(v[3], v[4], v[ 9], v[14], m[blake3_schedule[r][14]], m[blake3_schedule[r][15]])
+
+#define B3_ROUNDS(v, m)                                                                         \
+    B3_ROUND(v, m, 0) B3_ROUND(v, m, 1) B3_ROUND(v, m, 2) B3_ROUND(v, m, 3)                     \
+    B3_ROUND(v, m, 4) B3_ROUND(v, m, 5) B3_ROUND(v, m, 6)
+
+/* portable compress */
+
+#define ADD(a, b)   ((a) + (b))
+#define XOR(a, b)   ((a) ^ (b))
+#define ROTR16(x)   RORc(x, 16)
+#define ROTR12(x)   RORc(x, 12)
+#define ROTR8(x)    RORc(x, 8)
+#define ROTR7(x)    RORc(x, 7)
+
+static void blake3_compress_c(ulong32 v[16], const ulong32 cv[8], const unsigned char *block,
+                              unsigned char block_len, ulong64 counter, unsigned char flags)
+{
+    ulong32 m[16];
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        LOAD32L(m[i], block + 4 * i);
+    }
+    for (i = 0; i < 8; i++) {
+        v[i] = cv[i];
+    }
+    v[ 8] = blake3_IV[0];
+    v[ 9] = blake3_IV[1];
+    v[10] = blake3_IV[2];
+    v[11] = blake3_IV[3];
+    v[12] = (ulong32)counter;
+    v[13] = (ulong32)(counter >> 32);
+    v[14] = block_len;
+    v[15] = flags;
+
+    B3_ROUNDS(v, m)
+}
+
+#undef ADD
+#undef XOR
+#undef ROTR16
+#undef ROTR12
+#undef ROTR8
+#undef ROTR7
+
+static void blake3_compress_in_place_c(ulong32 cv[8], const unsigned char *block,
+                                       unsigned char block_len, ulong64 counter, unsigned char flags)
+{
+    ulong32 v[16];
+    int i;
+
+    blake3_compress_c(v, cv, block, block_len, counter, flags);
+    for (i = 0; i < 8; i++) {
+        cv[i] = v[i] ^ v[i + 8];
+    }
+}
+
+static void blake3_compress_xof_c(const ulong32 cv[8], const unsigned char *block,
+                                  unsigned char block_len, ulong64 counter, unsigned char flags,
+                                  unsigned char out[64])
+{
+    ulong32 v[16];
+    int i;
+
+    blake3_compress_c(v, cv, block, block_len, counter, flags);
+    for (i = 0; i < 8; i++) {
+        STORE32L(v[i] ^ v[i + 8], out + 4 * i);
+        STORE32L(v[i + 8] ^ cv[i], out + 32 + 4 * i);
+    }
+}
+
+typedef void (*blake3_hash_many_fn)(const unsigned char *const *inputs, size_t num_inputs, size_t blocks,
+                                    const ulong32 key[8], ulong64 counter, int increment_counter,
+                                    unsigned char flags, unsigned char flags_start, unsigned char flags_end,
+                                    unsigned char *out);
+
+static void (*blake3_compress_in_place)(ulong32 cv[8], const unsigned char *block,
+                                        unsigned char block_len, ulong64 counter,
+                                        unsigned char flags) = blake3_compress_in_place_c;
+static void (*blake3_compress_xof)(const ulong32 cv[8], const unsigned char *block,
+                                   unsigned char block_len, ulong64 counter, unsigned char flags,
+                                   unsigned char out[64]) = blake3_compress_xof_c;
+
+/* hash blocks consecutive blocks of each input, one input at a time */
+static void blake3_hash_many_c(const unsigned char *const *inputs, size_t num_inputs, size_t blocks,
+                               const ulong32 key[8], ulong64 counter, int increment_counter,
+                               unsigned char flags, unsigned char flags_start, unsigned char flags_end,
+                               unsigned char *out)
+{
+    ulong32 cv[8];
+    size_t b;
+    unsigned char block_flags;
+    int i;
+
+    for (; num_inputs > 0; num_inputs--, inputs++, out += BLAKE3_OUT_LEN) {
+        XMEMCPY(cv, key, sizeof(cv));
+        block_flags = flags | flags_start;
+        for (b = 0; b < blocks; b++) {
+            if (b + 1 == blocks) {
+                block_flags |= flags_end;
+            }
+            blake3_compress_in_place(cv, *inputs + b * BLAKE3_BLOCK_LEN, BLAKE3_BLOCK_LEN, counter, block_flags);
+            block_flags = flags;
+        }
+        for (i = 0; i < 8; i++) {
+            STORE32L(cv[i], out + 4 * i);
+        }
+        if (increment_counter) {
+            counter++;
+        }
+    }
+}
+
+#ifdef LTC_X86_SIMD
+
+/* lane kernels: lane j hashes inputs[j], the state words are transposed
+   so v[i] holds word i of every lane */
+
+#define B3_LANE_COUNTERS(lo, hi, n)                                         \
+    for (j = 0; j < (n); j++) {                                             \
+        ulong64 c = counter + (increment_counter ? (ulong64)j : 0);         \
+        lo[j] = (ulong32)c;                                                 \
+        hi[j] = (ulong32)(c >> 32);                                         \
+    }
+
+#define B3_LANE_FLAGS()                                                     \
+    block_flags = flags;                                                    \
+    if (b == 0) block_flags |= flags_start;                                 \
+    if (b + 1 == blocks) block_flags |= flags_end;
+
+/* SSE4.1 */
+
+#define ADD(a, b)   _mm_add_epi32(a, b)
+#define XOR(a, b)   _mm_xor_si128(a, b)
+#define ROTR16(x)   _mm_shuffle_epi8(x, R16)
+#define ROTR12(x)   _mm_or_si128(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 20))
+#define ROTR8(x)    _mm_shuffle_epi8(x, R8)
+#define ROTR7(x)    _mm_or_si128(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 25))
+
+#define B3_SHUFFLE_PS(a, b, c)  \
+    _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), (c)))
+
+/* one block with the state as 4 rows, the message permutation is done in registers */
+__attribute__((target("sse4.1")))
+static void blake3_compress_rows_sse41(__m128i rows[4], const ulong32 cv[8], const unsigned char *block,
+                                       unsigned char block_len, ulong64 counter, unsigned char flags)
+{
+    const __m128i R16 = _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m128i R8  = _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+    __m128i r0, r1, r2, r3, m0, m1, m2, m3, t0, t1, t2, t3, tt;
+    int r;
+
+    r0 = _mm_loadu_si128((const __m128i *)&cv[0]);
+    r1 = _mm_loadu_si128((const __m128i *)&cv[4]);
+    r2 = _mm_setr_epi32((int)blake3_IV[0], (int)blake3_IV[1], (int)blake3_IV[2], (int)blake3_IV[3]);
+    r3 = _mm_setr_epi32((int)(ulong32)counter, (int)(ulong32)(counter >> 32), block_len, flags);
+
+    m0 = _mm_loadu_si128((const __m128i *)(block +  0));
+    m1 = _mm_loadu_si128((const __m128i *)(block + 16));
+    m2 = _mm_loadu_si128((const __m128i *)(block + 32));
+    m3 = _mm_loadu_si128((const __m128i *)(block + 48));
+
+#define B3_G1(m)    r0 = ADD(ADD(r0, m), r1); r3 = ROTR16(XOR(r3, r0)); r2 = ADD(r2, r3); r1 = ROTR12(XOR(r1, r2));
+#define B3_G2(m)    r0 = ADD(ADD(r0, m), r1); r3 = ROTR8(XOR(r3, r0));  r2 = ADD(r2, r3); r1 = ROTR7(XOR(r1, r2));
+
+/* rotate rows 0, 2 and 3 so the diagonals line up as columns */
+#define B3_DIAGONALIZE()                                                    \
+    r0 = _mm_shuffle_epi32(r0, _MM_SHUFFLE(2, 1, 0, 3));                    \
+    r3 = _mm_shuffle_epi32(r3, _MM_SHUFFLE(1, 0, 3, 2));                    \
+    r2 = _mm_shuffle_epi32(r2, _MM_SHUFFLE(0, 3, 2, 1));
+
+#define B3_UNDIAGONALIZE()                                                  \
+    r0 = _mm_shuffle_epi32(r0, _MM_SHUFFLE(0, 3, 2, 1));                    \
+    r3 = _mm_shuffle_epi32(r3, _MM_SHUFFLE(1, 0, 3, 2));                    \
+    r2 = _mm_shuffle_epi32(r2, _MM_SHUFFLE(2, 1, 0, 3));
+
+    /* round 1, t0..t3 are the words in the order the G functions use them */
+    t0 = B3_SHUFFLE_PS(m0, m1, _MM_SHUFFLE(2, 0, 2, 0));
+    B3_G1(t0);
+    t1 = B3_SHUFFLE_PS(m0, m1, _MM_SHUFFLE(3, 1, 3, 1));
+    B3_G2(t1);
+    B3_DIAGONALIZE();
+    t2 = B3_SHUFFLE_PS(m2, m3, _MM_SHUFFLE(2, 0, 2, 0));
+    t2 = _mm_shuffle_epi32(t2, _MM_SHUFFLE(2, 1, 0, 3));
+    B3_G1(t2);
+    t3 = B3_SHUFFLE_PS(m2, m3, _MM_SHUFFLE(3, 1, 3, 1));
+    t3 = _mm_shuffle_epi32(t3, _MM_SHUFFLE(2, 1, 0, 3));
+    B3_G2(t3);
+    B3_UNDIAGONALIZE();
+    m0 = t0; m1 = t1; m2 = t2; m3 = t3;
+
+    /* rounds 2-7, the same permutation of the previous round's order each time */
+    for (r = 1; r < 7; r++) {
+        t0 = B3_SHUFFLE_PS(m0, m1, _MM_SHUFFLE(3, 1, 1, 2));
+        t0 = _mm_shuffle_epi32(t0, _MM_SHUFFLE(0, 3, 2, 1));
+        B3_G1(t0);
+        t1 = B3_SHUFFLE_PS(m2, m3, _MM_SHUFFLE(3, 3, 2, 2));
+        tt = _mm_shuffle_epi32(m0, _MM_SHUFFLE(0, 0, 3, 3));
+        t1 = _mm_blend_epi16(tt, t1, 0xCC);
+        B3_G2(t1);
+        B3_DIAGONALIZE();
+        t2 = _mm_unpacklo_epi64(m3, m1);
+        tt = _mm_blend_epi16(t2, m2, 0xC0);
+        t2 = _mm_shuffle_epi32(tt, _MM_SHUFFLE(1, 3, 2, 0));
+        B3_G1(t2);
+        t3 = _mm_unpackhi_epi32(m1, m3);
+        tt = _mm_unpacklo_epi32(m2, t3);
+        t3 = _mm_shuffle_epi32(tt, _MM_SHUFFLE(0, 1, 3, 2));
+        B3_G2(t3);
+        B3_UNDIAGONALIZE();
+        m0 = t0; m1 = t1; m2 = t2; m3 = t3;
+    }
+
+#undef B3_G1
+#undef B3_G2
+#undef B3_DIAGONALIZE
+#undef B3_UNDIAGONALIZE
+
+    rows[0] = r0;
+    rows[1] = r1;
+    rows[2] = r2;
+    rows[3] = r3;
+}
+
+__attribute__((target("sse4.1")))
+static void blake3_compress_in_place_sse41(ulong32 cv[8], const unsigned char *block,
+                                           unsigned char block_len, ulong64 counter, unsigned char flags)
+{
+    __m128i rows[4];
+
+    blake3_compress_rows_sse41(rows, cv, block, block_len, counter, flags);
+    _mm_storeu_si128((__m128i *)&cv[0], _mm_xor_si128(rows[0], rows[2]));
+    _mm_storeu_si128((__m128i *)&cv[4], _mm_xor_si128(rows[1], rows[3]));
+}
+
+__attribute__((target("sse4.1")))
+static void blake3_compress_xof_sse41(const ulong32 cv[8], const unsigned char *block,
+                                      unsigned char block_len, ulong64 counter, unsigned char flags,
+                                      unsigned char out[64])
+{
+    __m128i rows[4];
+
+    blake3_compress_rows_sse41(rows, cv, block, block_len, counter, flags);
+    _mm_storeu_si128((__m128i *)(out +  0), _mm_xor_si128(rows[0], rows[2]));
+    _mm_storeu_si128((__m128i *)(out + 16), _mm_xor_si128(rows[1], rows[3]));
+    _mm_storeu_si128((__m128i *)(out + 32), _mm_xor_si128(rows[2], _mm_loadu_si128((const __m128i *)&cv[0])));
+    _mm_storeu_si128((__m128i *)(out + 48), _mm_xor_si128(rows[3], _mm_loadu_si128((const __m128i *)&cv[4])));
+}
+
+__attribute__((target("sse4.1")))
+static void blake3_transpose4_sse41(__m128i *a, __m128i *b, __m128i *c, __m128i *d)
+{
+    __m128i t0 = _mm_unpacklo_epi32(*a, *b);
+    __m128i t1 = _mm_unpackhi_epi32(*a, *b);
+    __m128i t2 = _mm_unpacklo_epi32(*c, *d);
+    __m128i t3 = _mm_unpackhi_epi32(*c, *d);
+
+    *a = _mm_unpacklo_epi64(t0, t2);
+    *b = _mm_unpackhi_epi64(t0, t2);
+    *c = _mm_unpacklo_epi64(t1, t3);
+    *d = _mm_unpackhi_epi64(t1, t3);
+}
+
+__attribute__((target("sse4.1")))
+static void blake3_hash4_sse41(const unsigned char *const *inputs, size_t blocks,
+                               const ulong32 key[8], ulong64 counter, int increment_counter,
+                               unsigned char flags, unsigned char flags_start, unsigned char flags_end,
+                               unsigned char *out)
+{
+    const __m128i R16 = _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m128i R8  = _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+    __m128i h[8], v[16], m[16], ctr_lo, ctr_hi;
+    ulong32 lo[4], hi[4];
+    unsigned char block_flags;
+    size_t b, off;
+    int i, j;
+
+    B3_LANE_COUNTERS(lo, hi, 4);
+    ctr_lo = _mm_loadu_si128((const __m128i *)lo);
+    ctr_hi = _mm_loadu_si128((const __m128i *)hi);
+
+    for (i = 0; i < 8; i++) {
+        h[i] = _mm_set1_epi32((int)key[i]);
+    }
+
+    for (b = 0; b < blocks; b++) {
+        B3_LANE_FLAGS();
+        off = b * BLAKE3_BLOCK_LEN;
+
+        for (i = 0; i < 16; i += 4) {
+            for (j = 0; j < 4; j++) {
+                m[i + j] = _mm_loadu_si128((const __m128i *)(inputs[j] + off + 4 * i));
+            }
+            blake3_transpose4_sse41(&m[i], &m[i + 1], &m[i + 2], &m[i + 3]);
+        }
+
+        for (i = 0; i < 8; i++) {
+            v[i] = h[i];
+        }
+        v[ 8] = _mm_set1_epi32((int)blake3_IV[0]);
+        v[ 9] = _mm_set1_epi32((int)blake3_IV[1]);
+        v[10] = _mm_set1_epi32((int)blake3_IV[2]);
+        v[11] = _mm_set1_epi32((int)blake3_IV[3]);
+        v[12] = ctr_lo;
+        v[13] = ctr_hi;
+        v[14] = _mm_set1_epi32(BLAKE3_BLOCK_LEN);
+        v[15] = _mm_set1_epi32(block_flags);
+
+        B3_ROUNDS(v, m)
+
+        for (i = 0; i < 8; i++) {
+            h[i] = XOR(v[i], v[i + 8]);
+        }
+    }
+
+    blake3_transpose4_sse41(&h[0], &h[1], &h[2], &h[3]);
+    blake3_transpose4_sse41(&h[4], &h[5], &h[6], &h[7]);
+    for (j = 0; j < 4; j++) {
+        _mm_storeu_si128((__m128i *)(out + j * BLAKE3_OUT_LEN), h[j]);
+        _mm_storeu_si128((__m128i *)(out + j * BLAKE3_OUT_LEN + 16), h[4 + j]);
+    }
+}
+
+#undef ADD
+#undef XOR
+#undef ROTR16
+#undef ROTR12
+#undef ROTR8
+#undef ROTR7
+
+/* AVX2 */
+
+#define ADD(a, b)   _mm256_add_epi32(a, b)
+#define XOR(a, b)   _mm256_xor_si256(a, b)
+#define ROTR16(x)   _mm256_shuffle_epi8(x, R16)
+#define ROTR12(x)   _mm256_or_si256(_mm256_srli_epi32(x, 12), _mm256_slli_epi32(x, 20))
+#define ROTR8(x)    _mm256_shuffle_epi8(x, R8)
+#define ROTR7(x)    _mm256_or_si256(_mm256_srli_epi32(x, 7), _mm256_slli_epi32(x, 25))
+
+__attribute__((target("avx2")))
+static void blake3_transpose8_avx2(__m256i v[8])
+{
+    __m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(v[2], v[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(v[4], v[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(v[4], v[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(v[6], v[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(v[6], v[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    v[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    v[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    v[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    v[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    v[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    v[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    v[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    v[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+__attribute__((target("avx2")))
+static void blake3_hash8_avx2(const unsigned char *const *inputs, size_t blocks,
+                              const ulong32 key[8], ulong64 counter, int increment_counter,
+                              unsigned char flags, unsigned char flags_start, unsigned char flags_end,
+                              unsigned char *out)
+{
+    const __m256i R16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                         2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i R8  = _mm256_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+                                         1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+    __m256i h[8], v[16], m[16], ctr_lo, ctr_hi;
+    ulong32 lo[8], hi[8];
+    unsigned char block_flags;
+    size_t b, off;
+    int i, j;
+
+    B3_LANE_COUNTERS(lo, hi, 8);
+    ctr_lo = _mm256_loadu_si256((const __m256i *)lo);
+    ctr_hi = _mm256_loadu_si256((const __m256i *)hi);
+
+    for (i = 0; i < 8; i++) {
+        h[i] = _mm256_set1_epi32((int)key[i]);
+    }
+
+    for (b = 0; b < blocks; b++) {
+        B3_LANE_FLAGS();
+        off = b * BLAKE3_BLOCK_LEN;
+
+        for (j = 0; j < 8; j++) {
+            m[j]     = _mm256_loadu_si256((const __m256i *)(inputs[j] + off));
+            m[j + 8] = _mm256_loadu_si256((const __m256i *)(inputs[j] + off + 32));
+        }
+        blake3_transpose8_avx2(&m[0]);
+        blake3_transpose8_avx2(&m[8]);
+
+        for (i = 0; i < 8; i++) {
+            v[i] = h[i];
+        }
+        v[ 8] = _mm256_set1_epi32((int)blake3_IV[0]);
+        v[ 9] = _mm256_set1_epi32((int)blake3_IV[1]);
+        v[10] = _mm256_set1_epi32((int)blake3_IV[2]);
+        v[11] = _mm256_set1_epi32((int)blake3_IV[3]);
+        v[12] = ctr_lo;
+        v[13] = ctr_hi;
+        v[14] = _mm256_set1_epi32(BLAKE3_BLOCK_LEN);
+        v[15] = _mm256_set1_epi32(block_flags);
+
+        B3_ROUNDS(v, m)
+
+        for (i = 0; i < 8; i++) {
+            h[i] = XOR(v[i], v[i + 8]);
+        }
+    }
+
+    blake3_transpose8_avx2(h);
+    for (j = 0; j < 8; j++) {
+        _mm256_storeu_si256((__m256i *)(out + j * BLAKE3_OUT_LEN), h[j]);
+    }
+}
+
+#undef ADD
+#undef XOR
+#undef ROTR16
+#undef ROTR12
+#undef ROTR8
+#undef ROTR7
+
+/* AVX-512 */
+
+#define ADD(a, b)   _mm512_add_epi32(a, b)
+#define XOR(a, b)   _mm512_xor_si512(a, b)
+#define ROTR16(x)   _mm512_ror_epi32(x, 16)
+#define ROTR12(x)   _mm512_ror_epi32(x, 12)
+#define ROTR8(x)    _mm512_ror_epi32(x, 8)
+#define ROTR7(x)    _mm512_ror_epi32(x, 7)
+
+/* 4x4 transposes inside each 128 bit lane, then a 4x4 transpose of the lanes */
+__attribute__((target("avx512f")))
+static void blake3_transpose16_avx512(__m512i v[16])
+{
+    __m512i x[16], p0, p1, p2, p3;
+    int g, i;
+
+    for (g = 0; g < 16; g += 4) {
+        __m512i t0 = _mm512_unpacklo_epi32(v[g + 0], v[g + 1]);
+        __m512i t1 = _mm512_unpackhi_epi32(v[g + 0], v[g + 1]);
+        __m512i t2 = _mm512_unpacklo_epi32(v[g + 2], v[g + 3]);
+        __m512i t3 = _mm512_unpackhi_epi32(v[g + 2], v[g + 3]);
+
+        x[g + 0] = _mm512_unpacklo_epi64(t0, t2);
+        x[g + 1] = _mm512_unpackhi_epi64(t0, t2);
+        x[g + 2] = _mm512_unpacklo_epi64(t1, t3);
+        x[g + 3] = _mm512_unpackhi_epi64(t1, t3);
+    }
+
+    /* x[4g + i] lane k holds word 4k + i of rows 4g..4g+3 */
+    for (i = 0; i < 4; i++) {
+        p0 = _mm512_shuffle_i32x4(x[i],     x[4 + i],  _MM_SHUFFLE(1, 0, 1, 0));
+        p1 = _mm512_shuffle_i32x4(x[8 + i], x[12 + i], _MM_SHUFFLE(1, 0, 1, 0));
+        p2 = _mm512_shuffle_i32x4(x[i],     x[4 + i],  _MM_SHUFFLE(3, 2, 3, 2));
+        p3 = _mm512_shuffle_i32x4(x[8 + i], x[12 + i], _MM_SHUFFLE(3, 2, 3, 2));
+
+        v[i]      = _mm512_shuffle_i32x4(p0, p1, _MM_SHUFFLE(2, 0, 2, 0));
+        v[4 + i]  = _mm512_shuffle_i32x4(p0, p1, _MM_SHUFFLE(3, 1, 3, 1));
+        v[8 + i]  = _mm512_shuffle_i32x4(p2, p3, _MM_SHUFFLE(2, 0, 2, 0));
+        v[12 + i] = _mm512_shuffle_i32x4(p2, p3, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void blake3_hash16_avx512(const unsigned char *const *inputs, size_t blocks,
+                                 const ulong32 key[8], ulong64 counter, int increment_counter,
+                                 unsigned char flags, unsigned char flags_start, unsigned char flags_end,
+                                 unsigned char *out)
+{
+    __m512i h[16], v[16], m[16], ctr_lo, ctr_hi;
+    ulong32 lo[16], hi[16];
+    unsigned char block_flags;
+    size_t b, off;
+    int i, j;
+
+    B3_LANE_COUNTERS(lo, hi, 16);
+    ctr_lo = _mm512_loadu_si512((const void *)lo);
+    ctr_hi = _mm512_loadu_si512((const void *)hi);
+
+    for (i = 0; i < 8; i++) {
+        h[i] = _mm512_set1_epi32((int)key[i]);
+    }
+
+    for (b = 0; b < blocks; b++) {
+        B3_LANE_FLAGS();
+        off = b * BLAKE3_BLOCK_LEN;
+
+        for (j = 0; j < 16; j++) {
+            m[j] = _mm512_loadu_si512((const void *)(inputs[j] + off));
+        }
+        blake3_transpose16_avx512(m);
+
+        for (i = 0; i < 8; i++) {
+            v[i] = h[i];
+        }
+        v[ 8] = _mm512_set1_epi32((int)blake3_IV[0]);
+        v[ 9] = _mm512_set1_epi32((int)blake3_IV[1]);
+        v[10] = _mm512_set1_epi32((int)blake3_IV[2]);
+        v[11] = _mm512_set1_epi32((int)blake3_IV[3]);
+        v[12] = ctr_lo;
+        v[13] = ctr_hi;
+        v[14] = _mm512_set1_epi32(BLAKE3_BLOCK_LEN);
+        v[15] = _mm512_set1_epi32(block_flags);
+
+        B3_ROUNDS(v, m)
+
+        for (i = 0; i < 8; i++) {
+            h[i] = XOR(v[i], v[i + 8]);
+        }
+    }
+
+    /* 8 words of 16 lanes, the transpose leaves lane j's words in the low half of h[j] */
+    for (i = 8; i < 16; i++) {
+        h[i] = _mm512_setzero_si512();
+    }
+    blake3_transpose16_avx512(h);
+    for (j = 0; j < 16; j++) {
+        _mm256_storeu_si256((__m256i *)(out + j * BLAKE3_OUT_LEN), _mm512_castsi512_si256(h[j]));
+    }
+}
+
+#undef ADD
+#undef XOR
+#undef ROTR16
+#undef ROTR12
+#undef ROTR8
+#undef ROTR7
+
+static void blake3_hash_many_sse41(const unsigned char *const *inputs, size_t num_inputs, size_t blocks,
+                                   const ulong32 key[8], ulong64 counter, int increment_counter,
+                                   unsigned char flags, unsigned char flags_start, unsigned char flags_end,
+                                   unsigned char *out)
+{
+    for (; num_inputs >= 4; num_inputs -= 4, inputs += 4, out += 4 * BLAKE3_OUT_LEN) {
+        blake3_hash4_sse41(inputs, blocks, key, counter, increment_counter, flags, flags_start, flags_end, out);
+        if (increment_counter) {
+            counter += 4;
+        }
+    }
+    blake3_hash_many_c(inputs, num_inputs, blocks, key, counter, increment_counter, flags, flags_start, flags_end, out);
+}
+
+static void blake3_hash_many_avx2(const unsigned char *const *inputs, size_t num_inputs, size_t blocks,
+                                  const ulong32 key[8], ulong64 counter, int increment_counter,
+                                  unsigned char flags, unsigned char flags_start, unsigned char flags_end,
+                                  unsigned char *out)
+{
+    for (; num_inputs >= 8; num_inputs -= 8, inputs += 8, out += 8 * BLAKE3_OUT_LEN) {
+        blake3_hash8_avx2(inputs, blocks, key, counter, increment_counter, flags, flags_start, flags_end, out);
+        if (increment_counter) {
+            counter += 8;
+        }
+    }
+    blake3_hash_many_sse41(inputs, num_inputs, blocks, key, counter, increment_counter, flags, flags_start, flags_end, out);
+}
+
+static void blake3_hash_many_avx512(const unsigned char *const *inputs, size_t num_inputs, size_t blocks,
+                                    const ulong32 key[8], ulong64 counter, int increment_counter,
+                                    unsigned char flags, unsigned char flags_start, unsigned char flags_end,
+                                    unsigned char *out)
+{
+    for (; num_inputs >= 16; num_inputs -= 16, inputs += 16, out += 16 * BLAKE3_OUT_LEN) {
+        blake3_hash16_avx512(inputs, blocks, key, counter, increment_counter, flags, flags_start, flags_end, out);
+        if (increment_counter) {
+            counter += 16;
+        }
+    }
+    blake3_hash_many_avx2(inputs, num_inputs, blocks, key, counter, increment_counter, flags, flags_start, flags_end, out);
+}
+
+#undef B3_SHUFFLE_PS
+#undef B3_LANE_COUNTERS
+#undef B3_LANE_FLAGS
+
+#endif /* LTC_X86_SIMD */
+
+static blake3_hash_many_fn blake3_hash_many = blake3_hash_many_c;
+static size_t blake3_simd_degree = 1;
+static int blake3_backend = LTC_BLAKE3_BACKEND_C;
+static int blake3_threads = 1;
+
+/**
+   Select the compress functions used by blake3
+   @param backend  LTC_BLAKE3_BACKEND_C, _SSE41, _AVX2 or _AVX512
+   @return CRYPT_OK if successful, CRYPT_INVALID_ARG if the backend is not built in
+*/
+int blake3_set_backend(int backend)
+{
+    switch (backend) {
+       case LTC_BLAKE3_BACKEND_C:
+          blake3_compress_in_place = blake3_compress_in_place_c;
+          blake3_compress_xof = blake3_compress_xof_c;
+          blake3_hash_many = blake3_hash_many_c;
+          blake3_simd_degree = 1;
+          break;
+#ifdef LTC_X86_SIMD
+       case LTC_BLAKE3_BACKEND_SSE41:
+          blake3_compress_in_place = blake3_compress_in_place_sse41;
+          blake3_compress_xof = blake3_compress_xof_sse41;
+          blake3_hash_many = blake3_hash_many_sse41;
+          blake3_simd_degree = 4;
+          break;
+       case LTC_BLAKE3_BACKEND_AVX2:
+          blake3_compress_in_place = blake3_compress_in_place_sse41;
+          blake3_compress_xof = blake3_compress_xof_sse41;
+          blake3_hash_many = blake3_hash_many_avx2;
+          blake3_simd_degree = 8;
+          break;
+       case LTC_BLAKE3_BACKEND_AVX512:
+          blake3_compress_in_place = blake3_compress_in_place_sse41;
+          blake3_compress_xof = blake3_compress_xof_sse41;
+          blake3_hash_many = blake3_hash_many_avx512;
+          blake3_simd_degree = 16;
+          break;
+#endif
+       default:
+          return CRYPT_INVALID_ARG;
+    }
+    blake3_backend = backend;
+    return CRYPT_OK;
+}
+
+/**
+   @return the LTC_BLAKE3_BACKEND_xxx in use
+*/
+int blake3_get_backend(void)
+{
+    return blake3_backend;
+}
+
+/**
+   Set how many threads a large blake3_process() call may use
+   @param threads  1 or more, 1 hashes everything on the calling thread
+   @return CRYPT_OK if successful
+*/
+int blake3_set_threads(int threads)
+{
+    if (threads < 1) {
+       return CRYPT_INVALID_ARG;
+    }
+#ifdef LTC_BLAKE3_THREADS
+    blake3_threads = threads;
+#endif
+    return CRYPT_OK;
+}
+
+/* the inputs to the compression of a node that is not compressed yet,
+   it is either a chaining value or, for the root, the start of the output */
+typedef struct {
+    ulong32 input_cv[8];
+    unsigned char block[BLAKE3_BLOCK_LEN];
+    unsigned char block_len;
+    ulong64 counter;
+    unsigned char flags;
+} blake3_output;
+
+static void blake3_make_output(blake3_output *o, const ulong32 cv[8], const unsigned char *block,
+                               unsigned char block_len, ulong64 counter, unsigned char flags)
+{
+    XMEMCPY(o->input_cv, cv, sizeof(o->input_cv));
+    XMEMCPY(o->block, block, BLAKE3_BLOCK_LEN);
+    o->block_len = block_len;
+    o->counter = counter;
+    o->flags = flags;
+}
+
+static void blake3_output_cv(const blake3_output *o, unsigned char out[BLAKE3_OUT_LEN])
+{
+    ulong32 cv[8];
+    int i;
+
+    XMEMCPY(cv, o->input_cv, sizeof(cv));
+    blake3_compress_in_place(cv, o->block, o->block_len, o->counter, o->flags);
+    for (i = 0; i < 8; i++) {
+        STORE32L(cv[i], out + 4 * i);
+    }
+}
+
+static void blake3_output_root(const blake3_output *o, ulong64 seek, unsigned char *out, unsigned long outlen)
+{
+    unsigned char wide[64];
+    ulong64 block = seek / 64;
+    unsigned long offset = (unsigned long)(seek % 64), n;
+
+    while (outlen > 0) {
+        blake3_compress_xof(o->input_cv, o->block, o->block_len, block, o->flags | B3_ROOT, wide);
+        n = MIN(outlen, 64 - offset);
+        XMEMCPY(out, wide + offset, n);
+        out += n;
+        outlen -= n;
+        block++;
+        offset = 0;
+    }
+    zeromem(wide, sizeof(wide));
+}
+
+static void blake3_parent_output(blake3_output *o, const unsigned char block[BLAKE3_BLOCK_LEN],
+                                 const ulong32 key[8], unsigned char flags)
+{
+    blake3_make_output(o, key, block, BLAKE3_BLOCK_LEN, 0, flags | B3_PARENT);
+}
+
+/* chunk state */
+
+static void blake3_chunk_init(struct blake3_chunk_state *cs, const ulong32 key[8], ulong64 counter, unsigned char flags)
+{
+    XMEMCPY(cs->cv, key, sizeof(cs->cv));
+    cs->chunk_counter = counter;
+    zeromem(cs->buf, sizeof(cs->buf));
+    cs->buf_len = 0;
+    cs->blocks_compressed = 0;
+    cs->flags = flags;
+}
+
+static size_t blake3_chunk_len(const struct blake3_chunk_state *cs)
+{
+    return BLAKE3_BLOCK_LEN * (size_t)cs->blocks_compressed + cs->buf_len;
+}
+
+static unsigned char blake3_chunk_start_flag(const struct blake3_chunk_state *cs)
+{
+    return cs->blocks_compressed == 0 ? B3_CHUNK_START : 0;
+}
+
+static size_t blake3_chunk_fill_buf(struct blake3_chunk_state *cs, const unsigned char *in, size_t inlen)
+{
+    size_t take = MIN(inlen, (size_t)(BLAKE3_BLOCK_LEN - cs->buf_len));
+
+    XMEMCPY(cs->buf + cs->buf_len, in, take);
+    cs->buf_len += (unsigned char)take;
+    return take;
+}
+
+/* the last block of a chunk stays buffered, it is compressed with CHUNK_END by the output */
+static void blake3_chunk_update(struct blake3_chunk_state *cs, const unsigned char *in, size_t inlen)
+{
+    size_t take;
+
+    if (cs->buf_len > 0) {
+        take = blake3_chunk_fill_buf(cs, in, inlen);
+        in += take;
+        inlen -= take;
+        if (inlen > 0) {
+            blake3_compress_in_place(cs->cv, cs->buf, BLAKE3_BLOCK_LEN, cs->chunk_counter,
+                                     cs->flags | blake3_chunk_start_flag(cs));
+            cs->blocks_compressed++;
+            cs->buf_len = 0;
+            zeromem(cs->buf, sizeof(cs->buf));
+        }
+    }
+
+    while (inlen > BLAKE3_BLOCK_LEN) {
+        blake3_compress_in_place(cs->cv, in, BLAKE3_BLOCK_LEN, cs->chunk_counter,
+                                 cs->flags | blake3_chunk_start_flag(cs));
+        cs->blocks_compressed++;
+        in += BLAKE3_BLOCK_LEN;
+        inlen -= BLAKE3_BLOCK_LEN;
+    }
+
+    blake3_chunk_fill_buf(cs, in, inlen);
+}
+
+static void blake3_chunk_output(const struct blake3_chunk_state *cs, blake3_output *o)
+{
+    blake3_make_output(o, cs->cv, cs->buf, cs->buf_len, cs->chunk_counter,
+                       cs->flags | blake3_chunk_start_flag(cs) | B3_CHUNK_END);
+}
+
+/* subtrees */
+
+static ulong64 blake3_round_down_pow2(ulong64 x)
+{
+    ulong64 p = 1;
+
+    while (p <= x / 2) {
+        p <<= 1;
+    }
+    return p;
+}
+
+static unsigned blake3_popcount(ulong64 x)
+{
+    unsigned n = 0;
+
+    for (; x; x &= x - 1) {
+        n++;
+    }
+    return n;
+}
+
+/* the largest power of 2 number of chunks that leaves at least one byte on the right */
+static size_t blake3_left_len(size_t content_len)
+{
+    size_t full_chunks = (content_len - 1) / BLAKE3_CHUNK_LEN;
+
+    return (size_t)blake3_round_down_pow2(full_chunks) * BLAKE3_CHUNK_LEN;
+}
+
+static size_t blake3_compress_chunks_parallel(const unsigned char *in, size_t inlen, const ulong32 key[8],
+                                              ulong64 chunk_counter, unsigned char flags, unsigned char *out)
+{
+    const unsigned char *chunks[B3_MAX_SIMD_DEGREE];
+    struct blake3_chunk_state cs;
+    blake3_output o;
+    size_t n = 0, pos = 0;
+
+    while (inlen - pos >= BLAKE3_CHUNK_LEN) {
+        chunks[n++] = in + pos;
+        pos += BLAKE3_CHUNK_LEN;
+    }
+
+    blake3_hash_many(chunks, n, BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN, key, chunk_counter, 1,
+                     flags, B3_CHUNK_START, B3_CHUNK_END, out);
+
+    /* a partial chunk at the end */
+    if (inlen > pos) {
+        blake3_chunk_init(&cs, key, chunk_counter + n, flags);
+        blake3_chunk_update(&cs, in + pos, inlen - pos);
+        blake3_chunk_output(&cs, &o);
+        blake3_output_cv(&o, out + n * BLAKE3_OUT_LEN);
+        return n + 1;
+    }
+    return n;
+}
+
+static size_t blake3_compress_parents_parallel(const unsigned char *cvs, size_t num_cvs, const ulong32 key[8],
+                                               unsigned char flags, unsigned char *out)
+{
+    const unsigned char *parents[B3_MAX_SIMD_DEGREE];
+    size_t n = 0;
+
+    while (num_cvs - 2 * n >= 2) {
+        parents[n] = cvs + 2 * n * BLAKE3_OUT_LEN;
+        n++;
+    }
+
+    blake3_hash_many(parents, n, 1, key, 0, 0, flags | B3_PARENT, 0, 0, out);
+
+    /* an odd one left over moves up unchanged */
+    if (num_cvs > 2 * n) {
+        XMEMCPY(out + n * BLAKE3_OUT_LEN, cvs + 2 * n * BLAKE3_OUT_LEN, BLAKE3_OUT_LEN);
+        return n + 1;
+    }
+    return n;
+}
+
+static size_t blake3_compress_subtree_wide(const unsigned char *in, size_t inlen, const ulong32 key[8],
+                                           ulong64 chunk_counter, unsigned char flags, unsigned char *out,
+                                           int threads);
+
+#ifdef LTC_BLAKE3_THREADS
+
+typedef struct {
+    const unsigned char *in;
+    size_t inlen;
+    const ulong32 *key;
+    ulong64 chunk_counter;
+    unsigned char flags;
+    unsigned char *out;
+    int threads;
+    size_t num_cvs;
+} blake3_subtree_job;
+
+static void *blake3_subtree_thread(void *arg)
+{
+    blake3_subtree_job *job = arg;
+
+    job->num_cvs = blake3_compress_subtree_wide(job->in, job->inlen, job->key, job->chunk_counter,
+                                                job->flags, job->out, job->threads);
+    return NULL;
+}
+
+#endif
+
+/* hash a subtree into as many chaining values as the SIMD degree, at least 2.
+   The left and right halves are independent, so big ones go to separate threads */
+static size_t blake3_compress_subtree_wide(const unsigned char *in, size_t inlen, const ulong32 key[8],
+                                           ulong64 chunk_counter, unsigned char flags, unsigned char *out,
+                                           int threads)
+{
+    unsigned char cv_array[2 * B3_MAX_SIMD_DEGREE * BLAKE3_OUT_LEN];
+    size_t left_len, right_len, left_n = 0, right_n = 0, degree;
+    ulong64 right_counter;
+    unsigned char *right_cvs;
+    int done = 0;
+
+    if (inlen <= blake3_simd_degree * BLAKE3_CHUNK_LEN) {
+        return blake3_compress_chunks_parallel(in, inlen, key, chunk_counter, flags, out);
+    }
+
+    left_len = blake3_left_len(inlen);
+    right_len = inlen - left_len;
+    right_counter = chunk_counter + left_len / BLAKE3_CHUNK_LEN;
+
+    /* the portable backend still needs 2 results per side */
+    degree = blake3_simd_degree;
+    if (left_len > BLAKE3_CHUNK_LEN && degree == 1) {
+        degree = 2;
+    }
+    right_cvs = cv_array + degree * BLAKE3_OUT_LEN;
+
+#ifdef LTC_BLAKE3_THREADS
+    if (threads > 1 && right_len >= B3_THREAD_MIN) {
+        blake3_subtree_job job;
+        pthread_t thread;
+
+        job.in = in;
+        job.inlen = left_len;
+        job.key = key;
+        job.chunk_counter = chunk_counter;
+        job.flags = flags;
+        job.out = cv_array;
+        job.threads = threads / 2;
+        job.num_cvs = 0;
+
+        if (pthread_create(&thread, NULL, blake3_subtree_thread, &job) == 0) {
+            right_n = blake3_compress_subtree_wide(in + left_len, right_len, key, right_counter, flags,
+                                                   right_cvs, threads - threads / 2);
+            pthread_join(thread, NULL);
+            left_n = job.num_cvs;
+            done = 1;
+        }
+    }
+#endif
+
+    if (!done) {
+        left_n = blake3_compress_subtree_wide(in, left_len, key, chunk_counter, flags, cv_array, threads);
+        right_n = blake3_compress_subtree_wide(in + left_len, right_len, key, right_counter, flags, right_cvs, threads);
+    }
+
+    /* two chunks of output from the portable backend are already a pair */
+    if (left_n == 1) {
+        XMEMCPY(out, cv_array, 2 * BLAKE3_OUT_LEN);
+        return 2;
+    }
+
+    return blake3_compress_parents_parallel(cv_array, left_n + right_n, key, flags, out);
+}
+
+/* reduce a power of 2 subtree of at least 2 chunks to the two chaining values under its root */
+static void blake3_compress_subtree_to_parent(const unsigned char *in, size_t inlen, const ulong32 key[8],
+                                              ulong64 chunk_counter, unsigned char flags,
+                                              unsigned char out[2 * BLAKE3_OUT_LEN])
+{
+    unsigned char cv_array[B3_MAX_SIMD_DEGREE * BLAKE3_OUT_LEN];
+    unsigned char out_array[B3_MAX_SIMD_DEGREE * BLAKE3_OUT_LEN / 2];
+    size_t num_cvs;
+
+    num_cvs = blake3_compress_subtree_wide(in, inlen, key, chunk_counter, flags, cv_array, blake3_threads);
+
+    while (num_cvs > 2) {
+        num_cvs = blake3_compress_parents_parallel(cv_array, num_cvs, key, flags, out_array);
+        XMEMCPY(cv_array, out_array, num_cvs * BLAKE3_OUT_LEN);
+    }
+    XMEMCPY(out, cv_array, 2 * BLAKE3_OUT_LEN);
+}
+
+/* hasher */
+
+/* merge completed subtrees on the stack, total_len is in chunks */
+static void blake3_merge_cv_stack(struct blake3_state *self, ulong64 total_len)
+{
+    unsigned post_merge_len = blake3_popcount(total_len);
+    unsigned char *parent;
+    blake3_output o;
+
+    while (self->cv_stack_len > post_merge_len) {
+        parent = self->cv_stack + (self->cv_stack_len - 2) * BLAKE3_OUT_LEN;
+        blake3_parent_output(&o, parent, self->key, self->chunk.flags);
+        blake3_output_cv(&o, parent);
+        self->cv_stack_len--;
+    }
+}
+
+/* a new chaining value is pushed lazily, the stack is only merged once more
+   input shows the previous subtrees are not on the right edge */
+static void blake3_push_cv(struct blake3_state *self, const unsigned char cv[BLAKE3_OUT_LEN], ulong64 chunk_counter)
+{
+    blake3_merge_cv_stack(self, chunk_counter);
+    XMEMCPY(self->cv_stack + self->cv_stack_len * BLAKE3_OUT_LEN, cv, BLAKE3_OUT_LEN);
+    self->cv_stack_len++;
+}
+
+/**
+   Initialize the hash state.  The state is allocated here and released by
+   blake3_done(), or by blake3_free() for a hash that is never finished
+   @param md   The hash state you wish to initialize
+   @return CRYPT_OK if successful
+*/
+int blake3_init(hash_state * md)
+{
+    LTC_ARGCHK(md != NULL);
+
+    md->blake3 = XCALLOC(1, sizeof(struct blake3_state));
+    if (md->blake3 == NULL) {
+       return CRYPT_MEM;
+    }
+    XMEMCPY(md->blake3->key, blake3_IV, sizeof(md->blake3->key));
+    blake3_chunk_init(&md->blake3->chunk, blake3_IV, 0, 0);
+    md->blake3->outlen = BLAKE3_OUT_LEN;
+    md->blake3->cv_stack_len = 0;
+    return CRYPT_OK;
+}
+
+/**
+   Release the state of a hash without producing the digest
+   @param md   The hash state, may already be released
+*/
+void blake3_free(hash_state * md)
+{
+    if (md == NULL || md->blake3 == NULL) {
+       return;
+    }
+    zeromem(md->blake3, sizeof(struct blake3_state));
+    XFREE(md->blake3);
+    md->blake3 = NULL;
+}
+
+/**
+   Set the number of bytes blake3_done() produces
+   @param md      The hash state
+   @param outlen  The digest length in octets, 32 by default
+   @return CRYPT_OK if successful
+*/
+int blake3_set_outlen(hash_state * md, unsigned long outlen)
+{
+    LTC_ARGCHK(md != NULL);
+
+    /* already finished with blake3_done */
+    if (md->blake3 == NULL || outlen == 0) {
+       return CRYPT_INVALID_ARG;
+    }
+    md->blake3->outlen = outlen;
+    return CRYPT_OK;
+}
+
+/**
+   Process a block of memory though the hash
+   @param md     The hash state
+   @param in     The data to hash
+   @param inlen  The length of the data (octets)
+   @return CRYPT_OK if successful
+*/
+int blake3_process(hash_state * md, const unsigned char *in, unsigned long inlen)
+{
+    struct blake3_state *self;
+    struct blake3_chunk_state cs;
+    unsigned char cv[2 * BLAKE3_OUT_LEN];
+    blake3_output o;
+    size_t take, subtree_len;
+    ulong64 count_so_far, subtree_chunks;
+
+    LTC_ARGCHK(md != NULL);
+    LTC_ARGCHK(in != NULL || inlen == 0);
+
+    if (md->blake3 == NULL) {
+       return CRYPT_INVALID_ARG;
+    }
+    self = md->blake3;
+    if (inlen == 0) {
+       return CRYPT_OK;
+    }
+
+    /* finish a partial chunk first */
+    if (blake3_chunk_len(&self->chunk) > 0) {
+        take = MIN((size_t)inlen, BLAKE3_CHUNK_LEN - blake3_chunk_len(&self->chunk));
+        blake3_chunk_update(&self->chunk, in, take);
+        in += take;
+        inlen -= take;
+        if (inlen == 0) {
+           return CRYPT_OK;
+        }
+        /* more input follows, so this chunk is not the root */
+        blake3_chunk_output(&self->chunk, &o);
+        blake3_output_cv(&o, cv);
+        blake3_push_cv(self, cv, self->chunk.chunk_counter);
+        blake3_chunk_init(&self->chunk, self->key, self->chunk.chunk_counter + 1, self->chunk.flags);
+    }
+
+    /* hash the largest whole subtrees we can.  A subtree is a power of 2 number
+       of chunks and must evenly divide the chunks so far */
+    while (inlen > BLAKE3_CHUNK_LEN) {
+        subtree_len = (size_t)blake3_round_down_pow2(inlen);
+        count_so_far = self->chunk.chunk_counter * BLAKE3_CHUNK_LEN;
+        while ((((ulong64)(subtree_len - 1)) & count_so_far) != 0) {
+            subtree_len /= 2;
+        }
+        subtree_chunks = subtree_len / BLAKE3_CHUNK_LEN;
+
+        if (subtree_len <= BLAKE3_CHUNK_LEN) {
+            blake3_chunk_init(&cs, self->key, self->chunk.chunk_counter, self->chunk.flags);
+            blake3_chunk_update(&cs, in, subtree_len);
+            blake3_chunk_output(&cs, &o);
+            blake3_output_cv(&o, cv);
+            blake3_push_cv(self, cv, cs.chunk_counter);
+        } else {
+            blake3_compress_subtree_to_parent(in, subtree_len, self->key, self->chunk.chunk_counter,
+                                              self->chunk.flags, cv);
+            blake3_push_cv(self, cv, self->chunk.chunk_counter);
+            blake3_push_cv(self, cv + BLAKE3_OUT_LEN, self->chunk.chunk_counter + subtree_chunks / 2);
+        }
+        self->chunk.chunk_counter += subtree_chunks;
+        in += subtree_len;
+        inlen -= subtree_len;
+    }
+
+    if (inlen > 0) {
+        blake3_chunk_update(&self->chunk, in, inlen);
+        blake3_merge_cv_stack(self, self->chunk.chunk_counter);
+    }
+
+#ifdef LTC_CLEAN_STACK
+    zeromem(cv, sizeof(cv));
+    zeromem(&cs, sizeof(cs));
+#endif
+    return CRYPT_OK;
+}
+
+/**
+   Extendable output, the hash state is not changed so more can be read or hashed
+   @param md      The hash state
+   @param seek    Offset in the output stream to start at
+   @param out     [out] The destination
+   @param outlen  The number of octets to produce
+   @return CRYPT_OK if successful
+*/
+int blake3_xof(hash_state * md, ulong64 seek, unsigned char *out, unsigned long outlen)
+{
+    struct blake3_state *self;
+    unsigned char parent[BLAKE3_BLOCK_LEN];
+    blake3_output o;
+    size_t remaining;
+
+    LTC_ARGCHK(md  != NULL);
+    LTC_ARGCHK(out != NULL);
+
+    if (md->blake3 == NULL) {
+       return CRYPT_INVALID_ARG;
+    }
+    self = md->blake3;
+    if (outlen == 0) {
+       return CRYPT_OK;
+    }
+
+    /* a single chunk is the root */
+    if (self->cv_stack_len == 0) {
+        blake3_chunk_output(&self->chunk, &o);
+        blake3_output_root(&o, seek, out, outlen);
+        return CRYPT_OK;
+    }
+
+    /* roll the current chunk, or the top two stack entries, up the right edge */
+    if (blake3_chunk_len(&self->chunk) > 0) {
+        remaining = self->cv_stack_len;
+        blake3_chunk_output(&self->chunk, &o);
+    } else {
+        remaining = self->cv_stack_len - 2;
+        blake3_parent_output(&o, self->cv_stack + remaining * BLAKE3_OUT_LEN, self->key, self->chunk.flags);
+    }
+    while (remaining > 0) {
+        remaining--;
+        XMEMCPY(parent, self->cv_stack + remaining * BLAKE3_OUT_LEN, BLAKE3_OUT_LEN);
+        blake3_output_cv(&o, parent + BLAKE3_OUT_LEN);
+        blake3_parent_output(&o, parent, self->key, self->chunk.flags);
+    }
+    blake3_output_root(&o, seek, out, outlen);
+
+#ifdef LTC_CLEAN_STACK
+    zeromem(parent, sizeof(parent));
+    zeromem(&o, sizeof(o));
+#endif
+    return CRYPT_OK;
+}
+
+/**
+   Terminate the hash to get the digest
+   @param md  The hash state, released afterwards
+   @param out [out] The destination of the hash (32 bytes, or the length set with blake3_set_outlen)
+   @return CRYPT_OK if successful
+*/
+int blake3_done(hash_state * md, unsigned char *out)
+{
+    int err;
+
+    LTC_ARGCHK(md  != NULL);
+    LTC_ARGCHK(out != NULL);
+
+    if (md->blake3 == NULL) {
+       return CRYPT_INVALID_ARG;
+    }
+    err = blake3_xof(md, 0, out, md->blake3->outlen);
+    blake3_free(md);
+    return err;
+}
+
+/**
+  Self-test the hash
+  @return CRYPT_OK if successful, CRYPT_NOP if self-tests have been disabled
+*/
+int  blake3_test(void)
+{
+ #ifndef LTC_TEST
+    return CRYPT_NOP;
+ #else
+  /* input is i % 251 for i = 0 .. len - 1 */
+  static const struct {
+      unsigned long len;
+      unsigned char hash[32];
+  } tests[] = {
+    { 0,
+      { 0xaf, 0x13, 0x49, 0xb9, 0xf5, 0xf9, 0xa1, 0xa6,
+        0xa0, 0x40, 0x4d, 0xea, 0x36, 0xdc, 0xc9, 0x49,
+        0x9b, 0xcb, 0x25, 0xc9, 0xad, 0xc1, 0x12, 0xb7,
+        0xcc, 0x9a, 0x93, 0xca, 0xe4, 0x1f, 0x32, 0x62 }
+    },
+    { 1025,
+      { 0xd0, 0x02, 0x78, 0xae, 0x47, 0xeb, 0x27, 0xb3,
+        0x4f, 0xae, 0xcf, 0x67, 0xb4, 0xfe, 0x26, 0x3f,
+        0x82, 0xd5, 0x41, 0x29, 0x16, 0xc1, 0xff, 0xd9,
+        0x7c, 0x8c, 0xb7, 0xfb, 0x81, 0x4b, 0x84, 0x44 }
+    },
+    { 17409,
+      { 0x50, 0xbc, 0x54, 0x23, 0x8a, 0xc9, 0x27, 0x1c,
+        0x9f, 0x34, 0x71, 0xf5, 0x20, 0x6a, 0x04, 0xeb,
+        0x25, 0xd2, 0xe2, 0x6b, 0x32, 0x14, 0xed, 0x97,
+        0x1c, 0xc5, 0x52, 0x30, 0xb0, 0xd2, 0x28, 0x64 }
+    },
+  };
+
+  /* 131 octets of output for the 1025 octet input */
+  static const unsigned char xof[131] = {
+        0xd0, 0x02, 0x78, 0xae, 0x47, 0xeb, 0x27, 0xb3,
+        0x4f, 0xae, 0xcf, 0x67, 0xb4, 0xfe, 0x26, 0x3f,
+        0x82, 0xd5, 0x41, 0x29, 0x16, 0xc1, 0xff, 0xd9,
+        0x7c, 0x8c, 0xb7, 0xfb, 0x81, 0x4b, 0x84, 0x44,
+        0xf4, 0xc4, 0xa2, 0x2b, 0x4b, 0x39, 0x91, 0x55,
+        0x35, 0x8a, 0x99, 0x4e, 0x52, 0xbf, 0x25, 0x5d,
+        0xe6, 0x00, 0x35, 0x74, 0x2e, 0xc7, 0x1b, 0xd0,
+        0x8a, 0xc2, 0x75, 0xa1, 0xb5, 0x1c, 0xc6, 0xbf,
+        0xe3, 0x32, 0xb0, 0xef, 0x84, 0xb4, 0x09, 0x10,
+        0x8c, 0xda, 0x08, 0x0e, 0x62, 0x69, 0xed, 0x4b,
+        0x3e, 0x2c, 0x3f, 0x7d, 0x72, 0x2a, 0xa4, 0xcd,
+        0xc9, 0x8d, 0x16, 0xde, 0xb5, 0x54, 0xe5, 0x62,
+        0x7b, 0xe8, 0xf9, 0x55, 0xc9, 0x8e, 0x1d, 0x5f,
+        0x95, 0x65, 0xa9, 0x19, 0x4c, 0xad, 0x0c, 0x42,
+        0x85, 0xf9, 0x37, 0x00, 0x06, 0x2d, 0x95, 0x95,
+        0xad, 0xb9, 0x92, 0xae, 0x68, 0xff, 0x12, 0x80,
+        0x0a, 0xb6, 0x7a
+  };
+
+  int i, err = CRYPT_OK;
+  unsigned long j;
+  unsigned char tmp[131], *buf;
+  hash_state md;
+
+  buf = XMALLOC(17409);
+  if (buf == NULL) {
+     return CRYPT_MEM;
+  }
+  for (j = 0; j < 17409; j++) {
+      buf[j] = (unsigned char)(j % 251);
+  }
+
+  for (i = 0; i < (int)(sizeof(tests) / sizeof(tests[0])); i++) {
+      if ((err = blake3_init(&md)) != CRYPT_OK) {
+         goto done;
+      }
+      blake3_process(&md, buf, tests[i].len);
+      blake3_done(&md, tmp);
+      if (XMEMCMP(tmp, tests[i].hash, 32) != 0) {
+         err = CRYPT_FAIL_TESTVECTOR;
+         goto done;
+      }
+  }
+
+  if ((err = blake3_init(&md)) != CRYPT_OK) {
+     goto done;
+  }
+  blake3_process(&md, buf, 1025);
+  blake3_xof(&md, 0, tmp, sizeof(xof));
+  blake3_free(&md);
+  if (XMEMCMP(tmp, xof, sizeof(xof)) != 0) {
+     err = CRYPT_FAIL_TESTVECTOR;
+  }
+
+done:
+  XFREE(buf);
+  return err;
+ #endif
+}
+
+#endif
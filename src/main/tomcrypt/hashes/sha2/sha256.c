@@ -11,6 +11,10 @@
 #include "tomcrypt.h"
 #pragma clang diagnostic ignored "-Wconversion"
 
+#ifdef LTC_X86_SIMD
+#include <immintrin.h>
+#endif
+
 /**
   @file sha256.c
   LTC_SHA256 by Tom St Denis 
@@ -36,7 +40,7 @@ const struct ltc_hash_descriptor sha256_desc =
     NULL
 };
 
-#ifdef LTC_SMALL_CODE
+#if defined(LTC_SMALL_CODE) || defined(LTC_X86_SIMD)
 /* the K array */
 static const ulong32 K[64] = {
     0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL,
@@ -69,7 +73,7 @@ static const ulong32 K[64] = {
 #ifdef LTC_CLEAN_STACK
 static int _sha256_compress(hash_state * md, unsigned char *buf)
 #else
-static int  sha256_compress(hash_state * md, unsigned char *buf)
+static int  sha256_compress_c(hash_state * md, unsigned char *buf)
 #endif
 {
     ulong32 S[8], W[64], t0, t1;
@@ -190,7 +194,7 @@ static int  sha256_compress(hash_state * md, unsigned char *buf)
 }
 
 #ifdef LTC_CLEAN_STACK
-static int sha256_compress(hash_state * md, unsigned char *buf)
+static int sha256_compress_c(hash_state * md, unsigned char *buf)
 {
     int err;
     err = _sha256_compress(md, buf);
@@ -199,6 +203,120 @@ static int sha256_compress(hash_state * md, unsigned char *buf)
 }
 #endif
 
+#ifdef LTC_X86_SIMD
+/* compress 512-bits with the SHA extensions.  The state is kept as ABEF/CDGH
+   pairs while the rounds run, each sha256rnds2 does two rounds. */
+
+/* 4 rounds on message words Wc */
+#define SHANI_RND4(i, Wc)                                                       \
+    MSG    = _mm_add_epi32(Wc, _mm_loadu_si128((const __m128i *)(K + 4*(i))));  \
+    STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);                        \
+    MSG    = _mm_shuffle_epi32(MSG, 0x0E);                                      \
+    STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+
+/* finish W[i+4..i+7] in Wn using Wc and the previous group Wp */
+#define SHANI_MSG2(Wc, Wp, Wn)                                                  \
+    Wn = _mm_add_epi32(Wn, _mm_alignr_epi8(Wc, Wp, 4));                         \
+    Wn = _mm_sha256msg2_epu32(Wn, Wc);
+
+/* start the next schedule group in Wp */
+#define SHANI_MSG1(Wc, Wp)                                                      \
+    Wp = _mm_sha256msg1_epu32(Wp, Wc);
+
+__attribute__((target("sha,sse4.1")))
+static int sha256_compress_shani(hash_state * md, unsigned char *buf)
+{
+    const __m128i MASK = _mm_set_epi64x(CONST64(0x0c0d0e0f08090a0b), CONST64(0x0405060700010203));
+    __m128i STATE0, STATE1, ABEF, CDGH, MSG, TMP;
+    __m128i W0, W1, W2, W3;
+
+    TMP    = _mm_loadu_si128((const __m128i *)&md->sha256.state[0]);
+    STATE1 = _mm_loadu_si128((const __m128i *)&md->sha256.state[4]);
+
+    TMP    = _mm_shuffle_epi32(TMP, 0xB1);            /* CDAB */
+    STATE1 = _mm_shuffle_epi32(STATE1, 0x1B);         /* EFGH */
+    STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);         /* ABEF */
+    STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);      /* CDGH */
+
+    ABEF = STATE0;
+    CDGH = STATE1;
+
+    W0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf +  0)), MASK);
+    W1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 16)), MASK);
+    W2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 32)), MASK);
+    W3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 48)), MASK);
+
+    SHANI_RND4( 0, W0);
+    SHANI_RND4( 1, W1); SHANI_MSG1(W1, W0);
+    SHANI_RND4( 2, W2); SHANI_MSG1(W2, W1);
+    SHANI_RND4( 3, W3); SHANI_MSG2(W3, W2, W0); SHANI_MSG1(W3, W2);
+    SHANI_RND4( 4, W0); SHANI_MSG2(W0, W3, W1); SHANI_MSG1(W0, W3);
+    SHANI_RND4( 5, W1); SHANI_MSG2(W1, W0, W2); SHANI_MSG1(W1, W0);
+    SHANI_RND4( 6, W2); SHANI_MSG2(W2, W1, W3); SHANI_MSG1(W2, W1);
+    SHANI_RND4( 7, W3); SHANI_MSG2(W3, W2, W0); SHANI_MSG1(W3, W2);
+    SHANI_RND4( 8, W0); SHANI_MSG2(W0, W3, W1); SHANI_MSG1(W0, W3);
+    SHANI_RND4( 9, W1); SHANI_MSG2(W1, W0, W2); SHANI_MSG1(W1, W0);
+    SHANI_RND4(10, W2); SHANI_MSG2(W2, W1, W3); SHANI_MSG1(W2, W1);
+    SHANI_RND4(11, W3); SHANI_MSG2(W3, W2, W0); SHANI_MSG1(W3, W2);
+    SHANI_RND4(12, W0); SHANI_MSG2(W0, W3, W1); SHANI_MSG1(W0, W3);
+    SHANI_RND4(13, W1); SHANI_MSG2(W1, W0, W2);
+    SHANI_RND4(14, W2); SHANI_MSG2(W2, W1, W3);
+    SHANI_RND4(15, W3);
+
+    STATE0 = _mm_add_epi32(STATE0, ABEF);
+    STATE1 = _mm_add_epi32(STATE1, CDGH);
+
+    TMP    = _mm_shuffle_epi32(STATE0, 0x1B);         /* FEBA */
+    STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);         /* DCHG */
+    STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0);      /* DCBA */
+    STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);         /* HGFE */
+
+    _mm_storeu_si128((__m128i *)&md->sha256.state[0], STATE0);
+    _mm_storeu_si128((__m128i *)&md->sha256.state[4], STATE1);
+
+    return CRYPT_OK;
+}
+
+#undef SHANI_RND4
+#undef SHANI_MSG2
+#undef SHANI_MSG1
+
+#endif /* LTC_X86_SIMD */
+
+static int (*sha256_compress)(hash_state * md, unsigned char *buf) = sha256_compress_c;
+static int sha256_backend = LTC_SHA_BACKEND_C;
+
+/**
+   Select the compress function used by sha256 and sha224
+   @param backend  LTC_SHA_BACKEND_C or LTC_SHA_BACKEND_SHANI
+   @return CRYPT_OK if successful, CRYPT_INVALID_ARG if the backend is not built in
+*/
+int sha256_set_backend(int backend)
+{
+    switch (backend) {
+       case LTC_SHA_BACKEND_C:
+          sha256_compress = sha256_compress_c;
+          break;
+#ifdef LTC_X86_SIMD
+       case LTC_SHA_BACKEND_SHANI:
+          sha256_compress = sha256_compress_shani;
+          break;
+#endif
+       default:
+          return CRYPT_INVALID_ARG;
+    }
+    sha256_backend = backend;
+    return CRYPT_OK;
+}
+
+/**
+   @return the LTC_SHA_BACKEND_xxx used by sha256 and sha224
+*/
+int sha256_get_backend(void)
+{
+    return sha256_backend;
+}
+
 /**
    Initialize the hash state
    @param md   The hash state you wish to initialize
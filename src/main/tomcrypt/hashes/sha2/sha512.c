@@ -10,6 +10,10 @@
  */
 #include "tomcrypt.h"
 
+#ifdef LTC_X86_SIMD
+#include <immintrin.h>
+#endif
+
 /**
    @param sha512.c
    LTC_SHA512 by Tom St Denis 
@@ -93,7 +97,7 @@ CONST64(0x5fcb6fab3ad6faec), CONST64(0x6c44198c4a475817)
 #ifdef LTC_CLEAN_STACK
 static int _sha512_compress(hash_state * md, unsigned char *buf)
 #else
-static int  sha512_compress(hash_state * md, unsigned char *buf)
+static int  sha512_compress_c(hash_state * md, unsigned char *buf)
 #endif
 {
     ulong64 S[8], W[80], t0, t1;
@@ -158,7 +162,7 @@ static int  sha512_compress(hash_state * md, unsigned char *buf)
 
 /* compress 1024-bits */
 #ifdef LTC_CLEAN_STACK
-static int sha512_compress(hash_state * md, unsigned char *buf)
+static int sha512_compress_c(hash_state * md, unsigned char *buf)
 {
     int err;
     err = _sha512_compress(md, buf);
@@ -167,6 +171,156 @@ static int sha512_compress(hash_state * md, unsigned char *buf)
 }
 #endif
 
+#ifdef LTC_X86_SIMD
+/* compress 1024-bits, the message schedule is kept as four AVX2 registers
+   holding W[i-16..i-1] and expanded four words at a time, interleaved with
+   scalar rounds that use the BMI2 rotates.  W[i+2] and W[i+3] depend on W[i]
+   and W[i+1], so Gamma1 is applied to the low pair first and then again to
+   the freshly computed pair. */
+
+#define AVX_ROR64(x, n)     _mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - (n)))
+#define AVX_Gamma0(x)       _mm256_xor_si256(_mm256_xor_si256(AVX_ROR64(x, 1), AVX_ROR64(x, 8)), _mm256_srli_epi64(x, 7))
+#define AVX_Gamma1(x)       _mm256_xor_si256(_mm256_xor_si256(AVX_ROR64(x, 19), AVX_ROR64(x, 61)), _mm256_srli_epi64(x, 6))
+
+/* { a[1], a[2], a[3], b[0] } */
+#define AVX_SHIFT1(a, b)    _mm256_alignr_epi8(_mm256_permute2x128_si256(a, b, 0x21), a, 8)
+
+/* W[i..i+3] into X0 from X0..X3 = W[i-16..i-1], W[i]+K[i] into WK */
+#define AVX_SCHED(X0, X1, X2, X3, i)                                                \
+    X0 = _mm256_add_epi64(X0, AVX_Gamma0(AVX_SHIFT1(X0, X1)));                      \
+    X0 = _mm256_add_epi64(X0, AVX_SHIFT1(X2, X3));                                  \
+    X0 = _mm256_add_epi64(X0, AVX_Gamma1(_mm256_permute2x128_si256(X3, X3, 0x81))); \
+    X0 = _mm256_add_epi64(X0, AVX_Gamma1(_mm256_permute2x128_si256(X0, X0, 0x08))); \
+    _mm256_store_si256((__m256i *)(WK + (i)), _mm256_add_epi64(X0, _mm256_loadu_si256((const __m256i *)(K + (i)))));
+
+#undef RND
+#define RND(a,b,c,d,e,f,g,h,i)                    \
+     t0 = h + Sigma1(e) + Ch(e, f, g) + WK[i];   \
+     t1 = Sigma0(a) + Maj(a, b, c);              \
+     d += t0;                                    \
+     h  = t0 + t1;
+
+#define RND4_A(i)                                       \
+     RND(S[0],S[1],S[2],S[3],S[4],S[5],S[6],S[7],i+0);  \
+     RND(S[7],S[0],S[1],S[2],S[3],S[4],S[5],S[6],i+1);  \
+     RND(S[6],S[7],S[0],S[1],S[2],S[3],S[4],S[5],i+2);  \
+     RND(S[5],S[6],S[7],S[0],S[1],S[2],S[3],S[4],i+3);
+
+#define RND4_B(i)                                       \
+     RND(S[4],S[5],S[6],S[7],S[0],S[1],S[2],S[3],i+0);  \
+     RND(S[3],S[4],S[5],S[6],S[7],S[0],S[1],S[2],i+1);  \
+     RND(S[2],S[3],S[4],S[5],S[6],S[7],S[0],S[1],i+2);  \
+     RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],i+3);
+
+#ifdef LTC_CLEAN_STACK
+__attribute__((target("avx2,bmi2")))
+static int _sha512_compress_avx2(hash_state * md, unsigned char *buf)
+#else
+__attribute__((target("avx2,bmi2")))
+static int  sha512_compress_avx2(hash_state * md, unsigned char *buf)
+#endif
+{
+    const __m256i MASK = _mm256_set_epi64x(CONST64(0x08090a0b0c0d0e0f), CONST64(0x0001020304050607),
+                                           CONST64(0x08090a0b0c0d0e0f), CONST64(0x0001020304050607));
+    ulong64 S[8], t0, t1;
+    ulong64 WK[80] __attribute__((aligned(32)));
+    __m256i X0, X1, X2, X3;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        S[i] = md->sha512.state[i];
+    }
+
+    X0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(buf +  0)), MASK);
+    X1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(buf + 32)), MASK);
+    X2 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(buf + 64)), MASK);
+    X3 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(buf + 96)), MASK);
+
+    _mm256_store_si256((__m256i *)(WK +  0), _mm256_add_epi64(X0, _mm256_loadu_si256((const __m256i *)(K +  0))));
+    _mm256_store_si256((__m256i *)(WK +  4), _mm256_add_epi64(X1, _mm256_loadu_si256((const __m256i *)(K +  4))));
+    _mm256_store_si256((__m256i *)(WK +  8), _mm256_add_epi64(X2, _mm256_loadu_si256((const __m256i *)(K +  8))));
+    _mm256_store_si256((__m256i *)(WK + 12), _mm256_add_epi64(X3, _mm256_loadu_si256((const __m256i *)(K + 12))));
+
+    /* rounds i..i+15 overlap with the schedule for i+16..i+31 */
+    for (i = 0; i < 64; i += 16) {
+        AVX_SCHED(X0, X1, X2, X3, i + 16);
+        RND4_A(i + 0);
+        AVX_SCHED(X1, X2, X3, X0, i + 20);
+        RND4_B(i + 4);
+        AVX_SCHED(X2, X3, X0, X1, i + 24);
+        RND4_A(i + 8);
+        AVX_SCHED(X3, X0, X1, X2, i + 28);
+        RND4_B(i + 12);
+    }
+
+    RND4_A(64);
+    RND4_B(68);
+    RND4_A(72);
+    RND4_B(76);
+
+    for (i = 0; i < 8; i++) {
+        md->sha512.state[i] = md->sha512.state[i] + S[i];
+    }
+
+    return CRYPT_OK;
+}
+
+#undef RND
+#undef RND4_A
+#undef RND4_B
+#undef AVX_SCHED
+#undef AVX_SHIFT1
+
+#ifdef LTC_CLEAN_STACK
+static int sha512_compress_avx2(hash_state * md, unsigned char *buf)
+{
+    int err;
+    err = _sha512_compress_avx2(md, buf);
+    burn_stack(sizeof(ulong64) * 90 + sizeof(int));
+    return err;
+}
+#endif
+
+#undef AVX_ROR64
+#undef AVX_Gamma0
+#undef AVX_Gamma1
+
+#endif /* LTC_X86_SIMD */
+
+static int (*sha512_compress)(hash_state * md, unsigned char *buf) = sha512_compress_c;
+static int sha512_backend = LTC_SHA_BACKEND_C;
+
+/**
+   Select the compress function used by sha512, sha384 and sha512/256
+   @param backend  LTC_SHA_BACKEND_C or LTC_SHA_BACKEND_AVX2
+   @return CRYPT_OK if successful, CRYPT_INVALID_ARG if the backend is not built in
+*/
+int sha512_set_backend(int backend)
+{
+    switch (backend) {
+       case LTC_SHA_BACKEND_C:
+          sha512_compress = sha512_compress_c;
+          break;
+#ifdef LTC_X86_SIMD
+       case LTC_SHA_BACKEND_AVX2:
+          sha512_compress = sha512_compress_avx2;
+          break;
+#endif
+       default:
+          return CRYPT_INVALID_ARG;
+    }
+    sha512_backend = backend;
+    return CRYPT_OK;
+}
+
+/**
+   @return the LTC_SHA_BACKEND_xxx used by sha512, sha384 and sha512/256
+*/
+int sha512_get_backend(void)
+{
+    return sha512_backend;
+}
+
 /**
    Initialize the hash state
    @param md   The hash state you wish to initialize
@@ -23,6 +23,13 @@ void threefishSetKey(ThreefishKey_t* keyCtx, ThreefishSize_t stateSize,
     keyCtx->stateSize = stateSize;
 }
 
+void threefishSetTweak(ThreefishKey_t* keyCtx, uint64_t* tweak)
+{
+    keyCtx->tweak[0] = tweak[0];
+    keyCtx->tweak[1] = tweak[1];
+    keyCtx->tweak[2] = tweak[0] ^ tweak[1];
+}
+
 void threefishEncryptBlockBytes(ThreefishKey_t* keyCtx, uint8_t* in,
                                 uint8_t* out)
 {
@@ -81,6 +81,19 @@ extern "C"
      */
     void threefishSetKey(ThreefishKey_t* keyCtx, ThreefishSize_t stateSize, uint64_t* keyData, uint64_t* tweak);
     
+    /**
+     * Set only the Threefish tweak data.
+     * 
+     * The key words and their parity word stay as threefishSetKey left
+     * them, so changing the tweak for every block does not redo the key.
+     *
+     * @param keyCtx
+     *     Pointer to a Threefish key structure set up by threefishSetKey.
+     * @param tweak
+     *     Pointer to the two tweak words (word has 64 bits).
+     */
+    void threefishSetTweak(ThreefishKey_t* keyCtx, uint64_t* tweak);
+    
     /**
      * Encrypt Threefisch block (bytes).
      * 
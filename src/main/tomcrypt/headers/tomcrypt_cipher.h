@@ -452,8 +452,8 @@ extern struct ltc_cipher_descriptor {
        @param pt      Plaintext
        @param ct      Ciphertext
        @param blocks  The number of complete blocks to process
-       @param IV      The initial value (input/output)
-       @param mode    little or big endian counter (mode=0 or mode=1)
+       @param IV      The last counter used (input/output), it is incremented before each block
+       @param mode    CTR_COUNTER_LITTLE_ENDIAN or CTR_COUNTER_BIG_ENDIAN, ORed with the counter width in octets
        @param skey    The scheduled key context
        @return CRYPT_OK if successful
    */
@@ -655,6 +655,20 @@ extern const struct ltc_cipher_descriptor safer_k64_desc, safer_k128_desc, safer
 #define aes_enc_ecb_encrypt     rijndael_enc_ecb_encrypt
 #define aes_enc_keysize         rijndael_enc_keysize
 
+#define aes_set_backend         rijndael_set_backend
+#define aes_get_backend         rijndael_get_backend
+
+/* block functions for rijndael/aes, selected at run time with rijndael_set_backend().
+   All of them use the same key schedule, a key set up with one works with the others */
+enum {
+   LTC_AES_BACKEND_C = 0,     /* T-tables */
+   LTC_AES_BACKEND_AESNI,     /* x86 AES instructions, 8 blocks in flight in ECB, CBC decrypt and CTR */
+   LTC_AES_BACKEND_VPAES      /* SSSE3 byte shuffles, constant time without AES instructions */
+};
+
+int rijndael_set_backend(int backend);
+int rijndael_get_backend(void);
+
 int rijndael_setup(const unsigned char *key, int keylen, int num_rounds, symmetric_key *skey);
 int rijndael_ecb_encrypt(const unsigned char *pt, unsigned char *ct, symmetric_key *skey);
 int rijndael_ecb_decrypt(const unsigned char *ct, unsigned char *pt, symmetric_key *skey);
@@ -842,6 +856,8 @@ int cbc_start(int cipher, const unsigned char *IV, const unsigned char *key,
                int keylen, int num_rounds, symmetric_CBC *cbc);
 int cbc_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long len, symmetric_CBC *cbc);
 int cbc_decrypt(const unsigned char *ct, unsigned char *pt, unsigned long len, symmetric_CBC *cbc);
+int cbc_encrypt_multi(symmetric_CBC *cbc[], const unsigned char *pt[], unsigned char *ct[],
+                      const unsigned long len[], unsigned long n);
 int cbc_getiv(unsigned char *IV, unsigned long *len, symmetric_CBC *cbc);
 int cbc_setiv(const unsigned char *IV, unsigned long len, symmetric_CBC *cbc);
 int cbc_done(symmetric_CBC *cbc);
@@ -925,11 +941,57 @@ int xts_decrypt(
    const unsigned char *tweak,
          symmetric_xts *xts);
 
+/* with the tweak already encrypted under key2, e.g. many of them in one pass */
+int xts_tweaked_encrypt(
+   const unsigned char *pt, unsigned long ptlen,
+         unsigned char *ct,
+         unsigned char *T,
+         symmetric_xts *xts);
+int xts_tweaked_decrypt(
+   const unsigned char *ct, unsigned long ptlen,
+         unsigned char *pt,
+         unsigned char *T,
+         symmetric_xts *xts);
+
+#define XTS_ENCRYPT 0
+#define XTS_DECRYPT 1
+
+int xts_crypt_blocks(const unsigned char *in, unsigned char *out, unsigned long blocks,
+                     unsigned char *T, int direction, symmetric_xts *xts);
+
 void xts_done(symmetric_xts *xts);
 int  xts_test(void);
 void xts_mult_x(unsigned char *I);
 #endif
 
+#ifdef LTC_CHACHA
+/* block functions for chacha, selected at run time with chacha_set_backend() */
+enum {
+   LTC_CHACHA_BACKEND_C = 0,
+   LTC_CHACHA_BACKEND_SSE2,     /* 4 blocks at a time */
+   LTC_CHACHA_BACKEND_AVX2,     /* 8 blocks at a time */
+   LTC_CHACHA_BACKEND_AVX512    /* 16 blocks at a time */
+};
+
+typedef struct {
+   ulong32        input[16];
+   unsigned char  kstream[64];
+   unsigned long  ksleft;
+   unsigned long  ivlen;
+   int            rounds;
+} chacha_state;
+
+int chacha_set_backend(int backend);
+int chacha_get_backend(void);
+int chacha_setup(chacha_state *st, const unsigned char *key, unsigned long keylen, int rounds);
+int chacha_ivctr32(chacha_state *st, const unsigned char *iv, unsigned long ivlen, ulong32 counter);
+int chacha_ivctr64(chacha_state *st, const unsigned char *iv, unsigned long ivlen, ulong64 counter);
+int chacha_crypt(chacha_state *st, const unsigned char *in, unsigned long inlen, unsigned char *out);
+int chacha_keystream(chacha_state *st, unsigned char *out, unsigned long outlen);
+int chacha_done(chacha_state *st);
+int chacha_test(void);
+#endif /* LTC_CHACHA */
+
 int find_cipher(const char *name);
 int find_cipher_any(const char *name, int blocklen, int keylen);
 int find_cipher_id(unsigned char ID);
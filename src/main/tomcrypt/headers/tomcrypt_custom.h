@@ -19,12 +19,18 @@
 #define LTC_SKEIN1024
 #define LTC_SKEINMAC
 #define LTC_THREEFISH
+#define LTC_BLAKE3
+#define LTC_CHACHA
+#define LTC_POLY1305
+#define LTC_CHACHA20POLY1305_MODE
+#define LTC_OCB3_MODE
 
 #define LTC_NO_MATH
 #define LTC_NO_PK
 #define LTC_MRSA
 #define LTC_MECC
 #define LTC_ECC_BL
+#define LTC_ECC_SHAMIR
 #define LTC_TWOFISH
 
 #define LTC_NO_ASM
@@ -54,6 +60,27 @@
 
 #define LTC_EAX_MODE
 
+/* x86 SIMD kernels are compiled with per-function target attributes
+   and selected at run time, so they do not depend on LTC_NO_ASM */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define LTC_X86_SIMD
+#endif
+
+/* P-384 in fixed width 64 bit limbs, needs a 128 bit product */
+#if defined(LTC_MECC) && defined(__SIZEOF_INT128__)
+#define LTC_ECC_P384
+#endif
+
+/* Curve41417 in radix 2^52 limbs, also needs a 128 bit product */
+#if defined(LTC_ECC_BL) && defined(__SIZEOF_INT128__)
+#define LTC_ECC_BL_FE
+#endif
+
+/* blake3 hashes large updates on several threads */
+#if defined(LTC_BLAKE3) && (defined(__unix__) || defined(__APPLE__))
+#define LTC_BLAKE3_THREADS
+#endif
+
 
 /*------End C4 project ---------------*/
 
@@ -178,6 +178,30 @@ typedef struct SkeinCtx {
 #endif
 
 
+#ifdef LTC_BLAKE3
+#define BLAKE3_KEY_LEN      32
+#define BLAKE3_OUT_LEN      32
+#define BLAKE3_BLOCK_LEN    64
+#define BLAKE3_CHUNK_LEN    1024
+#define BLAKE3_MAX_DEPTH    54
+
+struct blake3_chunk_state {
+    ulong32 cv[8];
+    ulong64 chunk_counter;
+    unsigned char buf[BLAKE3_BLOCK_LEN];
+    unsigned char buf_len, blocks_compressed, flags;
+};
+
+struct blake3_state {
+    ulong32 key[8];
+    struct blake3_chunk_state chunk;
+    unsigned long outlen;
+    unsigned char cv_stack_len;
+    /* one chaining value per level of the tree, plus one for the lazy merge */
+    unsigned char cv_stack[(BLAKE3_MAX_DEPTH + 1) * BLAKE3_OUT_LEN];
+};
+#endif
+
 typedef union Hash_state {
     char dummy[1];
 #ifdef LTC_CHC_HASH
@@ -223,6 +247,9 @@ typedef union Hash_state {
 #ifdef LTC_SKEIN
     SkeinCtx_t skein;
 #endif
+#ifdef LTC_BLAKE3
+    struct blake3_state *blake3;    /* on the heap, the cv_stack would triple the union */
+#endif
      
 void *data;
 } hash_state;
@@ -289,7 +316,19 @@ int whirlpool_test(void);
 extern const struct ltc_hash_descriptor whirlpool_desc;
 #endif
 
+#if defined(LTC_SHA512) || defined(LTC_SHA256)
+/* compress functions for the SHA-2 family, selected at run time with
+   sha256_set_backend() / sha512_set_backend() */
+enum {
+   LTC_SHA_BACKEND_C = 0,
+   LTC_SHA_BACKEND_SHANI,     /* x86 SHA extensions, sha256 only */
+   LTC_SHA_BACKEND_AVX2       /* AVX2 message schedule, sha512 only */
+};
+#endif
+
 #ifdef LTC_SHA512
+int sha512_set_backend(int backend);
+int sha512_get_backend(void);
 int sha512_init(hash_state * md);
 int sha512_process(hash_state * md, const unsigned char *in, unsigned long inlen);
 int sha512_done(hash_state * md, unsigned char *hash);
@@ -320,6 +359,8 @@ extern const struct ltc_hash_descriptor sha512_256_desc;
 #endif
 
 #ifdef LTC_SHA256
+int sha256_set_backend(int backend);
+int sha256_get_backend(void);
 int sha256_init(hash_state * md);
 int sha256_process(hash_state * md, const unsigned char *in, unsigned long inlen);
 int sha256_done(hash_state * md, unsigned char *hash);
@@ -435,6 +476,28 @@ int skein1024_test(void);
 extern const struct ltc_hash_descriptor skein1024_desc;
 #endif
 
+#ifdef LTC_BLAKE3
+/* compress functions for blake3, selected at run time with blake3_set_backend() */
+enum {
+   LTC_BLAKE3_BACKEND_C = 0,
+   LTC_BLAKE3_BACKEND_SSE41,    /* 4 chunks at a time */
+   LTC_BLAKE3_BACKEND_AVX2,     /* 8 chunks at a time */
+   LTC_BLAKE3_BACKEND_AVX512    /* 16 chunks at a time */
+};
+
+int blake3_set_backend(int backend);
+int blake3_get_backend(void);
+int blake3_set_threads(int threads);
+int blake3_init(hash_state * md);
+int blake3_set_outlen(hash_state * md, unsigned long outlen);
+int blake3_process(hash_state * md, const unsigned char *in, unsigned long inlen);
+int blake3_done(hash_state * md, unsigned char *hash);
+int blake3_xof(hash_state * md, ulong64 seek, unsigned char *out, unsigned long outlen);
+void blake3_free(hash_state * md);
+int blake3_test(void);
+extern const struct ltc_hash_descriptor blake3_desc;
+#endif
+
 
 int find_hash(const char *name);
 int find_hash_id(unsigned char ID);
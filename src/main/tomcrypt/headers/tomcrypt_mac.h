@@ -208,6 +208,45 @@ int s_ocb_done(ocb_state *ocb, const unsigned char *pt, unsigned long ptlen,
 
 #endif /* LTC_OCB_MODE */
 
+#ifdef LTC_OCB3_MODE
+
+#define OCB3_ENCRYPT 0
+#define OCB3_DECRYPT 1
+
+/* L_i for block indices below 2^32 */
+#define OCB3_L_COUNT 32
+
+typedef struct {
+   unsigned char     L_star[16],              /* E(0) */
+                     L_dollar[16],            /* double(L_star) */
+                     L_[OCB3_L_COUNT][16],    /* L_0 = double(L_dollar), L_i = double(L_i-1), made as needed */
+                     Offset[16],              /* text offset */
+                     Checksum[16],            /* xor of the plaintext */
+                     aOffset[16],             /* AAD offset */
+                     aSum[16],                /* AAD hash */
+                     abuf[16];                /* AAD short of a block */
+   ulong64           blocks,                  /* text blocks so far */
+                     ablocks;                 /* AAD blocks so far */
+   unsigned long     abuflen,
+                     taglen,
+                     lcount;                  /* L_ made so far */
+   int               cipher,
+                     textdone;                /* a partial block ended the text */
+   symmetric_key     key;
+} ocb3_state;
+
+int ocb3_init(ocb3_state *ocb, int cipher,
+              const unsigned char *key,    unsigned long keylen,
+              const unsigned char *nonce,  unsigned long noncelen,
+              unsigned long taglen);
+int ocb3_add_aad(ocb3_state *ocb, const unsigned char *aad, unsigned long aadlen);
+int ocb3_encrypt(ocb3_state *ocb, const unsigned char *pt, unsigned long ptlen, unsigned char *ct);
+int ocb3_decrypt(ocb3_state *ocb, const unsigned char *ct, unsigned long ctlen, unsigned char *pt);
+int ocb3_done(ocb3_state *ocb, unsigned char *tag, unsigned long *taglen);
+int ocb3_test(void);
+
+#endif /* LTC_OCB3_MODE */
+
 #ifdef LTC_CCM_MODE
 
 #define CCM_ENCRYPT 0
@@ -259,8 +298,18 @@ extern const unsigned char gcm_shift_table[];
 #define LTC_GCM_MODE_AAD   1
 #define LTC_GCM_MODE_TEXT  2
 
+/* GHASH for gcm, selected at run time with gcm_set_backend().  A state keeps
+   the backend it was initialized with */
+enum {
+   LTC_GCM_BACKEND_C = 0,     /* gcm_gf_mult, or the 64KB tables with LTC_GCM_TABLES */
+   LTC_GCM_BACKEND_PCLMUL,    /* x86 carry-less multiply, 8 blocks per reduction, stitched with AES-NI CTR */
+   LTC_GCM_BACKEND_4BIT       /* Shoup's 4 bit table, 256 bytes instead of the 64KB ones */
+};
+
+int gcm_set_backend(int backend);
+int gcm_get_backend(void);
+
 typedef struct { 
-   symmetric_key       K;
    unsigned char       H[16],        /* multiplier */
                        X[16],        /* accumulator */
                        Y[16],        /* counter */
@@ -275,6 +324,15 @@ typedef struct {
    ulong64             totlen,       /* 64-bit counter used for IV and AAD */
                        pttotlen;     /* 64-bit counter for the PT */
 
+   int                 ghash;        /* LTC_GCM_BACKEND_ used by this state */
+   unsigned char       HP[8][16];    /* H^1..H^8 byte reversed, for LTC_GCM_BACKEND_PCLMUL */
+   ulong64             HL[16],       /* H times each 4 bit value, low and high halves, */
+                       HH[16];       /* for LTC_GCM_BACKEND_4BIT */
+
+   /* K and PC stay last, a state that does not use the tables can be allocated
+      without them and with only the key its cipher needs, see gcm_state_size() */
+   symmetric_key       K;
+
 #ifdef LTC_GCM_TABLES
    unsigned char       PC[16][256][16]  /* 16 tables of 8x128 */
 #ifdef LTC_GCM_TABLES_SSE2
@@ -289,6 +347,11 @@ void gcm_mult_h(gcm_state *gcm, unsigned char *I);
 int gcm_init(gcm_state *gcm, int cipher,
              const unsigned char *key, int keylen);
 
+int gcm_init_backend(gcm_state *gcm, int backend, int cipher,
+                     const unsigned char *key, int keylen);
+
+unsigned long gcm_state_size(int backend, int cipher);
+
 int gcm_reset(gcm_state *gcm);
 
 int gcm_add_iv(gcm_state *gcm, 
@@ -315,8 +378,66 @@ int gcm_memory(      int           cipher,
                                int direction);
 int gcm_test(void);
 
+void gcm_init_4bit(gcm_state *gcm);
+void gcm_mult_h_4bit(gcm_state *gcm, unsigned char *I);
+
+#ifdef LTC_X86_SIMD
+void gcm_init_pclmul(gcm_state *gcm);
+void gcm_mult_h_pclmul(gcm_state *gcm, unsigned char *I);
+void gcm_ghash_pclmul(gcm_state *gcm, const unsigned char *in, unsigned long blocks);
+int gcm_process_pclmul(gcm_state *gcm, const unsigned char *in, unsigned char *out,
+                       unsigned long blocks, int direction);
+#endif
+
 #endif /* LTC_GCM_MODE */
 
+#ifdef LTC_POLY1305
+/* poly1305 block functions, selected at run time with poly1305_set_backend() */
+enum {
+   LTC_POLY1305_BACKEND_C = 0,  /* radix 2^44 with 128 bit products, 2^26 without */
+   LTC_POLY1305_BACKEND_AVX2,   /* radix 2^26, 4 blocks at a time */
+   LTC_POLY1305_BACKEND_C26     /* radix 2^26 even with 128 bit products, the 32 bit code */
+};
+
+typedef struct {
+   ulong64        r[5], h[5];         /* three 44/44/42 bit limbs with 128 bit products, five 26 bit ones without */
+   int            radix26;            /* r and h are in 26 bit limbs, set by poly1305_init */
+   ulong32        pad[4];
+   ulong32        rpow[4][5];         /* r^1..r^4 in 26 bit limbs for the AVX2 kernel, made on first use */
+   int            rpowset;
+   unsigned char  buffer[16];
+   unsigned long  leftover;
+} poly1305_state;
+
+int poly1305_set_backend(int backend);
+int poly1305_get_backend(void);
+int poly1305_init(poly1305_state *st, const unsigned char *key, unsigned long keylen);
+int poly1305_process(poly1305_state *st, const unsigned char *in, unsigned long inlen);
+int poly1305_done(poly1305_state *st, unsigned char *mac, unsigned long *maclen);
+int poly1305_test(void);
+#endif /* LTC_POLY1305 */
+
+#ifdef LTC_CHACHA20POLY1305_MODE
+
+#define CHACHA20POLY1305_ENCRYPT 0
+#define CHACHA20POLY1305_DECRYPT 1
+
+typedef struct {
+   chacha_state   chacha;
+   poly1305_state poly;
+   ulong64        aadlen, ctlen;
+   int            aadflg;
+} chacha20poly1305_state;
+
+int chacha20poly1305_init(chacha20poly1305_state *st, const unsigned char *key, unsigned long keylen);
+int chacha20poly1305_setiv(chacha20poly1305_state *st, const unsigned char *iv, unsigned long ivlen);
+int chacha20poly1305_add_aad(chacha20poly1305_state *st, const unsigned char *in, unsigned long inlen);
+int chacha20poly1305_encrypt(chacha20poly1305_state *st, const unsigned char *in, unsigned long inlen, unsigned char *out);
+int chacha20poly1305_decrypt(chacha20poly1305_state *st, const unsigned char *in, unsigned long inlen, unsigned char *out);
+int chacha20poly1305_done(chacha20poly1305_state *st, unsigned char *tag, unsigned long *taglen);
+int chacha20poly1305_test(void);
+#endif /* LTC_CHACHA20POLY1305_MODE */
+
 #ifdef LTC_PELICAN
 
 typedef struct pelican_state
@@ -493,6 +493,17 @@ int ltc_ecc_bl_projective_dbl_point(ecc_point *P, ecc_point *R, void *modulus);
  */
 int ltc_ecc_bl_mulmod(void *k, ecc_point *G, ecc_point *R, void *modulus, void *b, int map);
 
+#ifdef LTC_ECC_BL_FE
+/**
+ @brief Square root modulo the Curve41417 prime, in constant time.
+ @param a        The number to take the root of
+ @param modulus  The modulus of the field the ECC curve is in
+ @param r        [out] The root, a^((p+1)/4)
+ @return CRYPT_OK on success, CRYPT_INVALID_ARG if a is not a square
+ */
+int ltc_ecc_bl_sqrtmod(void *a, void *modulus, void *r);
+#endif
+
 #endif  /* LTC_ECC_BL */
 
 /* R = kG */
@@ -518,6 +529,16 @@ int ltc_ecc_fp_mul2add(ecc_point *A, void *kA,
 /* map P to affine from projective */
 int ltc_ecc_map(ecc_point *P, void *modulus, void *mp);
 
+#ifdef LTC_ECC_P384
+/* fixed width P-384, CRYPT_NOP when the curve or order is another one */
+int ltc_ecc_p384_mulmod(void *k, ecc_point *G, ecc_point *R, void *modulus);
+int ltc_ecc_p384_mul2add(ecc_point *A, void *kA,
+                         ecc_point *B, void *kB,
+                         ecc_point *C,
+                              void *modulus);
+int ltc_ecc_p384_invmod(void *a, void *order, void *b);
+#endif
+
 #endif
 
 #ifdef LTC_MDSA
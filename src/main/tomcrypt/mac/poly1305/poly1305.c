@@ -0,0 +1,644 @@
+/* LibTomCrypt, modular cryptographic library -- Tom St Denis
+ *
+ * LibTomCrypt is a library that provides various cryptographic
+ * algorithms in a highly modular and flexible manner.
+ *
+ * The library is free for all purposes without any express
+ * guarantee it works.
+ *
+ * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
+ */
+#include "tomcrypt.h"
+
+/**
+  @file poly1305.c
+  Poly1305 one-time authenticator, D. J. Bernstein (RFC 8439), after
+  Andrew Moon's poly1305-donna
+
+  With 128 bit products h and r are kept in three limbs of 44, 44 and 42 bits,
+  without them, or on the C26 backend, in five limbs of 26 bits.  The AVX2 kernel works on four
+  blocks at a time in 26 bit limbs: lane j sums every fourth block times r^4,
+  and the lanes are folded together with r^4, r^3, r^2 and r at the end.
+*/
+
+#ifdef LTC_POLY1305
+
+#ifdef LTC_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if defined(__SIZEOF_INT128__)
+#define POLY1305_RADIX44
+typedef unsigned __int128 poly1305_u128;
+#endif
+
+#define POLY1305_M26    0x3ffffffUL
+#define POLY1305_M42    CONST64(0x3ffffffffff)
+#define POLY1305_M44    CONST64(0xfffffffffff)
+
+#ifdef POLY1305_RADIX44
+
+/* h = (h + m) * r for each block, hibit is 2^128 for whole blocks and 0 for the padded last one */
+static void poly1305_blocks_c44(poly1305_state *st, const unsigned char *m, unsigned long blocks, ulong64 hibit)
+{
+    ulong64       r0 = st->r[0], r1 = st->r[1], r2 = st->r[2];
+    ulong64       s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+    ulong64       h0 = st->h[0], h1 = st->h[1], h2 = st->h[2];
+    ulong64       t0, t1, c;
+    poly1305_u128 d0, d1, d2;
+
+    hibit <<= 40;
+    for (; blocks > 0; blocks--, m += 16) {
+        LOAD64L(t0, m + 0);
+        LOAD64L(t1, m + 8);
+
+        h0 += t0 & POLY1305_M44;
+        h1 += ((t0 >> 44) | (t1 << 20)) & POLY1305_M44;
+        h2 += ((t1 >> 24) & POLY1305_M42) | hibit;
+
+        d0 = (poly1305_u128)h0 * r0 + (poly1305_u128)h1 * s2 + (poly1305_u128)h2 * s1;
+        d1 = (poly1305_u128)h0 * r1 + (poly1305_u128)h1 * r0 + (poly1305_u128)h2 * s2;
+        d2 = (poly1305_u128)h0 * r2 + (poly1305_u128)h1 * r1 + (poly1305_u128)h2 * r0;
+
+        c = (ulong64)(d0 >> 44); h0 = (ulong64)d0 & POLY1305_M44;
+        d1 += c; c = (ulong64)(d1 >> 44); h1 = (ulong64)d1 & POLY1305_M44;
+        d2 += c; c = (ulong64)(d2 >> 42); h2 = (ulong64)d2 & POLY1305_M42;
+        h0 += c * 5; c = h0 >> 44; h0 &= POLY1305_M44;
+        h1 += c;
+    }
+
+    st->h[0] = h0; st->h[1] = h1; st->h[2] = h2;
+}
+
+#endif /* POLY1305_RADIX44 */
+
+static void poly1305_blocks_c26(poly1305_state *st, const unsigned char *m, unsigned long blocks, ulong64 hibit)
+{
+    ulong32 r0 = (ulong32)st->r[0], r1 = (ulong32)st->r[1], r2 = (ulong32)st->r[2];
+    ulong32 r3 = (ulong32)st->r[3], r4 = (ulong32)st->r[4];
+    ulong32 s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    ulong32 h0 = (ulong32)st->h[0], h1 = (ulong32)st->h[1], h2 = (ulong32)st->h[2];
+    ulong32 h3 = (ulong32)st->h[3], h4 = (ulong32)st->h[4];
+    ulong32 t, c;
+    ulong64 d0, d1, d2, d3, d4;
+
+    hibit <<= 24;
+    for (; blocks > 0; blocks--, m += 16) {
+        LOAD32L(t, m + 0);  h0 += t & POLY1305_M26;
+        LOAD32L(t, m + 3);  h1 += (t >> 2) & POLY1305_M26;
+        LOAD32L(t, m + 6);  h2 += (t >> 4) & POLY1305_M26;
+        LOAD32L(t, m + 9);  h3 += (t >> 6) & POLY1305_M26;
+        LOAD32L(t, m + 12); h4 += (t >> 8) | (ulong32)hibit;
+
+        d0 = (ulong64)h0 * r0 + (ulong64)h1 * s4 + (ulong64)h2 * s3 + (ulong64)h3 * s2 + (ulong64)h4 * s1;
+        d1 = (ulong64)h0 * r1 + (ulong64)h1 * r0 + (ulong64)h2 * s4 + (ulong64)h3 * s3 + (ulong64)h4 * s2;
+        d2 = (ulong64)h0 * r2 + (ulong64)h1 * r1 + (ulong64)h2 * r0 + (ulong64)h3 * s4 + (ulong64)h4 * s3;
+        d3 = (ulong64)h0 * r3 + (ulong64)h1 * r2 + (ulong64)h2 * r1 + (ulong64)h3 * r0 + (ulong64)h4 * s4;
+        d4 = (ulong64)h0 * r4 + (ulong64)h1 * r3 + (ulong64)h2 * r2 + (ulong64)h3 * r1 + (ulong64)h4 * r0;
+
+        c = (ulong32)(d0 >> 26); h0 = (ulong32)d0 & POLY1305_M26;
+        d1 += c; c = (ulong32)(d1 >> 26); h1 = (ulong32)d1 & POLY1305_M26;
+        d2 += c; c = (ulong32)(d2 >> 26); h2 = (ulong32)d2 & POLY1305_M26;
+        d3 += c; c = (ulong32)(d3 >> 26); h3 = (ulong32)d3 & POLY1305_M26;
+        d4 += c; c = (ulong32)(d4 >> 26); h4 = (ulong32)d4 & POLY1305_M26;
+        h0 += c * 5; c = h0 >> 26; h0 &= POLY1305_M26;
+        h1 += c;
+    }
+
+    st->h[0] = h0; st->h[1] = h1; st->h[2] = h2; st->h[3] = h3; st->h[4] = h4;
+}
+
+static void poly1305_blocks_c(poly1305_state *st, const unsigned char *m, unsigned long blocks, ulong64 hibit)
+{
+#ifdef POLY1305_RADIX44
+    if (!st->radix26) {
+       poly1305_blocks_c44(st, m, blocks, hibit);
+       return;
+    }
+#endif
+    poly1305_blocks_c26(st, m, blocks, hibit);
+}
+
+#ifdef LTC_X86_SIMD
+
+/* limbs of the state in 26 bits, h has to be carried first so nothing is cut off */
+static void poly1305_get26(const poly1305_state *st, const ulong64 *in, ulong32 out[5])
+{
+    int i;
+
+#ifdef POLY1305_RADIX44
+    if (!st->radix26) {
+       out[0] = (ulong32)(in[0] & POLY1305_M26);
+       out[1] = (ulong32)(((in[0] >> 26) | (in[1] << 18)) & POLY1305_M26);
+       out[2] = (ulong32)((in[1] >> 8) & POLY1305_M26);
+       out[3] = (ulong32)(((in[1] >> 34) | (in[2] << 10)) & POLY1305_M26);
+       out[4] = (ulong32)(in[2] >> 16);
+       return;
+    }
+#endif
+    for (i = 0; i < 5; i++) {
+        out[i] = (ulong32)in[i];
+    }
+}
+
+static void poly1305_set26(const poly1305_state *st, ulong64 *out, const ulong32 in[5])
+{
+    int i;
+
+#ifdef POLY1305_RADIX44
+    if (!st->radix26) {
+       /* the limbs may be a little over 26 bits, so they are added rather than or'd */
+       out[0] = (ulong64)in[0] + ((ulong64)(in[1] & 0x3ffff) << 26);
+       out[1] = (out[0] >> 44) + ((ulong64)in[1] >> 18) + ((ulong64)in[2] << 8) + ((ulong64)(in[3] & 0x3ff) << 34);
+       out[2] = (out[1] >> 44) + ((ulong64)in[3] >> 10) + ((ulong64)in[4] << 16);
+       out[0] &= POLY1305_M44;
+       out[1] &= POLY1305_M44;
+       return;
+    }
+#endif
+    for (i = 0; i < 5; i++) {
+        out[i] = in[i];
+    }
+}
+
+/* out = a * b mod 2^130 - 5, limbs left just over 26 bits */
+static void poly1305_mul26(ulong32 out[5], const ulong32 a[5], const ulong32 b[5])
+{
+    ulong64 d[5], c;
+    int     i, j;
+
+    for (i = 0; i < 5; i++) {
+        d[i] = 0;
+        for (j = 0; j <= i; j++) {
+            d[i] += (ulong64)a[j] * b[i - j];
+        }
+        for (; j < 5; j++) {
+            d[i] += (ulong64)a[j] * (b[5 + i - j] * 5);
+        }
+    }
+
+    c = 0;
+    for (i = 0; i < 5; i++) {
+        d[i] += c;
+        c = d[i] >> 26;
+        out[i] = (ulong32)(d[i] & POLY1305_M26);
+    }
+    out[0] += (ulong32)(c * 5);
+    out[1] += out[0] >> 26;
+    out[0] &= POLY1305_M26;
+}
+
+#define POLY1305_MUL(d, a, r, s)                                                                    \
+    d[0] = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a[0], r[0]), _mm256_mul_epu32(a[1], s[4])),  \
+           _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a[2], s[3]), _mm256_mul_epu32(a[3], s[2])),  \
+                            _mm256_mul_epu32(a[4], s[1])));                                          \
+    d[1] = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a[0], r[1]), _mm256_mul_epu32(a[1], r[0])),  \
+           _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a[2], s[4]), _mm256_mul_epu32(a[3], s[3])),  \
+                            _mm256_mul_epu32(a[4], s[2])));                                          \
+    d[2] = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a[0], r[2]), _mm256_mul_epu32(a[1], r[1])),  \
+           _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a[2], r[0]), _mm256_mul_epu32(a[3], s[4])),  \
+                            _mm256_mul_epu32(a[4], s[3])));                                          \
+    d[3] = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a[0], r[3]), _mm256_mul_epu32(a[1], r[2])),  \
+           _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a[2], r[1]), _mm256_mul_epu32(a[3], r[0])),  \
+                            _mm256_mul_epu32(a[4], s[4])));                                          \
+    d[4] = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a[0], r[4]), _mm256_mul_epu32(a[1], r[3])),  \
+           _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a[2], r[2]), _mm256_mul_epu32(a[3], r[1])),  \
+                            _mm256_mul_epu32(a[4], r[0])));
+
+/* four blocks, one per lane, split into 26 bit limbs with the 2^128 bit set */
+__attribute__((target("avx2")))
+static void poly1305_load4_avx2(__m256i m[5], const unsigned char *in)
+{
+    const __m256i mask = _mm256_set1_epi64x(POLY1305_M26);
+    __m256i v0 = _mm256_loadu_si256((const __m256i *)(in + 0));
+    __m256i v1 = _mm256_loadu_si256((const __m256i *)(in + 32));
+    __m256i lo = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(v0, v1), 0xD8);
+    __m256i hi = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(v0, v1), 0xD8);
+
+    m[0] = _mm256_and_si256(lo, mask);
+    m[1] = _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask);
+    m[2] = _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(lo, 52), _mm256_slli_epi64(hi, 12)), mask);
+    m[3] = _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask);
+    m[4] = _mm256_or_si256(_mm256_srli_epi64(hi, 40), _mm256_set1_epi64x(1 << 24));
+}
+
+/* blocks is a multiple of 4 */
+__attribute__((target("avx2")))
+static void poly1305_blocks_avx2(poly1305_state *st, const unsigned char *in, unsigned long blocks)
+{
+    const __m256i mask = _mm256_set1_epi64x(POLY1305_M26);
+    __m256i       a[5], d[5], m[5], r[5], s[5], c;
+    ulong32       h[5];
+    ulong64       lanes[4], t[5];
+    int           i;
+
+    poly1305_get26(st, st->h, h);
+
+    for (i = 0; i < 5; i++) {
+        r[i] = _mm256_set1_epi64x(st->rpow[3][i]);
+        s[i] = _mm256_set1_epi64x(st->rpow[3][i] * 5);
+    }
+
+    poly1305_load4_avx2(a, in);
+    for (i = 0; i < 5; i++) {
+        a[i] = _mm256_add_epi64(a[i], _mm256_set_epi64x(0, 0, 0, h[i]));
+    }
+    in += 64;
+    blocks -= 4;
+
+    for (; blocks > 0; blocks -= 4, in += 64) {
+        POLY1305_MUL(d, a, r, s)
+        poly1305_load4_avx2(m, in);
+
+        /* carry, the limbs only have to stay small enough for the next multiply */
+        c = _mm256_srli_epi64(d[0], 26); d[0] = _mm256_and_si256(d[0], mask); d[1] = _mm256_add_epi64(d[1], c);
+        c = _mm256_srli_epi64(d[3], 26); d[3] = _mm256_and_si256(d[3], mask); d[4] = _mm256_add_epi64(d[4], c);
+        c = _mm256_srli_epi64(d[1], 26); d[1] = _mm256_and_si256(d[1], mask); d[2] = _mm256_add_epi64(d[2], c);
+        c = _mm256_srli_epi64(d[4], 26); d[4] = _mm256_and_si256(d[4], mask);
+        d[0] = _mm256_add_epi64(d[0], _mm256_add_epi64(c, _mm256_slli_epi64(c, 2)));
+        c = _mm256_srli_epi64(d[2], 26); d[2] = _mm256_and_si256(d[2], mask); d[3] = _mm256_add_epi64(d[3], c);
+        c = _mm256_srli_epi64(d[0], 26); d[0] = _mm256_and_si256(d[0], mask); d[1] = _mm256_add_epi64(d[1], c);
+        c = _mm256_srli_epi64(d[3], 26); d[3] = _mm256_and_si256(d[3], mask); d[4] = _mm256_add_epi64(d[4], c);
+
+        for (i = 0; i < 5; i++) {
+            a[i] = _mm256_add_epi64(d[i], m[i]);
+        }
+    }
+
+    /* lane j still owes r^(4-j) */
+    for (i = 0; i < 5; i++) {
+        r[i] = _mm256_set_epi64x(st->rpow[0][i], st->rpow[1][i], st->rpow[2][i], st->rpow[3][i]);
+        s[i] = _mm256_set_epi64x(st->rpow[0][i] * 5, st->rpow[1][i] * 5, st->rpow[2][i] * 5, st->rpow[3][i] * 5);
+    }
+    POLY1305_MUL(d, a, r, s)
+
+    for (i = 0; i < 5; i++) {
+        _mm256_storeu_si256((__m256i *)lanes, d[i]);
+        t[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    t[1] += t[0] >> 26; h[0] = (ulong32)(t[0] & POLY1305_M26);
+    t[2] += t[1] >> 26; h[1] = (ulong32)(t[1] & POLY1305_M26);
+    t[3] += t[2] >> 26; h[2] = (ulong32)(t[2] & POLY1305_M26);
+    t[4] += t[3] >> 26; h[3] = (ulong32)(t[3] & POLY1305_M26);
+    t[0]  = (t[4] >> 26) * 5 + h[0]; h[4] = (ulong32)(t[4] & POLY1305_M26);
+    h[0]  = (ulong32)(t[0] & POLY1305_M26);
+    h[1] += (ulong32)(t[0] >> 26);
+
+    poly1305_set26(st, st->h, h);
+}
+
+#undef POLY1305_MUL
+
+#endif /* LTC_X86_SIMD */
+
+static int poly1305_backend = LTC_POLY1305_BACKEND_C;
+
+/**
+   Select the block function used by poly1305
+   @param backend  LTC_POLY1305_BACKEND_C, _C26 or _AVX2
+   @return CRYPT_OK if successful, CRYPT_INVALID_ARG if the backend is not built in
+*/
+int poly1305_set_backend(int backend)
+{
+    switch (backend) {
+       case LTC_POLY1305_BACKEND_C:
+       case LTC_POLY1305_BACKEND_C26:
+#ifdef LTC_X86_SIMD
+       case LTC_POLY1305_BACKEND_AVX2:
+#endif
+          poly1305_backend = backend;
+          return CRYPT_OK;
+
+       default:
+          return CRYPT_INVALID_ARG;
+    }
+}
+
+/**
+   @return the LTC_POLY1305_BACKEND_xxx in use
+*/
+int poly1305_get_backend(void)
+{
+    return poly1305_backend;
+}
+
+/* whole blocks, long runs go to the AVX2 kernel */
+static void poly1305_blocks(poly1305_state *st, const unsigned char *in, unsigned long blocks)
+{
+#ifdef LTC_X86_SIMD
+    unsigned long n;
+
+    if (poly1305_backend == LTC_POLY1305_BACKEND_AVX2 && blocks >= 8) {
+       if (!st->rpowset) {
+          poly1305_get26(st, st->r, st->rpow[0]);
+          poly1305_mul26(st->rpow[1], st->rpow[0], st->rpow[0]);
+          poly1305_mul26(st->rpow[2], st->rpow[1], st->rpow[0]);
+          poly1305_mul26(st->rpow[3], st->rpow[2], st->rpow[0]);
+          st->rpowset = 1;
+       }
+#ifdef POLY1305_RADIX44
+       /* the 44 bit limbs are only partly carried after a block */
+       if (!st->radix26) {
+          st->h[2] += st->h[1] >> 44; st->h[1] &= POLY1305_M44;
+       }
+#endif
+       n = blocks & ~3UL;
+       poly1305_blocks_avx2(st, in, n);
+       in     += 16 * n;
+       blocks -= n;
+    }
+#endif
+    if (blocks > 0) {
+       poly1305_blocks_c(st, in, blocks, 1);
+    }
+}
+
+/**
+   Initialize poly1305 with a one-time key
+   @param st      The state
+   @param key     r || s
+   @param keylen  32
+   @return CRYPT_OK if successful
+*/
+int poly1305_init(poly1305_state *st, const unsigned char *key, unsigned long keylen)
+{
+#ifdef POLY1305_RADIX44
+    ulong64 t0, t1;
+#endif
+    ulong32 t;
+
+    LTC_ARGCHK(st  != NULL);
+    LTC_ARGCHK(key != NULL);
+
+    if (keylen != 32) {
+       return CRYPT_INVALID_KEYSIZE;
+    }
+
+    zeromem(st, sizeof(poly1305_state));
+
+    /* the radix is fixed for the life of the state */
+#ifdef POLY1305_RADIX44
+    st->radix26 = (poly1305_backend == LTC_POLY1305_BACKEND_C26);
+#else
+    st->radix26 = 1;
+#endif
+
+    /* r &= 0x0ffffffc0ffffffc0ffffffc0fffffff */
+#ifdef POLY1305_RADIX44
+    if (!st->radix26) {
+       LOAD64L(t0, key + 0);
+       LOAD64L(t1, key + 8);
+       st->r[0] = t0 & CONST64(0xffc0fffffff);
+       st->r[1] = ((t0 >> 44) | (t1 << 20)) & CONST64(0xfffffc0ffff);
+       st->r[2] = (t1 >> 24) & CONST64(0x00ffffffc0f);
+    }
+#endif
+    if (st->radix26) {
+       LOAD32L(t, key + 0);  st->r[0] = t & 0x3ffffff;
+       LOAD32L(t, key + 3);  st->r[1] = (t >> 2) & 0x3ffff03;
+       LOAD32L(t, key + 6);  st->r[2] = (t >> 4) & 0x3ffc0ff;
+       LOAD32L(t, key + 9);  st->r[3] = (t >> 6) & 0x3f03fff;
+       LOAD32L(t, key + 12); st->r[4] = (t >> 8) & 0x00fffff;
+    }
+
+    LOAD32L(st->pad[0], key + 16);
+    LOAD32L(st->pad[1], key + 20);
+    LOAD32L(st->pad[2], key + 24);
+    LOAD32L(st->pad[3], key + 28);
+    return CRYPT_OK;
+}
+
+/**
+   Add data to the MAC
+   @param st     The state
+   @param in     The data
+   @param inlen  The length of the data
+   @return CRYPT_OK if successful
+*/
+int poly1305_process(poly1305_state *st, const unsigned char *in, unsigned long inlen)
+{
+    unsigned long n;
+
+    if (inlen == 0) {
+       return CRYPT_OK;
+    }
+
+    LTC_ARGCHK(st != NULL);
+    LTC_ARGCHK(in != NULL);
+
+    if (st->leftover > 0) {
+       n = MIN(16 - st->leftover, inlen);
+       XMEMCPY(st->buffer + st->leftover, in, n);
+       st->leftover += n;
+       in    += n;
+       inlen -= n;
+       if (st->leftover < 16) {
+          return CRYPT_OK;
+       }
+       poly1305_blocks_c(st, st->buffer, 1, 1);
+       st->leftover = 0;
+    }
+
+    if (inlen >= 16) {
+       n = inlen / 16;
+       poly1305_blocks(st, in, n);
+       in    += 16 * n;
+       inlen -= 16 * n;
+    }
+
+    if (inlen > 0) {
+       XMEMCPY(st->buffer, in, inlen);
+       st->leftover = inlen;
+    }
+    return CRYPT_OK;
+}
+
+#ifdef POLY1305_RADIX44
+
+/* fully carry h, reduce it mod 2^130 - 5 and add s */
+static void poly1305_finish44(const poly1305_state *st, unsigned char *mac)
+{
+    ulong64 h0, h1, h2, g0, g1, g2, c, t0, t1;
+
+    h0 = st->h[0]; h1 = st->h[1]; h2 = st->h[2];
+
+    c = h1 >> 44; h1 &= POLY1305_M44;
+    h2 += c;      c = h2 >> 42; h2 &= POLY1305_M42;
+    h0 += c * 5;  c = h0 >> 44; h0 &= POLY1305_M44;
+    h1 += c;      c = h1 >> 44; h1 &= POLY1305_M44;
+    h2 += c;      c = h2 >> 42; h2 &= POLY1305_M42;
+    h0 += c * 5;  c = h0 >> 44; h0 &= POLY1305_M44;
+    h1 += c;
+
+    /* h - p, kept if it did not go negative */
+    g0 = h0 + 5; c = g0 >> 44; g0 &= POLY1305_M44;
+    g1 = h1 + c; c = g1 >> 44; g1 &= POLY1305_M44;
+    g2 = h2 + c - ((ulong64)1 << 42);
+
+    c = (g2 >> 63) - 1;
+    g0 &= c; g1 &= c; g2 &= c;
+    c = ~c;
+    h0 = (h0 & c) | g0;
+    h1 = (h1 & c) | g1;
+    h2 = (h2 & c) | g2;
+
+    /* h + s mod 2^128 */
+    t0 = ((ulong64)st->pad[1] << 32) | st->pad[0];
+    t1 = ((ulong64)st->pad[3] << 32) | st->pad[2];
+    h0 += t0 & POLY1305_M44;                                   c = h0 >> 44; h0 &= POLY1305_M44;
+    h1 += (((t0 >> 44) | (t1 << 20)) & POLY1305_M44) + c;      c = h1 >> 44; h1 &= POLY1305_M44;
+    h2 += ((t1 >> 24) & POLY1305_M42) + c;                     h2 &= POLY1305_M42;
+
+    h0 = h0 | (h1 << 44);
+    h1 = (h1 >> 20) | (h2 << 24);
+
+    STORE64L(h0, mac + 0);
+    STORE64L(h1, mac + 8);
+}
+
+#endif /* POLY1305_RADIX44 */
+
+static void poly1305_finish26(const poly1305_state *st, unsigned char *mac)
+{
+    ulong32 h0, h1, h2, h3, h4, g0, g1, g2, g3, g4, c, mask;
+    ulong64 f;
+
+    h0 = (ulong32)st->h[0]; h1 = (ulong32)st->h[1]; h2 = (ulong32)st->h[2];
+    h3 = (ulong32)st->h[3]; h4 = (ulong32)st->h[4];
+
+                 c = h1 >> 26; h1 &= POLY1305_M26;
+    h2 += c;     c = h2 >> 26; h2 &= POLY1305_M26;
+    h3 += c;     c = h3 >> 26; h3 &= POLY1305_M26;
+    h4 += c;     c = h4 >> 26; h4 &= POLY1305_M26;
+    h0 += c * 5; c = h0 >> 26; h0 &= POLY1305_M26;
+    h1 += c;
+
+    g0 = h0 + 5; c = g0 >> 26; g0 &= POLY1305_M26;
+    g1 = h1 + c; c = g1 >> 26; g1 &= POLY1305_M26;
+    g2 = h2 + c; c = g2 >> 26; g2 &= POLY1305_M26;
+    g3 = h3 + c; c = g3 >> 26; g3 &= POLY1305_M26;
+    g4 = h4 + c - (1UL << 26);
+
+    mask = (g4 >> 31) - 1;
+    g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    h0 = (h0      ) | (h1 << 26);
+    h1 = (h1 >>  6) | (h2 << 20);
+    h2 = (h2 >> 12) | (h3 << 14);
+    h3 = (h3 >> 18) | (h4 <<  8);
+
+    f = (ulong64)h0 + st->pad[0];             h0 = (ulong32)f;
+    f = (ulong64)h1 + st->pad[1] + (f >> 32); h1 = (ulong32)f;
+    f = (ulong64)h2 + st->pad[2] + (f >> 32); h2 = (ulong32)f;
+    f = (ulong64)h3 + st->pad[3] + (f >> 32); h3 = (ulong32)f;
+
+    STORE32L(h0, mac + 0);
+    STORE32L(h1, mac + 4);
+    STORE32L(h2, mac + 8);
+    STORE32L(h3, mac + 12);
+}
+
+/**
+   Finish the MAC and wipe the state
+   @param st      The state
+   @param mac     [out] The 16 byte tag
+   @param maclen  [in/out] The size of mac, 16 on return
+   @return CRYPT_OK if successful
+*/
+int poly1305_done(poly1305_state *st, unsigned char *mac, unsigned long *maclen)
+{
+    LTC_ARGCHK(st     != NULL);
+    LTC_ARGCHK(mac    != NULL);
+    LTC_ARGCHK(maclen != NULL);
+
+    if (*maclen < 16) {
+       return CRYPT_BUFFER_OVERFLOW;
+    }
+
+    /* the last partial block has a 1 after it and no 2^128 */
+    if (st->leftover > 0) {
+       st->buffer[st->leftover] = 1;
+       XMEMSET(st->buffer + st->leftover + 1, 0, 16 - st->leftover - 1);
+       poly1305_blocks_c(st, st->buffer, 1, 0);
+    }
+
+#ifdef POLY1305_RADIX44
+    if (!st->radix26) {
+       poly1305_finish44(st, mac);
+    }
+#endif
+    if (st->radix26) {
+       poly1305_finish26(st, mac);
+    }
+
+    *maclen = 16;
+    zeromem(st, sizeof(poly1305_state));
+    return CRYPT_OK;
+}
+
+/**
+   RFC 8439 section 2.5.2, and a message long enough for the AVX2 kernel
+   checked against one fed to the block function a byte at a time
+   @return CRYPT_OK if successful
+*/
+int poly1305_test(void)
+{
+#ifndef LTC_TEST
+    return CRYPT_NOP;
+#else
+    static const unsigned char k[32] = {
+       0x85, 0xd6, 0xbe, 0x78, 0x57, 0x55, 0x6d, 0x33, 0x7f, 0x44, 0x52, 0xfe, 0x42, 0xd5, 0x06, 0xa8,
+       0x01, 0x03, 0x80, 0x8a, 0xfb, 0x0d, 0xb2, 0xfd, 0x4a, 0xbf, 0xf6, 0xaf, 0x41, 0x49, 0xf5, 0x1b
+    };
+    static const char m[] = "Cryptographic Forum Research Group";
+    static const unsigned char tag[16] = {
+       0xa8, 0x06, 0x1d, 0xc1, 0x30, 0x51, 0x36, 0xc6, 0xc2, 0x2b, 0x8b, 0xaf, 0x0c, 0x01, 0x27, 0xa9
+    };
+    poly1305_state st;
+    unsigned char  buf[16 * 37], out[16], out2[16];
+    unsigned long  outlen, i;
+    int            err;
+
+    outlen = sizeof(out);
+    if ((err = poly1305_init(&st, k, sizeof(k))) != CRYPT_OK)                              return err;
+    if ((err = poly1305_process(&st, (const unsigned char *)m, 34)) != CRYPT_OK)           return err;
+    if ((err = poly1305_done(&st, out, &outlen)) != CRYPT_OK)                              return err;
+    if (XMEMCMP(out, tag, sizeof(tag)) != 0) {
+       return CRYPT_FAIL_TESTVECTOR;
+    }
+
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = (unsigned char)(0xff - i * 7);
+    }
+
+    outlen = sizeof(out);
+    if ((err = poly1305_init(&st, k, sizeof(k))) != CRYPT_OK)                              return err;
+    if ((err = poly1305_process(&st, buf, sizeof(buf) - 3)) != CRYPT_OK)                   return err;
+    if ((err = poly1305_done(&st, out, &outlen)) != CRYPT_OK)                              return err;
+
+    outlen = sizeof(out2);
+    if ((err = poly1305_init(&st, k, sizeof(k))) != CRYPT_OK)                              return err;
+    for (i = 0; i < sizeof(buf) - 3; i++) {
+        if ((err = poly1305_process(&st, buf + i, 1)) != CRYPT_OK)                         return err;
+    }
+    if ((err = poly1305_done(&st, out2, &outlen)) != CRYPT_OK)                             return err;
+    if (XMEMCMP(out, out2, sizeof(out)) != 0) {
+       return CRYPT_FAIL_TESTVECTOR;
+    }
+
+    return CRYPT_OK;
+#endif
+}
+
+#endif /* LTC_POLY1305 */
+
+/* $Source$ */
+/* $Revision$ */
+/* $Date$ */
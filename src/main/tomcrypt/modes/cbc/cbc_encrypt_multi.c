@@ -0,0 +1,202 @@
+/* LibTomCrypt, modular cryptographic library -- Tom St Denis
+ *
+ * LibTomCrypt is a library that provides various cryptographic
+ * algorithms in a highly modular and flexible manner.
+ *
+ * The library is free for all purposes without any express
+ * guarantee it works.
+ *
+ * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
+ */
+#include "tomcrypt.h"
+
+#ifdef LTC_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+   @file cbc_encrypt_multi.c
+   CBC encryption of several independent streams.  One stream can not keep
+   more than one block in the cipher, every block waits on the one before it,
+   so AES on the AES-NI backend takes a block from each of 8 streams, each
+   under its own key, and runs them through the rounds together.
+*/
+
+
+#ifdef LTC_CBC_MODE
+
+#ifdef LTC_X86_SIMD
+
+#define CBC_AESNI_TARGET    __attribute__((target("aes,ssse3")))
+
+#define CBC_AESNI_KEY(K, r) \
+    _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)((K) + 4*(r))), _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3))
+
+#define CBC_LANES       8
+#define CBC_LANE8(S)    S(0) S(1) S(2) S(3) S(4) S(5) S(6) S(7)
+
+/* the streams go through 8 lanes, a lane that runs out takes the next
+   stream.  Idle lanes encrypt zeros into a sink under the keys of a busy
+   lane, which costs less than a loop over a varying number of lanes.
+   Returns as cbc_encrypt */
+CBC_AESNI_TARGET
+static int cbc_aesni_multi(symmetric_CBC *cbc[], const unsigned char *pt[], unsigned char *ct[],
+                            const unsigned long len[], unsigned long n)
+{
+    static const unsigned char zero[16];
+    __m128i rk[CBC_LANES][15], iv[CBC_LANES], b[CBC_LANES];
+    const unsigned char *in[CBC_LANES];
+    unsigned char *out[CBC_LANES], sink[16];
+    unsigned long lane[CBC_LANES], left[CBC_LANES], stride[CBC_LANES], next = 0, run, x;
+    int Nr = cbc[0]->key.rijndael.Nr, busy, lanes, i, r;
+
+    /* n marks an idle lane */
+    for (i = 0; i < CBC_LANES; i++) {
+        lane[i] = n;
+    }
+
+    for (;;) {
+        for (i = 0; i < CBC_LANES; i++) {
+            while (lane[i] == n && next < n) {
+                if (len[next] > 0) {
+                   for (r = 0; r <= Nr; r++) {
+                       rk[i][r] = CBC_AESNI_KEY(cbc[next]->key.rijndael.eK, r);
+                   }
+                   iv[i]     = _mm_loadu_si128((const __m128i *)cbc[next]->IV);
+                   in[i]     = pt[next];
+                   out[i]    = ct[next];
+                   left[i]   = len[next] >> 4;
+                   stride[i] = 16;
+                   lane[i]   = next;
+                }
+                next++;
+            }
+        }
+
+        /* run until the shortest busy stream is done */
+        busy = -1;
+        run = 0;
+        lanes = 0;
+        for (i = 0; i < CBC_LANES; i++) {
+            if (lane[i] != n) {
+               if (busy < 0 || left[i] < run) {
+                  run = left[i];
+                  busy = i;
+               }
+               lanes++;
+            }
+        }
+        if (busy < 0) {
+           return CRYPT_OK;
+        }
+
+        /* the last stream on its own is faster without the idle lanes */
+        if (lanes == 1 && next == n) {
+           _mm_storeu_si128((__m128i *)cbc[lane[busy]]->IV, iv[busy]);
+           return cbc_encrypt(in[busy], out[busy], left[busy] << 4, cbc[lane[busy]]);
+        }
+
+        for (i = 0; i < CBC_LANES; i++) {
+            if (lane[i] == n) {
+               for (r = 0; r <= Nr; r++) {
+                   rk[i][r] = rk[busy][r];
+               }
+               iv[i]     = _mm_setzero_si128();
+               in[i]     = zero;
+               out[i]    = sink;
+               stride[i] = 0;
+            }
+        }
+
+#define CBC_IN(i)       b[i] = _mm_xor_si128(_mm_xor_si128(iv[i], _mm_loadu_si128((const __m128i *)in[i])), rk[i][0]);
+#define CBC_ENC(i)      b[i] = _mm_aesenc_si128(b[i], rk[i][r]);
+#define CBC_ENCLAST(i)  iv[i] = _mm_aesenclast_si128(b[i], rk[i][Nr]);
+#define CBC_OUT(i)      _mm_storeu_si128((__m128i *)out[i], iv[i]); in[i] += stride[i]; out[i] += stride[i];
+
+        for (x = 0; x < run; x++) {
+            CBC_LANE8(CBC_IN)
+            for (r = 1; r < Nr; r++) {
+                CBC_LANE8(CBC_ENC)
+            }
+            CBC_LANE8(CBC_ENCLAST)
+            CBC_LANE8(CBC_OUT)
+        }
+
+#undef CBC_IN
+#undef CBC_ENC
+#undef CBC_ENCLAST
+#undef CBC_OUT
+
+        /* the streams that ran out hand back their IV and free the lane */
+        for (i = 0; i < CBC_LANES; i++) {
+            if (lane[i] != n && (left[i] -= run) == 0) {
+               _mm_storeu_si128((__m128i *)cbc[lane[i]]->IV, iv[i]);
+               lane[i] = n;
+            }
+        }
+    }
+}
+
+#endif /* LTC_X86_SIMD */
+
+/**
+  CBC encrypt several independent streams
+  @param cbc    The CBC states, one per stream, the IVs are updated as cbc_encrypt would
+  @param pt     The plaintexts
+  @param ct     [out] The ciphertexts, ct[i] may be pt[i]
+  @param len    The lengths, each a multiple of the block length
+  @param n      The number of streams
+  @return CRYPT_OK if successful
+*/
+int cbc_encrypt_multi(symmetric_CBC *cbc[], const unsigned char *pt[], unsigned char *ct[],
+                      const unsigned long len[], unsigned long n)
+{
+   unsigned long x;
+   int err;
+
+   LTC_ARGCHK(n == 0 || cbc != NULL);
+   LTC_ARGCHK(n == 0 || pt  != NULL);
+   LTC_ARGCHK(n == 0 || ct  != NULL);
+   LTC_ARGCHK(n == 0 || len != NULL);
+
+   for (x = 0; x < n; x++) {
+       LTC_ARGCHK(cbc[x] != NULL);
+       if ((err = cipher_is_valid(cbc[x]->cipher)) != CRYPT_OK) {
+          return err;
+       }
+       if (cbc[x]->blocklen < 1 || cbc[x]->blocklen > (int)sizeof(cbc[x]->IV) || len[x] % cbc[x]->blocklen) {
+          return CRYPT_INVALID_ARG;
+       }
+       if (len[x] > 0) {
+          LTC_ARGCHK(pt[x] != NULL);
+          LTC_ARGCHK(ct[x] != NULL);
+       }
+   }
+
+#ifdef LTC_X86_SIMD
+   if (n > 1 && cipher_descriptor[cbc[0]->cipher].ecb_encrypt == rijndael_ecb_encrypt &&
+       rijndael_get_backend() == LTC_AES_BACKEND_AESNI) {
+      for (x = 1; x < n; x++) {
+          if (cbc[x]->cipher != cbc[0]->cipher || cbc[x]->key.rijndael.Nr != cbc[0]->key.rijndael.Nr) {
+             break;
+          }
+      }
+      if (x == n) {
+         return cbc_aesni_multi(cbc, pt, ct, len, n);
+      }
+   }
+#endif
+
+   for (x = 0; x < n; x++) {
+       if (len[x] > 0 && (err = cbc_encrypt(pt[x], ct[x], len[x], cbc[x])) != CRYPT_OK) {
+          return err;
+       }
+   }
+   return CRYPT_OK;
+}
+
+#endif
+
+/* $Source$ */
+/* $Revision$ */
+/* $Date$ */
@@ -50,15 +50,20 @@ int ctr_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long len, s
    }
 #endif
    
-   /* handle acceleration only if pad is empty, accelerator is present and length is >= a block size */
-   if ((ctr->padlen == ctr->blocklen) && cipher_descriptor[ctr->cipher].accel_ctr_encrypt != NULL && (len >= (unsigned long)ctr->blocklen)) {
-      if ((err = cipher_descriptor[ctr->cipher].accel_ctr_encrypt(pt, ct, len/ctr->blocklen, ctr->ctr, ctr->mode, &ctr->key)) != CRYPT_OK) {
-         return err;
+   while (len) {
+      /* whole blocks go to the accelerator once the pad is used up, ctr_start leaves a full one */
+      if ((ctr->padlen == ctr->blocklen) && cipher_descriptor[ctr->cipher].accel_ctr_encrypt != NULL && (len >= (unsigned long)ctr->blocklen)) {
+         /* the accelerator needs the counter width too, ctrlen counts from the other end for big endian */
+         x = (ctr->mode == CTR_COUNTER_LITTLE_ENDIAN) ? ctr->ctrlen : ctr->blocklen - ctr->ctrlen;
+         if ((err = cipher_descriptor[ctr->cipher].accel_ctr_encrypt(pt, ct, len/ctr->blocklen, ctr->ctr, ctr->mode | x, &ctr->key)) != CRYPT_OK) {
+            return err;
+         }
+         pt  += len - len % ctr->blocklen;
+         ct  += len - len % ctr->blocklen;
+         len %= ctr->blocklen;
+         continue;
       }
-      len %= ctr->blocklen;
-   }
 
-   while (len) {
       /* is the pad empty? */
       if (ctr->padlen == ctr->blocklen) {
          /* increment counter */
@@ -0,0 +1,187 @@
+/* LibTomCrypt, modular cryptographic library -- Tom St Denis
+ *
+ * LibTomCrypt is a library that provides various cryptographic
+ * algorithms in a highly modular and flexible manner.
+ *
+ * The library is free for all purposes without any express
+ * guarantee it works.
+ *
+ * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
+ */
+#include "tomcrypt.h"
+
+#ifdef LTC_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+  @file xts_blocks.c
+  XTS whole blocks.  The tweak of block j is T * x^j, which only takes a shift
+  and a conditional XOR, so the tweaks of a batch are made up front and the
+  blocks go through the cipher side by side.  AES on the AES-NI backend does
+  8 blocks per batch with the tweaks kept in registers, other ciphers go
+  through their ECB accelerator 16 blocks at a time.
+*/
+
+#ifdef LTC_XTS_MODE
+
+/* blocks per pass through a cipher without the AES-NI path */
+#define XTS_BATCH       16
+
+#ifdef LTC_X86_SIMD
+
+#define XTS_AESNI_TARGET    __attribute__((target("aes,ssse3")))
+#define XTS_AESNI_INLINE    static inline __attribute__((always_inline, target("aes,ssse3")))
+
+#define XTS_AESNI_KEY(K, r) \
+    _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)((K) + 4*(r))), _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3))
+
+#define XTS_LANES       8
+#define XTS_LANE8(S)    S(0) S(1) S(2) S(3) S(4) S(5) S(6) S(7)
+
+/* t * x with t a little endian 128 bit number, the carry out of each 32 bit
+   lane goes into the next and the one out of the top comes back as 0x87 */
+XTS_AESNI_INLINE __m128i xts_mulx(__m128i t)
+{
+    __m128i c = _mm_and_si128(_mm_srai_epi32(t, 31), _mm_set_epi32(0x87, 1, 1, 1));
+
+    return _mm_xor_si128(_mm_add_epi32(t, t), _mm_shuffle_epi32(c, 0x93));
+}
+
+/* whole batches of 8, returns the number of blocks done */
+XTS_AESNI_TARGET
+static unsigned long xts_aesni_blocks(const unsigned char *in, unsigned char *out, unsigned long blocks,
+                                      unsigned char *T, int direction, symmetric_xts *xts)
+{
+    const ulong32 *K = (direction == XTS_DECRYPT) ? xts->key1.rijndael.dK : xts->key1.rijndael.eK;
+    __m128i rk[15], tw[XTS_LANES], b[XTS_LANES], t;
+    unsigned long done = 0;
+    int Nr = xts->key1.rijndael.Nr, r;
+
+    for (r = 0; r <= Nr; r++) {
+        rk[r] = XTS_AESNI_KEY(K, r);
+    }
+    t = _mm_loadu_si128((const __m128i *)T);
+
+#define XTS_IN(i)       tw[i] = t; t = xts_mulx(t); \
+                        b[i] = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)in + i), tw[i]), rk[0]);
+#define XTS_ENC(i)      b[i] = _mm_aesenc_si128(b[i], rk[r]);
+#define XTS_ENCLAST(i)  b[i] = _mm_aesenclast_si128(b[i], rk[Nr]);
+#define XTS_DEC(i)      b[i] = _mm_aesdec_si128(b[i], rk[r]);
+#define XTS_DECLAST(i)  b[i] = _mm_aesdeclast_si128(b[i], rk[Nr]);
+#define XTS_OUT(i)      _mm_storeu_si128((__m128i *)out + i, _mm_xor_si128(b[i], tw[i]));
+
+    for (; blocks >= XTS_LANES; blocks -= XTS_LANES, done += XTS_LANES) {
+        XTS_LANE8(XTS_IN)
+        if (direction == XTS_DECRYPT) {
+           for (r = 1; r < Nr; r++) {
+               XTS_LANE8(XTS_DEC)
+           }
+           XTS_LANE8(XTS_DECLAST)
+        } else {
+           for (r = 1; r < Nr; r++) {
+               XTS_LANE8(XTS_ENC)
+           }
+           XTS_LANE8(XTS_ENCLAST)
+        }
+        XTS_LANE8(XTS_OUT)
+        in += 16 * XTS_LANES;
+        out += 16 * XTS_LANES;
+    }
+
+#undef XTS_IN
+#undef XTS_ENC
+#undef XTS_ENCLAST
+#undef XTS_DEC
+#undef XTS_DECLAST
+#undef XTS_OUT
+
+    _mm_storeu_si128((__m128i *)T, t);
+
+    return done;
+}
+
+#endif /* LTC_X86_SIMD */
+
+/**
+  Encrypt or decrypt whole blocks
+  @param in         The input blocks
+  @param out        [out] The output blocks, may be in
+  @param blocks     The number of 16 byte blocks
+  @param T          [in/out] The encrypted tweak of the first block, the tweak of the next one on return
+  @param direction  XTS_ENCRYPT or XTS_DECRYPT
+  @param xts        The XTS structure
+  @return CRYPT_OK if successful
+*/
+int xts_crypt_blocks(const unsigned char *in, unsigned char *out, unsigned long blocks,
+                     unsigned char *T, int direction, symmetric_xts *xts)
+{
+    const struct ltc_cipher_descriptor *desc = &cipher_descriptor[xts->cipher];
+    unsigned char tw[XTS_BATCH * 16], buf[XTS_BATCH * 16];
+    unsigned long n, x;
+    int err = CRYPT_OK;
+
+#ifdef LTC_X86_SIMD
+    if (desc->ecb_encrypt == rijndael_ecb_encrypt && rijndael_get_backend() == LTC_AES_BACKEND_AESNI) {
+       n = xts_aesni_blocks(in, out, blocks, T, direction, xts);
+       in += 16 * n;
+       out += 16 * n;
+       blocks -= n;
+    }
+#endif
+
+    while (blocks > 0) {
+       n = MIN(blocks, XTS_BATCH);
+
+       for (x = 0; x < 16 * n; x++) {
+           if ((x & 15) == 0 && x > 0) {
+              xts_mult_x(T);
+           }
+           tw[x] = T[x & 15];
+           buf[x] = in[x] ^ tw[x];
+       }
+       xts_mult_x(T);
+
+       if (direction == XTS_DECRYPT) {
+          if (desc->accel_ecb_decrypt != NULL) {
+             err = desc->accel_ecb_decrypt(buf, buf, n, &xts->key1);
+          } else {
+             for (x = 0; x < n && err == CRYPT_OK; x++) {
+                 err = desc->ecb_decrypt(buf + 16 * x, buf + 16 * x, &xts->key1);
+             }
+          }
+       } else {
+          if (desc->accel_ecb_encrypt != NULL) {
+             err = desc->accel_ecb_encrypt(buf, buf, n, &xts->key1);
+          } else {
+             for (x = 0; x < n && err == CRYPT_OK; x++) {
+                 err = desc->ecb_encrypt(buf + 16 * x, buf + 16 * x, &xts->key1);
+             }
+          }
+       }
+       if (err != CRYPT_OK) {
+          goto done;
+       }
+
+       for (x = 0; x < 16 * n; x++) {
+           out[x] = buf[x] ^ tw[x];
+       }
+
+       in += 16 * n;
+       out += 16 * n;
+       blocks -= n;
+    }
+
+done:
+#ifdef LTC_CLEAN_STACK
+    zeromem(tw, sizeof(tw));
+    zeromem(buf, sizeof(buf));
+#endif
+    return err;
+}
+
+#endif /* LTC_XTS_MODE */
+
+/* $Source$ */
+/* $Revision$ */
+/* $Date$ */
@@ -50,34 +50,24 @@ static int tweak_uncrypt(const unsigned char *C, unsigned char *P, unsigned char
    return err;
 }   
 
-/** XTS Decryption
+/** XTS Decryption with the tweak already encrypted under key2
   @param ct     [in] Ciphertext
-  @param ptlen  Length of plaintext (and ciphertext)
-  @param pt     [out]  Plaintext
-  @param tweak  [in] The 128--bit encryption tweak (e.g. sector number)
+  @param ptlen  Length of plaintext (and ciphertext), at least 16
+  @param pt     [out]  Plaintext, may be ct
+  @param T      [in/out] The encrypted tweak, clobbered
   @param xts    The XTS structure
   Returns CRYPT_OK upon success
-*/int xts_decrypt(
+*/
+int xts_tweaked_decrypt(
    const unsigned char *ct, unsigned long ptlen,
          unsigned char *pt,
-   const unsigned char *tweak,
+         unsigned char *T,
          symmetric_xts *xts)
 {
-   unsigned char PP[16], CC[16], T[16];
+   unsigned char PP[16], CC[16];
    unsigned long i, m, mo, lim;
    int           err;
 
-   /* check inputs */
-   LTC_ARGCHK(pt    != NULL);
-   LTC_ARGCHK(ct    != NULL);
-   LTC_ARGCHK(tweak != NULL);
-   LTC_ARGCHK(xts   != NULL);
-
-   /* check if valid */
-   if ((err = cipher_is_valid(xts->cipher)) != CRYPT_OK) {
-      return err;
-   }
-
    /* get number of blocks */
    m  = ptlen >> 4;
    mo = ptlen & 15;
@@ -87,11 +77,6 @@ static int tweak_uncrypt(const unsigned char *C, unsigned char *P, unsigned char
       return CRYPT_INVALID_ARG;
    }
 
-   /* encrypt the tweak */
-   if ((err = cipher_descriptor[xts->cipher].ecb_encrypt(tweak, T, &xts->key2)) != CRYPT_OK) {
-      return err;
-   }
-
    /* for i = 0 to m-2 do */
    if (mo == 0) {
       lim = m;
@@ -99,12 +84,12 @@ static int tweak_uncrypt(const unsigned char *C, unsigned char *P, unsigned char
       lim = m - 1;
    }
 
-   for (i = 0; i < lim; i++) {
-      err = tweak_uncrypt(ct, pt, T, xts);
-      ct += 16;
-      pt += 16;
+   if ((err = xts_crypt_blocks(ct, pt, lim, T, XTS_DECRYPT, xts)) != CRYPT_OK) {
+      return err;
    }
-   
+   ct += 16 * lim;
+   pt += 16 * lim;
+
    /* if ptlen not divide 16 then */
    if (mo > 0) {
       XMEMCPY(CC, T, 16);
@@ -133,6 +118,42 @@ static int tweak_uncrypt(const unsigned char *C, unsigned char *P, unsigned char
    return CRYPT_OK;
 }
 
+/** XTS Decryption
+  @param ct     [in] Ciphertext
+  @param ptlen  Length of plaintext (and ciphertext)
+  @param pt     [out]  Plaintext
+  @param tweak  [in] The 128--bit encryption tweak (e.g. sector number)
+  @param xts    The XTS structure
+  Returns CRYPT_OK upon success
+*/
+int xts_decrypt(
+   const unsigned char *ct, unsigned long ptlen,
+         unsigned char *pt,
+   const unsigned char *tweak,
+         symmetric_xts *xts)
+{
+   unsigned char T[16];
+   int           err;
+
+   /* check inputs */
+   LTC_ARGCHK(pt    != NULL);
+   LTC_ARGCHK(ct    != NULL);
+   LTC_ARGCHK(tweak != NULL);
+   LTC_ARGCHK(xts   != NULL);
+
+   /* check if valid */
+   if ((err = cipher_is_valid(xts->cipher)) != CRYPT_OK) {
+      return err;
+   }
+
+   /* encrypt the tweak */
+   if ((err = cipher_descriptor[xts->cipher].ecb_encrypt(tweak, T, &xts->key2)) != CRYPT_OK) {
+      return err;
+   }
+
+   return xts_tweaked_decrypt(ct, ptlen, pt, T, xts);
+}
+
 #endif
 
 /* $Source$ */
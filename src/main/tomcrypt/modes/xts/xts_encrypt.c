@@ -52,49 +52,33 @@ static int tweak_crypt(const unsigned char *P, unsigned char *C, unsigned char *
    return CRYPT_OK;
 }   
 
-/** XTS Encryption
+/** XTS Encryption with the tweak already encrypted under key2
   @param pt     [in]  Plaintext
-  @param ptlen  Length of plaintext (and ciphertext)
-  @param ct     [out] Ciphertext
-  @param tweak  [in] The 128--bit encryption tweak (e.g. sector number)
+  @param ptlen  Length of plaintext (and ciphertext), at least 16
+  @param ct     [out] Ciphertext, may be pt
+  @param T      [in/out] The encrypted tweak, clobbered
   @param xts    The XTS structure
   Returns CRYPT_OK upon success
 */
-int xts_encrypt(
+int xts_tweaked_encrypt(
    const unsigned char *pt, unsigned long ptlen,
          unsigned char *ct,
-   const unsigned char *tweak,
+         unsigned char *T,
          symmetric_xts *xts)
 {
-   unsigned char PP[16], CC[16], T[16];
+   unsigned char PP[16], CC[16];
    unsigned long i, m, mo, lim;
    int           err;
 
-   /* check inputs */
-   LTC_ARGCHK(pt    != NULL);
-   LTC_ARGCHK(ct    != NULL);
-   LTC_ARGCHK(tweak != NULL);
-   LTC_ARGCHK(xts   != NULL);
-
-   /* check if valid */
-   if ((err = cipher_is_valid(xts->cipher)) != CRYPT_OK) {
-      return err;
-   }
-
    /* get number of blocks */
    m  = ptlen >> 4;
    mo = ptlen & 15;
 
-	   /* must have at least one full block */
+   /* must have at least one full block */
    if (m == 0) {
       return CRYPT_INVALID_ARG;
    }
 
-   /* encrypt the tweak */
-   if ((err = cipher_descriptor[xts->cipher].ecb_encrypt(tweak, T, &xts->key2)) != CRYPT_OK) {
-      return err;
-   }
-
    /* for i = 0 to m-2 do */
    if (mo == 0) {
       lim = m;
@@ -102,12 +86,12 @@ int xts_encrypt(
       lim = m - 1;
    }
 
-   for (i = 0; i < lim; i++) {
-      err = tweak_crypt(pt, ct, T, xts);
-      ct += 16;
-      pt += 16;
+   if ((err = xts_crypt_blocks(pt, ct, lim, T, XTS_ENCRYPT, xts)) != CRYPT_OK) {
+      return err;
    }
-   
+   ct += 16 * lim;
+   pt += 16 * lim;
+
    /* if ptlen not divide 16 then */
    if (mo > 0) {
       /* CC = tweak encrypt block m-1 */
@@ -134,6 +118,42 @@ int xts_encrypt(
    return err;
 }
 
+/** XTS Encryption
+  @param pt     [in]  Plaintext
+  @param ptlen  Length of plaintext (and ciphertext)
+  @param ct     [out] Ciphertext
+  @param tweak  [in] The 128--bit encryption tweak (e.g. sector number)
+  @param xts    The XTS structure
+  Returns CRYPT_OK upon success
+*/
+int xts_encrypt(
+   const unsigned char *pt, unsigned long ptlen,
+         unsigned char *ct,
+   const unsigned char *tweak,
+         symmetric_xts *xts)
+{
+   unsigned char T[16];
+   int           err;
+
+   /* check inputs */
+   LTC_ARGCHK(pt    != NULL);
+   LTC_ARGCHK(ct    != NULL);
+   LTC_ARGCHK(tweak != NULL);
+   LTC_ARGCHK(xts   != NULL);
+
+   /* check if valid */
+   if ((err = cipher_is_valid(xts->cipher)) != CRYPT_OK) {
+      return err;
+   }
+
+   /* encrypt the tweak */
+   if ((err = cipher_descriptor[xts->cipher].ecb_encrypt(tweak, T, &xts->key2)) != CRYPT_OK) {
+      return err;
+   }
+
+   return xts_tweaked_encrypt(pt, ptlen, ct, T, xts);
+}
+
 #endif
 
 /* $Source$ */
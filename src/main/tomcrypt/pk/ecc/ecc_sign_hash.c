@@ -82,7 +82,15 @@ int ecc_sign_hash(const unsigned char *in,  unsigned long inlen,
          ecc_free(&pubkey);
       } else { 
         /* find s = (e + xr)/k */
+#ifdef LTC_ECC_P384
+        /* the nonce is inverted in constant time on P-384 */
+        if ((err = ltc_ecc_p384_invmod(pubkey.k, p, pubkey.k)) == CRYPT_NOP) {
+           err = mp_invmod(pubkey.k, p, pubkey.k);
+        }
+        if (err != CRYPT_OK)                                                 { goto error; } /* k = 1/k */
+#else
         if ((err = mp_invmod(pubkey.k, p, pubkey.k)) != CRYPT_OK)            { goto error; } /* k = 1/k */
+#endif
         if ((err = mp_mulmod(key->k, r, p, s)) != CRYPT_OK)                  { goto error; } /* s = xr */
         if ((err = mp_add(e, s, s)) != CRYPT_OK)                             { goto error; } /* s = e +  xr */
         if ((err = mp_mod(s, p, s)) != CRYPT_OK)                             { goto error; } /* s = e +  xr */
@@ -53,6 +53,13 @@ int ltc_ecc_mul2add(ecc_point *A, void *kA,
   LTC_ARGCHK(kB      != NULL);
   LTC_ARGCHK(modulus != NULL);
 
+#ifdef LTC_ECC_P384
+  /* P-384 runs on fixed width limbs */
+  if ((err = ltc_ecc_p384_mul2add(A, kA, B, kB, C, modulus)) != CRYPT_NOP) {
+     return err;
+  }
+#endif
+
   /* allocate memory */
   tA = XCALLOC(1, ECC_BUF_SIZE);
   if (tA == NULL) {
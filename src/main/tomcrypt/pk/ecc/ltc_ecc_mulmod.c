@@ -50,6 +50,13 @@ int ltc_ecc_mulmod(void *k, ecc_point *G, ecc_point *R, void *modulus, int map)
    LTC_ARGCHK(R       != NULL);
    LTC_ARGCHK(modulus != NULL);
 
+#ifdef LTC_ECC_P384
+   /* P-384 runs on fixed width limbs, it always maps */
+   if (map && (err = ltc_ecc_p384_mulmod(k, G, R, modulus)) != CRYPT_NOP) {
+      return err;
+   }
+#endif
+
    /* init montgomery reduction */
    if ((err = mp_montgomery_setup(modulus, &mp)) != CRYPT_OK) {
       return err;
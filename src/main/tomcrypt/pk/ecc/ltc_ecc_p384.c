@@ -0,0 +1,790 @@
+/* LibTomCrypt, modular cryptographic library -- Tom St Denis
+ *
+ * LibTomCrypt is a library that provides various cryptographic
+ * algorithms in a highly modular and flexible manner.
+ *
+ * The library is free for all purposes without any express
+ * guarantee it works.
+ *
+ * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
+ */
+#include "tomcrypt.h"
+
+/**
+  @file ltc_ecc_p384.c
+  NIST P-384 in six 64 bit limbs.  Field elements live on the stack and are
+  reduced with the Solinas identity for p = 2^384 - 2^128 - 2^96 + 2^32 - 1,
+  so a field operation is a handful of 64x64 products instead of a call
+  through ltc_mp, a heap bignum and a generic reduction.  Points are
+  Jacobian with a = -3, the scalar goes through a fixed window of signed
+  5 bit digits with the table read in constant time, and inverses mod p and
+  mod the order are exponentiations by a fixed exponent.
+*/
+
+#ifdef LTC_MECC
+#ifdef LTC_ECC_P384
+
+typedef unsigned __int128 p384_dbl;
+typedef __int128          p384_sdbl;
+
+/* little endian limbs, always fully reduced */
+typedef ulong64 p384_fe[6];
+
+typedef struct {
+   p384_fe x, y, z;
+} p384_point;
+
+/* bits per digit of the signed window, the table holds 1..16 times the point */
+#define P384_WINDOW     5
+#define P384_TABLE      16
+#define P384_DIGITS     ((384 + P384_WINDOW - 1) / P384_WINDOW + 1)
+
+static const p384_fe p384_p = {
+   CONST64(0x00000000FFFFFFFF), CONST64(0xFFFFFFFF00000000), CONST64(0xFFFFFFFFFFFFFFFE),
+   CONST64(0xFFFFFFFFFFFFFFFF), CONST64(0xFFFFFFFFFFFFFFFF), CONST64(0xFFFFFFFFFFFFFFFF)
+};
+
+static const p384_fe p384_n = {
+   CONST64(0xECEC196ACCC52973), CONST64(0x581A0DB248B0A77A), CONST64(0xC7634D81F4372DDF),
+   CONST64(0xFFFFFFFFFFFFFFFF), CONST64(0xFFFFFFFFFFFFFFFF), CONST64(0xFFFFFFFFFFFFFFFF)
+};
+
+/* 2^768 mod n, takes a scalar into the Montgomery domain */
+static const p384_fe p384_n_rr = {
+   CONST64(0x2D319B2419B409A9), CONST64(0xFF3D81E5DF1AA419), CONST64(0xBC3E483AFCB82947),
+   CONST64(0xD40D49174AAB1CC5), CONST64(0x3FB05B7A28266895), CONST64(0x0C84EE012B39BF21)
+};
+
+/* -1/n mod 2^64 */
+#define P384_N0     CONST64(0x6ED46089E88FDC45)
+
+#ifdef __clang__
+#pragma mark - Field
+#endif
+
+/* the limb loops are spelled out, their carries chain from one to the next */
+#define P384_LIMB6(S)   S(0) S(1) S(2) S(3) S(4) S(5)
+
+/* all ones when a is zero */
+static ulong64 p384_is_zero(const p384_fe a)
+{
+   ulong64 t = a[0] | a[1] | a[2] | a[3] | a[4] | a[5];
+
+   return ((t | (0 - t)) >> 63) - 1;
+}
+
+/* r = mask ? a : r */
+static void p384_cmov(p384_fe r, const p384_fe a, ulong64 mask)
+{
+#define P384_CMOV(i)    r[i] ^= mask & (r[i] ^ a[i]);
+   P384_LIMB6(P384_CMOV)
+#undef P384_CMOV
+}
+
+/* r = a - m when that does not go below zero, a and m 6 limbs with carry on top of a */
+static void p384_sub_if_above(p384_fe r, const ulong64 a[6], ulong64 carry, const p384_fe m)
+{
+   p384_fe  t;
+   p384_dbl acc;
+   ulong64  borrow = 0, keep;
+
+#define P384_SUB(i)     acc = (p384_dbl)a[i] - m[i] - borrow; t[i] = (ulong64)acc; borrow = (ulong64)(acc >> 64) & 1;
+   P384_LIMB6(P384_SUB)
+#undef P384_SUB
+
+   /* keep a only when the subtraction borrowed past the carry */
+   keep = 0 - (borrow & ~carry & 1);
+#define P384_SEL(i)     r[i] = (a[i] & keep) | (t[i] & ~keep);
+   P384_LIMB6(P384_SEL)
+#undef P384_SEL
+}
+
+static void p384_add(p384_fe r, const p384_fe a, const p384_fe b)
+{
+   ulong64  t[6], carry = 0;
+   p384_dbl acc;
+
+#define P384_ADD(i)     acc = (p384_dbl)a[i] + b[i] + carry; t[i] = (ulong64)acc; carry = (ulong64)(acc >> 64);
+   P384_LIMB6(P384_ADD)
+#undef P384_ADD
+   p384_sub_if_above(r, t, carry, p384_p);
+}
+
+static void p384_sub(p384_fe r, const p384_fe a, const p384_fe b)
+{
+   p384_dbl acc;
+   ulong64  borrow = 0, carry = 0, mask;
+
+#define P384_SUB(i)     acc = (p384_dbl)a[i] - b[i] - borrow; r[i] = (ulong64)acc; borrow = (ulong64)(acc >> 64) & 1;
+   P384_LIMB6(P384_SUB)
+#undef P384_SUB
+
+   /* add p back when it went below zero */
+   mask = 0 - borrow;
+#define P384_ADD(i)     acc = (p384_dbl)r[i] + (p384_p[i] & mask) + carry; r[i] = (ulong64)acc; carry = (ulong64)(acc >> 64);
+   P384_LIMB6(P384_ADD)
+#undef P384_ADD
+}
+
+/* x + h 2^384 = x + h c mod p with c = 2^384 mod p = 2^128 + 2^96 - 2^32 + 1,
+   so h c = h + (h << 96) + (h << 128) - (h << 32), shifts and adds only.
+   What comes out above 2^384 goes back into h, at most 3 limbs */
+static void p384_fold(ulong64 x[6], ulong64 h[6])
+{
+   ulong64   s0, s1, s2, s3, s4, s5, s6;
+   p384_sdbl acc;
+
+   /* s = h << 32 */
+   s0 = h[0] << 32;
+   s1 = (h[1] << 32) | (h[0] >> 32);
+   s2 = (h[2] << 32) | (h[1] >> 32);
+   s3 = (h[3] << 32) | (h[2] >> 32);
+   s4 = (h[4] << 32) | (h[3] >> 32);
+   s5 = (h[5] << 32) | (h[4] >> 32);
+   s6 = h[5] >> 32;
+
+   acc  = (p384_sdbl)x[0] + h[0] - s0;               x[0] = (ulong64)acc; acc >>= 64;
+   acc += (p384_sdbl)x[1] + h[1] + s0 - s1;          x[1] = (ulong64)acc; acc >>= 64;
+   acc += (p384_sdbl)x[2] + h[2] + s1 + h[0] - s2;   x[2] = (ulong64)acc; acc >>= 64;
+   acc += (p384_sdbl)x[3] + h[3] + s2 + h[1] - s3;   x[3] = (ulong64)acc; acc >>= 64;
+   acc += (p384_sdbl)x[4] + h[4] + s3 + h[2] - s4;   x[4] = (ulong64)acc; acc >>= 64;
+   acc += (p384_sdbl)x[5] + h[5] + s4 + h[3] - s5;   x[5] = (ulong64)acc; acc >>= 64;
+   acc += (p384_sdbl)s5 + h[4] - s6;                 h[0] = (ulong64)acc; acc >>= 64;
+   acc += (p384_sdbl)s6 + h[5];                      h[1] = (ulong64)acc; acc >>= 64;
+   h[2] = (ulong64)acc;
+   h[3] = h[4] = h[5] = 0;
+}
+
+/* r = t mod p for a 768 bit t.  p is a Solinas prime, the top half folds
+   back in twice, which leaves at most one 2^384.  That one becomes c, and
+   x + c can no longer reach 2^384 */
+static void p384_reduce(p384_fe r, const ulong64 t[12])
+{
+   static const ulong64 c[6] = {
+      CONST64(0xFFFFFFFF00000001), CONST64(0x00000000FFFFFFFF), 1, 0, 0, 0
+   };
+   ulong64  x[6], h[6], mask, carry = 0;
+   p384_dbl acc;
+
+#define P384_SPLIT(i)   x[i] = t[i]; h[i] = t[i + 6];
+   P384_LIMB6(P384_SPLIT)
+#undef P384_SPLIT
+
+   p384_fold(x, h);
+   p384_fold(x, h);
+
+   mask = 0 - h[0];
+#define P384_ADD(i)     acc = (p384_dbl)x[i] + (c[i] & mask) + carry; x[i] = (ulong64)acc; carry = (ulong64)(acc >> 64);
+   P384_LIMB6(P384_ADD)
+#undef P384_ADD
+
+   p384_sub_if_above(r, x, 0, p384_p);
+}
+
+/* the products go into t column by column, (c2 c1 c0) holds the column sum */
+#define P384_MAC(i, j)  acc = (p384_dbl)a[i] * b[j]; \
+                        sum = (p384_dbl)c0 + (ulong64)acc; c0 = (ulong64)sum; \
+                        sum = (p384_dbl)c1 + (ulong64)(acc >> 64) + (ulong64)(sum >> 64); c1 = (ulong64)sum; \
+                        c2 += (ulong64)(sum >> 64);
+#define P384_COL(k)     t[k] = c0; c0 = c1; c1 = c2; c2 = 0;
+
+static void p384_mul(p384_fe r, const p384_fe a, const p384_fe b)
+{
+   ulong64  t[12], c0 = 0, c1 = 0, c2 = 0;
+   p384_dbl acc, sum;
+
+   P384_MAC(0, 0)                                                         P384_COL(0)
+   P384_MAC(0, 1) P384_MAC(1, 0)                                          P384_COL(1)
+   P384_MAC(0, 2) P384_MAC(1, 1) P384_MAC(2, 0)                           P384_COL(2)
+   P384_MAC(0, 3) P384_MAC(1, 2) P384_MAC(2, 1) P384_MAC(3, 0)            P384_COL(3)
+   P384_MAC(0, 4) P384_MAC(1, 3) P384_MAC(2, 2) P384_MAC(3, 1) P384_MAC(4, 0)
+                                                                          P384_COL(4)
+   P384_MAC(0, 5) P384_MAC(1, 4) P384_MAC(2, 3) P384_MAC(3, 2) P384_MAC(4, 1) P384_MAC(5, 0)
+                                                                          P384_COL(5)
+   P384_MAC(1, 5) P384_MAC(2, 4) P384_MAC(3, 3) P384_MAC(4, 2) P384_MAC(5, 1)
+                                                                          P384_COL(6)
+   P384_MAC(2, 5) P384_MAC(3, 4) P384_MAC(4, 3) P384_MAC(5, 2)            P384_COL(7)
+   P384_MAC(3, 5) P384_MAC(4, 4) P384_MAC(5, 3)                           P384_COL(8)
+   P384_MAC(4, 5) P384_MAC(5, 4)                                          P384_COL(9)
+   P384_MAC(5, 5)                                                         P384_COL(10)
+   t[11] = c0;
+
+   p384_reduce(r, t);
+}
+
+/* a square has each cross product twice, those go in doubled */
+#define P384_MAC2(i, j) acc = (p384_dbl)a[i] * a[j]; \
+                        c2 += (ulong64)(acc >> 127); acc <<= 1; \
+                        sum = (p384_dbl)c0 + (ulong64)acc; c0 = (ulong64)sum; \
+                        sum = (p384_dbl)c1 + (ulong64)(acc >> 64) + (ulong64)(sum >> 64); c1 = (ulong64)sum; \
+                        c2 += (ulong64)(sum >> 64);
+
+static void p384_sqr(p384_fe r, const p384_fe a)
+{
+   const ulong64 *b = a;
+   ulong64       t[12], c0 = 0, c1 = 0, c2 = 0;
+   p384_dbl      acc, sum;
+
+   P384_MAC(0, 0)                                                         P384_COL(0)
+   P384_MAC2(0, 1)                                                        P384_COL(1)
+   P384_MAC2(0, 2) P384_MAC(1, 1)                                         P384_COL(2)
+   P384_MAC2(0, 3) P384_MAC2(1, 2)                                        P384_COL(3)
+   P384_MAC2(0, 4) P384_MAC2(1, 3) P384_MAC(2, 2)                         P384_COL(4)
+   P384_MAC2(0, 5) P384_MAC2(1, 4) P384_MAC2(2, 3)                        P384_COL(5)
+   P384_MAC2(1, 5) P384_MAC2(2, 4) P384_MAC(3, 3)                         P384_COL(6)
+   P384_MAC2(2, 5) P384_MAC2(3, 4)                                        P384_COL(7)
+   P384_MAC2(3, 5) P384_MAC(4, 4)                                         P384_COL(8)
+   P384_MAC2(4, 5)                                                        P384_COL(9)
+   P384_MAC(5, 5)                                                         P384_COL(10)
+   t[11] = c0;
+
+   p384_reduce(r, t);
+}
+
+#undef P384_MAC
+#undef P384_MAC2
+#undef P384_COL
+
+static void p384_sqrn(p384_fe r, const p384_fe a, int n)
+{
+   int i;
+
+   p384_sqr(r, a);
+   for (i = 1; i < n; i++) {
+       p384_sqr(r, r);
+   }
+}
+
+/* r = a^(p-2), the exponent in binary is 255 ones, a zero, 32 ones, 64 zeros,
+   30 ones, a zero and a one.  The chain builds a^(2^k - 1) for the runs */
+static void p384_inv(p384_fe r, const p384_fe a)
+{
+   p384_fe x2, x3, x15, x30, x32, t, u;
+
+   p384_sqr(t, a);
+   p384_mul(x2, t, a);
+   p384_sqr(t, x2);
+   p384_mul(x3, t, a);
+   p384_sqrn(t, x3, 3);
+   p384_mul(u, t, x3);          /* x6 */
+   p384_sqrn(t, u, 6);
+   p384_mul(u, t, u);           /* x12 */
+   p384_sqrn(t, u, 3);
+   p384_mul(x15, t, x3);
+   p384_sqrn(t, x15, 15);
+   p384_mul(x30, t, x15);
+   p384_sqrn(t, x30, 2);
+   p384_mul(x32, t, x2);
+   p384_sqrn(t, x30, 30);
+   p384_mul(u, t, x30);         /* x60 */
+   p384_sqrn(t, u, 60);
+   p384_mul(u, t, u);           /* x120 */
+   p384_sqrn(t, u, 120);
+   p384_mul(u, t, u);           /* x240 */
+   p384_sqrn(t, u, 15);
+   p384_mul(u, t, x15);         /* x255 */
+
+   p384_sqrn(t, u, 1 + 32);
+   p384_mul(u, t, x32);
+   p384_sqrn(t, u, 64 + 30);
+   p384_mul(u, t, x30);
+   p384_sqrn(t, u, 2);
+   p384_mul(r, t, a);
+
+#ifdef LTC_CLEAN_STACK
+   zeromem(x2, sizeof(x2));
+   zeromem(x3, sizeof(x3));
+   zeromem(x15, sizeof(x15));
+   zeromem(x30, sizeof(x30));
+   zeromem(x32, sizeof(x32));
+   zeromem(t, sizeof(t));
+   zeromem(u, sizeof(u));
+#endif
+}
+
+#ifdef __clang__
+#pragma mark - Points
+#endif
+
+/* dbl-2001-b, a = -3.  The point at infinity (z = 0) doubles to itself */
+static void p384_point_dbl(p384_point *r, const p384_point *p)
+{
+   p384_fe delta, gamma, beta, alpha, t, u;
+
+   p384_sqr(delta, p->z);
+   p384_sqr(gamma, p->y);
+   p384_mul(beta, p->x, gamma);
+
+   /* alpha = 3(x - delta)(x + delta) */
+   p384_sub(t, p->x, delta);
+   p384_add(u, p->x, delta);
+   p384_mul(t, t, u);
+   p384_add(alpha, t, t);
+   p384_add(alpha, alpha, t);
+
+   /* z3 = (y + z)^2 - gamma - delta */
+   p384_add(t, p->y, p->z);
+   p384_sqr(t, t);
+   p384_sub(t, t, gamma);
+   p384_sub(r->z, t, delta);
+
+   /* x3 = alpha^2 - 8 beta */
+   p384_add(beta, beta, beta);
+   p384_add(beta, beta, beta);
+   p384_add(u, beta, beta);
+   p384_sqr(t, alpha);
+   p384_sub(r->x, t, u);
+
+   /* y3 = alpha (4 beta - x3) - 8 gamma^2 */
+   p384_sub(t, beta, r->x);
+   p384_mul(t, alpha, t);
+   p384_sqr(u, gamma);
+   p384_add(u, u, u);
+   p384_add(u, u, u);
+   p384_add(u, u, u);
+   p384_sub(r->y, t, u);
+}
+
+/* add-2007-bl.  Either side at infinity is taken care of by a constant time
+   select.  Equal inputs would need the doubling, they only meet for scalars
+   within a few digits of a multiple of the order, so that case branches */
+static void p384_point_add(p384_point *r, const p384_point *p, const p384_point *q)
+{
+   p384_fe    z1z1, z2z2, u1, u2, s1, s2, h, rr, i, j, v, t;
+   p384_point out;
+   ulong64    pinf, qinf;
+
+   pinf = p384_is_zero(p->z);
+   qinf = p384_is_zero(q->z);
+
+   p384_sqr(z1z1, p->z);
+   p384_sqr(z2z2, q->z);
+   p384_mul(u1, p->x, z2z2);
+   p384_mul(u2, q->x, z1z1);
+   p384_mul(s1, p->y, q->z);
+   p384_mul(s1, s1, z2z2);
+   p384_mul(s2, q->y, p->z);
+   p384_mul(s2, s2, z1z1);
+   p384_sub(h, u2, u1);
+   p384_sub(rr, s2, s1);
+
+   if (p384_is_zero(h) & p384_is_zero(rr) & ~pinf & ~qinf) {
+      p384_point_dbl(r, p);
+      return;
+   }
+
+   /* i = (2h)^2, j = h i, r = 2(s2 - s1), v = u1 i */
+   p384_add(i, h, h);
+   p384_sqr(i, i);
+   p384_mul(j, h, i);
+   p384_add(rr, rr, rr);
+   p384_mul(v, u1, i);
+
+   /* x3 = r^2 - j - 2v */
+   p384_sqr(t, rr);
+   p384_sub(t, t, j);
+   p384_sub(t, t, v);
+   p384_sub(out.x, t, v);
+
+   /* y3 = r (v - x3) - 2 s1 j */
+   p384_sub(t, v, out.x);
+   p384_mul(t, rr, t);
+   p384_mul(s1, s1, j);
+   p384_add(s1, s1, s1);
+   p384_sub(out.y, t, s1);
+
+   /* z3 = ((z1 + z2)^2 - z1z1 - z2z2) h */
+   p384_add(t, p->z, q->z);
+   p384_sqr(t, t);
+   p384_sub(t, t, z1z1);
+   p384_sub(t, t, z2z2);
+   p384_mul(out.z, t, h);
+
+   p384_cmov(out.x, q->x, pinf);
+   p384_cmov(out.y, q->y, pinf);
+   p384_cmov(out.z, q->z, pinf);
+   p384_cmov(out.x, p->x, qinf);
+   p384_cmov(out.y, p->y, qinf);
+   p384_cmov(out.z, p->z, qinf);
+
+   *r = out;
+}
+
+/* table[i] = (i + 1) P */
+static void p384_point_table(p384_point table[P384_TABLE], const p384_point *p)
+{
+   int i;
+
+   table[0] = *p;
+   p384_point_dbl(&table[1], p);
+   for (i = 2; i < P384_TABLE; i++) {
+       p384_point_add(&table[i], &table[i - 1], p);
+   }
+}
+
+/* r = d P for a digit in [-16, 16], every entry of the table is read */
+static void p384_point_select(p384_point *r, const p384_point table[P384_TABLE], int d)
+{
+   p384_fe  ny;
+   ulong64  neg, mask;
+   unsigned a, x;
+   int      i;
+
+   neg = 0 - (ulong64)((unsigned)d >> (sizeof(int) * 8 - 1));
+   a   = (unsigned)((d ^ (int)neg) - (int)neg);
+
+   zeromem(r, sizeof(*r));
+   for (i = 0; i < P384_TABLE; i++) {
+       x    = a ^ (unsigned)(i + 1);
+       mask = 0 - (ulong64)((x - 1) >> (sizeof(unsigned) * 8 - 1));
+       p384_cmov(r->x, table[i].x, mask);
+       p384_cmov(r->y, table[i].y, mask);
+       p384_cmov(r->z, table[i].z, mask);
+   }
+
+   p384_sub(ny, p384_p, r->y);
+   p384_cmov(ny, r->y, p384_is_zero(r->y));
+   p384_cmov(r->y, ny, neg);
+}
+
+/* k as signed digits in [-15, 16], least significant first.  A window above
+   16 becomes negative and carries into the next one */
+static void p384_recode(signed char d[P384_DIGITS], const p384_fe k)
+{
+   unsigned carry = 0, v;
+   int      i, bit, l, s;
+   ulong64  w;
+
+   for (i = 0; i < P384_DIGITS - 1; i++) {
+       bit = i * P384_WINDOW;
+       l = bit >> 6;
+       s = bit & 63;
+       w = k[l] >> s;
+       if (s > 64 - P384_WINDOW && l < 5) {
+          w |= k[l + 1] << (64 - s);
+       }
+       v = (unsigned)(w & ((1 << P384_WINDOW) - 1)) + carry;
+       carry = (v + (1 << (P384_WINDOW - 1)) - 1) >> P384_WINDOW;
+       d[i] = (signed char)((int)v - (int)(carry << P384_WINDOW));
+   }
+   d[P384_DIGITS - 1] = (signed char)carry;
+}
+
+/* back to affine, the point at infinity has no affine form */
+static int p384_point_affine(p384_fe x, p384_fe y, const p384_point *p)
+{
+   p384_fe zi, zi2;
+
+   if (p384_is_zero(p->z)) {
+      return CRYPT_INVALID_ARG;
+   }
+   p384_inv(zi, p->z);
+   p384_sqr(zi2, zi);
+   p384_mul(x, p->x, zi2);
+   p384_mul(zi2, zi2, zi);
+   p384_mul(y, p->y, zi2);
+   return CRYPT_OK;
+}
+
+#ifdef __clang__
+#pragma mark - Conversion
+#endif
+
+/* a into limbs, CRYPT_NOP when it does not fit in 384 bits */
+static int p384_from_mp(ulong64 r[6], void *a)
+{
+   unsigned char buf[48];
+   unsigned long len;
+   int           i, err;
+
+   len = mp_unsigned_bin_size(a);
+   if (len > sizeof(buf)) {
+      return CRYPT_NOP;
+   }
+   zeromem(buf, sizeof(buf));
+   if ((err = mp_to_unsigned_bin(a, buf + sizeof(buf) - len)) != CRYPT_OK) {
+      return err;
+   }
+   for (i = 0; i < 6; i++) {
+       LOAD64H(r[i], buf + 8 * (5 - i));
+   }
+#ifdef LTC_CLEAN_STACK
+   zeromem(buf, sizeof(buf));
+#endif
+   return CRYPT_OK;
+}
+
+static int p384_to_mp(void *a, const ulong64 r[6])
+{
+   unsigned char buf[48];
+   int           i, err;
+
+   for (i = 0; i < 6; i++) {
+       STORE64H(r[i], buf + 8 * (5 - i));
+   }
+   err = mp_read_unsigned_bin(a, buf, sizeof(buf));
+#ifdef LTC_CLEAN_STACK
+   zeromem(buf, sizeof(buf));
+#endif
+   return err;
+}
+
+/* CRYPT_OK when a and m are the same number */
+static int p384_is(void *a, const p384_fe m)
+{
+   p384_fe t;
+   int     err;
+
+   if ((err = p384_from_mp(t, a)) != CRYPT_OK) {
+      return err;
+   }
+   return XMEMCMP(t, m, sizeof(t)) ? CRYPT_NOP : CRYPT_OK;
+}
+
+/* a Jacobian point of the curve into limbs, coordinates reduced mod p */
+static int p384_point_from_mp(p384_point *r, ecc_point *P)
+{
+   int err;
+
+   if ((err = p384_from_mp(r->x, P->x)) != CRYPT_OK) { return err; }
+   if ((err = p384_from_mp(r->y, P->y)) != CRYPT_OK) { return err; }
+   if ((err = p384_from_mp(r->z, P->z)) != CRYPT_OK) { return err; }
+   p384_sub_if_above(r->x, r->x, 0, p384_p);
+   p384_sub_if_above(r->y, r->y, 0, p384_p);
+   p384_sub_if_above(r->z, r->z, 0, p384_p);
+   return CRYPT_OK;
+}
+
+static int p384_point_to_mp(ecc_point *R, const p384_point *p)
+{
+   p384_fe x, y;
+   int     err;
+
+   if ((err = p384_point_affine(x, y, p)) != CRYPT_OK) { return err; }
+   if ((err = p384_to_mp(R->x, x)) != CRYPT_OK)        { return err; }
+   if ((err = p384_to_mp(R->y, y)) != CRYPT_OK)        { return err; }
+   return mp_set(R->z, 1);
+}
+
+#ifdef __clang__
+#pragma mark - Scalars
+#endif
+
+/* Montgomery product mod n, r = a b / 2^384 */
+static void p384_order_mul(p384_fe r, const p384_fe a, const p384_fe b)
+{
+   ulong64  t[8], m, carry;
+   p384_dbl acc;
+   int      i, j;
+
+   for (i = 0; i < 8; i++) {
+       t[i] = 0;
+   }
+   for (i = 0; i < 6; i++) {
+       carry = 0;
+       for (j = 0; j < 6; j++) {
+           acc = (p384_dbl)a[j] * b[i] + t[j] + carry;
+           t[j] = (ulong64)acc;
+           carry = (ulong64)(acc >> 64);
+       }
+       acc = (p384_dbl)t[6] + carry;
+       t[6] = (ulong64)acc;
+       t[7] = (ulong64)(acc >> 64);
+
+       m = t[0] * P384_N0;
+       acc = (p384_dbl)m * p384_n[0] + t[0];
+       carry = (ulong64)(acc >> 64);
+       for (j = 1; j < 6; j++) {
+           acc = (p384_dbl)m * p384_n[j] + t[j] + carry;
+           t[j - 1] = (ulong64)acc;
+           carry = (ulong64)(acc >> 64);
+       }
+       acc = (p384_dbl)t[6] + carry;
+       t[5] = (ulong64)acc;
+       t[6] = t[7] + (ulong64)(acc >> 64);
+   }
+   p384_sub_if_above(r, t, t[6], p384_n);
+}
+
+/* r = 1/a mod n as a^(n-2), 4 bits of the public exponent at a time */
+static void p384_order_inv(p384_fe r, const p384_fe a)
+{
+   p384_fe  table[16], e, acc;
+   unsigned nib;
+   int      i, j;
+
+   /* table[i] = a^i, Montgomery form */
+   zeromem(table[0], sizeof(table[0]));
+   table[0][0] = 1;
+   p384_order_mul(table[0], table[0], p384_n_rr);
+   p384_order_mul(table[1], a, p384_n_rr);
+   for (i = 2; i < 16; i++) {
+       p384_order_mul(table[i], table[i - 1], table[1]);
+   }
+
+   for (i = 0; i < 6; i++) {
+       e[i] = p384_n[i];
+   }
+   e[0] -= 2;
+
+   XMEMCPY(acc, table[0], sizeof(acc));
+   for (i = 95; i >= 0; i--) {
+       for (j = 0; j < 4; j++) {
+           p384_order_mul(acc, acc, acc);
+       }
+       nib = (unsigned)(e[i >> 4] >> (4 * (i & 15))) & 15;
+       p384_order_mul(acc, acc, table[nib]);
+   }
+
+   /* out of the Montgomery domain */
+   zeromem(e, sizeof(e));
+   e[0] = 1;
+   p384_order_mul(r, acc, e);
+
+#ifdef LTC_CLEAN_STACK
+   zeromem(table, sizeof(table));
+   zeromem(acc, sizeof(acc));
+#endif
+}
+
+#ifdef __clang__
+#pragma mark - Public
+#endif
+
+/**
+   Perform a point multiplication on P-384
+   @param k        The scalar to multiply by
+   @param G        The base point
+   @param R        [out] Destination for kG, in affine form
+   @param modulus  The modulus of the field the ECC curve is in
+   @return CRYPT_OK on success, CRYPT_NOP when the curve is not P-384 or k is wider than it
+*/
+int ltc_ecc_p384_mulmod(void *k, ecc_point *G, ecc_point *R, void *modulus)
+{
+   p384_point    table[P384_TABLE], q, t;
+   p384_fe       kk;
+   signed char   d[P384_DIGITS];
+   int           i, j, err;
+
+   LTC_ARGCHK(k       != NULL);
+   LTC_ARGCHK(G       != NULL);
+   LTC_ARGCHK(R       != NULL);
+   LTC_ARGCHK(modulus != NULL);
+
+   if ((err = p384_is(modulus, p384_p)) != CRYPT_OK)   { return err; }
+   if ((err = p384_from_mp(kk, k)) != CRYPT_OK)        { return err; }
+   if ((err = p384_point_from_mp(&q, G)) != CRYPT_OK)  { goto done; }
+
+   p384_recode(d, kk);
+   p384_point_table(table, &q);
+
+   p384_point_select(&q, table, d[P384_DIGITS - 1]);
+   for (i = P384_DIGITS - 2; i >= 0; i--) {
+       for (j = 0; j < P384_WINDOW; j++) {
+           p384_point_dbl(&q, &q);
+       }
+       p384_point_select(&t, table, d[i]);
+       p384_point_add(&q, &q, &t);
+   }
+
+   err = p384_point_to_mp(R, &q);
+
+done:
+#ifdef LTC_CLEAN_STACK
+   zeromem(table, sizeof(table));
+   zeromem(&q, sizeof(q));
+   zeromem(&t, sizeof(t));
+   zeromem(kk, sizeof(kk));
+   zeromem(d, sizeof(d));
+#endif
+   return err;
+}
+
+/** Computes kA*A + kB*B = C on P-384, both scalars share the doublings
+  @param A        First point to multiply
+  @param kA       What to multiple A by
+  @param B        Second point to multiply
+  @param kB       What to multiple B by
+  @param C        [out] Destination point (can overlap with A or B), in affine form
+  @param modulus  Modulus for curve
+  @return CRYPT_OK on success, CRYPT_NOP when the curve is not P-384 or a scalar is wider than it
+*/
+int ltc_ecc_p384_mul2add(ecc_point *A, void *kA,
+                         ecc_point *B, void *kB,
+                         ecc_point *C,
+                              void *modulus)
+{
+   p384_point    tableA[P384_TABLE], tableB[P384_TABLE], q, t;
+   p384_fe       ka, kb;
+   signed char   da[P384_DIGITS], db[P384_DIGITS];
+   int           i, j, err;
+
+   LTC_ARGCHK(A       != NULL);
+   LTC_ARGCHK(B       != NULL);
+   LTC_ARGCHK(C       != NULL);
+   LTC_ARGCHK(kA      != NULL);
+   LTC_ARGCHK(kB      != NULL);
+   LTC_ARGCHK(modulus != NULL);
+
+   if ((err = p384_is(modulus, p384_p)) != CRYPT_OK)   { return err; }
+   if ((err = p384_from_mp(ka, kA)) != CRYPT_OK)       { return err; }
+   if ((err = p384_from_mp(kb, kB)) != CRYPT_OK)       { return err; }
+   if ((err = p384_point_from_mp(&q, A)) != CRYPT_OK)  { return err; }
+   p384_point_table(tableA, &q);
+   if ((err = p384_point_from_mp(&q, B)) != CRYPT_OK)  { return err; }
+   p384_point_table(tableB, &q);
+
+   p384_recode(da, ka);
+   p384_recode(db, kb);
+
+   p384_point_select(&q, tableA, da[P384_DIGITS - 1]);
+   p384_point_select(&t, tableB, db[P384_DIGITS - 1]);
+   p384_point_add(&q, &q, &t);
+   for (i = P384_DIGITS - 2; i >= 0; i--) {
+       for (j = 0; j < P384_WINDOW; j++) {
+           p384_point_dbl(&q, &q);
+       }
+       p384_point_select(&t, tableA, da[i]);
+       p384_point_add(&q, &q, &t);
+       p384_point_select(&t, tableB, db[i]);
+       p384_point_add(&q, &q, &t);
+   }
+
+   return p384_point_to_mp(C, &q);
+}
+
+/**
+   Invert mod the P-384 group order in constant time
+   @param a      The number to invert, below the order
+   @param order  The group order of the curve
+   @param b      [out] 1/a mod order
+   @return CRYPT_OK on success, CRYPT_NOP when order is not the P-384 one or a is wider than it
+*/
+int ltc_ecc_p384_invmod(void *a, void *order, void *b)
+{
+   p384_fe t;
+   int     err;
+
+   LTC_ARGCHK(a     != NULL);
+   LTC_ARGCHK(order != NULL);
+   LTC_ARGCHK(b     != NULL);
+
+   if ((err = p384_is(order, p384_n)) != CRYPT_OK)     { return err; }
+   if ((err = p384_from_mp(t, a)) != CRYPT_OK)         { return err; }
+
+   p384_sub_if_above(t, t, 0, p384_n);
+   p384_order_inv(t, t);
+   err = p384_to_mp(b, t);
+
+#ifdef LTC_CLEAN_STACK
+   zeromem(t, sizeof(t));
+#endif
+   return err;
+}
+
+#endif /* LTC_ECC_P384 */
+#endif /* LTC_MECC */
+
+/* $Source$ */
+/* $Revision$ */
+/* $Date$ */
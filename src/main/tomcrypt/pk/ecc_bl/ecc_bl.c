@@ -129,102 +129,655 @@ static void hexdump(const char* title, const unsigned char *s, int l) {
 }
 #endif
 
-#ifdef DO_NOT_USE
-static mod3617(void *a, void *m, void *r) 
-{
-
-    unsigned char buf[500];
-    unsigned char bufbin[200];
-    unsigned char bufbin1[52];
-    unsigned char bufbin2[52] = {0};
-    unsigned char x, carry = 0;
-    unsigned char *b0, *b1;
-    int cmp, err, offset, size;
-    void *tmp;
-
-    cmp = mp_cmp(m, a);
-    if (cmp == LTC_MP_EQ) {      /* a is equal modulo, set result to zero */
-        mp_set(r, 0);
-        return CRYPT_OK;
+#ifdef LTC_ECC_BL_FE
+
+/*
+ * Curve41417 field arithmetic on fixed width limbs.  p = 2^414 - 17, an element
+ * is eight 52 bit limbs in 64 bit words, little endian, so 2^416 = 4 * 17 = 68
+ * mod p folds the top of a product back to the bottom.  Every function leaves
+ * its result carried: limbs below 2^52 except the lowest two, which may be a
+ * few bits over.  That keeps sums of eight limb products far below 2^128.
+ * Only bl_freeze makes the value canonical.  Nothing branches on the data.
+ */
+
+typedef unsigned __int128 bl_dbl;
+typedef ulong64 bl_fe[8];
+
+typedef struct {
+    bl_fe x, y, z, t;
+} bl_point;
+
+#define BL_MASK     ((((ulong64)1) << 52) - 1)
+#define BL_MASK50   ((((ulong64)1) << 50) - 1)
+#define BL_FOLD     68
+#define BL_D        3617
+
+static const bl_fe bl_p = {
+    0xFFFFFFFFFFFEFULL, 0xFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFULL,
+    0xFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFULL, 0x3FFFFFFFFFFFFULL
+};
+
+/* 8p, big enough limb by limb to subtract any carried value from */
+static const bl_fe bl_8p = {
+    0x7FFFFFFFFFFF78ULL, 0x7FFFFFFFFFFFF8ULL, 0x7FFFFFFFFFFFF8ULL, 0x7FFFFFFFFFFFF8ULL,
+    0x7FFFFFFFFFFFF8ULL, 0x7FFFFFFFFFFFF8ULL, 0x7FFFFFFFFFFFF8ULL, 0x1FFFFFFFFFFFF8ULL
+};
+
+/* the limb loops are spelled out, the carries chain from one to the next */
+#define BL_LIMB7(S)     S(0) S(1) S(2) S(3) S(4) S(5) S(6)
+#define BL_LIMB8(S)     BL_LIMB7(S) S(7)
+
+static void bl_copy(bl_fe r, const bl_fe a)
+{
+    int i;
+    for (i = 0; i < 8; i++) r[i] = a[i];
+}
+
+static void bl_set(bl_fe r, ulong64 v)
+{
+    int i;
+    r[0] = v;
+    for (i = 1; i < 8; i++) r[i] = 0;
+}
+
+static void bl_carry(bl_fe r)
+{
+    ulong64 c;
+
+#define BL_CARRY(i)     c = r[i] >> 52;  r[i] &= BL_MASK;  r[i + 1] += c;
+    BL_LIMB7(BL_CARRY)
+#undef BL_CARRY
+    c = r[7] >> 52;  r[7] &= BL_MASK;  r[0] += BL_FOLD * c;
+}
+
+static void bl_add(bl_fe r, const bl_fe a, const bl_fe b)
+{
+#define BL_ADD(i)       r[i] = a[i] + b[i];
+    BL_LIMB8(BL_ADD)
+#undef BL_ADD
+    bl_carry(r);
+}
+
+static void bl_sub(bl_fe r, const bl_fe a, const bl_fe b)
+{
+#define BL_SUB(i)       r[i] = a[i] + bl_8p[i] - b[i];
+    BL_LIMB8(BL_SUB)
+#undef BL_SUB
+    bl_carry(r);
+}
+
+/* the 128 bit columns of a product back to carried limbs */
+static void bl_carry_wide(bl_fe r, bl_dbl *c)
+{
+    bl_dbl t;
+
+#define BL_CARRY(i)     c[i + 1] += c[i] >> 52;  r[i] = (ulong64)c[i] & BL_MASK;
+    BL_LIMB7(BL_CARRY)
+#undef BL_CARRY
+    r[7] = (ulong64)c[7] & BL_MASK;
+    t    = (bl_dbl)r[0] + (c[7] >> 52) * BL_FOLD;
+    r[0] = (ulong64)t & BL_MASK;
+    r[1] += (ulong64)(t >> 52);
+}
+
+static void bl_mul(bl_fe r, const bl_fe a, const bl_fe b)
+{
+    ulong64 f[8];
+    bl_dbl  c[8];
+
+    /* the products that land at 2^416 and above come back times 68 */
+#define BL_FOLDB(i)     f[i] = BL_FOLD * b[i];
+    BL_LIMB8(BL_FOLDB)
+#undef BL_FOLDB
+
+    c[0] = (bl_dbl)a[0] * b[0] + (bl_dbl)a[1] * f[7] + (bl_dbl)a[2] * f[6] + (bl_dbl)a[3] * f[5]
+         + (bl_dbl)a[4] * f[4] + (bl_dbl)a[5] * f[3] + (bl_dbl)a[6] * f[2] + (bl_dbl)a[7] * f[1];
+    c[1] = (bl_dbl)a[0] * b[1] + (bl_dbl)a[1] * b[0] + (bl_dbl)a[2] * f[7] + (bl_dbl)a[3] * f[6]
+         + (bl_dbl)a[4] * f[5] + (bl_dbl)a[5] * f[4] + (bl_dbl)a[6] * f[3] + (bl_dbl)a[7] * f[2];
+    c[2] = (bl_dbl)a[0] * b[2] + (bl_dbl)a[1] * b[1] + (bl_dbl)a[2] * b[0] + (bl_dbl)a[3] * f[7]
+         + (bl_dbl)a[4] * f[6] + (bl_dbl)a[5] * f[5] + (bl_dbl)a[6] * f[4] + (bl_dbl)a[7] * f[3];
+    c[3] = (bl_dbl)a[0] * b[3] + (bl_dbl)a[1] * b[2] + (bl_dbl)a[2] * b[1] + (bl_dbl)a[3] * b[0]
+         + (bl_dbl)a[4] * f[7] + (bl_dbl)a[5] * f[6] + (bl_dbl)a[6] * f[5] + (bl_dbl)a[7] * f[4];
+    c[4] = (bl_dbl)a[0] * b[4] + (bl_dbl)a[1] * b[3] + (bl_dbl)a[2] * b[2] + (bl_dbl)a[3] * b[1]
+         + (bl_dbl)a[4] * b[0] + (bl_dbl)a[5] * f[7] + (bl_dbl)a[6] * f[6] + (bl_dbl)a[7] * f[5];
+    c[5] = (bl_dbl)a[0] * b[5] + (bl_dbl)a[1] * b[4] + (bl_dbl)a[2] * b[3] + (bl_dbl)a[3] * b[2]
+         + (bl_dbl)a[4] * b[1] + (bl_dbl)a[5] * b[0] + (bl_dbl)a[6] * f[7] + (bl_dbl)a[7] * f[6];
+    c[6] = (bl_dbl)a[0] * b[6] + (bl_dbl)a[1] * b[5] + (bl_dbl)a[2] * b[4] + (bl_dbl)a[3] * b[3]
+         + (bl_dbl)a[4] * b[2] + (bl_dbl)a[5] * b[1] + (bl_dbl)a[6] * b[0] + (bl_dbl)a[7] * f[7];
+    c[7] = (bl_dbl)a[0] * b[7] + (bl_dbl)a[1] * b[6] + (bl_dbl)a[2] * b[5] + (bl_dbl)a[3] * b[4]
+         + (bl_dbl)a[4] * b[3] + (bl_dbl)a[5] * b[2] + (bl_dbl)a[6] * b[1] + (bl_dbl)a[7] * b[0];
+
+    bl_carry_wide(r, c);
+}
+
+static void bl_sqr(bl_fe r, const bl_fe a)
+{
+    ulong64 d[8], f[8];
+    bl_dbl  c[8];
+
+#define BL_PREP(i)      d[i] = 2 * a[i];  f[i] = BL_FOLD * a[i];
+    BL_LIMB8(BL_PREP)
+#undef BL_PREP
+
+    c[0] = (bl_dbl)a[0] * a[0] + (bl_dbl)d[1] * f[7] + (bl_dbl)d[2] * f[6] + (bl_dbl)d[3] * f[5] + (bl_dbl)a[4] * f[4];
+    c[1] = (bl_dbl)d[0] * a[1] + (bl_dbl)d[2] * f[7] + (bl_dbl)d[3] * f[6] + (bl_dbl)d[4] * f[5];
+    c[2] = (bl_dbl)d[0] * a[2] + (bl_dbl)a[1] * a[1] + (bl_dbl)d[3] * f[7] + (bl_dbl)d[4] * f[6] + (bl_dbl)a[5] * f[5];
+    c[3] = (bl_dbl)d[0] * a[3] + (bl_dbl)d[1] * a[2] + (bl_dbl)d[4] * f[7] + (bl_dbl)d[5] * f[6];
+    c[4] = (bl_dbl)d[0] * a[4] + (bl_dbl)d[1] * a[3] + (bl_dbl)a[2] * a[2] + (bl_dbl)d[5] * f[7] + (bl_dbl)a[6] * f[6];
+    c[5] = (bl_dbl)d[0] * a[5] + (bl_dbl)d[1] * a[4] + (bl_dbl)d[2] * a[3] + (bl_dbl)d[6] * f[7];
+    c[6] = (bl_dbl)d[0] * a[6] + (bl_dbl)d[1] * a[5] + (bl_dbl)d[2] * a[4] + (bl_dbl)a[3] * a[3] + (bl_dbl)a[7] * f[7];
+    c[7] = (bl_dbl)d[0] * a[7] + (bl_dbl)d[1] * a[6] + (bl_dbl)d[2] * a[5] + (bl_dbl)d[3] * a[4];
+
+    bl_carry_wide(r, c);
+}
+
+static void bl_sqrn(bl_fe r, const bl_fe a, int n)
+{
+    bl_sqr(r, a);
+    while (--n > 0) bl_sqr(r, r);
+}
+
+static void bl_mul_small(bl_fe r, const bl_fe a, ulong64 s)
+{
+    bl_dbl c[8];
+
+#define BL_MULS(i)      c[i] = (bl_dbl)a[i] * s;
+    BL_LIMB8(BL_MULS)
+#undef BL_MULS
+    bl_carry_wide(r, c);
+}
+
+/* the canonical value, below p */
+static void bl_freeze(bl_fe r, const bl_fe a)
+{
+    bl_fe   t;
+    ulong64 c, mask;
+    int     i, pass;
+
+    bl_copy(r, a);
+    bl_carry(r);
+
+    /* fold everything at 2^414 and above, twice brings it below 2^414 */
+    for (pass = 0; pass < 2; pass++) {
+        c = r[7] >> 50;  r[7] &= BL_MASK50;  r[0] += 17 * c;
+        for (i = 0; i < 7; i++) {
+            c = r[i] >> 52;  r[i] &= BL_MASK;  r[i + 1] += c;
+        }
     }
-    if (cmp == LTC_MP_GT) {      /* modulo is greater than a - copy a to r and return it */
-        mp_copy(a, r);
-        return CRYPT_OK;
+
+    /* then subtract p if r + 17 reaches 2^414 */
+    t[0] = r[0] + 17;
+    for (i = 0; i < 7; i++) {
+        c = t[i] >> 52;  t[i] &= BL_MASK;  t[i + 1] = r[i + 1] + c;
     }
+    mask = 0 - (t[7] >> 50);
+    t[7] &= BL_MASK50;
+    for (i = 0; i < 8; i++) r[i] ^= mask & (r[i] ^ t[i]);
+}
 
-//    mp_toradix(a, buf, 16); fprintf(stderr, "         a: %s\n", buf);
-    if ((err = mp_init(&tmp)) != CRYPT_OK) {
-        return err;
+static int bl_is_zero(const bl_fe a)
+{
+    bl_fe   t;
+    ulong64 z = 0;
+    int     i;
+
+    bl_freeze(t, a);
+    for (i = 0; i < 8; i++) z |= t[i];
+    return z == 0;
+}
+
+static int bl_equal(const bl_fe a, const bl_fe b)
+{
+    bl_fe t;
+
+    bl_sub(t, a, b);
+    return bl_is_zero(t);
+}
+
+/* a^(2^409 - 1), shared by the inverse and the square root */
+static void bl_pow_409(bl_fe r, const bl_fe a)
+{
+    bl_fe x2, x4, x8, x16, x32, x64, x128, t;
+
+    bl_sqr(t, a);            bl_mul(x2, t, a);
+    bl_sqrn(t, x2, 2);       bl_mul(x4, t, x2);
+    bl_sqrn(t, x4, 4);       bl_mul(x8, t, x4);
+    bl_sqrn(t, x8, 8);       bl_mul(x16, t, x8);
+    bl_sqrn(t, x16, 16);     bl_mul(x32, t, x16);
+    bl_sqrn(t, x32, 32);     bl_mul(x64, t, x32);
+    bl_sqrn(t, x64, 64);     bl_mul(x128, t, x64);
+    bl_sqrn(t, x128, 128);   bl_mul(t, t, x128);          /* 2^256 - 1 */
+    bl_sqrn(t, t, 128);      bl_mul(t, t, x128);          /* 2^384 - 1 */
+    bl_sqrn(t, t, 16);       bl_mul(t, t, x16);           /* 2^400 - 1 */
+    bl_sqrn(t, t, 8);        bl_mul(t, t, x8);            /* 2^408 - 1 */
+    bl_sqr(t, t);            bl_mul(r, t, a);             /* 2^409 - 1 */
+}
+
+/* a^(p-2) = a^((2^409 - 1) * 2^5 + 0b01101), zero for zero */
+static void bl_inv(bl_fe r, const bl_fe a)
+{
+    bl_fe t;
+
+    bl_pow_409(t, a);
+    bl_sqr(t, t);
+    bl_sqr(t, t);  bl_mul(t, t, a);
+    bl_sqr(t, t);  bl_mul(t, t, a);
+    bl_sqr(t, t);
+    bl_sqr(t, t);  bl_mul(r, t, a);
+}
+
+/* p = 3 mod 4, so a root is a^((p+1)/4) = a^((2^410 - 1) * 4) */
+static int bl_sqrt(bl_fe r, const bl_fe a)
+{
+    bl_fe t;
+
+    bl_pow_409(t, a);
+    bl_sqr(t, t);  bl_mul(t, t, a);
+    bl_sqrn(r, t, 2);
+
+    bl_sqr(t, r);
+    return bl_equal(t, a);
+}
+
+static void bl_from_bytes(bl_fe r, const unsigned char *in)
+{
+    ulong64 acc = 0;
+    int     i, bits = 0, j = 0;
+
+    /* 52 big endian bytes are exactly the eight limbs */
+    for (i = 51; i >= 0; i--) {
+        acc |= (ulong64)in[i] << bits;
+        bits += 8;
+        if (bits >= 52) {
+            r[j++] = acc & BL_MASK;
+            acc >>= 52;
+            bits -= 52;
+        }
     }
+}
+
+static void bl_to_bytes(unsigned char *out, const bl_fe a)
+{
+    bl_fe   t;
+    ulong64 acc = 0;
+    int     i, bits = 0, j = 0;
+
+    bl_freeze(t, a);
+    for (i = 51; i >= 0; i--) {
+        if (bits < 8) {
+            acc |= t[j++] << bits;
+            bits += 52;
+        }
+        out[i] = (unsigned char)acc;
+        acc >>= 8;
+        bits -= 8;
+    }
+}
+
+static int bl_from_mp(bl_fe r, void *a)
+{
+    unsigned char buf[52];
+    unsigned long size;
+    int           err;
+
     size = mp_unsigned_bin_size(a);
-    offset = size - 52;
-    mp_to_unsigned_bin(a, bufbin);
-    memcpy(bufbin1, &bufbin[offset], 52);
-    bufbin1[0] &= 0x3f;
+    if (mp_cmp_d(a, 0) == LTC_MP_LT || size > sizeof(buf)) {
+        return CRYPT_INVALID_ARG;
+    }
+    zeromem(buf, sizeof(buf));
+    if ((err = mp_to_unsigned_bin(a, buf + sizeof(buf) - size)) != CRYPT_OK) {
+        return err;
+    }
+    bl_from_bytes(r, buf);
+    bl_carry(r);
+    return CRYPT_OK;
+}
+
+static int bl_to_mp(void *r, const bl_fe a)
+{
+    unsigned char buf[52];
+
+    bl_to_bytes(buf, a);
+    return mp_read_unsigned_bin(r, buf, sizeof(buf));
+}
+
+/* only Curve41417 is in ltc_ecc_bl_sets, anything else is a caller error */
+static int bl_check_curve(void *modulus, void *b)
+{
+    bl_fe m;
+    int   err, i;
+    ulong64 diff = 0;
+
+    if ((err = bl_from_mp(m, modulus)) != CRYPT_OK) {
+        return err;
+    }
+    for (i = 0; i < 8; i++) diff |= m[i] ^ bl_p[i];
+    if (diff != 0 || (b != NULL && mp_cmp_d(b, BL_D) != LTC_MP_EQ)) {
+        return CRYPT_INVALID_ARG;
+    }
+    return CRYPT_OK;
+}
+
+/*
+ * Extended Edwards points (X : Y : Z : T) with x = X/Z, y = Y/Z and T = XY/Z,
+ * on x^2 + y^2 = 1 + d x^2 y^2 with d = 3617.  d is not a square, so the
+ * addition law is complete: (0 : 1 : 1 : 0) is the neutral point, a point
+ * added to itself or to its negative goes through the same formulas, and no
+ * input needs a special case.
+ */
+
+#define BL_WINDOW   5
+#define BL_TABLE    (1 << (BL_WINDOW - 1))      /* P, 3P, ..., 31P */
+#define BL_DIGITS   84                          /* 83 windows of 5 bits and a top digit cover 416 bits */
+
+static void bl_cmov(bl_fe r, const bl_fe a, ulong64 mask)
+{
+#define BL_CMOV(i)      r[i] ^= mask & (r[i] ^ a[i]);
+    BL_LIMB8(BL_CMOV)
+#undef BL_CMOV
+}
+
+/* (XZ : YZ : Z^2 : XY) is the projective point with T filled in */
+static int bl_point_from_mp(bl_point *R, ecc_point *P)
+{
+    bl_fe x, y, z;
+    int   err;
+
+    if ((err = bl_from_mp(x, P->x)) != CRYPT_OK) { return err; }
+    if ((err = bl_from_mp(y, P->y)) != CRYPT_OK) { return err; }
+    if ((err = bl_from_mp(z, P->z)) != CRYPT_OK) { return err; }
+
+    bl_mul(R->x, x, z);
+    bl_mul(R->y, y, z);
+    bl_sqr(R->z, z);
+    bl_mul(R->t, x, y);
+    return CRYPT_OK;
+}
+
+static int bl_point_to_mp(ecc_point *R, const bl_point *P)
+{
+    int err;
+
+    if ((err = bl_to_mp(R->x, P->x)) != CRYPT_OK) { return err; }
+    if ((err = bl_to_mp(R->y, P->y)) != CRYPT_OK) { return err; }
+    return bl_to_mp(R->z, P->z);
+}
+
+/* add-2008-hwcd with a = 1, R may be P or Q */
+static void bl_point_add(bl_point *R, const bl_point *P, const bl_point *Q)
+{
+    bl_fe a, b, c, d, e, f, g, h, t;
+
+    bl_mul(a, P->x, Q->x);                  /* A = X1 X2 */
+    bl_mul(b, P->y, Q->y);                  /* B = Y1 Y2 */
+    bl_mul(c, P->t, Q->t);
+    bl_mul_small(c, c, BL_D);               /* C = d T1 T2 */
+    bl_mul(d, P->z, Q->z);                  /* D = Z1 Z2 */
+    bl_add(e, P->x, P->y);
+    bl_add(t, Q->x, Q->y);
+    bl_mul(e, e, t);
+    bl_sub(e, e, a);
+    bl_sub(e, e, b);                        /* E = (X1 + Y1)(X2 + Y2) - A - B */
+    bl_sub(f, d, c);                        /* F = D - C */
+    bl_add(g, d, c);                        /* G = D + C */
+    bl_sub(h, b, a);                        /* H = B - A */
+    bl_mul(R->x, e, f);
+    bl_mul(R->y, g, h);
+    bl_mul(R->t, e, h);
+    bl_mul(R->z, f, g);
+}
+
+/* dbl-2008-hwcd with a = 1, R may be P.  T is not an input, and is only
+   written when an addition comes next */
+static void bl_point_dbl(bl_point *R, const bl_point *P, int withT)
+{
+    bl_fe a, b, c, e, f, g, h;
+
+    bl_sqr(a, P->x);                        /* A = X^2 */
+    bl_sqr(b, P->y);                        /* B = Y^2 */
+    bl_sqr(c, P->z);
+    bl_add(c, c, c);                        /* C = 2 Z^2 */
+    bl_add(e, P->x, P->y);
+    bl_sqr(e, e);
+    bl_sub(e, e, a);
+    bl_sub(e, e, b);                        /* E = (X + Y)^2 - A - B */
+    bl_add(g, a, b);                        /* G = A + B */
+    bl_sub(f, g, c);                        /* F = G - C */
+    bl_sub(h, a, b);                        /* H = A - B */
+    bl_mul(R->x, e, f);
+    bl_mul(R->y, g, h);
+    bl_mul(R->z, f, g);
+    if (withT) {
+        bl_mul(R->t, e, h);
+    }
+}
+
+/* -(X : Y : Z : T) is (-X : Y : Z : -T), done when mask is all ones */
+static void bl_point_cneg(bl_point *R, ulong64 mask)
+{
+    bl_fe zero, n;
+
+    bl_set(zero, 0);
+    bl_sub(n, zero, R->x);
+    bl_cmov(R->x, n, mask);
+    bl_sub(n, zero, R->t);
+    bl_cmov(R->t, n, mask);
+}
+
+static void bl_point_cmov(bl_point *R, const bl_point *P, ulong64 mask)
+{
+    bl_cmov(R->x, P->x, mask);
+    bl_cmov(R->y, P->y, mask);
+    bl_cmov(R->z, P->z, mask);
+    bl_cmov(R->t, P->t, mask);
+}
+
+/* P, 3P, ..., 31P */
+static void bl_point_table(bl_point table[BL_TABLE], const bl_point *P)
+{
+    bl_point P2;
+    int      i;
+
+    bl_point_dbl(&P2, P, 1);
+    table[0] = *P;
+    for (i = 1; i < BL_TABLE; i++) {
+        bl_point_add(&table[i], &table[i - 1], &P2);
+    }
+}
+
+/* r = d P for an odd digit in [-31, 31], every entry of the table is read */
+static void bl_point_select(bl_point *R, const bl_point table[BL_TABLE], int d)
+{
+    ulong64  neg, mask;
+    unsigned a, x;
+    int      i;
+
+    neg = 0 - (ulong64)((unsigned)d >> (sizeof(int) * 8 - 1));
+    a   = (unsigned)((d ^ (int)neg) - (int)neg) >> 1;
+
+    zeromem(R, sizeof(*R));
+    for (i = 0; i < BL_TABLE; i++) {
+        x    = a ^ (unsigned)i;
+        mask = 0 - (ulong64)((x - 1) >> (sizeof(unsigned) * 8 - 1));
+        bl_point_cmov(R, &table[i], mask);
+    }
+    bl_point_cneg(R, neg);
+}
+
+/* an odd k, 52 bytes little endian with a zero byte above, as odd digits in
+   [-31, 31] least significant first.  Each window of 6 bits with its low bit
+   forced to one gives (w | 1) - 32, which leaves the bits above odd again */
+static void bl_recode(signed char d[BL_DIGITS], const unsigned char k[53])
+{
+    unsigned w;
+    int      i, bit;
+
+    for (i = 0; i < BL_DIGITS; i++) {
+        bit = i * BL_WINDOW;
+        w   = ((unsigned)k[bit >> 3] | ((unsigned)k[(bit >> 3) + 1] << 8)) >> (bit & 7);
+        w   = (w & 0x3F) | 1;
+        d[i] = (signed char)(i < BL_DIGITS - 1 ? (int)w - 32 : (int)w);
+    }
+}
+
+static int bl_point_affine(bl_point *P)
+{
+    bl_fe zi;
+
+    if (bl_is_zero(P->z)) {
+        return CRYPT_INVALID_ARG;
+    }
+    bl_inv(zi, P->z);
+    bl_mul(P->x, P->x, zi);
+    bl_mul(P->y, P->y, zi);
+    bl_mul(P->t, P->x, P->y);
+    bl_set(P->z, 1);
+    return CRYPT_OK;
+}
+
+int ltc_ecc_bl_map(ecc_point *P, void *modulus, ecc_point *R)
+{
+    bl_point T;
+    int      err;
+
+    if ((err = bl_check_curve(modulus, NULL)) != CRYPT_OK) { return err; }
+    if ((err = bl_point_from_mp(&T, P)) != CRYPT_OK)      { return err; }
+    if ((err = bl_point_affine(&T)) != CRYPT_OK)          { return err; }
+    return bl_point_to_mp(R, &T);
+}
+
+int ltc_ecc_bl_projective_add_point(ecc_point *P, ecc_point *Q, ecc_point *R, void *modulus, void *b)
+{
+    bl_point tP, tQ;
+    int      err;
+
+    /* callers still use (0, 0, 0) as the point at infinity */
+    if (mp_cmp_d(P->z, 0) == LTC_MP_EQ) {
+        if ((err = mp_copy(Q->x, R->x)) != CRYPT_OK)  { return err; }
+        if ((err = mp_copy(Q->y, R->y)) != CRYPT_OK)  { return err; }
+        if ((err = mp_copy(Q->z, R->z)) != CRYPT_OK)  { return err; }
+        return CRYPT_OK;
+    }
+
+    if (mp_cmp_d(Q->z, 0) == LTC_MP_EQ) {
+        if ((err = mp_copy(P->x, R->x)) != CRYPT_OK)  { return err; }
+        if ((err = mp_copy(P->y, R->y)) != CRYPT_OK)  { return err; }
+        if ((err = mp_copy(P->z, R->z)) != CRYPT_OK)  { return err; }
+        return CRYPT_OK;
+    }
+
+    if ((err = bl_check_curve(modulus, b)) != CRYPT_OK) { return err; }
+    if ((err = bl_point_from_mp(&tP, P)) != CRYPT_OK)   { return err; }
+    if ((err = bl_point_from_mp(&tQ, Q)) != CRYPT_OK)   { return err; }
+
+    bl_point_add(&tP, &tP, &tQ);
+    return bl_point_to_mp(R, &tP);
+}
+
+int ltc_ecc_bl_projective_dbl_point(ecc_point *P, ecc_point *R, void *modulus)
+{
+    bl_point T;
+    int      err;
+
+    if ((err = bl_check_curve(modulus, NULL)) != CRYPT_OK) { return err; }
+    if ((err = bl_point_from_mp(&T, P)) != CRYPT_OK)      { return err; }
+
+    bl_point_dbl(&T, &T, 0);
+    return bl_point_to_mp(R, &T);
+}
 
-    b0 = bufbin;
-    b1 = bufbin2;
-//    fprintf(stderr, "size: %d, offset: %d ", size, offset);
-    while (offset) {
-        x = *b0++;
-        *b1++ = (x >> 6) | carry;
-        carry = x << 2;
-        offset--;
+/*
+ * kG with a fixed window of signed odd digits.  The run of doublings and
+ * additions is the same for every k of up to 52 bytes, and the table is read
+ * in full for every digit.  An even k is done as k + 1, then G is taken back
+ * off, also without a branch.
+ */
+int ltc_ecc_bl_mulmod(void *k, ecc_point *G, ecc_point *R, void *modulus, void *b, int map)
+{
+    unsigned char big[52], little[53];      /* Max length of Curve41417 data */
+    unsigned long size;
+    signed char   d[BL_DIGITS];
+    bl_point      table[BL_TABLE], acc, t;
+    ulong64       even;
+    int           i, j, err;
+
+    if ((err = bl_check_curve(modulus, b)) != CRYPT_OK) { return err; }
+
+    size = mp_unsigned_bin_size(k);
+    if (mp_cmp_d(k, 0) == LTC_MP_LT || size > sizeof(big)) {
+        return CRYPT_INVALID_ARG;
     }
-//    fprintf(stderr, "carry: %x, x shifted: %x, x: %x\n", carry, *b0 >> 6, *b0);
-    *b1 = (*b0 >> 6) | carry;
+    zeromem(big, sizeof(big));
+    if ((err = mp_to_unsigned_bin(k, big + sizeof(big) - size)) != CRYPT_OK) { goto err_exit; }
+    if ((err = bl_point_from_mp(&acc, G)) != CRYPT_OK)  { goto err_exit; }
 
-    mp_read_unsigned_bin(r, bufbin2, size - 52 + 1);
-//    mp_toradix(r, buf, 16); fprintf(stderr, "         r: %s\n", buf);
+    for (i = 0; i < 52; i++) little[i] = big[51 - i];
+    little[52] = 0;
 
-    if ((err = mp_mul_d(r, 17, r)) != CRYPT_OK)   {goto err_exit;}
+    even = 0 - (ulong64)(~little[0] & 1);
+    little[0] |= 1;
+    bl_recode(d, little);
 
-    mp_read_unsigned_bin(tmp, bufbin1, 52);
-    if ((err = mp_add(r, tmp, r)) != CRYPT_OK)    {goto err_exit;}
+    bl_point_table(table, &acc);
 
-    while (mp_cmp(r, m) >= LTC_MP_EQ) {
-        if ((err = mp_sub(r, m, r)) != CRYPT_OK)  {goto err_exit;}
+    bl_point_select(&acc, table, d[BL_DIGITS - 1]);
+    for (i = BL_DIGITS - 2; i >= 0; i--) {
+        for (j = 0; j < BL_WINDOW; j++) {
+            bl_point_dbl(&acc, &acc, j == BL_WINDOW - 1);
+        }
+        bl_point_select(&t, table, d[i]);
+        bl_point_add(&acc, &acc, &t);
+    }
+
+    t = table[0];
+    bl_point_cneg(&t, (ulong64)-1);
+    bl_point_add(&t, &acc, &t);
+    bl_point_cmov(&acc, &t, even);
+
+    /* map R back from projective space if requested */
+    if (map) {
+        if ((err = bl_point_affine(&acc)) != CRYPT_OK) { goto err_exit; }
     }
+    err = bl_point_to_mp(R, &acc);
 
 err_exit:
-    mp_clear(tmp);
+#ifdef LTC_CLEAN_STACK
+    zeromem(big, sizeof(big));
+    zeromem(little, sizeof(little));
+    zeromem(d, sizeof(d));
+    zeromem(table, sizeof(table));
+    zeromem(&acc, sizeof(acc));
+    zeromem(&t, sizeof(t));
+#endif
     return err;
-/*
-    bnExtractLittleBytes(a, buffer, 0, 52);
-    buffer[51] &= 0x3f;
+}
 
-    bnCopy(&tmp, a);
-    bnRShift(&tmp, 414);
-    bnCopy(r, &tmp);
-    bnLShift(r, 4);
-    bnAdd(r, &tmp);
+int ltc_ecc_bl_sqrtmod(void *a, void *modulus, void *r)
+{
+    bl_fe x, s;
+    int   err;
 
-    bnInsertLittleBytes(&tmp, buffer, 0, 52);
+    if ((err = bl_check_curve(modulus, NULL)) != CRYPT_OK) { return err; }
+    if ((err = bl_from_mp(x, a)) != CRYPT_OK)             { return err; }
 
-    bnAdd(r, &tmp);
-    while (bnCmp(r, modulo) >= 0) {
-        bnSub(r, modulo);
+    if (!bl_sqrt(s, x)) {
+        return CRYPT_INVALID_ARG;
     }
-    bnEnd(&tmp);
-    return 0;
-*/
+    return bl_to_mp(r, s);
 }
-#endif
+
+#else
+
+/* no 128 bit type, the generic mp_int code */
+
 /* 
  * Define some local macros to reduce typing and enable changing function calls
  * ATTENTION: these macros use the *first* parameter (r) as result (was easier to convert from some existing code)
  */
-#if 1
 #define MUL_MOD(r, a, b, m, mp) {if((err = mp_mul(a, b, r)) != CRYPT_OK){goto err_exit;} if ((err = mp_mod(r, m, r)) != CRYPT_OK){ goto err_exit; }}
 
 #define SQR_MOD(r, a, m, mp) {if((err = mp_sqr(a, r)) != CRYPT_OK){goto err_exit;} if ((err = mp_mod(r, m, r)) != CRYPT_OK){ goto err_exit; }}
 
-#else
-#define MUL_MOD(r, a, b, m, mp) {if((err = mp_mul(a, b, r)) != CRYPT_OK){goto err_exit;} if ((err = mod3617(r, m, r)) != CRYPT_OK){ goto err_exit; }}
-
-#define SQR_MOD(r, a, m, mp) {if((err = mp_sqr(a, r)) != CRYPT_OK){goto err_exit;} if ((err = mod3617(r, m, r)) != CRYPT_OK){ goto err_exit; }}
-
-#endif
 
 #define ADD_MOD(r, a, b, m) {if ((err = mp_add (a, b, r)) != CRYPT_OK){goto err_exit;} if (mp_cmp (r, m) >= LTC_MP_EQ) {\
 if ((err = mp_sub (r, m, r)) != CRYPT_OK){goto err_exit;} }}
@@ -233,6 +786,7 @@ if ((err = mp_sub (r, m, r)) != CRYPT_OK){goto err_exit;} }}
 if ((err = mp_sub (a, b, r)) != CRYPT_OK){goto err_exit;} }
 
 
+
 int ltc_ecc_bl_map(ecc_point *P, void *modulus, ecc_point *R)
 {
     int err;
@@ -400,7 +954,6 @@ err_exit:
     return err;
 }
 
-#ifndef WORKING
 int ltc_ecc_bl_mulmod(void *k, ecc_point *G, ecc_point *R, void *modulus, void *b, int map)
 {
     unsigned char buffer[52];       // Max length of Curve3617 data
@@ -447,83 +1000,7 @@ err_exit:
     ltc_ecc_del_point(n);
     return err;
 }
-#else
-int ltc_ecc_bl_mulmod(void *k, ecc_point *G, ecc_point *R, void *modulus, void *b, int map)
-{
-    unsigned char buffer[52];       // Max length of Curve3617 data
-    int size;
-    int bits;
-    int i, offset, mask = 0, bit;
-    int err;
-    void       *mu, *mp;
-    ecc_point *n;
-
-    /* init montgomery reduction */
-    if ((err = mp_montgomery_setup(modulus, &mp)) != CRYPT_OK) {
-        return err;
-    }
-    if ((err = mp_init(&mu)) != CRYPT_OK) {
-        mp_montgomery_free(mp);
-        return err;
-    }
-    if ((err = mp_montgomery_normalization(mu, modulus)) != CRYPT_OK) {
-        mp_montgomery_free(mp);
-        mp_clear(mu);
-        return err;
-    }
-    size = mp_unsigned_bin_size(k) - 1;
-    bits = mp_count_bits(k);
-
-    mp_to_unsigned_bin(k, buffer);
- 
-    n = ltc_ecc_new_point();
-    /* tG = G  and convert to montgomery */
-    if (mp_cmp_d(mu, 1) == LTC_MP_EQ) {
-        if ((err = mp_copy(G->x, n->x)) != CRYPT_OK)                                  { goto err_exit; }
-        if ((err = mp_copy(G->y, n->y)) != CRYPT_OK)                                  { goto err_exit; }
-        if ((err = mp_copy(G->z, n->z)) != CRYPT_OK)                                  { goto err_exit; }
-    } 
-    else {
-        if ((err = mp_mulmod(G->x, mu, modulus, n->x)) != CRYPT_OK)                   { goto err_exit; }
-        if ((err = mp_mulmod(G->y, mu, modulus, n->y)) != CRYPT_OK)                   { goto err_exit; }
-        if ((err = mp_mulmod(G->z, mu, modulus, n->z)) != CRYPT_OK)                   { goto err_exit; }
-    }
-    mp_clear(mu);
-    mu = NULL;
-
-    if ((err = mp_set(R->x, 0)) != CRYPT_OK)  { goto err_exit; }
-    if ((err = mp_set(R->y, 0)) != CRYPT_OK)  { goto err_exit; }
-    if ((err = mp_set(R->z, 0)) != CRYPT_OK)  { goto err_exit; }
-
-    
-    for (i = 0; i < bits; i++) {
-        offset = size - (i >> 3);
-        mask = 1 << (i & 7);
-        bit = buffer[offset] & mask;
-        if (bit) {
-            if ((err = ltc_ecc_bl_projective_add_point(R, n, R, modulus, b, mp)) != CRYPT_OK)  { goto err_exit; }
-        }
-        if ((err = ltc_ecc_bl_projective_dbl_point(n, n, modulus, mp))  != CRYPT_OK)           { goto err_exit; }
-    }
-
-    /* map R back from projective space if requested */
-    if (map) {
-        err = ltc_ecc_bl_map(R, modulus, R, mp);
-    }
-    else {
-        err = CRYPT_OK;
-    }
 
-err_exit:
-    if (mu != NULL) {
-        mp_clear(mu);
-    }
-    mp_montgomery_free(mp);
+#endif  /* LTC_ECC_BL_FE */
 
-    ltc_ecc_del_point(n);
-    return err;
-}
 #endif
-
-
-#endif
\ No newline at end of file
@@ -0,0 +1,630 @@
+/* LibTomCrypt, modular cryptographic library -- Tom St Denis
+ *
+ * LibTomCrypt is a library that provides various cryptographic
+ * algorithms in a highly modular and flexible manner.
+ *
+ * The library is free for all purposes without any express
+ * guarantee it works.
+ *
+ * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
+ */
+#include "tomcrypt.h"
+
+/**
+  @file chacha.c
+  ChaCha stream cipher, D. J. Bernstein, with the RFC 8439 96 bit nonce
+
+  Whole blocks are made several at a time in SIMD lanes (4 with SSE2, 8 with
+  AVX2, 16 with AVX-512), lane j working on counter + j.  The state words are
+  kept transposed, so vector i holds word i of every lane, and are transposed
+  back into blocks on the way out.
+*/
+
+#ifdef LTC_CHACHA
+
+#ifdef LTC_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#define CHACHA_QUARTERROUND(a, b, c, d)                         \
+    x[a] += x[b]; x[d] = ROLc(x[d] ^ x[a], 16);                 \
+    x[c] += x[d]; x[b] = ROLc(x[b] ^ x[c], 12);                 \
+    x[a] += x[b]; x[d] = ROLc(x[d] ^ x[a], 8);                  \
+    x[c] += x[d]; x[b] = ROLc(x[b] ^ x[c], 7);
+
+/* one block of keystream for the counter in input[12..13] */
+static void chacha_block(const ulong32 input[16], int rounds, unsigned char *out)
+{
+    ulong32 x[16];
+    int     i;
+
+    XMEMCPY(x, input, sizeof(x));
+    for (i = 0; i < rounds; i += 2) {
+        CHACHA_QUARTERROUND(0, 4,  8, 12)
+        CHACHA_QUARTERROUND(1, 5,  9, 13)
+        CHACHA_QUARTERROUND(2, 6, 10, 14)
+        CHACHA_QUARTERROUND(3, 7, 11, 15)
+        CHACHA_QUARTERROUND(0, 5, 10, 15)
+        CHACHA_QUARTERROUND(1, 6, 11, 12)
+        CHACHA_QUARTERROUND(2, 7,  8, 13)
+        CHACHA_QUARTERROUND(3, 4,  9, 14)
+    }
+    for (i = 0; i < 16; i++) {
+        STORE32L(x[i] + input[i], out + 4 * i);
+    }
+    zeromem(x, sizeof(x));
+}
+
+#undef CHACHA_QUARTERROUND
+
+/* the block counter is 64 bits, for a 96 bit nonce chacha_crypt keeps it below 2^32 */
+static void chacha_next(ulong32 input[16], ulong32 n)
+{
+    input[12] += n;
+    if (input[12] < n) {
+       input[13]++;
+    }
+}
+
+#ifdef LTC_X86_SIMD
+
+/* the quarter rounds on all lanes at once, with ADD, XOR and the ROTL macros of each width */
+#define CHACHA_QR(a, b, c, d)                                               \
+    x[a] = ADD(x[a], x[b]); x[d] = ROTL16(XOR(x[d], x[a]));                 \
+    x[c] = ADD(x[c], x[d]); x[b] = ROTL12(XOR(x[b], x[c]));                 \
+    x[a] = ADD(x[a], x[b]); x[d] = ROTL8(XOR(x[d], x[a]));                  \
+    x[c] = ADD(x[c], x[d]); x[b] = ROTL7(XOR(x[b], x[c]));
+
+#define CHACHA_DOUBLEROUND()                                                \
+    CHACHA_QR(0, 4,  8, 12) CHACHA_QR(1, 5,  9, 13)                         \
+    CHACHA_QR(2, 6, 10, 14) CHACHA_QR(3, 7, 11, 15)                         \
+    CHACHA_QR(0, 5, 10, 15) CHACHA_QR(1, 6, 11, 12)                         \
+    CHACHA_QR(2, 7,  8, 13) CHACHA_QR(3, 4,  9, 14)
+
+/* SSE2 */
+
+#define ADD(a, b)   _mm_add_epi32(a, b)
+#define XOR(a, b)   _mm_xor_si128(a, b)
+#define ROTL16(v)   _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16))
+#define ROTL12(v)   _mm_or_si128(_mm_slli_epi32(v, 12), _mm_srli_epi32(v, 20))
+#define ROTL8(v)    _mm_or_si128(_mm_slli_epi32(v, 8),  _mm_srli_epi32(v, 24))
+#define ROTL7(v)    _mm_or_si128(_mm_slli_epi32(v, 7),  _mm_srli_epi32(v, 25))
+
+__attribute__((target("sse2")))
+static void chacha_transpose4_sse2(__m128i *a, __m128i *b, __m128i *c, __m128i *d)
+{
+    __m128i t0 = _mm_unpacklo_epi32(*a, *b);
+    __m128i t1 = _mm_unpackhi_epi32(*a, *b);
+    __m128i t2 = _mm_unpacklo_epi32(*c, *d);
+    __m128i t3 = _mm_unpackhi_epi32(*c, *d);
+
+    *a = _mm_unpacklo_epi64(t0, t2);
+    *b = _mm_unpackhi_epi64(t0, t2);
+    *c = _mm_unpacklo_epi64(t1, t3);
+    *d = _mm_unpackhi_epi64(t1, t3);
+}
+
+/* 4 blocks, out = in ^ keystream */
+__attribute__((target("sse2")))
+static void chacha_blocks4_sse2(const ulong32 input[16], int rounds, const unsigned char *in, unsigned char *out)
+{
+    __m128i x[16], s[16];
+    int     i, j;
+
+    for (i = 0; i < 16; i++) {
+        s[i] = _mm_set1_epi32((int)input[i]);
+    }
+    s[12] = _mm_add_epi32(s[12], _mm_set_epi32(3, 2, 1, 0));
+    for (i = 0; i < 16; i++) {
+        x[i] = s[i];
+    }
+
+    for (i = 0; i < rounds; i += 2) {
+        CHACHA_DOUBLEROUND()
+    }
+
+    for (i = 0; i < 16; i++) {
+        x[i] = _mm_add_epi32(x[i], s[i]);
+    }
+
+    /* words 4g..4g+3 of block j come out of x[4g + j] */
+    for (i = 0; i < 16; i += 4) {
+        chacha_transpose4_sse2(&x[i], &x[i + 1], &x[i + 2], &x[i + 3]);
+        for (j = 0; j < 4; j++) {
+            _mm_storeu_si128((__m128i *)(out + 64 * j + 4 * i),
+                             _mm_xor_si128(x[i + j], _mm_loadu_si128((const __m128i *)(in + 64 * j + 4 * i))));
+        }
+    }
+}
+
+#undef ADD
+#undef XOR
+#undef ROTL16
+#undef ROTL12
+#undef ROTL8
+#undef ROTL7
+
+/* AVX2 */
+
+#define ADD(a, b)   _mm256_add_epi32(a, b)
+#define XOR(a, b)   _mm256_xor_si256(a, b)
+#define ROTL16(v)   _mm256_shuffle_epi8(v, R16)
+#define ROTL12(v)   _mm256_or_si256(_mm256_slli_epi32(v, 12), _mm256_srli_epi32(v, 20))
+#define ROTL8(v)    _mm256_shuffle_epi8(v, R8)
+#define ROTL7(v)    _mm256_or_si256(_mm256_slli_epi32(v, 7), _mm256_srli_epi32(v, 25))
+
+__attribute__((target("avx2")))
+static void chacha_transpose8_avx2(__m256i v[8])
+{
+    __m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(v[2], v[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(v[4], v[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(v[4], v[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(v[6], v[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(v[6], v[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    v[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    v[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    v[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    v[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    v[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    v[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    v[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    v[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/* 8 blocks, out = in ^ keystream */
+__attribute__((target("avx2")))
+static void chacha_blocks8_avx2(const ulong32 input[16], int rounds, const unsigned char *in, unsigned char *out)
+{
+    const __m256i R16 = _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+    const __m256i R8  = _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                        14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+    __m256i x[16], s[16];
+    int     i, j;
+
+    for (i = 0; i < 16; i++) {
+        s[i] = _mm256_set1_epi32((int)input[i]);
+    }
+    s[12] = _mm256_add_epi32(s[12], _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    for (i = 0; i < 16; i++) {
+        x[i] = s[i];
+    }
+
+    for (i = 0; i < rounds; i += 2) {
+        CHACHA_DOUBLEROUND()
+    }
+
+    for (i = 0; i < 16; i++) {
+        x[i] = _mm256_add_epi32(x[i], s[i]);
+    }
+
+    /* words 8h..8h+7 of block j come out of x[8h + j] */
+    chacha_transpose8_avx2(&x[0]);
+    chacha_transpose8_avx2(&x[8]);
+    for (j = 0; j < 8; j++) {
+        _mm256_storeu_si256((__m256i *)(out + 64 * j),
+                            _mm256_xor_si256(x[j], _mm256_loadu_si256((const __m256i *)(in + 64 * j))));
+        _mm256_storeu_si256((__m256i *)(out + 64 * j + 32),
+                            _mm256_xor_si256(x[8 + j], _mm256_loadu_si256((const __m256i *)(in + 64 * j + 32))));
+    }
+}
+
+#undef ADD
+#undef XOR
+#undef ROTL16
+#undef ROTL12
+#undef ROTL8
+#undef ROTL7
+
+/* AVX-512 */
+
+#define ADD(a, b)   _mm512_add_epi32(a, b)
+#define XOR(a, b)   _mm512_xor_si512(a, b)
+#define ROTL16(v)   _mm512_rol_epi32(v, 16)
+#define ROTL12(v)   _mm512_rol_epi32(v, 12)
+#define ROTL8(v)    _mm512_rol_epi32(v, 8)
+#define ROTL7(v)    _mm512_rol_epi32(v, 7)
+
+/* 4x4 transposes inside each 128 bit lane, then a 4x4 transpose of the lanes */
+__attribute__((target("avx512f")))
+static void chacha_transpose16_avx512(__m512i v[16])
+{
+    __m512i x[16], p0, p1, p2, p3;
+    int g, i;
+
+    for (g = 0; g < 16; g += 4) {
+        __m512i t0 = _mm512_unpacklo_epi32(v[g + 0], v[g + 1]);
+        __m512i t1 = _mm512_unpackhi_epi32(v[g + 0], v[g + 1]);
+        __m512i t2 = _mm512_unpacklo_epi32(v[g + 2], v[g + 3]);
+        __m512i t3 = _mm512_unpackhi_epi32(v[g + 2], v[g + 3]);
+
+        x[g + 0] = _mm512_unpacklo_epi64(t0, t2);
+        x[g + 1] = _mm512_unpackhi_epi64(t0, t2);
+        x[g + 2] = _mm512_unpacklo_epi64(t1, t3);
+        x[g + 3] = _mm512_unpackhi_epi64(t1, t3);
+    }
+
+    for (i = 0; i < 4; i++) {
+        p0 = _mm512_shuffle_i32x4(x[i],     x[4 + i],  _MM_SHUFFLE(1, 0, 1, 0));
+        p1 = _mm512_shuffle_i32x4(x[8 + i], x[12 + i], _MM_SHUFFLE(1, 0, 1, 0));
+        p2 = _mm512_shuffle_i32x4(x[i],     x[4 + i],  _MM_SHUFFLE(3, 2, 3, 2));
+        p3 = _mm512_shuffle_i32x4(x[8 + i], x[12 + i], _MM_SHUFFLE(3, 2, 3, 2));
+
+        v[i]      = _mm512_shuffle_i32x4(p0, p1, _MM_SHUFFLE(2, 0, 2, 0));
+        v[4 + i]  = _mm512_shuffle_i32x4(p0, p1, _MM_SHUFFLE(3, 1, 3, 1));
+        v[8 + i]  = _mm512_shuffle_i32x4(p2, p3, _MM_SHUFFLE(2, 0, 2, 0));
+        v[12 + i] = _mm512_shuffle_i32x4(p2, p3, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+}
+
+/* 16 blocks, out = in ^ keystream */
+__attribute__((target("avx512f")))
+static void chacha_blocks16_avx512(const ulong32 input[16], int rounds, const unsigned char *in, unsigned char *out)
+{
+    __m512i x[16], s[16];
+    int     i, j;
+
+    for (i = 0; i < 16; i++) {
+        s[i] = _mm512_set1_epi32((int)input[i]);
+    }
+    s[12] = _mm512_add_epi32(s[12], _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+    for (i = 0; i < 16; i++) {
+        x[i] = s[i];
+    }
+
+    for (i = 0; i < rounds; i += 2) {
+        CHACHA_DOUBLEROUND()
+    }
+
+    for (i = 0; i < 16; i++) {
+        x[i] = _mm512_add_epi32(x[i], s[i]);
+    }
+
+    /* block j comes out of x[j] */
+    chacha_transpose16_avx512(x);
+    for (j = 0; j < 16; j++) {
+        _mm512_storeu_si512((void *)(out + 64 * j),
+                            _mm512_xor_si512(x[j], _mm512_loadu_si512((const void *)(in + 64 * j))));
+    }
+}
+
+#undef ADD
+#undef XOR
+#undef ROTL16
+#undef ROTL12
+#undef ROTL8
+#undef ROTL7
+
+#undef CHACHA_QR
+#undef CHACHA_DOUBLEROUND
+
+#endif /* LTC_X86_SIMD */
+
+static int chacha_backend = LTC_CHACHA_BACKEND_C;
+
+/**
+   Select the block functions used by chacha
+   @param backend  LTC_CHACHA_BACKEND_C, _SSE2, _AVX2 or _AVX512
+   @return CRYPT_OK if successful, CRYPT_INVALID_ARG if the backend is not built in
+*/
+int chacha_set_backend(int backend)
+{
+    switch (backend) {
+       case LTC_CHACHA_BACKEND_C:
+#ifdef LTC_X86_SIMD
+       case LTC_CHACHA_BACKEND_SSE2:
+       case LTC_CHACHA_BACKEND_AVX2:
+       case LTC_CHACHA_BACKEND_AVX512:
+#endif
+          chacha_backend = backend;
+          return CRYPT_OK;
+
+       default:
+          return CRYPT_INVALID_ARG;
+    }
+}
+
+/**
+   @return the LTC_CHACHA_BACKEND_xxx in use
+*/
+int chacha_get_backend(void)
+{
+    return chacha_backend;
+}
+
+/* out = in ^ keystream for whole blocks, the widest kernel the backend has first.
+   A batch whose low counter word would wrap goes one block at a time */
+static void chacha_xor_blocks(chacha_state *st, const unsigned char *in, unsigned char *out, unsigned long blocks)
+{
+    unsigned char buf[64];
+    int           i;
+
+#ifdef LTC_X86_SIMD
+    if (chacha_backend == LTC_CHACHA_BACKEND_AVX512) {
+       for (; blocks >= 16 && st->input[12] <= 0xFFFFFFF0UL; blocks -= 16, in += 1024, out += 1024) {
+           chacha_blocks16_avx512(st->input, st->rounds, in, out);
+           chacha_next(st->input, 16);
+       }
+    }
+    if (chacha_backend == LTC_CHACHA_BACKEND_AVX512 || chacha_backend == LTC_CHACHA_BACKEND_AVX2) {
+       for (; blocks >= 8 && st->input[12] <= 0xFFFFFFF8UL; blocks -= 8, in += 512, out += 512) {
+           chacha_blocks8_avx2(st->input, st->rounds, in, out);
+           chacha_next(st->input, 8);
+       }
+    }
+    if (chacha_backend != LTC_CHACHA_BACKEND_C) {
+       for (; blocks >= 4 && st->input[12] <= 0xFFFFFFFCUL; blocks -= 4, in += 256, out += 256) {
+           chacha_blocks4_sse2(st->input, st->rounds, in, out);
+           chacha_next(st->input, 4);
+       }
+    }
+#endif
+
+    for (; blocks > 0; blocks--, in += 64, out += 64) {
+        chacha_block(st->input, st->rounds, buf);
+        for (i = 0; i < 64; i++) {
+            out[i] = in[i] ^ buf[i];
+        }
+        chacha_next(st->input, 1);
+    }
+    zeromem(buf, sizeof(buf));
+}
+
+/**
+   Initialize a chacha state with a key
+   @param st      The state
+   @param key     The secret key
+   @param keylen  16 or 32
+   @param rounds  8, 12 or 20, 0 for 20
+   @return CRYPT_OK if successful
+*/
+int chacha_setup(chacha_state *st, const unsigned char *key, unsigned long keylen, int rounds)
+{
+    static const char * const sigma = "expand 32-byte k";
+    static const char * const tau   = "expand 16-byte k";
+    const char *constants;
+
+    LTC_ARGCHK(st  != NULL);
+    LTC_ARGCHK(key != NULL);
+
+    if (keylen != 32 && keylen != 16) {
+       return CRYPT_INVALID_KEYSIZE;
+    }
+    if (rounds == 0) {
+       rounds = 20;
+    }
+    if (rounds != 8 && rounds != 12 && rounds != 20) {
+       return CRYPT_INVALID_ROUNDS;
+    }
+
+    LOAD32L(st->input[4], key + 0);
+    LOAD32L(st->input[5], key + 4);
+    LOAD32L(st->input[6], key + 8);
+    LOAD32L(st->input[7], key + 12);
+    if (keylen == 32) {
+       key += 16;
+       constants = sigma;
+    } else {
+       constants = tau;
+    }
+    LOAD32L(st->input[8],  key + 0);
+    LOAD32L(st->input[9],  key + 4);
+    LOAD32L(st->input[10], key + 8);
+    LOAD32L(st->input[11], key + 12);
+    LOAD32L(st->input[0], constants + 0);
+    LOAD32L(st->input[1], constants + 4);
+    LOAD32L(st->input[2], constants + 8);
+    LOAD32L(st->input[3], constants + 12);
+
+    st->input[12] = st->input[13] = st->input[14] = st->input[15] = 0;
+    st->rounds = rounds;
+    st->ivlen  = 0;
+    st->ksleft = 0;
+    return CRYPT_OK;
+}
+
+/**
+   Set a 96 bit nonce and a 32 bit block counter (RFC 8439)
+   @param st       The state
+   @param iv       The nonce
+   @param ivlen    12
+   @param counter  The first block
+   @return CRYPT_OK if successful
+*/
+int chacha_ivctr32(chacha_state *st, const unsigned char *iv, unsigned long ivlen, ulong32 counter)
+{
+    LTC_ARGCHK(st != NULL);
+    LTC_ARGCHK(iv != NULL);
+
+    if (ivlen != 12) {
+       return CRYPT_INVALID_ARG;
+    }
+
+    st->input[12] = counter;
+    LOAD32L(st->input[13], iv + 0);
+    LOAD32L(st->input[14], iv + 4);
+    LOAD32L(st->input[15], iv + 8);
+    st->ksleft = 0;
+    st->ivlen  = ivlen;
+    return CRYPT_OK;
+}
+
+/**
+   Set a 64 bit nonce and a 64 bit block counter (the original ChaCha)
+   @param st       The state
+   @param iv       The nonce
+   @param ivlen    8
+   @param counter  The first block
+   @return CRYPT_OK if successful
+*/
+int chacha_ivctr64(chacha_state *st, const unsigned char *iv, unsigned long ivlen, ulong64 counter)
+{
+    LTC_ARGCHK(st != NULL);
+    LTC_ARGCHK(iv != NULL);
+
+    if (ivlen != 8) {
+       return CRYPT_INVALID_ARG;
+    }
+
+    st->input[12] = (ulong32)(counter & 0xFFFFFFFFUL);
+    st->input[13] = (ulong32)(counter >> 32);
+    LOAD32L(st->input[14], iv + 0);
+    LOAD32L(st->input[15], iv + 4);
+    st->ksleft = 0;
+    st->ivlen  = ivlen;
+    return CRYPT_OK;
+}
+
+/**
+   Encrypt or decrypt, in and out may be the same buffer
+   @param st     The state, with the nonce set
+   @param in     The input
+   @param inlen  The length of the input
+   @param out    [out] in ^ keystream
+   @return CRYPT_OK if successful, CRYPT_INVALID_ARG when a 32 bit counter would wrap
+*/
+int chacha_crypt(chacha_state *st, const unsigned char *in, unsigned long inlen, unsigned char *out)
+{
+    unsigned long blocks, i;
+
+    if (inlen == 0) {
+       return CRYPT_OK;
+    }
+
+    LTC_ARGCHK(st  != NULL);
+    LTC_ARGCHK(in  != NULL);
+    LTC_ARGCHK(out != NULL);
+
+    if (st->ivlen == 0) {
+       return CRYPT_INVALID_ARG;
+    }
+
+    /* the rest of the last block first */
+    for (; st->ksleft > 0 && inlen > 0; inlen--, st->ksleft--) {
+        *out++ = *in++ ^ st->kstream[64 - st->ksleft];
+    }
+    if (inlen == 0) {
+       return CRYPT_OK;
+    }
+
+    /* a 96 bit nonce leaves 32 bits of counter, which stops short of wrapping into the nonce */
+    blocks = (inlen + 63) / 64;
+    if (st->ivlen == 12 && (ulong64)st->input[12] + blocks > CONST64(0xFFFFFFFF)) {
+       return CRYPT_INVALID_ARG;
+    }
+
+    chacha_xor_blocks(st, in, out, inlen / 64);
+    in    += inlen & ~63UL;
+    out   += inlen & ~63UL;
+    inlen &= 63;
+
+    if (inlen > 0) {
+       chacha_block(st->input, st->rounds, st->kstream);
+       chacha_next(st->input, 1);
+       for (i = 0; i < inlen; i++) {
+           out[i] = in[i] ^ st->kstream[i];
+       }
+       st->ksleft = 64 - inlen;
+    }
+    return CRYPT_OK;
+}
+
+/**
+   Write keystream
+   @param st      The state, with the nonce set
+   @param out     [out] The keystream
+   @param outlen  The length of the keystream
+   @return CRYPT_OK if successful
+*/
+int chacha_keystream(chacha_state *st, unsigned char *out, unsigned long outlen)
+{
+    if (outlen == 0) {
+       return CRYPT_OK;
+    }
+    LTC_ARGCHK(out != NULL);
+
+    XMEMSET(out, 0, outlen);
+    return chacha_crypt(st, out, outlen, out);
+}
+
+/**
+   Wipe a chacha state
+   @param st  The state
+   @return CRYPT_OK if successful
+*/
+int chacha_done(chacha_state *st)
+{
+    LTC_ARGCHK(st != NULL);
+
+    zeromem(st, sizeof(chacha_state));
+    return CRYPT_OK;
+}
+
+/**
+   RFC 8439 section 2.4.2, in pieces and in one go on every backend built in
+   @return CRYPT_OK if successful
+*/
+int chacha_test(void)
+{
+#ifndef LTC_TEST
+    return CRYPT_NOP;
+#else
+    static const unsigned char k[32] = {
+       0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+       0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+    };
+    static const unsigned char n[12] = {
+       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00
+    };
+    static const char pt[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+    static const unsigned char ct[114] = {
+       0x6e, 0x2e, 0x35, 0x9a, 0x25, 0x68, 0xf9, 0x80, 0x41, 0xba, 0x07, 0x28, 0xdd, 0x0d, 0x69, 0x81,
+       0xe9, 0x7e, 0x7a, 0xec, 0x1d, 0x43, 0x60, 0xc2, 0x0a, 0x27, 0xaf, 0xcc, 0xfd, 0x9f, 0xae, 0x0b,
+       0xf9, 0x1b, 0x65, 0xc5, 0x52, 0x47, 0x33, 0xab, 0x8f, 0x59, 0x3d, 0xab, 0xcd, 0x62, 0xb3, 0x57,
+       0x16, 0x39, 0xd6, 0x24, 0xe6, 0x51, 0x52, 0xab, 0x8f, 0x53, 0x0c, 0x35, 0x9f, 0x08, 0x61, 0xd8,
+       0x07, 0xca, 0x0d, 0xbf, 0x50, 0x0d, 0x6a, 0x61, 0x56, 0xa3, 0x8e, 0x08, 0x8a, 0x22, 0xb6, 0x5e,
+       0x52, 0xbc, 0x51, 0x4d, 0x16, 0xcc, 0xf8, 0x06, 0x81, 0x8c, 0xe9, 0x1a, 0xb7, 0x79, 0x37, 0x36,
+       0x5a, 0xf9, 0x0b, 0xbf, 0x74, 0xa3, 0x5b, 0xe6, 0xb4, 0x0b, 0x8e, 0xed, 0xf2, 0x78, 0x5e, 0x42,
+       0x87, 0x4d
+    };
+    chacha_state  st;
+    unsigned char out[114];
+    int           err;
+
+    if ((err = chacha_setup(&st, k, sizeof(k), 20)) != CRYPT_OK)                        return err;
+    if ((err = chacha_ivctr32(&st, n, sizeof(n), 1)) != CRYPT_OK)                       return err;
+    if ((err = chacha_crypt(&st, (const unsigned char *)pt, 35, out)) != CRYPT_OK)      return err;
+    if ((err = chacha_crypt(&st, (const unsigned char *)pt + 35, 79, out + 35)) != CRYPT_OK) return err;
+    if (XMEMCMP(out, ct, sizeof(ct)) != 0) {
+       return CRYPT_FAIL_TESTVECTOR;
+    }
+
+    if ((err = chacha_ivctr32(&st, n, sizeof(n), 1)) != CRYPT_OK)                       return err;
+    if ((err = chacha_crypt(&st, out, sizeof(out), out)) != CRYPT_OK)                   return err;
+    if (XMEMCMP(out, pt, sizeof(out)) != 0) {
+       return CRYPT_FAIL_TESTVECTOR;
+    }
+
+    chacha_done(&st);
+    return CRYPT_OK;
+#endif
+}
+
+#endif /* LTC_CHACHA */
+
+/* $Source$ */
+/* $Revision$ */
+/* $Date$ */
@@ -28,6 +28,7 @@ typedef enum
     kTest_Share,
     kTest_Keys,
     kTest_Utilties,
+    kTest_Bench,
      kTest_All,
 } SDKTest;
 
@@ -95,6 +96,7 @@ static TestTable sOpTestTable[] =
     { 0, kArg_TestID,	  NULL,  kTest_Share,      "share",             0,  "Secret Sharing / Key Split" },
     { 0, kArg_TestID,	  NULL,  kTest_Keys,       "keys",              0,  "Key Import / Export" },
     { 0, kArg_TestID,	  NULL,  kTest_Utilties,    "utilties",       0,  "S4 Utilties" },
+    { 0, kArg_TestID,	  NULL,  kTest_Bench,       "bench",          0,  "Performance Benchmarks" },
     
      { 0, kArg_TestID,	  NULL,  kTest_Invalid,		 "none",				0,  NULL },
     
@@ -376,6 +378,13 @@ int optest_main(int argc, char **argv)
                     
                 case kTest_Utilties:
                     err = TestUtilties();
+                    break;
+                    
+                    /* Run throughput measurements */
+                case kTest_Bench:
+                    err = TestBenchmarks();
+                    break;
+                    
                 default:;
             }
             CKERR;
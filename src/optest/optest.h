@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include  "s4.h"
+#include  "s4cpu.h"
 
 #ifdef __IPHONE_OS_VERSION_MIN_REQUIRED
 #define OPTEST_IOS_SPECIFIC 1
@@ -72,6 +73,18 @@ extern unsigned int gLogLevel;
 
 int OPTESTPrintF(const char *, ...);
 
+/* a SIMD kernel to force.  The mask hides the features of the faster kernels,
+ needs is what this one runs on */
+typedef struct
+{
+    char        *name;
+    uint32_t    mask;
+    uint32_t    needs;
+} OPTESTKernel;
+
+bool OPTESTUseKernel(const OPTESTKernel *kernel);
+void OPTESTResetKernel(void);
+
 char *hash_algor_table(HASH_Algorithm algor);
 char *cipher_algor_table(Cipher_Algorithm algor);
 char* mac_algor_table(MAC_Algorithm algor);
@@ -105,4 +118,5 @@ S4Err TestTBCiphers();
 S4Err TestSecretSharing();
 S4Err TestKeys();
 S4Err  TestUtilties();
+S4Err TestBenchmarks();
 #endif /* optest_h */
@@ -294,10 +294,42 @@ S4Err compareResults(const void* expected, const void* calculated, size_t len,
 
 
 
+/* false when the CPU can not run the kernel, otherwise the backends are picked again
+ under its mask.  The mask is internal to the library: make test links it statically
+ with OPTEST_CPU_HOOKS, against the framework only the default (kS4CPU_All) kernel runs */
+bool OPTESTUseKernel(const OPTESTKernel *kernel)
+{
+#ifdef OPTEST_CPU_HOOKS
+    sCPU_SetMask(kS4CPU_All);
+    
+    if((sCPU_Features() & kernel->needs) != kernel->needs)
+    {
+        OPTESTLogVerbose("\t\t%-8s not on this CPU\n", kernel->name);
+        return false;
+    }
+    
+    sCPU_SetMask(kernel->mask);
+    OPTESTLogVerbose("\t\t%-8s\n", kernel->name);
+    
+    return true;
+#else
+    return kernel->mask == kS4CPU_All;
+#endif
+}
+
+/* back to the backends S4_Init picked */
+void OPTESTResetKernel(void)
+{
+#ifdef OPTEST_CPU_HOOKS
+    sCPU_SetMask(kS4CPU_All);
+#endif
+}
+
 char *hash_algor_table(HASH_Algorithm algor)
 {
     switch (algor )
     {
+        case kHASH_Algorithm_MD5: 		return (("MD5"));
         case kHASH_Algorithm_SHA1: 		return (("SHA-1"));
         case kHASH_Algorithm_SHA224:		return (("SHA-224"));
         case kHASH_Algorithm_SHA256:		return (("SHA-256"));
@@ -307,11 +339,16 @@ char *hash_algor_table(HASH_Algorithm algor)
         case kHASH_Algorithm_SKEIN256:		return (("SKEIN-256"));
         case kHASH_Algorithm_SKEIN512:		return (("SKEIN-512"));
         case kHASH_Algorithm_SKEIN1024:		return (("SKEIN-1024"));
+        case kHASH_Algorithm_SKEIN512_TREE:	return (("SKEIN-512-Tree"));
+        case kHASH_Algorithm_SKEIN1024_TREE:	return (("SKEIN-1024-Tree"));
+        case kHASH_Algorithm_BLAKE3:		return (("BLAKE3"));
 
         
 #if _USES_XXHASH_
         case kHASH_Algorithm_xxHash32:		return (("xxHash-32"));
         case kHASH_Algorithm_xxHash64:		return (("xxHash-64"));
+        case kHASH_Algorithm_xxHash3_64:	return (("xxHash3-64"));
+        case kHASH_Algorithm_xxHash128:		return (("xxHash-128"));
 #endif
         
         default:				return (("Invalid"));
@@ -331,6 +368,15 @@ uint32_t hash_algor_bits(HASH_Algorithm algor)
         case kHASH_Algorithm_SKEIN256:		 return (256);
         case kHASH_Algorithm_SKEIN512:		 return (512);
         case kHASH_Algorithm_SKEIN1024:		 return (1024);
+        case kHASH_Algorithm_SKEIN512_TREE:	 return (512);
+        case kHASH_Algorithm_SKEIN1024_TREE:	 return (1024);
+        case kHASH_Algorithm_BLAKE3:		 return (256);
+#if _USES_XXHASH_
+        case kHASH_Algorithm_xxHash32:		 return (32);
+        case kHASH_Algorithm_xxHash64:		 return (64);
+        case kHASH_Algorithm_xxHash3_64:	 return (64);
+        case kHASH_Algorithm_xxHash128:		 return (128);
+#endif
         default:				 return (0);
     }
 }
@@ -357,6 +403,7 @@ char *cipher_algor_table(Cipher_Algorithm algor)
         case kCipher_Algorithm_AES192: 		return (("AES-192"));
         case kCipher_Algorithm_AES256: 		return (("AES-256"));
         case kCipher_Algorithm_2FISH256: 		return (("Twofish-256"));
+        case kCipher_Algorithm_ChaCha20: 		return (("ChaCha20"));
 
         case kCipher_Algorithm_3FISH256: 		return (("ThreeFish-256"));
         case kCipher_Algorithm_3FISH512: 		return (("ThreeFish-512"));
@@ -0,0 +1,1552 @@
+//
+//  testBench.c
+//  S4
+//
+//  Throughput measurements, not run as part of the default test set.
+//  use:  optest --bench
+//
+//  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "s4.h"
+#include "optest.h"
+
+
+static double sNow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* time stamp counter, 0 where there is none.  It ticks at the nominal clock, not the
+ turbo one, so cycles per byte are only good for comparing backends on one machine */
+static uint64_t sCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+
+#ifdef __clang__
+#pragma mark - Batch hashing
+#endif
+
+static S4Err BenchHashBatch(HASH_Algorithm algor, size_t msgSize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    uint8_t         *msgs = NULL;
+    uint8_t         *digests = NULL;
+    const unsigned char **in = NULL;
+    unsigned long   *inlen = NULL;
+    uint8_t         **out = NULL;
+    double          start, loopTime, batchTime;
+    size_t          i;
+
+    msgs    = malloc(msgSize * count);             CKNULL(msgs);
+    digests = malloc(64 * count);                  CKNULL(digests);
+    in      = malloc(sizeof(*in) * count);         CKNULL(in);
+    inlen   = malloc(sizeof(*inlen) * count);      CKNULL(inlen);
+    out     = malloc(sizeof(*out) * count);        CKNULL(out);
+
+    err = RNG_GetBytes(msgs, msgSize * count); CKERR;
+
+    for(i = 0; i < count; i++)
+    {
+        in[i]       = msgs + i * msgSize;
+        inlen[i]    = msgSize;
+        out[i]      = digests + i * 64;
+    }
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = HASH_DO(algor, in[i], inlen[i], 64, out[i]); CKERR;
+    }
+    loopTime = sNow() - start;
+
+    start = sNow();
+    err = HASH_DOBatch(algor, count, in, inlen, 64, out); CKERR;
+    batchTime = sNow() - start;
+
+    OPTESTLogInfo("\t%10s %5zu bytes  %10.0f msg/s  %10.0f msg/s  %5.2fx\n",
+                  hash_algor_table(algor), msgSize,
+                  count / loopTime, count / batchTime, loopTime / batchTime);
+
+done:
+
+    if(msgs)    free(msgs);
+    if(digests) free(digests);
+    if(in)      free(in);
+    if(inlen)   free(inlen);
+    if(out)     free(out);
+
+    return err;
+}
+
+
+static S4Err BenchMACBatch(HASH_Algorithm algor, size_t msgSize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    MAC_ContextRef  macRef = kInvalidMAC_ContextRef;
+    uint8_t         key[32];
+    uint8_t         *msgs = NULL;
+    uint8_t         *macs = NULL;
+    const unsigned char **in = NULL;
+    unsigned long   *inlen = NULL;
+    uint8_t         **out = NULL;
+    double          start, loopTime, batchTime;
+    size_t          i, resultLen;
+
+    msgs    = malloc(msgSize * count);             CKNULL(msgs);
+    macs    = malloc(64 * count);                  CKNULL(macs);
+    in      = malloc(sizeof(*in) * count);         CKNULL(in);
+    inlen   = malloc(sizeof(*inlen) * count);      CKNULL(inlen);
+    out     = malloc(sizeof(*out) * count);        CKNULL(out);
+
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    err = RNG_GetBytes(msgs, msgSize * count); CKERR;
+
+    for(i = 0; i < count; i++)
+    {
+        in[i]       = msgs + i * msgSize;
+        inlen[i]    = msgSize;
+        out[i]      = macs + i * 64;
+    }
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = MAC_Init(kMAC_Algorithm_SKEIN, algor, key, sizeof(key), &macRef); CKERR;
+        err = MAC_Update(macRef, in[i], inlen[i]); CKERR;
+        resultLen = 32;
+        err = MAC_Final(macRef, out[i], &resultLen); CKERR;
+        MAC_Free(macRef);
+        macRef = kInvalidMAC_ContextRef;
+    }
+    loopTime = sNow() - start;
+
+    start = sNow();
+    err = MAC_DOBatch(kMAC_Algorithm_SKEIN, algor, key, sizeof(key), count, in, inlen, 32, out); CKERR;
+    batchTime = sNow() - start;
+
+    OPTESTLogInfo("\t%10s %5zu bytes  %10.0f msg/s  %10.0f msg/s  %5.2fx\n",
+                  hash_algor_table(algor), msgSize,
+                  count / loopTime, count / batchTime, loopTime / batchTime);
+
+done:
+
+    if(!IsNull(macRef))
+        MAC_Free(macRef);
+
+    if(msgs)    free(msgs);
+    if(macs)    free(macs);
+    if(in)      free(in);
+    if(inlen)   free(inlen);
+    if(out)     free(out);
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Skein tree hashing
+#endif
+
+static S4Err BenchSkeinTree(HASH_Algorithm seqAlgor, HASH_Algorithm treeAlgor, size_t msgSize)
+{
+    S4Err           err = kS4Err_NoErr;
+    HASH_ContextRef hashRef = kInvalidHASH_ContextRef;
+    uint8_t         *msg = NULL;
+    uint8_t         hashBuf[128];
+    uint32_t        threadCounts[] = { 1, 2, 4, 0 };
+    double          start, seqTime, treeTime;
+    int             i;
+
+    msg = malloc(msgSize); CKNULL(msg);
+    err = RNG_GetBytes(msg, msgSize); CKERR;
+
+    start = sNow();
+    err = HASH_DO(seqAlgor, msg, msgSize, sizeof(hashBuf), hashBuf); CKERR;
+    seqTime = sNow() - start;
+
+    OPTESTLogInfo("\t%15s %4zu MB                %8.1f MB/s\n",
+                  hash_algor_table(seqAlgor), msgSize >> 20, msgSize / seqTime / 1e6);
+
+    for(i = 0; i < sizeof(threadCounts) / sizeof(uint32_t); i++)
+    {
+        err = HASH_InitSkeinTree(treeAlgor,
+                                 kHASH_SkeinTree_LeafSizeExp,
+                                 kHASH_SkeinTree_FanOutExp,
+                                 kHASH_SkeinTree_MaxHeight,
+                                 threadCounts[i], &hashRef); CKERR;
+
+        start = sNow();
+        err = HASH_Update(hashRef, msg, msgSize); CKERR;
+        err = HASH_Final(hashRef, hashBuf); CKERR;
+        treeTime = sNow() - start;
+
+        HASH_Free(hashRef);
+        hashRef = kInvalidHASH_ContextRef;
+
+        if(threadCounts[i])
+            OPTESTLogInfo("\t%15s %4zu MB %2u threads    %8.1f MB/s  %5.2fx\n",
+                          hash_algor_table(treeAlgor), msgSize >> 20, threadCounts[i],
+                          msgSize / treeTime / 1e6, seqTime / treeTime);
+        else
+            OPTESTLogInfo("\t%15s %4zu MB all CPUs      %8.1f MB/s  %5.2fx\n",
+                          hash_algor_table(treeAlgor), msgSize >> 20,
+                          msgSize / treeTime / 1e6, seqTime / treeTime);
+    }
+
+done:
+
+    if(HASH_ContextRefIsValid(hashRef))
+        HASH_Free(hashRef);
+
+    if(msg) free(msg);
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - BLAKE3
+#endif
+
+static S4Err BenchHashThroughput(HASH_Algorithm algor, size_t msgSize)
+{
+    S4Err           err = kS4Err_NoErr;
+    uint8_t         *msg = NULL;
+    uint8_t         hashBuf[64];
+    double          start, hashTime;
+
+    msg = malloc(msgSize); CKNULL(msg);
+    err = RNG_GetBytes(msg, msgSize); CKERR;
+
+    start = sNow();
+    err = HASH_DO(algor, msg, msgSize, sizeof(hashBuf), hashBuf); CKERR;
+    hashTime = sNow() - start;
+
+    OPTESTLogInfo("\t%15s %4zu MB                %8.1f MB/s\n",
+                  hash_algor_table(algor), msgSize >> 20, msgSize / hashTime / 1e6);
+
+done:
+
+    if(msg) free(msg);
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - Ciphers
+#endif
+
+/* bulk ECB and CBC through the public API, whichever AES backend the CPU selected */
+static S4Err BenchCipherThroughput(Cipher_Algorithm algor, size_t msgSize)
+{
+    S4Err           err = kS4Err_NoErr;
+    CBC_ContextRef  cbc = kInvalidCBC_ContextRef;
+    CTR_ContextRef  ctr = kInvalidCTR_ContextRef;
+    uint8_t         *msg = NULL;
+    uint8_t         key[32];
+    uint8_t         iv[16];
+    double          start, ecbTime, cbcEncTime, cbcDecTime, ctrTime;
+    uint64_t        cycles, ecbCycles, cbcEncCycles, cbcDecCycles, ctrCycles;
+    int             k;
+    
+    /* the table code first, the rest are measured against it */
+    OPTESTKernel    kernels[] = {
+        { "table",      ~(kS4CPU_AES | kS4CPU_SSSE3),   0 },
+        { "vpaes",      ~kS4CPU_AES,                    kS4CPU_SSSE3 },
+        { "aesni",      kS4CPU_All,                     kS4CPU_AES | kS4CPU_SSSE3 },
+    };
+
+    msg = malloc(msgSize); CKNULL(msg);
+    err = RNG_GetBytes(msg, msgSize); CKERR;
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    err = RNG_GetBytes(iv, sizeof(iv)); CKERR;
+
+    for(k = 0; k < sizeof(kernels) / sizeof(OPTESTKernel); k++)
+    {
+        if(!OPTESTUseKernel(&kernels[k]))
+            continue;
+
+        start = sNow(); cycles = sCycles();
+        err = ECB_Encrypt(algor, key, msg, msgSize, msg); CKERR;
+        ecbCycles = sCycles() - cycles; ecbTime = sNow() - start;
+
+        err = CBC_Init(algor, key, iv, &cbc); CKERR;
+        start = sNow(); cycles = sCycles();
+        err = CBC_Encrypt(cbc, msg, msgSize, msg); CKERR;
+        cbcEncCycles = sCycles() - cycles; cbcEncTime = sNow() - start;
+        CBC_Free(cbc);
+        cbc = kInvalidCBC_ContextRef;
+
+        err = CBC_Init(algor, key, iv, &cbc); CKERR;
+        start = sNow(); cycles = sCycles();
+        err = CBC_Decrypt(cbc, msg, msgSize, msg); CKERR;
+        cbcDecCycles = sCycles() - cycles; cbcDecTime = sNow() - start;
+        CBC_Free(cbc);
+        cbc = kInvalidCBC_ContextRef;
+
+        err = CTR_Init(algor, key, iv, 1, &ctr); CKERR;
+        start = sNow(); cycles = sCycles();
+        err = CTR_Update(ctr, msg, msgSize, msg); CKERR;
+        ctrCycles = sCycles() - cycles; ctrTime = sNow() - start;
+        CTR_Free(ctr);
+        ctr = kInvalidCTR_ContextRef;
+
+        OPTESTLogInfo("\t%10s %-6s %4zu MB  ECB %8.1f  CBC enc %8.1f  CBC dec %8.1f  CTR %8.1f MB/s\n",
+                      cipher_algor_table(algor), kernels[k].name, msgSize >> 20,
+                      msgSize / ecbTime / 1e6, msgSize / cbcEncTime / 1e6,
+                      msgSize / cbcDecTime / 1e6, msgSize / ctrTime / 1e6);
+
+        if(ecbCycles)
+            OPTESTLogInfo("\t%10s %-6s %4s     ECB %8.2f  CBC enc %8.2f  CBC dec %8.2f  CTR %8.2f cycles/byte\n",
+                          "", "", "",
+                          (double) ecbCycles / msgSize, (double) cbcEncCycles / msgSize,
+                          (double) cbcDecCycles / msgSize, (double) ctrCycles / msgSize);
+    }
+
+done:
+
+    if(CBC_ContextRefIsValid(cbc))
+        CBC_Free(cbc);
+
+    if(CTR_ContextRefIsValid(ctr))
+        CTR_Free(ctr);
+
+    if(msg) free(msg);
+
+    OPTESTResetKernel();
+
+    return err;
+}
+
+
+/* CTR_Update on one thread and on one per CPU, and in short updates served from the keystream made ahead */
+static S4Err BenchCTRThroughput(Cipher_Algorithm algor, size_t msgSize)
+{
+    S4Err           err = kS4Err_NoErr;
+    CTR_ContextRef  ctr = kInvalidCTR_ContextRef;
+    uint8_t         *msg = NULL;
+    uint8_t         key[128];                  /* up to Threefish-1024 */
+    uint8_t         iv[16];
+    double          start, oneTime, allTime, shortTime;
+    size_t          offset;
+
+    msg = malloc(msgSize); CKNULL(msg);
+    err = RNG_GetBytes(msg, msgSize); CKERR;
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    err = RNG_GetBytes(iv, sizeof(iv)); CKERR;
+
+    err = CTR_Init(algor, key, iv, 1, &ctr); CKERR;
+    start = sNow();
+    err = CTR_Update(ctr, msg, msgSize, msg); CKERR;
+    oneTime = sNow() - start;
+
+    err = CTR_Seek(ctr, 0); CKERR;
+    start = sNow();
+    for(offset = 0; offset + 100 <= msgSize; offset += 100)
+    {
+        err = CTR_Update(ctr, msg + offset, 100, msg + offset); CKERR;
+    }
+    shortTime = sNow() - start;
+    CTR_Free(ctr);
+    ctr = kInvalidCTR_ContextRef;
+
+    err = CTR_Init(algor, key, iv, 0, &ctr); CKERR;
+    start = sNow();
+    err = CTR_Update(ctr, msg, msgSize, msg); CKERR;
+    allTime = sNow() - start;
+
+    OPTESTLogInfo("\t%10s %4zu MB  CTR %8.1f  threaded %8.1f  100 byte updates %8.1f MB/s\n",
+                  cipher_algor_table(algor), msgSize >> 20,
+                  msgSize / oneTime / 1e6, msgSize / allTime / 1e6, msgSize / shortTime / 1e6);
+
+done:
+
+    if(CTR_ContextRefIsValid(ctr))
+        CTR_Free(ctr);
+
+    if(msg) free(msg);
+
+    return err;
+}
+
+/* GCM one shot both ways, against CBC followed by HMAC-SHA256 over the ciphertext */
+static S4Err BenchGCMThroughput(Cipher_Algorithm algor, size_t msgSize)
+{
+    S4Err           err = kS4Err_NoErr;
+    CBC_ContextRef  cbc = kInvalidCBC_ContextRef;
+    MAC_ContextRef  mac = kInvalidMAC_ContextRef;
+    uint8_t         *msg = NULL;
+    uint8_t         key[32];
+    uint8_t         iv[16];
+    uint8_t         aad[64];
+    uint8_t         tag[32];
+    size_t          tagLen = sizeof(tag);
+    double          start, encTime, decTime, cbcTime;
+
+    msg = malloc(msgSize); CKNULL(msg);
+    err = RNG_GetBytes(msg, msgSize); CKERR;
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    err = RNG_GetBytes(iv, sizeof(iv)); CKERR;
+    err = RNG_GetBytes(aad, sizeof(aad)); CKERR;
+
+    start = sNow();
+    err = GCM_EncryptAEAD(algor, key, iv, 12, aad, sizeof(aad), msg, msgSize, msg, tag, 16); CKERR;
+    encTime = sNow() - start;
+
+    start = sNow();
+    err = GCM_DecryptAEAD(algor, key, iv, 12, aad, sizeof(aad), msg, msgSize, msg, tag, 16); CKERR;
+    decTime = sNow() - start;
+
+    start = sNow();
+    err = CBC_Init(algor, key, iv, &cbc); CKERR;
+    err = CBC_Encrypt(cbc, msg, msgSize, msg); CKERR;
+    err = MAC_Init(kMAC_Algorithm_HMAC, kHASH_Algorithm_SHA256, key, sizeof(key), &mac); CKERR;
+    err = MAC_Update(mac, aad, sizeof(aad)); CKERR;
+    err = MAC_Update(mac, msg, msgSize); CKERR;
+    err = MAC_Final(mac, tag, &tagLen); CKERR;
+    cbcTime = sNow() - start;
+
+    OPTESTLogInfo("\t%10s %4zu MB  GCM encrypt %8.1f  decrypt %8.1f  CBC+HMAC-SHA256 %8.1f MB/s\n",
+                  cipher_algor_table(algor), msgSize >> 20,
+                  msgSize / encTime / 1e6, msgSize / decTime / 1e6, msgSize / cbcTime / 1e6);
+
+done:
+
+    if(CBC_ContextRefIsValid(cbc))
+        CBC_Free(cbc);
+
+    if(MAC_ContextRefIsValid(mac))
+        MAC_Free(mac);
+
+    if(msg) free(msg);
+
+    return err;
+}
+
+/* ChaCha20-Poly1305 one shot both ways, against AES-256 GCM.  Packets are sealed one
+ AEAD call each, which is where the per message setup of Poly1305 shows */
+static S4Err BenchChaChaPolyThroughput(size_t msgSize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    uint8_t         *msg = NULL;
+    uint8_t         *ct = NULL;
+    uint8_t         key[32];
+    uint8_t         nonce[12];
+    uint8_t         aad[64];
+    uint8_t         tag[16];
+    size_t          i;
+    double          start, encTime, decTime, gcmTime;
+
+    msg = malloc(msgSize); CKNULL(msg);
+    ct  = malloc(msgSize); CKNULL(ct);
+    err = RNG_GetBytes(msg, msgSize); CKERR;
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    err = RNG_GetBytes(nonce, sizeof(nonce)); CKERR;
+    err = RNG_GetBytes(aad, sizeof(aad)); CKERR;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = CHACHAPOLY_EncryptAEAD(kCipher_Algorithm_ChaCha20, key, nonce, sizeof(nonce), aad, sizeof(aad),
+                                     msg, msgSize, ct, tag, sizeof(tag)); CKERR;
+    }
+    encTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = CHACHAPOLY_DecryptAEAD(kCipher_Algorithm_ChaCha20, key, nonce, sizeof(nonce), aad, sizeof(aad),
+                                     ct, msgSize, msg, tag, sizeof(tag)); CKERR;
+    }
+    decTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = GCM_EncryptAEAD(kCipher_Algorithm_AES256, key, nonce, sizeof(nonce), aad, sizeof(aad),
+                              msg, msgSize, ct, tag, sizeof(tag)); CKERR;
+    }
+    gcmTime = sNow() - start;
+
+    OPTESTLogInfo("	%8zu bytes x %-6zu ChaCha20-Poly1305 encrypt %8.1f  decrypt %8.1f  AES-256 GCM %8.1f MB/s\n",
+                  msgSize, count,
+                  msgSize * count / encTime / 1e6, msgSize * count / decTime / 1e6, msgSize * count / gcmTime / 1e6);
+
+done:
+
+    if(msg) free(msg);
+    if(ct) free(ct);
+
+    return err;
+}
+
+/* OCB3 one shot both ways, against GCM and against CBC followed by HMAC-SHA256 over
+ the ciphertext, each message sealed with its own call */
+static S4Err BenchOCBThroughput(Cipher_Algorithm algor, size_t msgSize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    CBC_ContextRef  cbc = kInvalidCBC_ContextRef;
+    MAC_ContextRef  mac = kInvalidMAC_ContextRef;
+    uint8_t         *msg = NULL;
+    uint8_t         *ct = NULL;
+    uint8_t         key[32];
+    uint8_t         iv[16];
+    uint8_t         aad[64];
+    uint8_t         tag[32];
+    size_t          tagLen;
+    size_t          i;
+    double          start, encTime, decTime, gcmTime, cbcTime;
+
+    msg = malloc(msgSize); CKNULL(msg);
+    ct  = malloc(msgSize); CKNULL(ct);
+    err = RNG_GetBytes(msg, msgSize); CKERR;
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    err = RNG_GetBytes(iv, sizeof(iv)); CKERR;
+    err = RNG_GetBytes(aad, sizeof(aad)); CKERR;
+    ZERO(ct, msgSize);
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = OCB_EncryptAEAD(algor, key, iv, 12, aad, sizeof(aad), msg, msgSize, ct, tag, 16); CKERR;
+    }
+    encTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = OCB_DecryptAEAD(algor, key, iv, 12, aad, sizeof(aad), ct, msgSize, msg, tag, 16); CKERR;
+    }
+    decTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = GCM_EncryptAEAD(algor, key, iv, 12, aad, sizeof(aad), msg, msgSize, ct, tag, 16); CKERR;
+    }
+    gcmTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        tagLen = sizeof(tag);
+        err = CBC_Init(algor, key, iv, &cbc); CKERR;
+        err = CBC_Encrypt(cbc, msg, msgSize, ct); CKERR;
+        CBC_Free(cbc);
+        cbc = kInvalidCBC_ContextRef;
+        err = MAC_Init(kMAC_Algorithm_HMAC, kHASH_Algorithm_SHA256, key, sizeof(key), &mac); CKERR;
+        err = MAC_Update(mac, aad, sizeof(aad)); CKERR;
+        err = MAC_Update(mac, ct, msgSize); CKERR;
+        err = MAC_Final(mac, tag, &tagLen); CKERR;
+        MAC_Free(mac);
+        mac = kInvalidMAC_ContextRef;
+    }
+    cbcTime = sNow() - start;
+
+    OPTESTLogInfo("\t%10s %8zu bytes x %-6zu OCB encrypt %8.1f  decrypt %8.1f  GCM %8.1f  CBC+HMAC-SHA256 %8.1f MB/s\n",
+                  cipher_algor_table(algor), msgSize, count,
+                  msgSize * count / encTime / 1e6, msgSize * count / decTime / 1e6,
+                  msgSize * count / gcmTime / 1e6, msgSize * count / cbcTime / 1e6);
+
+done:
+
+    if(CBC_ContextRefIsValid(cbc))
+        CBC_Free(cbc);
+
+    if(MAC_ContextRefIsValid(mac))
+        MAC_Free(mac);
+
+    if(msg) free(msg);
+    if(ct) free(ct);
+
+    return err;
+}
+
+/* 4KB pages scattered through a 64MB buffer, one call for all of them, next to a plain
+ copy of the same bytes as the memory bandwidth to aim for */
+static S4Err BenchXTSThroughput(Cipher_Algorithm algor, size_t sectorSize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    XTS_ContextRef  xts1 = kInvalidXTS_ContextRef;
+    XTS_ContextRef  xtsN = kInvalidXTS_ContextRef;
+    XTS_Sector      *sectors = NULL;
+    uint8_t         *buf = NULL;
+    uint8_t         *out = NULL;
+    uint8_t         key[64];
+    size_t          i, j;
+    const int       rounds = 4;
+    double          start, encTime, encNTime, decNTime, copyTime;
+
+    buf = malloc(sectorSize * count); CKNULL(buf);
+    out = malloc(sectorSize * count); CKNULL(out);
+    sectors = malloc(count * sizeof(XTS_Sector)); CKNULL(sectors);
+    err = RNG_GetBytes(buf, sectorSize * count); CKERR;
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    ZERO(out, sectorSize * count);
+
+    for(i = 0; i < count; i++)
+    {
+        j = (i * 4099) % count;
+        sectors[i].sector = j + 1000;
+        sectors[i].in     = buf + j * sectorSize;
+        sectors[i].out    = out + j * sectorSize;
+    }
+
+    err = XTS_Init(algor, key, sectorSize, 1, &xts1); CKERR;
+    err = XTS_Init(algor, key, sectorSize, 0, &xtsN); CKERR;
+
+    start = sNow();
+    for(i = 0; i < rounds; i++)
+        COPY(buf, out, sectorSize * count);
+    copyTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < rounds; i++)
+    {
+        err = XTS_EncryptSectors(xts1, sectors, count); CKERR;
+    }
+    encTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < rounds; i++)
+    {
+        err = XTS_EncryptSectors(xtsN, sectors, count); CKERR;
+    }
+    encNTime = sNow() - start;
+
+    for(i = 0; i < count; i++)
+        sectors[i].in = sectors[i].out;
+
+    start = sNow();
+    for(i = 0; i < rounds; i++)
+    {
+        err = XTS_DecryptSectors(xtsN, sectors, count); CKERR;
+    }
+    decNTime = sNow() - start;
+
+    OPTESTLogInfo("\t%10s %6zu byte sectors x %-6zu XTS encrypt %8.1f  threaded %8.1f  decrypt %8.1f  memcpy %8.1f MB/s\n",
+                  cipher_algor_table(algor), sectorSize, count,
+                  sectorSize * count * rounds / encTime / 1e6, sectorSize * count * rounds / encNTime / 1e6,
+                  sectorSize * count * rounds / decNTime / 1e6, sectorSize * count * rounds / copyTime / 1e6);
+
+done:
+
+    XTS_Free(xts1);
+    XTS_Free(xtsN);
+
+    if(buf) free(buf);
+    if(out) free(out);
+    if(sectors) free(sectors);
+
+    return err;
+}
+
+/* CBC decryption takes the whole buffer at once against the block at a time loop it replaced,
+ with encryption, where every block waits on the one before, for scale */
+static S4Err BenchCBCDecrypt(Cipher_Algorithm algor, size_t msgSize)
+{
+    S4Err           err = kS4Err_NoErr;
+    CBC_ContextRef  cbc = kInvalidCBC_ContextRef;
+    uint8_t         *msg = NULL;
+    uint8_t         *out = NULL;
+    uint8_t         key[32];
+    uint8_t         iv[16];
+    size_t          i;
+    double          start, encTime, decTime, blockTime;
+
+    msg = malloc(msgSize); CKNULL(msg);
+    out = malloc(msgSize); CKNULL(out);
+    err = RNG_GetBytes(msg, msgSize); CKERR;
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    err = RNG_GetBytes(iv, sizeof(iv)); CKERR;
+    ZERO(out, msgSize);
+
+    err = CBC_Init(algor, key, iv, &cbc); CKERR;
+    start = sNow();
+    err = CBC_Encrypt(cbc, msg, msgSize, out); CKERR;
+    encTime = sNow() - start;
+    CBC_Free(cbc);
+
+    err = CBC_Init(algor, key, iv, &cbc); CKERR;
+    start = sNow();
+    err = CBC_Decrypt(cbc, out, msgSize, msg); CKERR;
+    decTime = sNow() - start;
+    CBC_Free(cbc);
+
+    err = CBC_Init(algor, key, iv, &cbc); CKERR;
+    start = sNow();
+    for(i = 0; i < msgSize; i += 16)
+    {
+        err = CBC_Decrypt(cbc, out + i, 16, msg + i); CKERR;
+    }
+    blockTime = sNow() - start;
+
+    OPTESTLogInfo("\t%10s %8zu bytes            CBC decrypt %8.1f  block at a time %8.1f  encrypt %8.1f MB/s\n",
+                  cipher_algor_table(algor), msgSize,
+                  msgSize / decTime / 1e6, msgSize / blockTime / 1e6, msgSize / encTime / 1e6);
+
+done:
+
+    if(CBC_ContextRefIsValid(cbc))
+        CBC_Free(cbc);
+
+    if(msg) free(msg);
+    if(out) free(out);
+
+    return err;
+}
+
+/* count messages each under its own key, as when many keys are wrapped, through CBC_EncryptMulti
+ against a CBC context per message */
+static S4Err BenchCBCMulti(Cipher_Algorithm algor, size_t msgSize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    CBC_ContextRef  cbc = kInvalidCBC_ContextRef;
+    uint8_t         *msg = NULL;
+    uint8_t         *out = NULL;
+    uint8_t         *keys = NULL;
+    const void      **key = NULL, **iv = NULL, **in = NULL;
+    void            **outs = NULL;
+    size_t          *len = NULL;
+    size_t          i;
+    double          start, multiTime, loopTime;
+
+    msg  = malloc(msgSize * count); CKNULL(msg);
+    out  = malloc(msgSize * count); CKNULL(out);
+    keys = malloc(48 * count); CKNULL(keys);
+    key  = malloc(count * sizeof(void *)); CKNULL(key);
+    iv   = malloc(count * sizeof(void *)); CKNULL(iv);
+    in   = malloc(count * sizeof(void *)); CKNULL(in);
+    outs = malloc(count * sizeof(void *)); CKNULL(outs);
+    len  = malloc(count * sizeof(size_t)); CKNULL(len);
+    err = RNG_GetBytes(msg, msgSize * count); CKERR;
+    err = RNG_GetBytes(keys, 48 * count); CKERR;
+    ZERO(out, msgSize * count);
+
+    for(i = 0; i < count; i++)
+    {
+        key[i]  = keys + 48 * i;
+        iv[i]   = keys + 48 * i + 32;
+        in[i]   = msg + msgSize * i;
+        outs[i] = out + msgSize * i;
+        len[i]  = msgSize;
+    }
+
+    start = sNow();
+    err = CBC_EncryptMulti(algor, count, key, iv, in, len, outs); CKERR;
+    multiTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = CBC_Init(algor, key[i], iv[i], &cbc); CKERR;
+        err = CBC_Encrypt(cbc, in[i], msgSize, outs[i]); CKERR;
+        CBC_Free(cbc);
+        cbc = kInvalidCBC_ContextRef;
+    }
+    loopTime = sNow() - start;
+
+    OPTESTLogInfo("\t%10s %8zu bytes x %-6zu CBC multi   %8.1f  one at a time   %8.1f MB/s\n",
+                  cipher_algor_table(algor), msgSize, count,
+                  msgSize * count / multiTime / 1e6, msgSize * count / loopTime / 1e6);
+
+done:
+
+    if(CBC_ContextRefIsValid(cbc))
+        CBC_Free(cbc);
+
+    if(msg) free(msg);
+    if(out) free(out);
+    if(keys) free(keys);
+    if(key) free(key);
+    if(iv) free(iv);
+    if(in) free(in);
+    if(outs) free(outs);
+    if(len) free(len);
+
+    return err;
+}
+
+/* a tweek per block: TBC_SetTweek and TBC_Encrypt for each block against TBC_EncryptBlocks */
+static S4Err BenchTBCBlocks(Cipher_Algorithm algor, size_t blockSize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    TBC_ContextRef  tbc = kInvalidTBC_ContextRef;
+    uint8_t         key[128];
+    uint8_t         *buf = NULL;
+    uint64_t        *tweeks = NULL;
+    TBC_Block       *blocks = NULL;
+    size_t          i;
+    double          start, blocksTime, loopTime;
+
+    buf     = malloc(blockSize * count); CKNULL(buf);
+    tweeks  = malloc(2 * sizeof(uint64_t) * count); CKNULL(tweeks);
+    blocks  = malloc(sizeof(TBC_Block) * count); CKNULL(blocks);
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    err = RNG_GetBytes(buf, blockSize * count); CKERR;
+
+    for(i = 0; i < count; i++)
+    {
+        tweeks[2 * i]       = i;
+        tweeks[2 * i + 1]   = 0;
+        blocks[i].tweek     = tweeks + 2 * i;
+        blocks[i].in        = buf + blockSize * i;
+        blocks[i].out       = buf + blockSize * i;
+    }
+
+    err = TBC_Init(algor, key, &tbc); CKERR;
+
+    start = sNow();
+    err = TBC_EncryptBlocks(tbc, blocks, count); CKERR;
+    blocksTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = TBC_SetTweek(tbc, blocks[i].tweek); CKERR;
+        err = TBC_Encrypt(tbc, blocks[i].in, blocks[i].out); CKERR;
+    }
+    loopTime = sNow() - start;
+
+    OPTESTLogInfo("\t%14s %8zu blocks   TBC blocks %8.1f  one at a time   %8.1f MB/s\n",
+                  cipher_algor_table(algor), count,
+                  blockSize * count / blocksTime / 1e6, blockSize * count / loopTime / 1e6);
+
+done:
+
+    if(TBC_ContextRefIsValid(tbc))
+        TBC_Free(tbc);
+
+    if(buf) free(buf);
+    if(tweeks) free(tweeks);
+    if(blocks) free(blocks);
+
+    return err;
+}
+
+/* many GCM contexts alive at once, 256 byte packets round robin across them.
+ The 64KB tables stop fitting in the caches long before the compact layouts do */
+static S4Err BenchGCMContexts(Cipher_Algorithm algor)
+{
+    S4Err           err = kS4Err_NoErr;
+    GCM_ContextRef  *ctx = NULL;
+    GCM_Layout      layouts[] = { kGCM_Layout_Tables64K, kGCM_Layout_Table4Bit, kGCM_Layout_PCLMUL };
+    const char      *names[]  = { "64K tables", "4 bit table", "pclmul" };
+    size_t          counts[]  = { 1, 16, 256, 4096 };
+    const size_t    packetSize = 256;
+    const size_t    totalBytes = 32 << 20;
+    uint8_t         key[32];
+    uint8_t         iv[12];
+    uint8_t         packet[256];
+    double          start, initTime, runTime;
+    size_t          i, j, n, count = 0, p;
+
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    err = RNG_GetBytes(iv, sizeof(iv)); CKERR;
+    err = RNG_GetBytes(packet, sizeof(packet)); CKERR;
+
+    for(i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++)
+    {
+        for(j = 0; j < sizeof(counts) / sizeof(counts[0]); j++)
+        {
+            count = counts[j];
+            ctx = calloc(count, sizeof(GCM_ContextRef)); CKNULL(ctx);
+
+            start = sNow();
+            for(n = 0; n < count; n++)
+            {
+                err = GCM_InitWithLayout(algor, key, iv, sizeof(iv), layouts[i], &ctx[n]);
+                if(err == kS4Err_FeatureNotAvailable)
+                    break;
+                CKERR;
+                err = GCM_AddAAD(ctx[n], key, 13); CKERR;
+            }
+            initTime = sNow() - start;
+
+            /* PCLMUL is only there on CPUs that have it */
+            if(err == kS4Err_FeatureNotAvailable)
+            {
+                OPTESTLogInfo("\t%10s %-12s not available\n", cipher_algor_table(algor), names[i]);
+                err = kS4Err_NoErr;
+            }
+            else
+            {
+                start = sNow();
+                for(p = 0, n = 0; p < totalBytes; p += packetSize)
+                {
+                    err = GCM_Encrypt(ctx[n], packet, packetSize, packet); CKERR;
+                    if(++n == count) n = 0;
+                }
+                runTime = sNow() - start;
+
+                OPTESTLogInfo("\t%10s %-12s %5zu contexts  init %8.2f us  %8.1f MB/s\n",
+                              cipher_algor_table(algor), names[i], count,
+                              initTime / count * 1e6, totalBytes / runTime / 1e6);
+            }
+
+            for(n = 0; n < count; n++)
+                GCM_Free(ctx[n]);
+            free(ctx);
+            ctx = NULL;
+        }
+    }
+
+done:
+
+    if(ctx)
+    {
+        for(n = 0; n < count; n++)
+            GCM_Free(ctx[n]);
+        free(ctx);
+    }
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - ECC
+#endif
+
+/* key generation, then sign, verify and ECDH against one key pair */
+static S4Err BenchECC(int keySize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    ECC_ContextRef  ecc = kInvalidECC_ContextRef;
+    ECC_ContextRef  peer = kInvalidECC_ContextRef;
+    uint8_t         hash[48];
+    uint8_t         sig[256];
+    size_t          sigLen = 0;
+    uint8_t         secret[128];
+    size_t          secretLen = 0;
+    size_t          i;
+    double          start, genTime, signTime, verifyTime, dhTime;
+
+    err = RNG_GetBytes(hash, sizeof(hash)); CKERR;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = ECC_Init(&ecc); CKERR;
+        err = ECC_Generate(ecc, keySize); CKERR;
+        ECC_Free(ecc);
+        ecc = kInvalidECC_ContextRef;
+    }
+    genTime = sNow() - start;
+
+    err = ECC_Init(&ecc); CKERR;
+    err = ECC_Generate(ecc, keySize); CKERR;
+    err = ECC_Init(&peer); CKERR;
+    err = ECC_Generate(peer, keySize); CKERR;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = ECC_Sign(ecc, hash, sizeof(hash), sig, sizeof(sig), &sigLen); CKERR;
+    }
+    signTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = ECC_Verify(ecc, sig, sigLen, hash, sizeof(hash)); CKERR;
+    }
+    verifyTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = ECC_SharedSecret(ecc, peer, secret, sizeof(secret), &secretLen); CKERR;
+    }
+    dhTime = sNow() - start;
+
+    OPTESTLogInfo("\tECC-%d   generate %8.1f   sign %8.1f   verify %8.1f   ECDH %8.1f ops/s\n",
+                  keySize, count / genTime, count / signTime, count / verifyTime, count / dhTime);
+
+done:
+
+    if(ECC_ContextRefIsValid(ecc))
+        ECC_Free(ecc);
+
+    if(ECC_ContextRefIsValid(peer))
+        ECC_Free(peer);
+
+    return err;
+}
+
+#if _USES_XXHASH_
+
+#ifdef __clang__
+#pragma mark - xxHash
+#endif
+
+/* short keys, the HASH_DO one shot path against a context per key */
+static S4Err BenchXXHashShort(HASH_Algorithm algor, size_t msgSize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    HASH_ContextRef hashRef = kInvalidHASH_ContextRef;
+    uint8_t         msg[256];
+    uint8_t         hashBuf[16];
+    double          start, ctxTime, doTime;
+    size_t          i;
+
+    err = RNG_GetBytes(msg, sizeof(msg)); CKERR;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = HASH_Init(algor, &hashRef); CKERR;
+        err = HASH_Update(hashRef, msg, msgSize); CKERR;
+        err = HASH_Final(hashRef, hashBuf); CKERR;
+        HASH_Free(hashRef);
+        hashRef = kInvalidHASH_ContextRef;
+    }
+    ctxTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = HASH_DO(algor, msg, msgSize, sizeof(hashBuf), hashBuf); CKERR;
+    }
+    doTime = sNow() - start;
+
+    OPTESTLogInfo("\t%10s %5zu bytes  %10.0f msg/s  %10.0f msg/s  %5.2fx\n",
+                  hash_algor_table(algor), msgSize,
+                  count / ctxTime, count / doTime, ctxTime / doTime);
+
+done:
+
+    if(HASH_ContextRefIsValid(hashRef))
+        HASH_Free(hashRef);
+
+    return err;
+}
+
+#endif
+
+
+/* short messages through a fresh heap context each time, a context in a stack buffer, and one context restarted */
+
+static S4Err BenchHashContext(HASH_Algorithm algor, size_t msgSize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    HASH_ContextRef hashRef = kInvalidHASH_ContextRef;
+    uint8_t         ctxBuf[kHASH_ContextAllocSize];
+    uint8_t         msg[256];
+    uint8_t         hashBuf[64];
+    double          start, heapTime, inPlaceTime, resetTime;
+    size_t          i;
+
+    err = RNG_GetBytes(msg, sizeof(msg)); CKERR;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = HASH_Init(algor, &hashRef); CKERR;
+        err = HASH_Update(hashRef, msg, msgSize); CKERR;
+        err = HASH_Final(hashRef, hashBuf); CKERR;
+        HASH_Free(hashRef);
+        hashRef = kInvalidHASH_ContextRef;
+    }
+    heapTime = sNow() - start;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = HASH_InitInPlace(algor, ctxBuf, sizeof(ctxBuf), &hashRef); CKERR;
+        err = HASH_Update(hashRef, msg, msgSize); CKERR;
+        err = HASH_Final(hashRef, hashBuf); CKERR;
+        HASH_Free(hashRef);
+        hashRef = kInvalidHASH_ContextRef;
+    }
+    inPlaceTime = sNow() - start;
+
+    err = HASH_InitInPlace(algor, ctxBuf, sizeof(ctxBuf), &hashRef); CKERR;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = HASH_Reset(hashRef); CKERR;
+        err = HASH_Update(hashRef, msg, msgSize); CKERR;
+        err = HASH_Final(hashRef, hashBuf); CKERR;
+    }
+    resetTime = sNow() - start;
+
+    OPTESTLogInfo("\t%10s %4zu bytes  %10.0f  %10.0f  %10.0f msg/s\n",
+                  hash_algor_table(algor), msgSize,
+                  count / heapTime, count / inPlaceTime, count / resetTime);
+
+done:
+
+    if(HASH_ContextRefIsValid(hashRef))
+        HASH_Free(hashRef);
+
+    return err;
+}
+
+/* checkpoint a hash part way through a stream: HASH_Export, then HASH_Import into a new context */
+
+static S4Err BenchHashCheckpoint(HASH_Algorithm algor, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    HASH_ContextRef hashRef = kInvalidHASH_ContextRef;
+    HASH_ContextRef importRef = kInvalidHASH_ContextRef;
+    uint8_t         msg[4096];
+    uint8_t         exportBuf[kHASH_ExportMaxSize];
+    size_t          exportLen = 0;
+    double          start, elapsed;
+    size_t          i;
+
+    err = RNG_GetBytes(msg, sizeof(msg)); CKERR;
+
+    /* a chunk boundary that leaves a partial block behind */
+    err = HASH_Init(algor, &hashRef); CKERR;
+    for(i = 0; i < 256; i++)
+    {
+        err = HASH_Update(hashRef, msg, sizeof(msg)); CKERR;
+    }
+    err = HASH_Update(hashRef, msg, 37); CKERR;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = HASH_Export(hashRef, exportBuf, sizeof(exportBuf), &exportLen); CKERR;
+        err = HASH_Import(exportBuf, exportLen, &importRef); CKERR;
+        HASH_Free(importRef);
+        importRef = kInvalidHASH_ContextRef;
+    }
+    elapsed = sNow() - start;
+
+    OPTESTLogInfo("\t%10s  %4zu bytes  %10.0f checkpoints/s\n",
+                  hash_algor_table(algor), exportLen, count / elapsed);
+
+done:
+
+    if(HASH_ContextRefIsValid(importRef))
+        HASH_Free(importRef);
+
+    if(HASH_ContextRefIsValid(hashRef))
+        HASH_Free(hashRef);
+
+    return err;
+}
+
+/* MAC_Init for each message against MAC_Reset of one keyed context */
+
+static S4Err BenchMACContext(MAC_Algorithm mac, HASH_Algorithm algor, size_t msgSize, size_t count)
+{
+    S4Err           err = kS4Err_NoErr;
+    MAC_ContextRef  macRef = kInvalidMAC_ContextRef;
+    uint8_t         ctxBuf[kMAC_ContextAllocSize];
+    uint8_t         key[32];
+    uint8_t         msg[256];
+    uint8_t         macBuf[64];
+    size_t          macLen;
+    double          start, initTime, resetTime;
+    size_t          i;
+
+    err = RNG_GetBytes(key, sizeof(key)); CKERR;
+    err = RNG_GetBytes(msg, sizeof(msg)); CKERR;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = MAC_Init(mac, algor, key, sizeof(key), &macRef); CKERR;
+        err = MAC_Update(macRef, msg, msgSize); CKERR;
+        macLen = sizeof(macBuf);
+        err = MAC_Final(macRef, macBuf, &macLen); CKERR;
+        MAC_Free(macRef);
+        macRef = kInvalidMAC_ContextRef;
+    }
+    initTime = sNow() - start;
+
+    err = MAC_InitInPlace(mac, algor, key, sizeof(key), ctxBuf, sizeof(ctxBuf), &macRef); CKERR;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = MAC_Reset(macRef); CKERR;
+        err = MAC_Update(macRef, msg, msgSize); CKERR;
+        macLen = sizeof(macBuf);
+        err = MAC_Final(macRef, macBuf, &macLen); CKERR;
+    }
+    resetTime = sNow() - start;
+
+    OPTESTLogInfo("\t%5s %10s %4zu bytes  %10.0f  %10.0f msg/s  %5.2fx\n",
+                  mac_algor_table(mac), hash_algor_table(algor), msgSize,
+                  count / initTime, count / resetTime, initTime / resetTime);
+
+done:
+
+    if(MAC_ContextRefIsValid(macRef))
+        MAC_Free(macRef);
+
+    return err;
+}
+
+#ifdef __clang__
+#pragma mark - Multiple digests
+#endif
+
+/* one pass per algorithm vs a HASH_MultiInit context, over more data than the last level cache holds */
+
+static S4Err BenchHashMulti(const HASH_Algorithm algors[], size_t count, const uint8_t *msg, size_t msgSize)
+{
+    S4Err           err = kS4Err_NoErr;
+    HASH_ContextRef hashRef = kInvalidHASH_ContextRef;
+    uint8_t         hashBuf[kHASH_Multi_MaxCount * 128];
+    double          start, sepTime, multiTime;
+    size_t          i;
+
+    start = sNow();
+    for(i = 0; i < count; i++)
+    {
+        err = HASH_Init(algors[i], &hashRef); CKERR;
+        err = HASH_Update(hashRef, msg, msgSize); CKERR;
+        err = HASH_Final(hashRef, hashBuf); CKERR;
+        HASH_Free(hashRef);
+        hashRef = kInvalidHASH_ContextRef;
+    }
+    sepTime = sNow() - start;
+
+    start = sNow();
+    err = HASH_MultiInit(algors, count, &hashRef); CKERR;
+    err = HASH_Update(hashRef, msg, msgSize); CKERR;
+    err = HASH_Final(hashRef, hashBuf); CKERR;
+    multiTime = sNow() - start;
+
+    for(i = 0; i < count; i++)
+        OPTESTLogInfo("%s%s", i ? " + " : "\t", hash_algor_table(algors[i]));
+
+    OPTESTLogInfo("\n\t\t%8.1f MB/s  %8.1f MB/s  %5.2fx\n",
+                  msgSize / sepTime / 1e6, msgSize / multiTime / 1e6, sepTime / multiTime);
+
+done:
+
+    if(HASH_ContextRefIsValid(hashRef))
+        HASH_Free(hashRef);
+
+    return err;
+}
+
+
+#ifdef __clang__
+#pragma mark - File hashing
+#endif
+
+/* drop the file from the page cache where the OS lets us */
+
+static bool sDropFileCache(const char *path)
+{
+    bool    dropped = false;
+#if defined(POSIX_FADV_DONTNEED)
+    int     fd = open(path, O_RDONLY);
+    
+    if(fd >= 0)
+    {
+        dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        close(fd);
+    }
+#endif
+    return dropped;
+}
+
+/* the loop the tomcrypt hash_file / hmac_file helpers run, 512 byte freads on the calling thread */
+
+static S4Err sHashFileFread(HASH_Algorithm algor, const char *path, uint8_t *hashBuf)
+{
+    S4Err           err = kS4Err_NoErr;
+    HASH_ContextRef hashRef = kInvalidHASH_ContextRef;
+    FILE            *f = NULL;
+    uint8_t         buf[512];
+    size_t          n;
+    
+    f = fopen(path, "rb");
+    ASSERTERR(f != NULL, kS4Err_ResourceUnavailable);
+    
+    err = HASH_Init(algor, &hashRef); CKERR;
+    
+    do {
+        n = fread(buf, 1, sizeof(buf), f);
+        err = HASH_Update(hashRef, buf, n); CKERR;
+    } while(n == sizeof(buf));
+    
+    err = HASH_Final(hashRef, hashBuf); CKERR;
+    
+done:
+    
+    if(HASH_ContextRefIsValid(hashRef))
+        HASH_Free(hashRef);
+    
+    if(f) fclose(f);
+    
+    return err;
+}
+
+static S4Err BenchHashFile(HASH_Algorithm algor, const char *path, size_t fileSize)
+{
+    S4Err           err = kS4Err_NoErr;
+    uint8_t         hashBuf[64];
+    double          start, t[2][2];
+    int             cold, api;
+    bool            canDrop = true;
+    
+    for(cold = 1; cold >= 0; cold--)
+        for(api = 0; api < 2; api++)
+        {
+            if(cold)
+            {
+                canDrop = sDropFileCache(path);
+            }
+            else
+            {
+                /* warm it up */
+                err = HASH_File(algor, path, sizeof(hashBuf), hashBuf); CKERR;
+            }
+            
+            start = sNow();
+            
+            if(api == 0)
+                err = sHashFileFread(algor, path, hashBuf);
+            else
+                err = HASH_File(algor, path, sizeof(hashBuf), hashBuf);
+            CKERR;
+            
+            t[cold][api] = sNow() - start;
+        }
+    
+    OPTESTLogInfo("\t%10s  cold %8.1f  %8.1f MB/s%s   warm %8.1f  %8.1f MB/s\n",
+                  hash_algor_table(algor),
+                  fileSize / t[1][0] / 1e6, fileSize / t[1][1] / 1e6, canDrop ? "" : "*",
+                  fileSize / t[0][0] / 1e6, fileSize / t[0][1] / 1e6);
+    
+done:
+    
+    return err;
+}
+
+S4Err TestBenchmarks()
+{
+    S4Err err = kS4Err_NoErr;
+
+    HASH_Algorithm  batchAlgors[] = { kHASH_Algorithm_SHA256, kHASH_Algorithm_SHA512,
+                                      kHASH_Algorithm_SKEIN256, kHASH_Algorithm_SKEIN512 };
+    HASH_Algorithm  macAlgors[] = { kHASH_Algorithm_SKEIN256, kHASH_Algorithm_SKEIN512 };
+    size_t          batchSizes[] = { 64, 256, 512 };
+    int             i, j;
+
+    OPTESTLogInfo("\nBatch hashing: looping HASH_DO vs HASH_DOBatch\n");
+
+    for(i = 0; i < sizeof(batchAlgors) / sizeof(HASH_Algorithm); i++)
+        for(j = 0; j < sizeof(batchSizes) / sizeof(size_t); j++)
+        {
+            err = BenchHashBatch(batchAlgors[i], batchSizes[j], 200000); CKERR;
+        }
+
+    OPTESTLogInfo("\nBatch Skein-MAC: looping MAC_Init/Update/Final vs MAC_DOBatch\n");
+
+    for(i = 0; i < sizeof(macAlgors) / sizeof(HASH_Algorithm); i++)
+        for(j = 0; j < sizeof(batchSizes) / sizeof(size_t); j++)
+        {
+            err = BenchMACBatch(macAlgors[i], batchSizes[j], 200000); CKERR;
+        }
+
+    OPTESTLogInfo("\nSkein tree hashing: sequential HASH_DO vs tree mode leaves on a thread pool\n");
+
+    err = BenchSkeinTree(kHASH_Algorithm_SKEIN512, kHASH_Algorithm_SKEIN512_TREE, 256 << 20); CKERR;
+    err = BenchSkeinTree(kHASH_Algorithm_SKEIN1024, kHASH_Algorithm_SKEIN1024_TREE, 256 << 20); CKERR;
+
+    OPTESTLogInfo("\nBLAKE3: SIMD chunks and threaded subtrees vs SHA-256 and Skein-512\n");
+
+    err = BenchHashThroughput(kHASH_Algorithm_SHA256, 256 << 20); CKERR;
+    err = BenchHashThroughput(kHASH_Algorithm_SKEIN512, 256 << 20); CKERR;
+    err = BenchHashThroughput(kHASH_Algorithm_BLAKE3, 256 << 20); CKERR;
+
+    {
+        HASH_Algorithm  ctxAlgors[] = { kHASH_Algorithm_SHA256, kHASH_Algorithm_SHA512,
+                                        kHASH_Algorithm_SKEIN256, kHASH_Algorithm_BLAKE3 };
+
+        OPTESTLogInfo("\nHash contexts: HASH_Init on the heap vs HASH_InitInPlace vs HASH_Reset\n");
+
+        for(i = 0; i < sizeof(ctxAlgors) / sizeof(HASH_Algorithm); i++)
+        {
+            err = BenchHashContext(ctxAlgors[i], 64, 1000000); CKERR;
+        }
+
+        OPTESTLogInfo("\nHash checkpoints: HASH_Export and HASH_Import after 1 MB (the context is %d bytes)\n",
+                      kHASH_ContextAllocSize);
+
+        for(i = 0; i < sizeof(ctxAlgors) / sizeof(HASH_Algorithm); i++)
+        {
+            err = BenchHashCheckpoint(ctxAlgors[i], 1000000); CKERR;
+        }
+
+        OPTESTLogInfo("\nMAC contexts: MAC_Init per message vs MAC_Reset\n");
+
+        err = BenchMACContext(kMAC_Algorithm_HMAC, kHASH_Algorithm_SHA256, 64, 1000000); CKERR;
+        err = BenchMACContext(kMAC_Algorithm_HMAC, kHASH_Algorithm_SHA512, 64, 1000000); CKERR;
+        err = BenchMACContext(kMAC_Algorithm_SKEIN, kHASH_Algorithm_SKEIN256, 64, 1000000); CKERR;
+    }
+
+    {
+#if _USES_XXHASH_
+        HASH_Algorithm  ingestAlgors[] = { kHASH_Algorithm_SHA256, kHASH_Algorithm_SHA512,
+                                           kHASH_Algorithm_xxHash64 };
+        HASH_Algorithm  fastAlgors[] = { kHASH_Algorithm_xxHash64, kHASH_Algorithm_xxHash3_64,
+                                         kHASH_Algorithm_BLAKE3 };
+#else
+        HASH_Algorithm  ingestAlgors[] = { kHASH_Algorithm_SHA256, kHASH_Algorithm_SHA512 };
+#endif
+        size_t          msgSize = (size_t) 1 << 30;
+        uint8_t         *msg = malloc(msgSize);
+        size_t          n;
+
+        if(msg)
+        {
+            /* touch it all so page faults are not timed */
+            for(n = 0; n < msgSize; n++)
+                msg[n] = n & 0xFF;
+
+            OPTESTLogInfo("\nMultiple digests, %zu MB: one pass per algorithm vs HASH_MultiInit\n", msgSize >> 20);
+
+            err = BenchHashMulti(ingestAlgors, sizeof(ingestAlgors) / sizeof(HASH_Algorithm), msg, msgSize);
+#if _USES_XXHASH_
+            if(IsntS4Err(err))
+                err = BenchHashMulti(fastAlgors, sizeof(fastAlgors) / sizeof(HASH_Algorithm), msg, msgSize);
+#endif
+            free(msg);
+            CKERR;
+        }
+    }
+
+    {
+        HASH_Algorithm  fileAlgors[] = { kHASH_Algorithm_SHA256, kHASH_Algorithm_SKEIN512,
+                                         kHASH_Algorithm_BLAKE3 };
+        size_t          fileSize = 512 << 20;
+        const char      *tmpDir = getenv("TMPDIR");
+        char            path[1024];
+        uint8_t         *chunk = NULL;
+        FILE            *f = NULL;
+        int             fd;
+        size_t          n;
+        
+        snprintf(path, sizeof(path), "%s/optest-bench-XXXXXX", tmpDir ? tmpDir : "/tmp");
+        fd = mkstemp(path);
+        ASSERTERR(fd >= 0, kS4Err_ResourceUnavailable);
+        
+        chunk = malloc(1 << 20);
+        f = fdopen(fd, "wb");
+        
+        if(chunk && f)
+        {
+            for(n = 0; n < fileSize; n += 1 << 20)
+            {
+                RNG_GetBytes(chunk, 1 << 20);
+                fwrite(chunk, 1, 1 << 20, f);
+            }
+            fflush(f);
+            fsync(fd);
+            
+            OPTESTLogInfo("\nFile hashing, %zu MB: 512 byte fread loop (hash_file) vs HASH_File\n", fileSize >> 20);
+            
+            for(i = 0; i < sizeof(fileAlgors) / sizeof(HASH_Algorithm) && IsntS4Err(err); i++)
+                err = BenchHashFile(fileAlgors[i], path, fileSize);
+        }
+        
+        if(f) fclose(f); else close(fd);
+        if(chunk) free(chunk);
+        unlink(path);
+        CKERR;
+    }
+
+    {
+        char version[256];
+
+        err = S4_GetVersionString(sizeof(version), version); CKERR;
+        OPTESTLogInfo("\nAES bulk, %s\n", version);
+    }
+
+    err = BenchCipherThroughput(kCipher_Algorithm_AES128, 64 << 20); CKERR;
+    err = BenchCipherThroughput(kCipher_Algorithm_AES256, 64 << 20); CKERR;
+    err = BenchCTRThroughput(kCipher_Algorithm_AES128, 256 << 20); CKERR;
+    err = BenchCTRThroughput(kCipher_Algorithm_AES256, 256 << 20); CKERR;
+    err = BenchCTRThroughput(kCipher_Algorithm_2FISH256, 64 << 20); CKERR;
+    err = BenchCTRThroughput(kCipher_Algorithm_3FISH256, 64 << 20); CKERR;
+    err = BenchCTRThroughput(kCipher_Algorithm_3FISH512, 64 << 20); CKERR;
+    err = BenchCTRThroughput(kCipher_Algorithm_3FISH1024, 64 << 20); CKERR;
+    err = BenchGCMThroughput(kCipher_Algorithm_AES128, 256 << 20); CKERR;
+    err = BenchGCMThroughput(kCipher_Algorithm_AES256, 256 << 20); CKERR;
+    err = BenchGCMThroughput(kCipher_Algorithm_2FISH256, 64 << 20); CKERR;
+    err = BenchGCMContexts(kCipher_Algorithm_AES128); CKERR;
+    err = BenchChaChaPolyThroughput(64 << 20, 4); CKERR;
+    err = BenchChaChaPolyThroughput(1500, 20000); CKERR;
+    err = BenchOCBThroughput(kCipher_Algorithm_AES128, 64 << 20, 4); CKERR;
+    err = BenchOCBThroughput(kCipher_Algorithm_AES256, 64 << 20, 4); CKERR;
+    err = BenchOCBThroughput(kCipher_Algorithm_AES128, 1504, 20000); CKERR;
+    err = BenchXTSThroughput(kCipher_Algorithm_AES128, 4096, 16384); CKERR;
+    err = BenchXTSThroughput(kCipher_Algorithm_AES256, 4096, 16384); CKERR;
+    err = BenchXTSThroughput(kCipher_Algorithm_AES256, 512, 131072); CKERR;
+    err = BenchCBCDecrypt(kCipher_Algorithm_AES128, 64 << 20); CKERR;
+    err = BenchCBCDecrypt(kCipher_Algorithm_AES256, 64 << 20); CKERR;
+    err = BenchCBCMulti(kCipher_Algorithm_AES256, 64, 100000); CKERR;
+    err = BenchCBCMulti(kCipher_Algorithm_AES256, 4096, 4096); CKERR;
+    err = BenchTBCBlocks(kCipher_Algorithm_3FISH256, 32, 1 << 20); CKERR;
+    err = BenchTBCBlocks(kCipher_Algorithm_3FISH512, 64, 1 << 19); CKERR;
+    err = BenchTBCBlocks(kCipher_Algorithm_3FISH1024, 128, 1 << 18); CKERR;
+
+    OPTESTLogInfo("\nECC\n");
+
+    err = BenchECC(384, 200); CKERR;
+    err = BenchECC(414, 200); CKERR;
+
+#if _USES_XXHASH_
+    {
+        HASH_Algorithm  xxAlgors[] = { kHASH_Algorithm_xxHash64, kHASH_Algorithm_xxHash3_64,
+                                       kHASH_Algorithm_xxHash128 };
+        size_t          keySizes[] = { 8, 16, 64, 200 };
+
+        OPTESTLogInfo("\nxxHash short keys: HASH_Init/Update/Final vs HASH_DO\n");
+
+        for(i = 0; i < sizeof(xxAlgors) / sizeof(HASH_Algorithm); i++)
+            for(j = 0; j < sizeof(keySizes) / sizeof(size_t); j++)
+            {
+                err = BenchXXHashShort(xxAlgors[i], keySizes[j], 2000000); CKERR;
+            }
+
+        OPTESTLogInfo("\nxxHash bulk\n");
+
+        for(i = 0; i < sizeof(xxAlgors) / sizeof(HASH_Algorithm); i++)
+        {
+            err = BenchHashThroughput(xxAlgors[i], 256 << 20); CKERR;
+        }
+    }
+#endif
+
+    OPTESTLogInfo("\n");
+
+done:
+    return err;
+}
@@ -33,6 +33,30 @@ typedef struct  {
 
 
 
+/* an ECB context expands the key once and has to match the one shot calls */
+
+static S4Err RunECBContext(katvector *kat, uint8_t *out)
+{
+    S4Err   err = kS4Err_NoErr;
+    ECB_ContextRef  ECB = kInvalidECB_ContextRef;
+    size_t  i;
+
+    err = ECB_Init(kat->algor, kat->key, &ECB); CKERR;
+
+    for(i = 0; i < kat->PTlen; i += 16)
+    {
+        err = ECB_Process(ECB, true, kat->PT + i, 16, out + i); CKERR;
+    }
+    err = compareResults( kat->EBC, out, kat->EBClen , kResultFormat_Byte, "ECB context Encrypt"); CKERR;
+
+    err = ECB_Process(ECB, false, out, kat->PTlen, out); CKERR;
+    err = compareResults( kat->PT, out, kat->PTlen , kResultFormat_Byte, "ECB context Decrypt"); CKERR;
+
+done:
+    ECB_Free(ECB);
+    return err;
+}
+
 static S4Err RunCipherKAT(  katvector *kat)
 
 {
@@ -66,6 +90,9 @@ static S4Err RunCipherKAT(  katvector *kat)
         
         /* check against orginal plain-text  */
         err = compareResults( kat->PT, out, kat->PTlen , kResultFormat_Byte, "Symmetric Decrypt"); CKERR;
+        
+        /* the same through one expanded key, a block at a time as when wrapping keys */
+        err = RunECBContext(kat, out); CKERR;
     }
     
     if(kat->CBC && kat->CBClen > 0)
@@ -130,14 +157,846 @@ done:
     return err;
 }
 
+/* the AES backends share the eK/dK key layout, so a key expanded under one has to encrypt
+ and decrypt under every other.  37 blocks go through the multi-block paths and the tail */
+
+static S4Err RunAESAcrossBackends(Cipher_Algorithm algor, const uint8_t *key,
+                                  const OPTESTKernel *kernels, int kernelCount)
+{
+    S4Err           err = kS4Err_NoErr;
+    ECB_ContextRef  ECB = kInvalidECB_ContextRef;
+    uint8_t         PT[16 * 37];
+    uint8_t         CT[sizeof(PT)];
+    uint8_t         out[sizeof(PT)];
+    int             i, j;
+    
+    for(i = 0; i < sizeof(PT); i++)
+        PT[i] = (uint8_t)(i * 13 + 5);
+    
+    OPTESTResetKernel();
+    err = ECB_Encrypt(algor, key, PT, sizeof(PT), CT); CKERR;
+    
+    for(i = 0; i < kernelCount; i++)
+    {
+        if(!OPTESTUseKernel(&kernels[i]))
+            continue;
+        
+        err = ECB_Init(algor, key, &ECB); CKERR;
+        
+        for(j = 0; j < kernelCount; j++)
+        {
+            if(!OPTESTUseKernel(&kernels[j]))
+                continue;
+            
+            err = ECB_Process(ECB, true, PT, sizeof(PT), out); CKERR;
+            err = compareResults(CT, out, sizeof(CT), kResultFormat_Byte, "AES key across backends"); CKERR;
+            
+            err = ECB_Process(ECB, false, CT, sizeof(CT), out); CKERR;
+            err = compareResults(PT, out, sizeof(PT), kResultFormat_Byte, "AES key across backends"); CKERR;
+        }
+        
+        ECB_Free(ECB);
+        ECB = kInvalidECB_ContextRef;
+    }
+    
+done:
+    
+    if(ECB_ContextRefIsValid(ECB))
+        ECB_Free(ECB);
+    
+    OPTESTResetKernel();
+    
+    return err;
+}
+
+/* many short messages under their own keys in one call, as when wrapping keys, have to match
+ one CBC context per message.  The count crosses a scheduling group, some are empty, one is
+ long enough to be left running alone, and every other one is encrypted in place */
+
+static S4Err RunCBCMulti(Cipher_Algorithm algor, const uint8_t *baseKey, size_t keyLen)
+{
+    S4Err   err = kS4Err_NoErr;
+    CBC_ContextRef  CBC = kInvalidCBC_ContextRef;
+    enum { kCount = 77 };
+    uint8_t     keys[kCount][32], IVs[kCount][16];
+    uint8_t     *msg[kCount] = { NULL }, *ref[kCount] = { NULL }, *ct[kCount] = { NULL };
+    const void  *key[kCount], *iv[kCount], *in[kCount];
+    void        *out[kCount];
+    size_t      len[kCount];
+    size_t      i, j;
+
+    for(i = 0; i < kCount; i++)
+    {
+        len[i] = (i == 5) ? 4096 * 16 : ((i * 37) % 41) * 16;
+        for(j = 0; j < keyLen; j++) keys[i][j] = baseKey[j] ^ (uint8_t)(i * 3 + j);
+        for(j = 0; j < 16; j++) IVs[i][j] = (uint8_t)(i + j * 5);
+
+        msg[i] = malloc(len[i] + 1);
+        ref[i] = malloc(len[i] + 1);
+        ct[i]  = malloc(len[i] + 1);
+        CKNULL(msg[i]); CKNULL(ref[i]); CKNULL(ct[i]);
+        for(j = 0; j < len[i]; j++) msg[i][j] = (uint8_t)(i ^ (j * 13));
+
+        err = CBC_Init(algor, keys[i], IVs[i], &CBC); CKERR;
+        err = CBC_Encrypt(CBC, msg[i], len[i], ref[i]); CKERR;
+        CBC_Free(CBC);
+        CBC = kInvalidCBC_ContextRef;
+
+        if(i & 1) COPY(msg[i], ct[i], len[i]);
+        key[i] = keys[i];
+        iv[i]  = IVs[i];
+        in[i]  = (i & 1) ? ct[i] : msg[i];
+        out[i] = ct[i];
+    }
+
+    err = CBC_EncryptMulti(algor, kCount, key, iv, in, len, out); CKERR;
+
+    for(i = 0; i < kCount; i++)
+    {
+        err = compareResults( ref[i], ct[i], len[i], kResultFormat_Byte, "CBC Multi Encrypt"); CKERR;
+
+        err = CBC_Init(algor, keys[i], IVs[i], &CBC); CKERR;
+        err = CBC_Decrypt(CBC, ct[i], len[i], ct[i]); CKERR;
+        err = compareResults( msg[i], ct[i], len[i], kResultFormat_Byte, "CBC Multi Decrypt"); CKERR;
+        CBC_Free(CBC);
+        CBC = kInvalidCBC_ContextRef;
+    }
+
+done:
+    if(CBC_ContextRefIsValid(CBC))
+        CBC_Free(CBC);
+
+    for(i = 0; i < kCount; i++)
+    {
+        if(msg[i]) free(msg[i]);
+        if(ref[i]) free(ref[i]);
+        if(ct[i]) free(ct[i]);
+    }
+    return err;
+}
+
+
+/* counter mode, the known answers are NIST SP 800-38A F.5.1 and F.5.5 */
+
+static S4Err RunCTRKAT(Cipher_Algorithm algor, const uint8_t *key, const uint8_t *expected)
+{
+    S4Err   err = kS4Err_NoErr;
+    CTR_ContextRef  CTR = kInvalidCTR_ContextRef;
+    uint8_t out[64];
+    size_t  i;
+
+    uint8_t IV[] = {
+        0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+    };
+
+    uint8_t PT[] = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+        0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+        0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+        0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+    };
+
+    err = CTR_Init(algor, key, IV, 1, &CTR); CKERR;
+    err = CTR_Update(CTR, PT, sizeof(PT), out); CKERR;
+    err = compareResults( expected, out, sizeof(PT), kResultFormat_Byte, "CTR Encrypt"); CKERR;
+
+    /* a byte at a time from the middle of a block */
+    err = CTR_Seek(CTR, 21); CKERR;
+    for(i = 21; i < sizeof(PT); i++)
+    {
+        err = CTR_Update(CTR, out + i, 1, out + i); CKERR;
+    }
+    err = CTR_Seek(CTR, 0); CKERR;
+    err = CTR_Update(CTR, out, 21, out); CKERR;
+    err = compareResults( PT, out, sizeof(PT), kResultFormat_Byte, "CTR Decrypt"); CKERR;
+
+done:
+    CTR_Free(CTR);
+    return err;
+}
+
+/* the Threefish keystream one block at a time, block n is the IV and zeros
+ encrypted with n as the tweek */
+
+static S4Err sTBCKeystream(Cipher_Algorithm algor, const uint8_t *key, const uint8_t *IV,
+                           uint8_t *ref, size_t len)
+{
+    S4Err   err = kS4Err_NoErr;
+    TBC_ContextRef  TBC = kInvalidTBC_ContextRef;
+    uint8_t block[128];
+    uint8_t tweek[16];
+    uint64_t n;
+    size_t  blockSize, i;
+    int     j;
+
+    blockSize = algor == kCipher_Algorithm_3FISH256 ? 32 : algor == kCipher_Algorithm_3FISH512 ? 64 : 128;
+
+    ZERO(block, sizeof(block));
+    ZERO(tweek, sizeof(tweek));
+    COPY(IV, block, 16);
+
+    /* the block number is the first 8 bytes of the tweak, little endian */
+    err = TBC_Init(algor, key, &TBC); CKERR;
+    for(i = 0, n = 0; i < len; i += blockSize, n++)
+    {
+        for(j = 0; j < 8; j++)
+            tweek[j] = (uint8_t)(n >> (8 * j));
+        err = TBC_SetTweek(TBC, tweek); CKERR;
+        err = TBC_Encrypt(TBC, block, ref + i); CKERR;
+    }
+
+done:
+    if(TBC_ContextRefIsValid(TBC))
+        TBC_Free(TBC);
+    return err;
+}
+
+/* long streams against counter blocks run through ECB, with the counter carrying
+ out of the low 64 bits, or against Threefish one block at a time.  Split updates,
+ seeks and the threaded path all have to agree */
+
+static S4Err RunCTRStream(Cipher_Algorithm algor, const uint8_t *key)
+{
+    S4Err   err = kS4Err_NoErr;
+    CTR_ContextRef  CTR = kInvalidCTR_ContextRef;
+    const size_t    len = (3 << 20) + 1234;
+    uint8_t *in = NULL, *ref = NULL, *out = NULL;
+    uint8_t IV[16], ctr[16];
+    size_t  i, n, offset;
+    int     j;
+
+    in  = malloc(len);
+    ref = malloc(len + 128);
+    out = malloc(len);
+    CKNULL(in); CKNULL(ref); CKNULL(out);
+
+    for(i = 0; i < len; i++) in[i] = (uint8_t)(i * 7 + (i >> 11));
+    for(i = 0; i < 16; i++) IV[i] = (i < 8) ? (uint8_t)(0x30 + i) : 0xFF;
+    IV[15] = 0xF0;
+
+    if(algor == kCipher_Algorithm_3FISH256 || algor == kCipher_Algorithm_3FISH512 || algor == kCipher_Algorithm_3FISH1024)
+    {
+        err = sTBCKeystream(algor, key, IV, ref, len); CKERR;
+    }
+    else
+    {
+        COPY(IV, ctr, 16);
+        for(i = 0; i < len; i += 16)
+        {
+            COPY(ctr, ref + i, 16);
+            for(j = 15; j >= 0 && ++ctr[j] == 0; j--);
+        }
+        err = ECB_Encrypt(algor, key, ref, (len + 15) & ~15UL, ref); CKERR;
+    }
+    for(i = 0; i < len; i++) ref[i] ^= in[i];
+
+    /* one update, split across threads */
+    err = CTR_Init(algor, key, IV, 4, &CTR); CKERR;
+    err = CTR_Update(CTR, in, len, out); CKERR;
+    err = compareResults( ref, out, len, kResultFormat_Byte, "CTR threaded"); CKERR;
+    CTR_Free(CTR);
+    CTR = kInvalidCTR_ContextRef;
+
+    /* uneven updates on one thread */
+    err = CTR_Init(algor, key, IV, 1, &CTR); CKERR;
+    for(offset = 0, n = 1; offset < len; offset += n, n = n * 3 + 5)
+    {
+        if(n > len - offset) n = len - offset;
+        err = CTR_Update(CTR, in + offset, n, out + offset); CKERR;
+    }
+    err = compareResults( ref, out, len, kResultFormat_Byte, "CTR split"); CKERR;
+
+    /* random access, backwards through the stream */
+    ZERO(out, len);
+    for(offset = len, n = 1; offset > 0; offset -= n, n = n * 5 + 3)
+    {
+        if(n > offset) n = offset;
+        err = CTR_Seek(CTR, offset - n); CKERR;
+        err = CTR_Update(CTR, in + offset - n, n, out + offset - n); CKERR;
+    }
+    err = compareResults( ref, out, len, kResultFormat_Byte, "CTR seek"); CKERR;
+
+done:
+    CTR_Free(CTR);
+    if(in) free(in);
+    if(ref) free(ref);
+    if(out) free(out);
+    return err;
+}
+
+/* GCM, the known answers are test cases 4, 6 and 16 of the McGrew and Viega GCM
+ specification.  The 60 byte text ends in a partial block, case 6 has a 60 byte IV */
+
+static S4Err RunGCMKAT(Cipher_Algorithm algor, const uint8_t *key,
+                       const uint8_t *IV, size_t ivLen,
+                       const uint8_t *expected, const uint8_t *expectedTag)
+{
+    S4Err   err = kS4Err_NoErr;
+    GCM_ContextRef  GCM = kInvalidGCM_ContextRef;
+    uint8_t out[60];
+    uint8_t tag[16];
+
+    uint8_t PT[] = {
+        0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5, 0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,
+        0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda, 0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72,
+        0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53, 0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,
+        0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57, 0xba, 0x63, 0x7b, 0x39
+    };
+
+    uint8_t AAD[] = {
+        0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef, 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+        0xab, 0xad, 0xda, 0xd2
+    };
+
+    err = GCM_EncryptAEAD(algor, key, IV, ivLen, AAD, sizeof(AAD), PT, sizeof(PT), out, tag, sizeof(tag)); CKERR;
+    err = compareResults( expected, out, sizeof(PT), kResultFormat_Byte, "GCM Encrypt"); CKERR;
+    err = compareResults( expectedTag, tag, sizeof(tag), kResultFormat_Byte, "GCM Tag"); CKERR;
+
+    /* in place, in pieces that straddle the blocks */
+    err = GCM_Init(algor, key, IV, ivLen, &GCM); CKERR;
+    err = GCM_AddAAD(GCM, AAD, 3); CKERR;
+    err = GCM_AddAAD(GCM, AAD + 3, sizeof(AAD) - 3); CKERR;
+    err = GCM_Decrypt(GCM, out, 17, out); CKERR;
+    err = GCM_Decrypt(GCM, out + 17, sizeof(PT) - 17, out + 17); CKERR;
+    err = GCM_Final(GCM, tag, 12); CKERR;
+    err = compareResults( PT, out, sizeof(PT), kResultFormat_Byte, "GCM Decrypt"); CKERR;
+    GCM_Free(GCM);
+    GCM = kInvalidGCM_ContextRef;
+
+    /* a tag that does not match leaves nothing behind */
+    err = GCM_EncryptAEAD(algor, key, IV, ivLen, AAD, sizeof(AAD), PT, sizeof(PT), out, tag, sizeof(tag)); CKERR;
+    tag[15] ^= 1;
+    err = GCM_DecryptAEAD(algor, key, IV, ivLen, AAD, sizeof(AAD), out, sizeof(PT), out, tag, sizeof(tag));
+    if(err != kS4Err_BadIntegrity || out[0] != 0 || out[sizeof(PT) - 1] != 0)
+    {
+        OPTESTLogError("\tGCM accepted a bad tag\n");
+        RETERR(kS4Err_SelfTestFailed);
+    }
+    err = kS4Err_NoErr;
+
+done:
+    GCM_Free(GCM);
+    return err;
+}
+
+/* long streams, where the CTR part can be checked against CTR_Update starting at
+ counter 2 and the tag against one made elsewhere.  Uneven updates and each table
+ layout have to agree with the one shot calls, a context only goes one way */
+
+static S4Err RunGCMStream(Cipher_Algorithm algor, const uint8_t *key, const uint8_t *expectedTag)
+{
+    S4Err   err = kS4Err_NoErr;
+    GCM_ContextRef  GCM = kInvalidGCM_ContextRef;
+    CTR_ContextRef  CTR = kInvalidCTR_ContextRef;
+    const size_t    len = (1 << 20) + 1234;
+    uint8_t *in = NULL, *ref = NULL, *out = NULL;
+    uint8_t IV[12], ctr[16], AAD[1000], tag[16], refTag[16];
+    size_t  i, j, n, offset;
+    GCM_Layout  layouts[] = { kGCM_Layout_Tables64K, kGCM_Layout_Table4Bit, kGCM_Layout_PCLMUL };
+
+    in  = malloc(len);
+    ref = malloc(len);
+    out = malloc(len);
+    CKNULL(in); CKNULL(ref); CKNULL(out);
+
+    for(i = 0; i < len; i++) in[i] = (uint8_t)(i * 7 + (i >> 11));
+    for(i = 0; i < sizeof(AAD); i++) AAD[i] = (uint8_t)(i * 13);
+    for(i = 0; i < sizeof(IV); i++) IV[i] = (uint8_t)(0x20 + i);
+
+    COPY(IV, ctr, 12);
+    ctr[12] = ctr[13] = ctr[14] = 0;
+    ctr[15] = 2;
+    err = CTR_Init(algor, key, ctr, 1, &CTR); CKERR;
+    err = CTR_Update(CTR, in, len, ref); CKERR;
+
+    err = GCM_EncryptAEAD(algor, key, IV, sizeof(IV), AAD, sizeof(AAD), in, len, out, refTag, sizeof(refTag)); CKERR;
+    err = compareResults( ref, out, len, kResultFormat_Byte, "GCM stream"); CKERR;
+    if(expectedTag)
+    {
+        err = compareResults( expectedTag, refTag, sizeof(refTag), kResultFormat_Byte, "GCM stream tag"); CKERR;
+    }
+
+    /* uneven updates */
+    ZERO(out, len);
+    err = GCM_Init(algor, key, IV, sizeof(IV), &GCM); CKERR;
+    for(offset = 0, n = 1; offset < sizeof(AAD); offset += n, n = n * 2 + 7)
+    {
+        if(n > sizeof(AAD) - offset) n = sizeof(AAD) - offset;
+        err = GCM_AddAAD(GCM, AAD + offset, n); CKERR;
+    }
+    for(offset = 0, n = 1; offset < len; offset += n, n = n * 3 + 5)
+    {
+        if(n > len - offset) n = len - offset;
+        err = GCM_Encrypt(GCM, in + offset, n, out + offset); CKERR;
+    }
+    err = GCM_Final(GCM, tag, sizeof(tag)); CKERR;
+    err = compareResults( ref, out, len, kResultFormat_Byte, "GCM split"); CKERR;
+    err = compareResults( refTag, tag, sizeof(tag), kResultFormat_Byte, "GCM split tag"); CKERR;
+
+    if(GCM_Decrypt(GCM, out, 16, out) != kS4Err_BadParams)
+    {
+        OPTESTLogError("\tGCM decrypted on an encrypting context\n");
+        RETERR(kS4Err_SelfTestFailed);
+    }
+    GCM_Free(GCM);
+    GCM = kInvalidGCM_ContextRef;
+
+    /* every table layout hashes the same, PCLMUL is only there on CPUs that have it */
+    for(j = 0; j < sizeof(layouts) / sizeof(layouts[0]); j++)
+    {
+        err = GCM_InitWithLayout(algor, key, IV, sizeof(IV), layouts[j], &GCM);
+        if(err == kS4Err_FeatureNotAvailable)
+        {
+            err = kS4Err_NoErr;
+            continue;
+        }
+        CKERR;
+        ZERO(out, len);
+        err = GCM_AddAAD(GCM, AAD, sizeof(AAD)); CKERR;
+        for(offset = 0, n = 3; offset < len; offset += n, n = n * 4 + 1)
+        {
+            if(n > len - offset) n = len - offset;
+            err = GCM_Encrypt(GCM, in + offset, n, out + offset); CKERR;
+        }
+        err = GCM_Final(GCM, tag, sizeof(tag)); CKERR;
+        err = compareResults( ref, out, len, kResultFormat_Byte, "GCM layout"); CKERR;
+        err = compareResults( refTag, tag, sizeof(tag), kResultFormat_Byte, "GCM layout tag"); CKERR;
+        GCM_Free(GCM);
+        GCM = kInvalidGCM_ContextRef;
+    }
+
+    /* back in place */
+    err = GCM_Init(algor, key, IV, sizeof(IV), &GCM); CKERR;
+    err = GCM_AddAAD(GCM, AAD, sizeof(AAD)); CKERR;
+    for(offset = 0, n = 5; offset < len; offset += n, n = n * 5 + 3)
+    {
+        if(n > len - offset) n = len - offset;
+        err = GCM_Decrypt(GCM, out + offset, n, out + offset); CKERR;
+    }
+    err = GCM_Final(GCM, refTag, sizeof(refTag)); CKERR;
+    err = compareResults( in, out, len, kResultFormat_Byte, "GCM split decrypt"); CKERR;
+
+done:
+    GCM_Free(GCM);
+    CTR_Free(CTR);
+    if(in) free(in);
+    if(ref) free(ref);
+    if(out) free(out);
+    return err;
+}
+
+/* ChaCha20-Poly1305, the known answer is the AEAD example of RFC 8439 section 2.8.2,
+ the 114 byte text ends in a partial block and so does the AAD */
+
+static S4Err RunChaChaPolyKAT(void)
+{
+    S4Err   err = kS4Err_NoErr;
+    CHACHAPOLY_ContextRef  CP = kInvalidCHACHAPOLY_ContextRef;
+    uint8_t out[114];
+    uint8_t tag[kCHACHAPOLY_TagSize];
+
+    uint8_t key[] = {
+        0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
+        0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f
+    };
+
+    uint8_t nonce[] = {
+        0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47
+    };
+
+    uint8_t AAD[] = {
+        0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7
+    };
+
+    const char *PT = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+
+    uint8_t expected[] = {
+        0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e, 0xc2,
+        0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe, 0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee, 0x62, 0xd6,
+        0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9, 0x67, 0x12, 0x82, 0xfa, 0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b,
+        0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29, 0x05, 0xd6, 0xa5, 0xb6, 0x7e, 0xcd, 0x3b, 0x36,
+        0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c, 0x98, 0x03, 0xae, 0xe3, 0x28, 0x09, 0x1b, 0x58,
+        0xfa, 0xb3, 0x24, 0xe4, 0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc,
+        0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5, 0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b,
+        0x61, 0x16
+    };
+
+    uint8_t expectedTag[] = {
+        0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a, 0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91
+    };
+
+    err = CHACHAPOLY_EncryptAEAD(kCipher_Algorithm_ChaCha20, key, nonce, sizeof(nonce), AAD, sizeof(AAD),
+                                 PT, sizeof(out), out, tag, sizeof(tag)); CKERR;
+    err = compareResults( expected, out, sizeof(out), kResultFormat_Byte, "ChaCha20-Poly1305 Encrypt"); CKERR;
+    err = compareResults( expectedTag, tag, sizeof(tag), kResultFormat_Byte, "ChaCha20-Poly1305 Tag"); CKERR;
+
+    /* in place, in pieces that straddle the blocks */
+    err = CHACHAPOLY_Init(kCipher_Algorithm_ChaCha20, key, nonce, sizeof(nonce), &CP); CKERR;
+    err = CHACHAPOLY_AddAAD(CP, AAD, 5); CKERR;
+    err = CHACHAPOLY_AddAAD(CP, AAD + 5, sizeof(AAD) - 5); CKERR;
+    err = CHACHAPOLY_Decrypt(CP, out, 17, out); CKERR;
+    err = CHACHAPOLY_Decrypt(CP, out + 17, sizeof(out) - 17, out + 17); CKERR;
+    err = CHACHAPOLY_Final(CP, tag, sizeof(tag)); CKERR;
+    err = compareResults( PT, out, sizeof(out), kResultFormat_Byte, "ChaCha20-Poly1305 Decrypt"); CKERR;
+    CHACHAPOLY_Free(CP);
+    CP = kInvalidCHACHAPOLY_ContextRef;
+
+    /* a tag that does not match leaves nothing behind */
+    err = CHACHAPOLY_EncryptAEAD(kCipher_Algorithm_ChaCha20, key, nonce, sizeof(nonce), AAD, sizeof(AAD),
+                                 PT, sizeof(out), out, tag, sizeof(tag)); CKERR;
+    tag[15] ^= 1;
+    err = CHACHAPOLY_DecryptAEAD(kCipher_Algorithm_ChaCha20, key, nonce, sizeof(nonce), AAD, sizeof(AAD),
+                                 out, sizeof(out), out, tag, sizeof(tag));
+    if(err != kS4Err_BadIntegrity || out[0] != 0 || out[sizeof(out) - 1] != 0)
+    {
+        OPTESTLogError("\tChaCha20-Poly1305 accepted a bad tag\n");
+        RETERR(kS4Err_SelfTestFailed);
+    }
+    err = kS4Err_NoErr;
+
+done:
+    CHACHAPOLY_Free(CP);
+    return err;
+}
+
+/* a long stream, long enough for every SIMD width of ChaCha20 and Poly1305, with the
+ tag made elsewhere.  Uneven updates have to agree with the one shot calls, and the
+ original 8 byte nonce has to round trip */
+
+static S4Err RunChaChaPolyStream(const uint8_t *key, const uint8_t *expectedTag)
+{
+    S4Err   err = kS4Err_NoErr;
+    CHACHAPOLY_ContextRef  CP = kInvalidCHACHAPOLY_ContextRef;
+    const size_t    len = (1 << 20) + 1234;
+    uint8_t *in = NULL, *ref = NULL, *out = NULL;
+    uint8_t nonce[12], AAD[1000], tag[kCHACHAPOLY_TagSize], refTag[kCHACHAPOLY_TagSize];
+    size_t  i, n, offset;
+
+    in  = malloc(len);
+    ref = malloc(len);
+    out = malloc(len);
+    CKNULL(in); CKNULL(ref); CKNULL(out);
+
+    for(i = 0; i < len; i++) in[i] = (uint8_t)(i * 7 + (i >> 11));
+    for(i = 0; i < sizeof(AAD); i++) AAD[i] = (uint8_t)(i * 13);
+    for(i = 0; i < sizeof(nonce); i++) nonce[i] = (uint8_t)(0x20 + i);
+
+    err = CHACHAPOLY_EncryptAEAD(kCipher_Algorithm_ChaCha20, key, nonce, sizeof(nonce), AAD, sizeof(AAD),
+                                 in, len, ref, refTag, sizeof(refTag)); CKERR;
+    err = compareResults( expectedTag, refTag, sizeof(refTag), kResultFormat_Byte, "ChaCha20-Poly1305 stream tag"); CKERR;
+
+    /* uneven updates */
+    err = CHACHAPOLY_Init(kCipher_Algorithm_ChaCha20, key, nonce, sizeof(nonce), &CP); CKERR;
+    for(offset = 0, n = 1; offset < sizeof(AAD); offset += n, n = n * 2 + 7)
+    {
+        if(n > sizeof(AAD) - offset) n = sizeof(AAD) - offset;
+        err = CHACHAPOLY_AddAAD(CP, AAD + offset, n); CKERR;
+    }
+    for(offset = 0, n = 1; offset < len; offset += n, n = n * 3 + 5)
+    {
+        if(n > len - offset) n = len - offset;
+        err = CHACHAPOLY_Encrypt(CP, in + offset, n, out + offset); CKERR;
+    }
+    err = CHACHAPOLY_Final(CP, tag, sizeof(tag)); CKERR;
+    err = compareResults( ref, out, len, kResultFormat_Byte, "ChaCha20-Poly1305 split"); CKERR;
+    err = compareResults( refTag, tag, sizeof(tag), kResultFormat_Byte, "ChaCha20-Poly1305 split tag"); CKERR;
+
+    if(CHACHAPOLY_Decrypt(CP, out, 16, out) != kS4Err_BadParams)
+    {
+        OPTESTLogError("\tChaCha20-Poly1305 decrypted on an encrypting context\n");
+        RETERR(kS4Err_SelfTestFailed);
+    }
+    CHACHAPOLY_Free(CP);
+    CP = kInvalidCHACHAPOLY_ContextRef;
+
+    /* back in place */
+    err = CHACHAPOLY_Init(kCipher_Algorithm_ChaCha20, key, nonce, sizeof(nonce), &CP); CKERR;
+    err = CHACHAPOLY_AddAAD(CP, AAD, sizeof(AAD)); CKERR;
+    for(offset = 0, n = 5; offset < len; offset += n, n = n * 5 + 3)
+    {
+        if(n > len - offset) n = len - offset;
+        err = CHACHAPOLY_Decrypt(CP, out + offset, n, out + offset); CKERR;
+    }
+    err = CHACHAPOLY_Final(CP, refTag, sizeof(refTag)); CKERR;
+    err = compareResults( in, out, len, kResultFormat_Byte, "ChaCha20-Poly1305 split decrypt"); CKERR;
+    CHACHAPOLY_Free(CP);
+    CP = kInvalidCHACHAPOLY_ContextRef;
+
+    /* the 8 byte nonce */
+    err = CHACHAPOLY_EncryptAEAD(kCipher_Algorithm_ChaCha20, key, nonce, 8, AAD, sizeof(AAD),
+                                 in, len, out, tag, sizeof(tag)); CKERR;
+    err = CHACHAPOLY_DecryptAEAD(kCipher_Algorithm_ChaCha20, key, nonce, 8, AAD, sizeof(AAD),
+                                 out, len, out, tag, sizeof(tag)); CKERR;
+    err = compareResults( in, out, len, kResultFormat_Byte, "ChaCha20-Poly1305 8 byte nonce"); CKERR;
+
+done:
+    CHACHAPOLY_Free(CP);
+    if(in) free(in);
+    if(ref) free(ref);
+    if(out) free(out);
+    return err;
+}
+
+/* OCB3, the known answer is the iterative test of RFC 7253 appendix A: 128 messages of
+ growing length under nonces 1 to 384, with and without AAD, all encrypted again as AAD
+ under nonce 385.  It runs for every tag length, as the tag length goes into the nonce */
+
+static S4Err RunOCBKAT(Cipher_Algorithm algor, size_t keyLen, size_t tagLen, const uint8_t *expected)
+{
+    S4Err   err = kS4Err_NoErr;
+    const size_t    maxLen = 384 * 16 + 127 * 128;
+    uint8_t *C = NULL, *out = NULL;
+    uint8_t key[32], nonce[12], S[128], tag[16];
+    size_t  i, n;
+
+    C   = malloc(maxLen);
+    out = malloc(maxLen);
+    CKNULL(C); CKNULL(out);
+
+    ZERO(key, sizeof(key));
+    key[keyLen - 1] = (uint8_t)(tagLen * 8);
+    ZERO(nonce, sizeof(nonce));
+    ZERO(S, sizeof(S));
+
+    for(i = 0, n = 0; i < 128; i++)
+    {
+        nonce[10] = (uint8_t)((3 * i + 1) >> 8);  nonce[11] = (uint8_t)(3 * i + 1);
+        err = OCB_EncryptAEAD(algor, key, nonce, sizeof(nonce), S, i, S, i, C + n, C + n + i, tagLen); CKERR;
+        n += i + tagLen;
+
+        nonce[10] = (uint8_t)((3 * i + 2) >> 8);  nonce[11] = (uint8_t)(3 * i + 2);
+        err = OCB_EncryptAEAD(algor, key, nonce, sizeof(nonce), NULL, 0, S, i, C + n, C + n + i, tagLen); CKERR;
+        n += i + tagLen;
+
+        nonce[10] = (uint8_t)((3 * i + 3) >> 8);  nonce[11] = (uint8_t)(3 * i + 3);
+        err = OCB_EncryptAEAD(algor, key, nonce, sizeof(nonce), S, i, NULL, 0, NULL, C + n, tagLen); CKERR;
+        n += tagLen;
+    }
+
+    nonce[10] = 385 >> 8;  nonce[11] = 385 & 0xff;
+    err = OCB_EncryptAEAD(algor, key, nonce, sizeof(nonce), C, n, NULL, 0, NULL, tag, tagLen); CKERR;
+    err = compareResults( expected, tag, tagLen, kResultFormat_Byte, "OCB iterative tag"); CKERR;
+
+    /* the messages with text decrypt back to zeros */
+    for(i = 0, n = 0; i < 128; i++)
+    {
+        nonce[10] = (uint8_t)((3 * i + 1) >> 8);  nonce[11] = (uint8_t)(3 * i + 1);
+        err = OCB_DecryptAEAD(algor, key, nonce, sizeof(nonce), S, i, C + n, i, out, C + n + i, tagLen); CKERR;
+        err = compareResults( S, out, i, kResultFormat_Byte, "OCB iterative decrypt"); CKERR;
+        n += 2 * (i + tagLen) + tagLen;
+    }
+
+done:
+    if(C) free(C);
+    if(out) free(out);
+    return err;
+}
+
+/* a long stream with the tag made elsewhere.  Updates of uneven multiples of the block
+ size have to agree with the one shot calls, and a bad tag leaves nothing behind */
+
+static S4Err RunOCBStream(Cipher_Algorithm algor, const uint8_t *key, const uint8_t *expectedTag)
+{
+    S4Err   err = kS4Err_NoErr;
+    OCB_ContextRef  OCB = kInvalidOCB_ContextRef;
+    const size_t    len = (1 << 20) + 1234;
+    uint8_t *in = NULL, *ref = NULL, *out = NULL;
+    uint8_t nonce[12], AAD[1000], tag[16], refTag[16];
+    size_t  i, n, offset;
+
+    in  = malloc(len);
+    ref = malloc(len);
+    out = malloc(len);
+    CKNULL(in); CKNULL(ref); CKNULL(out);
+
+    for(i = 0; i < len; i++) in[i] = (uint8_t)(i * 7 + (i >> 11));
+    for(i = 0; i < sizeof(AAD); i++) AAD[i] = (uint8_t)(i * 13);
+    for(i = 0; i < sizeof(nonce); i++) nonce[i] = (uint8_t)(0x20 + i);
+
+    err = OCB_EncryptAEAD(algor, key, nonce, sizeof(nonce), AAD, sizeof(AAD),
+                          in, len, ref, refTag, sizeof(refTag)); CKERR;
+    if(expectedTag)
+    {
+        err = compareResults( expectedTag, refTag, sizeof(refTag), kResultFormat_Byte, "OCB stream tag"); CKERR;
+    }
+
+    /* uneven updates, the text in whole blocks until the last */
+    err = OCB_Init(algor, key, nonce, sizeof(nonce), sizeof(tag), &OCB); CKERR;
+    for(offset = 0, n = 1; offset < sizeof(AAD); offset += n, n = n * 2 + 7)
+    {
+        if(n > sizeof(AAD) - offset) n = sizeof(AAD) - offset;
+        err = OCB_AddAAD(OCB, AAD + offset, n); CKERR;
+    }
+    for(offset = 0, n = 16; offset < len; offset += n, n = (n * 3 + 32) & ~15)
+    {
+        if(n > len - offset) n = len - offset;
+        err = OCB_Encrypt(OCB, in + offset, n, out + offset); CKERR;
+    }
+    err = OCB_Final(OCB, tag, sizeof(tag)); CKERR;
+    err = compareResults( ref, out, len, kResultFormat_Byte, "OCB split"); CKERR;
+    err = compareResults( refTag, tag, sizeof(tag), kResultFormat_Byte, "OCB split tag"); CKERR;
+
+    if(OCB_Decrypt(OCB, out, 16, out) != kS4Err_BadParams)
+    {
+        OPTESTLogError("\tOCB decrypted on an encrypting context\n");
+        RETERR(kS4Err_SelfTestFailed);
+    }
+    OCB_Free(OCB);
+    OCB = kInvalidOCB_ContextRef;
+
+    /* back in place */
+    err = OCB_Init(algor, key, nonce, sizeof(nonce), sizeof(tag), &OCB); CKERR;
+    err = OCB_AddAAD(OCB, AAD, sizeof(AAD)); CKERR;
+    for(offset = 0, n = 48; offset < len; offset += n, n = (n * 5 + 16) & ~15)
+    {
+        if(n > len - offset) n = len - offset;
+        err = OCB_Decrypt(OCB, out + offset, n, out + offset); CKERR;
+    }
+    err = OCB_Final(OCB, refTag, sizeof(refTag)); CKERR;
+    err = compareResults( in, out, len, kResultFormat_Byte, "OCB split decrypt"); CKERR;
+    OCB_Free(OCB);
+    OCB = kInvalidOCB_ContextRef;
+
+    /* a tag that does not match leaves nothing behind */
+    refTag[0] ^= 1;
+    err = OCB_DecryptAEAD(algor, key, nonce, sizeof(nonce), AAD, sizeof(AAD),
+                          ref, len, out, refTag, sizeof(refTag));
+    if(err != kS4Err_BadIntegrity || out[0] != 0 || out[len - 1] != 0)
+    {
+        OPTESTLogError("\tOCB accepted a bad tag\n");
+        RETERR(kS4Err_SelfTestFailed);
+    }
+    err = kS4Err_NoErr;
+
+done:
+    OCB_Free(OCB);
+    if(in) free(in);
+    if(ref) free(ref);
+    if(out) free(out);
+    return err;
+}
+
+/* IEEE 1619 vectors through the sector call, the tweak is the sector number */
+
+static S4Err RunXTSKAT(const uint8_t *key, uint64_t sector,
+                       const uint8_t *PT, size_t len, const uint8_t *CT)
+{
+    S4Err   err = kS4Err_NoErr;
+    XTS_ContextRef  XTS = kInvalidXTS_ContextRef;
+    uint8_t out[64];
+    XTS_Sector  s = { sector, PT, out };
+
+    err = XTS_Init(kCipher_Algorithm_AES128, key, len, 1, &XTS); CKERR;
+    err = XTS_EncryptSectors(XTS, &s, 1); CKERR;
+    err = compareResults( CT, out, len, kResultFormat_Byte, "XTS Encrypt"); CKERR;
+
+    s.in = out;
+    err = XTS_DecryptSectors(XTS, &s, 1); CKERR;
+    err = compareResults( PT, out, len, kResultFormat_Byte, "XTS Decrypt"); CKERR;
+
+done:
+    XTS_Free(XTS);
+    return err;
+}
+
+/* scattered sectors in one call have to agree with one call per sector, threaded or not,
+ and come back in place.  Sector sizes that are not whole blocks use ciphertext stealing */
+
+static S4Err RunXTSSectors(Cipher_Algorithm algor, const uint8_t *key, size_t keyLen, size_t sectorSize)
+{
+    S4Err   err = kS4Err_NoErr;
+    XTS_ContextRef  XTS = kInvalidXTS_ContextRef;
+    XTS_ContextRef  XTS1 = kInvalidXTS_ContextRef;
+    const size_t    count = ((4 << 20) / sectorSize) | 1;
+    uint8_t *in = NULL, *ref = NULL, *out = NULL;
+    XTS_Sector  *sectors = NULL;
+    uint8_t keys[64];
+    size_t  i;
+
+    in  = malloc(count * sectorSize);
+    ref = malloc(count * sectorSize);
+    out = malloc(count * sectorSize);
+    sectors = malloc(count * sizeof(XTS_Sector));
+    CKNULL(in); CKNULL(ref); CKNULL(out); CKNULL(sectors);
+
+    for(i = 0; i < count * sectorSize; i++) in[i] = (uint8_t)(i * 11 + (i >> 9));
+    for(i = 0; i < keyLen; i++) keys[i] = key[i];
+    for(i = 0; i < keyLen; i++) keys[keyLen + i] = key[i] ^ 0x5c;
+
+    err = XTS_Init(algor, keys, sectorSize, 1, &XTS1); CKERR;
+    err = XTS_Init(algor, keys, sectorSize, 4, &XTS); CKERR;
+
+    /* the reference, one sector at a time */
+    for(i = 0; i < count; i++)
+    {
+        XTS_Sector s = { (uint64_t)i * 0x9e3779b97f4a7c15ULL, in + i * sectorSize, ref + i * sectorSize };
+        err = XTS_EncryptSectors(XTS1, &s, 1); CKERR;
+    }
+
+    /* all of them at once, split across threads, out of order */
+    for(i = 0; i < count; i++)
+    {
+        size_t j = (i * 7) % count;
+        sectors[i].sector = (uint64_t)j * 0x9e3779b97f4a7c15ULL;
+        sectors[i].in     = in + j * sectorSize;
+        sectors[i].out    = out + j * sectorSize;
+    }
+    err = XTS_EncryptSectors(XTS, sectors, count); CKERR;
+    err = compareResults( ref, out, count * sectorSize, kResultFormat_Byte, "XTS sectors"); CKERR;
+
+    /* back in place */
+    for(i = 0; i < count; i++)
+        sectors[i].in = sectors[i].out;
+    err = XTS_DecryptSectors(XTS, sectors, count); CKERR;
+    err = compareResults( in, out, count * sectorSize, kResultFormat_Byte, "XTS sectors decrypt"); CKERR;
+
+    /* the two halves of the key have to differ */
+    for(i = 0; i < keyLen; i++) keys[keyLen + i] = key[i];
+    XTS_Free(XTS);
+    XTS = kInvalidXTS_ContextRef;
+    if(XTS_Init(algor, keys, sectorSize, 1, &XTS) != kS4Err_BadParams)
+    {
+        OPTESTLogError("\tXTS accepted two equal keys\n");
+        RETERR(kS4Err_SelfTestFailed);
+    }
+
+done:
+    XTS_Free(XTS);
+    XTS_Free(XTS1);
+    if(in) free(in);
+    if(ref) free(ref);
+    if(out) free(out);
+    if(sectors) free(sectors);
+    return err;
+}
 
 S4Err TestCiphers()
 {
     S4Err err = kS4Err_NoErr;
     
-    unsigned int		i;
+    unsigned int		i, k;
+    
+    /* each AES backend runs the KATs and the modes, they share one key schedule */
+    OPTESTKernel    aesKernels[] = {
+        { "aesni",      kS4CPU_All,                         kS4CPU_AES | kS4CPU_SSSE3 },
+        { "vpaes",      ~kS4CPU_AES,                        kS4CPU_SSSE3 },
+        { "c",          ~(kS4CPU_AES | kS4CPU_SSSE3),       0 },
+    };
+    
+    /* chacha / poly1305, every ChaCha kernel and both portable Poly1305 radixes */
+    OPTESTKernel    chachaPolyKernels[] = {
+        { "avx512/avx2",    kS4CPU_All,                                                 kS4CPU_AVX512F | kS4CPU_AVX2 },
+        { "avx512/c",       ~kS4CPU_AVX2,                                               kS4CPU_AVX512F | kS4CPU_MUL128 },
+        { "avx512/c26",     ~(kS4CPU_AVX2 | kS4CPU_MUL128),                             kS4CPU_AVX512F },
+        { "avx2/avx2",      ~kS4CPU_AVX512F,                                            kS4CPU_AVX2 },
+        { "sse2/c",         ~(kS4CPU_AVX512F | kS4CPU_AVX2),                            kS4CPU_SSE2 | kS4CPU_MUL128 },
+        { "sse2/c26",       ~(kS4CPU_AVX512F | kS4CPU_AVX2 | kS4CPU_MUL128),            kS4CPU_SSE2 },
+        { "c/c",            ~(kS4CPU_AVX512F | kS4CPU_AVX2 | kS4CPU_SSE2),              kS4CPU_MUL128 },
+        { "c/c26",          ~(kS4CPU_AVX512F | kS4CPU_AVX2 | kS4CPU_SSE2 | kS4CPU_MUL128), 0 },
+    };
     
     uint8_t P1[512];
+    uint8_t TF_K[128];
     
     /* Test vectors for ECB known answer test */
     /* AES 128 bit key */
@@ -257,6 +1116,163 @@ S4Err TestCiphers()
         0xF6, 0x05, 0xA4, 0x45, 0xE3, 0xB1, 0x5C, 0xBF, 0x8F, 0x72, 0x7F, 0xFC, 0x28, 0x05, 0xE9, 0xE3
     };
 
+    /* CTR known answers, SP 800-38A */
+    uint8_t CTR_K1[] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+
+    uint8_t CTR_C1[] = {
+        0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+        0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+        0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+        0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+    };
+
+    uint8_t CTR_K3[] = {
+        0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+        0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4
+    };
+
+    uint8_t CTR_C3[] = {
+        0x60, 0x1e, 0xc3, 0x13, 0x77, 0x57, 0x89, 0xa5, 0xb7, 0xa7, 0xf5, 0x04, 0xbb, 0xf3, 0xd2, 0x28,
+        0xf4, 0x43, 0xe3, 0xca, 0x4d, 0x62, 0xb5, 0x9a, 0xca, 0x84, 0xe9, 0x90, 0xca, 0xca, 0xf5, 0xc5,
+        0x2b, 0x09, 0x30, 0xda, 0xa2, 0x3d, 0xe9, 0x4c, 0xe8, 0x70, 0x17, 0xba, 0x2d, 0x84, 0x98, 0x8d,
+        0xdf, 0xc9, 0xc5, 0x8d, 0xb6, 0x7a, 0xad, 0xa6, 0x13, 0xc2, 0xdd, 0x08, 0x45, 0x79, 0x41, 0xa6
+    };
+
+    /* GCM test cases 4, 6 and 16 */
+    uint8_t GCM_K4[] = {
+        0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08
+    };
+
+    uint8_t GCM_K16[] = {
+        0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+        0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08
+    };
+
+    uint8_t GCM_IV4[] = {
+        0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88
+    };
+
+    uint8_t GCM_IV6[] = {
+        0x93, 0x13, 0x22, 0x5d, 0xf8, 0x84, 0x06, 0xe5, 0x55, 0x90, 0x9c, 0x5a, 0xff, 0x52, 0x69, 0xaa,
+        0x6a, 0x7a, 0x95, 0x38, 0x53, 0x4f, 0x7d, 0xa1, 0xe4, 0xc3, 0x03, 0xd2, 0xa3, 0x18, 0xa7, 0x28,
+        0xc3, 0xc0, 0xc9, 0x51, 0x56, 0x80, 0x95, 0x39, 0xfc, 0xf0, 0xe2, 0x42, 0x9a, 0x6b, 0x52, 0x54,
+        0x16, 0xae, 0xdb, 0xf5, 0xa0, 0xde, 0x6a, 0x57, 0xa6, 0x37, 0xb3, 0x9b
+    };
+
+    uint8_t GCM_C4[] = {
+        0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24, 0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+        0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0, 0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e,
+        0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c, 0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+        0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97, 0x3d, 0x58, 0xe0, 0x91
+    };
+
+    uint8_t GCM_T4[] = {
+        0x5b, 0xc9, 0x4f, 0xbc, 0x32, 0x21, 0xa5, 0xdb, 0x94, 0xfa, 0xe9, 0x5a, 0xe7, 0x12, 0x1a, 0x47
+    };
+
+    uint8_t GCM_C6[] = {
+        0x8c, 0xe2, 0x49, 0x98, 0x62, 0x56, 0x15, 0xb6, 0x03, 0xa0, 0x33, 0xac, 0xa1, 0x3f, 0xb8, 0x94,
+        0xbe, 0x91, 0x12, 0xa5, 0xc3, 0xa2, 0x11, 0xa8, 0xba, 0x26, 0x2a, 0x3c, 0xca, 0x7e, 0x2c, 0xa7,
+        0x01, 0xe4, 0xa9, 0xa4, 0xfb, 0xa4, 0x3c, 0x90, 0xcc, 0xdc, 0xb2, 0x81, 0xd4, 0x8c, 0x7c, 0x6f,
+        0xd6, 0x28, 0x75, 0xd2, 0xac, 0xa4, 0x17, 0x03, 0x4c, 0x34, 0xae, 0xe5
+    };
+
+    uint8_t GCM_T6[] = {
+        0x61, 0x9c, 0xc5, 0xae, 0xff, 0xfe, 0x0b, 0xfa, 0x46, 0x2a, 0xf4, 0x3c, 0x16, 0x99, 0xd0, 0x50
+    };
+
+    uint8_t GCM_C16[] = {
+        0x52, 0x2d, 0xc1, 0xf0, 0x99, 0x56, 0x7d, 0x07, 0xf4, 0x7f, 0x37, 0xa3, 0x2a, 0x84, 0x42, 0x7d,
+        0x64, 0x3a, 0x8c, 0xdc, 0xbf, 0xe5, 0xc0, 0xc9, 0x75, 0x98, 0xa2, 0xbd, 0x25, 0x55, 0xd1, 0xaa,
+        0x8c, 0xb0, 0x8e, 0x48, 0x59, 0x0d, 0xbb, 0x3d, 0xa7, 0xb0, 0x8b, 0x10, 0x56, 0x82, 0x88, 0x38,
+        0xc5, 0xf6, 0x1e, 0x63, 0x93, 0xba, 0x7a, 0x0a, 0xbc, 0xc9, 0xf6, 0x62
+    };
+
+    uint8_t GCM_T16[] = {
+        0x76, 0xfc, 0x6e, 0xce, 0x0f, 0x4e, 0x17, 0x68, 0xcd, 0xdf, 0x88, 0x53, 0xbb, 0x2d, 0x55, 0x1b
+    };
+
+    /* the tags of RunGCMStream */
+    uint8_t GCM_TS1[] = {
+        0x26, 0xbd, 0x6d, 0x0e, 0x33, 0x0f, 0x24, 0xba, 0x2b, 0xcc, 0x88, 0x5c, 0x11, 0x1e, 0x62, 0xfc
+    };
+
+    uint8_t GCM_TS3[] = {
+        0xa7, 0x7c, 0xba, 0x02, 0x64, 0x27, 0x7d, 0x93, 0x26, 0x9d, 0xf0, 0xd0, 0x5a, 0x9e, 0xb2, 0xa2
+    };
+
+    /* RFC 7253 appendix A, the iterative test for 128, 96 and 64 bit tags */
+    uint8_t OCB_A128[] = {
+        0x67, 0xe9, 0x44, 0xd2, 0x32, 0x56, 0xc5, 0xe0, 0xb6, 0xc6, 0x1f, 0xa2, 0x2f, 0xdf, 0x1e, 0xa2
+    };
+    uint8_t OCB_A128_96[] = {
+        0x77, 0xa3, 0xd8, 0xe7, 0x35, 0x89, 0x15, 0x8d, 0x25, 0xd0, 0x12, 0x09
+    };
+    uint8_t OCB_A128_64[] = {
+        0x19, 0x2c, 0x9b, 0x7b, 0xd9, 0x0b, 0xa0, 0x6a
+    };
+    uint8_t OCB_A192[] = {
+        0xf6, 0x73, 0xf2, 0xc3, 0xe7, 0x17, 0x4a, 0xae, 0x7b, 0xae, 0x98, 0x6c, 0xa9, 0xf2, 0x9e, 0x17
+    };
+    uint8_t OCB_A192_96[] = {
+        0x05, 0xd5, 0x6e, 0xad, 0x27, 0x52, 0xc8, 0x6b, 0xe6, 0x93, 0x2c, 0x5e
+    };
+    uint8_t OCB_A192_64[] = {
+        0x00, 0x66, 0xbc, 0x6e, 0x0e, 0xf3, 0x4e, 0x24
+    };
+    uint8_t OCB_A256[] = {
+        0xd9, 0x0e, 0xb8, 0xe9, 0xc9, 0x77, 0xc8, 0x8b, 0x79, 0xdd, 0x79, 0x3d, 0x7f, 0xfa, 0x16, 0x1c
+    };
+    uint8_t OCB_A256_96[] = {
+        0x54, 0x58, 0x35, 0x9a, 0xc2, 0x3b, 0x0c, 0xba, 0x9e, 0x63, 0x30, 0xdd
+    };
+    uint8_t OCB_A256_64[] = {
+        0x7d, 0x4e, 0xa5, 0xd4, 0x45, 0x50, 0x1c, 0xbe
+    };
+
+    /* the tags of RunOCBStream */
+    uint8_t OCB_TS1[] = {
+        0x94, 0x78, 0x0a, 0x40, 0x44, 0x9f, 0xef, 0x72, 0xfc, 0x15, 0x52, 0xe2, 0x95, 0x1c, 0xac, 0x6d
+    };
+
+    uint8_t OCB_TS3[] = {
+        0xba, 0x6c, 0xdc, 0x60, 0xfd, 0xee, 0x22, 0x55, 0x4d, 0x3e, 0xb0, 0xd4, 0x7f, 0xd0, 0x7f, 0xb8
+    };
+
+    /* the tag of RunChaChaPolyStream */
+    uint8_t CHACHAPOLY_TS[] = {
+        0x91, 0xb3, 0x64, 0x3e, 0x34, 0x59, 0x03, 0x4a, 0x15, 0x23, 0x31, 0x8a, 0x32, 0x6a, 0x52, 0xc0
+    };
+
+    /* IEEE 1619 XTS-AES-128 vectors 2 and 15, the data key then the tweak key */
+    uint8_t XTS_K2[] = {
+        0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22
+    };
+    uint8_t XTS_P2[] = {
+        0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44,
+        0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44
+    };
+    uint8_t XTS_C2[] = {
+        0xc4, 0x54, 0x18, 0x5e, 0x6a, 0x16, 0x93, 0x6e, 0x39, 0x33, 0x40, 0x38, 0xac, 0xef, 0x83, 0x8b,
+        0xfb, 0x18, 0x6f, 0xff, 0x74, 0x80, 0xad, 0xc4, 0x28, 0x93, 0x82, 0xec, 0xd6, 0xd3, 0x94, 0xf0
+    };
+
+    uint8_t XTS_K15[] = {
+        0xff, 0xfe, 0xfd, 0xfc, 0xfb, 0xfa, 0xf9, 0xf8, 0xf7, 0xf6, 0xf5, 0xf4, 0xf3, 0xf2, 0xf1, 0xf0,
+        0xbf, 0xbe, 0xbd, 0xbc, 0xbb, 0xba, 0xb9, 0xb8, 0xb7, 0xb6, 0xb5, 0xb4, 0xb3, 0xb2, 0xb1, 0xb0
+    };
+    uint8_t XTS_P15[] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+        0x10
+    };
+    uint8_t XTS_C15[] = {
+        0x6c, 0x16, 0x25, 0xdb, 0x46, 0x71, 0x52, 0x2d, 0x3d, 0x75, 0x99, 0x60, 0x1d, 0xe7, 0xca, 0x09,
+        0xed
+    };
+
     OPTESTLogInfo("\nTesting Ciphers\n");
     
     
@@ -273,15 +1289,130 @@ S4Err TestCiphers()
     /* init the P1 */
     for (i = 0; i < sizeof(P1) ; i++) P1[i] = i;
     
-    /* run  known answer tests (KAT) */
+    for(k = 0; k < sizeof(aesKernels) / sizeof(OPTESTKernel); k++)
+    {
+        if(!OPTESTUseKernel(&aesKernels[k]))
+            continue;
+        
+        OPTESTLogInfo("\tAES %s\n", aesKernels[k].name);
+        
+        /* run  known answer tests (KAT) */
+        for (i = 0; i < sizeof(kat_vector_array)/ sizeof(katvector) ; i++)
+        {
+            if(kat_vector_array[i].algor == kCipher_Algorithm_2FISH256)
+                continue;
+            
+            err = RunCipherKAT( &kat_vector_array[i] ); CKERR;
+        }
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES128), "CBC multi");
+        err = RunCBCMulti(kCipher_Algorithm_AES128, K1, 16); CKERR;
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES256), "CBC multi");
+        err = RunCBCMulti(kCipher_Algorithm_AES256, K3, 32); CKERR;
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES128), "CTR");
+        err = RunCTRKAT(kCipher_Algorithm_AES128, CTR_K1, CTR_C1); CKERR;
+        err = RunCTRStream(kCipher_Algorithm_AES128, K1); CKERR;
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES256), "CTR");
+        err = RunCTRKAT(kCipher_Algorithm_AES256, CTR_K3, CTR_C3); CKERR;
+        err = RunCTRStream(kCipher_Algorithm_AES256, K3); CKERR;
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES128), "GCM");
+        err = RunGCMKAT(kCipher_Algorithm_AES128, GCM_K4, GCM_IV4, sizeof(GCM_IV4), GCM_C4, GCM_T4); CKERR;
+        err = RunGCMKAT(kCipher_Algorithm_AES128, GCM_K4, GCM_IV6, sizeof(GCM_IV6), GCM_C6, GCM_T6); CKERR;
+        err = RunGCMStream(kCipher_Algorithm_AES128, K1, GCM_TS1); CKERR;
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES256), "GCM");
+        err = RunGCMKAT(kCipher_Algorithm_AES256, GCM_K16, GCM_IV4, sizeof(GCM_IV4), GCM_C16, GCM_T16); CKERR;
+        err = RunGCMStream(kCipher_Algorithm_AES256, K3, GCM_TS3); CKERR;
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES128), "OCB");
+        err = RunOCBKAT(kCipher_Algorithm_AES128, 16, sizeof(OCB_A128), OCB_A128); CKERR;
+        err = RunOCBKAT(kCipher_Algorithm_AES128, 16, sizeof(OCB_A128_96), OCB_A128_96); CKERR;
+        err = RunOCBKAT(kCipher_Algorithm_AES128, 16, sizeof(OCB_A128_64), OCB_A128_64); CKERR;
+        err = RunOCBStream(kCipher_Algorithm_AES128, K1, OCB_TS1); CKERR;
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES192), "OCB");
+        err = RunOCBKAT(kCipher_Algorithm_AES192, 24, sizeof(OCB_A192), OCB_A192); CKERR;
+        err = RunOCBKAT(kCipher_Algorithm_AES192, 24, sizeof(OCB_A192_96), OCB_A192_96); CKERR;
+        err = RunOCBKAT(kCipher_Algorithm_AES192, 24, sizeof(OCB_A192_64), OCB_A192_64); CKERR;
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES256), "OCB");
+        err = RunOCBKAT(kCipher_Algorithm_AES256, 32, sizeof(OCB_A256), OCB_A256); CKERR;
+        err = RunOCBKAT(kCipher_Algorithm_AES256, 32, sizeof(OCB_A256_96), OCB_A256_96); CKERR;
+        err = RunOCBKAT(kCipher_Algorithm_AES256, 32, sizeof(OCB_A256_64), OCB_A256_64); CKERR;
+        err = RunOCBStream(kCipher_Algorithm_AES256, K3, OCB_TS3); CKERR;
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES128), "XTS");
+        err = RunXTSKAT(XTS_K2, 0x3333333333ULL, XTS_P2, sizeof(XTS_P2), XTS_C2); CKERR;
+        err = RunXTSKAT(XTS_K15, 0x123456789aULL, XTS_P15, sizeof(XTS_P15), XTS_C15); CKERR;
+        err = RunXTSSectors(kCipher_Algorithm_AES128, K1, 16, 4096); CKERR;
+        err = RunXTSSectors(kCipher_Algorithm_AES128, K1, 16, 520); CKERR;
+        
+        OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_AES256), "XTS");
+        err = RunXTSSectors(kCipher_Algorithm_AES256, K3, 32, 4096); CKERR;
+    }
+    
+    OPTESTResetKernel();
+    
+    OPTESTLogInfo("\t%-12s %s\n", "AES", "key across backends");
+    err = RunAESAcrossBackends(kCipher_Algorithm_AES128, K1, aesKernels, sizeof(aesKernels) / sizeof(OPTESTKernel)); CKERR;
+    err = RunAESAcrossBackends(kCipher_Algorithm_AES192, K2, aesKernels, sizeof(aesKernels) / sizeof(OPTESTKernel)); CKERR;
+    err = RunAESAcrossBackends(kCipher_Algorithm_AES256, K3, aesKernels, sizeof(aesKernels) / sizeof(OPTESTKernel)); CKERR;
+    
     for (i = 0; i < sizeof(kat_vector_array)/ sizeof(katvector) ; i++)
     {
-        err = RunCipherKAT( &kat_vector_array[i] ); CKERR;
+        if(kat_vector_array[i].algor == kCipher_Algorithm_2FISH256)
+        {
+            err = RunCipherKAT( &kat_vector_array[i] ); CKERR;
+        }
+    }
+    
+    OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_2FISH256), "CBC multi");
+    err = RunCBCMulti(kCipher_Algorithm_2FISH256, K3, 32); CKERR;
+
+    OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_2FISH256), "CTR");
+    err = RunCTRStream(kCipher_Algorithm_2FISH256, K3); CKERR;
+
+    for(i = 0; i < sizeof(TF_K); i++) TF_K[i] = (uint8_t)(i * 37 + 11);
+
+    OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_3FISH256), "CTR");
+    err = RunCTRStream(kCipher_Algorithm_3FISH256, TF_K); CKERR;
+
+    OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_3FISH512), "CTR");
+    err = RunCTRStream(kCipher_Algorithm_3FISH512, TF_K); CKERR;
+
+    OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_3FISH1024), "CTR");
+    err = RunCTRStream(kCipher_Algorithm_3FISH1024, TF_K); CKERR;
+
+    OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_2FISH256), "GCM");
+    err = RunGCMStream(kCipher_Algorithm_2FISH256, K3, NULL); CKERR;
+
+    for(k = 0; k < sizeof(chachaPolyKernels) / sizeof(OPTESTKernel); k++)
+    {
+        if(!OPTESTUseKernel(&chachaPolyKernels[k]))
+            continue;
         
+        OPTESTLogInfo("\t%-12s %4s %s\n", cipher_algor_table(kCipher_Algorithm_ChaCha20), "Poly1305", chachaPolyKernels[k].name);
+        err = RunChaChaPolyKAT(); CKERR;
+        err = RunChaChaPolyStream(K3, CHACHAPOLY_TS); CKERR;
     }
     
+    OPTESTResetKernel();
+
+    OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_2FISH256), "OCB");
+    err = RunOCBStream(kCipher_Algorithm_2FISH256, K3, NULL); CKERR;
+
+    OPTESTLogInfo("\t%-12s %4s\n", cipher_algor_table(kCipher_Algorithm_2FISH256), "XTS");
+    err = RunXTSSectors(kCipher_Algorithm_2FISH256, K3, 32, 4096); CKERR;
+    
     OPTESTLogInfo("\n");
     
 done:
+    
+    OPTESTResetKernel();
+    
     return err;
 }
@@ -11,6 +11,10 @@
 #include "s4.h"
 #include "optest.h"
 
+#ifdef OPTEST_CPU_HOOKS
+#include <tomcrypt.h>
+#endif
+
 
 
 static S4Err sTestECC(int keySize)
@@ -259,6 +263,216 @@ done:
 }
 
 
+/* a signature and shared secret made outside S4 */
+static S4Err sTestECC_KAT(int keySize,
+                          const uint8_t *priv1, size_t priv1Len,
+                          const uint8_t *pub1,  size_t pub1Len,
+                          const uint8_t *pub2,  size_t pub2Len,
+                          const uint8_t *Z,     size_t ZLen,
+                          const uint8_t *hash,  size_t hashLen,
+                          const uint8_t *sig,   size_t sigLen)
+{
+    S4Err           err = kS4Err_NoErr;
+    ECC_ContextRef  eccPriv = kInvalidECC_ContextRef;
+    ECC_ContextRef  eccPub  = kInvalidECC_ContextRef;
+    ECC_ContextRef  eccPeer = kInvalidECC_ContextRef;
+    uint8_t         h[64];
+    uint8_t         Z1[256];
+    size_t          Zlen1 = 0;
+
+    OPTESTLogInfo("\tTesting ECC-%d KAT\n", keySize);
+
+    COPY(hash, h, hashLen);
+
+    err = ECC_Init(&eccPub); CKERR;
+    err = ECC_Import_ANSI_X963(eccPub, (void *)pub1, pub1Len); CKERR;
+    err = ECC_Verify(eccPub, (void *)sig, sigLen, h, hashLen); CKERR;
+
+    h[0] ^= 1;
+    err = ECC_Verify(eccPub, (void *)sig, sigLen, h, hashLen);
+    if(err != kS4Err_BadIntegrity)
+    {
+        OPTESTLogInfo("\tECC-%d KAT verify of a changed hash did not fail\n", keySize);
+        err = kS4Err_SelfTestFailed;
+        goto done;
+    }
+
+    err = ECC_Init(&eccPriv); CKERR;
+    err = ECC_Import(eccPriv, (void *)priv1, priv1Len); CKERR;
+    err = ECC_Init(&eccPeer); CKERR;
+    err = ECC_Import_ANSI_X963(eccPeer, (void *)pub2, pub2Len); CKERR;
+    err = ECC_SharedSecret(eccPriv, eccPeer, Z1, sizeof(Z1), &Zlen1); CKERR;
+    err = compare2Results(Z, ZLen, Z1, Zlen1, kResultFormat_Byte, "ECC KAT shared secret"); CKERR;
+
+done:
+
+    if(ECC_ContextRefIsValid(eccPriv)) ECC_Free(eccPriv);
+    if(ECC_ContextRefIsValid(eccPub)) ECC_Free(eccPub);
+    if(ECC_ContextRefIsValid(eccPeer)) ECC_Free(eccPeer);
+
+    return err;
+}
+
+static S4Err sTestECC_P384KAT()
+{
+    uint8_t priv1[] = {
+        0x30, 0x81, 0x9e, 0x03, 0x02, 0x07, 0x80, 0x02, 0x01, 0x30, 0x02, 0x30, 0x45, 0xe8, 0x7f, 0x97,
+        0x72, 0xbf, 0x71, 0xe8, 0x03, 0x98, 0xbd, 0xc3, 0x35, 0x63, 0x19, 0xa5, 0xef, 0xcd, 0x6f, 0xfe,
+        0x33, 0xb5, 0xbe, 0x0f, 0xeb, 0x8e, 0x68, 0x6e, 0x63, 0xf9, 0x5d, 0x4c, 0x74, 0xb1, 0x88, 0x93,
+        0x99, 0xf0, 0x22, 0xc9, 0xd4, 0xae, 0x29, 0x64, 0x58, 0x21, 0x10, 0x69, 0x02, 0x31, 0x00, 0xb9,
+        0xe6, 0x40, 0x5d, 0x8f, 0x60, 0xd8, 0x5a, 0x20, 0xe6, 0x91, 0x80, 0x65, 0x6f, 0x2c, 0x62, 0xb8,
+        0x6d, 0x9d, 0x04, 0x3b, 0x6f, 0xef, 0x02, 0xca, 0xe7, 0x09, 0xd0, 0x5f, 0x06, 0x1b, 0xef, 0xed,
+        0xf4, 0x54, 0xc5, 0x7b, 0xd6, 0x3f, 0xf8, 0xc9, 0xf3, 0x25, 0xb8, 0xce, 0x7a, 0x25, 0x6c, 0x02,
+        0x30, 0x69, 0xb2, 0x95, 0xf6, 0x6d, 0xf6, 0x3c, 0xf7, 0x05, 0x64, 0xe9, 0xeb, 0x1a, 0xe2, 0xcd,
+        0xdf, 0xc1, 0x03, 0xb7, 0x1f, 0x7e, 0xd1, 0x58, 0x59, 0xdf, 0x80, 0xdf, 0x23, 0x87, 0x2c, 0x5e,
+        0xb4, 0xdb, 0xc5, 0x4c, 0xa1, 0x98, 0xb1, 0xba, 0xde, 0x8e, 0xd4, 0x5a, 0xbc, 0xdd, 0x8e, 0x03,
+        0x23
+    };
+    uint8_t pub1[] = {
+        0x04, 0x45, 0xe8, 0x7f, 0x97, 0x72, 0xbf, 0x71, 0xe8, 0x03, 0x98, 0xbd, 0xc3, 0x35, 0x63, 0x19,
+        0xa5, 0xef, 0xcd, 0x6f, 0xfe, 0x33, 0xb5, 0xbe, 0x0f, 0xeb, 0x8e, 0x68, 0x6e, 0x63, 0xf9, 0x5d,
+        0x4c, 0x74, 0xb1, 0x88, 0x93, 0x99, 0xf0, 0x22, 0xc9, 0xd4, 0xae, 0x29, 0x64, 0x58, 0x21, 0x10,
+        0x69, 0xb9, 0xe6, 0x40, 0x5d, 0x8f, 0x60, 0xd8, 0x5a, 0x20, 0xe6, 0x91, 0x80, 0x65, 0x6f, 0x2c,
+        0x62, 0xb8, 0x6d, 0x9d, 0x04, 0x3b, 0x6f, 0xef, 0x02, 0xca, 0xe7, 0x09, 0xd0, 0x5f, 0x06, 0x1b,
+        0xef, 0xed, 0xf4, 0x54, 0xc5, 0x7b, 0xd6, 0x3f, 0xf8, 0xc9, 0xf3, 0x25, 0xb8, 0xce, 0x7a, 0x25,
+        0x6c
+    };
+    uint8_t pub2[] = {
+        0x04, 0xee, 0xc5, 0xbb, 0x95, 0x6e, 0x11, 0x57, 0x6a, 0x75, 0x93, 0x59, 0x5e, 0x27, 0x05, 0x18,
+        0xb9, 0x80, 0xe6, 0x2c, 0xdf, 0xd0, 0x1c, 0xa0, 0x5a, 0x40, 0xe6, 0xbc, 0x55, 0xe7, 0x62, 0x64,
+        0x26, 0xa1, 0x48, 0x41, 0x4d, 0x2f, 0x41, 0x02, 0x78, 0x90, 0xbe, 0xce, 0x5e, 0x91, 0xcc, 0x61,
+        0x2f, 0xf1, 0x8b, 0x79, 0xca, 0xdd, 0x58, 0x2e, 0x3d, 0xf5, 0x92, 0xed, 0x89, 0x4c, 0x80, 0xd0,
+        0xf0, 0xa1, 0x2e, 0x34, 0xf1, 0xcd, 0xe0, 0x47, 0x3d, 0x68, 0xd7, 0x1c, 0xb4, 0x3e, 0xd4, 0x05,
+        0xe0, 0x6e, 0x37, 0x35, 0xb7, 0x31, 0xa0, 0x36, 0x41, 0xc2, 0x67, 0x2b, 0x58, 0xea, 0xab, 0xce,
+        0xdd
+    };
+    uint8_t Z[] = {
+        0x4d, 0xc9, 0x79, 0xdc, 0x17, 0xe2, 0x05, 0xee, 0xc3, 0xfa, 0x57, 0x71, 0x62, 0x7e, 0x07, 0x7a,
+        0x68, 0x07, 0x9f, 0x61, 0xf7, 0x23, 0x60, 0x14, 0x32, 0x28, 0x58, 0x90, 0x01, 0x08, 0x34, 0x5d,
+        0x69, 0x5b, 0x5d, 0x5d, 0x52, 0xe5, 0x66, 0x17, 0x44, 0xea, 0xb8, 0x1d, 0x69, 0xba, 0x0c, 0xf5
+    };
+    uint8_t hash[] = {
+        0xcb, 0x00, 0x75, 0x3f, 0x45, 0xa3, 0x5e, 0x8b, 0xb5, 0xa0, 0x3d, 0x69, 0x9a, 0xc6, 0x50, 0x07,
+        0x27, 0x2c, 0x32, 0xab, 0x0e, 0xde, 0xd1, 0x63, 0x1a, 0x8b, 0x60, 0x5a, 0x43, 0xff, 0x5b, 0xed,
+        0x80, 0x86, 0x07, 0x2b, 0xa1, 0xe7, 0xcc, 0x23, 0x58, 0xba, 0xec, 0xa1, 0x34, 0xc8, 0x25, 0xa7
+    };
+    uint8_t sig[] = {
+        0x30, 0x64, 0x02, 0x30, 0x4c, 0xcf, 0x3b, 0xe5, 0x78, 0xa9, 0xd0, 0xe0, 0x14, 0xa4, 0x5b, 0xc4,
+        0xa9, 0x4d, 0xee, 0xdc, 0xc8, 0xfd, 0x62, 0x7d, 0x66, 0xc6, 0x3f, 0x8c, 0xb7, 0xba, 0xb2, 0x46,
+        0x13, 0x03, 0x27, 0xe4, 0x51, 0x7d, 0xed, 0x2f, 0x23, 0x33, 0x8e, 0xf1, 0x9d, 0x51, 0xc6, 0xc2,
+        0x6f, 0x1d, 0x79, 0x6b, 0x02, 0x30, 0x25, 0xb7, 0x2d, 0x7b, 0x49, 0x1e, 0xa9, 0xb4, 0x12, 0x87,
+        0xc7, 0xca, 0x6c, 0xb0, 0x52, 0x98, 0x17, 0x70, 0x9f, 0x32, 0x54, 0xd7, 0xed, 0xa9, 0x28, 0x58,
+        0xe5, 0xbd, 0xb3, 0xb9, 0xfa, 0xa3, 0x41, 0x65, 0xcf, 0x4a, 0x33, 0x23, 0x49, 0xd9, 0xeb, 0x04,
+        0x82, 0x4a, 0x98, 0x2d, 0xe6, 0x71
+    };
+
+    return sTestECC_KAT(384, priv1, sizeof(priv1), pub1, sizeof(pub1), pub2, sizeof(pub2),
+                        Z, sizeof(Z), hash, sizeof(hash), sig, sizeof(sig));
+}
+
+/* Curve41417, the same checks with vectors from plain affine Edwards arithmetic */
+static S4Err sTestECC_41417KAT()
+{
+    uint8_t priv1[] = {
+        0x30, 0x81, 0xa9, 0x03, 0x02, 0x07, 0x80, 0x02, 0x01, 0x34, 0x02, 0x34, 0x3d, 0xf8, 0x06, 0xd4,
+        0x59, 0xe9, 0xaf, 0x5a, 0xe2, 0xb7, 0xc8, 0x78, 0x7b, 0xd3, 0x4a, 0xec, 0xcf, 0x9f, 0x67, 0x02,
+        0x96, 0x1c, 0x29, 0x61, 0xab, 0xf4, 0x8f, 0x5d, 0x94, 0xde, 0xfd, 0x18, 0x12, 0x20, 0x82, 0xe1,
+        0x19, 0x8a, 0x1d, 0x05, 0x91, 0x42, 0x27, 0x88, 0xc1, 0x96, 0x29, 0x5f, 0x69, 0x74, 0x34, 0x8a,
+        0x02, 0x34, 0x09, 0xf9, 0x7b, 0x6b, 0x29, 0xb9, 0xab, 0x8b, 0xe9, 0x76, 0x2d, 0xb1, 0xad, 0xea,
+        0xbe, 0x0f, 0xc9, 0xc1, 0xc3, 0xa6, 0x46, 0xa6, 0xf0, 0x30, 0x05, 0xae, 0x0c, 0xff, 0x93, 0xc7,
+        0x1d, 0x4b, 0x64, 0xc1, 0x86, 0xe9, 0x4c, 0x1a, 0xe4, 0xe5, 0x19, 0x89, 0x8c, 0xd7, 0x6d, 0x69,
+        0xde, 0x0a, 0xd5, 0xb0, 0x79, 0xda, 0x02, 0x34, 0x10, 0x35, 0xec, 0xd2, 0x80, 0x34, 0x96, 0x5b,
+        0x70, 0xf5, 0x98, 0x50, 0x78, 0xc3, 0x4c, 0x52, 0xff, 0x03, 0x15, 0xf0, 0x37, 0x2e, 0x6f, 0xef,
+        0x34, 0x29, 0x7c, 0x9e, 0x08, 0x9f, 0x8c, 0x2b, 0x68, 0x2f, 0x13, 0x27, 0xa5, 0xa4, 0xa5, 0x78,
+        0xbb, 0x74, 0xb8, 0x06, 0xa7, 0xe1, 0x8d, 0xdf, 0x83, 0x13, 0x77, 0x30
+    };
+    uint8_t pub1[] = {
+        0x04, 0x3d, 0xf8, 0x06, 0xd4, 0x59, 0xe9, 0xaf, 0x5a, 0xe2, 0xb7, 0xc8, 0x78, 0x7b, 0xd3, 0x4a,
+        0xec, 0xcf, 0x9f, 0x67, 0x02, 0x96, 0x1c, 0x29, 0x61, 0xab, 0xf4, 0x8f, 0x5d, 0x94, 0xde, 0xfd,
+        0x18, 0x12, 0x20, 0x82, 0xe1, 0x19, 0x8a, 0x1d, 0x05, 0x91, 0x42, 0x27, 0x88, 0xc1, 0x96, 0x29,
+        0x5f, 0x69, 0x74, 0x34, 0x8a, 0x09, 0xf9, 0x7b, 0x6b, 0x29, 0xb9, 0xab, 0x8b, 0xe9, 0x76, 0x2d,
+        0xb1, 0xad, 0xea, 0xbe, 0x0f, 0xc9, 0xc1, 0xc3, 0xa6, 0x46, 0xa6, 0xf0, 0x30, 0x05, 0xae, 0x0c,
+        0xff, 0x93, 0xc7, 0x1d, 0x4b, 0x64, 0xc1, 0x86, 0xe9, 0x4c, 0x1a, 0xe4, 0xe5, 0x19, 0x89, 0x8c,
+        0xd7, 0x6d, 0x69, 0xde, 0x0a, 0xd5, 0xb0, 0x79, 0xda
+    };
+    uint8_t pub2[] = {
+        0x04, 0x14, 0x8f, 0x8a, 0x04, 0x98, 0x36, 0x38, 0x49, 0xaa, 0x1a, 0x23, 0x7d, 0x37, 0x32, 0x90,
+        0x3b, 0x2c, 0x60, 0xe6, 0x52, 0x3b, 0xa4, 0xc5, 0x79, 0x25, 0xf1, 0xa3, 0x68, 0xd0, 0x24, 0x2d,
+        0xf7, 0xdf, 0xaa, 0x0d, 0x96, 0x6e, 0x49, 0x28, 0xdf, 0x0c, 0x82, 0xff, 0x3c, 0xde, 0xf1, 0x00,
+        0x6c, 0xc7, 0xc3, 0x4b, 0x14, 0x3f, 0x23, 0x61, 0x1d, 0xee, 0x48, 0xdf, 0x4a, 0x45, 0x97, 0x38,
+        0xb8, 0xb8, 0x7a, 0xfc, 0xee, 0xba, 0xeb, 0x11, 0x02, 0xf8, 0x95, 0x3c, 0x2f, 0x33, 0x56, 0x8d,
+        0xaf, 0x25, 0x40, 0x58, 0xa4, 0x95, 0x80, 0x64, 0x69, 0x70, 0xa4, 0xee, 0x8c, 0xa8, 0xe7, 0xe9,
+        0xa8, 0x6a, 0xca, 0x32, 0xda, 0xec, 0x22, 0x70, 0xf6
+    };
+    uint8_t Z[] = {
+        0x33, 0x02, 0x24, 0x16, 0xf8, 0x11, 0xca, 0xb5, 0xfb, 0x8d, 0xb3, 0x13, 0xea, 0x5d, 0x93, 0x35,
+        0xc0, 0x4f, 0xd9, 0x29, 0x3b, 0x0d, 0x60, 0x28, 0x09, 0xc2, 0x2f, 0x2e, 0xf5, 0x55, 0x7a, 0x7a,
+        0x4f, 0x88, 0xb3, 0xf1, 0x03, 0x48, 0x01, 0xf3, 0x03, 0x57, 0x15, 0xc7, 0x45, 0xeb, 0xdc, 0xed,
+        0xed, 0x2b, 0x47, 0x8b
+    };
+    uint8_t hash[] = {
+        0xdd, 0xaf, 0x35, 0xa1, 0x93, 0x61, 0x7a, 0xba, 0xcc, 0x41, 0x73, 0x49, 0xae, 0x20, 0x41, 0x31,
+        0x12, 0xe6, 0xfa, 0x4e, 0x89, 0xa9, 0x7e, 0xa2, 0x0a, 0x9e, 0xee, 0xe6, 0x4b, 0x55, 0xd3, 0x9a,
+        0x21, 0x92, 0x99, 0x2a, 0x27, 0x4f, 0xc1, 0xa8, 0x36, 0xba, 0x3c, 0x23, 0xa3, 0xfe, 0xeb, 0xbd,
+        0x45, 0x4d, 0x44, 0x23, 0x64, 0x3c, 0xe8, 0x0e, 0x2a, 0x9a, 0xc9, 0x4f, 0xa5, 0x4c, 0xa4, 0x9f
+    };
+    uint8_t sig[] = {
+        0x30, 0x6c, 0x02, 0x34, 0x02, 0x19, 0xb4, 0x91, 0x52, 0xa0, 0x53, 0x53, 0x42, 0xb2, 0x81, 0xa2,
+        0xea, 0x5f, 0x50, 0x97, 0xae, 0xb9, 0x75, 0x7f, 0x57, 0xab, 0xca, 0xbe, 0x7c, 0xa9, 0xd6, 0x59,
+        0x42, 0xda, 0x5c, 0x56, 0x34, 0x11, 0x28, 0x51, 0xe3, 0x9f, 0x13, 0x5a, 0x8a, 0x94, 0xec, 0x14,
+        0x75, 0x69, 0x20, 0xa3, 0x1b, 0xa6, 0x6d, 0xf8, 0x02, 0x34, 0x04, 0x81, 0xee, 0xf0, 0xec, 0xd1,
+        0xa9, 0x9b, 0x9f, 0x40, 0x84, 0x57, 0x7a, 0xca, 0xd2, 0x08, 0xb8, 0xde, 0x30, 0x39, 0x8e, 0xd6,
+        0x25, 0xbf, 0xb8, 0x78, 0x46, 0xd4, 0xc0, 0x96, 0x5c, 0x17, 0x91, 0x4d, 0x0b, 0x05, 0x75, 0xc3,
+        0x8d, 0x4a, 0xa3, 0x1f, 0x0f, 0x91, 0x6e, 0xfe, 0x3b, 0x9a, 0x5b, 0x48, 0x33, 0x62
+    };
+
+    return sTestECC_KAT(414, priv1, sizeof(priv1), pub1, sizeof(pub1), pub2, sizeof(pub2),
+                        Z, sizeof(Z), hash, sizeof(hash), sig, sizeof(sig));
+}
+
+
+#if defined(OPTEST_CPU_HOOKS) && defined(LTC_ECC_BL_FE)
+
+/* the Curve41417 square root is internal, reached through the static library.  Each
+   base point coordinate is a root of its square, and -1 has none since p = 3 mod 4 */
+static S4Err sTestECC_41417Sqrt()
+{
+    S4Err                   err = kS4Err_NoErr;
+    const ltc_ecc_set_type  *curve = &ltc_ecc_bl_sets[0];
+    const char              *coords[] = { curve->Gx, curve->Gy };
+    void                    *p = NULL, *x = NULL, *a = NULL, *r = NULL;
+    int                     i;
+    
+    OPTESTLogInfo("\tTesting ECC-414 square root\n");
+    
+    ASSERTERR(mp_init_multi(&p, &x, &a, &r, NULL) == CRYPT_OK, kS4Err_OutOfMemory);
+    ASSERTERR(mp_read_radix(p, curve->prime, 16) == CRYPT_OK, kS4Err_SelfTestFailed);
+    
+    for(i = 0; i < sizeof(coords) / sizeof(coords[0]); i++)
+    {
+        ASSERTERR(mp_read_radix(x, coords[i], 16) == CRYPT_OK, kS4Err_SelfTestFailed);
+        ASSERTERR(mp_mulmod(x, x, p, a) == CRYPT_OK, kS4Err_SelfTestFailed);
+        ASSERTERR(ltc_ecc_bl_sqrtmod(a, p, r) == CRYPT_OK, kS4Err_SelfTestFailed);
+        
+        /* either root will do */
+        if(mp_cmp(r, x) != LTC_MP_EQ)
+        {
+            ASSERTERR(mp_sub(p, r, r) == CRYPT_OK, kS4Err_SelfTestFailed);
+            ASSERTERR(mp_cmp(r, x) == LTC_MP_EQ, kS4Err_SelfTestFailed);
+        }
+    }
+    
+    ASSERTERR(mp_sub_d(p, 1, a) == CRYPT_OK, kS4Err_SelfTestFailed);
+    ASSERTERR(ltc_ecc_bl_sqrtmod(a, p, r) == CRYPT_INVALID_ARG, kS4Err_SelfTestFailed);
+    
+done:
+    if(p) mp_clear_multi(p, x, a, r, NULL);
+    
+    return err;
+}
+
+#endif
+
 S4Err  TestECC()
 {
     S4Err     err = kS4Err_NoErr;
@@ -273,6 +487,13 @@ S4Err  TestECC()
     OPTESTLogVerbose("\n");
     err = sTestECC_DH(414); CKERR;
     OPTESTLogInfo("\n");
+
+    err = sTestECC_P384KAT(); CKERR;
+    err = sTestECC_41417KAT(); CKERR;
+#if defined(OPTEST_CPU_HOOKS) && defined(LTC_ECC_BL_FE)
+    err = sTestECC_41417Sqrt(); CKERR;
+#endif
+    OPTESTLogInfo("\n");
     
     
     
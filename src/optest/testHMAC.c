@@ -164,6 +164,8 @@ static S4Err TestHMACkat(
     size_t				hashSize = 0;
     size_t				resultLen;
     uint8_t                hmacBuf[64];
+    uint8_t                macState[kMAC_ContextAllocSize + 16];
+    int                    i;
     
     err  = MAC_Init(kMAC_Algorithm_HMAC, algor,key, keyLen,  &hmac); CKERR;
     
@@ -177,6 +179,29 @@ static S4Err TestHMACkat(
     /* check against know answer */
     err = compareResults( expected, hmacBuf, resultLen , kResultFormat_Byte, hash_algor_table(algor)); CKERR;
     
+    MAC_Free(hmac);
+    hmac = kInvalidMAC_ContextRef;
+    
+    /* in a caller buffer, off alignment on purpose, and again after MAC_Reset */
+    err  = MAC_InitInPlace(kMAC_Algorithm_HMAC, algor, key, keyLen,
+                           macState + 3, kMAC_ContextAllocSize, &hmac); CKERR;
+    
+    for(i = 0; i < 2; i++)
+    {
+        if(i > 0)
+        {
+            err = MAC_Reset(hmac); CKERR;
+        }
+        
+        err  = MAC_Update( hmac,  (uint8_t*)data, dataLen);CKERR;
+        
+        ZERO(hmacBuf, sizeof(hmacBuf));
+        resultLen = hashSize;
+        err  = MAC_Final( hmac, hmacBuf, &resultLen);CKERR;
+        
+        err = compareResults( expected, hmacBuf, resultLen , kResultFormat_Byte, hash_algor_table(algor)); CKERR;
+    }
+    
 done:
     
     if(!IsNull(hmac))
@@ -187,6 +212,120 @@ done:
 
 
 
+/*
+ MAC a batch of messages of varied lengths with one key and check each
+ result against the single message MAC API
+ */
+
+static S4Err TestMACBatch(HASH_Algorithm algor)
+{
+    S4Err err = kS4Err_NoErr;
+    
+#define kMACBatchCount  100
+    
+    MAC_Algorithm   mac = mac_for_algorithm(algor);
+    MAC_ContextRef  macRef = kInvalidMAC_ContextRef;
+    MAC_ContextRef  resetRef = kInvalidMAC_ContextRef;
+    uint8_t         macState[kMAC_ContextAllocSize];
+    uint8_t         key[32];
+    uint8_t         *msg = NULL;
+    uint8_t         *batchOut = NULL;
+    const unsigned char   *in[kMACBatchCount];
+    unsigned long   inlen[kMACBatchCount];
+    uint8_t         *out[kMACBatchCount];
+    uint8_t         macBuf[64];
+    size_t          resultLen;
+    int             i, k;
+    
+    /* Skein-MAC runs four lanes, with the AVX-512VL rotate or without */
+    OPTESTKernel    skeinKernels[] = {
+        { "avx512vl",   kS4CPU_All,                             kS4CPU_AVX512F | kS4CPU_AVX512VL },
+        { "avx2",       ~kS4CPU_AVX512VL,                       kS4CPU_AVX2 },
+        { "scalar",     ~kS4CPU_AVX2,                           0 },
+    };
+    OPTESTKernel    defaultKernels[] = {
+        { "default",    kS4CPU_All,                             0 },
+    };
+    OPTESTKernel    *kernels = defaultKernels;
+    int             kernelCount = 1;
+    
+    if(mac == kMAC_Algorithm_SKEIN)
+    {
+        kernels = skeinKernels;
+        kernelCount = sizeof(skeinKernels) / sizeof(OPTESTKernel);
+    }
+    
+    msg = malloc(kMACBatchCount * 4); CKNULL(msg);
+    batchOut = malloc(kMACBatchCount * sizeof(macBuf)); CKNULL(batchOut);
+    
+    for(i = 0; i < sizeof(key); i++)
+        key[i] = i;
+    
+    for(i = 0; i < kMACBatchCount * 4; i++)
+        msg[i] = i & 0xFF;
+    
+    for(i = 0; i < kMACBatchCount; i++)
+    {
+        in[i]       = msg + (i % 5);
+        inlen[i]    = (i * 29) % (kMACBatchCount * 3);
+        out[i]      = batchOut + i * sizeof(macBuf);
+    }
+    
+    for(k = 0; k < kernelCount; k++)
+    {
+        if(!OPTESTUseKernel(&kernels[k]))
+            continue;
+        
+        memset(batchOut, 0, kMACBatchCount * sizeof(macBuf));
+        
+        err = MAC_DOBatch(mac, algor, key, sizeof(key), kMACBatchCount, in, inlen, sizeof(macBuf), out); CKERR;
+        
+        for(i = 0; i < kMACBatchCount; i++)
+        {
+            err = MAC_Init(mac, algor, key, sizeof(key), &macRef); CKERR;
+            err = MAC_Update(macRef, in[i], inlen[i]); CKERR;
+            resultLen = sizeof(macBuf);
+            err = MAC_Final(macRef, macBuf, &resultLen); CKERR;
+            MAC_Free(macRef);
+            macRef = kInvalidMAC_ContextRef;
+            
+            err = compareResults( macBuf, out[i], hash_algor_bits(algor) / 8 , kResultFormat_Byte, "Batch MAC"); CKERR;
+            
+            /* one keyed context, restarted for each message */
+            if(!MAC_ContextRefIsValid(resetRef))
+            {
+                err = MAC_InitInPlace(mac, algor, key, sizeof(key), macState, sizeof(macState), &resetRef); CKERR;
+            }
+            else
+            {
+                err = MAC_Reset(resetRef); CKERR;
+            }
+            
+            err = MAC_Update(resetRef, in[i], inlen[i]); CKERR;
+            resultLen = sizeof(macBuf);
+            err = MAC_Final(resetRef, macBuf, &resultLen); CKERR;
+            
+            err = compareResults( macBuf, out[i], hash_algor_bits(algor) / 8 , kResultFormat_Byte, "Reset MAC"); CKERR;
+        }
+    }
+    
+done:
+    
+    OPTESTResetKernel();
+    
+    if(!IsNull(macRef))
+        MAC_Free(macRef);
+    
+    if(!IsNull(resetRef))
+        MAC_Free(resetRef);
+    
+    if(msg) free(msg);
+    if(batchOut) free(batchOut);
+    
+    return err;
+}
+
+
 S4Err TestHMAC()
 {
     S4Err err = kS4Err_NoErr;
@@ -491,6 +630,14 @@ S4Err TestHMAC()
         OPTESTLogInfo("\n");
     }	
     
+    OPTESTLogInfo("\nTesting Batch MAC API\n");
+    
+    for (i = 0; hash_algor_list[i] != kHASH_Algorithm_Invalid; i++)
+    {
+        OPTESTLogInfo("\t%11s\n",  hash_algor_table(hash_algor_list[i])  );
+        err = TestMACBatch(hash_algor_list[i]); CKERR;
+    }
+    
     OPTESTLogInfo("\n");
     
     
@@ -6,8 +6,15 @@
 //  Copyright © 2015 4th-A Technologies, LLC. All rights reserved.
 //
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "s4.h"
 #include "optest.h"
 
@@ -64,6 +71,17 @@ S4Err TestHashKAT(
         err = ( compareResults( expected, hashBuf, expectedLen , kResultFormat_Byte, "Quick HASH")); CKERR;
     }
     
+    /* the same context again after HASH_Reset */
+    err = HASH_Reset(hash); CKERR;
+    
+    for (i = 0; i < passes; i++)
+    {
+        err = HASH_Update( hash, msg, msgsize); CKERR;
+    }
+    
+    err = HASH_Final (hash, hashBuf); CKERR;
+    err = ( compareResults( expected, hashBuf, expectedLen , kResultFormat_Byte, "Reset HASH")); CKERR;
+    
     
 done:
     
@@ -75,17 +93,1108 @@ done:
 
 
 
+/*
+ Compare HASH_DOBatch against HASH_DO for messages of every length
+ up to a few blocks, so each lane sees every padding case
+ */
+
+static S4Err TestHashBatch(HASH_Algorithm algor)
+{
+    S4Err err = kS4Err_NoErr;
+    
+#define kBatchCount  300
+    
+    /* SHA-256 runs 16 or 8 lanes and SHA-512 8 or 4, each checked against HASH_DO */
+    OPTESTKernel    shaKernels[] = {
+        { "avx512",     kS4CPU_All,                             kS4CPU_AVX512F },
+        { "avx2",       ~kS4CPU_AVX512F,                        kS4CPU_AVX2 },
+        { "scalar",     ~(kS4CPU_AVX512F | kS4CPU_AVX2),        0 },
+    };
+    /* Skein-256/512 run four lanes, with the AVX-512VL rotate or without */
+    OPTESTKernel    skeinKernels[] = {
+        { "avx512vl",   kS4CPU_All,                             kS4CPU_AVX512F | kS4CPU_AVX512VL },
+        { "avx2",       ~kS4CPU_AVX512VL,                       kS4CPU_AVX2 },
+        { "scalar",     ~kS4CPU_AVX2,                           0 },
+    };
+    OPTESTKernel    defaultKernels[] = {
+        { "default",    kS4CPU_All,                             0 },
+    };
+    
+    OPTESTKernel    *kernels = defaultKernels;
+    int             kernelCount = 1;
+    uint8_t         *msg = NULL;
+    uint8_t         *batchOut = NULL;
+    const unsigned char   *in[kBatchCount];
+    unsigned long   inlen[kBatchCount];
+    uint8_t         *out[kBatchCount];
+    uint8_t         hashBuf[128];
+    int             i, k;
+    
+    switch(algor)
+    {
+        case kHASH_Algorithm_SHA224:
+        case kHASH_Algorithm_SHA256:
+        case kHASH_Algorithm_SHA384:
+        case kHASH_Algorithm_SHA512:
+        case kHASH_Algorithm_SHA512_256:
+            kernels = shaKernels;
+            kernelCount = sizeof(shaKernels) / sizeof(OPTESTKernel);
+            break;
+            
+        case kHASH_Algorithm_SKEIN256:
+        case kHASH_Algorithm_SKEIN512:
+            kernels = skeinKernels;
+            kernelCount = sizeof(skeinKernels) / sizeof(OPTESTKernel);
+            break;
+            
+        default:
+            break;
+    }
+    
+    msg = malloc(kBatchCount); CKNULL(msg);
+    batchOut = malloc(kBatchCount * sizeof(hashBuf)); CKNULL(batchOut);
+    
+    for(i = 0; i < kBatchCount; i++)
+        msg[i] = i & 0xFF;
+    
+    /* vary the lengths so lanes finish at different times */
+    for(i = 0; i < kBatchCount; i++)
+    {
+        in[i]       = msg + (i % 7);
+        inlen[i]    = (i * 37) % (kBatchCount - 7);
+        out[i]      = batchOut + i * sizeof(hashBuf);
+    }
+    
+    for(k = 0; k < kernelCount; k++)
+    {
+        if(!OPTESTUseKernel(&kernels[k]))
+            continue;
+        
+        memset(batchOut, 0, kBatchCount * sizeof(hashBuf));
+        
+        err = HASH_DOBatch(algor, kBatchCount, in, inlen, sizeof(hashBuf), out); CKERR;
+        
+        for(i = 0; i < kBatchCount; i++)
+        {
+            err = HASH_DO(algor, in[i], inlen[i], sizeof(hashBuf), hashBuf); CKERR;
+            err = compareResults( hashBuf, out[i], hash_algor_bits(algor) / 8 , kResultFormat_Byte, "Batch HASH"); CKERR;
+        }
+    }
+    
+done:
+    
+    OPTESTResetKernel();
+    
+    if(msg) free(msg);
+    if(batchOut) free(batchOut);
+    
+    return err;
+}
+
+
+/*
+ Skein tree hashing known answers, msg[i] = i & 0xFF.  Each vector is run
+ with several thread counts and update sizes, which must not change the digest
+ */
+
+static S4Err TestSkeinTree()
+{
+    S4Err err = kS4Err_NoErr;
+    
+    typedef struct
+    {
+        HASH_Algorithm  algor;
+        uint8_t         leafSizeExp;
+        uint8_t         fanOutExp;
+        uint8_t         maxHeight;
+        size_t          msgLen;
+        uint8_t         *kat;
+    } treevector;
+    
+    treevector kat_vector_array[] =
+    {
+        {   kHASH_Algorithm_SKEIN512_TREE, 1, 1, 0xFF, 5000,
+            "\x94\x93\x3d\x01\x55\x8e\x1e\xcd\x40\x1e\x8e\xe2\x24\xc8\x60\xff"
+            "\x04\x77\x5f\xb1\xb0\x4b\x1f\x66\xb3\xec\xc8\x4f\xdb\x98\xcd\xcc"
+            "\x56\xf1\x01\x98\x4d\x34\x04\xa6\x15\xf8\x73\x2d\xbf\x5e\xc9\x4c"
+            "\x67\x27\x31\x85\x0d\x81\x6e\x71\x47\xc5\xc6\x16\xdd\x2c\x44\x12" },
+        {   kHASH_Algorithm_SKEIN512_TREE, 1, 1, 0x03, 5000,
+            "\xf6\x59\xae\x92\x2b\xb2\xd9\x37\xb0\x02\xef\xe2\x85\x8b\xc6\xac"
+            "\x15\xeb\x25\x95\xf0\x50\x6e\xb5\x1a\x4b\x81\x77\x1f\x2d\x42\xec"
+            "\x4f\x03\xdb\x59\x0a\xcb\xd1\x4d\x69\x63\xb8\x2b\x4f\x1f\x79\x22"
+            "\xf7\x11\x8e\xc0\x33\x45\x28\xa6\xe5\x71\xbd\x4d\xc4\x71\x87\xb3" },
+        {   kHASH_Algorithm_SKEIN512_TREE, 2, 3, 0xFF, 0,
+            "\xeb\x80\x13\x28\x8b\x90\x3a\xcb\x6b\x10\xf7\x54\xa6\xb8\xd6\xa4"
+            "\x5f\xed\xe3\x31\xc0\x93\x84\x23\x14\xa2\x9b\xc2\x96\x57\x67\x91"
+            "\xe1\x36\x71\xb1\x91\x3b\x57\x57\x76\xf0\x1c\xc2\x3d\xd4\x3b\xf8"
+            "\x0f\xc3\x6a\x37\x6e\xae\x87\xa4\xa2\xc1\x85\x0f\xa5\x02\xd0\x70" },
+        {   kHASH_Algorithm_SKEIN512_TREE, 10, 8, 0xFF, 1048576,
+            "\x13\x9f\x98\x6b\x60\x33\xeb\xc4\x8c\x52\x06\x45\x7b\x45\xee\x44"
+            "\x72\xb7\xbf\xfd\xb2\x35\x68\x64\xff\x4a\x4d\xf3\xe0\x14\x79\x04"
+            "\x1c\x67\x3a\xa8\x34\xfa\x98\x2c\xc1\xdf\xe0\xde\xfd\x28\xf5\x33"
+            "\x0f\xd1\x85\x15\xd1\x72\xda\x8d\xd2\xd5\x35\xd0\xe0\x94\x3c\xd2" },
+        {   kHASH_Algorithm_SKEIN1024_TREE, 1, 1, 0xFF, 5000,
+            "\x9e\xf0\x6c\x1f\xec\x8e\x74\xcc\x1b\xec\xfb\xfe\x35\x5c\x81\xd8"
+            "\xf5\x7d\x37\x9e\x4a\xd0\x46\x21\x51\x48\x93\xd6\xe8\x7c\x3e\xd8"
+            "\x59\xba\xc6\x34\x2b\x08\x26\x56\xec\x5e\xe5\xf5\x75\x99\x68\x63"
+            "\xdf\xe5\x83\x98\xd9\xf6\xfb\x03\xee\x82\x64\xf6\xc8\x47\x80\x42"
+            "\xf0\x19\xcb\x3d\x86\x7b\xb2\xa9\x8f\x82\x4e\x78\xfe\x13\x58\xf7"
+            "\x20\xb9\xb9\x1e\x9b\xd9\x70\xd8\xc9\xfb\x21\xf2\x4c\xe1\xa8\x9b"
+            "\x25\xd4\x8d\xb5\x38\x40\x7b\xc2\x97\x8e\xa9\xf7\x19\xb6\x34\xe0"
+            "\xc7\x7f\x19\x31\x4b\x56\x19\x57\xf5\xc8\x69\xea\x20\x63\x84\x20" },
+        {   kHASH_Algorithm_SKEIN1024_TREE, 2, 2, 0x02, 5000,
+            "\x39\x84\xdf\x25\x02\x9e\x71\xcf\x92\x59\xe1\xc3\x41\x6a\xdc\x51"
+            "\xee\x00\x81\x0e\x9a\x3a\x20\x7c\x83\x40\xd4\x0b\x6f\xd0\x93\xd6"
+            "\x65\xc1\xff\xbe\xbc\x8f\xee\xb8\x16\xb6\x55\xce\xea\x21\xfa\xee"
+            "\x61\x85\xc3\xf5\xcf\x2b\xa5\xad\xf4\x8b\xdc\xa3\x0a\x27\xa4\xc2"
+            "\x1f\x10\x12\x25\x4a\x39\xeb\x3b\x79\xbf\x05\xa5\x5f\xe9\xaa\x48"
+            "\x73\x3f\xd7\xac\x3e\x4c\xf7\xd1\xb8\x8d\xc7\x08\x5d\x8d\x52\x28"
+            "\xe1\xbf\x0b\x7b\x13\x62\x54\x6f\x5c\xc4\x74\xfa\xdb\x3e\x07\x98"
+            "\xdd\xc2\x44\x95\x36\x8d\xe7\x61\xa7\xa8\x2e\x10\xd3\xcc\xe5\xe2" },
+        {   kHASH_Algorithm_SKEIN1024_TREE, 10, 8, 0xFF, 1048576,
+            "\x12\xf4\x6e\x2b\xdd\xf1\xc3\x15\x44\x51\xa0\xee\x64\x5f\x2b\x86"
+            "\xf2\xe2\x6b\xb8\x8b\xc1\xc0\x4f\x50\x06\x18\x98\x84\x5c\x0f\xf0"
+            "\xdf\x58\xd8\x9d\x16\x37\x04\x35\x55\x5c\x53\x9a\x8c\x21\x7e\x85"
+            "\x85\x58\x68\x2e\x62\x82\x26\x09\xe0\xbf\xb3\xab\xad\x08\x32\x20"
+            "\x67\x7c\x46\x71\x3d\x1f\x99\x99\x00\x3a\x0e\x7d\x6a\x02\x39\x8e"
+            "\x3e\xca\xd3\xcf\x0b\x37\xbd\x36\x15\xeb\xa3\x8f\xef\x1f\xd6\x9f"
+            "\x74\xf8\xad\x22\x5d\x95\x59\xea\x55\x4b\x78\x0f\xeb\xdd\xa6\x9b"
+            "\x65\xa8\xfb\x0a\xf0\x8b\xf0\x60\x70\x02\x76\xa3\x2e\x33\x5c\x85" },
+    };
+    
+    uint32_t        threadCounts[] = { 1, 2, 3, 8 };
+    size_t          updateSizes[] = { 0, 1000, 7 };
+    uint8_t         *msg = NULL;
+    uint8_t         hashBuf[128];
+    HASH_ContextRef hash = kInvalidHASH_ContextRef;
+    size_t          maxLen = 0;
+    size_t          hashSize, offset, n;
+    int             i, j, k;
+    
+    for(i = 0; i < sizeof(kat_vector_array) / sizeof(treevector); i++)
+        maxLen = MAX(maxLen, kat_vector_array[i].msgLen);
+    
+    msg = malloc(maxLen + 1); CKNULL(msg);
+    for(offset = 0; offset < maxLen; offset++)
+        msg[offset] = offset & 0xFF;
+    
+    for(i = 0; i < sizeof(kat_vector_array) / sizeof(treevector); i++)
+    {
+        treevector *kat = &kat_vector_array[i];
+        
+        OPTESTLogInfo("\t%15s  Yl %2d Yf %d Ym %3d %7zu bytes\n",
+                      hash_algor_table(kat->algor),
+                      kat->leafSizeExp, kat->fanOutExp, kat->maxHeight, kat->msgLen);
+        
+        for(j = 0; j < sizeof(threadCounts) / sizeof(uint32_t); j++)
+            for(k = 0; k < sizeof(updateSizes) / sizeof(size_t); k++)
+            {
+                /* byte at a time updates of the 1MB vectors take too long */
+                if(updateSizes[k] && updateSizes[k] < 100 && kat->msgLen > 10000)
+                    continue;
+                
+                err = HASH_InitSkeinTree(kat->algor, kat->leafSizeExp, kat->fanOutExp, kat->maxHeight,
+                                         threadCounts[j], &hash); CKERR;
+                
+                for(offset = 0; offset < kat->msgLen; offset += n)
+                {
+                    n = kat->msgLen - offset;
+                    if(updateSizes[k] && n > updateSizes[k])
+                        n = updateSizes[k];
+                    err = HASH_Update(hash, msg + offset, n); CKERR;
+                }
+                
+                err = HASH_GetSize(hash, &hashSize); CKERR;
+                err = HASH_Final(hash, hashBuf); CKERR;
+                
+                err = compareResults(kat->kat, hashBuf, hashSize, kResultFormat_Byte, "Skein Tree"); CKERR;
+                
+                /* the same tree and thread pool, for the next message */
+                if(k == 0)
+                {
+                    ZERO(hashBuf, sizeof(hashBuf));
+                    err = HASH_Reset(hash); CKERR;
+                    err = HASH_Update(hash, msg, kat->msgLen); CKERR;
+                    err = HASH_Final(hash, hashBuf); CKERR;
+                    
+                    err = compareResults(kat->kat, hashBuf, hashSize, kResultFormat_Byte, "Reset Skein Tree"); CKERR;
+                }
+                
+                HASH_Free(hash);
+                hash = kInvalidHASH_ContextRef;
+            }
+    }
+    
+    /* HASH_Init picks the default shape */
+    for(i = 0; i < sizeof(kat_vector_array) / sizeof(treevector); i++)
+    {
+        treevector *kat = &kat_vector_array[i];
+        
+        if(kat->leafSizeExp != kHASH_SkeinTree_LeafSizeExp
+           || kat->fanOutExp != kHASH_SkeinTree_FanOutExp
+           || kat->maxHeight != kHASH_SkeinTree_MaxHeight)
+            continue;
+        
+        err = HASH_DO(kat->algor, msg, kat->msgLen, sizeof(hashBuf), hashBuf); CKERR;
+        err = compareResults(kat->kat, hashBuf, hash_algor_bits(kat->algor) / 8, kResultFormat_Byte, "Quick Skein Tree"); CKERR;
+    }
+    
+    /* leaves past the cap would need a leaf buffer of GBs */
+    err = HASH_InitSkeinTree(kHASH_Algorithm_SKEIN1024_TREE, kHASH_SkeinTree_MaxLeafSizeExp + 1,
+                             kHASH_SkeinTree_FanOutExp, kHASH_SkeinTree_MaxHeight, 0, &hash);
+    ASSERTERR(err == kS4Err_BadParams && !HASH_ContextRefIsValid(hash), kS4Err_SelfTestFailed);
+    err = kS4Err_NoErr;
+    
+done:
+    
+    if(HASH_ContextRefIsValid(hash))
+        HASH_Free(hash);
+    
+    if(msg) free(msg);
+    
+    return err;
+}
+
+
+/*
+ BLAKE3 extendable output, msg[i] = i % 251.  The large inputs go through the
+ SIMD chunk kernels and, on machines with several CPUs, the threaded subtrees.
+ Each is checked under every chunk kernel the CPU has and with several update
+ sizes, which must not change the output
+ */
+
+static S4Err TestBLAKE3()
+{
+    S4Err err = kS4Err_NoErr;
+    
+    typedef struct  {
+        size_t              msgLen;
+        uint8_t             *kat;
+    } xofvector;
+    
+    xofvector kat_vector_array[] =
+    {
+        {   1025,
+            (uint8_t*)
+            "\xd0\x02\x78\xae\x47\xeb\x27\xb3\x4f\xae\xcf\x67\xb4\xfe\x26\x3f"
+            "\x82\xd5\x41\x29\x16\xc1\xff\xd9\x7c\x8c\xb7\xfb\x81\x4b\x84\x44"
+            "\xf4\xc4\xa2\x2b\x4b\x39\x91\x55\x35\x8a\x99\x4e\x52\xbf\x25\x5d"
+            "\xe6\x00\x35\x74\x2e\xc7\x1b\xd0\x8a\xc2\x75\xa1\xb5\x1c\xc6\xbf"
+            "\xe3\x32\xb0\xef\x84\xb4\x09\x10\x8c\xda\x08\x0e\x62\x69\xed\x4b"
+            "\x3e\x2c\x3f\x7d\x72\x2a\xa4\xcd\xc9\x8d\x16\xde\xb5\x54\xe5\x62"
+            "\x7b\xe8\xf9\x55\xc9\x8e\x1d\x5f\x95\x65\xa9\x19\x4c\xad\x0c\x42"
+            "\x85\xf9\x37\x00\x06\x2d\x95\x95\xad\xb9\x92\xae\x68\xff\x12\x80"
+            "\x0a\xb6\x7a" },
+        {   1048577,
+            (uint8_t*)
+            "\x2f\x05\x3c\xd7\x47\x2c\xf0\xcd\x2f\x9a\xda\xf4\x5c\x11\x80\x25"
+            "\x5b\x91\xb9\xa8\x65\x40\x4a\x63\x67\x1a\x0e\xe5\xf7\x92\xed\x33"
+            "\xa1\x31\xaf\x9e\x51\xc9\x41\xf9\xff\xab\x2d\x9d\x36\x01\x6c\xcb"
+            "\x7a\x2b\x60\x19\x52\x63\x87\x4a\x1a\x66\xdf\x85\xb4\x99\x4d\x87"
+            "\x2b\xd4\x6a\xc2\x94\x15\x33\xa5\xda\xe9\x1f\xa6\x6d\xab\x13\x43"
+            "\xd8\x2e\x05\x11\x77\x46\xd5\x6a\xcc\x37\xe5\xfb\xa2\xef\x58\xcd"
+            "\x06\x0b\xd8\x57\x01\x1d\xd7\xb0\x99\x79\x8a\x85\x82\xa5\x9e\x4c"
+            "\x17\x2e\x9e\x93\x11\x3c\x38\xaf\xa8\x8b\xa8\x7a\xfd\x63\xea\x88"
+            "\xd5\xf6\x92" },
+        {   3000001,
+            (uint8_t*)
+            "\xa1\xea\xd5\x12\xed\xfc\xe7\xca\xae\xcf\x9c\x12\x4b\xb4\xda\x10"
+            "\x44\x32\xbf\xd8\xca\x64\x0e\x62\xab\x37\x6f\x1d\x72\xa5\x14\x28"
+            "\x62\x91\x82\x20\xfe\x1a\x17\x63\x3c\x1a\x5d\x3a\x27\x41\x01\x6c"
+            "\x7a\xfa\x64\x51\xbb\xbd\xf1\x3b\x2d\xbe\x2c\x82\x0c\xa2\x5d\x3c"
+            "\xbe\xfc\x71\xab\xa2\x52\xc6\x91\x29\x26\xe1\x6e\x2a\x2b\x95\x61"
+            "\xe6\x92\xc8\x67\x93\x03\x3c\x50\x31\x63\xdd\x49\x8f\xe0\x52\xa7"
+            "\x7b\x85\xba\xcd\x32\x49\x83\xb0\xa8\x33\x97\x7b\x96\x0a\x01\xce"
+            "\xa0\xbf\xee\xe4\xd5\xa0\x1c\x56\x6e\x96\xa1\x3f\x90\x75\x5b\x9f"
+            "\x01\x99\xf4" },
+    };
+    
+#define kBLAKE3_XOFLen  131
+    
+    size_t          updateSizes[] = { 0, 65536, 1000, 7 };
+    uint8_t         *msg = NULL;
+    uint8_t         hashBuf[kBLAKE3_XOFLen];
+    HASH_ContextRef hash = kInvalidHASH_ContextRef;
+    size_t          maxLen = 0;
+    size_t          hashSize, offset, n;
+    int             i, j, k;
+    
+    /* 16, 8 and 4 chunks at a time, then one */
+    OPTESTKernel    kernels[] = {
+        { "avx512",     kS4CPU_All,                                         kS4CPU_AVX512F | kS4CPU_SSE41 },
+        { "avx2",       ~kS4CPU_AVX512F,                                    kS4CPU_AVX2 | kS4CPU_SSE41 },
+        { "sse41",      ~(kS4CPU_AVX512F | kS4CPU_AVX2),                    kS4CPU_SSE41 },
+        { "c",          ~(kS4CPU_AVX512F | kS4CPU_AVX2 | kS4CPU_SSE41),     0 },
+    };
+    
+    for(i = 0; i < sizeof(kat_vector_array) / sizeof(xofvector); i++)
+        maxLen = MAX(maxLen, kat_vector_array[i].msgLen);
+    
+    msg = malloc(maxLen); CKNULL(msg);
+    for(offset = 0; offset < maxLen; offset++)
+        msg[offset] = offset % 251;
+    
+    for(j = 0; j < sizeof(kernels) / sizeof(OPTESTKernel); j++)
+    {
+        if(!OPTESTUseKernel(&kernels[j]))
+            continue;
+        
+        for(i = 0; i < sizeof(kat_vector_array) / sizeof(xofvector); i++)
+        {
+            xofvector *kat = &kat_vector_array[i];
+            
+            OPTESTLogInfo("\t%10s  %7zu bytes  %s\n", hash_algor_table(kHASH_Algorithm_BLAKE3), kat->msgLen, kernels[j].name);
+            
+            for(k = 0; k < sizeof(updateSizes) / sizeof(size_t); k++)
+            {
+                /* byte at a time updates of the large vectors take too long */
+                if(updateSizes[k] && updateSizes[k] < 100 && kat->msgLen > 10000)
+                    continue;
+                
+                err = HASH_Init(kHASH_Algorithm_BLAKE3, &hash); CKERR;
+                err = HASH_SetOutputSize(hash, kBLAKE3_XOFLen); CKERR;
+                
+                for(offset = 0; offset < kat->msgLen; offset += n)
+                {
+                    n = kat->msgLen - offset;
+                    if(updateSizes[k] && n > updateSizes[k])
+                        n = updateSizes[k];
+                    err = HASH_Update(hash, msg + offset, n); CKERR;
+                }
+                
+                err = HASH_GetSize(hash, &hashSize); CKERR;
+                ASSERTERR(hashSize == kBLAKE3_XOFLen, kS4Err_SelfTestFailed);
+                
+                err = HASH_Final(hash, hashBuf); CKERR;
+                HASH_Free(hash);
+                hash = kInvalidHASH_ContextRef;
+                
+                err = compareResults(kat->kat, hashBuf, kBLAKE3_XOFLen, kResultFormat_Byte, "BLAKE3 XOF"); CKERR;
+            }
+            
+            /* HASH_DO produces exactly outLen bytes */
+            err = HASH_DO(kHASH_Algorithm_BLAKE3, msg, kat->msgLen, kBLAKE3_XOFLen, hashBuf); CKERR;
+            err = compareResults(kat->kat, hashBuf, kBLAKE3_XOFLen, kResultFormat_Byte, "Quick BLAKE3 XOF"); CKERR;
+            
+            err = HASH_DO(kHASH_Algorithm_BLAKE3, msg, kat->msgLen, 7, hashBuf); CKERR;
+            err = compareResults(kat->kat, hashBuf, 7, kResultFormat_Byte, "Quick BLAKE3 XOF"); CKERR;
+        }
+    }
+    
+    /* only BLAKE3 has a variable output size */
+    err = HASH_Init(kHASH_Algorithm_SHA256, &hash); CKERR;
+    err = HASH_SetOutputSize(hash, 64);
+    ASSERTERR(err == kS4Err_FeatureNotAvailable, kS4Err_SelfTestFailed);
+    err = kS4Err_NoErr;
+    
+done:
+    
+    OPTESTResetKernel();
+    
+    if(HASH_ContextRefIsValid(hash))
+        HASH_Free(hash);
+    
+    if(msg) free(msg);
+    
+    return err;
+}
+
+
+#if _USES_XXHASH_
+
+/*
+ Seeded xxHash, msg[i] = i & 0xFF.  The lengths cover each of the XXH3
+ short input paths and the streaming path.  HASH_InitWithSeed is fed whole
+ and a byte at a time, and must agree with the one shot HASH_DOWithSeed
+ */
+
+static S4Err TestXXHashSeed()
+{
+    S4Err err = kS4Err_NoErr;
+    
+    typedef struct  {
+        size_t              msgLen;
+        uint8_t             *xxHash32;      /* seed 0x9E3779B1 */
+        uint8_t             *xxHash64;      /* the others 0x9E3779B97F4A7C15 */
+        uint8_t             *xxHash3_64;
+        uint8_t             *xxHash128;
+    } seedvector;
+    
+    seedvector kat_vector_array[] =
+    {
+        {      0,
+            (uint8_t*)"\xE7\x8A\xB7\x36",
+            (uint8_t*)"\x00\x00\x01\x3C\xC9\x9F\x34\xC4",
+            (uint8_t*)"\x8B\x2C\x66\xD6\x2C\x0E\x2B\x60",
+            (uint8_t*)"\x87\x17\x17\x98\x69\x17\xA5\x4C\x4B\x55\xCA\x2C\x7A\x97\x42\xD1" },
+        {      3,
+            (uint8_t*)"\x93\x27\x30\x24",
+            (uint8_t*)"\xBA\xE4\xC6\xF6\xD5\x6E\xBC\x67",
+            (uint8_t*)"\x9E\xD5\xB5\x03\xF5\xD1\x1F\xBE",
+            (uint8_t*)"\x9E\xD5\xB5\x03\xF5\xD1\x1F\xBE\x88\xF5\x4E\x1A\xA0\x55\x2A\xBF" },
+        {     17,
+            (uint8_t*)"\x16\xEA\xFD\x5E",
+            (uint8_t*)"\x5C\x77\x2D\x18\xAE\x65\x85\xFA",
+            (uint8_t*)"\x9F\xDE\x41\xC6\x63\xF0\xE5\x89",
+            (uint8_t*)"\xBC\xE8\x3D\x36\xC2\x3F\xA0\xCB\x88\xDF\xB8\xC1\x47\xA8\xDF\x4E" },
+        {    129,
+            (uint8_t*)"\x0F\xD6\x1C\x8B",
+            (uint8_t*)"\xC7\x6B\x53\x96\xC0\x2B\x33\xF6",
+            (uint8_t*)"\x77\x21\x2D\xDD\x9F\x15\x7F\x74",
+            (uint8_t*)"\xAE\x76\x18\xA8\x83\xAC\x2B\x95\x3F\x48\xD7\x1F\xBB\x98\xA7\x47" },
+        {    240,
+            (uint8_t*)"\x86\x24\x31\xF6",
+            (uint8_t*)"\xCD\x36\xE2\x82\xF0\x1C\xD2\x46",
+            (uint8_t*)"\x72\xC3\x68\x08\xDB\x66\xE7\xE6",
+            (uint8_t*)"\xF7\x55\x11\x23\xA1\x54\xD8\x5B\xEB\xB7\x4A\x6B\xAE\x4C\xBC\xF0" },
+        {    241,
+            (uint8_t*)"\x26\xB2\xC0\x21",
+            (uint8_t*)"\x28\x08\x27\x33\x51\xB1\x02\x0E",
+            (uint8_t*)"\x80\x5A\x8C\x20\xDE\x14\x21\x17",
+            (uint8_t*)"\x80\x5A\x8C\x20\xDE\x14\x21\x17\xD8\xF7\xE7\x93\xA2\x1B\x07\xAA" },
+        {   2000,
+            (uint8_t*)"\xF4\x2A\x52\x88",
+            (uint8_t*)"\x2B\x77\xF7\xF4\xEE\xB5\x18\xA0",
+            (uint8_t*)"\xB1\x5D\xC1\x64\xAC\xDC\x0F\x56",
+            (uint8_t*)"\xB1\x5D\xC1\x64\xAC\xDC\x0F\x56\xCB\xCD\x28\xAC\x1D\x1B\x36\xA8" },
+    };
+    
+    HASH_Algorithm  algors[] = { kHASH_Algorithm_xxHash32, kHASH_Algorithm_xxHash64,
+                                 kHASH_Algorithm_xxHash3_64, kHASH_Algorithm_xxHash128 };
+    
+    uint8_t         msg[2000];
+    uint8_t         hashBuf[16];
+    HASH_ContextRef hash = kInvalidHASH_ContextRef;
+    size_t          hashSize, offset;
+    int             i, j, k;
+    
+    for(offset = 0; offset < sizeof(msg); offset++)
+        msg[offset] = offset & 0xFF;
+    
+    for(j = 0; j < sizeof(algors) / sizeof(HASH_Algorithm); j++)
+    {
+        uint64_t seed = (algors[j] == kHASH_Algorithm_xxHash32) ? 0x9E3779B1 : 0x9E3779B97F4A7C15;
+        
+        OPTESTLogInfo("\t%10s\n", hash_algor_table(algors[j]));
+        
+        for(i = 0; i < sizeof(kat_vector_array) / sizeof(seedvector); i++)
+        {
+            seedvector *kat = &kat_vector_array[i];
+            uint8_t *expected = j == 0 ? kat->xxHash32 : j == 1 ? kat->xxHash64
+                              : j == 2 ? kat->xxHash3_64 : kat->xxHash128;
+            
+            for(k = 0; k < 2; k++)
+            {
+                err = HASH_InitWithSeed(algors[j], seed, &hash); CKERR;
+                
+                if(k == 0)
+                {
+                    err = HASH_Update(hash, msg, kat->msgLen); CKERR;
+                }
+                else for(offset = 0; offset < kat->msgLen; offset++)
+                {
+                    err = HASH_Update(hash, msg + offset, 1); CKERR;
+                }
+                
+                err = HASH_GetSize(hash, &hashSize); CKERR;
+                err = HASH_Final(hash, hashBuf); CKERR;
+                HASH_Free(hash);
+                hash = kInvalidHASH_ContextRef;
+                
+                err = compareResults(expected, hashBuf, hashSize, kResultFormat_Byte, "Seeded xxHash"); CKERR;
+            }
+            
+            err = HASH_DOWithSeed(algors[j], seed, msg, kat->msgLen, hashSize, hashBuf); CKERR;
+            err = compareResults(expected, hashBuf, hashSize, kResultFormat_Byte, "Quick Seeded xxHash"); CKERR;
+        }
+    }
+    
+    /* seeds are for xxHash only, and xxHash32 takes 32 bits */
+    err = HASH_InitWithSeed(kHASH_Algorithm_SHA256, 1, &hash);
+    ASSERTERR(err == kS4Err_FeatureNotAvailable, kS4Err_SelfTestFailed);
+    err = HASH_InitWithSeed(kHASH_Algorithm_xxHash32, 0x100000000ULL, &hash);
+    ASSERTERR(err == kS4Err_BadParams, kS4Err_SelfTestFailed);
+    err = kS4Err_NoErr;
+    
+done:
+    
+    if(HASH_ContextRefIsValid(hash))
+        HASH_Free(hash);
+    
+    return err;
+}
+
+#endif
+
+
+/*
+ Contexts built in a caller buffer, at every alignment, must match the heap
+ ones, and HASH_Reset must keep the seed and output size it was set up with
+ */
+
+static S4Err TestHashInPlace()
+{
+    S4Err err = kS4Err_NoErr;
+    
+    HASH_Algorithm  algors[] = { kHASH_Algorithm_SHA1, kHASH_Algorithm_SHA256, kHASH_Algorithm_SHA512,
+                                 kHASH_Algorithm_SKEIN256, kHASH_Algorithm_SKEIN1024, kHASH_Algorithm_BLAKE3,
+#if _USES_XXHASH_
+                                 kHASH_Algorithm_xxHash64, kHASH_Algorithm_xxHash3_64,
+#endif
+                               };
+    
+    uint8_t         ctxBuf[kHASH_ContextAllocSize + 64];
+    uint8_t         msg[1000];
+    uint8_t         expected[128];
+    uint8_t         hashBuf[128];
+    HASH_ContextRef hash = kInvalidHASH_ContextRef;
+    size_t          hashSize, i;
+    int             j;
+    
+    for(i = 0; i < sizeof(msg); i++)
+        msg[i] = i & 0xFF;
+    
+    for(j = 0; j < sizeof(algors) / sizeof(HASH_Algorithm); j++)
+    {
+        OPTESTLogInfo("\t%10s\n", hash_algor_table(algors[j]));
+        
+        err = HASH_DO(algors[j], msg, sizeof(msg), sizeof(expected), expected); CKERR;
+        
+        for(i = 0; i < 64; i += 7)
+        {
+            err = HASH_InitInPlace(algors[j], ctxBuf + i, kHASH_ContextAllocSize, &hash); CKERR;
+            err = HASH_Update(hash, msg, 100); CKERR;
+            
+            /* throw away what is there so far */
+            err = HASH_Reset(hash); CKERR;
+            err = HASH_Update(hash, msg, sizeof(msg)); CKERR;
+            err = HASH_GetSize(hash, &hashSize); CKERR;
+            err = HASH_Final(hash, hashBuf); CKERR;
+            HASH_Free(hash);
+            hash = kInvalidHASH_ContextRef;
+            
+            err = compareResults(expected, hashBuf, hashSize, kResultFormat_Byte, "In Place HASH"); CKERR;
+        }
+    }
+    
+    /* BLAKE3 keeps its output size */
+    err = HASH_DO(kHASH_Algorithm_BLAKE3, msg, sizeof(msg), 100, expected); CKERR;
+    err = HASH_InitInPlace(kHASH_Algorithm_BLAKE3, ctxBuf, sizeof(ctxBuf), &hash); CKERR;
+    err = HASH_SetOutputSize(hash, 100); CKERR;
+    err = HASH_Update(hash, msg, 10); CKERR;
+    err = HASH_Reset(hash); CKERR;
+    err = HASH_Update(hash, msg, sizeof(msg)); CKERR;
+    err = HASH_Final(hash, hashBuf); CKERR;
+    HASH_Free(hash);
+    hash = kInvalidHASH_ContextRef;
+    err = compareResults(expected, hashBuf, 100, kResultFormat_Byte, "Reset BLAKE3 XOF"); CKERR;
+    
+#if _USES_XXHASH_
+    /* and xxHash its seed */
+    err = HASH_DOWithSeed(kHASH_Algorithm_xxHash128, 12345, msg, sizeof(msg), 16, expected); CKERR;
+    err = HASH_InitWithSeed(kHASH_Algorithm_xxHash128, 12345, &hash); CKERR;
+    err = HASH_Update(hash, msg, 10); CKERR;
+    err = HASH_Reset(hash); CKERR;
+    err = HASH_Update(hash, msg, sizeof(msg)); CKERR;
+    err = HASH_Final(hash, hashBuf); CKERR;
+    HASH_Free(hash);
+    hash = kInvalidHASH_ContextRef;
+    err = compareResults(expected, hashBuf, 16, kResultFormat_Byte, "Reset seeded xxHash"); CKERR;
+#endif
+    
+    /* tree contexts live on the heap, and a buffer must hold the whole context */
+    err = HASH_InitInPlace(kHASH_Algorithm_SKEIN512_TREE, ctxBuf, sizeof(ctxBuf), &hash);
+    ASSERTERR(err == kS4Err_FeatureNotAvailable, kS4Err_SelfTestFailed);
+    err = HASH_InitInPlace(kHASH_Algorithm_SHA256, ctxBuf, 64, &hash);
+    ASSERTERR(err == kS4Err_BufferTooSmall, kS4Err_SelfTestFailed);
+    err = kS4Err_NoErr;
+    
+done:
+    
+    if(HASH_ContextRefIsValid(hash))
+        HASH_Free(hash);
+    
+    return err;
+}
+
+
+/*
+ Exporting and importing between every update must not change the digest.  The
+ update sizes straddle the block and buffer sizes of each algorithm, and the
+ message is long enough to stack several BLAKE3 chaining values.  Damaged
+ exports have to be refused
+ */
+
+static S4Err TestHashExport()
+{
+    S4Err err = kS4Err_NoErr;
+    
+    HASH_Algorithm  algors[] = { kHASH_Algorithm_MD5, kHASH_Algorithm_SHA1, kHASH_Algorithm_SHA224,
+                                 kHASH_Algorithm_SHA256, kHASH_Algorithm_SHA384, kHASH_Algorithm_SHA512,
+                                 kHASH_Algorithm_SHA512_256, kHASH_Algorithm_SKEIN256,
+                                 kHASH_Algorithm_SKEIN512, kHASH_Algorithm_SKEIN1024, kHASH_Algorithm_BLAKE3,
+#if _USES_XXHASH_
+                                 kHASH_Algorithm_xxHash32, kHASH_Algorithm_xxHash64,
+                                 kHASH_Algorithm_xxHash3_64, kHASH_Algorithm_xxHash128,
+#endif
+                               };
+    size_t          updateSizes[] = { 1, 15, 63, 64, 65, 127, 129, 240, 255, 257, 1000, 70003 };
+    size_t          msgSize = 3 << 20;
+    
+    uint8_t         *msg = NULL;
+    uint8_t         expected[128];
+    uint8_t         hashBuf[128];
+    uint8_t         exportBuf[kHASH_ExportMaxSize + 1];
+    HASH_ContextRef hash = kInvalidHASH_ContextRef;
+    size_t          exportLen, maxLen, hashSize, offset, n;
+    int             i, k;
+    
+    msg = malloc(msgSize); CKNULL(msg);
+    for(offset = 0; offset < msgSize; offset++)
+        msg[offset] = (offset * 7 + (offset >> 11)) & 0xFF;
+    
+    for(i = 0; i < sizeof(algors) / sizeof(HASH_Algorithm); i++)
+    {
+        bool seeded = false;
+        
+#if _USES_XXHASH_
+        seeded = algors[i] >= kHASH_Algorithm_xxHash32 && algors[i] <= kHASH_Algorithm_xxHash128;
+#endif
+        /* the same setup for the reference and every restart of the test context */
+        for(k = 0; k < 2; k++)
+        {
+            if(seeded)
+                err = HASH_InitWithSeed(algors[i], 0x1234567, &hash);
+            else
+                err = HASH_Init(algors[i], &hash);
+            CKERR;
+            
+            if(algors[i] == kHASH_Algorithm_BLAKE3)
+            {
+                err = HASH_SetOutputSize(hash, 64); CKERR;
+            }
+            
+            if(k == 1)
+                break;
+            
+            err = HASH_Update(hash, msg, msgSize); CKERR;
+            err = HASH_Final(hash, expected); CKERR;
+            HASH_Free(hash);
+            hash = kInvalidHASH_ContextRef;
+        }
+        
+        err = HASH_GetSize(hash, &hashSize); CKERR;
+        
+        maxLen = 0;
+        for(offset = 0, k = 0; offset < msgSize; offset += n, k++)
+        {
+            n = updateSizes[k % (sizeof(updateSizes) / sizeof(size_t))];
+            if(n > msgSize - offset)
+                n = msgSize - offset;
+            
+            err = HASH_Update(hash, msg + offset, n); CKERR;
+            
+            err = HASH_Export(hash, exportBuf, sizeof(exportBuf), &exportLen); CKERR;
+            HASH_Free(hash);
+            hash = kInvalidHASH_ContextRef;
+            
+            if(exportLen > maxLen)
+                maxLen = exportLen;
+            
+            err = HASH_Import(exportBuf, exportLen, &hash); CKERR;
+        }
+        
+        OPTESTLogInfo("\t%-14s %4zu byte checkpoints at most\n", hash_algor_table(algors[i]), maxLen);
+        
+        /* the length of the partial block is implied, nothing else should vary */
+        if(algors[i] == kHASH_Algorithm_SHA256)
+            ASSERTERR(maxLen <= 43 + 63, kS4Err_SelfTestFailed);
+        
+        ASSERTERR(maxLen <= kHASH_ExportMaxSize, kS4Err_SelfTestFailed);
+        
+        err = HASH_Final(hash, hashBuf); CKERR;
+        err = compareResults(expected, hashBuf, hashSize, kResultFormat_Byte, "Export HASH"); CKERR;
+        
+        HASH_Free(hash);
+        hash = kInvalidHASH_ContextRef;
+    }
+    
+    /* truncated, padded, too small a buffer, unknown version */
+    err = HASH_Init(kHASH_Algorithm_SHA256, &hash); CKERR;
+    err = HASH_Update(hash, msg, 100); CKERR;
+    err = HASH_Export(hash, exportBuf, sizeof(exportBuf), &exportLen); CKERR;
+    ASSERTERR(exportLen == 43 + 36, kS4Err_SelfTestFailed);
+    
+    err = HASH_Export(hash, exportBuf, exportLen - 1, &n);
+    ASSERTERR(err == kS4Err_BufferTooSmall, kS4Err_SelfTestFailed);
+    HASH_Free(hash);
+    hash = kInvalidHASH_ContextRef;
+    
+    err = HASH_Import(exportBuf, exportLen - 1, &hash);
+    ASSERTERR(err == kS4Err_BadParams && !HASH_ContextRefIsValid(hash), kS4Err_SelfTestFailed);
+    
+    err = HASH_Import(exportBuf, exportLen + 1, &hash);
+    ASSERTERR(err == kS4Err_BadParams, kS4Err_SelfTestFailed);
+    
+    exportBuf[0]++;
+    err = HASH_Import(exportBuf, exportLen, &hash);
+    ASSERTERR(err == kS4Err_BadParams, kS4Err_SelfTestFailed);
+    exportBuf[0]--;
+    
+    err = HASH_Import(exportBuf, exportLen, &hash); CKERR;
+    err = HASH_Update(hash, msg + 100, 1000); CKERR;
+    err = HASH_Final(hash, hashBuf); CKERR;
+    err = HASH_DO(kHASH_Algorithm_SHA256, msg, 1100, 32, expected); CKERR;
+    err = compareResults(expected, hashBuf, 32, kResultFormat_Byte, "Export HASH"); CKERR;
+    HASH_Free(hash);
+    hash = kInvalidHASH_ContextRef;
+    
+    /* a BLAKE3 chunk counter the chaining value stack does not match, or one past
+       the tree depth.  3 chunks leave two subtrees on the stack, the counter is
+       the 8 bytes after the header */
+    err = HASH_Init(kHASH_Algorithm_BLAKE3, &hash); CKERR;
+    err = HASH_Update(hash, msg, 3 * 1024 + 100); CKERR;
+    err = HASH_Export(hash, exportBuf, sizeof(exportBuf), &exportLen); CKERR;
+    HASH_Free(hash);
+    hash = kInvalidHASH_ContextRef;
+    
+    {
+        uint8_t counters[][8] = {
+            { 0x01, 0, 0, 0, 0, 0, 0, 0 },
+            { 0x07, 0, 0, 0, 0, 0, 0, 0 },
+            { 0x00, 0, 0, 0, 0, 0, 0, 0 },
+            { 0x03, 0, 0, 0, 0, 0, 0x40, 0 },
+            { 0xfe, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+        };
+        uint8_t saved[8];
+        
+        memcpy(saved, exportBuf + 3, 8);
+        ASSERTERR(saved[0] == 3, kS4Err_SelfTestFailed);
+        
+        for(k = 0; k < sizeof(counters) / sizeof(counters[0]); k++)
+        {
+            memcpy(exportBuf + 3, counters[k], 8);
+            err = HASH_Import(exportBuf, exportLen, &hash);
+            ASSERTERR(err == kS4Err_BadParams && !HASH_ContextRefIsValid(hash), kS4Err_SelfTestFailed);
+        }
+        
+        memcpy(exportBuf + 3, saved, 8);
+    }
+    
+    err = HASH_Import(exportBuf, exportLen, &hash); CKERR;
+    err = HASH_Update(hash, msg + 3 * 1024 + 100, 5000); CKERR;
+    err = HASH_Final(hash, hashBuf); CKERR;
+    err = HASH_DO(kHASH_Algorithm_BLAKE3, msg, 3 * 1024 + 5100, 32, expected); CKERR;
+    err = compareResults(expected, hashBuf, 32, kResultFormat_Byte, "Export HASH"); CKERR;
+    
+done:
+    
+    if(HASH_ContextRefIsValid(hash))
+        HASH_Free(hash);
+    
+    if(msg) free(msg);
+    
+    return err;
+}
+
+
+/*
+ A multi context must produce the same digests as hashing once per algorithm,
+ whatever the update sizes, and again after HASH_Reset
+ */
+
+static S4Err TestHashMulti()
+{
+    S4Err err = kS4Err_NoErr;
+    
+    HASH_Algorithm  algors[] = { kHASH_Algorithm_SHA256, kHASH_Algorithm_SHA512,
+#if _USES_XXHASH_
+                                 kHASH_Algorithm_xxHash64,
+#endif
+                                 kHASH_Algorithm_BLAKE3, kHASH_Algorithm_SKEIN512_TREE };
+    size_t          msgSizes[] = { 0, 1, 1000, 100000 };
+    size_t          updateSizes[] = { 0, 7, 20000 };
+    
+    uint8_t         *msg = NULL;
+    uint8_t         expected[512];
+    uint8_t         hashBuf[512];
+    uint8_t         exportBuf[kHASH_ContextAllocSize];
+    HASH_ContextRef hash = kInvalidHASH_ContextRef;
+    size_t          count = sizeof(algors) / sizeof(HASH_Algorithm);
+    size_t          total, hashSize, offset, n;
+    int             i, j, k;
+    
+    msg = malloc(100000); CKNULL(msg);
+    for(offset = 0; offset < 100000; offset++)
+        msg[offset] = (offset * 13) & 0xFF;
+    
+    for(i = 0; i < sizeof(msgSizes) / sizeof(size_t); i++)
+    {
+        OPTESTLogInfo("\t%zu algorithms  %7zu bytes\n", count, msgSizes[i]);
+        
+        for(total = 0, j = 0; j < count; j++)
+        {
+            hashSize = hash_algor_bits(algors[j]) / 8;
+            err = HASH_DO(algors[j], msg, msgSizes[i], hashSize, expected + total); CKERR;
+            total += hashSize;
+        }
+        
+        err = HASH_MultiInit(algors, count, &hash); CKERR;
+        err = HASH_GetSize(hash, &hashSize); CKERR;
+        ASSERTERR(hashSize == total, kS4Err_SelfTestFailed);
+        
+        for(k = 0; k < sizeof(updateSizes) / sizeof(size_t); k++)
+        {
+            if(k > 0)
+            {
+                err = HASH_Reset(hash); CKERR;
+            }
+            
+            for(offset = 0; offset < msgSizes[i]; offset += n)
+            {
+                n = msgSizes[i] - offset;
+                if(updateSizes[k] && n > updateSizes[k])
+                    n = updateSizes[k];
+                err = HASH_Update(hash, msg + offset, n); CKERR;
+            }
+            
+            err = HASH_Final(hash, hashBuf); CKERR;
+            err = compareResults(expected, hashBuf, total, kResultFormat_Byte, "Multi HASH"); CKERR;
+        }
+        
+        HASH_Free(hash);
+        hash = kInvalidHASH_ContextRef;
+    }
+    
+    /* member states live outside the context */
+    err = HASH_MultiInit(algors, 2, &hash); CKERR;
+    err = HASH_Export(hash, exportBuf, sizeof(exportBuf), &hashSize);
+    ASSERTERR(err == kS4Err_FeatureNotAvailable, kS4Err_SelfTestFailed);
+    HASH_Free(hash);
+    hash = kInvalidHASH_ContextRef;
+    
+    err = HASH_MultiInit(algors, 0, &hash);
+    ASSERTERR(err == kS4Err_BadParams, kS4Err_SelfTestFailed);
+    err = kS4Err_NoErr;
+    
+done:
+    
+    if(HASH_ContextRefIsValid(hash))
+        HASH_Free(hash);
+    
+    if(msg) free(msg);
+    
+    return err;
+}
+
+
+/*
+ HASH_File and MAC_File must match hashing the same bytes from memory.  The
+ sizes cross the mapped window and reader buffer boundaries, and a FIFO takes
+ the reader thread path
+ */
+
+typedef struct
+{
+    const char      *path;
+    const uint8_t   *data;
+    size_t          len;
+} sFIFOJob;
+
+static void* sFIFOWriter(void *arg)
+{
+    sFIFOJob    *job = arg;
+    size_t      offset, n;
+    int         fd = open(job->path, O_WRONLY);
+    
+    if(fd < 0)
+        return NULL;
+    
+    /* odd sized writes, so reads come back short */
+    for(offset = 0; offset < job->len; offset += n)
+    {
+        ssize_t wrote;
+        
+        n = job->len - offset < 99991 ? job->len - offset : 99991;
+        wrote = write(fd, job->data + offset, n);
+        if(wrote <= 0)
+            break;
+        n = wrote;
+    }
+    
+    close(fd);
+    
+    return NULL;
+}
+
+static S4Err TestHashFile()
+{
+    S4Err err = kS4Err_NoErr;
+    
+    HASH_Algorithm  algors[] = { kHASH_Algorithm_SHA256, kHASH_Algorithm_SKEIN512,
+                                 kHASH_Algorithm_SKEIN512_TREE, kHASH_Algorithm_BLAKE3 };
+    size_t          sizes[] = { 0, 1, 4096, (1 << 20), (20 << 20) + 777 };
+    
+    const char      *tmpDir = getenv("TMPDIR");
+    char            path[1024];
+    char            fifoPath[1024];
+    uint8_t         *msg = NULL;
+    uint8_t         key[32];
+    uint8_t         expected[131];
+    uint8_t         hashBuf[131];
+    MAC_ContextRef  macRef = kInvalidMAC_ContextRef;
+    size_t          maxLen = 0, resultLen, offset;
+    int             fd = -1;
+    int             i, j;
+    
+    if(!tmpDir)
+        tmpDir = "/tmp";
+    
+    snprintf(path, sizeof(path), "%s/optest-hashfile-XXXXXX", tmpDir);
+    snprintf(fifoPath, sizeof(fifoPath), "%s/optest-hashfifo-%d", tmpDir, (int) getpid());
+    
+    for(i = 0; i < sizeof(sizes) / sizeof(size_t); i++)
+        maxLen = MAX(maxLen, sizes[i]);
+    
+    msg = malloc(maxLen); CKNULL(msg);
+    for(offset = 0; offset < maxLen; offset++)
+        msg[offset] = (offset * 7) & 0xFF;
+    
+    for(i = 0; i < sizeof(key); i++)
+        key[i] = i;
+    
+    fd = mkstemp(path);
+    ASSERTERR(fd >= 0, kS4Err_ResourceUnavailable);
+    close(fd);
+    fd = -1;
+    
+    for(i = 0; i < sizeof(sizes) / sizeof(size_t); i++)
+    {
+        FILE *f = fopen(path, "wb");
+        
+        ASSERTERR(f != NULL, kS4Err_ResourceUnavailable);
+        fwrite(msg, 1, sizes[i], f);
+        fclose(f);
+        
+        OPTESTLogInfo("\t%9zu bytes\n", sizes[i]);
+        
+        for(j = 0; j < sizeof(algors) / sizeof(HASH_Algorithm); j++)
+        {
+            /* BLAKE3 exercises the extendable output, the others take their natural size */
+            unsigned long outLen = algors[j] == kHASH_Algorithm_BLAKE3 ? sizeof(hashBuf)
+                                                                      : hash_algor_bits(algors[j]) / 8;
+            
+            err = HASH_DO(algors[j], msg, sizes[i], outLen, expected); CKERR;
+            err = HASH_File(algors[j], path, outLen, hashBuf); CKERR;
+            err = compareResults(expected, hashBuf, outLen, kResultFormat_Byte, "HASH_File"); CKERR;
+        }
+        
+        /* MAC_File against MAC_Update on the same bytes */
+        for(j = 0; j < 2; j++)
+        {
+            MAC_Algorithm   mac     = j == 0 ? kMAC_Algorithm_HMAC : kMAC_Algorithm_SKEIN;
+            HASH_Algorithm  hash    = j == 0 ? kHASH_Algorithm_SHA256 : kHASH_Algorithm_SKEIN256;
+            
+            err = MAC_Init(mac, hash, key, sizeof(key), &macRef); CKERR;
+            err = MAC_Update(macRef, msg, sizes[i]); CKERR;
+            resultLen = 32;
+            err = MAC_Final(macRef, expected, &resultLen); CKERR;
+            MAC_Free(macRef);
+            macRef = kInvalidMAC_ContextRef;
+            
+            err = MAC_File(mac, hash, key, sizeof(key), path, 32, hashBuf); CKERR;
+            err = compareResults(expected, hashBuf, 32, kResultFormat_Byte, "MAC_File"); CKERR;
+        }
+    }
+    
+    /* pipes can not be mapped, they go through the reader thread */
+    OPTESTLogInfo("\t%9zu bytes through a FIFO\n", maxLen);
+    
+    unlink(fifoPath);
+    ASSERTERR(mkfifo(fifoPath, 0600) == 0, kS4Err_ResourceUnavailable);
+    
+    for(j = 0; j < sizeof(algors) / sizeof(HASH_Algorithm); j++)
+    {
+        sFIFOJob    job = { fifoPath, msg, maxLen };
+        pthread_t   writer;
+        
+        err = HASH_DO(algors[j], msg, maxLen, 32, expected); CKERR;
+        
+        ASSERTERR(pthread_create(&writer, NULL, sFIFOWriter, &job) == 0, kS4Err_ResourceUnavailable);
+        err = HASH_File(algors[j], fifoPath, 32, hashBuf);
+        pthread_join(writer, NULL);
+        CKERR;
+        
+        err = compareResults(expected, hashBuf, 32, kResultFormat_Byte, "HASH_File FIFO"); CKERR;
+    }
+    
+    err = HASH_File(kHASH_Algorithm_SHA256, "/nonexistent/optest-hashfile", 32, hashBuf);
+    ASSERTERR(err == kS4Err_ResourceUnavailable, kS4Err_SelfTestFailed);
+    err = kS4Err_NoErr;
+    
+done:
+    
+    if(MAC_ContextRefIsValid(macRef))
+        MAC_Free(macRef);
+    
+    unlink(path);
+    unlink(fifoPath);
+    
+    if(msg) free(msg);
+    
+    return err;
+}
+
+
 /*
  Run Hash Algorithm known answer self test
  */
 
+/* the SHA-2 compress function an algorithm runs on, 0 when it is not SHA-2 */
+static int SHA2Width(HASH_Algorithm algor)
+{
+    switch(algor)
+    {
+        case kHASH_Algorithm_SHA224:
+        case kHASH_Algorithm_SHA256:
+            return 256;
+            
+        case kHASH_Algorithm_SHA384:
+        case kHASH_Algorithm_SHA512:
+        case kHASH_Algorithm_SHA512_256:
+            return 512;
+            
+        default:
+            return 0;
+    }
+}
+
 S4Err TestHash()
 {
     S4Err err = kS4Err_NoErr;
     
-    unsigned int i;
+    unsigned int i, j, k;
     int last_algor = -1;
     
+    /* SHA-224/256 run on SHA-NI or C, SHA-384/512 on AVX2 or C */
+    OPTESTKernel    sha256Kernels[] = {
+        { "shani",      kS4CPU_All,             kS4CPU_SHA | kS4CPU_SSE41 },
+        { "c",          ~kS4CPU_SHA,            0 },
+    };
+    OPTESTKernel    sha512Kernels[] = {
+        { "avx2",       kS4CPU_All,             kS4CPU_AVX2 | kS4CPU_BMI2 },
+        { "c",          ~kS4CPU_AVX2,           0 },
+    };
+    struct
+    {
+        int             width;
+        OPTESTKernel    *kernels;
+        int             kernelCount;
+    } shaBackends[] = {
+        { 256,  sha256Kernels,  sizeof(sha256Kernels) / sizeof(OPTESTKernel) },
+        { 512,  sha512Kernels,  sizeof(sha512Kernels) / sizeof(OPTESTKernel) },
+    };
+    
     
     /* Test vectors, first line from each FIPS-180 SHA-1 known answer test */
     typedef struct  {
@@ -463,6 +1572,40 @@ S4Err TestHash()
             128
         },
         
+        {
+            kHASH_Algorithm_BLAKE3,
+            "Short",
+            "abc",
+            3,
+            1,
+            (uint8_t*)
+            "\x64\x37\xb3\xac\x38\x46\x51\x33\xff\xb6\x3b\x75\x27\x3a\x8d\xb5"
+            "\x48\xc5\x58\x46\x5d\x79\xdb\x03\xfd\x35\x9c\x6c\xd5\xbd\x9d\x85",
+            32
+        },
+        {
+            kHASH_Algorithm_BLAKE3,
+            "Multi",
+            "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+            56,
+            1,
+            (uint8_t*)
+            "\xc1\x90\x12\xcc\x2a\xaf\x0d\xc3\xd8\xe5\xc4\x5a\x1b\x79\x11\x4d"
+            "\x2d\xf4\x2a\xbb\x2a\x41\x0b\xf5\x4b\xe0\x9e\x89\x1a\xf0\x6f\xf8",
+            32
+        },
+        {
+            kHASH_Algorithm_BLAKE3,
+            "Long",
+            "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+            64,
+            15625,
+            (uint8_t*)
+            "\x61\x6f\x57\x5a\x1b\x58\xd4\xc9\x79\x7d\x42\x17\xb9\x73\x0a\xe5"
+            "\xe6\xeb\x31\x9d\x76\xed\xef\x65\x49\xb4\x6f\x4e\xfe\x31\xff\x8b",
+            32
+        },
+        
 #if _USES_XXHASH_
         
         /* these vectors come from  xxhsum.c  at https://github.com/Cyan4973/xxHash
@@ -550,6 +1693,88 @@ S4Err TestHash()
             (uint8_t*)"\xF7\x9F\x68\x55\x16\x1C\xD9\x73",
             8
         },
+        
+        /* XXH3 vectors from xxHash 0.8, seed 0 */
+        {
+            kHASH_Algorithm_xxHash3_64,
+            "TV 1",
+            "\x9e\xff\x1f\x4b\x5e\x53\x2f\xdd"
+            "\xb5\x54\x4d\x2a\x95\x2b",
+            14,
+            1,
+            (uint8_t*)"\xA8\x26\xA0\x25\x58\xB9\x86\xD7",
+            8
+        },
+        {
+            kHASH_Algorithm_xxHash3_64,
+            "TV2",
+            "\x9e\xff\x1f\x4b\x5e\x53\x2f\xdd"
+            "\xb5\x54\x4d\x2a\x95\x2b\x57\xae"
+            "\x5d\xba\x74\xe9\xd3\xa6\x4c\x98"
+            "\x30\x60\xc0\x80\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00",
+            101,
+            1,
+            (uint8_t*)"\xCF\xC5\x34\xED\xE4\x6F\xCC\xD1",
+            8
+        },
+        {
+            kHASH_Algorithm_xxHash3_64,
+            "Long",
+            "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+            64,
+            15625,
+            (uint8_t*)"\xEB\xC4\x85\x52\xAE\x6F\xFD\xB1",
+            8
+        },
+        {
+            kHASH_Algorithm_xxHash128,
+            "TV 1",
+            "\x9e\xff\x1f\x4b\x5e\x53\x2f\xdd"
+            "\xb5\x54\x4d\x2a\x95\x2b",
+            14,
+            1,
+            (uint8_t*)"\x3C\x2A\x2C\xA5\x49\x3D\xAF\xCC\x44\x12\x38\xF7\x98\x90\xC5\x09",
+            16
+        },
+        {
+            kHASH_Algorithm_xxHash128,
+            "TV2",
+            "\x9e\xff\x1f\x4b\x5e\x53\x2f\xdd"
+            "\xb5\x54\x4d\x2a\x95\x2b\x57\xae"
+            "\x5d\xba\x74\xe9\xd3\xa6\x4c\x98"
+            "\x30\x60\xc0\x80\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00\x00\x00\x00"
+            "\x00\x00\x00\x00\x00",
+            101,
+            1,
+            (uint8_t*)"\x18\x34\xE3\xFF\x11\x9A\x9B\xBA\x69\xC4\xAF\x37\xEF\x04\x5B\x7B",
+            16
+        },
+        {
+            kHASH_Algorithm_xxHash128,
+            "Long",
+            "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+            64,
+            15625,
+            (uint8_t*)"\xEB\xC4\x85\x52\xAE\x6F\xFD\xB1\x79\x95\x4A\x38\x8E\xDF\x45\xA5",
+            16
+        },
 
 #endif
         
@@ -585,9 +1810,84 @@ S4Err TestHash()
                           kat_vector_array[i].kat_len);  CKERR;
     }
     
+    /* the loop above only ran the backends S4_Init picked */
+    OPTESTLogInfo("\n\nTesting SHA-2 Backends\n");
+    
+    for(j = 0; j < sizeof(shaBackends) / sizeof(shaBackends[0]); j++)
+    {
+        for(k = 0; k < shaBackends[j].kernelCount; k++)
+        {
+            if(!OPTESTUseKernel(&shaBackends[j].kernels[k]))
+                continue;
+            
+            OPTESTLogInfo("\t   SHA-%d\t%s\n", shaBackends[j].width, shaBackends[j].kernels[k].name);
+            
+            for (i = 0; i < sizeof(kat_vector_array)/ sizeof(katvector) ; i++)
+            {
+                katvector* kat = &kat_vector_array[i];
+                
+                if(SHA2Width(kat->algor) != shaBackends[j].width)
+                    continue;
+                
+                err = TestHashKAT(kat->algor, kat->name, (uint8_t*) kat->msg, kat->msgLen,
+                                  kat->passes, kat->kat, kat->kat_len);  CKERR;
+            }
+        }
+    }
+    
+    OPTESTResetKernel();
+    
+    OPTESTLogInfo("\n\nTesting Batch Hash API\n");
+    
+    {
+        HASH_Algorithm batchAlgors[] = {
+            kHASH_Algorithm_SHA224, kHASH_Algorithm_SHA256, kHASH_Algorithm_SHA384,
+            kHASH_Algorithm_SHA512, kHASH_Algorithm_SHA512_256, kHASH_Algorithm_SKEIN256,
+            kHASH_Algorithm_SKEIN512, kHASH_Algorithm_SKEIN1024,
+        };
+        
+        for (i = 0; i < sizeof(batchAlgors)/ sizeof(HASH_Algorithm) ; i++)
+        {
+            OPTESTLogInfo("\t%10s\n", hash_algor_table(batchAlgors[i]));
+            err = TestHashBatch(batchAlgors[i]); CKERR;
+        }
+    }
+    
+    OPTESTLogInfo("\n\nTesting Skein Tree Hashing\n");
+    
+    err = TestSkeinTree(); CKERR;
+    
+    OPTESTLogInfo("\n\nTesting BLAKE3 Extendable Output\n");
+    
+    err = TestBLAKE3(); CKERR;
+    
+#if _USES_XXHASH_
+    OPTESTLogInfo("\n\nTesting Seeded xxHash\n");
+    
+    err = TestXXHashSeed(); CKERR;
+    
+#endif
+    OPTESTLogInfo("\n\nTesting In Place Contexts and HASH_Reset\n");
+    
+    err = TestHashInPlace(); CKERR;
+    
+    OPTESTLogInfo("\n\nTesting HASH_Export and HASH_Import\n");
+    
+    err = TestHashExport(); CKERR;
+    
+    OPTESTLogInfo("\n\nTesting Multiple Digests in One Pass\n");
+    
+    err = TestHashMulti(); CKERR;
+    
+    OPTESTLogInfo("\n\nTesting File Hashing\n");
+    
+    err = TestHashFile(); CKERR;
+    
     OPTESTLogInfo("\n\n");
     
 done:
     
+    OPTESTResetKernel();
+    
     return( err );
 }
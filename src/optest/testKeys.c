@@ -279,6 +279,7 @@ static S4Err sRunCipherImportExportKAT(  cipherKATvector *kat)
     S4KeyContextRef passKeyCtx =  kInvalidS4KeyContextRef;
     S4KeyContextRef keyCtx =  kInvalidS4KeyContextRef;
     S4KeyContextRef keyCtx1 =  kInvalidS4KeyContextRef;
+    S4KeyContextRef passCopyCtx =  kInvalidS4KeyContextRef;
     
     S4KeyContextRef  *importCtx = NULL;
     size_t      keyCount = 0;
@@ -315,6 +316,14 @@ static S4Err sRunCipherImportExportKAT(  cipherKATvector *kat)
     
     err = sCompareKeys(keyCtx, keyCtx1, false); CKERR;
     
+    /* a copy of the passkey expands its own key schedule */
+    S4Key_Free(keyCtx1);
+    keyCtx1 = kInvalidS4KeyContextRef;
+    err = S4Key_Copy(passKeyCtx, &passCopyCtx); CKERR;
+    err = S4Key_DecryptFromS4Key(importCtx[0], passCopyCtx , &keyCtx1); CKERR;
+    
+    err = sCompareKeys(keyCtx, keyCtx1, false); CKERR;
+    
     
     if(data)
     {
@@ -346,6 +355,11 @@ done:
         S4Key_Free(passKeyCtx);
     }
  
+    if(S4KeyContextRefIsValid(passCopyCtx))
+    {
+        S4Key_Free(passCopyCtx);
+    }
+ 
     if(S4KeyContextRefIsValid(keyCtx1))
     {
         S4Key_Free(keyCtx1);
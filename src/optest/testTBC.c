@@ -7,6 +7,7 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "s4.h"
 #include "optest.h"
@@ -32,6 +33,113 @@ typedef struct  {
  */
 
 
+/* the same block through TBC_EncryptBlocks, enough times to fill the SIMD lanes and
+ leave one over, with the context tweek set to something else */
+static S4Err RunBlocksKAT(TBC_ContextRef TBC, katvector *kat)
+{
+    S4Err err = kS4Err_NoErr;
+    const size_t    count = 5;
+    size_t          blockSize = kat->keysize >> 3;
+    uint8_t         buf[5 * 128];
+    uint64_t        otherTweek[2] = { ~0ULL, 1 };
+    TBC_Block       blocks[5];
+    size_t          i;
+
+    err = TBC_SetTweek(TBC, otherTweek); CKERR;
+
+    for(i = 0; i < count; i++)
+    {
+        memcpy(buf + i * blockSize, kat->PT, blockSize);
+        blocks[i].tweek = kat->tweek;
+        blocks[i].in    = buf + i * blockSize;
+        blocks[i].out   = buf + i * blockSize;
+    }
+
+    err = TBC_EncryptBlocks(TBC, blocks, count); CKERR;
+
+    for(i = 0; i < count; i++)
+    {
+        err = compareResults( kat->TBC, buf + i * blockSize, blockSize, kResultFormat_Long, "TBC EncryptBlocks"); CKERR;
+    }
+
+    err = TBC_DecryptBlocks(TBC, blocks, count); CKERR;
+
+    for(i = 0; i < count; i++)
+    {
+        err = compareResults( kat->PT, buf + i * blockSize, blockSize, kResultFormat_Long, "TBC DecryptBlocks"); CKERR;
+    }
+
+done:
+    return err;
+}
+
+/* blocks with a tweek each against TBC_SetTweek and TBC_Encrypt one at a time */
+static S4Err RunBlocks(Cipher_Algorithm algor, size_t keysize)
+{
+    S4Err err = kS4Err_NoErr;
+    TBC_ContextRef TBC = kInvalidTBC_ContextRef;
+    const size_t    count = 39;
+    size_t          blockSize = keysize >> 3;
+    uint8_t         key[128];
+    uint8_t         *in = NULL, *ref = NULL, *out = NULL;
+    uint64_t        *tweeks = NULL;
+    TBC_Block       *blocks = NULL;
+    size_t          i, j;
+
+    in      = malloc(count * blockSize);
+    ref     = malloc(count * blockSize);
+    out     = malloc(count * blockSize);
+    tweeks  = malloc(count * 2 * sizeof(uint64_t));
+    blocks  = malloc(count * sizeof(TBC_Block));
+    CKNULL(in); CKNULL(ref); CKNULL(out); CKNULL(tweeks); CKNULL(blocks);
+
+    for(i = 0; i < blockSize; i++) key[i] = (uint8_t)(i * 29 + 7);
+    for(i = 0; i < count * blockSize; i++) in[i] = (uint8_t)(i * 13 + (i >> 8));
+
+    err = TBC_Init(algor, key, &TBC); CKERR;
+
+    for(i = 0; i < count; i++)
+    {
+        tweeks[2 * i]       = (uint64_t)i * 0x9e3779b97f4a7c15ULL;
+        tweeks[2 * i + 1]   = ~(uint64_t)i << 32;
+
+        err = TBC_SetTweek(TBC, tweeks + 2 * i); CKERR;
+        err = TBC_Encrypt(TBC, in + i * blockSize, ref + i * blockSize); CKERR;
+    }
+
+    /* out of order */
+    for(i = 0; i < count; i++)
+    {
+        j = (i * 7) % count;
+        blocks[i].tweek = tweeks + 2 * j;
+        blocks[i].in    = in + j * blockSize;
+        blocks[i].out   = out + j * blockSize;
+    }
+
+    err = TBC_EncryptBlocks(TBC, blocks, count); CKERR;
+    err = compareResults( ref, out, count * blockSize, kResultFormat_Byte, "TBC EncryptBlocks"); CKERR;
+
+    /* back in place */
+    for(i = 0; i < count; i++)
+        blocks[i].in = blocks[i].out;
+
+    err = TBC_DecryptBlocks(TBC, blocks, count); CKERR;
+    err = compareResults( in, out, count * blockSize, kResultFormat_Byte, "TBC DecryptBlocks"); CKERR;
+
+done:
+
+    if(TBC_ContextRefIsValid(TBC))
+        TBC_Free(TBC);
+
+    if(in)      free(in);
+    if(ref)     free(ref);
+    if(out)     free(out);
+    if(tweeks)  free(tweeks);
+    if(blocks)  free(blocks);
+
+    return err;
+}
+
 static S4Err RunCipherKAT(  katvector *kat)
 
 {
@@ -64,6 +172,8 @@ static S4Err RunCipherKAT(  katvector *kat)
     /* check against orginal plain-text  */
     err = compareResults( IN, PT, kat->keysize >>3  , kResultFormat_Long, "TBC Decrypt"); CKERR;
 
+    err = RunBlocksKAT(TBC, kat); CKERR;
+
 done:
     
     if(TBC_ContextRefIsValid(TBC))
@@ -80,7 +190,14 @@ S4Err TestTBCiphers()
 {
     S4Err err = kS4Err_NoErr;
     
-    unsigned int		i;
+    unsigned int		i, k;
+    
+    /* TBC_Init picks the Threefish lanes, so each context is made after the mask is set */
+    OPTESTKernel    laneKernels[] = {
+        { "avx512vl",   kS4CPU_All,             kS4CPU_AVX512F | kS4CPU_AVX512VL },
+        { "avx2",       ~kS4CPU_AVX512VL,       kS4CPU_AVX2 },
+        { "scalar",     ~kS4CPU_AVX2,           0 },
+    };
     
     /* Test vectors for RBC known answer test */
     /* ThreeFish 256 bit key */
@@ -199,15 +316,31 @@ S4Err TestTBCiphers()
      };
     
 
-    /* run  known answer tests (KAT) */
-    for (i = 0; i < sizeof(kat_vector_array)/ sizeof(katvector) ; i++)
+    for(k = 0; k < sizeof(laneKernels) / sizeof(OPTESTKernel); k++)
     {
-        err = RunCipherKAT( &kat_vector_array[i] ); CKERR;
+        if(!OPTESTUseKernel(&laneKernels[k]))
+            continue;
+        
+        OPTESTLogInfo("\tThreeFish %s\n", laneKernels[k].name);
         
+        /* run  known answer tests (KAT) */
+        for (i = 0; i < sizeof(kat_vector_array)/ sizeof(katvector) ; i++)
+        {
+            err = RunCipherKAT( &kat_vector_array[i] ); CKERR;
+            
+        }
+        
+        OPTESTLogInfo("\t%-14s %s\n", "ThreeFish", "Multiple blocks");
+        err = RunBlocks(kCipher_Algorithm_3FISH256, 256); CKERR;
+        err = RunBlocks(kCipher_Algorithm_3FISH512, 512); CKERR;
+        err = RunBlocks(kCipher_Algorithm_3FISH1024, 1024); CKERR;
     }
     
       OPTESTLogInfo("\n");
     
 done:
+    
+    OPTESTResetKernel();
+    
     return err;
 }